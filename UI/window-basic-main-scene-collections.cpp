@@ -281,6 +281,7 @@ void OBSBasic::on_actionRenameSceneCollection_triggered()
 	}
 
 	oldFile.insert(0, path);
+	os_unlink((oldFile + ".snapshot").c_str());
 	oldFile += ".json";
 	os_unlink(oldFile.c_str());
 	oldFile += ".bak";
@@ -343,6 +344,7 @@ void OBSBasic::on_actionRemoveSceneCollection_triggered()
 		api->on_event(OBS_FRONTEND_EVENT_SCENE_COLLECTION_CHANGING);
 
 	oldFile.insert(0, path);
+	os_unlink((oldFile + ".snapshot").c_str());
 	oldFile += ".json";
 
 	os_unlink(oldFile.c_str());
@@ -21,6 +21,7 @@
 #include <cstddef>
 #include <ctime>
 #include <functional>
+#include <sys/stat.h>
 #include <obs-data.h>
 #include <obs.h>
 #include <obs.hpp>
@@ -767,7 +768,25 @@ obs_data_array_t *OBSBasic::SaveProjectors()
 	return savedProjectors;
 }
 
-void OBSBasic::Save(const char *file)
+/* the binary snapshot of the scene collection saved to a JSON file */
+static std::string GetSnapshotPath(const char *file)
+{
+	std::string path = file;
+	size_t ext = path.rfind(".json");
+
+	if (ext != std::string::npos && ext == path.size() - 5)
+		path.resize(ext);
+	return path + ".snapshot";
+}
+
+void OBSBasic::ResetSnapshotWriter()
+{
+	obs_data_writer_destroy(snapshotWriter);
+	snapshotWriter = nullptr;
+	snapshotFile.clear();
+}
+
+void OBSBasic::Save(const char *file, bool json)
 {
 	OBSScene scene = GetCurrentScene();
 	OBSSource curProgramScene = OBSGetStrongRef(programScene);
@@ -820,8 +839,29 @@ void OBSBasic::Save(const char *file)
 		obs_data_set_obj(saveData, "modules", moduleObj);
 	}
 
-	if (!obs_data_save_json_safe(saveData, file, "tmp", "bak"))
+	/* JSON first, so that the snapshot is never older than it unless
+	 * something else wrote the JSON file.  it always has to exist, since
+	 * that's how scene collections are found. */
+	if (!json && !os_file_exists(file))
+		json = true;
+	if (json && !obs_data_save_json_safe(saveData, file, "tmp", "bak"))
 		blog(LOG_ERROR, "Could not save scene data to %s", file);
+
+	std::string snapshot = GetSnapshotPath(file);
+	if (snapshotFile != snapshot) {
+		ResetSnapshotWriter();
+		snapshotWriter = obs_data_writer_create(snapshot.c_str());
+		snapshotFile = snapshot;
+	}
+
+	if (!obs_data_writer_save(snapshotWriter, saveData)) {
+		blog(LOG_ERROR, "Could not save scene data to %s",
+		     snapshot.c_str());
+
+		/* the JSON file is all that's left to load it from */
+		if (!json)
+			obs_data_save_json_safe(saveData, file, "tmp", "bak");
+	}
 }
 
 void OBSBasic::DeferSaveBegin()
@@ -1047,11 +1087,40 @@ void OBSBasic::LogScenes()
 	blog(LOG_INFO, "------------------------------------------------");
 }
 
+/* loads the snapshot unless the JSON file was written after it, by an import
+ * or an older version */
+static obs_data_t *LoadSceneCollectionData(const char *file)
+{
+	std::string snapshot = GetSnapshotPath(file);
+	struct stat json_stat;
+	struct stat snapshot_stat;
+
+	if (os_stat(snapshot.c_str(), &snapshot_stat) == 0 &&
+	    (os_stat(file, &json_stat) != 0 ||
+	     snapshot_stat.st_mtime >= json_stat.st_mtime)) {
+		obs_data_t *data =
+			obs_data_create_from_binary_file(snapshot.c_str());
+		if (data)
+			return data;
+
+		blog(LOG_WARNING, "Failed to load scene collection snapshot "
+				  "%s, loading the JSON file instead",
+		     snapshot.c_str());
+	}
+
+	return obs_data_create_from_json_file_safe(file, "bak");
+}
+
 void OBSBasic::Load(const char *file)
 {
+	uint64_t start = os_gettime_ns();
+
 	disableSaving++;
 
-	obs_data_t *data = obs_data_create_from_json_file_safe(file, "bak");
+	/* the first save after loading writes a full snapshot */
+	ResetSnapshotWriter();
+
+	obs_data_t *data = LoadSceneCollectionData(file);
 	if (!data) {
 		disableSaving--;
 		blog(LOG_INFO, "No scene file found, creating default scene");
@@ -1061,6 +1130,9 @@ void OBSBasic::Load(const char *file)
 	}
 
 	LoadData(data, file);
+
+	blog(LOG_INFO, "Scene collection loaded in %.2f ms",
+	     (double)(os_gettime_ns() - start) / 1000000.0);
 }
 
 static inline void AddMissingFiles(void *data, obs_source_t *source)
@@ -2859,6 +2931,8 @@ OBSBasic::~OBSBasic()
 	delete cpuUsageTimer;
 	os_cpu_usage_info_destroy(cpuUsageInfo);
 
+	ResetSnapshotWriter();
+
 	obs_hotkey_set_callback_routing_func(nullptr, nullptr);
 	ClearHotkeys();
 
@@ -2941,6 +3015,7 @@ void OBSBasic::SaveProjectNow()
 		return;
 
 	projectChanged = true;
+	saveJson = true;
 	SaveProjectDeferred();
 }
 
@@ -2962,7 +3037,9 @@ void OBSBasic::SaveProjectDeferred()
 	if (!projectChanged)
 		return;
 
+	bool json = saveJson;
 	projectChanged = false;
+	saveJson = false;
 
 	const char *sceneCollection = config_get_string(
 		App()->GlobalConfig(), "Basic", "SceneCollectionFile");
@@ -2983,7 +3060,7 @@ void OBSBasic::SaveProjectDeferred()
 	if (ret <= 0)
 		return;
 
-	Save(savePath);
+	Save(savePath, json);
 }
 
 OBSSource OBSBasic::GetProgramSource()
@@ -5658,6 +5735,14 @@ void OBSBasic::SetDeinterlacingOrder()
 	obs_source_set_deinterlace_field_order(source, order);
 }
 
+void OBSBasic::SetDeinterlacingCPU(bool checked)
+{
+	OBSSceneItem sceneItem = GetCurrentSceneItem();
+	obs_source_t *source = obs_sceneitem_get_source(sceneItem);
+
+	obs_source_set_deinterlace_cpu(source, checked);
+}
+
 QMenu *OBSBasic::AddDeinterlacingMenu(QMenu *menu, obs_source_t *source)
 {
 	obs_deinterlace_mode deinterlaceMode =
@@ -5697,6 +5782,14 @@ QMenu *OBSBasic::AddDeinterlacingMenu(QMenu *menu, obs_source_t *source)
 	ADD_ORDER("BottomFieldFirst", OBS_DEINTERLACE_FIELD_ORDER_BOTTOM);
 #undef ADD_ORDER
 
+	menu->addSeparator();
+
+	action = menu->addAction(QTStr("Deinterlacing.CPU"));
+	action->setCheckable(true);
+	action->setChecked(obs_source_get_deinterlace_cpu(source));
+	connect(action, &QAction::toggled, this,
+		&OBSBasic::SetDeinterlacingCPU);
+
 	return menu;
 }
 
@@ -234,9 +234,15 @@ private:
 	bool loaded = false;
 	long disableSaving = 1;
 	bool projectChanged = false;
+	bool saveJson = false;
 	bool previewEnabled = true;
 	ContextBarSize contextBarSize = ContextBarSize_Normal;
 
+	/* every save goes to a binary snapshot next to the scene collection's
+	 * JSON file, which is only written when saving right away */
+	obs_data_writer_t *snapshotWriter = nullptr;
+	std::string snapshotFile;
+
 	std::deque<SourceCopyInfo> clipboard;
 	OBSWeakSourceAutoRelease copyFiltersSource;
 	bool copyVisible = true;
@@ -366,7 +372,8 @@ private:
 
 	void UploadLog(const char *subdir, const char *file, const bool crash);
 
-	void Save(const char *file);
+	void Save(const char *file, bool json);
+	void ResetSnapshotWriter();
 	void LoadData(obs_data_t *data, const char *file);
 	void Load(const char *file);
 
@@ -763,6 +770,7 @@ private slots:
 
 	void SetDeinterlacingMode();
 	void SetDeinterlacingOrder();
+	void SetDeinterlacingCPU(bool checked);
 
 	void SetScaleFilter();
 
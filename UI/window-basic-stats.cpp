@@ -96,6 +96,8 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 	renderTime = new QLabel(this);
 	skippedFrames = new QLabel(this);
 	missedFrames = new QLabel(this);
+	renderCacheHits = new QLabel(this);
+	sharedConversions = new QLabel(this);
 
 	str = MakeMissedFramesText(999999, 999999, 99.99);
 	textWidth = missedFrames->fontMetrics().boundingRect(str).width();
@@ -107,6 +109,8 @@ OBSBasicStats::OBSBasicStats(QWidget *parent, bool closeable)
 	newStat("AverageTimeToRender", renderTime, 2);
 	newStat("MissedFrames", missedFrames, 2);
 	newStat("SkippedFrames", skippedFrames, 2);
+	newStat("RenderCacheHits", renderCacheHits, 2);
+	newStat("SharedConversions", sharedConversions, 2);
 
 	/* --------------------------------------------- */
 	QPushButton *closeButton = nullptr;
@@ -263,6 +267,24 @@ static uint32_t first_encoded = 0xFFFFFFFF;
 static uint32_t first_skipped = 0xFFFFFFFF;
 static uint32_t first_rendered = 0xFFFFFFFF;
 static uint32_t first_lagged = 0xFFFFFFFF;
+static uint32_t first_cache_hits = 0xFFFFFFFF;
+static uint32_t first_cache_misses = 0xFFFFFFFF;
+static uint64_t first_conversions = 0;
+static uint64_t first_shared_conversions = 0;
+
+/* conversions for encoders, and how many of them were reused from another
+ * encoder asking for the same format */
+static void GetConversionCounts(uint64_t &total, uint64_t &shared)
+{
+	struct video_output_stats video_stats;
+	struct audio_output_stats audio_stats;
+
+	video_output_get_stats(obs_get_video(), &video_stats);
+	audio_output_get_stats(obs_get_audio(), &audio_stats);
+
+	shared = video_stats.shared_conversions + audio_stats.shared_resamples;
+	total = video_stats.conversions + audio_stats.resamples + shared;
+}
 
 void OBSBasicStats::InitializeValues()
 {
@@ -271,6 +293,9 @@ void OBSBasicStats::InitializeValues()
 	first_skipped = video_output_get_skipped_frames(video);
 	first_rendered = obs_get_total_frames();
 	first_lagged = obs_get_lagged_frames();
+	first_cache_hits = obs_get_render_cache_hits();
+	first_cache_misses = obs_get_render_cache_misses();
+	GetConversionCounts(first_conversions, first_shared_conversions);
 }
 
 void OBSBasicStats::Update()
@@ -422,6 +447,50 @@ void OBSBasicStats::Update()
 	else
 		setThemeID(missedFrames, "");
 
+	/* ------------------ */
+
+	uint32_t cache_hits = obs_get_render_cache_hits();
+	uint32_t cache_misses = obs_get_render_cache_misses();
+
+	if (cache_hits < first_cache_hits ||
+	    cache_misses < first_cache_misses) {
+		first_cache_hits = cache_hits;
+		first_cache_misses = cache_misses;
+	}
+	cache_hits -= first_cache_hits;
+	cache_misses -= first_cache_misses;
+
+	num = (cache_hits + cache_misses)
+		      ? (long double)cache_hits /
+				(long double)(cache_hits + cache_misses)
+		      : 0.0l;
+	num *= 100.0l;
+
+	str = QString::number(num, 'f', 1) + QStringLiteral("%");
+	renderCacheHits->setText(str);
+
+	/* ------------------ */
+
+	uint64_t conversions;
+	uint64_t shared_conversions;
+	GetConversionCounts(conversions, shared_conversions);
+
+	if (conversions < first_conversions ||
+	    shared_conversions < first_shared_conversions) {
+		first_conversions = conversions;
+		first_shared_conversions = shared_conversions;
+	}
+	conversions -= first_conversions;
+	shared_conversions -= first_shared_conversions;
+
+	num = conversions ? (long double)shared_conversions /
+				    (long double)conversions
+			  : 0.0l;
+	num *= 100.0l;
+
+	str = QString::number(num, 'f', 1) + QStringLiteral("%");
+	sharedConversions->setText(str);
+
 	/* ------------------------------------------- */
 	/* recording/streaming stats                   */
 
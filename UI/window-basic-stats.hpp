@@ -24,6 +24,8 @@ class OBSBasicStats : public QFrame {
 	QLabel *renderTime = nullptr;
 	QLabel *skippedFrames = nullptr;
 	QLabel *missedFrames = nullptr;
+	QLabel *renderCacheHits = nullptr;
+	QLabel *sharedConversions = nullptr;
 
 	QGridLayout *outputLayout = nullptr;
 
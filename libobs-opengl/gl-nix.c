@@ -17,6 +17,7 @@
 
 #include "gl-nix.h"
 #include "gl-x11-egl.h"
+#include "gl-headless-egl.h"
 
 #ifdef ENABLE_WAYLAND
 #include "gl-wayland-egl.h"
@@ -33,6 +34,11 @@ static void init_winsys(void)
 	if (platform == OBS_NIX_PLATFORM_X11_EGL)
 		gl_vtable = gl_x11_egl_get_winsys_vtable();
 
+	if (platform == OBS_NIX_PLATFORM_HEADLESS) {
+		gl_vtable = gl_headless_egl_get_winsys_vtable();
+		blog(LOG_INFO, "Using headless EGL");
+	}
+
 #ifdef ENABLE_WAYLAND
 	if (platform == OBS_NIX_PLATFORM_WAYLAND) {
 		gl_vtable = gl_wayland_egl_get_winsys_vtable();
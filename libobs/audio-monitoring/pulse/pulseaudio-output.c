@@ -1,5 +1,6 @@
 #include "obs-internal.h"
 #include "pulseaudio-wrapper.h"
+#include "media-io/monitor-buffer.h"
 
 #define PULSE_DATA(voidptr) struct audio_monitor *data = voidptr;
 #define blog(level, msg, ...) blog(level, "pulse-am: " msg, ##__VA_ARGS__)
@@ -18,8 +19,9 @@ struct audio_monitor {
 	uint_fast32_t packets;
 	uint_fast64_t frames;
 
-	struct circlebuf new_data;
+	struct monitor_buffer *buffer;
 	audio_resampler_t *resampler;
+	bool compensate;
 
 	bool ignore;
 	pthread_mutex_t playback_mutex;
@@ -184,56 +186,32 @@ void process_volume(const struct audio_monitor *monitor, float vol,
 	}
 }
 
-static void do_stream_write(void *param)
+/* called from the pulse thread, so this must never wait on the source */
+static void on_stream_request(pa_stream *stream, size_t nbytes, void *param)
 {
-	PULSE_DATA(param);
-	uint8_t *buffer = NULL;
-
-	pulseaudio_lock();
-	pthread_mutex_lock(&data->playback_mutex);
-
-	// If we have grown a large buffer internally, grow the pulse buffer to match so we can write our data out.
-	if (data->new_data.size > data->attr.tlength * 2) {
-		data->attr.fragsize = (uint32_t)-1;
-		data->attr.maxlength = (uint32_t)-1;
-		data->attr.prebuf = (uint32_t)-1;
-		data->attr.minreq = (uint32_t)-1;
-		data->attr.tlength = data->new_data.size;
-		pa_stream_set_buffer_attr(data->stream, &data->attr, NULL,
-					  NULL);
-	}
+	struct monitor_buffer *buffer = param;
+	const size_t frame_size =
+		pa_frame_size(pa_stream_get_sample_spec(stream));
 
-	// Buffer up enough data before we start playing.
-	if (pa_stream_is_corked(data->stream)) {
-		if (data->new_data.size >= data->attr.tlength) {
-			pa_stream_cork(data->stream, 0, NULL, NULL);
-		} else {
-			goto finish;
-		}
-	}
+	while (nbytes >= frame_size) {
+		size_t bytes = nbytes;
+		void *out;
 
-	while (data->new_data.size > 0) {
-		size_t bytesToFill = data->new_data.size;
-		if (pa_stream_begin_write(data->stream, (void **)&buffer,
-					  &bytesToFill))
-			goto finish;
-
-		// PA may request we submit more or less data than we have.
-		// Wait for more data if we cannot perform a full write.
-		if (bytesToFill > data->new_data.size) {
-			pa_stream_cancel_write(data->stream);
-			goto finish;
-		}
+		if (pa_stream_begin_write(stream, &out, &bytes) < 0 || !out)
+			return;
 
-		circlebuf_pop_front(&data->new_data, buffer, bytesToFill);
+		bytes -= bytes % frame_size;
+		if (!bytes) {
+			pa_stream_cancel_write(stream);
+			return;
+		}
 
-		pa_stream_write(data->stream, buffer, bytesToFill, NULL, 0LL,
+		monitor_buffer_read(buffer, out,
+				    (uint32_t)(bytes / frame_size));
+		pa_stream_write(stream, out, bytes, NULL, 0LL,
 				PA_SEEK_RELATIVE);
+		nbytes -= bytes;
 	}
-
-finish:
-	pthread_mutex_unlock(&data->playback_mutex);
-	pulseaudio_unlock();
 }
 
 static void on_audio_playback(void *param, obs_source_t *source,
@@ -254,6 +232,17 @@ static void on_audio_playback(void *param, obs_source_t *source,
 	if (os_atomic_load_long(&source->activate_refs) == 0)
 		goto unlock;
 
+	if (monitor->compensate) {
+		uint32_t out_frames = (uint32_t)util_mul_div64(
+			audio_data->frames, monitor->samples_per_sec,
+			audio_output_get_sample_rate(obs->audio.audio));
+		int delta = monitor_buffer_compensation(monitor->buffer,
+							 out_frames);
+
+		audio_resampler_set_compensation(monitor->resampler, delta,
+						 delta ? (int)out_frames : 0);
+	}
+
 	success = audio_resampler_resample(
 		monitor->resampler, resample_data, &resample_frames, &ts_offset,
 		(const uint8_t *const *)audio_data->data,
@@ -265,7 +254,8 @@ static void on_audio_playback(void *param, obs_source_t *source,
 	bytes = monitor->bytes_per_frame * resample_frames;
 
 	if (muted) {
-		memset(resample_data[0], 0, bytes);
+		memset(resample_data[0],
+		       monitor->format == PA_SAMPLE_U8 ? 0x80 : 0, bytes);
 	} else {
 		if (!close_float(vol, 1.0f, EPSILON)) {
 			process_volume(monitor, vol, resample_data,
@@ -273,13 +263,12 @@ static void on_audio_playback(void *param, obs_source_t *source,
 		}
 	}
 
-	circlebuf_push_back(&monitor->new_data, resample_data[0], bytes);
+	monitor_buffer_push(monitor->buffer, resample_data[0], resample_frames);
 	monitor->packets++;
 	monitor->frames += resample_frames;
 
 unlock:
 	pthread_mutex_unlock(&monitor->playback_mutex);
-	do_stream_write(param);
 }
 
 static void pulseaudio_server_info(pa_context *c, const pa_server_info *i,
@@ -343,15 +332,15 @@ skip:
 static void pulseaudio_stop_playback(struct audio_monitor *monitor)
 {
 	if (monitor->stream) {
+		/* Remove the callbacks, to ensure we no longer try to do anything
+		 * with this stream object */
+		pulseaudio_write_callback(monitor->stream, NULL, NULL);
+
 		/* Stop the stream */
 		pulseaudio_lock();
 		pa_stream_disconnect(monitor->stream);
 		pulseaudio_unlock();
 
-		/* Remove the callbacks, to ensure we no longer try to do anything
-		 * with this stream object */
-		pulseaudio_write_callback(monitor->stream, NULL, NULL);
-
 		/* Unreference the stream and drop it. PA will free it when it can. */
 		pulseaudio_lock();
 		pa_stream_unref(monitor->stream);
@@ -364,6 +353,17 @@ static void pulseaudio_stop_playback(struct audio_monitor *monitor)
 	     "Got %" PRIuFAST32 " packets with %" PRIuFAST64 " frames",
 	     monitor->packets, monitor->frames);
 
+	if (monitor->buffer) {
+		struct monitor_buffer_stats stats;
+		monitor_buffer_get_stats(monitor->buffer, &stats);
+
+		blog(LOG_INFO,
+		     "%ld underruns, %ld overflows, %ld skips, "
+		     "latency %.1f ms, correction %+.0f ppm",
+		     stats.underruns, stats.overflows, stats.skips,
+		     stats.latency_ms, stats.correction_ppm);
+	}
+
 	monitor->packets = 0;
 	monitor->frames = 0;
 }
@@ -449,9 +449,22 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 		return false;
 	}
 
+	/* enables compensation up front, since it resets the resampler */
+	monitor->compensate =
+		audio_resampler_set_compensation(monitor->resampler, 0, 0);
+	if (!monitor->compensate)
+		blog(LOG_WARNING, "Clock drift compensation is unavailable");
+
 	monitor->speakers = pulseaudio_channels_to_obs_speakers(spec.channels);
 	monitor->bytes_per_frame = pa_frame_size(&spec);
 
+	/* half of the latency is buffered here, the other half in pulse */
+	uint32_t latency_ms = obs->audio.monitoring_latency_ms;
+
+	monitor->buffer = monitor_buffer_create(
+		spec.rate, monitor->bytes_per_frame,
+		spec.format == PA_SAMPLE_U8 ? 0x80 : 0, latency_ms / 2);
+
 	pa_channel_map channel_map = pulseaudio_channel_map(monitor->speakers);
 
 	monitor->stream = pulseaudio_stream_new(
@@ -465,11 +478,16 @@ static bool audio_monitor_init(struct audio_monitor *monitor,
 	monitor->attr.maxlength = (uint32_t)-1;
 	monitor->attr.minreq = (uint32_t)-1;
 	monitor->attr.prebuf = (uint32_t)-1;
-	monitor->attr.tlength = pa_usec_to_bytes(25000, &spec);
+	monitor->attr.tlength =
+		pa_usec_to_bytes((pa_usec_t)latency_ms * 500, &spec);
 
 	pa_stream_flags_t flags = PA_STREAM_INTERPOLATE_TIMING |
-				  PA_STREAM_AUTO_TIMING_UPDATE |
-				  PA_STREAM_START_CORKED;
+				  PA_STREAM_AUTO_TIMING_UPDATE;
+
+	/* the buffer outlives the stream, so it's safe as the userdata even
+	 * though the monitor itself is still moved after this */
+	pulseaudio_write_callback(monitor->stream, on_stream_request,
+				  monitor->buffer);
 
 	int_fast32_t ret = pulseaudio_connect_playback(
 		monitor->stream, monitor->device, &monitor->attr, flags);
@@ -501,13 +519,13 @@ static inline void audio_monitor_free(struct audio_monitor *monitor)
 		obs_source_remove_audio_capture_callback(
 			monitor->source, on_audio_playback, monitor);
 
-	audio_resampler_destroy(monitor->resampler);
-	circlebuf_free(&monitor->new_data);
-
 	if (monitor->stream)
 		pulseaudio_stop_playback(monitor);
 	pulseaudio_unref();
 
+	audio_resampler_destroy(monitor->resampler);
+	monitor_buffer_destroy(monitor->buffer);
+
 	bfree(monitor->device);
 }
 
@@ -37,6 +37,7 @@ target_sources(
           obs-audio.c
           obs-audio-controls.c
           obs-audio-controls.h
+          obs-audio-buffering.h
           obs-avc.c
           obs-avc.h
           obs-data.c
@@ -45,6 +46,7 @@ target_sources(
           obs-display.c
           obs-encoder.c
           obs-encoder.h
+          obs-fanout.h
           obs-ffmpeg-compat.h
           obs-hotkey.c
           obs-hotkey.h
@@ -55,12 +57,14 @@ target_sources(
           obs-nal.h
           obs-hotkey-name-map.c
           obs-interaction.h
+          obs-interleave.h
           obs-internal.h
           obs-module.c
           obs-module.h
           obs-output.c
           obs-output.h
           obs-output-delay.c
+          obs-output-fanout.c
           obs-properties.c
           obs-properties.h
           obs-service.c
@@ -152,13 +156,23 @@ target_sources(
   PRIVATE media-io/audio-io.c
           media-io/audio-io.h
           media-io/audio-math.h
+          media-io/audio-meter.c
+          media-io/audio-meter.h
           media-io/audio-resampler.h
           media-io/audio-resampler-ffmpeg.c
           media-io/format-conversion.c
           media-io/format-conversion.h
+          media-io/frame-pool.c
+          media-io/frame-pool.h
           media-io/frame-rate.h
           media-io/media-remux.c
           media-io/media-remux.h
+          media-io/monitor-buffer.c
+          media-io/monitor-buffer.h
+          media-io/video-convert.c
+          media-io/video-convert.h
+          media-io/video-deinterlace.c
+          media-io/video-deinterlace.h
           media-io/video-fourcc.c
           media-io/video-frame.c
           media-io/video-frame.h
@@ -195,6 +209,8 @@ target_sources(
           util/file-serializer.h
           util/lexer.c
           util/lexer.h
+          util/pacer.c
+          util/pacer.h
           util/platform.c
           util/platform.h
           util/profiler.c
@@ -202,6 +218,8 @@ target_sources(
           util/profiler.hpp
           util/pipe.h
           util/serializer.h
+          util/spsc-ring.c
+          util/spsc-ring.h
           util/sse-intrin.h
           util/task.c
           util/task.h
@@ -210,6 +228,8 @@ target_sources(
           util/threading.h
           util/utf8.c
           util/utf8.h
+          util/worker-pool.c
+          util/worker-pool.h
           util/uthash.h
           util/util_uint64.h
           util/util_uint128.h
@@ -43,25 +43,49 @@ extern profiler_name_store_t *obs_get_profiler_name_store(void);
 		int invalid = 0; \
 	} while (0)
 
+/* Inputs of a mix asking for the same conversion share one resampler, which
+ * only runs once per tick no matter how many inputs use it */
+struct audio_conversion {
+	struct audio_convert_info info;
+	audio_resampler_t *resampler;
+	size_t refs;
+
+	/* output of the last run, valid until the next one */
+	uint64_t tick;
+	bool success;
+	uint8_t *output[MAX_AV_PLANES];
+	uint32_t frames;
+	uint64_t offset;
+};
+
 struct audio_input {
 	struct audio_convert_info conversion;
-	audio_resampler_t *resampler;
+	struct audio_conversion *shared;
 
 	audio_output_callback_t callback;
 	void *param;
 };
 
-static inline void audio_input_free(struct audio_input *input)
-{
-	audio_resampler_destroy(input->resampler);
-}
-
 struct audio_mix {
 	DARRAY(struct audio_input) inputs;
+	DARRAY(struct audio_conversion *) conversions;
 	float buffer[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
 	float buffer_unclamped[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
 };
 
+static inline void audio_input_free(struct audio_mix *mix,
+				    struct audio_input *input)
+{
+	struct audio_conversion *shared = input->shared;
+
+	if (!shared || --shared->refs > 0)
+		return;
+
+	da_erase_item(mix->conversions, &shared);
+	audio_resampler_destroy(shared->resampler);
+	bfree(shared);
+}
+
 struct audio_output {
 	struct audio_output_info info;
 	size_t block_size;
@@ -77,33 +101,44 @@ struct audio_output {
 	void *input_param;
 	pthread_mutex_t input_mutex;
 	struct audio_mix mixes[MAX_AUDIO_MIXES];
+
+	uint64_t tick;
+	uint64_t resamples;
+	uint64_t shared_resamples;
+
+	volatile long catch_up_ticks;
 };
 
 /* ------------------------------------------------------------------------- */
 
-static bool resample_audio_output(struct audio_input *input,
+static bool resample_audio_output(struct audio_output *audio,
+				  struct audio_input *input,
 				  struct audio_data *data)
 {
-	bool success = true;
-
-	if (input->resampler) {
-		uint8_t *output[MAX_AV_PLANES];
-		uint32_t frames;
-		uint64_t offset;
+	struct audio_conversion *shared = input->shared;
 
-		memset(output, 0, sizeof(output));
+	if (!shared)
+		return true;
 
-		success = audio_resampler_resample(
-			input->resampler, output, &frames, &offset,
-			(const uint8_t *const *)data->data, data->frames);
+	if (shared->tick != audio->tick) {
+		memset(shared->output, 0, sizeof(shared->output));
 
-		for (size_t i = 0; i < MAX_AV_PLANES; i++)
-			data->data[i] = output[i];
-		data->frames = frames;
-		data->timestamp -= offset;
+		shared->success = audio_resampler_resample(
+			shared->resampler, shared->output, &shared->frames,
+			&shared->offset, (const uint8_t *const *)data->data,
+			data->frames);
+		shared->tick = audio->tick;
+		audio->resamples++;
+	} else {
+		audio->shared_resamples++;
 	}
 
-	return success;
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		data->data[i] = shared->output[i];
+	data->frames = shared->frames;
+	data->timestamp -= shared->offset;
+
+	return shared->success;
 }
 
 static inline void do_audio_output(struct audio_output *audio, size_t mix_idx,
@@ -126,7 +161,7 @@ static inline void do_audio_output(struct audio_output *audio, size_t mix_idx,
 		data.frames = frames;
 		data.timestamp = timestamp;
 
-		if (resample_audio_output(input, &data))
+		if (resample_audio_output(audio, input, &data))
 			input->callback(input->param, mix_idx, &data);
 	}
 
@@ -171,6 +206,7 @@ static void input_and_output(struct audio_output *audio, uint64_t audio_time,
 	bool success;
 
 	memset(data, 0, sizeof(data));
+	audio->tick++;
 
 #ifdef DEBUG_AUDIO
 	blog(LOG_DEBUG, "audio_time: %llu, prev_time: %llu, bytes: %lu",
@@ -240,6 +276,11 @@ static void *audio_thread(void *param)
 		input_and_output(audio, audio_time, prev_time);
 		prev_time = audio_time;
 
+		while (os_atomic_load_long(&audio->catch_up_ticks) > 0) {
+			os_atomic_dec_long(&audio->catch_up_ticks);
+			input_and_output(audio, audio_time, audio_time);
+		}
+
 		profile_end(audio_thread_name);
 
 		profile_reenable_thread();
@@ -270,12 +311,42 @@ static size_t audio_get_input_idx(const audio_t *audio, size_t mix_idx,
 	return DARRAY_INVALID;
 }
 
+static inline bool same_conversion(const struct audio_convert_info *a,
+				   const struct audio_convert_info *b)
+{
+	return a->format == b->format &&
+	       a->samples_per_sec == b->samples_per_sec &&
+	       a->speakers == b->speakers &&
+	       a->allow_clipping == b->allow_clipping;
+}
+
+static struct audio_conversion *
+get_shared_conversion(struct audio_mix *mix,
+		      const struct audio_convert_info *info)
+{
+	for (size_t i = 0; i < mix->conversions.num; i++) {
+		struct audio_conversion *shared = mix->conversions.array[i];
+
+		if (same_conversion(&shared->info, info)) {
+			shared->refs++;
+			return shared;
+		}
+	}
+
+	return NULL;
+}
+
 static inline bool audio_input_init(struct audio_input *input,
-				    struct audio_output *audio)
+				    struct audio_output *audio,
+				    struct audio_mix *mix)
 {
 	if (input->conversion.format != audio->info.format ||
 	    input->conversion.samples_per_sec != audio->info.samples_per_sec ||
 	    input->conversion.speakers != audio->info.speakers) {
+		input->shared = get_shared_conversion(mix, &input->conversion);
+		if (input->shared)
+			return true;
+
 		struct resample_info from = {
 			.format = audio->info.format,
 			.samples_per_sec = audio->info.samples_per_sec,
@@ -286,14 +357,21 @@ static inline bool audio_input_init(struct audio_input *input,
 			.samples_per_sec = input->conversion.samples_per_sec,
 			.speakers = input->conversion.speakers};
 
-		input->resampler = audio_resampler_create(&to, &from);
-		if (!input->resampler) {
+		audio_resampler_t *resampler =
+			audio_resampler_create(&to, &from);
+		if (!resampler) {
 			blog(LOG_ERROR, "audio_input_init: Failed to "
 					"create resampler");
 			return false;
 		}
+
+		input->shared = bzalloc(sizeof(*input->shared));
+		input->shared->info = input->conversion;
+		input->shared->resampler = resampler;
+		input->shared->refs = 1;
+		da_push_back(mix->conversions, &input->shared);
 	} else {
-		input->resampler = NULL;
+		input->shared = NULL;
 	}
 
 	return true;
@@ -333,7 +411,7 @@ bool audio_output_connect(audio_t *audio, size_t mi,
 			input.conversion.samples_per_sec =
 				audio->info.samples_per_sec;
 
-		success = audio_input_init(&input, audio);
+		success = audio_input_init(&input, audio, mix);
 		if (success)
 			da_push_back(mix->inputs, &input);
 	}
@@ -354,7 +432,7 @@ void audio_output_disconnect(audio_t *audio, size_t mix_idx,
 	size_t idx = audio_get_input_idx(audio, mix_idx, callback, param);
 	if (idx != DARRAY_INVALID) {
 		struct audio_mix *mix = &audio->mixes[mix_idx];
-		audio_input_free(mix->inputs.array + idx);
+		audio_input_free(mix, mix->inputs.array + idx);
 		da_erase(mix->inputs, idx);
 	}
 
@@ -425,9 +503,10 @@ void audio_output_close(audio_t *audio)
 		struct audio_mix *mix = &audio->mixes[mix_idx];
 
 		for (size_t i = 0; i < mix->inputs.num; i++)
-			audio_input_free(mix->inputs.array + i);
+			audio_input_free(mix, mix->inputs.array + i);
 
 		da_free(mix->inputs);
+		da_free(mix->conversions);
 	}
 	bfree(audio);
 }
@@ -471,3 +550,35 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 {
 	return audio ? audio->info.samples_per_sec : 0;
 }
+
+void audio_output_catch_up(audio_t *audio, uint32_t ticks)
+{
+	long old_val;
+
+	if (!audio || !ticks)
+		return;
+
+	old_val = os_atomic_load_long(&audio->catch_up_ticks);
+	while (!os_atomic_compare_exchange_long(&audio->catch_up_ticks,
+						&old_val,
+						old_val + (long)ticks))
+		;
+}
+
+void audio_output_get_stats(audio_t *audio, struct audio_output_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	if (!audio)
+		return;
+
+	pthread_mutex_lock(&audio->input_mutex);
+
+	stats->resamples = audio->resamples;
+	stats->shared_resamples = audio->shared_resamples;
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
+		stats->resamplers += audio->mixes[i].conversions.num;
+
+	pthread_mutex_unlock(&audio->input_mutex);
+}
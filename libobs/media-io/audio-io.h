@@ -238,6 +238,28 @@ EXPORT uint32_t audio_output_get_sample_rate(const audio_t *audio);
 EXPORT const struct audio_output_info *
 audio_output_get_info(const audio_t *audio);
 
+struct audio_output_stats {
+	/** Resampler runs */
+	uint64_t resamples;
+	/** Conversions handed to an input from a resampler run made for
+	 * another input of the same mix with an identical conversion */
+	uint64_t shared_resamples;
+	/** Resamplers currently in use */
+	size_t resamplers;
+};
+
+EXPORT void audio_output_get_stats(audio_t *audio,
+				   struct audio_output_stats *stats);
+
+/**
+ * Runs the input callback again for the given number of ticks right after
+ * the current one, without waiting for the clock.  Those extra calls get an
+ * empty time range (start_ts == end_ts), and let the input hand over audio
+ * it has buffered ahead, which lowers the latency of every output without a
+ * gap in the timestamps.  Can be called from the input callback.
+ */
+EXPORT void audio_output_catch_up(audio_t *audio, uint32_t ticks);
+
 #ifdef __cplusplus
 }
 #endif
@@ -19,6 +19,7 @@
 
 #include "../util/c99defs.h"
 #include <math.h>
+#include <string.h>
 
 #ifdef _MSC_VER
 #include <float.h>
@@ -38,6 +39,87 @@ static inline float db_to_mul(const float db)
 	return isfinite((double)db) ? powf(10.0f, db / 20.0f) : 0.0f;
 }
 
+/*
+ * Approximations for per-sample use in dynamics processors.
+ *
+ * fast_log2f has an absolute error below 2e-7 near 0 dB, further out the
+ * float rounding of the result dominates.  fast_mul_to_db stays within
+ * 3e-5 dB of the exact value down to -240 dB.  fast_exp2f has a relative
+ * error below 3e-7, and fast_db_to_mul is within 1e-6 of the exact gain
+ * from -150 to +60 dB.  Zero and denormals map to about -764 dB, and
+ * anything below -758 dB maps to 0.  NaN is not handled.
+ *
+ * audio-dynamics.c in obs-filters implements the same polynomials with SIMD,
+ * keep the two in sync.
+ */
+
+#define FAST_LOG2_C1 2.885390082f /* 2 / ln(2) */
+#define FAST_LOG2_C3 0.961796694f /* 2 / (3 ln(2)) */
+#define FAST_LOG2_C5 0.577078016f /* 2 / (5 ln(2)) */
+#define FAST_LOG2_C7 0.412198583f /* 2 / (7 ln(2)) */
+
+#define FAST_EXP2_C1 0.693147181f /* ln(2) */
+#define FAST_EXP2_C2 0.240226507f /* ln(2)^2 / 2 */
+#define FAST_EXP2_C3 0.055504109f /* ln(2)^3 / 6 */
+#define FAST_EXP2_C4 0.009618129f /* ln(2)^4 / 24 */
+#define FAST_EXP2_C5 0.001333356f /* ln(2)^5 / 120 */
+#define FAST_EXP2_C6 0.000154035f /* ln(2)^6 / 720 */
+
+#define FAST_DB_PER_LOG2 6.020599913f /* 20 log10(2) */
+#define FAST_LOG2_PER_DB 0.166096405f /* log2(10) / 20 */
+
+static inline float fast_log2f(const float x)
+{
+	uint32_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+
+	float e = (float)((int32_t)((bits >> 23) & 0xff) - 127);
+	bits = (bits & 0x007fffff) | 0x3f800000;
+
+	float m;
+	memcpy(&m, &bits, sizeof(m));
+
+	/* center the mantissa on 1 so the series converges quickly */
+	if (m > 1.414213562f) {
+		m *= 0.5f;
+		e += 1.0f;
+	}
+
+	const float t = (m - 1.0f) / (m + 1.0f);
+	const float t2 = t * t;
+	const float p = FAST_LOG2_C5 + t2 * FAST_LOG2_C7;
+	return e + t * (FAST_LOG2_C1 + t2 * (FAST_LOG2_C3 + t2 * p));
+}
+
+static inline float fast_exp2f(float x)
+{
+	if (x < -126.0f)
+		return 0.0f;
+	if (x > 127.0f)
+		x = 127.0f;
+
+	const float n = floorf(x + 0.5f);
+	const float f = x - n;
+	float p = FAST_EXP2_C5 + f * FAST_EXP2_C6;
+	p = FAST_EXP2_C3 + f * (FAST_EXP2_C4 + f * p);
+	p = 1.0f + f * (FAST_EXP2_C1 + f * (FAST_EXP2_C2 + f * p));
+
+	const uint32_t bits = (uint32_t)((int32_t)n + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(scale));
+	return p * scale;
+}
+
+static inline float fast_mul_to_db(const float mul)
+{
+	return fast_log2f(mul) * FAST_DB_PER_LOG2;
+}
+
+static inline float fast_db_to_mul(const float db)
+{
+	return fast_exp2f(db * FAST_LOG2_PER_DB);
+}
+
 #ifdef _MSC_VER
 #pragma warning(pop)
 #endif
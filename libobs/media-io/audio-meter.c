@@ -0,0 +1,232 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+
+#include "audio-meter.h"
+
+#include "../util/base.h"
+#include "../util/threading.h"
+
+/* The AVX2 kernel is compiled with a target attribute and only called after
+ * checking the CPU at runtime, like the video-convert kernels */
+#if defined(__x86_64__) || (defined(_M_X64) && !defined(_M_ARM64EC))
+#define METER_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#include "../util/sse-intrin.h"
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_AVX2
+#endif
+
+/* Normalized sinc weights of the samples at -1.5, -0.5, +0.5 and +1.5 for
+ * the points at -0.3, -0.1, +0.1 and +0.3 */
+static const float phases[4][4] = {
+	{-0.155915f, 0.935489f, 0.233872f, -0.103943f},
+	{-0.216236f, 0.756827f, 0.504551f, -0.189207f},
+	{-0.189207f, 0.504551f, 0.756827f, -0.216236f},
+	{-0.103943f, 0.233872f, 0.935489f, -0.155915f},
+};
+
+static inline float interpolate(const float *x, size_t phase)
+{
+	const float *c = phases[phase];
+	return c[0] * x[-3] + c[1] * x[-2] + c[2] * x[-1] + c[3] * x[0];
+}
+
+static float true_peak_c(const float *x, size_t i, size_t frames, float peak)
+{
+	for (; i < frames; i++) {
+		peak = fmaxf(peak, fabsf(x[i]));
+		for (size_t p = 0; p < 4; p++)
+			peak = fmaxf(peak, fabsf(interpolate(x + i, p)));
+	}
+
+	return peak;
+}
+
+static inline float hmax_ps(__m128 v)
+{
+	float vals[4];
+	_mm_storeu_ps(vals, v);
+	return fmaxf(fmaxf(vals[0], vals[1]), fmaxf(vals[2], vals[3]));
+}
+
+static inline __m128 abs_ps(__m128 v)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), v);
+}
+
+static float true_peak_sse2(const float *x, size_t frames)
+{
+	__m128 c[4][4];
+	__m128 peak = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (size_t p = 0; p < 4; p++)
+		for (size_t t = 0; t < 4; t++)
+			c[p][t] = _mm_set1_ps(phases[p][t]);
+
+	for (; i + 4 <= frames; i += 4) {
+		const __m128 x0 = _mm_loadu_ps(x + i - 3);
+		const __m128 x1 = _mm_loadu_ps(x + i - 2);
+		const __m128 x2 = _mm_loadu_ps(x + i - 1);
+		const __m128 x3 = _mm_loadu_ps(x + i);
+
+		peak = _mm_max_ps(peak, abs_ps(x3));
+
+		for (size_t p = 0; p < 4; p++) {
+			__m128 y = _mm_mul_ps(c[p][0], x0);
+			y = _mm_add_ps(y, _mm_mul_ps(c[p][1], x1));
+			y = _mm_add_ps(y, _mm_mul_ps(c[p][2], x2));
+			y = _mm_add_ps(y, _mm_mul_ps(c[p][3], x3));
+			peak = _mm_max_ps(peak, abs_ps(y));
+		}
+	}
+
+	return true_peak_c(x, i, frames, hmax_ps(peak));
+}
+
+#ifdef METER_X64
+static TARGET_AVX2 float true_peak_avx2(const float *x, size_t frames)
+{
+	const __m256 sign = _mm256_set1_ps(-0.0f);
+	__m256 c[4][4];
+	__m256 peak = _mm256_setzero_ps();
+	size_t i = 0;
+
+	for (size_t p = 0; p < 4; p++)
+		for (size_t t = 0; t < 4; t++)
+			c[p][t] = _mm256_set1_ps(phases[p][t]);
+
+	for (; i + 8 <= frames; i += 8) {
+		const __m256 x0 = _mm256_loadu_ps(x + i - 3);
+		const __m256 x1 = _mm256_loadu_ps(x + i - 2);
+		const __m256 x2 = _mm256_loadu_ps(x + i - 1);
+		const __m256 x3 = _mm256_loadu_ps(x + i);
+
+		peak = _mm256_max_ps(peak, _mm256_andnot_ps(sign, x3));
+
+		for (size_t p = 0; p < 4; p++) {
+			__m256 y = _mm256_mul_ps(c[p][0], x0);
+			y = _mm256_add_ps(y, _mm256_mul_ps(c[p][1], x1));
+			y = _mm256_add_ps(y, _mm256_mul_ps(c[p][2], x2));
+			y = _mm256_add_ps(y, _mm256_mul_ps(c[p][3], x3));
+			peak = _mm256_max_ps(peak, _mm256_andnot_ps(sign, y));
+		}
+	}
+
+	const __m128 half = _mm_max_ps(_mm256_castps256_ps128(peak),
+				       _mm256_extractf128_ps(peak, 1));
+	return true_peak_c(x, i, frames, hmax_ps(half));
+}
+#endif
+
+static bool detect_avx2(void)
+{
+#if defined(METER_X64) && defined(_MSC_VER)
+	int regs[4];
+
+	__cpuid(regs, 1);
+	const bool osxsave = (regs[2] & (1 << 27)) != 0;
+	const bool avx = (regs[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+		return false;
+
+	__cpuidex(regs, 7, 0);
+	return (regs[1] & (1 << 5)) != 0;
+
+#elif defined(METER_X64)
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2");
+
+#else
+	return false;
+#endif
+}
+
+/* -1 until checked, then 0 or 1 */
+static volatile long cpu_avx2 = -1;
+static volatile bool avx2_allowed = true;
+
+static bool use_avx2(void)
+{
+	long avx2 = os_atomic_load_long(&cpu_avx2);
+
+	if (avx2 < 0) {
+		avx2 = detect_avx2() ? 1 : 0;
+		if (os_atomic_set_long(&cpu_avx2, avx2) < 0 && avx2)
+			blog(LOG_INFO, "audio-meter: Using AVX2 kernel");
+	}
+
+	return avx2 && os_atomic_load_bool(&avx2_allowed);
+}
+
+bool audio_meter_set_avx2(bool allow)
+{
+	os_atomic_set_bool(&avx2_allowed, allow);
+	return use_avx2();
+}
+
+float audio_meter_true_peak(const float *samples, size_t frames)
+{
+#ifdef METER_X64
+	if (use_avx2())
+		return true_peak_avx2(samples, frames);
+#endif
+	return true_peak_sse2(samples, frames);
+}
+
+float audio_meter_sample_peak(const float *samples, size_t frames)
+{
+	__m128 peak = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4)
+		peak = _mm_max_ps(peak, abs_ps(_mm_loadu_ps(samples + i)));
+
+	float result = hmax_ps(peak);
+	for (; i < frames; i++)
+		result = fmaxf(result, fabsf(samples[i]));
+	return result;
+}
+
+float audio_meter_sum_squares(const float *samples, size_t frames)
+{
+	__m128 sum = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		const __m128 x = _mm_loadu_ps(samples + i);
+		sum = _mm_add_ps(sum, _mm_mul_ps(x, x));
+	}
+
+	float vals[4];
+	_mm_storeu_ps(vals, sum);
+
+	float result = (vals[0] + vals[1]) + (vals[2] + vals[3]);
+	for (; i < frames; i++)
+		result += samples[i] * samples[i];
+	return result;
+}
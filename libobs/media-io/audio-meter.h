@@ -0,0 +1,56 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Level measurements for audio meters.
+ *
+ * The true peak estimate interpolates four points between each pair of
+ * samples with a four tap sinc filter, one polyphase branch per point, and
+ * uses an AVX2 kernel when the CPU supports it.
+ */
+
+/** Largest absolute sample value */
+EXPORT float audio_meter_sample_peak(const float *samples, size_t frames);
+
+/** Sum of the squared samples */
+EXPORT float audio_meter_sum_squares(const float *samples, size_t frames);
+
+/**
+ * Largest absolute value of the samples and of the interpolated signal.
+ * The three values before samples[0] must be readable and hold the end of
+ * the previous block, the interpolation runs up to the second to last
+ * sample.
+ */
+EXPORT float audio_meter_true_peak(const float *samples, size_t frames);
+
+/**
+ * Allows or disallows the AVX2 kernel, for testing.  Returns true if it is
+ * used afterwards.
+ */
+EXPORT bool audio_meter_set_avx2(bool allow);
+
+#ifdef __cplusplus
+}
+#endif
@@ -34,6 +34,7 @@ struct audio_resampler {
 	uint32_t output_ch;
 	uint32_t output_freq;
 	uint32_t output_planes;
+	int compensation;
 #if LIBSWRESAMPLE_VERSION_INT < AV_VERSION_INT(4, 5, 100)
 	uint64_t input_layout;
 	uint64_t output_layout;
@@ -206,6 +207,9 @@ bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
 					    (int64_t)rs->input_freq,
 					    AV_ROUND_UP);
 
+	/* a pending compensation can stretch the output past the estimate */
+	estimated += rs->compensation;
+
 	*ts_offset = (uint64_t)swr_get_delay(context, 1000000000);
 
 	/* resize the buffer if bigger */
@@ -233,3 +237,21 @@ bool audio_resampler_resample(audio_resampler_t *rs, uint8_t *output[],
 	*out_frames = (uint32_t)ret;
 	return true;
 }
+
+bool audio_resampler_set_compensation(audio_resampler_t *rs, int sample_delta,
+				      int distance)
+{
+	int errcode;
+
+	if (!rs)
+		return false;
+
+	errcode = swr_set_compensation(rs->context, sample_delta, distance);
+	if (errcode < 0) {
+		blog(LOG_ERROR, "swr_set_compensation failed: %d", errcode);
+		return false;
+	}
+
+	rs->compensation = abs(sample_delta);
+	return true;
+}
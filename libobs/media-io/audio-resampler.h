@@ -44,6 +44,16 @@ EXPORT bool audio_resampler_resample(audio_resampler_t *resampler,
 				     const uint8_t *const input[],
 				     uint32_t in_frames);
 
+/**
+ * Stretches or squeezes the output by sample_delta frames, spread over the
+ * next distance output frames, to follow a clock that drifts against the
+ * input.  The first call switches the resampler to full resampling even at
+ * equal rates, which resets it, so call it with (0, 0) before the first
+ * resample if compensation will be used later.
+ */
+EXPORT bool audio_resampler_set_compensation(audio_resampler_t *resampler,
+					     int sample_delta, int distance);
+
 #ifdef __cplusplus
 }
 #endif
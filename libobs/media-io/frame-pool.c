@@ -0,0 +1,291 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include "frame-pool.h"
+
+#include "../util/bmem.h"
+#include "../util/platform.h"
+#include "../util/threading.h"
+#include "../util/uthash.h"
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+/* Smaller buffers are cheap to allocate and are not pooled */
+#define MIN_POOLED_SHIFT 16
+#define MAX_POOLED_SHIFT 30
+#define CLASSES_PER_OCTAVE 4
+
+/* rounding up can carry into the next power of two, hence the extra
+ * octave */
+#define NUM_CLASSES \
+	((MAX_POOLED_SHIFT - MIN_POOLED_SHIFT + 2) * CLASSES_PER_OCTAVE)
+
+#define DEFAULT_MAX_CACHED ((size_t)256 * 1024 * 1024)
+#define HUGE_PAGE_SIZE ((uintptr_t)2 * 1024 * 1024)
+
+struct pool_buffer {
+	void *ptr;
+	size_t size;
+	int size_class;
+	uint64_t released;
+
+	struct pool_buffer *next;
+	UT_hash_handle hh;
+};
+
+struct frame_pool {
+	pthread_mutex_t mutex;
+	struct pool_buffer *in_use;
+	struct pool_buffer *free_lists[NUM_CLASSES];
+	size_t max_cached;
+	struct frame_pool_stats stats;
+};
+
+static struct frame_pool pool = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+	.max_cached = DEFAULT_MAX_CACHED,
+};
+
+static int floor_log2(size_t val)
+{
+	int shift = 0;
+	while (val >>= 1)
+		shift++;
+	return shift;
+}
+
+static int get_size_class(size_t size, size_t *class_size)
+{
+	if (size < ((size_t)1 << MIN_POOLED_SHIFT))
+		return -1;
+
+	int shift = floor_log2(size);
+	if (shift > MAX_POOLED_SHIFT)
+		return -1;
+
+	const size_t step = (size_t)1 << (shift - 2);
+	const size_t rounded = (size + step - 1) & ~(step - 1);
+
+	shift = floor_log2(rounded);
+	*class_size = rounded;
+	return (shift - MIN_POOLED_SHIFT) * CLASSES_PER_OCTAVE +
+	       (int)((rounded >> (shift - 2)) & (CLASSES_PER_OCTAVE - 1));
+}
+
+/* Transparent huge pages can be requested for part of a regular allocation,
+ * so the buffers can stay plain bmalloc allocations.  Windows and macOS only
+ * offer huge pages through dedicated allocators, so they are skipped. */
+static void advise_huge_pages(void *ptr, size_t size)
+{
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+	const uintptr_t mask = ~(HUGE_PAGE_SIZE - 1);
+	uintptr_t start = ((uintptr_t)ptr + HUGE_PAGE_SIZE - 1) & mask;
+	uintptr_t end = ((uintptr_t)ptr + size) & mask;
+
+	if (end > start)
+		madvise((void *)start, end - start, MADV_HUGEPAGE);
+#else
+	UNUSED_PARAMETER(ptr);
+	UNUSED_PARAMETER(size);
+#endif
+}
+
+static inline void mark_in_use(struct pool_buffer *buf)
+{
+	struct frame_pool_stats *stats = &pool.stats;
+	size_t resident;
+
+	HASH_ADD_PTR(pool.in_use, ptr, buf);
+	stats->in_use_bytes += buf->size;
+
+	resident = stats->in_use_bytes + stats->cached_bytes;
+	if (resident > stats->peak_resident_bytes)
+		stats->peak_resident_bytes = resident;
+}
+
+static inline void destroy_buffer(struct pool_buffer *buf)
+{
+	bfree(buf->ptr);
+	bfree(buf);
+}
+
+void *frame_pool_alloc(size_t size)
+{
+	struct pool_buffer *buf;
+	size_t class_size;
+	int size_class = get_size_class(size, &class_size);
+
+	if (size_class < 0)
+		return bmalloc(size);
+
+	pthread_mutex_lock(&pool.mutex);
+	pool.stats.allocs++;
+
+	buf = pool.free_lists[size_class];
+	if (buf) {
+		pool.free_lists[size_class] = buf->next;
+		pool.stats.cached_bytes -= buf->size;
+		pool.stats.hits++;
+		mark_in_use(buf);
+	}
+	pthread_mutex_unlock(&pool.mutex);
+
+	if (buf)
+		return buf->ptr;
+
+	buf = bzalloc(sizeof(*buf));
+	buf->ptr = bmalloc(class_size);
+	buf->size = class_size;
+	buf->size_class = size_class;
+	advise_huge_pages(buf->ptr, class_size);
+
+	pthread_mutex_lock(&pool.mutex);
+	mark_in_use(buf);
+	pthread_mutex_unlock(&pool.mutex);
+
+	return buf->ptr;
+}
+
+void frame_pool_free(void *ptr)
+{
+	struct pool_buffer *buf;
+	bool cached = false;
+
+	if (!ptr)
+		return;
+
+	pthread_mutex_lock(&pool.mutex);
+
+	HASH_FIND_PTR(pool.in_use, &ptr, buf);
+	if (buf) {
+		HASH_DEL(pool.in_use, buf);
+		pool.stats.in_use_bytes -= buf->size;
+
+		if (pool.stats.cached_bytes + buf->size <= pool.max_cached) {
+			buf->released = os_gettime_ns();
+			buf->next = pool.free_lists[buf->size_class];
+			pool.free_lists[buf->size_class] = buf;
+			pool.stats.cached_bytes += buf->size;
+			cached = true;
+		} else {
+			pool.stats.evictions++;
+		}
+	}
+
+	pthread_mutex_unlock(&pool.mutex);
+
+	if (cached)
+		return;
+	if (buf)
+		destroy_buffer(buf);
+	else
+		bfree(ptr); /* too small to be pooled */
+}
+
+/* unlinks buffers from the free lists while holding the mutex, so they can
+ * be freed after it has been released */
+static struct pool_buffer *evict_idle(uint64_t now, uint64_t max_idle_ns)
+{
+	struct pool_buffer *evicted = NULL;
+
+	for (size_t i = 0; i < NUM_CLASSES; i++) {
+		struct pool_buffer **p_next = &pool.free_lists[i];
+
+		while (*p_next) {
+			struct pool_buffer *buf = *p_next;
+
+			if (now - buf->released < max_idle_ns) {
+				p_next = &buf->next;
+				continue;
+			}
+
+			*p_next = buf->next;
+			buf->next = evicted;
+			evicted = buf;
+
+			pool.stats.cached_bytes -= buf->size;
+			pool.stats.evictions++;
+		}
+	}
+
+	return evicted;
+}
+
+static struct pool_buffer *evict_over_limit(void)
+{
+	struct pool_buffer *evicted = NULL;
+
+	/* largest buffers first, they are the least likely to be reused */
+	for (size_t i = NUM_CLASSES; i > 0; i--) {
+		struct pool_buffer **list = &pool.free_lists[i - 1];
+
+		while (*list && pool.stats.cached_bytes > pool.max_cached) {
+			struct pool_buffer *buf = *list;
+
+			*list = buf->next;
+			buf->next = evicted;
+			evicted = buf;
+
+			pool.stats.cached_bytes -= buf->size;
+			pool.stats.evictions++;
+		}
+	}
+
+	return evicted;
+}
+
+static void destroy_list(struct pool_buffer *buf)
+{
+	while (buf) {
+		struct pool_buffer *next = buf->next;
+		destroy_buffer(buf);
+		buf = next;
+	}
+}
+
+void frame_pool_trim(uint64_t max_idle_ns)
+{
+	uint64_t now = os_gettime_ns();
+	struct pool_buffer *evicted;
+
+	pthread_mutex_lock(&pool.mutex);
+	evicted = evict_idle(now, max_idle_ns);
+	pthread_mutex_unlock(&pool.mutex);
+
+	destroy_list(evicted);
+}
+
+void frame_pool_set_max_cached(size_t bytes)
+{
+	struct pool_buffer *evicted;
+
+	pthread_mutex_lock(&pool.mutex);
+	pool.max_cached = bytes;
+	evicted = evict_over_limit();
+	pthread_mutex_unlock(&pool.mutex);
+
+	destroy_list(evicted);
+}
+
+void frame_pool_get_stats(struct frame_pool_stats *stats)
+{
+	pthread_mutex_lock(&pool.mutex);
+	*stats = pool.stats;
+	pthread_mutex_unlock(&pool.mutex);
+}
@@ -0,0 +1,61 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Process-wide pool for video frame buffers.  Sizes are rounded up to one of
+ * four size classes per power of two, and freed buffers are kept around for
+ * reuse until they have been idle for a while, so sources that recreate
+ * their frames (format changes, looping media, frame caches) stop hitting
+ * the system allocator.
+ *
+ * Buffers from frame_pool_alloc must be released with frame_pool_free, and
+ * only buffers from frame_pool_alloc may be passed to it.  They must never be
+ * released with bfree, so pooled frames are kept inside libobs and the
+ * public frame helpers keep using bmalloc/bfree.
+ */
+
+struct frame_pool_stats {
+	uint64_t allocs;
+	uint64_t hits;
+	uint64_t evictions;
+	size_t cached_bytes;
+	size_t in_use_bytes;
+	size_t peak_resident_bytes;
+};
+
+EXPORT void *frame_pool_alloc(size_t size);
+EXPORT void frame_pool_free(void *ptr);
+
+/** Releases cached buffers that have been idle for longer than max_idle_ns */
+EXPORT void frame_pool_trim(uint64_t max_idle_ns);
+
+/** Sets how many bytes of idle buffers the pool may keep */
+EXPORT void frame_pool_set_max_cached(size_t bytes);
+
+EXPORT void frame_pool_get_stats(struct frame_pool_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
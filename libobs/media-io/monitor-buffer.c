@@ -0,0 +1,243 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "monitor-buffer.h"
+#include "../util/bmem.h"
+#include "../util/spsc-ring.h"
+#include "../util/threading.h"
+
+/* the fill level is smoothed over roughly 20 packets */
+#define LEVEL_SMOOTHING 0.05
+
+/* gains of the rate controller.  With these the level settles within a few
+ * seconds without overshooting much, and clock drift is absorbed by the
+ * integral term. */
+#define CONTROL_P 0.2
+#define CONTROL_I 0.02
+
+/* a 0.1% rate change shifts the pitch by less than two cents */
+#define MAX_CORRECTION 0.001
+
+/* errors beyond this (in seconds) come from stalls rather than drift, and
+ * are only integrated up to it */
+#define MAX_INTEGRATED_ERROR 0.005
+
+#define MIN_RING_MS 500
+
+struct monitor_buffer {
+	struct spsc_ring ring;
+	size_t frame_size;
+	size_t max_frames;
+	uint32_t sample_rate;
+	uint8_t silence;
+	volatile long target_frames;
+	volatile bool playing;
+
+	/* producer */
+	bool level_valid;
+	long last_skips;
+	double level;
+	double integral;
+	double residue;
+	uint64_t pushed_frames;
+
+	/* consumer */
+	uint64_t played_frames;
+
+	volatile long underruns;
+	volatile long overflows;
+	volatile long skips;
+	volatile long latency_frames;
+	volatile long correction_ppb;
+};
+
+struct monitor_buffer *monitor_buffer_create(uint32_t sample_rate,
+					     size_t frame_size,
+					     uint8_t silence,
+					     uint32_t target_ms)
+{
+	struct monitor_buffer *mb = bzalloc(sizeof(*mb));
+	size_t frames = (size_t)sample_rate * MIN_RING_MS / 1000;
+	size_t target = (size_t)sample_rate * target_ms / 1000;
+
+	if (frames < target * 4)
+		frames = target * 4;
+
+	mb->sample_rate = sample_rate;
+	mb->frame_size = frame_size;
+	mb->silence = silence;
+
+	spsc_ring_init(&mb->ring, frames * frame_size);
+	mb->max_frames = mb->ring.size / frame_size;
+
+	monitor_buffer_set_target(mb, target_ms);
+	return mb;
+}
+
+void monitor_buffer_destroy(struct monitor_buffer *mb)
+{
+	if (!mb)
+		return;
+
+	spsc_ring_free(&mb->ring);
+	bfree(mb);
+}
+
+void monitor_buffer_set_target(struct monitor_buffer *mb, uint32_t target_ms)
+{
+	size_t target = (size_t)mb->sample_rate * target_ms / 1000;
+
+	/* leave room for the consumer to fall behind before dropping */
+	if (target > mb->max_frames / 2)
+		target = mb->max_frames / 2;
+
+	os_atomic_set_long(&mb->target_frames, (long)target);
+}
+
+static inline size_t buffered_frames(const struct monitor_buffer *mb)
+{
+	return spsc_ring_readable(&mb->ring) / mb->frame_size;
+}
+
+int monitor_buffer_compensation(struct monitor_buffer *mb,
+				uint32_t out_frames)
+{
+	const double target = (double)os_atomic_load_long(&mb->target_frames);
+	const double rate = (double)mb->sample_rate;
+	double sample, error, integrated, correction, delta;
+	int frames;
+
+	/* while the consumer is prebuffering the level says nothing about
+	 * the clocks, so start over once it plays again */
+	if (!os_atomic_load_bool(&mb->playing)) {
+		mb->level_valid = false;
+		return 0;
+	}
+
+	/* the same goes for the level from before the consumer skipped */
+	if (mb->last_skips != os_atomic_load_long(&mb->skips)) {
+		mb->last_skips = os_atomic_load_long(&mb->skips);
+		mb->level_valid = false;
+	}
+
+	/* halfway through the packet that is about to be pushed */
+	sample = (double)buffered_frames(mb) + (double)out_frames * 0.5;
+
+	if (!mb->level_valid) {
+		mb->level = sample;
+		mb->level_valid = true;
+	}
+	mb->level += (sample - mb->level) * LEVEL_SMOOTHING;
+	os_atomic_set_long(&mb->latency_frames, (long)mb->level);
+
+	error = (mb->level - target) / rate;
+	integrated = error;
+	if (integrated > MAX_INTEGRATED_ERROR)
+		integrated = MAX_INTEGRATED_ERROR;
+	else if (integrated < -MAX_INTEGRATED_ERROR)
+		integrated = -MAX_INTEGRATED_ERROR;
+	mb->integral += integrated * (double)out_frames / rate;
+
+	/* anti-windup: the integral alone never exceeds the limit */
+	if (mb->integral * CONTROL_I > MAX_CORRECTION)
+		mb->integral = MAX_CORRECTION / CONTROL_I;
+	else if (mb->integral * CONTROL_I < -MAX_CORRECTION)
+		mb->integral = -MAX_CORRECTION / CONTROL_I;
+
+	correction = -(error * CONTROL_P + mb->integral * CONTROL_I);
+	if (correction > MAX_CORRECTION)
+		correction = MAX_CORRECTION;
+	else if (correction < -MAX_CORRECTION)
+		correction = -MAX_CORRECTION;
+
+	os_atomic_set_long(&mb->correction_ppb, (long)(correction * 1e9));
+
+	delta = correction * (double)out_frames + mb->residue;
+	frames = (int)lround(delta);
+	mb->residue = delta - (double)frames;
+	return frames;
+}
+
+bool monitor_buffer_push(struct monitor_buffer *mb, const void *data,
+			 uint32_t frames)
+{
+	if (!spsc_ring_push(&mb->ring, data, frames * mb->frame_size)) {
+		os_atomic_inc_long(&mb->overflows);
+		return false;
+	}
+
+	mb->pushed_frames += frames;
+	return true;
+}
+
+uint32_t monitor_buffer_read(struct monitor_buffer *mb, void *out,
+			     uint32_t frames)
+{
+	const size_t target = (size_t)os_atomic_load_long(&mb->target_frames);
+	size_t avail = buffered_frames(mb);
+	size_t count;
+
+	if (!os_atomic_load_bool(&mb->playing)) {
+		if (avail < target || !avail) {
+			memset(out, mb->silence, frames * mb->frame_size);
+			return 0;
+		}
+		os_atomic_set_bool(&mb->playing, true);
+	}
+
+	/* the producer's clock correction is limited, so this only happens
+	 * after this side stalled */
+	if (avail > target * 2 + frames) {
+		spsc_ring_pop(&mb->ring, NULL,
+			      (avail - target) * mb->frame_size);
+		os_atomic_inc_long(&mb->skips);
+		avail = target;
+	}
+
+	count = avail < frames ? avail : frames;
+	spsc_ring_pop(&mb->ring, out, count * mb->frame_size);
+
+	if (count < frames) {
+		memset((uint8_t *)out + count * mb->frame_size, mb->silence,
+		       (frames - count) * mb->frame_size);
+		os_atomic_inc_long(&mb->underruns);
+		os_atomic_set_bool(&mb->playing, false);
+	}
+
+	mb->played_frames += count;
+	return (uint32_t)count;
+}
+
+void monitor_buffer_get_stats(struct monitor_buffer *mb,
+			      struct monitor_buffer_stats *stats)
+{
+	const double rate = (double)mb->sample_rate;
+
+	stats->pushed_frames = mb->pushed_frames;
+	stats->played_frames = mb->played_frames;
+	stats->underruns = os_atomic_load_long(&mb->underruns);
+	stats->overflows = os_atomic_load_long(&mb->overflows);
+	stats->skips = os_atomic_load_long(&mb->skips);
+	stats->latency_ms =
+		(double)os_atomic_load_long(&mb->latency_frames) * 1000.0 /
+		rate;
+	stats->correction_ppm =
+		(double)os_atomic_load_long(&mb->correction_ppb) / 1000.0;
+}
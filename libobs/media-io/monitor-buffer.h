@@ -0,0 +1,99 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Buffer between a source's audio callback and an audio monitoring device.
+ *
+ *   The source pushes converted frames, the device pulls them from its own
+ * thread, and neither side ever waits on the other: frames that don't fit
+ * are dropped, and missing frames are played as silence.
+ *
+ *   The two sides run on different clocks, so the buffer slowly fills up or
+ * runs dry.  The producer asks monitor_buffer_compensation how many frames
+ * to add or remove from the next packet (usually by passing the value to
+ * audio_resampler_set_compensation), which keeps the average fill level at
+ * the target latency.  If the level still gets too far from it, because the
+ * device stalled or the source stopped, the consumer skips frames or
+ * prebuffers up to the target again.
+ */
+
+struct monitor_buffer;
+
+struct monitor_buffer_stats {
+	uint64_t pushed_frames;
+	uint64_t played_frames;
+
+	/** reads that ran out of frames and were padded with silence */
+	long underruns;
+	/** packets that were dropped because the buffer was full */
+	long overflows;
+	/** times the consumer skipped frames to get back to the target */
+	long skips;
+
+	/** average amount of buffered audio */
+	double latency_ms;
+	/** current rate correction, positive if frames are being added */
+	double correction_ppm;
+};
+
+/**
+ * Creates a buffer for frames of frame_size bytes.  silence is the byte
+ * value that silent samples consist of (0, or 0x80 for unsigned 8 bit).
+ */
+EXPORT struct monitor_buffer *monitor_buffer_create(uint32_t sample_rate,
+						    size_t frame_size,
+						    uint8_t silence,
+						    uint32_t target_ms);
+EXPORT void monitor_buffer_destroy(struct monitor_buffer *mb);
+
+/** Can be called from any thread */
+EXPORT void monitor_buffer_set_target(struct monitor_buffer *mb,
+				      uint32_t target_ms);
+
+/**
+ * Producer: the number of frames to add (or remove, if negative) while
+ * producing the next out_frames frames.
+ */
+EXPORT int monitor_buffer_compensation(struct monitor_buffer *mb,
+				       uint32_t out_frames);
+
+/** Producer: returns false if the frames were dropped */
+EXPORT bool monitor_buffer_push(struct monitor_buffer *mb, const void *data,
+				uint32_t frames);
+
+/**
+ * Consumer: fills out with exactly frames frames and returns how many of
+ * them were audio rather than silence.
+ */
+EXPORT uint32_t monitor_buffer_read(struct monitor_buffer *mb, void *out,
+				    uint32_t frames);
+
+/** Can be called from any thread */
+EXPORT void monitor_buffer_get_stats(struct monitor_buffer *mb,
+				     struct monitor_buffer_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,976 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <string.h>
+
+#include "video-convert.h"
+
+#include "../util/base.h"
+#include "../util/threading.h"
+
+/* AVX2 and AVX-512 kernels are compiled with per-function target attributes
+ * so the rest of libobs does not need to be built for those instruction
+ * sets, and are only called after checking the CPU at runtime.  Elsewhere
+ * the SSE2 kernels go through simde. */
+#if defined(__x86_64__) || (defined(_M_X64) && !defined(_M_ARM64EC))
+#define CONVERT_X64
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#else
+#include "../util/sse-intrin.h"
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#define TARGET_AVX512 __attribute__((target("avx512f,avx512bw")))
+#else
+#define TARGET_AVX2
+#define TARGET_AVX512
+#endif
+
+/* P010 stores its 10 bit samples in the high bits, I010 in the low bits */
+#define P010_SHIFT 6
+
+struct convert_kernels {
+	void (*uv_split)(const uint8_t *uv, uint8_t *u, uint8_t *v,
+			 uint32_t count);
+	void (*uv_merge)(const uint8_t *u, const uint8_t *v, uint8_t *uv,
+			 uint32_t count);
+	void (*uv_split_p010)(const uint16_t *uv, uint16_t *u, uint16_t *v,
+			      uint32_t count);
+	void (*uv_merge_p010)(const uint16_t *u, const uint16_t *v,
+			      uint16_t *uv, uint32_t count);
+	void (*y_from_p010)(const uint16_t *src, uint16_t *dst,
+			    uint32_t count);
+	void (*y_to_p010)(const uint16_t *src, uint16_t *dst, uint32_t count);
+	void (*swap_rb)(const uint8_t *src, uint8_t *dst, uint32_t count);
+	void (*packed_split)(const uint8_t *src, uint8_t *y, uint8_t *u,
+			     uint8_t *v, uint32_t width, bool luma_first);
+};
+
+/* ------------------------------------------------------------------------- */
+/* Scalar kernels, also used for the tails of the SIMD kernels               */
+
+static void uv_split_c(const uint8_t *uv, uint8_t *u, uint8_t *v,
+		       uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		u[i] = uv[i * 2];
+		v[i] = uv[i * 2 + 1];
+	}
+}
+
+static void uv_merge_c(const uint8_t *u, const uint8_t *v, uint8_t *uv,
+		       uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		uv[i * 2] = u[i];
+		uv[i * 2 + 1] = v[i];
+	}
+}
+
+static void uv_split_p010_c(const uint16_t *uv, uint16_t *u, uint16_t *v,
+			    uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		u[i] = uv[i * 2] >> P010_SHIFT;
+		v[i] = uv[i * 2 + 1] >> P010_SHIFT;
+	}
+}
+
+static void uv_merge_p010_c(const uint16_t *u, const uint16_t *v,
+			    uint16_t *uv, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		uv[i * 2] = (uint16_t)(u[i] << P010_SHIFT);
+		uv[i * 2 + 1] = (uint16_t)(v[i] << P010_SHIFT);
+	}
+}
+
+static void y_from_p010_c(const uint16_t *src, uint16_t *dst, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+		dst[i] = src[i] >> P010_SHIFT;
+}
+
+static void y_to_p010_c(const uint16_t *src, uint16_t *dst, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+		dst[i] = (uint16_t)(src[i] << P010_SHIFT);
+}
+
+static void swap_rb_c(const uint8_t *src, uint8_t *dst, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		const uint8_t r = src[i * 4];
+
+		dst[i * 4] = src[i * 4 + 2];
+		dst[i * 4 + 1] = src[i * 4 + 1];
+		dst[i * 4 + 2] = r;
+		dst[i * 4 + 3] = src[i * 4 + 3];
+	}
+}
+
+/* Packed 4:2:2 rows always contain an even number of pixels, so the chroma
+ * of the last pair can be read even if width is odd. */
+static void packed_split_c(const uint8_t *src, uint8_t *y, uint8_t *u,
+			   uint8_t *v, uint32_t width, bool luma_first)
+{
+	const uint32_t y_offset = luma_first ? 0 : 1;
+	const uint32_t c_offset = luma_first ? 1 : 0;
+
+	for (uint32_t x = 0; x < width; x++) {
+		y[x] = src[x * 2 + y_offset];
+
+		if ((x & 1) == 0) {
+			u[x / 2] = src[x * 2 + c_offset];
+			v[x / 2] = src[x * 2 + c_offset + 2];
+		}
+	}
+}
+
+static const struct convert_kernels kernels_c = {
+	.uv_split = uv_split_c,
+	.uv_merge = uv_merge_c,
+	.uv_split_p010 = uv_split_p010_c,
+	.uv_merge_p010 = uv_merge_p010_c,
+	.y_from_p010 = y_from_p010_c,
+	.y_to_p010 = y_to_p010_c,
+	.swap_rb = swap_rb_c,
+	.packed_split = packed_split_c,
+};
+
+/* ------------------------------------------------------------------------- */
+/* SSE2 kernels (through simde on other architectures)                       */
+
+static void uv_split_sse2(const uint8_t *uv, uint8_t *u, uint8_t *v,
+			  uint32_t count)
+{
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	uint32_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(uv + i * 2));
+		__m128i b = _mm_loadu_si128((const __m128i *)(uv + i * 2 + 16));
+
+		__m128i u_val = _mm_packus_epi16(_mm_and_si128(a, mask),
+						 _mm_and_si128(b, mask));
+		__m128i v_val = _mm_packus_epi16(_mm_srli_epi16(a, 8),
+						 _mm_srli_epi16(b, 8));
+
+		_mm_storeu_si128((__m128i *)(u + i), u_val);
+		_mm_storeu_si128((__m128i *)(v + i), v_val);
+	}
+
+	uv_split_c(uv + i * 2, u + i, v + i, count - i);
+}
+
+static void uv_merge_sse2(const uint8_t *u, const uint8_t *v, uint8_t *uv,
+			  uint32_t count)
+{
+	uint32_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m128i u_val = _mm_loadu_si128((const __m128i *)(u + i));
+		__m128i v_val = _mm_loadu_si128((const __m128i *)(v + i));
+
+		_mm_storeu_si128((__m128i *)(uv + i * 2),
+				 _mm_unpacklo_epi8(u_val, v_val));
+		_mm_storeu_si128((__m128i *)(uv + i * 2 + 16),
+				 _mm_unpackhi_epi8(u_val, v_val));
+	}
+
+	uv_merge_c(u + i, v + i, uv + i * 2, count - i);
+}
+
+/* Shifted samples fit in 10 bits, so the signed saturating pack is enough
+ * and SSE4.1's packus_epi32 is not needed. */
+static void uv_split_p010_sse2(const uint16_t *uv, uint16_t *u, uint16_t *v,
+			       uint32_t count)
+{
+	const __m128i mask = _mm_set1_epi32(0xFFFF);
+	uint32_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(uv + i * 2));
+		__m128i b = _mm_loadu_si128((const __m128i *)(uv + i * 2 + 8));
+
+		__m128i u_val = _mm_packs_epi32(
+			_mm_srli_epi32(_mm_and_si128(a, mask), P010_SHIFT),
+			_mm_srli_epi32(_mm_and_si128(b, mask), P010_SHIFT));
+		__m128i v_val =
+			_mm_packs_epi32(_mm_srli_epi32(a, 16 + P010_SHIFT),
+					_mm_srli_epi32(b, 16 + P010_SHIFT));
+
+		_mm_storeu_si128((__m128i *)(u + i), u_val);
+		_mm_storeu_si128((__m128i *)(v + i), v_val);
+	}
+
+	uv_split_p010_c(uv + i * 2, u + i, v + i, count - i);
+}
+
+static void uv_merge_p010_sse2(const uint16_t *u, const uint16_t *v,
+			       uint16_t *uv, uint32_t count)
+{
+	uint32_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i u_val = _mm_loadu_si128((const __m128i *)(u + i));
+		__m128i v_val = _mm_loadu_si128((const __m128i *)(v + i));
+
+		u_val = _mm_slli_epi16(u_val, P010_SHIFT);
+		v_val = _mm_slli_epi16(v_val, P010_SHIFT);
+
+		_mm_storeu_si128((__m128i *)(uv + i * 2),
+				 _mm_unpacklo_epi16(u_val, v_val));
+		_mm_storeu_si128((__m128i *)(uv + i * 2 + 8),
+				 _mm_unpackhi_epi16(u_val, v_val));
+	}
+
+	uv_merge_p010_c(u + i, v + i, uv + i * 2, count - i);
+}
+
+static void y_from_p010_sse2(const uint16_t *src, uint16_t *dst,
+			     uint32_t count)
+{
+	uint32_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i val = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_srli_epi16(val, P010_SHIFT));
+	}
+
+	y_from_p010_c(src + i, dst + i, count - i);
+}
+
+static void y_to_p010_sse2(const uint16_t *src, uint16_t *dst, uint32_t count)
+{
+	uint32_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m128i val = _mm_loadu_si128((const __m128i *)(src + i));
+		_mm_storeu_si128((__m128i *)(dst + i),
+				 _mm_slli_epi16(val, P010_SHIFT));
+	}
+
+	y_to_p010_c(src + i, dst + i, count - i);
+}
+
+static void swap_rb_sse2(const uint8_t *src, uint8_t *dst, uint32_t count)
+{
+	const __m128i ga_mask = _mm_set1_epi32((int)0xFF00FF00);
+	uint32_t i = 0;
+
+	for (; i + 4 <= count; i += 4) {
+		__m128i val = _mm_loadu_si128((const __m128i *)(src + i * 4));
+		__m128i ga = _mm_and_si128(val, ga_mask);
+		__m128i rb = _mm_andnot_si128(ga_mask, val);
+
+		rb = _mm_or_si128(_mm_slli_epi32(rb, 16),
+				  _mm_srli_epi32(rb, 16));
+		_mm_storeu_si128((__m128i *)(dst + i * 4),
+				 _mm_or_si128(ga, rb));
+	}
+
+	swap_rb_c(src + i * 4, dst + i * 4, count - i);
+}
+
+static void packed_split_sse2(const uint8_t *src, uint8_t *y, uint8_t *u,
+			      uint8_t *v, uint32_t width, bool luma_first)
+{
+	const __m128i mask = _mm_set1_epi16(0x00FF);
+	uint32_t x = 0;
+
+	for (; x + 16 <= width; x += 16) {
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + x * 2));
+		__m128i b =
+			_mm_loadu_si128((const __m128i *)(src + x * 2 + 16));
+		__m128i a_lo = _mm_and_si128(a, mask);
+		__m128i b_lo = _mm_and_si128(b, mask);
+		__m128i a_hi = _mm_srli_epi16(a, 8);
+		__m128i b_hi = _mm_srli_epi16(b, 8);
+		__m128i y_val, c_val;
+
+		if (luma_first) {
+			y_val = _mm_packus_epi16(a_lo, b_lo);
+			c_val = _mm_packus_epi16(a_hi, b_hi);
+		} else {
+			y_val = _mm_packus_epi16(a_hi, b_hi);
+			c_val = _mm_packus_epi16(a_lo, b_lo);
+		}
+
+		/* c_val is UVUV..., split it into 8 U values followed by
+		 * 8 V values */
+		c_val = _mm_packus_epi16(_mm_and_si128(c_val, mask),
+					 _mm_srli_epi16(c_val, 8));
+
+		_mm_storeu_si128((__m128i *)(y + x), y_val);
+		_mm_storel_epi64((__m128i *)(u + x / 2), c_val);
+		_mm_storel_epi64((__m128i *)(v + x / 2),
+				 _mm_srli_si128(c_val, 8));
+	}
+
+	packed_split_c(src + x * 2, y + x, u + x / 2, v + x / 2, width - x,
+		       luma_first);
+}
+
+static const struct convert_kernels kernels_sse2 = {
+	.uv_split = uv_split_sse2,
+	.uv_merge = uv_merge_sse2,
+	.uv_split_p010 = uv_split_p010_sse2,
+	.uv_merge_p010 = uv_merge_p010_sse2,
+	.y_from_p010 = y_from_p010_sse2,
+	.y_to_p010 = y_to_p010_sse2,
+	.swap_rb = swap_rb_sse2,
+	.packed_split = packed_split_sse2,
+};
+
+#ifdef CONVERT_X64
+
+/* ------------------------------------------------------------------------- */
+/* AVX2 kernels                                                              */
+
+/* 256 bit packs and unpacks work within each 128 bit lane, so the results
+ * have to be put back in order with a cross-lane permute */
+#define PACK_ORDER_256 _MM_SHUFFLE(3, 1, 2, 0)
+
+static TARGET_AVX2 void uv_split_avx2(const uint8_t *uv, uint8_t *u,
+				      uint8_t *v, uint32_t count)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	uint32_t i = 0;
+
+	for (; i + 32 <= count; i += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(uv + i * 2));
+		__m256i b =
+			_mm256_loadu_si256((const __m256i *)(uv + i * 2 + 32));
+
+		__m256i u_val = _mm256_packus_epi16(_mm256_and_si256(a, mask),
+						    _mm256_and_si256(b, mask));
+		__m256i v_val = _mm256_packus_epi16(_mm256_srli_epi16(a, 8),
+						    _mm256_srli_epi16(b, 8));
+
+		_mm256_storeu_si256((__m256i *)(u + i),
+				    _mm256_permute4x64_epi64(u_val,
+							     PACK_ORDER_256));
+		_mm256_storeu_si256((__m256i *)(v + i),
+				    _mm256_permute4x64_epi64(v_val,
+							     PACK_ORDER_256));
+	}
+
+	uv_split_c(uv + i * 2, u + i, v + i, count - i);
+}
+
+static TARGET_AVX2 void uv_merge_avx2(const uint8_t *u, const uint8_t *v,
+				      uint8_t *uv, uint32_t count)
+{
+	uint32_t i = 0;
+
+	for (; i + 32 <= count; i += 32) {
+		__m256i u_val = _mm256_loadu_si256((const __m256i *)(u + i));
+		__m256i v_val = _mm256_loadu_si256((const __m256i *)(v + i));
+		__m256i lo = _mm256_unpacklo_epi8(u_val, v_val);
+		__m256i hi = _mm256_unpackhi_epi8(u_val, v_val);
+
+		_mm256_storeu_si256((__m256i *)(uv + i * 2),
+				    _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *)(uv + i * 2 + 32),
+				    _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	uv_merge_c(u + i, v + i, uv + i * 2, count - i);
+}
+
+static TARGET_AVX2 void uv_split_p010_avx2(const uint16_t *uv, uint16_t *u,
+					   uint16_t *v, uint32_t count)
+{
+	const __m256i mask = _mm256_set1_epi32(0xFFFF);
+	uint32_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(uv + i * 2));
+		__m256i b =
+			_mm256_loadu_si256((const __m256i *)(uv + i * 2 + 16));
+
+		__m256i u_val = _mm256_packs_epi32(
+			_mm256_srli_epi32(_mm256_and_si256(a, mask),
+					  P010_SHIFT),
+			_mm256_srli_epi32(_mm256_and_si256(b, mask),
+					  P010_SHIFT));
+		__m256i v_val = _mm256_packs_epi32(
+			_mm256_srli_epi32(a, 16 + P010_SHIFT),
+			_mm256_srli_epi32(b, 16 + P010_SHIFT));
+
+		_mm256_storeu_si256((__m256i *)(u + i),
+				    _mm256_permute4x64_epi64(u_val,
+							     PACK_ORDER_256));
+		_mm256_storeu_si256((__m256i *)(v + i),
+				    _mm256_permute4x64_epi64(v_val,
+							     PACK_ORDER_256));
+	}
+
+	uv_split_p010_c(uv + i * 2, u + i, v + i, count - i);
+}
+
+static TARGET_AVX2 void uv_merge_p010_avx2(const uint16_t *u,
+					   const uint16_t *v, uint16_t *uv,
+					   uint32_t count)
+{
+	uint32_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256i u_val = _mm256_loadu_si256((const __m256i *)(u + i));
+		__m256i v_val = _mm256_loadu_si256((const __m256i *)(v + i));
+		__m256i lo, hi;
+
+		u_val = _mm256_slli_epi16(u_val, P010_SHIFT);
+		v_val = _mm256_slli_epi16(v_val, P010_SHIFT);
+		lo = _mm256_unpacklo_epi16(u_val, v_val);
+		hi = _mm256_unpackhi_epi16(u_val, v_val);
+
+		_mm256_storeu_si256((__m256i *)(uv + i * 2),
+				    _mm256_permute2x128_si256(lo, hi, 0x20));
+		_mm256_storeu_si256((__m256i *)(uv + i * 2 + 16),
+				    _mm256_permute2x128_si256(lo, hi, 0x31));
+	}
+
+	uv_merge_p010_c(u + i, v + i, uv + i * 2, count - i);
+}
+
+static TARGET_AVX2 void y_from_p010_avx2(const uint16_t *src, uint16_t *dst,
+					 uint32_t count)
+{
+	uint32_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256i val = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_srli_epi16(val, P010_SHIFT));
+	}
+
+	y_from_p010_c(src + i, dst + i, count - i);
+}
+
+static TARGET_AVX2 void y_to_p010_avx2(const uint16_t *src, uint16_t *dst,
+				       uint32_t count)
+{
+	uint32_t i = 0;
+
+	for (; i + 16 <= count; i += 16) {
+		__m256i val = _mm256_loadu_si256((const __m256i *)(src + i));
+		_mm256_storeu_si256((__m256i *)(dst + i),
+				    _mm256_slli_epi16(val, P010_SHIFT));
+	}
+
+	y_to_p010_c(src + i, dst + i, count - i);
+}
+
+static TARGET_AVX2 void swap_rb_avx2(const uint8_t *src, uint8_t *dst,
+				     uint32_t count)
+{
+	const __m256i shuffle = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15, 2, 1, 0,
+		3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+	uint32_t i = 0;
+
+	for (; i + 8 <= count; i += 8) {
+		__m256i val =
+			_mm256_loadu_si256((const __m256i *)(src + i * 4));
+		_mm256_storeu_si256((__m256i *)(dst + i * 4),
+				    _mm256_shuffle_epi8(val, shuffle));
+	}
+
+	swap_rb_c(src + i * 4, dst + i * 4, count - i);
+}
+
+static TARGET_AVX2 void packed_split_avx2(const uint8_t *src, uint8_t *y,
+					  uint8_t *u, uint8_t *v,
+					  uint32_t width, bool luma_first)
+{
+	const __m256i mask = _mm256_set1_epi16(0x00FF);
+	uint32_t x = 0;
+
+	for (; x + 32 <= width; x += 32) {
+		__m256i a = _mm256_loadu_si256((const __m256i *)(src + x * 2));
+		__m256i b =
+			_mm256_loadu_si256((const __m256i *)(src + x * 2 + 32));
+		__m256i a_lo = _mm256_and_si256(a, mask);
+		__m256i b_lo = _mm256_and_si256(b, mask);
+		__m256i a_hi = _mm256_srli_epi16(a, 8);
+		__m256i b_hi = _mm256_srli_epi16(b, 8);
+		__m256i y_val, c_val;
+
+		if (luma_first) {
+			y_val = _mm256_packus_epi16(a_lo, b_lo);
+			c_val = _mm256_packus_epi16(a_hi, b_hi);
+		} else {
+			y_val = _mm256_packus_epi16(a_hi, b_hi);
+			c_val = _mm256_packus_epi16(a_lo, b_lo);
+		}
+
+		y_val = _mm256_permute4x64_epi64(y_val, PACK_ORDER_256);
+		c_val = _mm256_permute4x64_epi64(c_val, PACK_ORDER_256);
+
+		/* 16 U values in the low lane, 16 V values in the high lane */
+		c_val = _mm256_packus_epi16(_mm256_and_si256(c_val, mask),
+					    _mm256_srli_epi16(c_val, 8));
+		c_val = _mm256_permute4x64_epi64(c_val, PACK_ORDER_256);
+
+		_mm256_storeu_si256((__m256i *)(y + x), y_val);
+		_mm_storeu_si128((__m128i *)(u + x / 2),
+				 _mm256_castsi256_si128(c_val));
+		_mm_storeu_si128((__m128i *)(v + x / 2),
+				 _mm256_extracti128_si256(c_val, 1));
+	}
+
+	packed_split_sse2(src + x * 2, y + x, u + x / 2, v + x / 2, width - x,
+			  luma_first);
+}
+
+static const struct convert_kernels kernels_avx2 = {
+	.uv_split = uv_split_avx2,
+	.uv_merge = uv_merge_avx2,
+	.uv_split_p010 = uv_split_p010_avx2,
+	.uv_merge_p010 = uv_merge_p010_avx2,
+	.y_from_p010 = y_from_p010_avx2,
+	.y_to_p010 = y_to_p010_avx2,
+	.swap_rb = swap_rb_avx2,
+	.packed_split = packed_split_avx2,
+};
+
+/* ------------------------------------------------------------------------- */
+/* AVX-512 kernels                                                           */
+
+/* Only the chroma (de)interleaving kernels benefit from the wider registers,
+ * the plain shifts and byte swaps are limited by memory bandwidth and keep
+ * using the AVX2 versions. */
+
+static TARGET_AVX512 void uv_split_avx512(const uint8_t *uv, uint8_t *u,
+					  uint8_t *v, uint32_t count)
+{
+	const __m512i mask = _mm512_set1_epi16(0x00FF);
+	const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+	uint32_t i = 0;
+
+	for (; i + 64 <= count; i += 64) {
+		__m512i a = _mm512_loadu_si512((const void *)(uv + i * 2));
+		__m512i b = _mm512_loadu_si512((const void *)(uv + i * 2 + 64));
+
+		__m512i u_val = _mm512_packus_epi16(_mm512_and_si512(a, mask),
+						    _mm512_and_si512(b, mask));
+		__m512i v_val = _mm512_packus_epi16(_mm512_srli_epi16(a, 8),
+						    _mm512_srli_epi16(b, 8));
+
+		_mm512_storeu_si512((void *)(u + i),
+				    _mm512_permutexvar_epi64(order, u_val));
+		_mm512_storeu_si512((void *)(v + i),
+				    _mm512_permutexvar_epi64(order, v_val));
+	}
+
+	uv_split_avx2(uv + i * 2, u + i, v + i, count - i);
+}
+
+static TARGET_AVX512 void uv_merge_avx512(const uint8_t *u, const uint8_t *v,
+					  uint8_t *uv, uint32_t count)
+{
+	const __m512i order_lo = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+	const __m512i order_hi = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+	uint32_t i = 0;
+
+	for (; i + 64 <= count; i += 64) {
+		__m512i u_val = _mm512_loadu_si512((const void *)(u + i));
+		__m512i v_val = _mm512_loadu_si512((const void *)(v + i));
+		__m512i lo = _mm512_unpacklo_epi8(u_val, v_val);
+		__m512i hi = _mm512_unpackhi_epi8(u_val, v_val);
+
+		_mm512_storeu_si512((void *)(uv + i * 2),
+				    _mm512_permutex2var_epi64(lo, order_lo,
+							      hi));
+		_mm512_storeu_si512((void *)(uv + i * 2 + 64),
+				    _mm512_permutex2var_epi64(lo, order_hi,
+							      hi));
+	}
+
+	uv_merge_avx2(u + i, v + i, uv + i * 2, count - i);
+}
+
+static TARGET_AVX512 void uv_split_p010_avx512(const uint16_t *uv,
+					       uint16_t *u, uint16_t *v,
+					       uint32_t count)
+{
+	const __m512i mask = _mm512_set1_epi32(0xFFFF);
+	const __m512i order = _mm512_setr_epi64(0, 2, 4, 6, 1, 3, 5, 7);
+	uint32_t i = 0;
+
+	for (; i + 32 <= count; i += 32) {
+		__m512i a = _mm512_loadu_si512((const void *)(uv + i * 2));
+		__m512i b = _mm512_loadu_si512((const void *)(uv + i * 2 + 32));
+
+		__m512i u_val = _mm512_packs_epi32(
+			_mm512_srli_epi32(_mm512_and_si512(a, mask),
+					  P010_SHIFT),
+			_mm512_srli_epi32(_mm512_and_si512(b, mask),
+					  P010_SHIFT));
+		__m512i v_val = _mm512_packs_epi32(
+			_mm512_srli_epi32(a, 16 + P010_SHIFT),
+			_mm512_srli_epi32(b, 16 + P010_SHIFT));
+
+		_mm512_storeu_si512((void *)(u + i),
+				    _mm512_permutexvar_epi64(order, u_val));
+		_mm512_storeu_si512((void *)(v + i),
+				    _mm512_permutexvar_epi64(order, v_val));
+	}
+
+	uv_split_p010_avx2(uv + i * 2, u + i, v + i, count - i);
+}
+
+static TARGET_AVX512 void uv_merge_p010_avx512(const uint16_t *u,
+					       const uint16_t *v, uint16_t *uv,
+					       uint32_t count)
+{
+	const __m512i order_lo = _mm512_setr_epi64(0, 1, 8, 9, 2, 3, 10, 11);
+	const __m512i order_hi = _mm512_setr_epi64(4, 5, 12, 13, 6, 7, 14, 15);
+	uint32_t i = 0;
+
+	for (; i + 32 <= count; i += 32) {
+		__m512i u_val = _mm512_loadu_si512((const void *)(u + i));
+		__m512i v_val = _mm512_loadu_si512((const void *)(v + i));
+		__m512i lo, hi;
+
+		u_val = _mm512_slli_epi16(u_val, P010_SHIFT);
+		v_val = _mm512_slli_epi16(v_val, P010_SHIFT);
+		lo = _mm512_unpacklo_epi16(u_val, v_val);
+		hi = _mm512_unpackhi_epi16(u_val, v_val);
+
+		_mm512_storeu_si512((void *)(uv + i * 2),
+				    _mm512_permutex2var_epi64(lo, order_lo,
+							      hi));
+		_mm512_storeu_si512((void *)(uv + i * 2 + 32),
+				    _mm512_permutex2var_epi64(lo, order_hi,
+							      hi));
+	}
+
+	uv_merge_p010_avx2(u + i, v + i, uv + i * 2, count - i);
+}
+
+static const struct convert_kernels kernels_avx512 = {
+	.uv_split = uv_split_avx512,
+	.uv_merge = uv_merge_avx512,
+	.uv_split_p010 = uv_split_p010_avx512,
+	.uv_merge_p010 = uv_merge_p010_avx512,
+	.y_from_p010 = y_from_p010_avx2,
+	.y_to_p010 = y_to_p010_avx2,
+	.swap_rb = swap_rb_avx2,
+	.packed_split = packed_split_avx2,
+};
+
+#endif
+
+static const struct convert_kernels *const kernels[] = {
+	[VIDEO_CONVERT_SIMD_NONE] = &kernels_c,
+	[VIDEO_CONVERT_SIMD_SSE2] = &kernels_sse2,
+#ifdef CONVERT_X64
+	[VIDEO_CONVERT_SIMD_AVX2] = &kernels_avx2,
+	[VIDEO_CONVERT_SIMD_AVX512] = &kernels_avx512,
+#else
+	[VIDEO_CONVERT_SIMD_AVX2] = &kernels_sse2,
+	[VIDEO_CONVERT_SIMD_AVX512] = &kernels_sse2,
+#endif
+};
+
+/* ------------------------------------------------------------------------- */
+/* Runtime dispatch                                                          */
+
+static enum video_convert_simd detect_simd(void)
+{
+#if defined(CONVERT_X64) && defined(_MSC_VER)
+	int regs[4];
+	uint64_t xcr0;
+
+	__cpuid(regs, 1);
+	const bool osxsave = (regs[2] & (1 << 27)) != 0;
+	const bool avx = (regs[2] & (1 << 28)) != 0;
+	if (!osxsave || !avx)
+		return VIDEO_CONVERT_SIMD_SSE2;
+
+	/* make sure the OS saves the YMM (and ZMM) registers */
+	xcr0 = _xgetbv(0);
+	if ((xcr0 & 0x6) != 0x6)
+		return VIDEO_CONVERT_SIMD_SSE2;
+
+	__cpuidex(regs, 7, 0);
+	const bool avx2 = (regs[1] & (1 << 5)) != 0;
+	const bool avx512f = (regs[1] & (1 << 16)) != 0;
+	const bool avx512bw = (regs[1] & (1 << 30)) != 0;
+	if (!avx2)
+		return VIDEO_CONVERT_SIMD_SSE2;
+	if (avx512f && avx512bw && (xcr0 & 0xE6) == 0xE6)
+		return VIDEO_CONVERT_SIMD_AVX512;
+	return VIDEO_CONVERT_SIMD_AVX2;
+
+#elif defined(CONVERT_X64)
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx512f") &&
+	    __builtin_cpu_supports("avx512bw"))
+		return VIDEO_CONVERT_SIMD_AVX512;
+	if (__builtin_cpu_supports("avx2"))
+		return VIDEO_CONVERT_SIMD_AVX2;
+	return VIDEO_CONVERT_SIMD_SSE2;
+
+#else
+	return VIDEO_CONVERT_SIMD_SSE2;
+#endif
+}
+
+static volatile long cpu_simd = -1;
+static volatile long simd_limit = VIDEO_CONVERT_SIMD_AVX512;
+
+static enum video_convert_simd get_cpu_simd(void)
+{
+	long simd = os_atomic_load_long(&cpu_simd);
+
+	if (simd < 0) {
+		simd = (long)detect_simd();
+		if (os_atomic_set_long(&cpu_simd, simd) < 0)
+			blog(LOG_INFO, "video-convert: Using %s kernels",
+			     video_convert_simd_name(simd));
+	}
+
+	return (enum video_convert_simd)simd;
+}
+
+enum video_convert_simd video_convert_get_simd(void)
+{
+	enum video_convert_simd cpu = get_cpu_simd();
+	long limit = os_atomic_load_long(&simd_limit);
+
+	return (long)cpu < limit ? cpu : (enum video_convert_simd)limit;
+}
+
+enum video_convert_simd video_convert_set_simd(enum video_convert_simd max)
+{
+	if (max > VIDEO_CONVERT_SIMD_AVX512)
+		max = VIDEO_CONVERT_SIMD_AVX512;
+
+	os_atomic_set_long(&simd_limit, (long)max);
+	return video_convert_get_simd();
+}
+
+const char *video_convert_simd_name(enum video_convert_simd simd)
+{
+	switch (simd) {
+	case VIDEO_CONVERT_SIMD_NONE:
+		return "C";
+	case VIDEO_CONVERT_SIMD_SSE2:
+		return "SSE2";
+	case VIDEO_CONVERT_SIMD_AVX2:
+		return "AVX2";
+	case VIDEO_CONVERT_SIMD_AVX512:
+		return "AVX-512";
+	}
+
+	return "Unknown";
+}
+
+/* ------------------------------------------------------------------------- */
+/* Frame conversions                                                         */
+
+struct convert_frame {
+	const uint8_t *const *input;
+	const uint32_t *in_linesize;
+	uint8_t *const *output;
+	const uint32_t *out_linesize;
+	uint32_t width;
+	uint32_t height;
+};
+
+#define IN_ROW(f, plane, y) \
+	((f)->input[plane] + (size_t)(f)->in_linesize[plane] * (y))
+#define OUT_ROW(f, plane, y) \
+	((f)->output[plane] + (size_t)(f)->out_linesize[plane] * (y))
+
+static void copy_plane(const struct convert_frame *f, size_t plane,
+		       size_t row_size, uint32_t height)
+{
+	const uint32_t in_linesize = f->in_linesize[plane];
+	const uint32_t out_linesize = f->out_linesize[plane];
+
+	if (in_linesize == out_linesize && in_linesize == row_size) {
+		memcpy(f->output[plane], f->input[plane], row_size * height);
+		return;
+	}
+
+	for (uint32_t y = 0; y < height; y++)
+		memcpy(OUT_ROW(f, plane, y), IN_ROW(f, plane, y), row_size);
+}
+
+static void nv12_to_i420(const struct convert_kernels *k,
+			 const struct convert_frame *f)
+{
+	const uint32_t cx = (f->width + 1) / 2;
+	const uint32_t cy = (f->height + 1) / 2;
+
+	copy_plane(f, 0, f->width, f->height);
+
+	for (uint32_t y = 0; y < cy; y++)
+		k->uv_split(IN_ROW(f, 1, y), OUT_ROW(f, 1, y),
+			    OUT_ROW(f, 2, y), cx);
+}
+
+static void i420_to_nv12(const struct convert_kernels *k,
+			 const struct convert_frame *f)
+{
+	const uint32_t cx = (f->width + 1) / 2;
+	const uint32_t cy = (f->height + 1) / 2;
+
+	copy_plane(f, 0, f->width, f->height);
+
+	for (uint32_t y = 0; y < cy; y++)
+		k->uv_merge(IN_ROW(f, 1, y), IN_ROW(f, 2, y),
+			    OUT_ROW(f, 1, y), cx);
+}
+
+static void p010_to_i010(const struct convert_kernels *k,
+			 const struct convert_frame *f)
+{
+	const uint32_t cx = (f->width + 1) / 2;
+	const uint32_t cy = (f->height + 1) / 2;
+
+	for (uint32_t y = 0; y < f->height; y++)
+		k->y_from_p010((const uint16_t *)IN_ROW(f, 0, y),
+			       (uint16_t *)OUT_ROW(f, 0, y), f->width);
+
+	for (uint32_t y = 0; y < cy; y++)
+		k->uv_split_p010((const uint16_t *)IN_ROW(f, 1, y),
+				 (uint16_t *)OUT_ROW(f, 1, y),
+				 (uint16_t *)OUT_ROW(f, 2, y), cx);
+}
+
+static void i010_to_p010(const struct convert_kernels *k,
+			 const struct convert_frame *f)
+{
+	const uint32_t cx = (f->width + 1) / 2;
+	const uint32_t cy = (f->height + 1) / 2;
+
+	for (uint32_t y = 0; y < f->height; y++)
+		k->y_to_p010((const uint16_t *)IN_ROW(f, 0, y),
+			     (uint16_t *)OUT_ROW(f, 0, y), f->width);
+
+	for (uint32_t y = 0; y < cy; y++)
+		k->uv_merge_p010((const uint16_t *)IN_ROW(f, 1, y),
+				 (const uint16_t *)IN_ROW(f, 2, y),
+				 (uint16_t *)OUT_ROW(f, 1, y), cx);
+}
+
+static void swap_rb(const struct convert_kernels *k,
+		    const struct convert_frame *f)
+{
+	for (uint32_t y = 0; y < f->height; y++)
+		k->swap_rb(IN_ROW(f, 0, y), OUT_ROW(f, 0, y), f->width);
+}
+
+static void packed_to_i422(const struct convert_kernels *k,
+			   const struct convert_frame *f, bool luma_first,
+			   bool swap_uv)
+{
+	const size_t u_plane = swap_uv ? 2 : 1;
+	const size_t v_plane = swap_uv ? 1 : 2;
+
+	for (uint32_t y = 0; y < f->height; y++)
+		k->packed_split(IN_ROW(f, 0, y), OUT_ROW(f, 0, y),
+				OUT_ROW(f, u_plane, y), OUT_ROW(f, v_plane, y),
+				f->width, luma_first);
+}
+
+static void yuy2_to_i422(const struct convert_kernels *k,
+			 const struct convert_frame *f)
+{
+	packed_to_i422(k, f, true, false);
+}
+
+static void uyvy_to_i422(const struct convert_kernels *k,
+			 const struct convert_frame *f)
+{
+	packed_to_i422(k, f, false, false);
+}
+
+static void yvyu_to_i422(const struct convert_kernels *k,
+			 const struct convert_frame *f)
+{
+	packed_to_i422(k, f, true, true);
+}
+
+typedef void (*convert_func_t)(const struct convert_kernels *k,
+			       const struct convert_frame *f);
+
+static convert_func_t get_convert_func(enum video_format src,
+				       enum video_format dst)
+{
+	switch (src) {
+	case VIDEO_FORMAT_NV12:
+		return dst == VIDEO_FORMAT_I420 ? nv12_to_i420 : NULL;
+	case VIDEO_FORMAT_I420:
+		return dst == VIDEO_FORMAT_NV12 ? i420_to_nv12 : NULL;
+	case VIDEO_FORMAT_P010:
+		return dst == VIDEO_FORMAT_I010 ? p010_to_i010 : NULL;
+	case VIDEO_FORMAT_I010:
+		return dst == VIDEO_FORMAT_P010 ? i010_to_p010 : NULL;
+	case VIDEO_FORMAT_RGBA:
+		return dst == VIDEO_FORMAT_BGRA ? swap_rb : NULL;
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+		return dst == VIDEO_FORMAT_RGBA ? swap_rb : NULL;
+	case VIDEO_FORMAT_YUY2:
+		return dst == VIDEO_FORMAT_I422 ? yuy2_to_i422 : NULL;
+	case VIDEO_FORMAT_UYVY:
+		return dst == VIDEO_FORMAT_I422 ? uyvy_to_i422 : NULL;
+	case VIDEO_FORMAT_YVYU:
+		return dst == VIDEO_FORMAT_I422 ? yvyu_to_i422 : NULL;
+	default:
+		return NULL;
+	}
+}
+
+bool video_convert_supported(enum video_format src, enum video_format dst)
+{
+	return get_convert_func(src, dst) != NULL;
+}
+
+bool video_convert(enum video_format src, enum video_format dst,
+		   uint32_t width, uint32_t height,
+		   const uint8_t *const input[], const uint32_t in_linesize[],
+		   uint8_t *const output[], const uint32_t out_linesize[])
+{
+	convert_func_t convert = get_convert_func(src, dst);
+	if (!convert)
+		return false;
+
+	struct convert_frame frame = {
+		.input = input,
+		.in_linesize = in_linesize,
+		.output = output,
+		.out_linesize = out_linesize,
+		.width = width,
+		.height = height,
+	};
+
+	convert(kernels[video_convert_get_simd()], &frame);
+	return true;
+}
@@ -0,0 +1,72 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+#include "video-io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Same-size conversions between video formats that only rearrange samples
+ * (plane layout, packing, channel order or bit position) and therefore need
+ * no color math.  Anything else still goes through the video scaler.
+ *
+ * The kernels are picked at runtime from the best instruction set the CPU
+ * supports.
+ */
+
+enum video_convert_simd {
+	VIDEO_CONVERT_SIMD_NONE,
+	VIDEO_CONVERT_SIMD_SSE2,
+	VIDEO_CONVERT_SIMD_AVX2,
+	VIDEO_CONVERT_SIMD_AVX512,
+};
+
+/** Returns true if src can be converted to dst by video_convert */
+EXPORT bool video_convert_supported(enum video_format src,
+				    enum video_format dst);
+
+/**
+ * Converts a whole frame from src to dst.  Returns false if the conversion
+ * is not supported.
+ */
+EXPORT bool video_convert(enum video_format src, enum video_format dst,
+			  uint32_t width, uint32_t height,
+			  const uint8_t *const input[],
+			  const uint32_t in_linesize[], uint8_t *const output[],
+			  const uint32_t out_linesize[]);
+
+/** Returns the instruction set currently used by video_convert */
+EXPORT enum video_convert_simd video_convert_get_simd(void);
+
+/**
+ * Limits the instruction set used by video_convert to at most max, mostly
+ * useful for testing and benchmarking.  Returns the instruction set that
+ * will actually be used.
+ */
+EXPORT enum video_convert_simd
+video_convert_set_simd(enum video_convert_simd max);
+
+EXPORT const char *video_convert_simd_name(enum video_convert_simd simd);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,287 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <string.h>
+
+#include "video-deinterlace.h"
+
+#include "../util/sse-intrin.h"
+
+/* lines around a missing line.  c and e are the lines above and below it in
+ * the kept field, a and b hold lines y - 2 to y + 2 of the frames before and
+ * after it */
+struct yadif_lines {
+	const uint8_t *c;
+	const uint8_t *e;
+	const uint8_t *a[5];
+	const uint8_t *b[5];
+};
+
+static FORCE_INLINE int abs_int(int val)
+{
+	return val < 0 ? -val : val;
+}
+
+static FORCE_INLINE int min_int(int a, int b)
+{
+	return a < b ? a : b;
+}
+
+static FORCE_INLINE int max_int(int a, int b)
+{
+	return a > b ? a : b;
+}
+
+/* checks the edge direction j, and uses it for the prediction if it has a
+ * lower score */
+static FORCE_INLINE bool yadif_check(const uint8_t *cl, const uint8_t *el,
+				     int s, int j, int *spatial_score,
+				     int *spatial_pred)
+{
+	int score = abs_int(cl[-s + j * s] - el[-s - j * s]) +
+		    abs_int(cl[j * s] - el[-j * s]) +
+		    abs_int(cl[s + j * s] - el[s - j * s]);
+
+	if (score >= *spatial_score)
+		return false;
+
+	*spatial_score = score;
+	*spatial_pred = (cl[j * s] + el[-j * s]) >> 1;
+	return true;
+}
+
+/* same as the filter_line function of the original yadif filter, with
+ * spatial interlacing check (mode 0) */
+static inline uint8_t yadif_pixel(const struct yadif_lines *l, uint32_t x,
+				  int s, bool edge)
+{
+	const uint8_t *cl = l->c + x;
+	const uint8_t *el = l->e + x;
+	int c = *cl;
+	int e = *el;
+	int d = (l->a[2][x] + l->b[2][x]) >> 1;
+	int temporal_diff0 = abs_int(l->a[2][x] - l->b[2][x]);
+	int temporal_diff1 =
+		(abs_int(l->a[1][x] - c) + abs_int(l->a[3][x] - e)) >> 1;
+	int temporal_diff2 =
+		(abs_int(l->b[1][x] - c) + abs_int(l->b[3][x] - e)) >> 1;
+	int diff = max_int(temporal_diff0 >> 1,
+			   max_int(temporal_diff1, temporal_diff2));
+	int spatial_pred = (c + e) >> 1;
+
+	/* the edge-directed search needs three samples on either side */
+	if (!edge) {
+		int spatial_score = abs_int(cl[-s] - el[-s]) + abs_int(c - e) +
+				    abs_int(cl[s] - el[s]) - 1;
+
+		if (yadif_check(cl, el, s, -1, &spatial_score, &spatial_pred))
+			yadif_check(cl, el, s, -2, &spatial_score,
+				    &spatial_pred);
+		if (yadif_check(cl, el, s, 1, &spatial_score, &spatial_pred))
+			yadif_check(cl, el, s, 2, &spatial_score,
+				    &spatial_pred);
+	}
+
+	int b = (l->a[0][x] + l->b[0][x]) >> 1;
+	int f = (l->a[4][x] + l->b[4][x]) >> 1;
+	int max_ = max_int(d - e, max_int(d - c, min_int(b - c, f - e)));
+	int min_ = min_int(d - e, min_int(d - c, max_int(b - c, f - e)));
+
+	diff = max_int(diff, max_int(min_, -max_));
+
+	if (spatial_pred > d + diff)
+		spatial_pred = d + diff;
+	else if (spatial_pred < d - diff)
+		spatial_pred = d - diff;
+
+	return (uint8_t)spatial_pred;
+}
+
+/* ------------------------------------------------------------------------- */
+/* SSE2 version, 8 samples at a time as 16-bit values */
+
+static FORCE_INLINE __m128i load8(const uint8_t *ptr)
+{
+	return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)ptr),
+				 _mm_setzero_si128());
+}
+
+static FORCE_INLINE __m128i absdiff16(__m128i a, __m128i b)
+{
+	return _mm_sub_epi16(_mm_max_epi16(a, b), _mm_min_epi16(a, b));
+}
+
+static FORCE_INLINE __m128i select16(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+static FORCE_INLINE __m128i avg16(__m128i a, __m128i b)
+{
+	return _mm_srli_epi16(_mm_add_epi16(a, b), 1);
+}
+
+static FORCE_INLINE __m128i check_score(const uint8_t *cl, const uint8_t *el,
+					int s, int j)
+{
+	return _mm_add_epi16(
+		_mm_add_epi16(absdiff16(load8(cl - s + j * s),
+					load8(el - s - j * s)),
+			      absdiff16(load8(cl + j * s), load8(el - j * s))),
+		absdiff16(load8(cl + s + j * s), load8(el + s - j * s)));
+}
+
+/* updates the prediction in the lanes set in `mask` where the score of
+ * direction j is lower, and returns those lanes */
+static FORCE_INLINE __m128i check_dir(const uint8_t *cl, const uint8_t *el,
+				      int s, int j, __m128i mask,
+				      __m128i *spatial_score,
+				      __m128i *spatial_pred)
+{
+	__m128i score = check_score(cl, el, s, j);
+	__m128i better = _mm_and_si128(mask,
+				       _mm_cmplt_epi16(score, *spatial_score));
+
+	*spatial_score = select16(better, score, *spatial_score);
+	*spatial_pred = select16(
+		better, avg16(load8(cl + j * s), load8(el - j * s)),
+		*spatial_pred);
+	return better;
+}
+
+static void yadif_pixels_sse2(uint8_t *dst, const struct yadif_lines *l,
+			      uint32_t x, int s)
+{
+	const __m128i all = _mm_set1_epi16(-1);
+	const uint8_t *cl = l->c + x;
+	const uint8_t *el = l->e + x;
+	__m128i c = load8(cl);
+	__m128i e = load8(el);
+	__m128i a2 = load8(l->a[2] + x);
+	__m128i b2 = load8(l->b[2] + x);
+	__m128i d = avg16(a2, b2);
+
+	__m128i temporal_diff0 = _mm_srli_epi16(absdiff16(a2, b2), 1);
+	__m128i temporal_diff1 = _mm_srli_epi16(
+		_mm_add_epi16(absdiff16(load8(l->a[1] + x), c),
+			      absdiff16(load8(l->a[3] + x), e)),
+		1);
+	__m128i temporal_diff2 = _mm_srli_epi16(
+		_mm_add_epi16(absdiff16(load8(l->b[1] + x), c),
+			      absdiff16(load8(l->b[3] + x), e)),
+		1);
+	__m128i diff = _mm_max_epi16(
+		temporal_diff0, _mm_max_epi16(temporal_diff1, temporal_diff2));
+
+	__m128i spatial_pred = avg16(c, e);
+	__m128i spatial_score = _mm_add_epi16(
+		absdiff16(load8(cl - s), load8(el - s)), absdiff16(c, e));
+	spatial_score = _mm_add_epi16(spatial_score,
+				      absdiff16(load8(cl + s), load8(el + s)));
+	spatial_score = _mm_sub_epi16(spatial_score, _mm_set1_epi16(1));
+	__m128i mask;
+
+	mask = check_dir(cl, el, s, -1, all, &spatial_score, &spatial_pred);
+	check_dir(cl, el, s, -2, mask, &spatial_score, &spatial_pred);
+	mask = check_dir(cl, el, s, 1, all, &spatial_score, &spatial_pred);
+	check_dir(cl, el, s, 2, mask, &spatial_score, &spatial_pred);
+
+	__m128i b = avg16(load8(l->a[0] + x), load8(l->b[0] + x));
+	__m128i f = avg16(load8(l->a[4] + x), load8(l->b[4] + x));
+	__m128i de = _mm_sub_epi16(d, e);
+	__m128i dc = _mm_sub_epi16(d, c);
+	__m128i bc = _mm_sub_epi16(b, c);
+	__m128i fe = _mm_sub_epi16(f, e);
+	__m128i max_ =
+		_mm_max_epi16(de, _mm_max_epi16(dc, _mm_min_epi16(bc, fe)));
+	__m128i min_ =
+		_mm_min_epi16(de, _mm_min_epi16(dc, _mm_max_epi16(bc, fe)));
+	__m128i neg_max = _mm_sub_epi16(_mm_setzero_si128(), max_);
+
+	diff = _mm_max_epi16(diff, _mm_max_epi16(min_, neg_max));
+
+	spatial_pred = _mm_min_epi16(spatial_pred, _mm_add_epi16(d, diff));
+	spatial_pred = _mm_max_epi16(spatial_pred, _mm_sub_epi16(d, diff));
+
+	_mm_storel_epi64((__m128i *)(dst + x),
+			 _mm_packus_epi16(spatial_pred, spatial_pred));
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline const uint8_t *get_line(const uint8_t *data, uint32_t linesize,
+				      uint32_t y)
+{
+	return data + (size_t)linesize * y;
+}
+
+static void yadif_line(uint8_t *dst, const struct yadif_lines *l,
+		       uint32_t width, uint32_t step)
+{
+	const uint32_t border = step * 3;
+	uint32_t x = 0;
+
+	if (width > border * 2) {
+		for (; x < border; x++)
+			dst[x] = yadif_pixel(l, x, (int)step, true);
+		for (; x + 8 <= width - border; x += 8)
+			yadif_pixels_sse2(dst, l, x, (int)step);
+		for (; x < width - border; x++)
+			dst[x] = yadif_pixel(l, x, (int)step, false);
+	}
+
+	for (; x < width; x++)
+		dst[x] = yadif_pixel(l, x, (int)step, true);
+}
+
+void deinterlace_yadif(uint8_t *output, uint32_t out_linesize,
+		       const uint8_t *const input[3],
+		       const uint32_t in_linesize[3], uint32_t width,
+		       uint32_t height, uint32_t step, uint32_t parity,
+		       uint32_t start_y, uint32_t end_y)
+{
+	const uint8_t *field = input[0];
+
+	for (uint32_t y = start_y; y < end_y; y++) {
+		uint8_t *dst = output + (size_t)out_linesize * y;
+		struct yadif_lines l;
+
+		/* lines of the kept field, and planes too small to have both
+		 * fields, are copied as they are */
+		if ((y & 1) == parity || height < 2) {
+			memcpy(dst, get_line(field, in_linesize[0], y), width);
+			continue;
+		}
+
+		/* lines past the top or bottom of the plane are mirrored */
+		uint32_t above = y > 0 ? y - 1 : y + 1;
+		uint32_t below = y + 1 < height ? y + 1 : y - 1;
+		uint32_t above2 = y > 1 ? y - 2 : y;
+		uint32_t below2 = y + 2 < height ? y + 2 : y;
+		const uint32_t lines[5] = {above2, above, y, below, below2};
+
+		l.c = get_line(field, in_linesize[0], above);
+		l.e = get_line(field, in_linesize[0], below);
+
+		for (size_t i = 0; i < 5; i++) {
+			l.a[i] = get_line(input[1], in_linesize[1], lines[i]);
+			l.b[i] = get_line(input[2], in_linesize[2], lines[i]);
+		}
+
+		yadif_line(dst, &l, width, step);
+	}
+}
@@ -0,0 +1,52 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Yadif deinterlacing of 8-bit planes
+ *
+ *   Keeps the lines of one field of a plane, and rebuilds the lines of the
+ * other field from the lines around them and from the two frames surrounding
+ * the missing field in time.
+ *
+ *   input[0] is the frame holding the field that is kept, input[1] and
+ * input[2] are the frames before and after the missing field (either of them
+ * may be the same as input[0]).  `parity` is the parity of the lines that are
+ * kept (0 for the top field), `width` is the width of the plane in bytes, and
+ * `step` is the distance in bytes between samples of the same component
+ * (e.g. 2 for the interleaved chroma plane of NV12).
+ *
+ *   Only lines start_y to end_y are written, so a plane can be split up
+ * between threads.
+ */
+
+EXPORT void deinterlace_yadif(uint8_t *output, uint32_t out_linesize,
+			      const uint8_t *const input[3],
+			      const uint32_t in_linesize[3], uint32_t width,
+			      uint32_t height, uint32_t step, uint32_t parity,
+			      uint32_t start_y, uint32_t end_y);
+
+#ifdef __cplusplus
+}
+#endif
@@ -18,6 +18,7 @@
 #pragma once
 
 #include "../util/bmem.h"
+#include "frame-pool.h"
 #include "video-io.h"
 
 struct video_frame {
@@ -55,6 +56,22 @@ static inline void video_frame_destroy(struct video_frame *frame)
 	}
 }
 
+/**
+ * Like video_frame_init, but takes the buffer from the frame pool.  The frame
+ * must be released with video_frame_free_pooled, never with video_frame_free.
+ */
+EXPORT void video_frame_init_pooled(struct video_frame *frame,
+				    enum video_format format, uint32_t width,
+				    uint32_t height);
+
+static inline void video_frame_free_pooled(struct video_frame *frame)
+{
+	if (frame) {
+		frame_pool_free(frame->data[0]);
+		memset(frame, 0, sizeof(struct video_frame));
+	}
+}
+
 EXPORT void video_frame_copy(struct video_frame *dst,
 			     const struct video_frame *src,
 			     enum video_format format, uint32_t height);
@@ -25,6 +25,7 @@
 #include "../util/util_uint64.h"
 
 #include "format-conversion.h"
+#include "video-convert.h"
 #include "video-io.h"
 #include "video-frame.h"
 #include "video-scaler.h"
@@ -40,23 +41,29 @@ struct cached_frame_info {
 	int count;
 };
 
-struct video_input {
-	struct video_scale_info conversion;
+/* Inputs asking for the same scaled format share one conversion, which only
+ * runs once per output frame no matter how many inputs use it */
+struct video_conversion {
+	struct video_scale_info info;
+	enum video_format convert_from;
 	video_scaler_t *scaler;
+	bool convert;
 	struct video_frame frame[MAX_CONVERT_BUFFERS];
 	int cur_frame;
+	size_t refs;
+
+	uint64_t frame_seq;
+	bool success;
+};
+
+struct video_input {
+	struct video_scale_info conversion;
+	struct video_conversion *shared;
 
 	void (*callback)(void *param, struct video_data *frame);
 	void *param;
 };
 
-static inline void video_input_free(struct video_input *input)
-{
-	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-		video_frame_free(&input->frame[i]);
-	video_scaler_destroy(input->scaler);
-}
-
 struct video_output {
 	struct video_output_info info;
 
@@ -71,6 +78,10 @@ struct video_output {
 
 	pthread_mutex_t input_mutex;
 	DARRAY(struct video_input) inputs;
+	DARRAY(struct video_conversion *) conversions;
+	uint64_t frame_seq;
+	uint64_t converted_frames;
+	uint64_t shared_frames;
 
 	size_t available_frames;
 	size_t first_added;
@@ -81,37 +92,77 @@ struct video_output {
 	volatile long gpu_refs;
 };
 
+static void video_input_free(struct video_output *video,
+			     struct video_input *input)
+{
+	struct video_conversion *shared = input->shared;
+
+	if (!shared || --shared->refs > 0)
+		return;
+
+	da_erase_item(video->conversions, &shared);
+
+	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
+		video_frame_free_pooled(&shared->frame[i]);
+	video_scaler_destroy(shared->scaler);
+	bfree(shared);
+}
+
 /* ------------------------------------------------------------------------- */
 
-static inline bool scale_video_output(struct video_input *input,
-				      struct video_data *data)
+static bool run_conversion(struct video_conversion *shared,
+			   const struct video_data *data)
 {
-	bool success = true;
+	struct video_frame *frame;
 
-	if (input->scaler) {
-		struct video_frame *frame;
+	if (++shared->cur_frame == MAX_CONVERT_BUFFERS)
+		shared->cur_frame = 0;
 
-		if (++input->cur_frame == MAX_CONVERT_BUFFERS)
-			input->cur_frame = 0;
+	frame = &shared->frame[shared->cur_frame];
 
-		frame = &input->frame[input->cur_frame];
+	if (shared->convert)
+		return video_convert(shared->convert_from, shared->info.format,
+				     shared->info.width, shared->info.height,
+				     (const uint8_t *const *)data->data,
+				     data->linesize, frame->data,
+				     frame->linesize);
 
-		success = video_scaler_scale(input->scaler, frame->data,
-					     frame->linesize,
-					     (const uint8_t *const *)data->data,
-					     data->linesize);
+	return video_scaler_scale(shared->scaler, frame->data, frame->linesize,
+				  (const uint8_t *const *)data->data,
+				  data->linesize);
+}
 
-		if (success) {
-			for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-				data->data[i] = frame->data[i];
-				data->linesize[i] = frame->linesize[i];
-			}
-		} else {
+static inline bool scale_video_output(struct video_output *video,
+				      struct video_input *input,
+				      struct video_data *data)
+{
+	struct video_conversion *shared = input->shared;
+
+	if (!shared)
+		return true;
+
+	if (shared->frame_seq != video->frame_seq) {
+		shared->success = run_conversion(shared, data);
+		shared->frame_seq = video->frame_seq;
+		video->converted_frames++;
+
+		if (!shared->success)
 			blog(LOG_WARNING, "video-io: Could not scale frame!");
+	} else {
+		video->shared_frames++;
+	}
+
+	if (shared->success) {
+		const struct video_frame *frame =
+			&shared->frame[shared->cur_frame];
+
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			data->data[i] = frame->data[i];
+			data->linesize[i] = frame->linesize[i];
 		}
 	}
 
-	return success;
+	return shared->success;
 }
 
 static inline bool video_output_cur_frame(struct video_output *video)
@@ -132,11 +183,13 @@ static inline bool video_output_cur_frame(struct video_output *video)
 
 	pthread_mutex_lock(&video->input_mutex);
 
+	video->frame_seq++;
+
 	for (size_t i = 0; i < video->inputs.num; i++) {
 		struct video_input *input = video->inputs.array + i;
 		struct video_data frame = frame_info->frame;
 
-		if (scale_video_output(input, &frame))
+		if (scale_video_output(video, input, &frame))
 			input->callback(input->param, &frame);
 	}
 
@@ -213,8 +266,8 @@ static inline void init_cache(struct video_output *video)
 		struct video_frame *frame;
 		frame = (struct video_frame *)&video->cache[i];
 
-		video_frame_init(frame, video->info.format, video->info.width,
-				 video->info.height);
+		video_frame_init_pooled(frame, video->info.format,
+					video->info.width, video->info.height);
 	}
 
 	video->available_frames = video->info.cache_size;
@@ -270,11 +323,12 @@ void video_output_close(video_t *video)
 	pthread_mutex_lock(&video->input_mutex);
 
 	for (size_t i = 0; i < video->inputs.num; i++)
-		video_input_free(&video->inputs.array[i]);
+		video_input_free(video, &video->inputs.array[i]);
 	da_free(video->inputs);
+	da_free(video->conversions);
 
 	for (size_t i = 0; i < video->info.cache_size; i++)
-		video_frame_free((struct video_frame *)&video->cache[i]);
+		video_frame_free_pooled((struct video_frame *)&video->cache[i]);
 
 	pthread_mutex_unlock(&video->input_mutex);
 	os_sem_destroy(video->update_semaphore);
@@ -325,24 +379,43 @@ static bool match_space(enum video_colorspace a, enum video_colorspace b)
 	return collapse_space(a) == collapse_space(b);
 }
 
-static inline bool video_input_init(struct video_input *input,
-				    struct video_output *video)
+/* same-size layout changes don't need swscale */
+static bool can_convert(const struct video_scale_info *to,
+			const struct video_scale_info *from)
 {
-	if (input->conversion.width != video->info.width ||
-	    input->conversion.height != video->info.height ||
-	    input->conversion.format != video->info.format ||
-	    !match_range(input->conversion.range, video->info.range) ||
-	    !match_space(input->conversion.colorspace,
-			 video->info.colorspace)) {
-		struct video_scale_info from = {.format = video->info.format,
-						.width = video->info.width,
-						.height = video->info.height,
-						.range = video->info.range,
-						.colorspace =
-							video->info.colorspace};
-
-		int ret = video_scaler_create(&input->scaler,
-					      &input->conversion, &from,
+	return to->width == from->width && to->height == from->height &&
+	       match_range(to->range, from->range) &&
+	       match_space(to->colorspace, from->colorspace) &&
+	       video_convert_supported(from->format, to->format);
+}
+
+static bool same_conversion(const struct video_scale_info *a,
+			    const struct video_scale_info *b)
+{
+	return a->format == b->format && a->width == b->width &&
+	       a->height == b->height && match_range(a->range, b->range) &&
+	       match_space(a->colorspace, b->colorspace);
+}
+
+static struct video_conversion *
+create_conversion(struct video_output *video,
+		  const struct video_scale_info *info)
+{
+	struct video_scale_info from = {.format = video->info.format,
+					.width = video->info.width,
+					.height = video->info.height,
+					.range = video->info.range,
+					.colorspace = video->info.colorspace};
+	struct video_conversion *shared = bzalloc(sizeof(*shared));
+
+	shared->info = *info;
+	shared->refs = 1;
+
+	if (can_convert(info, &from)) {
+		shared->convert = true;
+		shared->convert_from = from.format;
+	} else {
+		int ret = video_scaler_create(&shared->scaler, info, &from,
 					      VIDEO_SCALE_FAST_BILINEAR);
 		if (ret != VIDEO_SCALER_SUCCESS) {
 			if (ret == VIDEO_SCALER_BAD_CONVERSION)
@@ -352,14 +425,44 @@ static inline bool video_input_init(struct video_input *input,
 				blog(LOG_ERROR, "video_input_init: Failed to "
 						"create scaler");
 
-			return false;
+			bfree(shared);
+			return NULL;
 		}
+	}
+
+	for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
+		video_frame_init_pooled(&shared->frame[i], info->format,
+					info->width, info->height);
 
-		for (size_t i = 0; i < MAX_CONVERT_BUFFERS; i++)
-			video_frame_init(&input->frame[i],
-					 input->conversion.format,
-					 input->conversion.width,
-					 input->conversion.height);
+	return shared;
+}
+
+static inline bool video_input_init(struct video_input *input,
+				    struct video_output *video)
+{
+	if (input->conversion.width != video->info.width ||
+	    input->conversion.height != video->info.height ||
+	    input->conversion.format != video->info.format ||
+	    !match_range(input->conversion.range, video->info.range) ||
+	    !match_space(input->conversion.colorspace,
+			 video->info.colorspace)) {
+		for (size_t i = 0; i < video->conversions.num; i++) {
+			struct video_conversion *shared =
+				video->conversions.array[i];
+
+			if (same_conversion(&shared->info,
+					    &input->conversion)) {
+				shared->refs++;
+				input->shared = shared;
+				return true;
+			}
+		}
+
+		input->shared = create_conversion(video, &input->conversion);
+		if (!input->shared)
+			return false;
+
+		da_push_back(video->conversions, &input->shared);
 	}
 
 	return true;
@@ -450,7 +553,7 @@ void video_output_disconnect(video_t *video,
 
 	size_t idx = video_get_input_idx(video, callback, param);
 	if (idx != DARRAY_INVALID) {
-		video_input_free(video->inputs.array + idx);
+		video_input_free(video, video->inputs.array + idx);
 		da_erase(video->inputs, idx);
 
 		if (video->inputs.num == 0) {
@@ -586,6 +689,20 @@ uint32_t video_output_get_total_frames(const video_t *video)
 	return (uint32_t)os_atomic_load_long(&video->total_frames);
 }
 
+void video_output_get_stats(video_t *video, struct video_output_stats *stats)
+{
+	memset(stats, 0, sizeof(*stats));
+
+	if (!video)
+		return;
+
+	pthread_mutex_lock(&video->input_mutex);
+	stats->conversions = video->converted_frames;
+	stats->shared_conversions = video->shared_frames;
+	stats->converters = video->conversions.num;
+	pthread_mutex_unlock(&video->input_mutex);
+}
+
 /* Note: These four functions below are a very slight bit of a hack.  If the
  * texture encoder thread is active while the raw encoder thread is active, the
  * total frame count will just be doubled while they're both active.  Which is
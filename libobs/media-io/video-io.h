@@ -326,6 +326,19 @@ EXPORT double video_output_get_frame_rate(const video_t *video);
 EXPORT uint32_t video_output_get_skipped_frames(const video_t *video);
 EXPORT uint32_t video_output_get_total_frames(const video_t *video);
 
+struct video_output_stats {
+	/** Frames converted or scaled for the inputs */
+	uint64_t conversions;
+	/** Converted frames handed to an input from a conversion made for
+	 * another input with the same format, size and color settings */
+	uint64_t shared_conversions;
+	/** Conversions currently in use */
+	size_t converters;
+};
+
+EXPORT void video_output_get_stats(video_t *video,
+				   struct video_output_stats *stats);
+
 extern void video_output_inc_texture_encoders(video_t *video);
 extern void video_output_dec_texture_encoders(video_t *video);
 extern void video_output_inc_texture_frames(video_t *video);
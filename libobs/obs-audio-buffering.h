@@ -0,0 +1,195 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "util/circlebuf.h"
+#include "media-io/audio-io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Audio buffering
+ *
+ * Buffering is added by holding back output for a few ticks while the
+ * timestamps carry on: the timestamps of the ticks before the held back ones
+ * are queued in front of them, and rendered first.  It's given back the other
+ * way around, by having the audio output run extra ticks right away that only
+ * render what's queued, so outputs get that audio early instead of losing any
+ * of it.
+ */
+
+/* adaptive buffering only gives buffering back after every source has been
+ * ahead of it for this long, and always leaves them this much headroom */
+#define RECLAIM_WINDOW_SEC 10
+#define RECLAIM_HEADROOM_TICKS 1
+
+struct ts_info {
+	uint64_t start;
+	uint64_t end;
+};
+
+struct audio_buffering {
+	struct circlebuf timestamps; /* struct ts_info */
+	uint64_t buffered_ts;
+	uint64_t wait_ticks;
+	int total_ticks;
+	int max_ticks;
+
+	/* adaptive buffering: ticks into the current window, and the least
+	 * audio any source had ready past the end of a tick during it */
+	uint64_t reclaim_ticks;
+	uint64_t reclaim_headroom;
+};
+
+static inline bool audio_buffering_maxed(const struct audio_buffering *b)
+{
+	return b->total_ticks == b->max_ticks;
+}
+
+/* queues the timestamps of a new tick, or nothing when catching up, and gets
+ * the ones to render.  returns false if there's nothing to render. */
+static inline bool audio_buffering_begin_tick(struct audio_buffering *b,
+					      const struct ts_info *in,
+					      bool catching_up,
+					      struct ts_info *ts)
+{
+	if (!catching_up)
+		circlebuf_push_back(&b->timestamps, in, sizeof(*in));
+	if (!b->timestamps.size)
+		return false;
+
+	circlebuf_peek_front(&b->timestamps, ts, sizeof(*ts));
+	return true;
+}
+
+/* how many ticks a source whose audio starts at min_ts is behind */
+static inline int audio_buffering_ticks_behind(size_t sample_rate,
+					       uint64_t start, uint64_t min_ts)
+{
+	uint64_t frames = ns_to_audio_frames(sample_rate, start - min_ts);
+	return (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
+}
+
+/* holds back output for up to the given number of ticks more, and changes ts
+ * to the earliest of the ticks queued in front.  returns the ticks added,
+ * which stops short at the maximum. */
+static inline int audio_buffering_add(struct audio_buffering *b,
+				      size_t sample_rate, struct ts_info *ts,
+				      int ticks)
+{
+	struct ts_info new_ts;
+
+	if (ticks > b->max_ticks - b->total_ticks)
+		ticks = b->max_ticks - b->total_ticks;
+	if (ticks <= 0)
+		return 0;
+
+	if (!b->wait_ticks)
+		b->buffered_ts = ts->start;
+
+	b->total_ticks += ticks;
+	b->reclaim_ticks = 0;
+
+	new_ts.start = b->buffered_ts -
+		       audio_frames_to_ns(sample_rate,
+					  b->wait_ticks * AUDIO_OUTPUT_FRAMES);
+
+	for (int i = 0; i < ticks; i++) {
+		const uint64_t cur_ticks = ++b->wait_ticks;
+
+		new_ts.end = new_ts.start;
+		new_ts.start = b->buffered_ts -
+			       audio_frames_to_ns(sample_rate,
+						  cur_ticks *
+							  AUDIO_OUTPUT_FRAMES);
+
+		circlebuf_push_front(&b->timestamps, &new_ts, sizeof(new_ts));
+	}
+
+	*ts = new_ts;
+	return ticks;
+}
+
+/* keeps track of the least headroom seen while nothing is held back, and
+ * returns true once it has been seen for a whole window */
+static inline bool audio_buffering_window_ended(struct audio_buffering *b,
+						size_t sample_rate,
+						uint64_t headroom)
+{
+	if (b->wait_ticks || !b->total_ticks) {
+		b->reclaim_ticks = 0;
+		return false;
+	}
+
+	if (!b->reclaim_ticks++ || headroom < b->reclaim_headroom)
+		b->reclaim_headroom = headroom;
+
+	if (b->reclaim_ticks * AUDIO_OUTPUT_FRAMES <
+	    RECLAIM_WINDOW_SEC * sample_rate)
+		return false;
+
+	b->reclaim_ticks = 0;
+	return true;
+}
+
+/* gives back half of the window's headroom past what it always leaves, so
+ * that buffering eases down instead of dropping all at once.  returns the
+ * ticks given back, which the audio output has to catch up on. */
+static inline int audio_buffering_reclaim(struct audio_buffering *b,
+					  size_t sample_rate)
+{
+	const uint64_t tick_ns =
+		audio_frames_to_ns(sample_rate, AUDIO_OUTPUT_FRAMES);
+	uint64_t available = b->reclaim_headroom / tick_ns;
+	int ticks = b->total_ticks;
+
+	if (available <= RECLAIM_HEADROOM_TICKS)
+		return 0;
+
+	available = (available - RECLAIM_HEADROOM_TICKS + 1) / 2;
+	if (available < (uint64_t)ticks)
+		ticks = (int)available;
+
+	b->total_ticks -= ticks;
+	return ticks;
+}
+
+/* pops the tick that was just rendered.  returns false while output is being
+ * held back. */
+static inline bool audio_buffering_end_tick(struct audio_buffering *b)
+{
+	circlebuf_pop_front(&b->timestamps, NULL, sizeof(struct ts_info));
+
+	if (b->wait_ticks) {
+		b->wait_ticks--;
+		return false;
+	}
+
+	return true;
+}
+
+static inline void audio_buffering_free(struct audio_buffering *b)
+{
+	circlebuf_free(&b->timestamps);
+}
+
+#ifdef __cplusplus
+}
+#endif
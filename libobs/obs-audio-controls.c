@@ -15,18 +15,25 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
+#include <errno.h>
 #include <math.h>
 
-#include "util/sse-intrin.h"
-
 #include "util/threading.h"
 #include "util/bmem.h"
+#include "util/platform.h"
+#include "util/spsc-ring.h"
 #include "media-io/audio-math.h"
+#include "media-io/audio-meter.h"
 #include "obs.h"
 #include "obs-internal.h"
 
 #include "obs-audio-controls.h"
 
+#ifdef _WIN32
+#define WIN32_MEAN_AND_LEAN
+#include <windows.h>
+#endif
+
 /* These are pointless warnings generated not by our code, but by a standard
  * library macro, INFINITY */
 #ifdef _MSC_VER
@@ -63,6 +70,8 @@ struct meter_cb {
 	void *param;
 };
 
+struct meter_tap;
+
 struct obs_volmeter {
 	pthread_mutex_t mutex;
 	obs_source_t *source;
@@ -74,10 +83,12 @@ struct obs_volmeter {
 
 	enum obs_peak_meter_type peak_meter_type;
 	unsigned int update_ms;
-	float prev_samples[MAX_AUDIO_CHANNELS][4];
 
-	float magnitude[MAX_AUDIO_CHANNELS];
-	float peak[MAX_AUDIO_CHANNELS];
+	/* protected by the meter service mutex */
+	struct meter_tap *tap;
+
+	/* the meter thread holds a reference while it calls the callbacks */
+	volatile long refs;
 };
 
 static float cubic_def_to_db(const float def)
@@ -261,6 +272,66 @@ static void volmeter_source_destroyed(void *vptr, calldata_t *calldata)
 	obs_volmeter_detach_source(volmeter);
 }
 
+/* ------------------------------------------------------------------------- */
+/* Metering service
+ *
+ * All volume meters of a source share one tap.  The audio capture callback
+ * only copies the audio into the tap's ring buffer, the levels are computed
+ * by a single low priority thread and emitted at the display refresh rate,
+ * no matter how many meters are attached to the source. */
+
+#define METER_HISTORY 3
+#define METER_POLL_MS 5
+#define METER_INTERVAL_NS 16666667ULL
+
+struct meter_block {
+	uint32_t frames;
+	uint32_t channels;
+	bool muted;
+};
+
+struct meter_tap {
+	obs_source_t *source;
+	DARRAY(obs_volmeter_t *) meters;
+
+	struct spsc_ring ring;
+	volatile long dropped;
+
+	/* only used by the metering thread */
+	float *samples[MAX_AUDIO_CHANNELS];
+	size_t capacity;
+	float sample_peak[MAX_AUDIO_CHANNELS];
+	float true_peak[MAX_AUDIO_CHANNELS];
+	float sum_squares[MAX_AUDIO_CHANNELS];
+	uint64_t frames;
+	bool muted;
+	uint64_t last_emit;
+};
+
+static struct {
+	pthread_mutex_t mutex;
+	DARRAY(struct meter_tap *) taps;
+	pthread_t thread;
+	os_event_t *stop;
+} meters = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* levels computed while the meter service mutex is held, and signaled after
+ * it has been released */
+struct meter_levels {
+	obs_volmeter_t *volmeter;
+	float magnitude[MAX_AUDIO_CHANNELS];
+	float peak[MAX_AUDIO_CHANNELS];
+	float input_peak[MAX_AUDIO_CHANNELS];
+};
+
+/* set when the last meter was removed from one of the meter thread's own
+ * callbacks, so the thread can't be joined and has to clean up itself */
+static THREAD_LOCAL bool meter_thread_orphaned = false;
+
+static void volmeter_release(obs_volmeter_t *volmeter);
+
 static int get_nr_channels_from_audio_data(const struct audio_data *data)
 {
 	int nr_channels = 0;
@@ -271,288 +342,367 @@ static int get_nr_channels_from_audio_data(const struct audio_data *data)
 	return CLAMP(nr_channels, 0, MAX_AUDIO_CHANNELS);
 }
 
-/* msb(h, g, f, e) lsb(d, c, b, a)   -->  msb(h, h, g, f) lsb(e, d, c, b)
- */
-#define SHIFT_RIGHT_2PS(msb, lsb)                                          \
-	{                                                                  \
-		__m128 tmp =                                               \
-			_mm_shuffle_ps(lsb, msb, _MM_SHUFFLE(0, 0, 3, 3)); \
-		lsb = _mm_shuffle_ps(lsb, tmp, _MM_SHUFFLE(2, 1, 2, 1));   \
-		msb = _mm_shuffle_ps(msb, msb, _MM_SHUFFLE(3, 3, 2, 1));   \
+/* Runs on the audio thread, so it does nothing but copy the planes */
+static void volmeter_source_data_received(void *vptr, obs_source_t *source,
+					  const struct audio_data *data,
+					  bool muted)
+{
+	struct meter_tap *tap = vptr;
+	const int channels = get_nr_channels_from_audio_data(data);
+	const size_t plane_size = data->frames * sizeof(float);
+	size_t offset = sizeof(struct meter_block);
+	struct meter_block block = {
+		.frames = data->frames,
+		.channels = (uint32_t)channels,
+		.muted = muted && !obs_source_muted(source),
+	};
+
+	if (spsc_ring_writable(&tap->ring) < offset + channels * plane_size) {
+		os_atomic_inc_long(&tap->dropped);
+		return;
 	}
 
-/* x(d, c, b, a) --> (|d|, |c|, |b|, |a|)
- */
-#define abs_ps(v) _mm_andnot_ps(_mm_set1_ps(-0.f), v)
-
-/* Take cross product of a vector with a matrix resulting in vector.
- */
-#define VECTOR_MATRIX_CROSS_PS(out, v, m0, m1, m2, m3)    \
-	{                                                 \
-		out = _mm_mul_ps(v, m0);                  \
-		__m128 mul1 = _mm_mul_ps(v, m1);          \
-		__m128 mul2 = _mm_mul_ps(v, m2);          \
-		__m128 mul3 = _mm_mul_ps(v, m3);          \
-                                                          \
-		_MM_TRANSPOSE4_PS(out, mul1, mul2, mul3); \
-                                                          \
-		out = _mm_add_ps(out, mul1);              \
-		out = _mm_add_ps(out, mul2);              \
-		out = _mm_add_ps(out, mul3);              \
+	spsc_ring_write(&tap->ring, 0, &block, sizeof(block));
+
+	for (int plane = 0, ch = 0; ch < channels; plane++) {
+		if (!data->data[plane])
+			continue;
+
+		spsc_ring_write(&tap->ring, offset, data->data[plane],
+				plane_size);
+		offset += plane_size;
+		ch++;
 	}
 
-/* x4(d, c, b, a)  -->  max(a, b, c, d)
- */
-#define hmax_ps(r, x4)                     \
-	do {                               \
-		float x4_mem[4];           \
-		_mm_storeu_ps(x4_mem, x4); \
-		r = x4_mem[0];             \
-		r = fmaxf(r, x4_mem[1]);   \
-		r = fmaxf(r, x4_mem[2]);   \
-		r = fmaxf(r, x4_mem[3]);   \
-	} while (false)
-
-/* Calculate the true peak over a set of samples.
- * The algorithm implements 5x oversampling by using Whittaker-Shannon
- * interpolation over four samples.
- *
- * The four samples have location t=-1.5, -0.5, +0.5, +1.5
- * The oversamples are taken at locations t=-0.3, -0.1, +0.1, +0.3
- *
- * @param previous_samples  Last 4 samples from the previous iteration.
- * @param samples           The samples to find the peak in.
- * @param nr_samples        Number of sets of 4 samples.
- * @returns 5 times oversampled true-peak from the set of samples.
- */
-static float get_true_peak(__m128 previous_samples, const float *samples,
-			   size_t nr_samples)
-{
-	/* These are normalized-sinc parameters for interpolating over sample
-	 * points which are located at x-coords: -1.5, -0.5, +0.5, +1.5.
-	 * And oversample points at x-coords: -0.3, -0.1, 0.1, 0.3. */
-	const __m128 m3 =
-		_mm_set_ps(-0.155915f, 0.935489f, 0.233872f, -0.103943f);
-	const __m128 m1 =
-		_mm_set_ps(-0.216236f, 0.756827f, 0.504551f, -0.189207f);
-	const __m128 p1 =
-		_mm_set_ps(-0.189207f, 0.504551f, 0.756827f, -0.216236f);
-	const __m128 p3 =
-		_mm_set_ps(-0.103943f, 0.233872f, 0.935489f, -0.155915f);
-
-	__m128 work = previous_samples;
-	__m128 peak = previous_samples;
-	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
-		__m128 new_work = _mm_load_ps(&samples[i]);
-		__m128 intrp_samples;
-
-		/* Include the actual sample values in the peak. */
-		__m128 abs_new_work = abs_ps(new_work);
-		peak = _mm_max_ps(peak, abs_new_work);
-
-		/* Shift in the next point. */
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
-
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
-
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
-
-		SHIFT_RIGHT_2PS(new_work, work);
-		VECTOR_MATRIX_CROSS_PS(intrp_samples, work, m3, m1, p1, p3);
-		peak = _mm_max_ps(peak, abs_ps(intrp_samples));
+	spsc_ring_commit(&tap->ring, offset);
+}
+
+static struct meter_tap *meter_tap_create(obs_source_t *source)
+{
+	struct meter_tap *tap = bzalloc(sizeof(*tap));
+	struct obs_audio_info oai;
+	size_t channels = MAX_AUDIO_CHANNELS;
+	size_t rate = 48000;
+
+	if (obs_get_audio_info(&oai)) {
+		channels = get_audio_channels(oai.speakers);
+		rate = oai.samples_per_sec;
 	}
 
-	float r;
-	hmax_ps(r, peak);
-	return r;
+	/* a quarter of a second, in case the metering thread is starved */
+	spsc_ring_init(&tap->ring, rate / 4 * channels * sizeof(float));
+	tap->source = source;
+	return tap;
 }
 
-/* points contain the first four samples to calculate the sinc interpolation
- * over. They will have come from a previous iteration.
- */
-static float get_sample_peak(__m128 previous_samples, const float *samples,
-			     size_t nr_samples)
+static void meter_tap_destroy(struct meter_tap *tap)
 {
-	__m128 peak = previous_samples;
-	for (size_t i = 0; (i + 3) < nr_samples; i += 4) {
-		__m128 new_work = _mm_load_ps(&samples[i]);
-		peak = _mm_max_ps(peak, abs_ps(new_work));
+	if (!tap)
+		return;
+
+	if (tap->dropped)
+		blog(LOG_DEBUG, "Volume meter of '%s' dropped %ld packets",
+		     obs_source_get_name(tap->source), tap->dropped);
+
+	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++)
+		bfree(tap->samples[i]);
+	spsc_ring_free(&tap->ring);
+	da_free(tap->meters);
+	bfree(tap);
+}
+
+static bool meter_tap_wants_true_peak(struct meter_tap *tap)
+{
+	bool true_peak = false;
+
+	for (size_t i = 0; i < tap->meters.num && !true_peak; i++) {
+		obs_volmeter_t *volmeter = tap->meters.array[i];
+
+		pthread_mutex_lock(&volmeter->mutex);
+		true_peak = volmeter->peak_meter_type == TRUE_PEAK_METER;
+		pthread_mutex_unlock(&volmeter->mutex);
 	}
 
-	float r;
-	hmax_ps(r, peak);
-	return r;
+	return true_peak;
 }
 
-static void volmeter_process_peak_last_samples(obs_volmeter_t *volmeter,
-					       int channel_nr, float *samples,
-					       size_t nr_samples)
+static void meter_tap_reserve(struct meter_tap *tap, size_t frames)
 {
-	/* Take the last 4 samples that need to be used for the next peak
-	 * calculation. If there are less than 4 samples in total the new
-	 * samples shift out the old samples. */
+	if (frames <= tap->capacity)
+		return;
 
-	switch (nr_samples) {
-	case 0:
-		break;
-	case 1:
-		volmeter->prev_samples[channel_nr][0] =
-			volmeter->prev_samples[channel_nr][1];
-		volmeter->prev_samples[channel_nr][1] =
-			volmeter->prev_samples[channel_nr][2];
-		volmeter->prev_samples[channel_nr][2] =
-			volmeter->prev_samples[channel_nr][3];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
-		break;
-	case 2:
-		volmeter->prev_samples[channel_nr][0] =
-			volmeter->prev_samples[channel_nr][2];
-		volmeter->prev_samples[channel_nr][1] =
-			volmeter->prev_samples[channel_nr][3];
-		volmeter->prev_samples[channel_nr][2] = samples[nr_samples - 2];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
-		break;
-	case 3:
-		volmeter->prev_samples[channel_nr][0] =
-			volmeter->prev_samples[channel_nr][3];
-		volmeter->prev_samples[channel_nr][1] = samples[nr_samples - 3];
-		volmeter->prev_samples[channel_nr][2] = samples[nr_samples - 2];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
-		break;
-	default:
-		volmeter->prev_samples[channel_nr][0] = samples[nr_samples - 4];
-		volmeter->prev_samples[channel_nr][1] = samples[nr_samples - 3];
-		volmeter->prev_samples[channel_nr][2] = samples[nr_samples - 2];
-		volmeter->prev_samples[channel_nr][3] = samples[nr_samples - 1];
+	for (size_t i = 0; i < MAX_AUDIO_CHANNELS; i++) {
+		tap->samples[i] = brealloc(tap->samples[i],
+					   (METER_HISTORY + frames) *
+						   sizeof(float));
+		if (!tap->capacity)
+			memset(tap->samples[i], 0,
+			       METER_HISTORY * sizeof(float));
 	}
+
+	tap->capacity = frames;
 }
 
-static void volmeter_process_peak(obs_volmeter_t *volmeter,
-				  const struct audio_data *data,
-				  int nr_channels)
+static void meter_tap_drain(struct meter_tap *tap)
 {
-	int nr_samples = data->frames;
-	int channel_nr = 0;
-	for (int plane_nr = 0; channel_nr < nr_channels; plane_nr++) {
-		float *samples = (float *)data->data[plane_nr];
-		if (!samples) {
-			continue;
-		}
-		if (((uintptr_t)samples & 0xf) > 0) {
-			printf("Audio plane %i is not aligned %p skipping "
-			       "peak volume measurement.\n",
-			       plane_nr, samples);
-			volmeter->peak[channel_nr] = 1.0;
-			channel_nr++;
+	const bool true_peak = meter_tap_wants_true_peak(tap);
+	struct meter_block block;
+
+	while (spsc_ring_pop(&tap->ring, &block, sizeof(block))) {
+		const size_t plane_size = block.frames * sizeof(float);
+
+		if (!block.frames)
 			continue;
+
+		meter_tap_reserve(tap, block.frames);
+
+		/* each sample buffer starts with the last few samples of the
+		 * previous packet, which the true peak interpolation needs */
+		for (uint32_t ch = 0; ch < block.channels; ch++) {
+			float *history = tap->samples[ch];
+			float *samples = history + METER_HISTORY;
+			float peak;
+
+			spsc_ring_pop(&tap->ring, samples, plane_size);
+
+			peak = audio_meter_sample_peak(samples, block.frames);
+			tap->sample_peak[ch] =
+				fmaxf(tap->sample_peak[ch], peak);
+
+			if (true_peak) {
+				peak = audio_meter_true_peak(samples,
+							     block.frames);
+				tap->true_peak[ch] =
+					fmaxf(tap->true_peak[ch], peak);
+			}
+
+			tap->sum_squares[ch] +=
+				audio_meter_sum_squares(samples, block.frames);
+
+			memmove(history, history + block.frames,
+				METER_HISTORY * sizeof(float));
 		}
 
-		/* volmeter->prev_samples may not be aligned to 16 bytes;
-		 * use unaligned load. */
-		__m128 previous_samples =
-			_mm_loadu_ps(volmeter->prev_samples[channel_nr]);
+		tap->frames += block.frames;
+		tap->muted = block.muted;
+	}
+}
 
-		float peak;
-		switch (volmeter->peak_meter_type) {
-		case TRUE_PEAK_METER:
-			peak = get_true_peak(previous_samples, samples,
-					     nr_samples);
-			break;
+static void meter_tap_get_levels(const struct meter_tap *tap,
+				 obs_volmeter_t *volmeter,
+				 struct meter_levels *levels)
+{
+	enum obs_peak_meter_type type;
+	float mul;
+
+	pthread_mutex_lock(&volmeter->mutex);
+	type = volmeter->peak_meter_type;
+	mul = tap->muted ? 0.0f : db_to_mul(volmeter->cur_db);
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	os_atomic_inc_long(&volmeter->refs);
+	levels->volmeter = volmeter;
+
+	// Adjust magnitude/peak based on the volume level set by the
+	// user.  And convert to dB.
+	for (size_t ch = 0; ch < MAX_AUDIO_CHANNELS; ch++) {
+		float rms = sqrtf(tap->sum_squares[ch] / (float)tap->frames);
+		float ch_peak = tap->sample_peak[ch];
+		if (type == TRUE_PEAK_METER)
+			ch_peak = fmaxf(ch_peak, tap->true_peak[ch]);
+
+		levels->magnitude[ch] = mul_to_db(rms * mul);
+		levels->peak[ch] = mul_to_db(ch_peak * mul);
+
+		/* The input-peak is NOT adjusted with volume, so that
+		 * the user can check the input-gain. */
+		levels->input_peak[ch] = mul_to_db(ch_peak);
+	}
+}
+
+static void meter_tap_reset(struct meter_tap *tap)
+{
+	memset(tap->sample_peak, 0, sizeof(tap->sample_peak));
+	memset(tap->true_peak, 0, sizeof(tap->true_peak));
+	memset(tap->sum_squares, 0, sizeof(tap->sum_squares));
+	tap->frames = 0;
+}
+
+static void *meter_thread(void *param)
+{
+	os_event_t *stop = param;
+	DARRAY(struct meter_levels) levels;
+
+	da_init(levels);
+
+	os_set_thread_name("libobs: volume meters");
+#ifdef _WIN32
+	SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_BELOW_NORMAL);
+#endif
+
+	while (os_event_timedwait(stop, METER_POLL_MS) == ETIMEDOUT) {
+		const uint64_t now = os_gettime_ns();
 
-		case SAMPLE_PEAK_METER:
-		default:
-			peak = get_sample_peak(previous_samples, samples,
-					       nr_samples);
+		pthread_mutex_lock(&meters.mutex);
+
+		/* the last meter may have been removed, and a new thread
+		 * started for the next one, while this one was waiting */
+		if (meters.stop != stop) {
+			pthread_mutex_unlock(&meters.mutex);
 			break;
 		}
 
-		volmeter_process_peak_last_samples(volmeter, channel_nr,
-						   samples, nr_samples);
+		for (size_t i = 0; i < meters.taps.num; i++) {
+			struct meter_tap *tap = meters.taps.array[i];
+
+			meter_tap_drain(tap);
+
+			if (!tap->frames ||
+			    now - tap->last_emit < METER_INTERVAL_NS)
+				continue;
 
-		volmeter->peak[channel_nr] = peak;
+			for (size_t j = 0; j < tap->meters.num; j++)
+				meter_tap_get_levels(tap, tap->meters.array[j],
+						     da_push_back_new(levels));
+
+			meter_tap_reset(tap);
+			tap->last_emit = now;
+		}
+
+		pthread_mutex_unlock(&meters.mutex);
+
+		/* callbacks may add or remove meters, so they are called
+		 * without the service mutex */
+		for (size_t i = 0; i < levels.num; i++) {
+			struct meter_levels *l = &levels.array[i];
+
+			signal_levels_updated(l->volmeter, l->magnitude,
+					      l->peak, l->input_peak);
+			volmeter_release(l->volmeter);
+		}
+		da_resize(levels, 0);
 
-		channel_nr++;
+		if (meter_thread_orphaned)
+			break;
 	}
 
-	/* Clear the peak of the channels that have not been handled. */
-	for (; channel_nr < MAX_AUDIO_CHANNELS; channel_nr++) {
-		volmeter->peak[channel_nr] = 0.0;
+	da_free(levels);
+
+	if (meter_thread_orphaned)
+		os_event_destroy(stop);
+
+	return NULL;
+}
+
+static bool meter_thread_start(void)
+{
+	int errorcode;
+
+	if (os_event_init(&meters.stop, OS_EVENT_TYPE_MANUAL) != 0)
+		return false;
+
+#ifdef __APPLE__
+	pthread_attr_t attr;
+	pthread_attr_init(&attr);
+	pthread_attr_set_qos_class_np(&attr, QOS_CLASS_UTILITY, 0);
+	errorcode = pthread_create(&meters.thread, &attr, meter_thread,
+				   meters.stop);
+	pthread_attr_destroy(&attr);
+#else
+	errorcode = pthread_create(&meters.thread, NULL, meter_thread,
+				   meters.stop);
+#endif
+	if (errorcode != 0) {
+		blog(LOG_ERROR, "Failed to create volume meter thread");
+		os_event_destroy(meters.stop);
+		meters.stop = NULL;
+		return false;
 	}
+
+	return true;
 }
 
-static void volmeter_process_magnitude(obs_volmeter_t *volmeter,
-				       const struct audio_data *data,
-				       int nr_channels)
+static void meter_service_add(obs_volmeter_t *volmeter, obs_source_t *source)
 {
-	size_t nr_samples = data->frames;
+	struct meter_tap *tap = NULL;
 
-	int channel_nr = 0;
-	for (int plane_nr = 0; channel_nr < nr_channels; plane_nr++) {
-		float *samples = (float *)data->data[plane_nr];
-		if (!samples) {
-			continue;
+	pthread_mutex_lock(&meters.mutex);
+
+	for (size_t i = 0; i < meters.taps.num; i++) {
+		if (meters.taps.array[i]->source == source) {
+			tap = meters.taps.array[i];
+			break;
 		}
+	}
 
-		float sum = 0.0;
-		for (size_t i = 0; i < nr_samples; i++) {
-			float sample = samples[i];
-			sum += sample * sample;
+	if (!tap) {
+		if (!meters.stop && !meter_thread_start()) {
+			pthread_mutex_unlock(&meters.mutex);
+			return;
 		}
-		volmeter->magnitude[channel_nr] = sqrtf(sum / nr_samples);
 
-		channel_nr++;
+		tap = meter_tap_create(source);
+		da_push_back(meters.taps, &tap);
+		obs_source_add_audio_capture_callback(
+			source, volmeter_source_data_received, tap);
 	}
-}
 
-static void volmeter_process_audio_data(obs_volmeter_t *volmeter,
-					const struct audio_data *data)
-{
-	int nr_channels = get_nr_channels_from_audio_data(data);
+	da_push_back(tap->meters, &volmeter);
+	volmeter->tap = tap;
 
-	volmeter_process_peak(volmeter, data, nr_channels);
-	volmeter_process_magnitude(volmeter, data, nr_channels);
+	pthread_mutex_unlock(&meters.mutex);
 }
 
-static void volmeter_source_data_received(void *vptr, obs_source_t *source,
-					  const struct audio_data *data,
-					  bool muted)
+static void meter_service_remove(obs_volmeter_t *volmeter)
 {
-	struct obs_volmeter *volmeter = (struct obs_volmeter *)vptr;
-	float mul;
-	float magnitude[MAX_AUDIO_CHANNELS];
-	float peak[MAX_AUDIO_CHANNELS];
-	float input_peak[MAX_AUDIO_CHANNELS];
+	struct meter_tap *tap;
+	os_event_t *stop = NULL;
+	pthread_t thread;
 
-	pthread_mutex_lock(&volmeter->mutex);
+	pthread_mutex_lock(&meters.mutex);
 
-	volmeter_process_audio_data(volmeter, data);
-
-	// Adjust magnitude/peak based on the volume level set by the user.
-	// And convert to dB.
-	mul = muted && !obs_source_muted(source) ? 0.0f
-						 : db_to_mul(volmeter->cur_db);
-	for (int channel_nr = 0; channel_nr < MAX_AUDIO_CHANNELS;
-	     channel_nr++) {
-		magnitude[channel_nr] =
-			mul_to_db(volmeter->magnitude[channel_nr] * mul);
-		peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr] * mul);
-
-		/* The input-peak is NOT adjusted with volume, so that the user
-		 * can check the input-gain. */
-		input_peak[channel_nr] = mul_to_db(volmeter->peak[channel_nr]);
+	tap = volmeter->tap;
+	if (!tap) {
+		pthread_mutex_unlock(&meters.mutex);
+		return;
 	}
 
-	pthread_mutex_unlock(&volmeter->mutex);
+	volmeter->tap = NULL;
+	da_erase_item(tap->meters, &volmeter);
+
+	if (tap->meters.num) {
+		tap = NULL;
+	} else {
+		obs_source_remove_audio_capture_callback(
+			tap->source, volmeter_source_data_received, tap);
+		da_erase_item(meters.taps, &tap);
+	}
+
+	if (!meters.taps.num && meters.stop) {
+		stop = meters.stop;
+		thread = meters.thread;
+		meters.stop = NULL;
+	}
+
+	pthread_mutex_unlock(&meters.mutex);
+
+	if (stop) {
+		os_event_signal(stop);
 
-	signal_levels_updated(volmeter, magnitude, peak, input_peak);
+		if (pthread_equal(pthread_self(), thread)) {
+			pthread_detach(thread);
+			meter_thread_orphaned = true;
+		} else {
+			pthread_join(thread, NULL);
+			os_event_destroy(stop);
+		}
+	}
+
+	meter_tap_destroy(tap);
 }
 
+/* ------------------------------------------------------------------------- */
+
 obs_fader_t *obs_fader_create(enum obs_fader_type type)
 {
 	struct obs_fader *fader = bzalloc(sizeof(struct obs_fader));
@@ -773,6 +923,8 @@ obs_volmeter_t *obs_volmeter_create(enum obs_fader_type type)
 	if (!volmeter)
 		return NULL;
 
+	volmeter->refs = 1;
+
 	pthread_mutex_init_value(&volmeter->mutex);
 	pthread_mutex_init_value(&volmeter->callback_mutex);
 	if (pthread_mutex_init(&volmeter->mutex, NULL) != 0)
@@ -788,12 +940,11 @@ fail:
 	return NULL;
 }
 
-void obs_volmeter_destroy(obs_volmeter_t *volmeter)
+static void volmeter_release(obs_volmeter_t *volmeter)
 {
-	if (!volmeter)
+	if (os_atomic_dec_long(&volmeter->refs) != 0)
 		return;
 
-	obs_volmeter_detach_source(volmeter);
 	da_free(volmeter->callbacks);
 	pthread_mutex_destroy(&volmeter->callback_mutex);
 	pthread_mutex_destroy(&volmeter->mutex);
@@ -801,6 +952,15 @@ void obs_volmeter_destroy(obs_volmeter_t *volmeter)
 	bfree(volmeter);
 }
 
+void obs_volmeter_destroy(obs_volmeter_t *volmeter)
+{
+	if (!volmeter)
+		return;
+
+	obs_volmeter_detach_source(volmeter);
+	volmeter_release(volmeter);
+}
+
 bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
 {
 	signal_handler_t *sh;
@@ -816,8 +976,6 @@ bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
 			       volmeter);
 	signal_handler_connect(sh, "destroy", volmeter_source_destroyed,
 			       volmeter);
-	obs_source_add_audio_capture_callback(
-		source, volmeter_source_data_received, volmeter);
 	vol = obs_source_get_volume(source);
 
 	pthread_mutex_lock(&volmeter->mutex);
@@ -827,6 +985,8 @@ bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
 
 	pthread_mutex_unlock(&volmeter->mutex);
 
+	meter_service_add(volmeter, source);
+
 	return true;
 }
 
@@ -846,13 +1006,13 @@ void obs_volmeter_detach_source(obs_volmeter_t *volmeter)
 	if (!source)
 		return;
 
+	meter_service_remove(volmeter);
+
 	sh = obs_source_get_signal_handler(source);
 	signal_handler_disconnect(sh, "volume", volmeter_source_volume_changed,
 				  volmeter);
 	signal_handler_disconnect(sh, "destroy", volmeter_source_destroyed,
 				  volmeter);
-	obs_source_remove_audio_capture_callback(
-		source, volmeter_source_data_received, volmeter);
 }
 
 void obs_volmeter_set_peak_meter_type(obs_volmeter_t *volmeter,
@@ -212,6 +212,9 @@ EXPORT void obs_volmeter_destroy(obs_volmeter_t *volmeter);
  * When the volume meter is attached to a source it will start to listen to
  * volume updates on the source and after preparing the data emit its own
  * signal.
+ *
+ * The levels are measured once per source on a background thread, for all
+ * meters attached to it, and emitted at most 60 times per second.
  */
 EXPORT bool obs_volmeter_attach_source(obs_volmeter_t *volmeter,
 				       obs_source_t *source);
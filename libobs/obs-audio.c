@@ -19,25 +19,234 @@
 #include "obs-internal.h"
 #include "util/util_uint64.h"
 
-struct ts_info {
-	uint64_t start;
-	uint64_t end;
-};
-
 #define DEBUG_AUDIO 0
 #define DEBUG_LAGGED_AUDIO 0
 
+/* sources that take less than this to render in total are faster to render
+ * on the audio thread than to hand off to the worker threads */
+#define MIN_PARALLEL_RENDER_NS 100000
+
+extern THREAD_LOCAL bool is_audio_thread;
+
+/* set while a thread renders sources on behalf of the audio thread, which
+ * can be one of the worker threads, see render_audio_source */
+static THREAD_LOCAL bool rendering_audio = false;
+
+/* returns the index of the source in the tree being built, adding it (and
+ * taking a reference) the first time it's seen */
+static size_t get_tree_node(struct obs_core_audio *audio, obs_source_t *source)
+{
+	obs_source_t *s;
+
+	if (source->audio_tree_build == audio->tree_build)
+		return source->audio_tree_idx;
+
+	s = obs_source_get_ref(source);
+	if (!s)
+		return DARRAY_INVALID;
+
+	s->audio_tree_build = audio->tree_build;
+	s->audio_tree_idx = audio->tree_nodes.num;
+	da_push_back(audio->tree_nodes, &s);
+	return s->audio_tree_idx;
+}
+
 static void push_audio_tree(obs_source_t *parent, obs_source_t *source, void *p)
 {
 	struct obs_core_audio *audio = p;
+	struct audio_render_edge edge;
+
+	edge.child = get_tree_node(audio, source);
+	if (!parent || edge.child == DARRAY_INVALID)
+		return;
+
+	edge.parent = get_tree_node(audio, parent);
+	if (edge.parent != DARRAY_INVALID)
+		da_push_back(audio->tree_edges, &edge);
+}
+
+/* assigns every source a level above all of its children, then sorts the
+ * tree nodes by level into the render order.  sources within a level don't
+ * depend on each other and keep their relative order, so every tick renders
+ * the same way no matter how many threads are used */
+static void sort_render_order(struct obs_core_audio *audio)
+{
+	const size_t num = audio->tree_nodes.num;
+	size_t max_level = 0;
+	bool changed = true;
+	size_t *offsets;
+	size_t *levels;
+
+	da_resize(audio->tree_levels, num);
+	levels = audio->tree_levels.array;
+	memset(levels, 0, num * sizeof(size_t));
+
+	/* children are enumerated before their parents, so this usually
+	 * settles after one pass.  the pass limit only guards against
+	 * cycles */
+	for (size_t pass = 0; changed && pass < num; pass++) {
+		changed = false;
+
+		for (size_t i = 0; i < audio->tree_edges.num; i++) {
+			struct audio_render_edge *edge =
+				&audio->tree_edges.array[i];
+
+			if (levels[edge->parent] <= levels[edge->child]) {
+				levels[edge->parent] = levels[edge->child] + 1;
+				changed = true;
+			}
+		}
+	}
+
+	for (size_t i = 0; i < num; i++) {
+		if (levels[i] > max_level)
+			max_level = levels[i];
+	}
+
+	/* counting sort; afterwards level_offsets holds the start of every
+	 * level, plus the end of the last one */
+	da_resize(audio->level_offsets, max_level + 2);
+	offsets = audio->level_offsets.array;
+	memset(offsets, 0, (max_level + 2) * sizeof(size_t));
+
+	for (size_t i = 0; i < num; i++)
+		offsets[levels[i] + 1]++;
+	for (size_t i = 1; i <= max_level + 1; i++)
+		offsets[i] += offsets[i - 1];
+
+	/* the levels aren't needed past this point, so tree_levels is reused
+	 * to map tree nodes to their position in the render order */
+	da_resize(audio->render_order, num);
+	for (size_t i = 0; i < num; i++) {
+		size_t pos = offsets[levels[i]]++;
+
+		audio->render_order.array[pos] = audio->tree_nodes.array[i];
+		levels[i] = pos;
+	}
+
+	for (size_t i = max_level + 1; i > 0; i--)
+		offsets[i] = offsets[i - 1];
+	offsets[0] = 0;
+}
+
+static void free_tree_sources(struct obs_core_audio *audio)
+{
+	for (size_t i = 0; i < audio->tree_sources.num; i++)
+		obs_weak_source_release(audio->tree_sources.array[i]);
+	da_resize(audio->tree_sources, 0);
+}
+
+/* enumerates the output channels and audio sources to build the render
+ * order from scratch, and keeps weak references to it for later ticks */
+static void build_audio_tree(struct obs_core_audio *audio)
+{
+	struct obs_core_data *data = &obs->data;
+	long generation = os_atomic_load_long(&data->audio_tree_generation);
+	struct obs_source *source;
+
+	/* anything that changes from here on triggers another rebuild */
+	os_atomic_set_bool(&audio->tree_stale, false);
+
+	audio->tree_build++;
+	da_resize(audio->tree_nodes, 0);
+	da_resize(audio->tree_edges, 0);
+	da_resize(audio->tree_roots, 0);
+
+	/* NOTE: these are source channels, not audio channels */
+	for (uint32_t i = 0; i < MAX_CHANNELS; i++) {
+		source = obs_get_output_source(i);
+		if (source) {
+			size_t idx;
+
+			obs_source_enum_active_tree(source, push_audio_tree,
+						    audio);
+			idx = get_tree_node(audio, source);
+			if (idx != DARRAY_INVALID)
+				da_push_back(audio->tree_roots, &idx);
+			obs_source_release(source);
+		}
+	}
+
+	pthread_mutex_lock(&data->audio_sources_mutex);
+
+	source = data->first_audio_source;
+	while (source) {
+		push_audio_tree(NULL, source, audio);
+		source = (struct obs_source *)source->next_audio_source;
+	}
+
+	pthread_mutex_unlock(&data->audio_sources_mutex);
 
-	if (da_find(audio->render_order, &source, 0) == DARRAY_INVALID) {
-		obs_source_t *s = obs_source_get_ref(source);
-		if (s)
-			da_push_back(audio->render_order, &s);
+	sort_render_order(audio);
+
+	free_tree_sources(audio);
+	for (size_t i = 0; i < audio->render_order.num; i++) {
+		obs_source_t *source = audio->render_order.array[i];
+		obs_weak_source_t *weak = obs_source_get_weak_source(source);
+
+		da_push_back(audio->tree_sources, &weak);
+	}
+
+	for (size_t i = 0; i < audio->tree_roots.num; i++) {
+		size_t *root = &audio->tree_roots.array[i];
+
+		*root = audio->tree_levels.array[*root];
+		da_push_back(audio->root_nodes,
+			     &audio->render_order.array[*root]);
+	}
+
+	audio->tree_generation = generation;
+	audio->tree_valid = true;
+}
+
+/* takes references to the sources of the last built tree.  sources that
+ * have been destroyed since are left out, and the tree is rebuilt in the
+ * next tick */
+static void load_audio_tree(struct obs_core_audio *audio)
+{
+	da_resize(audio->render_order, audio->tree_sources.num);
+
+	for (size_t i = 0; i < audio->tree_sources.num; i++) {
+		obs_weak_source_t *weak = audio->tree_sources.array[i];
+		obs_source_t *source = obs_weak_source_get_source(weak);
+
+		if (!source)
+			os_atomic_set_bool(&audio->tree_stale, true);
+		audio->render_order.array[i] = source;
 	}
 
-	UNUSED_PARAMETER(parent);
+	for (size_t i = 0; i < audio->tree_roots.num; i++) {
+		size_t root = audio->tree_roots.array[i];
+		obs_source_t *source = audio->render_order.array[root];
+
+		if (source)
+			da_push_back(audio->root_nodes, &source);
+	}
+}
+
+static inline bool audio_tree_changed(struct obs_core_audio *audio)
+{
+	long generation =
+		os_atomic_load_long(&obs->data.audio_tree_generation);
+
+	return !audio->tree_valid || generation != audio->tree_generation ||
+	       os_atomic_load_bool(&audio->tree_stale);
+}
+
+bool obs_source_audio_rendered(const obs_source_t *source)
+{
+	struct obs_core_audio *audio = &obs->audio;
+
+	/* only meaningful while a tick is being rendered */
+	if (!is_audio_thread && !rendering_audio)
+		return true;
+	if (source->audio_render_tick == audio->render_tick)
+		return true;
+
+	/* a parent is asking for a child that isn't in the render order,
+	 * which means it was added after the tree was last built */
+	os_atomic_set_bool(&audio->tree_stale, true);
+	return false;
 }
 
 static inline size_t convert_time_to_frames(size_t sample_rate, uint64_t t)
@@ -151,7 +360,8 @@ static bool ignore_audio(obs_source_t *source, size_t channels,
 	return false;
 }
 
-static bool discard_if_stopped(obs_source_t *source, size_t channels)
+static bool discard_if_stopped(struct obs_core_audio *audio,
+			       obs_source_t *source, size_t channels)
 {
 	size_t last_size;
 	size_t size;
@@ -178,6 +388,7 @@ static bool discard_if_stopped(obs_source_t *source, size_t channels)
 			circlebuf_pop_front(&source->audio_input_buf[ch], NULL,
 					    source->audio_input_buf[ch].size);
 
+		audio->buffering_stats.discarded_frames += size / sizeof(float);
 		source->pending_stop = false;
 		source->audio_ts = 0;
 		source->last_audio_input_buf_size = 0;
@@ -200,8 +411,6 @@ static inline void discard_audio(struct obs_core_audio *audio,
 {
 	size_t total_floats = AUDIO_OUTPUT_FRAMES;
 	size_t size;
-	/* debug assert only */
-	UNUSED_PARAMETER(audio);
 
 #if DEBUG_AUDIO == 1
 	bool is_audio_source = source->info.output_flags & OBS_SOURCE_AUDIO;
@@ -226,7 +435,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	if (source->audio_ts < (ts->start - 1)) {
 		if (source->audio_pending &&
 		    source->audio_input_buf[0].size < MAX_AUDIO_SIZE &&
-		    discard_if_stopped(source, channels))
+		    discard_if_stopped(audio, source, channels))
 			return;
 
 #if DEBUG_AUDIO == 1
@@ -240,10 +449,9 @@ static inline void discard_audio(struct obs_core_audio *audio,
 
 		/* ignore_audio should have already run and marked this source
 		 * pending, unless we *just* added buffering */
-		assert(audio->total_buffering_ticks <
-			       audio->max_buffering_ticks ||
+		assert(!audio_buffering_maxed(&audio->buffering) ||
 		       source->audio_pending || !source->audio_ts ||
-		       audio->buffering_wait_ticks);
+		       audio->buffering.wait_ticks);
 #endif
 		return;
 	}
@@ -267,7 +475,7 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	size = total_floats * sizeof(float);
 
 	if (source->audio_input_buf[0].size < size) {
-		if (discard_if_stopped(source, channels))
+		if (discard_if_stopped(audio, source, channels))
 			return;
 
 #if DEBUG_AUDIO == 1
@@ -292,133 +500,150 @@ static inline void discard_audio(struct obs_core_audio *audio,
 	source->audio_ts = ts->end;
 }
 
-static inline bool audio_buffering_maxed(struct obs_core_audio *audio)
+static inline int buffering_ms(int ticks, size_t sample_rate)
 {
-	return audio->total_buffering_ticks == audio->max_buffering_ticks;
+	return (int)((size_t)ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate);
+}
+
+static void signal_buffering_changed(struct obs_core_audio *audio,
+				     size_t sample_rate, int prev_ticks,
+				     const char *reason, const char *source)
+{
+	struct calldata params;
+
+	calldata_init(&params);
+	calldata_set_int(&params, "buffering_ms",
+			 buffering_ms(audio->buffering.total_ticks,
+				      sample_rate));
+	calldata_set_int(&params, "prev_buffering_ms",
+			 buffering_ms(prev_ticks, sample_rate));
+	calldata_set_string(&params, "reason", reason);
+	calldata_set_string(&params, "source", source ? source : "");
+
+	signal_handler_signal(obs->signals, "audio_buffering_changed",
+			      &params);
+	calldata_free(&params);
 }
 
 static void set_fixed_audio_buffering(struct obs_core_audio *audio,
 				      size_t sample_rate, struct ts_info *ts)
 {
-	struct ts_info new_ts;
-	size_t total_ms;
+	struct audio_buffering *b = &audio->buffering;
 	int ticks;
 
-	if (audio_buffering_maxed(audio))
+	ticks = audio_buffering_add(b, sample_rate, ts,
+				    b->max_ticks - b->total_ticks);
+	if (!ticks)
 		return;
 
-	if (!audio->buffering_wait_ticks)
-		audio->buffered_ts = ts->start;
-
-	ticks = audio->max_buffering_ticks - audio->total_buffering_ticks;
-	audio->total_buffering_ticks += ticks;
-
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
-		   sample_rate;
-
 	blog(LOG_INFO,
 	     "Enabling fixed audio buffering, total "
 	     "audio buffering is now %d milliseconds",
-	     (int)total_ms);
-
-	new_ts.start =
-		audio->buffered_ts -
-		audio_frames_to_ns(sample_rate, audio->buffering_wait_ticks *
-							AUDIO_OUTPUT_FRAMES);
-
-	while (ticks--) {
-		const uint64_t cur_ticks = ++audio->buffering_wait_ticks;
-
-		new_ts.end = new_ts.start;
-		new_ts.start =
-			audio->buffered_ts -
-			audio_frames_to_ns(sample_rate,
-					   cur_ticks * AUDIO_OUTPUT_FRAMES);
-
-#if DEBUG_AUDIO == 1
-		blog(LOG_DEBUG, "add buffered ts: %" PRIu64 "-%" PRIu64,
-		     new_ts.start, new_ts.end);
-#endif
-
-		circlebuf_push_front(&audio->buffered_timestamps, &new_ts,
-				     sizeof(new_ts));
-	}
-
-	*ts = new_ts;
+	     buffering_ms(b->total_ticks, sample_rate));
+	signal_buffering_changed(audio, sample_rate, b->total_ticks - ticks,
+				 "fixed", NULL);
 }
 
 static void add_audio_buffering(struct obs_core_audio *audio,
 				size_t sample_rate, struct ts_info *ts,
 				uint64_t min_ts, const char *buffering_name)
 {
-	struct ts_info new_ts;
-	uint64_t offset;
-	uint64_t frames;
-	size_t total_ms;
-	size_t ms;
+	struct audio_buffering *b = &audio->buffering;
 	int ticks;
 
-	if (audio_buffering_maxed(audio))
-		return;
-
-	if (!audio->buffering_wait_ticks)
-		audio->buffered_ts = ts->start;
+#if DEBUG_AUDIO == 1
+	blog(LOG_DEBUG,
+	     "min_ts (%" PRIu64 ") < start timestamp "
+	     "(%" PRIu64 ")",
+	     min_ts, ts->start);
+	blog(LOG_DEBUG, "old buffered ts: %" PRIu64 "-%" PRIu64, ts->start,
+	     ts->end);
+#endif
 
-	offset = ts->start - min_ts;
-	frames = ns_to_audio_frames(sample_rate, offset);
-	ticks = (int)((frames + AUDIO_OUTPUT_FRAMES - 1) / AUDIO_OUTPUT_FRAMES);
+	ticks = audio_buffering_ticks_behind(sample_rate, ts->start, min_ts);
+	ticks = audio_buffering_add(b, sample_rate, ts, ticks);
+	if (!ticks)
+		return;
 
-	audio->total_buffering_ticks += ticks;
+	audio->buffering_stats.increases++;
 
-	if (audio->total_buffering_ticks >= audio->max_buffering_ticks) {
-		ticks -= audio->total_buffering_ticks -
-			 audio->max_buffering_ticks;
-		audio->total_buffering_ticks = audio->max_buffering_ticks;
+	if (audio_buffering_maxed(b))
 		blog(LOG_WARNING, "Max audio buffering reached!");
-	}
-
-	ms = ticks * AUDIO_OUTPUT_FRAMES * 1000 / sample_rate;
-	total_ms = audio->total_buffering_ticks * AUDIO_OUTPUT_FRAMES * 1000 /
-		   sample_rate;
 
 	blog(LOG_INFO,
 	     "adding %d milliseconds of audio buffering, total "
 	     "audio buffering is now %d milliseconds"
 	     " (source: %s)\n",
-	     (int)ms, (int)total_ms, buffering_name);
+	     buffering_ms(ticks, sample_rate),
+	     buffering_ms(b->total_ticks, sample_rate), buffering_name);
+	signal_buffering_changed(audio, sample_rate, b->total_ticks - ticks,
+				 "source_lagging", buffering_name);
+
 #if DEBUG_AUDIO == 1
-	blog(LOG_DEBUG,
-	     "min_ts (%" PRIu64 ") < start timestamp "
-	     "(%" PRIu64 ")",
-	     min_ts, ts->start);
-	blog(LOG_DEBUG, "old buffered ts: %" PRIu64 "-%" PRIu64, ts->start,
+	blog(LOG_DEBUG, "new buffered ts: %" PRIu64 "-%" PRIu64, ts->start,
 	     ts->end);
 #endif
+}
 
-	new_ts.start =
-		audio->buffered_ts -
-		audio_frames_to_ns(sample_rate, audio->buffering_wait_ticks *
-							AUDIO_OUTPUT_FRAMES);
+/* how much audio a source already has past the end of this tick, which is
+ * what adaptive buffering could give back */
+static inline uint64_t source_headroom(obs_source_t *source,
+				       size_t sample_rate,
+				       const struct ts_info *ts)
+{
+	size_t frames = source->audio_input_buf[0].size / sizeof(float);
+	uint64_t end;
 
-	while (ticks--) {
-		const uint64_t cur_ticks = ++audio->buffering_wait_ticks;
+	if (source->info.audio_render || !source->audio_ts)
+		return UINT64_MAX;
+	if (source->audio_pending)
+		return 0;
 
-		new_ts.end = new_ts.start;
-		new_ts.start =
-			audio->buffered_ts -
-			audio_frames_to_ns(sample_rate,
-					   cur_ticks * AUDIO_OUTPUT_FRAMES);
+	end = source->audio_ts + audio_frames_to_ns(sample_rate, frames);
+	return end > ts->end ? end - ts->end : 0;
+}
 
-#if DEBUG_AUDIO == 1
-		blog(LOG_DEBUG, "add buffered ts: %" PRIu64 "-%" PRIu64,
-		     new_ts.start, new_ts.end);
-#endif
+/* see obs-audio-buffering.h */
+static void reclaim_audio_buffering(struct obs_core_audio *audio,
+				    size_t sample_rate, uint64_t headroom)
+{
+	struct audio_buffering *b = &audio->buffering;
+	uint64_t headroom_ms;
+	int prev_ticks;
+	int ticks;
 
-		circlebuf_push_front(&audio->buffered_timestamps, &new_ts,
-				     sizeof(new_ts));
+	if (!os_atomic_load_bool(&obs->adaptive_audio_buffering) ||
+	    audio->fixed_buffer) {
+		b->reclaim_ticks = 0;
+		return;
 	}
 
-	*ts = new_ts;
+	if (!audio_buffering_window_ended(b, sample_rate, headroom))
+		return;
+
+	/* no audio sources at all counts as all the headroom in the world */
+	headroom_ms = b->reclaim_headroom / 1000000;
+	audio->buffering_stats.headroom_ms =
+		headroom_ms > UINT32_MAX ? UINT32_MAX : (uint32_t)headroom_ms;
+
+	prev_ticks = b->total_ticks;
+	ticks = audio_buffering_reclaim(b, sample_rate);
+	if (!ticks)
+		return;
+
+	audio->buffering_stats.reclaims++;
+	audio->buffering_stats.reclaimed_ms +=
+		(uint32_t)buffering_ms(ticks, sample_rate);
+
+	blog(LOG_INFO,
+	     "reclaiming %d milliseconds of audio buffering, total "
+	     "audio buffering is now %d milliseconds",
+	     buffering_ms(ticks, sample_rate),
+	     buffering_ms(b->total_ticks, sample_rate));
+
+	audio_output_catch_up(audio->audio, (uint32_t)ticks);
+	signal_buffering_changed(audio, sample_rate, prev_ticks, "reclaimed",
+				 NULL);
 }
 
 static bool audio_buffer_insufficient(struct obs_source *source,
@@ -515,6 +740,178 @@ static inline void execute_audio_tasks(void)
 	}
 }
 
+struct audio_render_info {
+	struct obs_core_audio *audio;
+	obs_source_t **sources;
+	uint32_t mixers;
+	size_t channels;
+	size_t sample_rate;
+	size_t audio_size;
+	uint64_t start_ts;
+
+	/* when a level is split, sources that have to stay on the audio
+	 * thread are rendered in a separate pass before the others */
+	bool split;
+	bool worker_pass;
+
+	/* sources can lag on any of the render threads */
+	volatile long ignored_frames;
+	volatile long source_restarts;
+};
+
+static inline void atomic_add_long(volatile long *val, long add)
+{
+	long old_val = os_atomic_load_long(val);
+	while (!os_atomic_compare_exchange_long(val, &old_val, old_val + add))
+		;
+}
+
+/* sources without an audio_render callback only run libobs code */
+static inline bool audio_render_thread_safe(const obs_source_t *source)
+{
+	return !source->info.audio_render ||
+	       (source->info.output_flags &
+		OBS_SOURCE_THREAD_SAFE_AUDIO_RENDER) != 0;
+}
+
+static void render_audio_source(void *param, size_t idx)
+{
+	struct audio_render_info *info = param;
+	struct obs_core_audio *audio = info->audio;
+	obs_source_t *source = info->sources[idx];
+	uint64_t start = os_gettime_ns();
+	long render_ns, avg_ns;
+	bool was_rendering;
+
+	if (!source)
+		return;
+	if (info->split &&
+	    audio_render_thread_safe(source) != info->worker_pass)
+		return;
+
+	/* the worker threads render on behalf of the audio thread, without
+	 * becoming the audio thread for obs_in_task_thread */
+	was_rendering = rendering_audio;
+	rendering_audio = true;
+	source->audio_render_tick = audio->render_tick;
+
+	obs_source_audio_render(source, info->mixers, info->channels,
+				info->sample_rate, info->audio_size);
+
+	/* if a source has gone backward in time and we can no
+	 * longer buffer, drop some or all of its audio */
+	if (audio_buffering_maxed(&audio->buffering) && source->audio_ts != 0 &&
+	    source->audio_ts < info->start_ts) {
+		if (source->info.audio_render) {
+			blog(LOG_DEBUG,
+			     "render audio source %s timestamp has "
+			     "gone backwards",
+			     obs_source_get_name(source));
+
+			/* just avoid further damage */
+			source->audio_pending = true;
+#if DEBUG_AUDIO == 1
+			/* this should really be fixed */
+			assert(false);
+#endif
+		} else {
+			pthread_mutex_lock(&source->audio_buf_mutex);
+			size_t size = source->audio_input_buf[0].size;
+			bool rerender = ignore_audio(source, info->channels,
+						     info->sample_rate,
+						     info->start_ts);
+			size -= source->audio_input_buf[0].size;
+			bool restarted = !source->audio_ts;
+			pthread_mutex_unlock(&source->audio_buf_mutex);
+
+			atomic_add_long(&info->ignored_frames,
+					(long)(size / sizeof(float)));
+			if (restarted)
+				os_atomic_inc_long(&info->source_restarts);
+
+			/* if we (potentially) recovered, re-render */
+			if (rerender)
+				obs_source_audio_render(source, info->mixers,
+							info->channels,
+							info->sample_rate,
+							info->audio_size);
+		}
+	}
+
+	rendering_audio = was_rendering;
+
+	render_ns = (long)(os_gettime_ns() - start);
+	avg_ns = os_atomic_load_long(&source->audio_render_time_ns);
+	os_atomic_set_long(&source->audio_render_time_ns,
+			   avg_ns + (render_ns - avg_ns) / 8);
+}
+
+/* only counts the sources that can be rendered on the worker threads */
+static bool worth_splitting(obs_source_t **sources, size_t count)
+{
+	size_t thread_safe = 0;
+	long total_ns = 0;
+
+	if (count < 2)
+		return false;
+
+	for (size_t i = 0; i < count; i++) {
+		obs_source_t *source = sources[i];
+
+		if (!source || !audio_render_thread_safe(source))
+			continue;
+
+		thread_safe++;
+		total_ns += os_atomic_load_long(&source->audio_render_time_ns);
+		if (thread_safe >= 2 && total_ns >= MIN_PARALLEL_RENDER_NS)
+			return true;
+	}
+
+	return false;
+}
+
+static void render_audio_sources(struct obs_core_audio *audio,
+				 struct audio_render_info *info)
+{
+	bool parallel = os_atomic_load_bool(&obs->parallel_audio_render);
+	const size_t *offsets = audio->level_offsets.array;
+
+	for (size_t level = 0; level + 1 < audio->level_offsets.num; level++) {
+		size_t count = offsets[level + 1] - offsets[level];
+		os_worker_pool_t *pool = NULL;
+
+		info->sources = audio->render_order.array + offsets[level];
+		if (parallel && worth_splitting(info->sources, count))
+			pool = audio->render_pool;
+
+		info->split = pool != NULL;
+		if (info->split) {
+			info->worker_pass = false;
+			os_worker_pool_run(NULL, render_audio_source, info,
+					   count);
+			info->worker_pass = true;
+		}
+
+		os_worker_pool_run(pool, render_audio_source, info, count);
+	}
+}
+
+static void update_render_time(struct obs_core_audio *audio,
+			       size_t sample_rate, uint64_t render_ns)
+{
+	audio->render_time_total_ns += render_ns;
+	audio->render_time_ticks++;
+	audio->render_time_frames += AUDIO_OUTPUT_FRAMES;
+
+	if (audio->render_time_frames >= sample_rate) {
+		audio->avg_render_time_ns = audio->render_time_total_ns /
+					    audio->render_time_ticks;
+		audio->render_time_total_ns = 0;
+		audio->render_time_ticks = 0;
+		audio->render_time_frames = 0;
+	}
+}
+
 bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 		    uint64_t *out_ts, uint32_t mixers,
 		    struct audio_output_data *mixes)
@@ -524,15 +921,23 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	struct obs_source *source;
 	size_t sample_rate = audio_output_get_sample_rate(audio->audio);
 	size_t channels = audio_output_get_channels(audio->audio);
-	struct ts_info ts = {start_ts_in, end_ts_in};
+	const struct ts_info in = {start_ts_in, end_ts_in};
+	struct ts_info ts;
 	size_t audio_size;
+	uint64_t render_start;
 	uint64_t min_ts;
+	uint64_t headroom = UINT64_MAX;
+	bool catching_up = start_ts_in == end_ts_in;
+
+	/* catching up only outputs what's buffered */
+	if (!audio_buffering_begin_tick(&audio->buffering, &in, catching_up,
+					&ts))
+		return false;
 
 	da_resize(audio->render_order, 0);
 	da_resize(audio->root_nodes, 0);
+	audio->render_tick++;
 
-	circlebuf_push_back(&audio->buffered_timestamps, &ts, sizeof(ts));
-	circlebuf_peek_front(&audio->buffered_timestamps, &ts, sizeof(ts));
 	min_ts = ts.start;
 
 	audio_size = AUDIO_OUTPUT_FRAMES * sizeof(float);
@@ -542,68 +947,31 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 #endif
 
 	/* ------------------------------------------------ */
-	/* build audio render order
-	 * NOTE: these are source channels, not audio channels */
-	for (uint32_t i = 0; i < MAX_CHANNELS; i++) {
-		obs_source_t *source = obs_get_output_source(i);
-		if (source) {
-			obs_source_enum_active_tree(source, push_audio_tree,
-						    audio);
-			push_audio_tree(NULL, source, audio);
-			da_push_back(audio->root_nodes, &source);
-			obs_source_release(source);
-		}
-	}
+	/* get the audio render order */
+	render_start = os_gettime_ns();
 
-	pthread_mutex_lock(&data->audio_sources_mutex);
-
-	source = data->first_audio_source;
-	while (source) {
-		push_audio_tree(NULL, source, audio);
-		source = (struct obs_source *)source->next_audio_source;
-	}
-
-	pthread_mutex_unlock(&data->audio_sources_mutex);
+	if (audio_tree_changed(audio))
+		build_audio_tree(audio);
+	else
+		load_audio_tree(audio);
 
 	/* ------------------------------------------------ */
 	/* render audio data */
-	for (size_t i = 0; i < audio->render_order.num; i++) {
-		obs_source_t *source = audio->render_order.array[i];
-		obs_source_audio_render(source, mixers, channels, sample_rate,
-					audio_size);
-
-		/* if a source has gone backward in time and we can no
-		 * longer buffer, drop some or all of its audio */
-		if (audio_buffering_maxed(audio) && source->audio_ts != 0 &&
-		    source->audio_ts < ts.start) {
-			if (source->info.audio_render) {
-				blog(LOG_DEBUG,
-				     "render audio source %s timestamp has "
-				     "gone backwards",
-				     obs_source_get_name(source));
-
-				/* just avoid further damage */
-				source->audio_pending = true;
-#if DEBUG_AUDIO == 1
-				/* this should really be fixed */
-				assert(false);
-#endif
-			} else {
-				pthread_mutex_lock(&source->audio_buf_mutex);
-				bool rerender = ignore_audio(source, channels,
-							     sample_rate,
-							     ts.start);
-				pthread_mutex_unlock(&source->audio_buf_mutex);
-
-				/* if we (potentially) recovered, re-render */
-				if (rerender)
-					obs_source_audio_render(source, mixers,
-								channels,
-								sample_rate,
-								audio_size);
-			}
-		}
-	}
+	struct audio_render_info info = {
+		.audio = audio,
+		.mixers = mixers,
+		.channels = channels,
+		.sample_rate = sample_rate,
+		.audio_size = audio_size,
+		.start_ts = ts.start,
+	};
+	render_audio_sources(audio, &info);
+
+	update_render_time(audio, sample_rate, os_gettime_ns() - render_start);
+
+	audio->buffering_stats.ignored_frames += (uint64_t)info.ignored_frames;
+	audio->buffering_stats.source_restarts +=
+		(uint32_t)info.source_restarts;
 
 	/* ------------------------------------------------ */
 	/* get minimum audio timestamp */
@@ -614,7 +982,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	/* ------------------------------------------------ */
 	/* if a source has gone backward in time, buffer    */
 	if (audio->fixed_buffer) {
-		if (!audio_buffering_maxed(audio)) {
+		if (!audio_buffering_maxed(&audio->buffering)) {
 			set_fixed_audio_buffering(audio, sample_rate, &ts);
 		}
 	} else if (min_ts < ts.start) {
@@ -624,7 +992,7 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 
 	/* ------------------------------------------------ */
 	/* mix audio */
-	if (!audio->buffering_wait_ticks) {
+	if (!audio->buffering.wait_ticks) {
 		for (size_t i = 0; i < audio->root_nodes.num; i++) {
 			obs_source_t *source = audio->root_nodes.array[i];
 
@@ -649,6 +1017,10 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	while (source) {
 		pthread_mutex_lock(&source->audio_buf_mutex);
 		discard_audio(audio, source, channels, sample_rate, &ts);
+
+		uint64_t source_ns = source_headroom(source, sample_rate, &ts);
+		if (source_ns < headroom)
+			headroom = source_ns;
 		pthread_mutex_unlock(&source->audio_buf_mutex);
 
 		source = (struct obs_source *)source->next_audio_source;
@@ -660,14 +1032,13 @@ bool audio_callback(void *param, uint64_t start_ts_in, uint64_t end_ts_in,
 	/* release audio sources */
 	release_audio_sources(audio);
 
-	circlebuf_pop_front(&audio->buffered_timestamps, NULL, sizeof(ts));
-
 	*out_ts = ts.start;
 
-	if (audio->buffering_wait_ticks) {
-		audio->buffering_wait_ticks--;
+	if (!catching_up)
+		reclaim_audio_buffering(audio, sample_rate, headroom);
+
+	if (!audio_buffering_end_tick(&audio->buffering))
 		return false;
-	}
 
 	execute_audio_tasks();
 
@@ -21,12 +21,16 @@
 #include "util/darray.h"
 #include "util/platform.h"
 #include "util/uthash.h"
+#include "util/array-serializer.h"
 #include "graphics/vec2.h"
 #include "graphics/vec3.h"
 #include "graphics/vec4.h"
 #include "graphics/quat.h"
 #include "obs-data.h"
 
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
 #include <jansson.h>
 
 struct obs_data_item {
@@ -42,12 +46,21 @@ struct obs_data_item {
 	size_t default_size;
 	size_t autoselect_size;
 	size_t capacity;
+
+	/* set if the item was allocated from a parser block */
+	struct obs_data_block *block;
 };
 
 struct obs_data {
 	volatile long ref;
 	char *json;
 	struct obs_data_item *items;
+
+	/* set if the items haven't been read from a snapshot yet */
+	volatile bool lazy;
+	struct obs_data_snapshot *snapshot;
+	const uint8_t *snapshot_obj;
+	size_t snapshot_strings;
 };
 
 struct obs_data_array {
@@ -63,6 +76,36 @@ struct obs_data_number {
 	};
 };
 
+/* Items created by the JSON parser are packed into shared blocks instead of
+ * being allocated one by one.  Each item holds a reference to its block, and
+ * the block is freed once the last of its items is destroyed.  Items that
+ * have to grow are moved out of their block into their own allocation. */
+#define OBS_DATA_BLOCK_SIZE (64 * 1024)
+
+struct obs_data_block {
+	volatile long ref;
+	size_t used;
+	size_t size;
+};
+
+static inline void obs_data_block_release(struct obs_data_block *block)
+{
+	if (block && os_atomic_dec_long(&block->ref) == 0)
+		bfree(block);
+}
+
+/* Objects loaded from a binary snapshot keep pointing into the snapshot until
+ * their items are first used, so parts of a file that are never looked at are
+ * never decoded. */
+static void snapshot_materialize(obs_data_t *data);
+static void snapshot_release(struct obs_data_snapshot *snap);
+
+static inline void obs_data_materialize(obs_data_t *data)
+{
+	if (os_atomic_load_bool(&data->lazy))
+		snapshot_materialize(data);
+}
+
 /* ------------------------------------------------------------------------- */
 /* Item structure, designed to be one allocation only */
 
@@ -336,7 +379,17 @@ obs_data_item_ensure_capacity(struct obs_data_item *item)
 	struct obs_data *parent = item->parent;
 	obs_data_item_detach(item);
 
-	new_item = brealloc(item, new_size);
+	if (item->block) {
+		struct obs_data_block *block = item->block;
+
+		new_item = bmalloc(new_size);
+		memcpy(new_item, item, item->capacity);
+		new_item->block = NULL;
+		obs_data_block_release(block);
+	} else {
+		new_item = brealloc(item, new_size);
+	}
+
 	new_item->capacity = new_size;
 	new_item->name = get_item_name(new_item);
 
@@ -354,7 +407,11 @@ static inline void obs_data_item_destroy(struct obs_data_item *item)
 	item_default_data_release(item);
 	item_autoselect_data_release(item);
 	obs_data_item_detach(item);
-	bfree(item);
+
+	if (item->block)
+		obs_data_block_release(item->block);
+	else
+		bfree(item);
 }
 
 static inline void move_data(obs_data_item_t *old_item, void *old_data,
@@ -458,70 +515,670 @@ obs_data_item_set_autoselect_data(struct obs_data_item **p_item,
 }
 
 /* ------------------------------------------------------------------------- */
+/* Block allocated items */
+
+static struct obs_data_block *obs_data_block_create(size_t size)
+{
+	struct obs_data_block *block = bmalloc(size);
+	block->ref = 1;
+	block->used = get_align_size(sizeof(struct obs_data_block));
+	block->size = size;
+	return block;
+}
+
+/* size taken up in a block by an item with the given name and value */
+static size_t block_item_size(const char *name, size_t size,
+			      enum obs_data_type type)
+{
+	size_t total = sizeof(struct obs_data_item) +
+		       get_name_align_size(name) + size;
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key,
-				   json_t *json);
+	/* loaded settings almost always get defaults set on them afterwards,
+	 * so leave room for a default value of the same size */
+	if (type != OBS_DATA_STRING)
+		total += get_align_size(size);
+
+	return get_align_size(total);
+}
 
-static inline void obs_data_add_json_object_data(obs_data_t *data, json_t *jobj)
+static struct obs_data_item *block_item_alloc(struct obs_data_block **p_block,
+					      size_t size)
 {
-	const char *item_key;
-	json_t *jitem;
+	struct obs_data_block *block = *p_block;
+	struct obs_data_item *item;
+
+	if (!block || block->size - block->used < size) {
+		if (size > OBS_DATA_BLOCK_SIZE / 4) {
+			item = bzalloc(size);
+			item->capacity = size;
+			return item;
+		}
 
-	json_object_foreach (jobj, item_key, jitem) {
-		obs_data_add_json_item(data, item_key, jitem);
+		obs_data_block_release(block);
+		block = obs_data_block_create(OBS_DATA_BLOCK_SIZE);
+		*p_block = block;
 	}
+
+	item = (struct obs_data_item *)((uint8_t *)block + block->used);
+	block->used += size;
+	os_atomic_inc_long(&block->ref);
+
+	memset(item, 0, size);
+	item->capacity = size;
+	item->block = block;
+	return item;
 }
 
-static inline void obs_data_add_json_object(obs_data_t *data, const char *key,
-					    json_t *jobj)
+/* adds a new item to an object.  object and array values are passed without
+ * taking a reference, the item takes ownership of them */
+static void add_block_item(struct obs_data_block **p_block, obs_data_t *data,
+			   const char *name, const void *ptr, size_t size,
+			   enum obs_data_type type)
 {
-	obs_data_t *sub_obj = obs_data_create();
+	size_t total_size = block_item_size(name, size, type);
+	struct obs_data_item *item = block_item_alloc(p_block, total_size);
+
+	item->ref = 1;
+	item->type = type;
+	item->name_len = get_name_align_size(name);
+	item->data_len = size;
+	item->data_size = size;
+	item->name = get_item_name(item);
 
-	obs_data_add_json_object_data(sub_obj, jobj);
-	obs_data_set_obj(data, key, sub_obj);
-	obs_data_release(sub_obj);
+	strcpy(get_item_name(item), name);
+	memcpy(get_item_data(item), ptr, size);
+
+	item->parent = data;
+	HASH_ADD_STR(data->items, name, item);
 }
 
-static void obs_data_add_json_array(obs_data_t *data, const char *key,
-				    json_t *jarray)
+/* ------------------------------------------------------------------------- */
+/* JSON parser
+ *
+ *   Builds the obs_data tree directly while reading the JSON text, without
+ * creating an intermediate document first.  Every item is allocated once,
+ * already at its final size, and is packed into a parser block together with
+ * the items that follow it in the file. */
+
+#define JSON_MAX_DEPTH 2048
+
+struct json_parser {
+	const char *start;
+	const char *cur;
+	const char *error;
+
+	struct dstr key;
+	struct dstr str;
+	struct obs_data_block *block;
+
+	obs_data_json_object_cb cb;
+	void *param;
+};
+
+static struct obs_data_item *get_item(struct obs_data *data, const char *name);
+static bool parse_json_object(struct json_parser *p, obs_data_t *data,
+			      int depth);
+
+static inline bool json_parse_error(struct json_parser *p, const char *error)
 {
-	obs_data_array_t *array = obs_data_array_create();
-	size_t idx;
-	json_t *jitem;
+	if (!p->error)
+		p->error = error;
+	return false;
+}
 
-	json_array_foreach (jarray, idx, jitem) {
-		obs_data_t *item;
+static inline void json_skip_whitespace(struct json_parser *p)
+{
+	while (*p->cur == ' ' || *p->cur == '\t' || *p->cur == '\n' ||
+	       *p->cur == '\r')
+		p->cur++;
+}
 
-		if (!json_is_object(jitem))
-			continue;
+static inline void json_add_item(struct json_parser *p, obs_data_t *data,
+				 const void *ptr, size_t size,
+				 enum obs_data_type type)
+{
+	add_block_item(&p->block, data, p->key.array, ptr, size, type);
+}
+
+static inline int json_hex_value(char ch)
+{
+	if (ch >= '0' && ch <= '9')
+		return ch - '0';
+	if (ch >= 'a' && ch <= 'f')
+		return ch - 'a' + 10;
+	if (ch >= 'A' && ch <= 'F')
+		return ch - 'A' + 10;
+	return -1;
+}
+
+static bool json_parse_hex4(struct json_parser *p, uint32_t *val)
+{
+	*val = 0;
 
-		item = obs_data_create();
-		obs_data_add_json_object_data(item, jitem);
-		obs_data_array_push_back(array, item);
-		obs_data_release(item);
+	for (int i = 0; i < 4; i++) {
+		int digit = json_hex_value(p->cur[i]);
+		if (digit < 0)
+			return json_parse_error(p, "invalid escape");
+
+		*val = (*val << 4) | (uint32_t)digit;
 	}
 
-	obs_data_set_array(data, key, array);
-	obs_data_array_release(array);
+	p->cur += 4;
+	return true;
+}
+
+static void json_cat_utf8(struct dstr *str, uint32_t ch)
+{
+	char buf[4];
+	size_t len;
+
+	if (ch < 0x80) {
+		buf[0] = (char)ch;
+		len = 1;
+	} else if (ch < 0x800) {
+		buf[0] = (char)(0xC0 | (ch >> 6));
+		buf[1] = (char)(0x80 | (ch & 0x3F));
+		len = 2;
+	} else if (ch < 0x10000) {
+		buf[0] = (char)(0xE0 | (ch >> 12));
+		buf[1] = (char)(0x80 | ((ch >> 6) & 0x3F));
+		buf[2] = (char)(0x80 | (ch & 0x3F));
+		len = 3;
+	} else {
+		buf[0] = (char)(0xF0 | (ch >> 18));
+		buf[1] = (char)(0x80 | ((ch >> 12) & 0x3F));
+		buf[2] = (char)(0x80 | ((ch >> 6) & 0x3F));
+		buf[3] = (char)(0x80 | (ch & 0x3F));
+		len = 4;
+	}
+
+	dstr_ncat(str, buf, len);
+}
+
+static bool json_parse_unicode_escape(struct json_parser *p, struct dstr *str)
+{
+	uint32_t ch, low;
+
+	if (!json_parse_hex4(p, &ch))
+		return false;
+
+	if (ch >= 0xDC00 && ch <= 0xDFFF)
+		return json_parse_error(p, "invalid Unicode escape");
+
+	if (ch >= 0xD800 && ch <= 0xDBFF) {
+		if (p->cur[0] != '\\' || p->cur[1] != 'u')
+			return json_parse_error(p, "invalid Unicode escape");
+
+		p->cur += 2;
+		if (!json_parse_hex4(p, &low))
+			return false;
+		if (low < 0xDC00 || low > 0xDFFF)
+			return json_parse_error(p, "invalid Unicode escape");
+
+		ch = 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+	}
+
+	if (!ch)
+		return json_parse_error(p, "\\u0000 is not allowed");
+
+	json_cat_utf8(str, ch);
+	return true;
+}
+
+static bool json_parse_escape(struct json_parser *p, struct dstr *str)
+{
+	char ch = *p->cur++;
+
+	switch (ch) {
+	case '"':
+	case '\\':
+	case '/':
+		break;
+	case 'b':
+		ch = '\b';
+		break;
+	case 'f':
+		ch = '\f';
+		break;
+	case 'n':
+		ch = '\n';
+		break;
+	case 'r':
+		ch = '\r';
+		break;
+	case 't':
+		ch = '\t';
+		break;
+	case 'u':
+		return json_parse_unicode_escape(p, str);
+	default:
+		return json_parse_error(p, "invalid escape");
+	}
+
+	dstr_ncat(str, &ch, 1);
+	return true;
+}
+
+static inline bool utf8_continuation(uint8_t ch)
+{
+	return (ch & 0xC0) == 0x80;
+}
+
+/* returns the size of the UTF-8 sequence at `str`, or 0 if it's invalid */
+static size_t utf8_sequence_size(const uint8_t *str)
+{
+	uint8_t ch = str[0];
+
+	if (ch >= 0xC2 && ch <= 0xDF)
+		return utf8_continuation(str[1]) ? 2 : 0;
+
+	if (ch >= 0xE0 && ch <= 0xEF) {
+		if ((ch == 0xE0 && str[1] < 0xA0) ||
+		    (ch == 0xED && str[1] > 0x9F))
+			return 0;
+		return utf8_continuation(str[1]) && utf8_continuation(str[2])
+			       ? 3
+			       : 0;
+	}
+
+	if (ch >= 0xF0 && ch <= 0xF4) {
+		if ((ch == 0xF0 && str[1] < 0x90) ||
+		    (ch == 0xF4 && str[1] > 0x8F))
+			return 0;
+		return utf8_continuation(str[1]) &&
+				       utf8_continuation(str[2]) &&
+				       utf8_continuation(str[3])
+			       ? 4
+			       : 0;
+	}
+
+	return 0;
+}
+
+static bool json_parse_string(struct json_parser *p, struct dstr *str)
+{
+	p->cur++;
+
+	str->len = 0;
+	str->array[0] = 0;
+
+	for (;;) {
+		const char *run = p->cur;
+		uint8_t ch;
+
+		while ((uint8_t)*p->cur >= 0x20 && (uint8_t)*p->cur < 0x80 &&
+		       *p->cur != '"' && *p->cur != '\\')
+			p->cur++;
+
+		if (p->cur != run)
+			dstr_ncat(str, run, p->cur - run);
+
+		ch = (uint8_t)*p->cur;
+
+		if (ch == '"') {
+			p->cur++;
+			return true;
+
+		} else if (ch == '\\') {
+			p->cur++;
+			if (!json_parse_escape(p, str))
+				return false;
+
+		} else if (ch >= 0x80) {
+			const uint8_t *seq = (const uint8_t *)p->cur;
+			size_t size = utf8_sequence_size(seq);
+			if (!size)
+				return json_parse_error(p, "invalid UTF-8");
+
+			dstr_ncat(str, p->cur, size);
+			p->cur += size;
+
+		} else if (!ch) {
+			return json_parse_error(p, "premature end of input");
+
+		} else {
+			return json_parse_error(p,
+						"control character in string");
+		}
+	}
+}
+
+static inline bool is_json_digit(char ch)
+{
+	return ch >= '0' && ch <= '9';
+}
+
+static bool json_parse_number(struct json_parser *p,
+			      struct obs_data_number *num)
+{
+	const char *start = p->cur;
+	bool real = false;
+	char buf[64];
+	size_t len;
+
+	if (*p->cur == '-')
+		p->cur++;
+
+	if (*p->cur == '0') {
+		p->cur++;
+	} else if (is_json_digit(*p->cur)) {
+		while (is_json_digit(*p->cur))
+			p->cur++;
+	} else {
+		return json_parse_error(p, "invalid token");
+	}
+
+	if (*p->cur == '.') {
+		p->cur++;
+		if (!is_json_digit(*p->cur))
+			return json_parse_error(p, "invalid number");
+		while (is_json_digit(*p->cur))
+			p->cur++;
+		real = true;
+	}
+
+	if (*p->cur == 'e' || *p->cur == 'E') {
+		p->cur++;
+		if (*p->cur == '+' || *p->cur == '-')
+			p->cur++;
+		if (!is_json_digit(*p->cur))
+			return json_parse_error(p, "invalid number");
+		while (is_json_digit(*p->cur))
+			p->cur++;
+		real = true;
+	}
+
+	len = p->cur - start;
+	if (len >= sizeof(buf))
+		return json_parse_error(p, real ? "number too long"
+						: "too big integer");
+
+	memcpy(buf, start, len);
+	buf[len] = 0;
+
+	if (real) {
+		num->type = OBS_DATA_NUM_DOUBLE;
+		num->double_val = os_strtod(buf);
+		if (isinf(num->double_val))
+			return json_parse_error(p, "real number overflow");
+	} else {
+		errno = 0;
+		num->type = OBS_DATA_NUM_INT;
+		num->int_val = strtoll(buf, NULL, 10);
+		if (errno == ERANGE)
+			return json_parse_error(p, "too big integer");
+	}
+
+	return true;
+}
+
+static bool json_parse_literal(struct json_parser *p, const char *literal)
+{
+	size_t len = strlen(literal);
+
+	if (strncmp(p->cur, literal, len) != 0 ||
+	    isalnum((unsigned char)p->cur[len]))
+		return json_parse_error(p, "invalid token");
+
+	p->cur += len;
+	return true;
+}
+
+/* parses and discards a value that can't be represented by obs_data */
+static bool json_skip_value(struct json_parser *p, int depth)
+{
+	struct obs_data_number num;
+	char end;
+
+	if (depth > JSON_MAX_DEPTH)
+		return json_parse_error(p, "maximum parsing depth reached");
+
+	switch (*p->cur) {
+	case '"':
+		return json_parse_string(p, &p->str);
+	case 't':
+		return json_parse_literal(p, "true");
+	case 'f':
+		return json_parse_literal(p, "false");
+	case 'n':
+		return json_parse_literal(p, "null");
+	case '{':
+		end = '}';
+		break;
+	case '[':
+		end = ']';
+		break;
+	default:
+		return json_parse_number(p, &num);
+	}
+
+	p->cur++;
+	json_skip_whitespace(p);
+
+	if (*p->cur == end) {
+		p->cur++;
+		return true;
+	}
+
+	for (;;) {
+		if (end == '}') {
+			if (*p->cur != '"')
+				return json_parse_error(p, "string expected");
+			if (!json_parse_string(p, &p->key))
+				return false;
+
+			json_skip_whitespace(p);
+			if (*p->cur++ != ':')
+				return json_parse_error(p, "':' expected");
+			json_skip_whitespace(p);
+		}
+
+		if (!json_skip_value(p, depth + 1))
+			return false;
+
+		json_skip_whitespace(p);
+		if (*p->cur == end) {
+			p->cur++;
+			return true;
+		}
+		if (*p->cur++ != ',')
+			return json_parse_error(p, "',' expected");
+
+		json_skip_whitespace(p);
+	}
+}
+
+static bool json_parse_array(struct json_parser *p, obs_data_array_t *array,
+			     const char *name, int depth)
+{
+	if (depth > JSON_MAX_DEPTH)
+		return json_parse_error(p, "maximum parsing depth reached");
+
+	p->cur++;
+	json_skip_whitespace(p);
+
+	if (*p->cur == ']') {
+		p->cur++;
+		return true;
+	}
+
+	for (;;) {
+		if (*p->cur == '{') {
+			obs_data_t *obj = obs_data_create();
+			da_push_back(array->objects, &obj);
+
+			if (!parse_json_object(p, obj, depth + 1))
+				return false;
+
+			if (p->cb && depth == 1)
+				p->cb(p->param, name, obj);
+
+		} else if (!json_skip_value(p, depth + 1)) {
+			return false;
+		}
+
+		json_skip_whitespace(p);
+		if (*p->cur == ']') {
+			p->cur++;
+			return true;
+		}
+		if (*p->cur++ != ',')
+			return json_parse_error(p, "']' expected");
+
+		json_skip_whitespace(p);
+	}
+}
+
+static bool json_parse_item(struct json_parser *p, obs_data_t *data,
+			    int depth)
+{
+	struct obs_data_number num;
+	bool val;
+
+	switch (*p->cur) {
+	case '"':
+		if (!json_parse_string(p, &p->str))
+			return false;
+		json_add_item(p, data, p->str.array, p->str.len + 1,
+			      OBS_DATA_STRING);
+		return true;
+
+	case '{': {
+		obs_data_t *obj = obs_data_create();
+		json_add_item(p, data, &obj, sizeof(obj), OBS_DATA_OBJECT);
+		return parse_json_object(p, obj, depth + 1);
+	}
+
+	case '[': {
+		obs_data_array_t *array = obs_data_array_create();
+		char *name = NULL;
+		bool success;
+
+		if (p->cb && depth == 0)
+			name = bstrdup(p->key.array);
+
+		json_add_item(p, data, &array, sizeof(array), OBS_DATA_ARRAY);
+		success = json_parse_array(p, array, name, depth + 1);
+		bfree(name);
+		return success;
+	}
+
+	case 't':
+	case 'f':
+		val = *p->cur == 't';
+		if (!json_parse_literal(p, val ? "true" : "false"))
+			return false;
+		json_add_item(p, data, &val, sizeof(val), OBS_DATA_BOOLEAN);
+		return true;
+
+	case 'n':
+		return json_parse_literal(p, "null");
+
+	default:
+		if (!json_parse_number(p, &num))
+			return false;
+		json_add_item(p, data, &num, sizeof(num), OBS_DATA_NUMBER);
+		return true;
+	}
 }
 
-static void obs_data_add_json_item(obs_data_t *data, const char *key,
-				   json_t *json)
+static bool parse_json_object(struct json_parser *p, obs_data_t *data,
+			      int depth)
 {
-	if (json_is_object(json))
-		obs_data_add_json_object(data, key, json);
-	else if (json_is_array(json))
-		obs_data_add_json_array(data, key, json);
-	else if (json_is_string(json))
-		obs_data_set_string(data, key, json_string_value(json));
-	else if (json_is_integer(json))
-		obs_data_set_int(data, key, json_integer_value(json));
-	else if (json_is_real(json))
-		obs_data_set_double(data, key, json_real_value(json));
-	else if (json_is_true(json))
-		obs_data_set_bool(data, key, true);
-	else if (json_is_false(json))
-		obs_data_set_bool(data, key, false);
+	if (depth > JSON_MAX_DEPTH)
+		return json_parse_error(p, "maximum parsing depth reached");
+
+	p->cur++;
+	json_skip_whitespace(p);
+
+	if (*p->cur == '}') {
+		p->cur++;
+		return true;
+	}
+
+	for (;;) {
+		if (*p->cur != '"')
+			return json_parse_error(p, "string or '}' expected");
+		if (!json_parse_string(p, &p->key))
+			return false;
+		if (get_item(data, p->key.array))
+			return json_parse_error(p, "duplicate object key");
+
+		json_skip_whitespace(p);
+		if (*p->cur++ != ':')
+			return json_parse_error(p, "':' expected");
+		json_skip_whitespace(p);
+
+		if (!json_parse_item(p, data, depth))
+			return false;
+
+		json_skip_whitespace(p);
+		if (*p->cur == '}') {
+			p->cur++;
+			return true;
+		}
+		if (*p->cur++ != ',')
+			return json_parse_error(p, "'}' expected");
+
+		json_skip_whitespace(p);
+	}
+}
+
+static int json_error_line(struct json_parser *p)
+{
+	int line = 1;
+
+	for (const char *ch = p->start; ch < p->cur; ch++) {
+		if (*ch == '\n')
+			line++;
+	}
+
+	return line;
+}
+
+static obs_data_t *parse_json(const char *json_string,
+			      obs_data_json_object_cb cb, void *param)
+{
+	obs_data_t *data = obs_data_create();
+	struct json_parser p = {
+		.start = json_string,
+		.cur = json_string,
+		.cb = cb,
+		.param = param,
+	};
+	bool success;
+
+	dstr_reserve(&p.key, 64);
+	dstr_reserve(&p.str, 256);
+
+	json_skip_whitespace(&p);
+
+	if (*p.cur == '{')
+		success = parse_json_object(&p, data, 0);
+	else if (*p.cur == '[')
+		success = json_skip_value(&p, 0);
+	else
+		success = json_parse_error(&p, "'[' or '{' expected");
+
+	if (success) {
+		json_skip_whitespace(&p);
+		if (*p.cur)
+			success = json_parse_error(&p, "end of file expected");
+	}
+
+	if (!success) {
+		blog(LOG_ERROR,
+		     "obs-data.c: [obs_data_create_from_json] "
+		     "Failed reading json string (%d): %s",
+		     json_error_line(&p), p.error);
+		obs_data_release(data);
+		data = NULL;
+	}
+
+	obs_data_block_release(p.block);
+	dstr_free(&p.key);
+	dstr_free(&p.str);
+	return data;
 }
 
 /* ------------------------------------------------------------------------- */
@@ -589,6 +1246,8 @@ static json_t *obs_data_to_json(obs_data_t *data)
 	obs_data_item_t *item = NULL;
 	obs_data_item_t *temp = NULL;
 
+	obs_data_materialize(data);
+
 	HASH_ITER (hh, data->items, item, temp) {
 		enum obs_data_type type = obs_data_item_gettype(item);
 		const char *name = get_item_name(item);
@@ -623,33 +1282,26 @@ obs_data_t *obs_data_create()
 
 obs_data_t *obs_data_create_from_json(const char *json_string)
 {
-	obs_data_t *data = obs_data_create();
-
-	json_error_t error;
-	json_t *root = json_loads(json_string, JSON_REJECT_DUPLICATES, &error);
-
-	if (root) {
-		obs_data_add_json_object_data(data, root);
-		json_decref(root);
-	} else {
-		blog(LOG_ERROR,
-		     "obs-data.c: [obs_data_create_from_json] "
-		     "Failed reading json string (%d): %s",
-		     error.line, error.text);
-		obs_data_release(data);
-		data = NULL;
-	}
+	if (!json_string)
+		return NULL;
 
-	return data;
+	return parse_json(json_string, NULL, NULL);
 }
 
 obs_data_t *obs_data_create_from_json_file(const char *json_file)
+{
+	return obs_data_create_from_json_file_cb(json_file, NULL, NULL);
+}
+
+obs_data_t *obs_data_create_from_json_file_cb(const char *json_file,
+					      obs_data_json_object_cb cb,
+					      void *param)
 {
 	char *file_data = os_quick_read_utf8_file(json_file);
 	obs_data_t *data = NULL;
 
 	if (file_data) {
-		data = obs_data_create_from_json(file_data);
+		data = parse_json(file_data, cb, param);
 		bfree(file_data);
 	}
 
@@ -702,6 +1354,9 @@ static inline void obs_data_destroy(struct obs_data *data)
 		obs_data_item_release(&item);
 	}
 
+	if (data->lazy)
+		snapshot_release(data->snapshot);
+
 	/* NOTE: don't use bfree for json text, allocated by json */
 	free(data->json);
 	bfree(data);
@@ -811,6 +1466,8 @@ obs_data_t *obs_data_get_defaults(obs_data_t *data)
 
 	struct obs_data_item *item, *temp;
 
+	obs_data_materialize(data);
+
 	HASH_ITER (hh, data->items, item, temp) {
 		const char *name = get_item_name(item);
 		switch (item->type) {
@@ -888,6 +1545,7 @@ static struct obs_data_item *get_item(struct obs_data *data, const char *name)
 		return NULL;
 
 	struct obs_data_item *item;
+	obs_data_materialize(data);
 	HASH_FIND_STR(data->items, name, item);
 	return item;
 }
@@ -1035,6 +1693,8 @@ void obs_data_apply(obs_data_t *target, obs_data_t *apply_data)
 
 	struct obs_data_item *item, *temp;
 
+	obs_data_materialize(apply_data);
+
 	HASH_ITER (hh, apply_data->items, item, temp) {
 		copy_item(target, item);
 	}
@@ -1084,6 +1744,7 @@ void obs_data_clear(obs_data_t *target)
 		return;
 
 	struct obs_data_item *item, *temp;
+	obs_data_materialize(target);
 	HASH_ITER (hh, target->items, item, temp) {
 		clear_item(item);
 	}
@@ -1546,6 +2207,8 @@ obs_data_item_t *obs_data_first(obs_data_t *data)
 	if (!data)
 		return NULL;
 
+	obs_data_materialize(data);
+
 	if (data->items)
 		os_atomic_inc_long(&data->items->ref);
 	return data->items;
@@ -2307,3 +2970,1090 @@ bool obs_data_item_get_autoselect_frames_per_second(
 	return get_frames_per_second(obs_data_item_get_autoselect_obj(item),
 				     fps, option);
 }
+
+/* ------------------------------------------------------------------------- */
+/* Binary snapshots
+ *
+ *   A snapshot file starts with a header, followed by records.  The first
+ * record holds the whole object, and the records after it hold changes that
+ * were appended by obs_data_writer_save.  All values are little endian.
+ *
+ *   header:  "OBSDATA\0", u32 version
+ *   record:  u8 type, u32 size, payload
+ *
+ *   Objects are stored in blobs, which start with a table of the strings they
+ * use (u32 count, then u32 length, bytes and a null terminator for each
+ * string), followed by the object itself:
+ *
+ *   object:  u32 size, u32 count, count * (u32 name, u8 tag, value)
+ *   array:   u32 size, u32 count, count * object
+ *
+ * Names and string values are indices into the string table.  Objects and
+ * arrays are prefixed with their size in bytes (not including the size
+ * itself), so objects can be skipped until they are used. */
+
+#define SNAPSHOT_MAGIC "OBSDATA"
+#define SNAPSHOT_VERSION 1
+#define SNAPSHOT_HEADER_SIZE 12
+#define SNAPSHOT_RECORD_HEADER_SIZE 5
+#define SNAPSHOT_MAX_DEPTH 2048
+
+enum snapshot_tag {
+	SNAPSHOT_STRING = 1,
+	SNAPSHOT_INT,
+	SNAPSHOT_DOUBLE,
+	SNAPSHOT_BOOL,
+	SNAPSHOT_OBJECT,
+	SNAPSHOT_ARRAY,
+};
+
+enum snapshot_record {
+	/* blob holding the whole object */
+	SNAPSHOT_RECORD_FULL = 1,
+	/* blob holding items to set on the object */
+	SNAPSHOT_RECORD_SET,
+	/* name of an item to erase */
+	SNAPSHOT_RECORD_ERASE,
+	/* name of an array, u32 new size */
+	SNAPSHOT_RECORD_ARRAY_SIZE,
+	/* name of an array, u32 index, blob holding the new element */
+	SNAPSHOT_RECORD_ARRAY_ITEM,
+};
+
+struct obs_data_snapshot {
+	volatile long ref;
+	struct os_mapped_file *file;
+	uint8_t *buffer;
+
+	/* string tables of all blobs */
+	DARRAY(const char *) strings;
+};
+
+static pthread_mutex_t snapshot_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static inline uint32_t read_u32(const uint8_t *ptr)
+{
+	return (uint32_t)ptr[0] | ((uint32_t)ptr[1] << 8) |
+	       ((uint32_t)ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static inline uint64_t read_u64(const uint8_t *ptr)
+{
+	return (uint64_t)read_u32(ptr) | ((uint64_t)read_u32(ptr + 4) << 32);
+}
+
+static void snapshot_release(struct obs_data_snapshot *snap)
+{
+	if (!snap || os_atomic_dec_long(&snap->ref) != 0)
+		return;
+
+	os_unmap_file(snap->file);
+	bfree(snap->buffer);
+	da_free(snap->strings);
+	bfree(snap);
+}
+
+static obs_data_t *snapshot_object(struct obs_data_snapshot *snap,
+				   const uint8_t *obj, size_t strings)
+{
+	obs_data_t *data = obs_data_create();
+
+	os_atomic_inc_long(&snap->ref);
+	data->snapshot = snap;
+	data->snapshot_obj = obj;
+	data->snapshot_strings = strings;
+	data->lazy = true;
+	return data;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Snapshot reading */
+
+struct snapshot_entry {
+	const char *name;
+	uint8_t tag;
+	const uint8_t *value;
+};
+
+/* reads an entry of an object that has already been validated */
+static const uint8_t *next_snapshot_entry(const uint8_t *cur,
+					  const char **strings,
+					  struct snapshot_entry *entry)
+{
+	entry->name = strings[read_u32(cur)];
+	entry->tag = cur[4];
+	entry->value = cur + 5;
+
+	switch (entry->tag) {
+	case SNAPSHOT_STRING:
+		return entry->value + 4;
+	case SNAPSHOT_INT:
+	case SNAPSHOT_DOUBLE:
+		return entry->value + 8;
+	case SNAPSHOT_BOOL:
+		return entry->value + 1;
+	default:
+		return entry->value + 4 + read_u32(entry->value);
+	}
+}
+
+static size_t snapshot_value_size(const struct snapshot_entry *entry,
+				  const char **strings,
+				  enum obs_data_type *type)
+{
+	switch (entry->tag) {
+	case SNAPSHOT_STRING:
+		*type = OBS_DATA_STRING;
+		return strlen(strings[read_u32(entry->value)]) + 1;
+	case SNAPSHOT_INT:
+	case SNAPSHOT_DOUBLE:
+		*type = OBS_DATA_NUMBER;
+		return sizeof(struct obs_data_number);
+	case SNAPSHOT_BOOL:
+		*type = OBS_DATA_BOOLEAN;
+		return sizeof(bool);
+	case SNAPSHOT_OBJECT:
+		*type = OBS_DATA_OBJECT;
+		return sizeof(obs_data_t *);
+	default:
+		*type = OBS_DATA_ARRAY;
+		return sizeof(obs_data_array_t *);
+	}
+}
+
+static void add_snapshot_item(struct obs_data_block **block,
+			      obs_data_t *data,
+			      const struct snapshot_entry *entry)
+{
+	struct obs_data_snapshot *snap = data->snapshot;
+	const char **strings = snap->strings.array + data->snapshot_strings;
+	const uint8_t *val = entry->value;
+	struct obs_data_number num;
+	obs_data_array_t *array;
+	obs_data_t *obj;
+	bool b;
+
+	switch (entry->tag) {
+	case SNAPSHOT_STRING: {
+		const char *str = strings[read_u32(val)];
+		add_block_item(block, data, entry->name, str, strlen(str) + 1,
+			       OBS_DATA_STRING);
+		break;
+	}
+	case SNAPSHOT_INT:
+		num.type = OBS_DATA_NUM_INT;
+		num.int_val = (long long)read_u64(val);
+		add_block_item(block, data, entry->name, &num, sizeof(num),
+			       OBS_DATA_NUMBER);
+		break;
+	case SNAPSHOT_DOUBLE: {
+		uint64_t bits = read_u64(val);
+		num.type = OBS_DATA_NUM_DOUBLE;
+		memcpy(&num.double_val, &bits, sizeof(bits));
+		add_block_item(block, data, entry->name, &num, sizeof(num),
+			       OBS_DATA_NUMBER);
+		break;
+	}
+	case SNAPSHOT_BOOL:
+		b = *val != 0;
+		add_block_item(block, data, entry->name, &b, sizeof(b),
+			       OBS_DATA_BOOLEAN);
+		break;
+	case SNAPSHOT_OBJECT:
+		obj = snapshot_object(snap, val, data->snapshot_strings);
+		add_block_item(block, data, entry->name, &obj, sizeof(obj),
+			       OBS_DATA_OBJECT);
+		break;
+	case SNAPSHOT_ARRAY: {
+		uint32_t count = read_u32(val + 4);
+		const uint8_t *cur = val + 8;
+
+		array = obs_data_array_create();
+		da_reserve(array->objects, count);
+
+		for (uint32_t i = 0; i < count; i++) {
+			obj = snapshot_object(snap, cur,
+					      data->snapshot_strings);
+			da_push_back(array->objects, &obj);
+			cur += 4 + read_u32(cur);
+		}
+
+		add_block_item(block, data, entry->name, &array, sizeof(array),
+			       OBS_DATA_ARRAY);
+		break;
+	}
+	}
+}
+
+static void snapshot_materialize(obs_data_t *data)
+{
+	pthread_mutex_lock(&snapshot_mutex);
+
+	if (data->lazy) {
+		struct obs_data_snapshot *snap = data->snapshot;
+		const char **strings =
+			snap->strings.array + data->snapshot_strings;
+		const uint8_t *obj = data->snapshot_obj;
+		uint32_t count = read_u32(obj + 4);
+		struct obs_data_block *block = NULL;
+		struct obs_data_item *item;
+		struct snapshot_entry entry;
+		const uint8_t *cur;
+		size_t total = get_align_size(sizeof(struct obs_data_block));
+
+		/* all items of the object go into a single block */
+		cur = obj + 8;
+		for (uint32_t i = 0; i < count; i++) {
+			enum obs_data_type type;
+			size_t size;
+
+			cur = next_snapshot_entry(cur, strings, &entry);
+			size = snapshot_value_size(&entry, strings, &type);
+			total += block_item_size(entry.name, size, type);
+		}
+
+		if (count)
+			block = obs_data_block_create(total);
+
+		cur = obj + 8;
+		for (uint32_t i = 0; i < count; i++) {
+			cur = next_snapshot_entry(cur, strings, &entry);
+			HASH_FIND_STR(data->items, entry.name, item);
+			if (!item)
+				add_snapshot_item(&block, data, &entry);
+		}
+
+		obs_data_block_release(block);
+
+		data->snapshot = NULL;
+		data->snapshot_obj = NULL;
+		os_atomic_store_bool(&data->lazy, false);
+		snapshot_release(snap);
+	}
+
+	pthread_mutex_unlock(&snapshot_mutex);
+}
+
+static const uint8_t *validate_snapshot_object(const uint8_t *cur,
+					       const uint8_t *end,
+					       uint32_t num_strings, int depth);
+
+static const uint8_t *validate_snapshot_value(const uint8_t *cur,
+					      const uint8_t *end, uint8_t tag,
+					      uint32_t num_strings, int depth)
+{
+	const uint8_t *array_end;
+	uint32_t count;
+
+	switch (tag) {
+	case SNAPSHOT_STRING:
+		if (end - cur < 4 || read_u32(cur) >= num_strings)
+			return NULL;
+		return cur + 4;
+	case SNAPSHOT_INT:
+	case SNAPSHOT_DOUBLE:
+		return end - cur < 8 ? NULL : cur + 8;
+	case SNAPSHOT_BOOL:
+		return end - cur < 1 ? NULL : cur + 1;
+	case SNAPSHOT_OBJECT:
+		return validate_snapshot_object(cur, end, num_strings,
+						depth + 1);
+	case SNAPSHOT_ARRAY:
+		if (end - cur < 8 || read_u32(cur) < 4 ||
+		    (size_t)(end - cur) - 4 < read_u32(cur))
+			return NULL;
+
+		array_end = cur + 4 + read_u32(cur);
+		count = read_u32(cur + 4);
+		cur += 8;
+
+		for (uint32_t i = 0; cur && i < count; i++)
+			cur = validate_snapshot_object(cur, array_end,
+						       num_strings, depth + 1);
+		return cur == array_end ? cur : NULL;
+	default:
+		return NULL;
+	}
+}
+
+/* checks that an object only refers to data within [cur, end), and returns a
+ * pointer past its end */
+static const uint8_t *validate_snapshot_object(const uint8_t *cur,
+					       const uint8_t *end,
+					       uint32_t num_strings, int depth)
+{
+	const uint8_t *obj_end;
+	uint32_t count;
+
+	if (depth > SNAPSHOT_MAX_DEPTH || end - cur < 8 ||
+	    read_u32(cur) < 4 || (size_t)(end - cur) - 4 < read_u32(cur))
+		return NULL;
+
+	obj_end = cur + 4 + read_u32(cur);
+	count = read_u32(cur + 4);
+	cur += 8;
+
+	for (uint32_t i = 0; cur && i < count; i++) {
+		if (obj_end - cur < 5 || read_u32(cur) >= num_strings)
+			return NULL;
+
+		cur = validate_snapshot_value(cur + 5, obj_end, cur[4],
+					      num_strings, depth);
+	}
+
+	return cur == obj_end ? cur : NULL;
+}
+
+/* reads the string table of a blob, and returns its object */
+static obs_data_t *read_snapshot_blob(struct obs_data_snapshot *snap,
+				      const uint8_t *cur, const uint8_t *end)
+{
+	size_t strings = snap->strings.num;
+	uint32_t num_strings;
+
+	if (end - cur < 4)
+		return NULL;
+
+	num_strings = read_u32(cur);
+	cur += 4;
+
+	for (uint32_t i = 0; i < num_strings; i++) {
+		uint32_t len;
+
+		if (end - cur < 4)
+			goto fail;
+
+		len = read_u32(cur);
+		cur += 4;
+
+		if ((size_t)(end - cur) <= len || cur[len] != 0 ||
+		    memchr(cur, 0, len))
+			goto fail;
+
+		da_push_back(snap->strings, &cur);
+		cur += len + 1;
+	}
+
+	if (validate_snapshot_object(cur, end, num_strings, 0) != end)
+		goto fail;
+
+	return snapshot_object(snap, cur, strings);
+
+fail:
+	da_resize(snap->strings, strings);
+	return NULL;
+}
+
+static const uint8_t *read_snapshot_name(const uint8_t *cur,
+					 const uint8_t *end, const char **name)
+{
+	uint32_t len;
+
+	if (end - cur < 4)
+		return NULL;
+
+	len = read_u32(cur);
+	cur += 4;
+
+	if ((size_t)(end - cur) <= len || cur[len] != 0 || memchr(cur, 0, len))
+		return NULL;
+
+	*name = (const char *)cur;
+	return cur + len + 1;
+}
+
+static void resize_snapshot_array(obs_data_t *data, const char *name,
+				  size_t size)
+{
+	obs_data_array_t *array = obs_data_get_array(data, name);
+
+	if (!array) {
+		array = obs_data_array_create();
+		obs_data_set_array(data, name, array);
+	}
+
+	while (array->objects.num > size)
+		obs_data_array_erase(array, array->objects.num - 1);
+
+	while (array->objects.num < size) {
+		obs_data_t *obj = obs_data_create();
+		obs_data_array_push_back(array, obj);
+		obs_data_release(obj);
+	}
+
+	obs_data_array_release(array);
+}
+
+static bool apply_snapshot_record(struct obs_data_snapshot *snap,
+				  obs_data_t **root, uint8_t type,
+				  const uint8_t *cur, const uint8_t *end)
+{
+	obs_data_array_t *array;
+	const char *name;
+	obs_data_t *obj;
+	uint32_t idx;
+
+	if (type == SNAPSHOT_RECORD_FULL) {
+		obj = read_snapshot_blob(snap, cur, end);
+		if (!obj)
+			return false;
+
+		obs_data_release(*root);
+		*root = obj;
+		return true;
+	}
+
+	/* changes can only be applied on top of a full record */
+	if (!*root)
+		return false;
+
+	switch (type) {
+	case SNAPSHOT_RECORD_SET:
+		obj = read_snapshot_blob(snap, cur, end);
+		if (!obj)
+			return false;
+
+		obs_data_apply(*root, obj);
+		obs_data_release(obj);
+		return true;
+
+	case SNAPSHOT_RECORD_ERASE:
+		if (read_snapshot_name(cur, end, &name) != end)
+			return false;
+
+		obs_data_erase(*root, name);
+		return true;
+
+	case SNAPSHOT_RECORD_ARRAY_SIZE:
+		cur = read_snapshot_name(cur, end, &name);
+		if (!cur || end - cur != 4)
+			return false;
+
+		resize_snapshot_array(*root, name, read_u32(cur));
+		return true;
+
+	case SNAPSHOT_RECORD_ARRAY_ITEM:
+		cur = read_snapshot_name(cur, end, &name);
+		if (!cur || end - cur < 4)
+			return false;
+
+		idx = read_u32(cur);
+		array = obs_data_get_array(*root, name);
+		if (!array || idx >= array->objects.num) {
+			obs_data_array_release(array);
+			return false;
+		}
+
+		obj = read_snapshot_blob(snap, cur + 4, end);
+		if (obj) {
+			obs_data_release(array->objects.array[idx]);
+			array->objects.array[idx] = obj;
+		}
+
+		obs_data_array_release(array);
+		return obj != NULL;
+	}
+
+	return false;
+}
+
+static obs_data_t *read_snapshot(struct obs_data_snapshot *snap,
+				 const uint8_t *data, size_t size,
+				 const char *file)
+{
+	const uint8_t *cur = data + SNAPSHOT_HEADER_SIZE;
+	const uint8_t *end = data + size;
+	obs_data_t *root = NULL;
+
+	if (size < SNAPSHOT_HEADER_SIZE ||
+	    memcmp(data, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+		blog(LOG_ERROR, "obs-data.c: '%s' is not a snapshot file", file);
+		return NULL;
+	}
+
+	if (read_u32(data + 8) != SNAPSHOT_VERSION) {
+		blog(LOG_ERROR,
+		     "obs-data.c: Snapshot file '%s' has unsupported version %u",
+		     file, read_u32(data + 8));
+		return NULL;
+	}
+
+	while (cur != end) {
+		const uint8_t *record_end;
+		uint8_t type;
+
+		/* a record that was cut short was being appended while the
+		 * program exited, everything before it is still valid */
+		if (end - cur < SNAPSHOT_RECORD_HEADER_SIZE ||
+		    (size_t)(end - cur) - SNAPSHOT_RECORD_HEADER_SIZE <
+			    read_u32(cur + 1)) {
+			blog(LOG_WARNING,
+			     "obs-data.c: Snapshot file '%s' ends with an "
+			     "incomplete record",
+			     file);
+			break;
+		}
+
+		type = cur[0];
+		record_end = cur + SNAPSHOT_RECORD_HEADER_SIZE +
+			     read_u32(cur + 1);
+
+		if (!apply_snapshot_record(snap, &root, type,
+					   cur + SNAPSHOT_RECORD_HEADER_SIZE,
+					   record_end)) {
+			blog(LOG_WARNING,
+			     "obs-data.c: Snapshot file '%s' has an invalid "
+			     "record at offset %zu, ignoring the rest",
+			     file, (size_t)(cur - data));
+			break;
+		}
+
+		cur = record_end;
+	}
+
+	if (!root)
+		blog(LOG_ERROR, "obs-data.c: Snapshot file '%s' is empty",
+		     file);
+
+	return root;
+}
+
+obs_data_t *obs_data_create_from_binary_file(const char *file)
+{
+	struct obs_data_snapshot *snap = bzalloc(sizeof(*snap));
+	const uint8_t *data;
+	obs_data_t *root;
+	size_t size;
+
+	snap->ref = 1;
+
+#ifdef _WIN32
+	/* a mapped file can't be replaced on windows, and objects that are
+	 * never used would keep it mapped, so it's read into memory instead */
+	FILE *f = os_fopen(file, "rb");
+	int64_t file_size = f ? os_fgetsize(f) : -1;
+
+	if (file_size > 0 && (uint64_t)file_size <= SIZE_MAX) {
+		snap->buffer = bmalloc((size_t)file_size);
+		if (fread(snap->buffer, 1, (size_t)file_size, f) !=
+		    (size_t)file_size) {
+			bfree(snap->buffer);
+			snap->buffer = NULL;
+		}
+	}
+
+	if (f)
+		fclose(f);
+
+	data = snap->buffer;
+	size = (size_t)file_size;
+#else
+	snap->file = os_map_file(file);
+	data = snap->file ? snap->file->data : NULL;
+	size = snap->file ? snap->file->size : 0;
+#endif
+
+	root = data ? read_snapshot(snap, data, size, file) : NULL;
+	snapshot_release(snap);
+	return root;
+}
+
+/* ------------------------------------------------------------------------- */
+/* Snapshot writing */
+
+struct snapshot_string {
+	UT_hash_handle hh;
+	uint32_t idx;
+};
+
+struct snapshot_encoder {
+	struct array_output_data strings_data;
+	struct array_output_data tree_data;
+	struct serializer strings;
+	struct serializer tree;
+
+	struct snapshot_string *table;
+	uint32_t num_strings;
+};
+
+static void encoder_init(struct snapshot_encoder *enc)
+{
+	memset(enc, 0, sizeof(*enc));
+	array_output_serializer_init(&enc->strings, &enc->strings_data);
+	array_output_serializer_init(&enc->tree, &enc->tree_data);
+}
+
+static void encoder_reset(struct snapshot_encoder *enc)
+{
+	struct snapshot_string *str, *temp;
+
+	HASH_ITER (hh, enc->table, str, temp) {
+		HASH_DEL(enc->table, str);
+		bfree(str);
+	}
+
+	enc->num_strings = 0;
+	enc->strings_data.bytes.num = 0;
+	enc->tree_data.bytes.num = 0;
+}
+
+static void encoder_free(struct snapshot_encoder *enc)
+{
+	encoder_reset(enc);
+	array_output_serializer_free(&enc->strings_data);
+	array_output_serializer_free(&enc->tree_data);
+}
+
+static uint32_t encoder_intern(struct snapshot_encoder *enc, const char *str)
+{
+	struct snapshot_string *entry;
+	size_t len = strlen(str);
+
+	HASH_FIND(hh, enc->table, str, len, entry);
+	if (entry)
+		return entry->idx;
+
+	/* the key is stored right after the entry */
+	entry = bmalloc(sizeof(*entry) + len + 1);
+	memcpy(entry + 1, str, len + 1);
+	entry->idx = enc->num_strings++;
+	HASH_ADD_KEYPTR(hh, enc->table, (const char *)(entry + 1), len, entry);
+
+	s_wl32(&enc->strings, (uint32_t)len);
+	s_write(&enc->strings, str, len + 1);
+	return entry->idx;
+}
+
+static inline void patch_u32(struct array_output_data *data, size_t pos,
+			     uint32_t val)
+{
+	uint8_t *ptr = data->bytes.array + pos;
+	ptr[0] = (uint8_t)val;
+	ptr[1] = (uint8_t)(val >> 8);
+	ptr[2] = (uint8_t)(val >> 16);
+	ptr[3] = (uint8_t)(val >> 24);
+}
+
+static void encode_object(struct snapshot_encoder *enc, obs_data_t *data);
+
+static void encode_item(struct snapshot_encoder *enc, obs_data_item_t *item)
+{
+	struct serializer *s = &enc->tree;
+	obs_data_array_t *array;
+	size_t start;
+
+	s_wl32(s, encoder_intern(enc, get_item_name(item)));
+
+	switch (item->type) {
+	case OBS_DATA_STRING:
+		s_w8(s, SNAPSHOT_STRING);
+		s_wl32(s, encoder_intern(enc, obs_data_item_get_string(item)));
+		break;
+
+	case OBS_DATA_NUMBER:
+		if (obs_data_item_numtype(item) == OBS_DATA_NUM_INT) {
+			s_w8(s, SNAPSHOT_INT);
+			s_wl64(s, (uint64_t)obs_data_item_get_int(item));
+		} else {
+			s_w8(s, SNAPSHOT_DOUBLE);
+			s_wld(s, obs_data_item_get_double(item));
+		}
+		break;
+
+	case OBS_DATA_BOOLEAN:
+		s_w8(s, SNAPSHOT_BOOL);
+		s_w8(s, obs_data_item_get_bool(item));
+		break;
+
+	case OBS_DATA_OBJECT:
+		s_w8(s, SNAPSHOT_OBJECT);
+		encode_object(enc, get_item_obj(item));
+		break;
+
+	case OBS_DATA_ARRAY:
+		array = get_item_array(item);
+		start = enc->tree_data.bytes.num;
+
+		s_w8(s, SNAPSHOT_ARRAY);
+		s_wl32(s, 0);
+		s_wl32(s, array ? (uint32_t)array->objects.num : 0);
+
+		for (size_t i = 0; array && i < array->objects.num; i++)
+			encode_object(enc, array->objects.array[i]);
+
+		patch_u32(&enc->tree_data, start + 1,
+			  (uint32_t)(enc->tree_data.bytes.num - start - 5));
+		break;
+
+	case OBS_DATA_NULL:
+		break;
+	}
+}
+
+static inline bool snapshot_item_valid(obs_data_item_t *item)
+{
+	return item->type != OBS_DATA_NULL &&
+	       obs_data_item_has_user_value(item);
+}
+
+static void encode_object(struct snapshot_encoder *enc, obs_data_t *data)
+{
+	size_t start = enc->tree_data.bytes.num;
+	uint32_t count = 0;
+
+	s_wl32(&enc->tree, 0);
+	s_wl32(&enc->tree, 0);
+
+	if (data) {
+		struct obs_data_item *item, *temp;
+
+		obs_data_materialize(data);
+
+		HASH_ITER (hh, data->items, item, temp) {
+			if (snapshot_item_valid(item)) {
+				encode_item(enc, item);
+				count++;
+			}
+		}
+	}
+
+	patch_u32(&enc->tree_data, start,
+		  (uint32_t)(enc->tree_data.bytes.num - start - 4));
+	patch_u32(&enc->tree_data, start + 4, count);
+}
+
+/* encodes a blob holding a single item */
+static void encode_item_blob(struct snapshot_encoder *enc,
+			     obs_data_item_t *item)
+{
+	encoder_reset(enc);
+
+	s_wl32(&enc->tree, 0);
+	s_wl32(&enc->tree, 1);
+	encode_item(enc, item);
+
+	patch_u32(&enc->tree_data, 0,
+		  (uint32_t)(enc->tree_data.bytes.num - 4));
+}
+
+static inline size_t encoder_blob_size(struct snapshot_encoder *enc)
+{
+	return 4 + enc->strings_data.bytes.num + enc->tree_data.bytes.num;
+}
+
+static void write_blob(struct serializer *s, struct snapshot_encoder *enc)
+{
+	s_wl32(s, enc->num_strings);
+	s_write(s, enc->strings_data.bytes.array, enc->strings_data.bytes.num);
+	s_write(s, enc->tree_data.bytes.array, enc->tree_data.bytes.num);
+}
+
+static void write_record_header(struct serializer *s, uint8_t type,
+				size_t size)
+{
+	s_w8(s, type);
+	s_wl32(s, (uint32_t)size);
+}
+
+static void write_snapshot_name(struct serializer *s, const char *name)
+{
+	size_t len = strlen(name);
+	s_wl32(s, (uint32_t)len);
+	s_write(s, name, len + 1);
+}
+
+static inline size_t snapshot_name_size(const char *name)
+{
+	return 4 + strlen(name) + 1;
+}
+
+static void write_snapshot_header(struct serializer *s)
+{
+	s_write(s, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	s_wl32(s, SNAPSHOT_VERSION);
+}
+
+static bool save_full_snapshot(obs_data_t *data, const char *file,
+			       const char *temp_ext, const char *backup_ext,
+			       size_t *size)
+{
+	struct snapshot_encoder enc;
+	struct array_output_data out;
+	struct serializer s;
+	bool success;
+
+	encoder_init(&enc);
+	encode_object(&enc, data);
+
+	array_output_serializer_init(&s, &out);
+	write_snapshot_header(&s);
+	write_record_header(&s, SNAPSHOT_RECORD_FULL, encoder_blob_size(&enc));
+	write_blob(&s, &enc);
+	encoder_free(&enc);
+
+	success = os_quick_write_utf8_file_safe(file,
+						(const char *)out.bytes.array,
+						out.bytes.num, false, temp_ext,
+						backup_ext);
+	if (size)
+		*size = out.bytes.num;
+
+	array_output_serializer_free(&out);
+	return success;
+}
+
+bool obs_data_save_binary_safe(obs_data_t *data, const char *file,
+			       const char *temp_ext, const char *backup_ext)
+{
+	if (!data || !file)
+		return false;
+
+	return save_full_snapshot(data, file, temp_ext, backup_ext, NULL);
+}
+
+/* ------------------------------------------------------------------------- */
+/* Incremental snapshot writer */
+
+struct writer_item {
+	UT_hash_handle hh;
+	char *name;
+	uint64_t hash;
+	bool seen;
+
+	/* arrays are tracked per element instead */
+	bool is_array;
+	DARRAY(uint64_t) elements;
+};
+
+struct obs_data_writer {
+	char *file;
+	struct writer_item *items;
+
+	/* whether the items above match the file */
+	bool valid;
+	size_t full_size;
+	size_t file_size;
+};
+
+obs_data_writer_t *obs_data_writer_create(const char *file)
+{
+	obs_data_writer_t *writer;
+
+	if (!file)
+		return NULL;
+
+	writer = bzalloc(sizeof(*writer));
+	writer->file = bstrdup(file);
+	return writer;
+}
+
+static void writer_item_destroy(struct writer_item *item)
+{
+	da_free(item->elements);
+	bfree(item->name);
+	bfree(item);
+}
+
+static void writer_clear(obs_data_writer_t *writer)
+{
+	struct writer_item *item, *temp;
+
+	HASH_ITER (hh, writer->items, item, temp) {
+		HASH_DEL(writer->items, item);
+		writer_item_destroy(item);
+	}
+
+	writer->valid = false;
+}
+
+void obs_data_writer_destroy(obs_data_writer_t *writer)
+{
+	if (writer) {
+		writer_clear(writer);
+		bfree(writer->file);
+		bfree(writer);
+	}
+}
+
+static uint64_t hash_bytes(uint64_t hash, const uint8_t *data, size_t size)
+{
+	for (size_t i = 0; i < size; i++) {
+		hash ^= data[i];
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static uint64_t encoder_hash(struct snapshot_encoder *enc)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	hash = hash_bytes(hash, enc->strings_data.bytes.array,
+			  enc->strings_data.bytes.num);
+	return hash_bytes(hash, enc->tree_data.bytes.array,
+			  enc->tree_data.bytes.num);
+}
+
+static struct writer_item *writer_get_item(obs_data_writer_t *writer,
+					   const char *name)
+{
+	struct writer_item *item;
+
+	HASH_FIND_STR(writer->items, name, item);
+	if (!item) {
+		item = bzalloc(sizeof(*item));
+		item->name = bstrdup(name);
+		HASH_ADD_STR(writer->items, name, item);
+	}
+
+	return item;
+}
+
+static void write_blob_record(struct serializer *s, uint8_t type,
+			      struct snapshot_encoder *enc)
+{
+	write_record_header(s, type, encoder_blob_size(enc));
+	write_blob(s, enc);
+}
+
+/* writes the elements of an array that changed, and updates their hashes */
+static void write_array_changes(struct serializer *s,
+				struct snapshot_encoder *enc,
+				struct writer_item *state, obs_data_item_t *item)
+{
+	obs_data_array_t *array = get_item_array(item);
+	size_t count = array ? array->objects.num : 0;
+	size_t old_count = state->is_array ? state->elements.num : 0;
+	const char *name = state->name;
+
+	if (!state->is_array || count != old_count) {
+		write_record_header(s, SNAPSHOT_RECORD_ARRAY_SIZE,
+				    snapshot_name_size(name) + 4);
+		write_snapshot_name(s, name);
+		s_wl32(s, (uint32_t)count);
+	}
+
+	da_resize(state->elements, count);
+
+	for (size_t i = 0; i < count; i++) {
+		uint64_t hash;
+
+		encoder_reset(enc);
+		encode_object(enc, array->objects.array[i]);
+		hash = encoder_hash(enc);
+
+		if (i < old_count && hash == state->elements.array[i])
+			continue;
+
+		write_record_header(s, SNAPSHOT_RECORD_ARRAY_ITEM,
+				    snapshot_name_size(name) + 4 +
+					    encoder_blob_size(enc));
+		write_snapshot_name(s, name);
+		s_wl32(s, (uint32_t)i);
+		write_blob(s, enc);
+
+		state->elements.array[i] = hash;
+	}
+
+	state->is_array = true;
+}
+
+/* writes the records needed to bring the file up to date with `data` */
+static void write_changes(obs_data_writer_t *writer, obs_data_t *data,
+			  struct serializer *s)
+{
+	struct snapshot_encoder enc;
+	struct obs_data_item *item, *temp;
+	struct writer_item *state, *state_temp;
+	uint64_t hash;
+
+	encoder_init(&enc);
+	obs_data_materialize(data);
+
+	HASH_ITER (hh, data->items, item, temp) {
+		if (!snapshot_item_valid(item))
+			continue;
+
+		state = writer_get_item(writer, get_item_name(item));
+		state->seen = true;
+
+		/* array elements are compared one by one, so that a change to
+		 * one of them doesn't rewrite the whole array */
+		if (item->type == OBS_DATA_ARRAY) {
+			write_array_changes(s, &enc, state, item);
+			continue;
+		}
+
+		encode_item_blob(&enc, item);
+		hash = encoder_hash(&enc);
+
+		if (state->is_array || hash != state->hash) {
+			write_blob_record(s, SNAPSHOT_RECORD_SET, &enc);
+			state->hash = hash;
+			state->is_array = false;
+		}
+	}
+
+	HASH_ITER (hh, writer->items, state, state_temp) {
+		if (!state->seen) {
+			write_record_header(s, SNAPSHOT_RECORD_ERASE,
+					    snapshot_name_size(state->name));
+			write_snapshot_name(s, state->name);
+
+			HASH_DEL(writer->items, state);
+			writer_item_destroy(state);
+		} else {
+			state->seen = false;
+		}
+	}
+
+	encoder_free(&enc);
+}
+
+static bool append_to_file(const char *file, const void *data, size_t size)
+{
+	FILE *f = os_fopen(file, "ab");
+	bool success;
+
+	if (!f)
+		return false;
+
+	success = fwrite(data, 1, size, f) == size;
+	success = fclose(f) == 0 && success;
+	return success;
+}
+
+bool obs_data_writer_save(obs_data_writer_t *writer, obs_data_t *data)
+{
+	struct array_output_data out;
+	struct serializer s;
+	bool success = true;
+
+	if (!writer || !data)
+		return false;
+
+	array_output_serializer_init(&s, &out);
+
+	/* the state is updated even if a full snapshot ends up being written,
+	 * since it describes the data that is in the file either way */
+	if (!writer->valid)
+		writer_clear(writer);
+	write_changes(writer, data, &s);
+
+	if (!writer->valid ||
+	    writer->file_size + out.bytes.num > writer->full_size * 2) {
+		success = save_full_snapshot(data, writer->file, "tmp", NULL,
+					     &writer->full_size);
+		writer->file_size = writer->full_size;
+
+	} else if (out.bytes.num) {
+		success = append_to_file(writer->file, out.bytes.array,
+					 out.bytes.num);
+		writer->file_size += out.bytes.num;
+	}
+
+	writer->valid = success;
+	array_output_serializer_free(&out);
+	return success;
+}
@@ -66,6 +66,17 @@ EXPORT obs_data_t *obs_data_create_from_json(const char *json_string);
 EXPORT obs_data_t *obs_data_create_from_json_file(const char *json_file);
 EXPORT obs_data_t *obs_data_create_from_json_file_safe(const char *json_file,
 						       const char *backup_ext);
+
+/**
+ * Called for each object of an array at the root of a JSON file as soon as the
+ * object has been parsed, before the rest of the file is read.
+ */
+typedef void (*obs_data_json_object_cb)(void *param, const char *array_name,
+					obs_data_t *obj);
+
+EXPORT obs_data_t *
+obs_data_create_from_json_file_cb(const char *json_file,
+				  obs_data_json_object_cb cb, void *param);
 EXPORT void obs_data_addref(obs_data_t *data);
 EXPORT void obs_data_release(obs_data_t *data);
 
@@ -80,6 +91,26 @@ EXPORT bool obs_data_save_json_pretty_safe(obs_data_t *data, const char *file,
 					   const char *temp_ext,
 					   const char *backup_ext);
 
+/**
+ * Binary snapshots are faster to load than JSON, and objects loaded from them
+ * are only decoded once they are used.  Only user values are stored.
+ */
+EXPORT obs_data_t *obs_data_create_from_binary_file(const char *file);
+EXPORT bool obs_data_save_binary_safe(obs_data_t *data, const char *file,
+				      const char *temp_ext,
+				      const char *backup_ext);
+
+/**
+ * Saves an object to a binary snapshot file repeatedly.  After the first save,
+ * only the root items and array elements that changed since the last save are
+ * appended to the file.
+ */
+typedef struct obs_data_writer obs_data_writer_t;
+
+EXPORT obs_data_writer_t *obs_data_writer_create(const char *file);
+EXPORT void obs_data_writer_destroy(obs_data_writer_t *writer);
+EXPORT bool obs_data_writer_save(obs_data_writer_t *writer, obs_data_t *data);
+
 EXPORT void obs_data_apply(obs_data_t *target, obs_data_t *apply_data);
 
 EXPORT void obs_data_erase(obs_data_t *data, const char *name);
@@ -0,0 +1,214 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "util/circlebuf.h"
+#include "obs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Fan-out queue
+ *
+ * A single queue of interleaved encoder packets shared by any number of
+ * readers.  Every packet gets a sequence number, and each reader keeps its
+ * own cursor into the queue, so readers never wait on each other.  Packets
+ * are released once every cursor has moved past them.
+ *
+ * Readers can join in the middle of the stream, so a cursor waits for a
+ * keyframe on every video track and rebases timestamps to start at its first
+ * keyframe.  A cursor that falls further behind than its backlog limit skips
+ * to the newest keyframe of the first video track.
+ */
+
+struct fanout_queue {
+	struct circlebuf packets; /* struct encoder_packet */
+	uint64_t first_seq;
+};
+
+struct fanout_cursor {
+	uint64_t seq;
+	int64_t base_usec;
+	int64_t max_backlog_usec;
+	bool started;
+	bool received_video[MAX_OUTPUT_VIDEO_ENCODERS];
+};
+
+static inline size_t fanout_queue_count(const struct fanout_queue *q)
+{
+	return q->packets.size / sizeof(struct encoder_packet);
+}
+
+static inline uint64_t fanout_queue_end_seq(const struct fanout_queue *q)
+{
+	return q->first_seq + fanout_queue_count(q);
+}
+
+static inline struct encoder_packet *
+fanout_queue_packet(struct fanout_queue *q, uint64_t seq)
+{
+	size_t idx = (size_t)(seq - q->first_seq);
+	return (struct encoder_packet *)circlebuf_data(
+		&q->packets, idx * sizeof(struct encoder_packet));
+}
+
+/* takes ownership of the packet's reference */
+static inline void fanout_queue_push(struct fanout_queue *q,
+				     const struct encoder_packet *packet)
+{
+	circlebuf_push_back(&q->packets, packet, sizeof(*packet));
+}
+
+/* releases all packets before min_seq */
+static inline void fanout_queue_trim(struct fanout_queue *q, uint64_t min_seq)
+{
+	struct encoder_packet packet;
+
+	while (q->first_seq < min_seq && q->packets.size) {
+		circlebuf_pop_front(&q->packets, &packet, sizeof(packet));
+		obs_encoder_packet_release(&packet);
+		q->first_seq++;
+	}
+}
+
+static inline void fanout_queue_free(struct fanout_queue *q)
+{
+	fanout_queue_trim(q, fanout_queue_end_seq(q));
+	circlebuf_free(&q->packets);
+}
+
+/* joins the queue at its current end, keeping the backlog limit */
+static inline void fanout_cursor_reset(struct fanout_cursor *c,
+				       const struct fanout_queue *q)
+{
+	c->seq = fanout_queue_end_seq(q);
+	c->base_usec = 0;
+	c->started = false;
+
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++)
+		c->received_video[i] = false;
+}
+
+/* jumps the cursor to the newest keyframe of the first video track, or to
+ * the end of the queue if there isn't one, and waits for a keyframe on every
+ * video track again.  returns the number of video frames skipped. */
+static inline long fanout_cursor_skip_backlog(struct fanout_cursor *c,
+					      struct fanout_queue *q)
+{
+	uint64_t end_seq = fanout_queue_end_seq(q);
+	uint64_t target = end_seq;
+	long dropped = 0;
+
+	for (uint64_t seq = end_seq; seq > c->seq; seq--) {
+		struct encoder_packet *packet = fanout_queue_packet(q, seq - 1);
+
+		if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe &&
+		    packet->track_idx == 0) {
+			target = seq - 1;
+			break;
+		}
+	}
+
+	for (uint64_t seq = c->seq; seq < target; seq++) {
+		struct encoder_packet *packet = fanout_queue_packet(q, seq);
+		if (packet->type == OBS_ENCODER_VIDEO)
+			dropped++;
+	}
+
+	c->seq = target;
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++)
+		c->received_video[i] = false;
+
+	return dropped;
+}
+
+/* returns the next packet for the cursor and moves past it, skipping the
+ * backlog first if the cursor has fallen too far behind.  the packet stays
+ * owned by the queue. */
+static inline struct encoder_packet *
+fanout_cursor_next(struct fanout_cursor *c, struct fanout_queue *q,
+		   long *dropped)
+{
+	uint64_t end_seq = fanout_queue_end_seq(q);
+	struct encoder_packet *packet;
+	struct encoder_packet *newest;
+
+	*dropped = 0;
+
+	if (c->seq >= end_seq)
+		return NULL;
+
+	if (c->max_backlog_usec) {
+		packet = fanout_queue_packet(q, c->seq);
+		newest = fanout_queue_packet(q, end_seq - 1);
+
+		if (newest->dts_usec - packet->dts_usec > c->max_backlog_usec) {
+			*dropped = fanout_cursor_skip_backlog(c, q);
+			if (c->seq >= end_seq)
+				return NULL;
+		}
+	}
+
+	return fanout_queue_packet(q, c->seq++);
+}
+
+/* waits for keyframes and rebases the timestamps of a copy of the cursor's
+ * packet.  returns false if the packet isn't sent, with dropped set if it was
+ * a video frame that had to be thrown away. */
+static inline bool fanout_cursor_prepare(struct fanout_cursor *c,
+					 struct encoder_packet *packet,
+					 bool *dropped)
+{
+	int64_t offset;
+
+	*dropped = false;
+
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		if (!c->received_video[packet->track_idx]) {
+			if (!packet->keyframe ||
+			    (!c->started && packet->track_idx != 0)) {
+				*dropped = true;
+				return false;
+			}
+
+			c->received_video[packet->track_idx] = true;
+		}
+
+		if (!c->started) {
+			c->base_usec = packet->dts_usec;
+			c->started = true;
+		}
+
+	} else if (!c->started || packet->dts_usec < c->base_usec) {
+		return false;
+	}
+
+	offset = c->base_usec * packet->timebase_den /
+		 (1000000LL * packet->timebase_num);
+
+	packet->dts -= offset;
+	packet->pts -= offset;
+	packet->dts_usec -= c->base_usec;
+	return true;
+}
+
+#ifdef __cplusplus
+}
+#endif
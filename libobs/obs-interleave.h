@@ -0,0 +1,200 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "util/circlebuf.h"
+#include "obs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Interleave queue
+ *
+ * Holds one FIFO of encoder packets per encoder track.  Encoders emit packets
+ * in DTS order, so every FIFO is always sorted and adding a packet is a push
+ * to the back of its track.  The next packet in interleaved order is the
+ * smallest head of all tracks (a k-way merge), so neither adding nor removing
+ * packets ever moves other packets around.
+ *
+ * Packets with equal DTS are ordered video first, then by track index.
+ */
+
+#define INTERLEAVE_MAX_TRACKS \
+	(MAX_OUTPUT_VIDEO_ENCODERS + MAX_OUTPUT_AUDIO_ENCODERS)
+
+struct interleave_queue {
+	struct circlebuf tracks[INTERLEAVE_MAX_TRACKS]; /* encoder_packet */
+	size_t num;
+};
+
+static inline size_t interleave_track(enum obs_encoder_type type,
+				      size_t track_idx)
+{
+	return type == OBS_ENCODER_VIDEO
+		       ? track_idx
+		       : MAX_OUTPUT_VIDEO_ENCODERS + track_idx;
+}
+
+static inline size_t interleave_track_count(const struct interleave_queue *q,
+					    size_t track)
+{
+	return q->tracks[track].size / sizeof(struct encoder_packet);
+}
+
+static inline struct encoder_packet *
+interleave_track_packet(struct interleave_queue *q, size_t track, size_t idx)
+{
+	return (struct encoder_packet *)circlebuf_data(
+		&q->tracks[track], idx * sizeof(struct encoder_packet));
+}
+
+/* returns true if packet a is sent before packet b */
+static inline bool interleave_packet_before(const struct encoder_packet *a,
+					    const struct encoder_packet *b)
+{
+	if (a->dts_usec != b->dts_usec)
+		return a->dts_usec < b->dts_usec;
+	if (a->type != b->type)
+		return a->type == OBS_ENCODER_VIDEO;
+	return a->track_idx < b->track_idx;
+}
+
+static inline void interleave_queue_push(struct interleave_queue *q,
+					 const struct encoder_packet *packet)
+{
+	size_t track = interleave_track(packet->type, packet->track_idx);
+
+	circlebuf_push_back(&q->tracks[track], packet, sizeof(*packet));
+	q->num++;
+}
+
+/* returns the track holding the next packet, or -1 if the queue is empty */
+static inline int interleave_queue_first_track(struct interleave_queue *q)
+{
+	struct encoder_packet *first = NULL;
+	int first_track = -1;
+
+	for (size_t i = 0; i < INTERLEAVE_MAX_TRACKS; i++) {
+		struct encoder_packet *head;
+
+		if (!q->tracks[i].size)
+			continue;
+
+		head = interleave_track_packet(q, i, 0);
+		if (!first || interleave_packet_before(head, first)) {
+			first = head;
+			first_track = (int)i;
+		}
+	}
+
+	return first_track;
+}
+
+static inline struct encoder_packet *
+interleave_queue_peek(struct interleave_queue *q)
+{
+	int track = interleave_queue_first_track(q);
+	return track != -1 ? interleave_track_packet(q, track, 0) : NULL;
+}
+
+static inline bool interleave_queue_pop(struct interleave_queue *q,
+					struct encoder_packet *packet)
+{
+	int track = interleave_queue_first_track(q);
+	if (track == -1)
+		return false;
+
+	circlebuf_pop_front(&q->tracks[track], packet, sizeof(*packet));
+	q->num--;
+	return true;
+}
+
+/* first packet of a specific encoder track */
+static inline struct encoder_packet *
+interleave_queue_head(struct interleave_queue *q, enum obs_encoder_type type,
+		      size_t track_idx)
+{
+	size_t track = interleave_track(type, track_idx);
+	return q->tracks[track].size ? interleave_track_packet(q, track, 0)
+				     : NULL;
+}
+
+/* last packet of a specific encoder track */
+static inline struct encoder_packet *
+interleave_queue_tail(struct interleave_queue *q, enum obs_encoder_type type,
+		      size_t track_idx)
+{
+	size_t track = interleave_track(type, track_idx);
+	size_t count = interleave_track_count(q, track);
+	return count ? interleave_track_packet(q, track, count - 1) : NULL;
+}
+
+/* number of packets that come before a packet in interleaved order */
+static inline size_t
+interleave_queue_count_before(struct interleave_queue *q,
+			      const struct encoder_packet *packet)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < INTERLEAVE_MAX_TRACKS; i++) {
+		size_t track_count = interleave_track_count(q, i);
+
+		for (size_t j = 0; j < track_count; j++) {
+			struct encoder_packet *cur =
+				interleave_track_packet(q, i, j);
+			if (!interleave_packet_before(cur, packet))
+				break;
+			count++;
+		}
+	}
+
+	return count;
+}
+
+/* releases the first count packets in interleaved order */
+static inline void interleave_queue_discard(struct interleave_queue *q,
+					    size_t count)
+{
+	struct encoder_packet packet;
+
+	while (count-- && interleave_queue_pop(q, &packet))
+		obs_encoder_packet_release(&packet);
+}
+
+static inline void interleave_queue_free(struct interleave_queue *q)
+{
+	struct encoder_packet packet;
+
+	for (size_t i = 0; i < INTERLEAVE_MAX_TRACKS; i++) {
+		while (q->tracks[i].size) {
+			circlebuf_pop_front(&q->tracks[i], &packet,
+					    sizeof(packet));
+			obs_encoder_packet_release(&packet);
+		}
+
+		circlebuf_free(&q->tracks[i]);
+	}
+
+	q->num = 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -25,6 +25,7 @@
 #include "util/platform.h"
 #include "util/profiler.h"
 #include "util/task.h"
+#include "util/worker-pool.h"
 #include "util/uthash.h"
 #include "callback/signal.h"
 #include "callback/proc.h"
@@ -37,6 +38,9 @@
 #include "media-io/audio-io.h"
 
 #include "obs.h"
+#include "obs-interleave.h"
+#include "obs-fanout.h"
+#include "obs-audio-buffering.h"
 
 #include <obsversion.h>
 #include <caption/caption.h>
@@ -339,6 +343,8 @@ struct obs_core_video {
 	pthread_t video_thread;
 	uint32_t total_frames;
 	uint32_t lagged_frames;
+	volatile long render_cache_hits;
+	volatile long render_cache_misses;
 	bool thread_initialized;
 
 	gs_texture_t *transparent_texture;
@@ -365,23 +371,61 @@ struct obs_core_video {
 
 struct audio_monitor;
 
+struct audio_render_edge {
+	size_t parent;
+	size_t child;
+};
+
 struct obs_core_audio {
 	audio_t *audio;
 
+	/* the sources rendered in the current tick, sorted by level, with
+	 * references held until the end of the tick */
 	DARRAY(struct obs_source *) render_order;
 	DARRAY(struct obs_source *) root_nodes;
-
-	uint64_t buffered_ts;
-	struct circlebuf buffered_timestamps;
-	uint64_t buffering_wait_ticks;
-	int total_buffering_ticks;
-	int max_buffering_ticks;
+	uint64_t render_tick;
+
+	/* the audio tree as a dependency graph: every source is rendered
+	 * after all of its children, level by level.  it is only rebuilt
+	 * when obs->data.audio_tree_generation changes or a source turns
+	 * out to be missing; other ticks take references from tree_sources
+	 * (in render order), tree_roots indexes the output channels in it,
+	 * and level_offsets holds the start of every level */
+	DARRAY(obs_weak_source_t *) tree_sources;
+	DARRAY(size_t) tree_roots;
+	DARRAY(size_t) level_offsets;
+	long tree_generation;
+	bool tree_valid;
+	volatile bool tree_stale;
+
+	/* scratch space for building the tree: tree_nodes in enumeration
+	 * order, with tree_edges indexing into it */
+	DARRAY(struct obs_source *) tree_nodes;
+	DARRAY(struct audio_render_edge) tree_edges;
+	DARRAY(size_t) tree_levels;
+	uint64_t tree_build;
+
+	/* renders the sources of a level in parallel, kept separate so that
+	 * a level is never rendered inline because other work is using the
+	 * shared pool */
+	os_worker_pool_t *render_pool;
+
+	uint64_t render_time_total_ns;
+	uint32_t render_time_ticks;
+	size_t render_time_frames;
+	uint64_t avg_render_time_ns;
+
+	struct audio_buffering buffering;
 	bool fixed_buffer;
 
+	/* counters only, the rest is filled in on query */
+	struct obs_audio_buffering_stats buffering_stats;
+
 	pthread_mutex_t monitoring_mutex;
 	DARRAY(struct audio_monitor *) monitors;
 	char *monitoring_device_name;
 	char *monitoring_device_id;
+	uint32_t monitoring_latency_ms;
 
 	pthread_mutex_t task_mutex;
 	struct circlebuf tasks;
@@ -395,6 +439,7 @@ struct obs_core_data {
 
 	/* Linked lists */
 	struct obs_source *first_audio_source;
+	struct obs_source *first_tick_source;
 	struct obs_display *first_display;
 	struct obs_output *first_output;
 	struct obs_encoder *first_encoder;
@@ -406,8 +451,12 @@ struct obs_core_data {
 	pthread_mutex_t encoders_mutex;
 	pthread_mutex_t services_mutex;
 	pthread_mutex_t audio_sources_mutex;
+	pthread_mutex_t tick_sources_mutex;
 	pthread_mutex_t draw_callbacks_mutex;
 	DARRAY(struct draw_callback) draw_callbacks;
+
+	/* incremented whenever the audio tree may have changed */
+	volatile long audio_tree_generation;
 	DARRAY(struct rendered_callback) rendered_callbacks;
 	DARRAY(struct tick_callback) tick_callbacks;
 
@@ -421,6 +470,7 @@ struct obs_core_data {
 
 	DARRAY(char *) protocols;
 	DARRAY(obs_source_t *) sources_to_tick;
+	DARRAY(obs_source_t *) parallel_sources_to_tick;
 };
 
 /* user hotkeys */
@@ -489,11 +539,42 @@ struct obs_core {
 
 	os_task_queue_t *destruction_task_thread;
 
+	/* pool for the parallel ticks of the graphics thread, created the
+	 * first time it's needed */
+	os_worker_pool_t *worker_pool;
+
+	/* pool for deinterlacing async frames on the CPU, kept separate so
+	 * that the threads outputting frames never hold up the graphics
+	 * thread, and never fall back to deinterlacing inline because of
+	 * it.  created the first time it's needed */
+	os_worker_pool_t *deinterlace_pool;
+	pthread_mutex_t worker_pool_mutex;
+
+	/* whether the audio thread may render sources in parallel, kept
+	 * outside of obs_core_audio so it survives audio resets */
+	volatile bool parallel_audio_render;
+	volatile bool adaptive_audio_buffering;
+
+	/* whether scenes and filters may reuse unchanged renders, kept
+	 * outside of obs_core_video so it survives video resets */
+	volatile bool render_cache_enabled;
+
 	obs_task_handler_t ui_task_handler;
 };
 
 extern struct obs_core *obs;
 
+extern os_worker_pool_t *obs_get_worker_pool(void);
+extern os_worker_pool_t *obs_get_deinterlace_pool(void);
+
+/* has to be called after the change has been made, so that the audio thread
+ * doesn't rebuild its render order in between */
+static inline void obs_audio_tree_changed(void)
+{
+	if (obs)
+		os_atomic_inc_long(&obs->data.audio_tree_generation);
+}
+
 struct obs_graphics_context {
 	uint64_t last_time;
 	uint64_t interval;
@@ -724,6 +805,10 @@ struct obs_source {
 	/* hint to allow sources to render more quickly */
 	bool texcoords_centered;
 
+	/* incremented whenever the output of the source changes, only
+	 * meaningful for sources with OBS_SOURCE_STATIC_CONTENT */
+	volatile long content_generation;
+
 	/* timing (if video is present, is based upon video) */
 	volatile bool timing_set;
 	volatile uint64_t timing_adjust;
@@ -744,6 +829,19 @@ struct obs_source {
 	bool muted;
 	struct obs_source *next_audio_source;
 	struct obs_source **prev_next_audio_source;
+
+	/* position in the audio tree while it's built (valid for
+	 * audio_tree_build), and the audio tick it was last rendered in */
+	uint64_t audio_tree_build;
+	size_t audio_tree_idx;
+	uint64_t audio_render_tick;
+	volatile long audio_render_time_ns;
+
+	/* list of sources that are ticked every frame, see
+	 * obs_source_tick_list_add */
+	struct obs_source *next_tick_source;
+	struct obs_source **prev_next_tick_source;
+	const char *profile_tick_name;
 	uint64_t audio_ts;
 	struct circlebuf audio_input_buf[MAX_AUDIO_CHANNELS];
 	size_t last_audio_input_buf_size;
@@ -812,12 +910,24 @@ struct obs_source {
 	bool deinterlace_top_first;
 	bool deinterlace_rendered;
 
+	/* deinterlacing on the CPU as frames arrive, the previous frame is
+	 * only used by the thread outputting frames */
+	bool deinterlace_cpu;
+	volatile bool deinterlace_cpu_active;
+	struct obs_source_frame *deinterlace_cpu_prev;
+
 	/* filters */
 	struct obs_source *filter_parent;
 	struct obs_source *filter_target;
 	DARRAY(struct obs_source *) filters;
 	pthread_mutex_t filter_mutex;
 	gs_texrender_t *filter_texrender;
+	uint64_t filter_render_key;
+
+	/* pass of the per-pixel filters fused into this one's, and a hash of
+	 * the shaders it was built from */
+	gs_effect_t *fused_effect;
+	uint64_t fused_effect_key;
 	enum obs_allow_direct_render allow_direct;
 	bool rendering_filter;
 	bool filter_bypass_active;
@@ -899,6 +1009,20 @@ obs_source_create_set_last_ver(const char *id, const char *name,
 			       bool is_private);
 extern void obs_source_destroy(struct obs_source *source);
 
+/* creation split in steps, so that the create callbacks of sources that are
+ * loaded together can run in parallel: obs_source_create_deferred sets up the
+ * source without calling its create callback, obs_source_create_data calls
+ * it, and obs_source_create_finish adds the source to the source lists.
+ * obs_source_destroy_deferred frees a source that never got past the first
+ * step, without signalling anything. */
+extern obs_source_t *
+obs_source_create_deferred(const char *id, const char *name, const char *uuid,
+			   obs_data_t *settings, obs_data_t *hotkey_data,
+			   uint32_t last_obs_ver, bool private);
+extern void obs_source_create_data(obs_source_t *source);
+extern void obs_source_create_finish(obs_source_t *source);
+extern void obs_source_destroy_deferred(obs_source_t *source);
+
 enum view_type {
 	MAIN_VIEW,
 	AUX_VIEW,
@@ -987,6 +1111,11 @@ extern void obs_source_set_texcoords_centered(obs_source_t *source,
 extern void obs_source_activate(obs_source_t *source, enum view_type type);
 extern void obs_source_deactivate(obs_source_t *source, enum view_type type);
 extern void obs_source_video_tick(obs_source_t *source, float seconds);
+extern void obs_source_video_tick_state(obs_source_t *source, float seconds);
+extern void obs_source_call_video_tick(obs_source_t *source, float seconds);
+extern void obs_source_tick_list_add(obs_source_t *source);
+extern void obs_source_tick_list_remove(obs_source_t *source);
+extern void obs_source_tick_list_prune(obs_source_t *source);
 extern float obs_source_get_target_volume(obs_source_t *source,
 					  obs_source_t *target);
 
@@ -994,8 +1123,31 @@ extern void obs_source_audio_render(obs_source_t *source, uint32_t mixers,
 				    size_t channels, size_t sample_rate,
 				    size_t size);
 
+/* returns false if called on the audio thread for a source that wasn't
+ * rendered in the current tick, which makes the audio tree get rebuilt */
+extern bool obs_source_audio_rendered(const obs_source_t *source);
+
 extern void add_alignment(struct vec2 *v, uint32_t align, int cx, int cy);
 
+/* returns a value that changes whenever the rendered output of the source
+ * may have changed, or 0 if it has to be assumed to change every frame */
+extern uint64_t obs_source_get_content_generation(obs_source_t *source);
+extern uint64_t obs_scene_get_content_generation(obs_scene_t *scene);
+
+static inline uint64_t content_generation_mix(uint64_t gen, uint64_t val)
+{
+	gen = (gen ^ val) * 0x100000001b3ULL;
+	return gen ? gen : 1;
+}
+
+/* frames that libobs allocates and frees itself (the async frame cache,
+ * preload and deinterlace frames) take their buffers from the frame pool,
+ * and must be destroyed with obs_source_frame_destroy_pooled */
+extern struct obs_source_frame *
+obs_source_frame_create_pooled(enum video_format format, uint32_t width,
+			       uint32_t height);
+extern void obs_source_frame_destroy_pooled(struct obs_source_frame *frame);
+
 extern struct obs_source_frame *filter_async_video(obs_source_t *source,
 						   struct obs_source_frame *in);
 extern bool update_async_texture(struct obs_source *source,
@@ -1009,12 +1161,22 @@ extern bool set_async_texture_size(struct obs_source *source,
 				   const struct obs_source_frame *frame);
 extern void remove_async_frame(obs_source_t *source,
 			       struct obs_source_frame *frame);
+extern struct obs_source_frame *
+cache_async_frame(obs_source_t *source, const struct obs_source_frame *frame);
+extern void push_async_frame(obs_source_t *source,
+			     struct obs_source_frame *frame);
+extern void copy_frame_info(struct obs_source_frame *dst,
+			    const struct obs_source_frame *src);
 
 extern void set_deinterlace_texture_size(obs_source_t *source);
 extern void deinterlace_process_last_frame(obs_source_t *source,
 					   uint64_t sys_time);
 extern void deinterlace_update_async_video(obs_source_t *source);
 extern void deinterlace_render(obs_source_t *s);
+extern bool deinterlace_cpu_supported(const obs_source_t *source,
+				      const struct obs_source_frame *frame);
+extern void deinterlace_cpu_output(obs_source_t *source,
+				   const struct obs_source_frame *frame);
 
 /* ------------------------------------------------------------------------- */
 /* outputs  */
@@ -1059,6 +1221,8 @@ extern bool audio_pause_check(struct pause_data *pause, struct audio_data *data,
 			      size_t sample_rate);
 extern void pause_reset(struct pause_data *pause);
 
+#define FANOUT_DEFAULT_MAX_BACKLOG_USEC (3 * 1000000LL)
+
 struct obs_output {
 	struct obs_context_data context;
 	struct obs_output_info info;
@@ -1077,7 +1241,7 @@ struct obs_output {
 	pthread_t end_data_capture_thread;
 	os_event_t *stopping_event;
 	pthread_mutex_t interleaved_mutex;
-	DARRAY(struct encoder_packet) interleaved_packets;
+	struct interleave_queue interleaved_packets;
 	int stop_code;
 
 	int reconnect_retry_sec;
@@ -1143,6 +1307,22 @@ struct obs_output {
 	volatile bool delay_active;
 	volatile bool delay_capturing;
 
+	/* fan-out parent: packets shared with destination outputs */
+	pthread_mutex_t fanout_mutex;
+	struct fanout_queue fanout_queue;
+	DARRAY(struct obs_output *) fanout_destinations;
+	volatile long fanout_attached_count;
+
+	/* fan-out destination: sends from a cursor into the parent's queue */
+	struct obs_output *fanout_parent;
+	struct fanout_cursor fanout_cursor;
+	bool fanout_attached;
+	bool fanout_capturing;
+	pthread_t fanout_thread;
+	os_sem_t *fanout_sem;
+	volatile bool fanout_thread_active;
+	volatile long fanout_frames_dropped;
+
 	char *last_error_message;
 
 	float audio_data[MAX_AUDIO_CHANNELS][AUDIO_OUTPUT_FRAMES];
@@ -1162,6 +1342,11 @@ extern void obs_output_cleanup_delay(obs_output_t *output);
 extern bool obs_output_delay_start(obs_output_t *output);
 extern void obs_output_delay_stop(obs_output_t *output);
 extern bool obs_output_actual_start(obs_output_t *output);
+extern void obs_output_fanout_push(struct obs_output *output,
+				   struct encoder_packet *packet);
+extern bool obs_output_fanout_attach(struct obs_output *dest);
+extern void obs_output_fanout_detach(struct obs_output *dest);
+extern void obs_output_fanout_free(struct obs_output *output);
 extern void obs_output_actual_stop(obs_output_t *output, bool force,
 				   uint64_t ts);
 
@@ -29,7 +29,9 @@ enum obs_nix_platform_type {
 #ifdef ENABLE_WAYLAND
 	OBS_NIX_PLATFORM_WAYLAND,
 #endif
-
+	/* no display server, only offscreen rendering.  the value is fixed so
+	 * that it doesn't depend on whether wayland support is enabled */
+	OBS_NIX_PLATFORM_HEADLESS = 0x100,
 };
 
 /**
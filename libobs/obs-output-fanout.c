@@ -0,0 +1,343 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <inttypes.h>
+#include "obs-internal.h"
+
+/* ------------------------------------------------------------------------- */
+/* Fan-out outputs
+ *
+ * An output can have any number of destination outputs attached to it.  The
+ * parent output interleaves the encoder packets once and pushes a reference
+ * of every packet it sends into a single shared queue.  Each destination has
+ * its own cursor into that queue and its own send thread, so a destination
+ * that blocks or falls behind never delays the parent or any of the other
+ * destinations.  Packets are released once every destination has moved past
+ * them. */
+
+static inline bool active(const struct obs_output *output)
+{
+	return os_atomic_load_bool(&output->active);
+}
+
+static inline bool data_active(const struct obs_output *output)
+{
+	return os_atomic_load_bool(&output->data_active);
+}
+
+static inline bool flag_encoded(const struct obs_output *output)
+{
+	return (output->info.flags & OBS_OUTPUT_ENCODED) != 0;
+}
+
+/* releases packets that every attached destination has already sent */
+static void fanout_trim(struct obs_output *output)
+{
+	uint64_t min_seq = fanout_queue_end_seq(&output->fanout_queue);
+
+	for (size_t i = 0; i < output->fanout_destinations.num; i++) {
+		struct obs_output *dest = output->fanout_destinations.array[i];
+		if (dest->fanout_attached && dest->fanout_cursor.seq < min_seq)
+			min_seq = dest->fanout_cursor.seq;
+	}
+
+	fanout_queue_trim(&output->fanout_queue, min_seq);
+}
+
+void obs_output_fanout_push(struct obs_output *output,
+			    struct encoder_packet *packet)
+{
+	struct encoder_packet instance;
+
+	if (!os_atomic_load_long(&output->fanout_attached_count))
+		return;
+
+	obs_encoder_packet_create_instance(&instance, packet);
+
+	pthread_mutex_lock(&output->fanout_mutex);
+	fanout_queue_push(&output->fanout_queue, &instance);
+
+	for (size_t i = 0; i < output->fanout_destinations.num; i++) {
+		struct obs_output *dest = output->fanout_destinations.array[i];
+		if (dest->fanout_attached)
+			os_sem_post(dest->fanout_sem);
+	}
+	pthread_mutex_unlock(&output->fanout_mutex);
+}
+
+void obs_output_fanout_free(struct obs_output *output)
+{
+	fanout_queue_free(&output->fanout_queue);
+	da_free(output->fanout_destinations);
+}
+
+/* ------------------------------------------------------------------------- */
+/* destination send thread */
+
+static inline void atomic_add_long(volatile long *val, long add)
+{
+	long old_val = os_atomic_load_long(val);
+	while (!os_atomic_compare_exchange_long(val, &old_val, old_val + add))
+		;
+}
+
+static bool fanout_next_packet(struct obs_output *parent,
+			       struct obs_output *dest,
+			       struct encoder_packet *out)
+{
+	struct encoder_packet *packet;
+	long dropped;
+
+	packet = fanout_cursor_next(&dest->fanout_cursor,
+				    &parent->fanout_queue, &dropped);
+
+	if (dropped) {
+		atomic_add_long(&dest->fanout_frames_dropped, dropped);
+
+		blog(LOG_DEBUG,
+		     "Output '%s': fan-out destination fell behind '%s', "
+		     "dropped %ld frames",
+		     dest->context.name, parent->context.name, dropped);
+	}
+
+	if (packet)
+		obs_encoder_packet_create_instance(out, packet);
+
+	fanout_trim(parent);
+	return !!packet;
+}
+
+static inline bool has_track(const struct obs_output *dest,
+			     const struct encoder_packet *packet)
+{
+	return packet->type == OBS_ENCODER_VIDEO
+		       ? !!dest->video_encoders[packet->track_idx]
+		       : !!dest->audio_encoders[packet->track_idx];
+}
+
+static bool prepare_packet(struct obs_output *dest,
+			   struct encoder_packet *packet)
+{
+	bool dropped;
+
+	if (!has_track(dest, packet))
+		return false;
+
+	if (fanout_cursor_prepare(&dest->fanout_cursor, packet, &dropped))
+		return true;
+
+	if (dropped)
+		os_atomic_inc_long(&dest->fanout_frames_dropped);
+	return false;
+}
+
+static void *fanout_send_thread(void *data)
+{
+	struct obs_output *dest = data;
+	struct obs_output *parent = dest->fanout_parent;
+
+	os_set_thread_name("obs-core: fan-out send thread");
+
+	while (os_sem_wait(dest->fanout_sem) == 0) {
+		struct encoder_packet packet;
+		bool have_packet;
+
+		if (!os_atomic_load_bool(&dest->fanout_thread_active))
+			break;
+
+		pthread_mutex_lock(&parent->fanout_mutex);
+		have_packet = fanout_next_packet(parent, dest, &packet);
+		pthread_mutex_unlock(&parent->fanout_mutex);
+
+		if (!have_packet)
+			continue;
+
+		if (data_active(dest) && prepare_packet(dest, &packet)) {
+			if (packet.type == OBS_ENCODER_VIDEO)
+				dest->total_frames++;
+
+			dest->info.encoded_packet(dest->context.data, &packet);
+		}
+
+		obs_encoder_packet_release(&packet);
+	}
+
+	return NULL;
+}
+
+bool obs_output_fanout_attach(struct obs_output *dest)
+{
+	struct obs_output *parent = dest->fanout_parent;
+
+	if (os_sem_init(&dest->fanout_sem, 0) != 0)
+		return false;
+
+	pthread_mutex_lock(&parent->fanout_mutex);
+	fanout_cursor_reset(&dest->fanout_cursor, &parent->fanout_queue);
+	dest->fanout_attached = true;
+	os_atomic_inc_long(&parent->fanout_attached_count);
+	pthread_mutex_unlock(&parent->fanout_mutex);
+
+	os_atomic_set_bool(&dest->fanout_thread_active, true);
+	if (pthread_create(&dest->fanout_thread, NULL, fanout_send_thread,
+			   dest) != 0) {
+		blog(LOG_WARNING,
+		     "Output '%s': failed to create fan-out send thread",
+		     dest->context.name);
+		os_atomic_set_bool(&dest->fanout_thread_active, false);
+		obs_output_fanout_detach(dest);
+		return false;
+	}
+
+	blog(LOG_INFO, "Output '%s': sending from fan-out output '%s'",
+	     dest->context.name, parent->context.name);
+	return true;
+}
+
+void obs_output_fanout_detach(struct obs_output *dest)
+{
+	struct obs_output *parent = dest->fanout_parent;
+
+	if (!parent || !dest->fanout_sem)
+		return;
+
+	if (os_atomic_set_bool(&dest->fanout_thread_active, false)) {
+		os_sem_post(dest->fanout_sem);
+		pthread_join(dest->fanout_thread, NULL);
+	}
+
+	pthread_mutex_lock(&parent->fanout_mutex);
+	if (dest->fanout_attached) {
+		dest->fanout_attached = false;
+		os_atomic_dec_long(&parent->fanout_attached_count);
+	}
+	fanout_trim(parent);
+	pthread_mutex_unlock(&parent->fanout_mutex);
+
+	os_sem_destroy(dest->fanout_sem);
+	dest->fanout_sem = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+bool obs_output_add_destination(obs_output_t *output, obs_output_t *destination)
+{
+	if (!obs_output_valid(output, "obs_output_add_destination"))
+		return false;
+	if (!obs_output_valid(destination, "obs_output_add_destination"))
+		return false;
+
+	if (output == destination || output->fanout_parent) {
+		blog(LOG_WARNING,
+		     "obs_output_add_destination: output '%s' cannot have "
+		     "destinations",
+		     output->context.name);
+		return false;
+	}
+	if (!flag_encoded(output) || !flag_encoded(destination)) {
+		blog(LOG_WARNING, "obs_output_add_destination: fan-out is "
+				  "only supported for encoded outputs");
+		return false;
+	}
+	if (destination->fanout_parent || active(destination)) {
+		blog(LOG_WARNING,
+		     "obs_output_add_destination: output '%s' is already "
+		     "active or attached to another output",
+		     destination->context.name);
+		return false;
+	}
+
+	/* the destination shares the parent's encoders so that its start
+	 * path can still read encoder headers and settings */
+	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
+		if (output->video_encoders[i])
+			obs_output_set_video_encoder2(
+				destination, output->video_encoders[i], i);
+	}
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		if (output->audio_encoders[i])
+			obs_output_set_audio_encoder(
+				destination, output->audio_encoders[i], i);
+	}
+
+	destination->fanout_parent = obs_output_get_ref(output);
+	if (!destination->fanout_parent)
+		return false;
+
+	pthread_mutex_lock(&output->fanout_mutex);
+	da_push_back(output->fanout_destinations, &destination);
+	pthread_mutex_unlock(&output->fanout_mutex);
+	return true;
+}
+
+void obs_output_remove_destination(obs_output_t *output,
+				   obs_output_t *destination)
+{
+	if (!obs_output_valid(output, "obs_output_remove_destination"))
+		return;
+	if (!obs_output_valid(destination, "obs_output_remove_destination"))
+		return;
+	if (destination->fanout_parent != output)
+		return;
+
+	/* an active destination stops receiving packets here, and ends its
+	 * data capture without touching the encoders it never connected to */
+	obs_output_fanout_detach(destination);
+
+	pthread_mutex_lock(&output->fanout_mutex);
+	da_erase_item(output->fanout_destinations, &destination);
+	pthread_mutex_unlock(&output->fanout_mutex);
+
+	destination->fanout_parent = NULL;
+	obs_output_release(output);
+}
+
+obs_output_t *obs_output_get_fanout_parent(const obs_output_t *destination)
+{
+	return obs_output_valid(destination, "obs_output_get_fanout_parent")
+		       ? destination->fanout_parent
+		       : NULL;
+}
+
+void obs_output_set_destination_max_backlog(obs_output_t *destination,
+					    uint32_t max_backlog_ms)
+{
+	struct obs_output *parent;
+
+	if (!obs_output_valid(destination,
+			      "obs_output_set_destination_max_backlog"))
+		return;
+
+	parent = destination->fanout_parent;
+	if (parent)
+		pthread_mutex_lock(&parent->fanout_mutex);
+
+	destination->fanout_cursor.max_backlog_usec =
+		(int64_t)max_backlog_ms * 1000;
+
+	if (parent)
+		pthread_mutex_unlock(&parent->fanout_mutex);
+}
+
+uint32_t obs_output_get_destination_max_backlog(const obs_output_t *destination)
+{
+	if (!obs_output_valid(destination,
+			      "obs_output_get_destination_max_backlog"))
+		return 0;
+
+	return (uint32_t)(destination->fanout_cursor.max_backlog_usec / 1000);
+}
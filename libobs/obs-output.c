@@ -177,6 +177,7 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 	pthread_mutex_init_value(&output->delay_mutex);
 	pthread_mutex_init_value(&output->caption_mutex);
 	pthread_mutex_init_value(&output->pause.mutex);
+	pthread_mutex_init_value(&output->fanout_mutex);
 
 	if (pthread_mutex_init(&output->interleaved_mutex, NULL) != 0)
 		goto fail;
@@ -186,6 +187,8 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 		goto fail;
 	if (pthread_mutex_init(&output->pause.mutex, NULL) != 0)
 		goto fail;
+	if (pthread_mutex_init(&output->fanout_mutex, NULL) != 0)
+		goto fail;
 	if (os_event_init(&output->stopping_event, OS_EVENT_TYPE_MANUAL) != 0)
 		goto fail;
 	if (!init_output_handlers(output, name, settings, hotkey_data))
@@ -215,6 +218,8 @@ obs_output_t *obs_output_create(const char *id, const char *name,
 	output->reconnect_retry_max = 20;
 	output->reconnect_retry_exp =
 		RECONNECT_RETRY_BASE_EXP + (rand_float(0) * 0.05f);
+	output->fanout_cursor.max_backlog_usec =
+		FANOUT_DEFAULT_MAX_BACKLOG_USEC;
 	output->valid = true;
 
 	obs_context_init_control(&output->context, output,
@@ -238,10 +243,7 @@ fail:
 
 static inline void free_packets(struct obs_output *output)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_encoder_packet_release(output->interleaved_packets.array +
-					   i);
-	da_free(output->interleaved_packets);
+	interleave_queue_free(&output->interleaved_packets);
 }
 
 static inline void clear_raw_audio_buffers(obs_output_t *output)
@@ -267,12 +269,17 @@ void obs_output_destroy(obs_output_t *output)
 		if (data_capture_ending(output))
 			pthread_join(output->end_data_capture_thread, NULL);
 
+		if (output->fanout_parent)
+			obs_output_remove_destination(output->fanout_parent,
+						      output);
+
 		if (output->service)
 			output->service->output = NULL;
 		if (output->context.data)
 			output->info.destroy(output->context.data);
 
 		free_packets(output);
+		obs_output_fanout_free(output);
 
 		for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
 			if (output->video_encoders[i]) {
@@ -295,6 +302,7 @@ void obs_output_destroy(obs_output_t *output)
 		pthread_mutex_destroy(&output->caption_mutex);
 		pthread_mutex_destroy(&output->interleaved_mutex);
 		pthread_mutex_destroy(&output->delay_mutex);
+		pthread_mutex_destroy(&output->fanout_mutex);
 		os_event_destroy(output->reconnect_stop_event);
 		obs_context_data_free(&output->context);
 		circlebuf_free(&output->delay_data);
@@ -1127,12 +1135,17 @@ uint64_t obs_output_get_total_bytes(const obs_output_t *output)
 
 int obs_output_get_frames_dropped(const obs_output_t *output)
 {
+	int dropped;
+
 	if (!obs_output_valid(output, "obs_output_get_frames_dropped"))
 		return 0;
+
+	dropped = (int)os_atomic_load_long(&output->fanout_frames_dropped);
 	if (!output->info.get_dropped_frames)
-		return 0;
+		return dropped;
 
-	return output->info.get_dropped_frames(output->context.data);
+	return dropped +
+	       output->info.get_dropped_frames(output->context.data);
 }
 
 int obs_output_get_total_frames(const obs_output_t *output)
@@ -1543,15 +1556,17 @@ double last_caption_timestamp = 0;
 
 static inline void send_interleaved(struct obs_output *output)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	struct encoder_packet *first =
+		interleave_queue_peek(&output->interleaved_packets);
+	struct encoder_packet out;
 
 	/* do not send an interleaved packet if there's no packet of the
 	 * opposing type of a higher timestamp in the interleave buffer.
 	 * this ensures that the timestamps are monotonic */
-	if (!has_higher_opposing_ts(output, &out))
+	if (!first || !has_higher_opposing_ts(output, first))
 		return;
 
-	da_erase(output->interleaved_packets, 0);
+	interleave_queue_pop(&output->interleaved_packets, &out);
 
 	if (out.type == OBS_ENCODER_VIDEO) {
 		output->total_frames++;
@@ -1586,6 +1601,7 @@ static inline void send_interleaved(struct obs_output *output)
 	}
 
 	output->info.encoded_packet(output->context.data, &out);
+	obs_output_fanout_push(output, &out);
 	obs_encoder_packet_release(&out);
 }
 
@@ -1603,40 +1619,44 @@ static inline void set_higher_ts(struct obs_output *output,
 	}
 }
 
-static inline struct encoder_packet *
-find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx);
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type,
-				      size_t audio_idx);
-
 /* gets the point where audio and video are closest together */
 static size_t get_interleaved_start_idx(struct obs_output *output)
 {
+	struct interleave_queue *q = &output->interleaved_packets;
 	int64_t closest_diff = 0x7FFFFFFFFFFFFFFFLL;
 	struct encoder_packet *first_video =
-		find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
-	size_t video_idx = DARRAY_INVALID;
-	size_t idx = 0;
-
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		int64_t diff;
-
-		if (packet->type != OBS_ENCODER_AUDIO) {
-			if (packet == first_video)
-				video_idx = i;
-			continue;
-		}
+		interleave_queue_head(q, OBS_ENCODER_VIDEO, 0);
+	struct encoder_packet *closest = NULL;
+	size_t video_idx;
+	size_t idx;
 
-		diff = llabs(packet->dts_usec - first_video->dts_usec);
-		if (diff < closest_diff) {
-			closest_diff = diff;
-			idx = i;
+	if (!first_video)
+		return 0;
+
+	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
+		size_t track = interleave_track(OBS_ENCODER_AUDIO, i);
+		size_t count = interleave_track_count(q, track);
+
+		for (size_t j = 0; j < count; j++) {
+			struct encoder_packet *packet =
+				interleave_track_packet(q, track, j);
+			int64_t diff =
+				llabs(packet->dts_usec - first_video->dts_usec);
+
+			if (diff < closest_diff ||
+			    (diff == closest_diff &&
+			     interleave_packet_before(packet, closest))) {
+				closest_diff = diff;
+				closest = packet;
+			}
 		}
 	}
 
+	if (!closest)
+		return 0;
+
+	video_idx = interleave_queue_count_before(q, first_video);
+	idx = interleave_queue_count_before(q, closest);
 	return video_idx < idx ? video_idx : idx;
 }
 
@@ -1648,6 +1668,7 @@ static int64_t get_encoder_duration(struct obs_encoder *encoder)
 
 static int prune_premature_packets(struct obs_output *output)
 {
+	struct interleave_queue *q = &output->interleaved_packets;
 	struct encoder_packet *video;
 	int video_idx;
 	int max_idx;
@@ -1656,12 +1677,12 @@ static int prune_premature_packets(struct obs_output *output)
 	int64_t diff = 0;
 	int audio_encoders = 0;
 
-	video_idx = find_first_packet_type_idx(output, OBS_ENCODER_VIDEO, 0);
-	if (video_idx == -1)
+	video = interleave_queue_head(q, OBS_ENCODER_VIDEO, 0);
+	if (!video)
 		return -1;
 
+	video_idx = (int)interleave_queue_count_before(q, video);
 	max_idx = video_idx;
-	video = &output->interleaved_packets.array[video_idx];
 	duration_usec = video->timebase_num * 1000000LL / video->timebase_den;
 
 	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
@@ -1673,14 +1694,13 @@ static int prune_premature_packets(struct obs_output *output)
 			continue;
 		audio_encoders++;
 
-		audio_idx = find_first_packet_type_idx(output,
-						       OBS_ENCODER_AUDIO, i);
-		if (audio_idx == -1) {
+		audio = interleave_queue_head(q, OBS_ENCODER_AUDIO, i);
+		if (!audio) {
 			output->received_audio = false;
 			return -1;
 		}
 
-		audio = &output->interleaved_packets.array[audio_idx];
+		audio_idx = (int)interleave_queue_count_before(q, audio);
 		if (audio_idx > max_idx)
 			max_idx = audio_idx;
 
@@ -1707,34 +1727,45 @@ static int prune_premature_packets(struct obs_output *output)
 	return diff > duration_usec ? max_idx + 1 : 0;
 }
 
-static void discard_to_idx(struct obs_output *output, size_t idx)
+static inline void discard_to_idx(struct obs_output *output, size_t idx)
 {
-	for (size_t i = 0; i < idx; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		obs_encoder_packet_release(packet);
-	}
-
-	da_erase_range(output->interleaved_packets, 0, idx);
+	interleave_queue_discard(&output->interleaved_packets, idx);
 }
 
 #define DEBUG_STARTING_PACKETS 0
 
+#if DEBUG_STARTING_PACKETS == 1
+static void log_interleaved_packets(struct obs_output *output, int prune_start)
+{
+	struct interleave_queue *q = &output->interleaved_packets;
+
+	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune_start);
+	for (size_t i = 0; i < INTERLEAVE_MAX_TRACKS; i++) {
+		size_t count = interleave_track_count(q, i);
+
+		for (size_t j = 0; j < count; j++) {
+			struct encoder_packet *packet =
+				interleave_track_packet(q, i, j);
+			size_t idx = interleave_queue_count_before(q, packet);
+
+			blog(LOG_DEBUG,
+			     "packet: %s %d, ts: %lld, pruned = %s",
+			     packet->type == OBS_ENCODER_AUDIO ? "audio"
+							       : "video",
+			     (int)packet->track_idx, packet->dts_usec,
+			     (int)idx < prune_start ? "true" : "false");
+		}
+	}
+}
+#endif
+
 static bool prune_interleaved_packets(struct obs_output *output)
 {
 	size_t start_idx = 0;
 	int prune_start = prune_premature_packets(output);
 
 #if DEBUG_STARTING_PACKETS == 1
-	blog(LOG_DEBUG, "--------- Pruning! %d ---------", prune_start);
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		blog(LOG_DEBUG, "packet: %s %d, ts: %lld, pruned = %s",
-		     packet->type == OBS_ENCODER_AUDIO ? "audio" : "video",
-		     (int)packet->track_idx, packet->dts_usec,
-		     (int)i < prune_start ? "true" : "false");
-	}
+	log_interleaved_packets(output, prune_start);
 #endif
 
 	/* prunes the first video packet if it's too far away from audio */
@@ -1751,59 +1782,17 @@ static bool prune_interleaved_packets(struct obs_output *output)
 	return true;
 }
 
-static int find_first_packet_type_idx(struct obs_output *output,
-				      enum obs_encoder_type type, size_t idx)
-{
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-
-		if (packet->type == type && packet->track_idx == idx)
-			return (int)i;
-	}
-
-	return -1;
-}
-
-static int find_last_packet_type_idx(struct obs_output *output,
-				     enum obs_encoder_type type, size_t idx)
-{
-	for (size_t i = output->interleaved_packets.num; i > 0; i--) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i - 1];
-
-		if (packet->type == type && packet->track_idx == idx)
-			return (int)(i - 1);
-	}
-
-	return -1;
-}
-
-static inline struct encoder_packet *
-find_first_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		       size_t audio_idx)
-{
-	int idx = find_first_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
-
-static inline struct encoder_packet *
-find_last_packet_type(struct obs_output *output, enum obs_encoder_type type,
-		      size_t audio_idx)
-{
-	int idx = find_last_packet_type_idx(output, type, audio_idx);
-	return (idx != -1) ? &output->interleaved_packets.array[idx] : NULL;
-}
-
 static bool get_audio_and_video_packets(struct obs_output *output,
 					struct encoder_packet **video,
 					struct encoder_packet **audio)
 {
+	struct interleave_queue *q = &output->interleaved_packets;
 	bool found_video = false;
+
 	for (size_t i = 0; i < MAX_OUTPUT_VIDEO_ENCODERS; i++) {
 		if (output->video_encoders[i]) {
-			video[i] = find_first_packet_type(output,
-							  OBS_ENCODER_VIDEO, i);
+			video[i] = interleave_queue_head(q, OBS_ENCODER_VIDEO,
+							 i);
 			if (!video[i]) {
 				output->received_video[i] = false;
 				return false;
@@ -1815,8 +1804,8 @@ static bool get_audio_and_video_packets(struct obs_output *output,
 
 	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
 		if (output->audio_encoders[i]) {
-			audio[i] = find_first_packet_type(output,
-							  OBS_ENCODER_AUDIO, i);
+			audio[i] = interleave_queue_head(q, OBS_ENCODER_AUDIO,
+							 i);
 			if (!audio[i]) {
 				output->received_audio = false;
 				return false;
@@ -1829,6 +1818,7 @@ static bool get_audio_and_video_packets(struct obs_output *output,
 
 static bool initialize_interleaved_packets(struct obs_output *output)
 {
+	struct interleave_queue *q = &output->interleaved_packets;
 	struct encoder_packet *video[MAX_OUTPUT_VIDEO_ENCODERS] = {0};
 	struct encoder_packet *audio[MAX_OUTPUT_AUDIO_ENCODERS] = {0};
 	struct encoder_packet *last_audio[MAX_OUTPUT_AUDIO_ENCODERS] = {0};
@@ -1846,8 +1836,8 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 
 	for (size_t i = 0; i < MAX_OUTPUT_AUDIO_ENCODERS; i++) {
 		if (output->audio_encoders[i]) {
-			last_audio[i] = find_last_packet_type(
-				output, OBS_ENCODER_AUDIO, i);
+			last_audio[i] =
+				interleave_queue_tail(q, OBS_ENCODER_AUDIO, i);
 		}
 	}
 
@@ -1900,73 +1890,34 @@ static bool initialize_interleaved_packets(struct obs_output *output)
 			output->highest_video_ts[i] -= video[i]->dts_usec;
 	}
 
-	/* apply new offsets to all existing packet DTS/PTS values */
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		apply_interleaved_packet_offset(output, packet);
-	}
-
-	return true;
-}
-
-static inline void insert_interleaved_packet(struct obs_output *output,
-					     struct encoder_packet *out)
-{
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
-
-		// sort video packets with same DTS by track index,
-		// to prevent the pruning logic from removing additional
-		// video tracks
-		if (out->dts_usec == cur_packet->dts_usec &&
-		    out->type == OBS_ENCODER_VIDEO &&
-		    cur_packet->type == OBS_ENCODER_VIDEO &&
-		    out->track_idx > cur_packet->track_idx)
-			continue;
+	/* apply new offsets to all existing packet DTS/PTS values.  the
+	 * offset is the same for every packet of a track, so each track
+	 * stays sorted and the queue never needs to be resorted */
+	for (size_t i = 0; i < INTERLEAVE_MAX_TRACKS; i++) {
+		size_t count = interleave_track_count(q, i);
 
-		if (out->dts_usec == cur_packet->dts_usec &&
-		    out->type == OBS_ENCODER_VIDEO) {
-			break;
-		} else if (out->dts_usec < cur_packet->dts_usec) {
-			break;
+		for (size_t j = 0; j < count; j++) {
+			struct encoder_packet *packet =
+				interleave_track_packet(q, i, j);
+			apply_interleaved_packet_offset(output, packet);
 		}
 	}
 
-	da_insert(output->interleaved_packets, idx, out);
-}
-
-static void resort_interleaved_packets(struct obs_output *output)
-{
-	DARRAY(struct encoder_packet) old_array;
-
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0,
-	       sizeof(output->interleaved_packets));
-
-	for (size_t i = 0; i < old_array.num; i++)
-		insert_interleaved_packet(output, &old_array.array[i]);
-
-	da_free(old_array);
+	return true;
 }
 
 static void discard_unused_audio_packets(struct obs_output *output,
 					 int64_t dts_usec)
 {
-	size_t idx = 0;
-
-	for (; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *p =
-			&output->interleaved_packets.array[idx];
+	struct interleave_queue *q = &output->interleaved_packets;
+	struct encoder_packet *first;
+	struct encoder_packet packet;
 
-		if (p->dts_usec >= dts_usec)
-			break;
+	while ((first = interleave_queue_peek(q)) != NULL &&
+	       first->dts_usec < dts_usec) {
+		interleave_queue_pop(q, &packet);
+		obs_encoder_packet_release(&packet);
 	}
-
-	if (idx)
-		discard_to_idx(output, idx);
 }
 
 static void interleave_packets(void *data, struct encoder_packet *packet)
@@ -2013,7 +1964,7 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	else
 		check_received(output, packet);
 
-	insert_interleaved_packet(output, &out);
+	interleave_queue_push(&output->interleaved_packets, &out);
 	set_higher_ts(output, &out);
 
 	received_video = true;
@@ -2028,10 +1979,8 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->received_audio && received_video) {
 		if (!was_started) {
 			if (prune_interleaved_packets(output)) {
-				if (initialize_interleaved_packets(output)) {
-					resort_interleaved_packets(output);
+				if (initialize_interleaved_packets(output))
 					send_interleaved(output);
-				}
 			}
 		} else {
 			send_interleaved(output);
@@ -2049,6 +1998,7 @@ static void default_encoded_callback(void *param, struct encoder_packet *packet)
 		packet->track_idx = get_encoder_index(output, packet);
 
 		output->info.encoded_packet(output->context.data, packet);
+		obs_output_fanout_push(output, packet);
 
 		if (packet->type == OBS_ENCODER_VIDEO)
 			output->total_frames++;
@@ -2226,7 +2176,7 @@ static inline bool preserve_active(struct obs_output *output)
 	return (output->delay_flags & OBS_OUTPUT_DELAY_PRESERVE) != 0;
 }
 
-static void hook_data_capture(struct obs_output *output)
+static bool hook_data_capture(struct obs_output *output)
 {
 	encoded_callback_t encoded_callback;
 	bool has_video = flag_video(output);
@@ -2237,6 +2187,14 @@ static void hook_data_capture(struct obs_output *output)
 		reset_packet_data(output);
 		pthread_mutex_unlock(&output->interleaved_mutex);
 
+		/* fan-out destinations receive the parent's interleaved
+		 * packets instead of connecting to the encoders */
+		if (output->fanout_parent) {
+			output->fanout_capturing =
+				obs_output_fanout_attach(output);
+			return output->fanout_capturing;
+		}
+
 		encoded_callback = (has_video && has_audio)
 					   ? interleave_packets
 					   : default_encoded_callback;
@@ -2268,6 +2226,8 @@ static void hook_data_capture(struct obs_output *output)
 		if (has_audio)
 			start_raw_audio(output);
 	}
+
+	return true;
 }
 
 static inline void signal_start(struct obs_output *output)
@@ -2470,6 +2430,8 @@ static void reset_raw_output(obs_output_t *output)
 
 bool obs_output_begin_data_capture(obs_output_t *output, uint32_t flags)
 {
+	bool hooked;
+
 	UNUSED_PARAMETER(flags);
 
 	if (!obs_output_valid(output, "obs_output_begin_data_capture"))
@@ -2481,6 +2443,7 @@ bool obs_output_begin_data_capture(obs_output_t *output, uint32_t flags)
 		return false;
 
 	output->total_frames = 0;
+	os_atomic_set_long(&output->fanout_frames_dropped, 0);
 
 	if (!flag_encoded(output))
 		reset_raw_output(output);
@@ -2492,7 +2455,7 @@ bool obs_output_begin_data_capture(obs_output_t *output, uint32_t flags)
 		pair_encoders(output);
 
 	os_atomic_set_bool(&output->data_active, true);
-	hook_data_capture(output);
+	hooked = hook_data_capture(output);
 
 	if (flag_service(output))
 		obs_service_activate(output->service);
@@ -2511,6 +2474,15 @@ bool obs_output_begin_data_capture(obs_output_t *output, uint32_t flags)
 		signal_start(output);
 	}
 
+	/* the output has already been started at this point, so it has to
+	 * be stopped like any other output that fails while active */
+	if (!hooked) {
+		obs_output_set_last_error(
+			output, "Failed to attach to the fan-out output");
+		obs_output_signal_stop(output, OBS_OUTPUT_ERROR);
+		return false;
+	}
+
 	return true;
 }
 
@@ -2557,7 +2529,15 @@ static void *end_data_capture_thread(void *data)
 	bool has_video = flag_video(output);
 	bool has_audio = flag_audio(output);
 
-	if (flag_encoded(output)) {
+	/* a destination never connected to the encoders.  it may have been
+	 * removed from its parent since, which detached it already, or
+	 * failed to attach in the first place. */
+	if (output->fanout_capturing || output->fanout_parent) {
+		if (output->fanout_capturing)
+			obs_output_fanout_detach(output);
+		output->fanout_capturing = false;
+
+	} else if (flag_encoded(output)) {
 		if (output->active_delay_ns)
 			encoded_callback = process_delay;
 		else
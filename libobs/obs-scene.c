@@ -32,6 +32,8 @@ static void get_ungrouped_transform(obs_sceneitem_t *group, struct vec2 *pos,
 				    struct vec2 *scale, float *rot);
 static inline bool crop_enabled(const struct obs_sceneitem_crop *crop);
 static inline bool item_texture_enabled(const struct obs_scene_item *item);
+static uint32_t scene_getwidth(void *data);
+static uint32_t scene_getheight(void *data);
 static void init_hotkeys(obs_scene_t *scene, obs_sceneitem_t *item,
 			 const char *name);
 
@@ -243,6 +245,12 @@ static void scene_destroy(void *data)
 
 	remove_all_items(scene);
 
+	if (scene->cache_render) {
+		obs_enter_graphics();
+		gs_texrender_destroy(scene->cache_render);
+		obs_leave_graphics();
+	}
+
 	pthread_mutex_destroy(&scene->video_mutex);
 	pthread_mutex_destroy(&scene->audio_mutex);
 	bfree(scene);
@@ -322,6 +330,7 @@ static inline void detach_sceneitem(struct obs_scene_item *item)
 	if (item->next)
 		item->next->prev = item->prev;
 
+	os_atomic_inc_long(&item->parent->content_generation);
 	item->parent = NULL;
 }
 
@@ -332,6 +341,8 @@ static inline void attach_sceneitem(struct obs_scene *parent,
 	item->prev = prev;
 	item->parent = parent;
 
+	os_atomic_inc_long(&parent->content_generation);
+
 	if (prev) {
 		item->next = prev->next;
 		if (prev->next)
@@ -499,6 +510,8 @@ static void update_item_transform(struct obs_scene_item *item, bool update_tex)
 
 	/* ----------------------- */
 
+	os_atomic_inc_long(&item->transform_generation);
+
 	calldata_init_fixed(&params, stack, sizeof(stack));
 	calldata_set_ptr(&params, "item", item);
 	signal_parent(item->parent, "item_transform", &params);
@@ -716,6 +729,93 @@ static bool are_texcoords_centered(struct matrix4 *m)
 	return memcmp(m, &copy, sizeof(*m)) == 0;
 }
 
+static inline bool item_transition_active(const struct obs_scene_item *item)
+{
+	return item->user_visible ? transition_active(item->show_transition)
+				  : transition_active(item->hide_transition);
+}
+
+/* assumes video lock */
+static uint64_t scene_content_generation(struct obs_scene *scene)
+{
+	uint64_t gen = content_generation_mix(
+		0xcbf29ce484222325ULL,
+		(uint64_t)os_atomic_load_long(&scene->content_generation));
+	struct obs_scene_item *item = scene->first_item;
+
+	if (!obs_get_render_cache_enabled())
+		return 0;
+
+	while (item) {
+		uint64_t source_gen;
+
+		if (item_transition_active(item))
+			return 0;
+		if (!item->user_visible) {
+			item = item->next;
+			continue;
+		}
+
+		/* the transform is about to change */
+		if (os_atomic_load_bool(&item->update_transform) ||
+		    source_size_changed(item))
+			return 0;
+
+		source_gen = obs_source_get_content_generation(item->source);
+		if (!source_gen)
+			return 0;
+
+		gen = content_generation_mix(gen, (uintptr_t)item);
+		gen = content_generation_mix(gen, source_gen);
+		gen = content_generation_mix(
+			gen, (uint64_t)os_atomic_load_long(
+				     &item->transform_generation));
+		gen = content_generation_mix(gen, item->scale_filter);
+		gen = content_generation_mix(gen, item->blend_method);
+		gen = content_generation_mix(gen, item->blend_type);
+
+		item = item->next;
+	}
+
+	return gen;
+}
+
+uint64_t obs_scene_get_content_generation(obs_scene_t *scene)
+{
+	uint64_t gen;
+
+	video_lock(scene);
+	gen = scene_content_generation(scene);
+	video_unlock(scene);
+	return gen;
+}
+
+/* identifies the content an item would render to its texture, or 0 if it may
+ * change every frame */
+static uint64_t item_render_key(const struct obs_scene_item *item,
+				uint32_t width, uint32_t height,
+				enum gs_color_space space)
+{
+	uint64_t key;
+
+	if (item_transition_active(item))
+		return 0;
+
+	key = obs_source_get_content_generation(item->source);
+	if (!key)
+		return 0;
+
+	key = content_generation_mix(key, width);
+	key = content_generation_mix(key, height);
+	key = content_generation_mix(key, item->crop.left);
+	key = content_generation_mix(key, item->crop.top);
+	key = content_generation_mix(key, item->crop.right);
+	key = content_generation_mix(key, item->crop.bottom);
+	key = content_generation_mix(key, space);
+	return content_generation_mix(key,
+				      (uint64_t)obs_get_video_sdr_white_level());
+}
+
 static inline void render_item(struct obs_scene_item *item)
 {
 	GS_DEBUG_MARKER_BEGIN_FORMAT(GS_DEBUG_COLOR_ITEM, "Item: %s",
@@ -739,6 +839,7 @@ static inline void render_item(struct obs_scene_item *item)
 
 	if (!item->item_render && use_texrender) {
 		item->item_render = gs_texrender_create(format, GS_ZS_NONE);
+		item->render_key = 0;
 	}
 
 	if (item->item_render) {
@@ -751,10 +852,15 @@ static inline void render_item(struct obs_scene_item *item)
 
 		uint32_t cx = calc_cx(item, width);
 		uint32_t cy = calc_cy(item, height);
+		uint64_t key =
+			item_render_key(item, width, height, source_space);
+
+		if (key && key == item->render_key) {
+			os_atomic_inc_long(&obs->video.render_cache_hits);
 
-		if (cx && cy &&
-		    gs_texrender_begin_with_color_space(item->item_render, cx,
-							cy, source_space)) {
+		} else if (cx && cy &&
+			   gs_texrender_begin_with_color_space(
+				   item->item_render, cx, cy, source_space)) {
 			float cx_scale = (float)width / (float)cx;
 			float cy_scale = (float)height / (float)cy;
 			struct vec4 clear_color;
@@ -795,6 +901,8 @@ static inline void render_item(struct obs_scene_item *item)
 			}
 
 			gs_texrender_end(item->item_render);
+			item->render_key = key;
+			os_atomic_inc_long(&obs->video.render_cache_misses);
 		}
 	}
 
@@ -895,21 +1003,11 @@ update_transforms_and_prune_sources(obs_scene_t *scene,
 		resize_group(group_sceneitem);
 }
 
-static void scene_video_render(void *data, gs_effect_t *effect)
+/* assumes video lock */
+static void render_items(struct obs_scene *scene)
 {
-	DARRAY(struct obs_scene_item *) remove_items;
-	struct obs_scene *scene = data;
 	struct obs_scene_item *item;
 
-	da_init(remove_items);
-
-	video_lock(scene);
-
-	if (!scene->is_group) {
-		update_transforms_and_prune_sources(scene, &remove_items.da,
-						    NULL);
-	}
-
 	gs_blend_state_push();
 	gs_reset_blend_state();
 
@@ -923,6 +1021,127 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 	}
 
 	gs_blend_state_pop();
+}
+
+/* items are composited on a transparent texture when the scene is cached, so
+ * only items that blend normally give the same result as rendering them
+ * directly */
+static bool scene_cacheable(const struct obs_scene *scene)
+{
+	const struct obs_scene_item *item = scene->first_item;
+
+	while (item) {
+		if (item->user_visible &&
+		    (!default_blending_enabled(item) ||
+		     item->blend_method == OBS_BLEND_METHOD_SRGB_OFF))
+			return false;
+
+		item = item->next;
+	}
+
+	return true;
+}
+
+/* assumes video lock */
+static void render_cached_items(struct obs_scene *scene, uint64_t gen)
+{
+	const enum gs_color_space space = gs_get_color_space();
+	const enum gs_color_format format = gs_get_format_from_space(space);
+	const uint32_t cx = scene_getwidth(scene);
+	const uint32_t cy = scene_getheight(scene);
+	uint64_t key;
+
+	if (!cx || !cy)
+		return;
+
+	key = content_generation_mix(gen, cx);
+	key = content_generation_mix(key, cy);
+	key = content_generation_mix(key, space);
+	key = content_generation_mix(
+		key, (uint64_t)obs_get_video_sdr_white_level());
+
+	if (scene->cache_render &&
+	    gs_texrender_get_format(scene->cache_render) != format) {
+		gs_texrender_destroy(scene->cache_render);
+		scene->cache_render = NULL;
+	}
+
+	if (!scene->cache_render) {
+		scene->cache_render = gs_texrender_create(format, GS_ZS_NONE);
+		scene->cache_key = 0;
+	}
+
+	if (key == scene->cache_key) {
+		os_atomic_inc_long(&obs->video.render_cache_hits);
+	} else {
+		struct vec4 clear_color;
+
+		gs_texrender_reset(scene->cache_render);
+		if (!gs_texrender_begin_with_color_space(scene->cache_render,
+							 cx, cy, space))
+			return;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+		render_items(scene);
+
+		gs_texrender_end(scene->cache_render);
+		scene->cache_key = key;
+		os_atomic_inc_long(&obs->video.render_cache_misses);
+	}
+
+	gs_texture_t *tex = gs_texrender_get_texture(scene->cache_render);
+	if (!tex)
+		return;
+
+	gs_effect_t *effect = obs->video.default_effect;
+	const bool previous = gs_set_linear_srgb(true);
+
+	gs_blend_state_push();
+	gs_blend_function_separate(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA,
+				   GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+
+	while (gs_effect_loop(effect, "Draw"))
+		obs_source_draw(tex, 0, 0, 0, 0, 0);
+
+	gs_blend_state_pop();
+	gs_set_linear_srgb(previous);
+}
+
+static void scene_video_render(void *data, gs_effect_t *effect)
+{
+	DARRAY(struct obs_scene_item *) remove_items;
+	struct obs_scene *scene = data;
+	uint64_t gen = 0;
+
+	da_init(remove_items);
+
+	video_lock(scene);
+
+	if (!scene->is_group) {
+		update_transforms_and_prune_sources(scene, &remove_items.da,
+						    NULL);
+
+		if (scene_cacheable(scene))
+			gen = scene_content_generation(scene);
+	}
+
+	/* only cache the scene once its content stayed the same from one
+	 * render to the next, to avoid an extra copy of scenes that change
+	 * every frame */
+	if (gen && gen == scene->last_generation) {
+		render_cached_items(scene, gen);
+	} else {
+		if (!gen && scene->cache_render) {
+			gs_texrender_destroy(scene->cache_render);
+			scene->cache_render = NULL;
+		}
+
+		scene->last_generation = gen;
+		render_items(scene);
+	}
 
 	video_unlock(scene);
 
@@ -1536,7 +1755,8 @@ const struct obs_source_info scene_info = {
 	.type = OBS_SOURCE_TYPE_SCENE,
 	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
 			OBS_SOURCE_COMPOSITE | OBS_SOURCE_DO_NOT_DUPLICATE |
-			OBS_SOURCE_SRGB,
+			OBS_SOURCE_SRGB | OBS_SOURCE_THREAD_SAFE_AUDIO_RENDER |
+			OBS_SOURCE_TICK_WHEN_VISIBLE,
 	.get_name = scene_getname,
 	.create = scene_create,
 	.destroy = scene_destroy,
@@ -1556,7 +1776,9 @@ const struct obs_source_info group_info = {
 	.id = "group",
 	.type = OBS_SOURCE_TYPE_SCENE,
 	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
-			OBS_SOURCE_COMPOSITE | OBS_SOURCE_SRGB,
+			OBS_SOURCE_COMPOSITE | OBS_SOURCE_SRGB |
+			OBS_SOURCE_THREAD_SAFE_AUDIO_RENDER |
+			OBS_SOURCE_TICK_WHEN_VISIBLE,
 	.get_name = group_getname,
 	.create = scene_create,
 	.destroy = scene_destroy,
@@ -2152,6 +2374,7 @@ static obs_sceneitem_t *obs_scene_add_internal(obs_scene_t *scene,
 		}
 	}
 
+	os_atomic_inc_long(&scene->content_generation);
 	full_unlock(scene);
 
 	if (!scene->source->context.private)
@@ -50,6 +50,11 @@ struct obs_scene_item {
 	gs_texrender_t *item_render;
 	struct obs_sceneitem_crop crop;
 
+	/* identifies what item_render currently holds, the texture is reused
+	 * instead of rendering the source again while this stays the same */
+	uint64_t render_key;
+	volatile long transform_generation;
+
 	struct vec2 pos;
 	struct vec2 scale;
 	float rot;
@@ -104,4 +109,11 @@ struct obs_scene {
 	pthread_mutex_t video_mutex;
 	pthread_mutex_t audio_mutex;
 	struct obs_scene_item *first_item;
+
+	/* composited items of the scene, used while the content of the scene
+	 * doesn't change from one render to the next */
+	gs_texrender_t *cache_render;
+	uint64_t cache_key;
+	uint64_t last_generation;
+	volatile long content_generation;
 };
@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include "obs-internal.h"
+#include "media-io/video-deinterlace.h"
 
 static bool ready_deinterlace_frames(obs_source_t *source, uint64_t sys_time)
 {
@@ -448,6 +449,262 @@ void deinterlace_render(obs_source_t *s)
 	gs_enable_framebuffer_srgb(previous);
 }
 
+/* ------------------------------------------------------------------------- */
+/* CPU deinterlacing
+ *
+ *   Frames of sources that have CPU deinterlacing enabled are deinterlaced
+ * with yadif as they arrive, so that they can be rendered as they are.  Only
+ * the previous frame is needed, so no latency is added: for every frame, the
+ * first field in time is kept, and the lines of the other field are rebuilt
+ * from the frames before and after it.  In double rate mode, a frame for the
+ * second field of the previous frame is output first. */
+
+#define DEINTERLACE_BAND_LINES 64
+
+struct cpu_plane {
+	uint32_t width; /* in bytes */
+	uint32_t height;
+	uint32_t step;
+};
+
+struct deinterlace_task {
+	uint8_t *output;
+	uint32_t out_linesize;
+	const uint8_t *input[3];
+	uint32_t in_linesize[3];
+	struct cpu_plane plane;
+	uint32_t parity;
+	uint32_t start_y;
+	uint32_t end_y;
+};
+
+static inline void set_plane(struct cpu_plane *plane, uint32_t width,
+			     uint32_t height, uint32_t step)
+{
+	plane->width = width;
+	plane->height = height;
+	plane->step = step;
+}
+
+/* returns the number of planes, or 0 if the format isn't 8-bit */
+static size_t get_cpu_planes(enum video_format format, uint32_t width,
+			     uint32_t height,
+			     struct cpu_plane planes[MAX_AV_PLANES])
+{
+	const uint32_t half_width = (width + 1) / 2;
+	const uint32_t half_height = (height + 1) / 2;
+
+	switch (format) {
+	case VIDEO_FORMAT_Y800:
+		set_plane(&planes[0], width, height, 1);
+		return 1;
+
+	case VIDEO_FORMAT_I420:
+	case VIDEO_FORMAT_I40A:
+		set_plane(&planes[0], width, height, 1);
+		set_plane(&planes[1], half_width, half_height, 1);
+		set_plane(&planes[2], half_width, half_height, 1);
+		set_plane(&planes[3], width, height, 1);
+		return format == VIDEO_FORMAT_I40A ? 4 : 3;
+
+	case VIDEO_FORMAT_NV12:
+		set_plane(&planes[0], width, height, 1);
+		set_plane(&planes[1], half_width * 2, half_height, 2);
+		return 2;
+
+	case VIDEO_FORMAT_I422:
+	case VIDEO_FORMAT_I42A:
+		set_plane(&planes[0], width, height, 1);
+		set_plane(&planes[1], half_width, height, 1);
+		set_plane(&planes[2], half_width, height, 1);
+		set_plane(&planes[3], width, height, 1);
+		return format == VIDEO_FORMAT_I42A ? 4 : 3;
+
+	case VIDEO_FORMAT_I444:
+	case VIDEO_FORMAT_YUVA:
+		for (size_t i = 0; i < 4; i++)
+			set_plane(&planes[i], width, height, 1);
+		return format == VIDEO_FORMAT_YUVA ? 4 : 3;
+
+	/* samples of the same component are 4 bytes apart, so luma is
+	 * compared with the luma of the next pair of pixels */
+	case VIDEO_FORMAT_YVYU:
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+		set_plane(&planes[0], half_width * 4, height, 4);
+		return 1;
+
+	case VIDEO_FORMAT_RGBA:
+	case VIDEO_FORMAT_BGRA:
+	case VIDEO_FORMAT_BGRX:
+	case VIDEO_FORMAT_AYUV:
+		set_plane(&planes[0], width * 4, height, 4);
+		return 1;
+
+	case VIDEO_FORMAT_BGR3:
+		set_plane(&planes[0], width * 3, height, 3);
+		return 1;
+
+	case VIDEO_FORMAT_NONE:
+	case VIDEO_FORMAT_I010:
+	case VIDEO_FORMAT_P010:
+	case VIDEO_FORMAT_I210:
+	case VIDEO_FORMAT_I412:
+	case VIDEO_FORMAT_YA2L:
+	case VIDEO_FORMAT_V210:
+	case VIDEO_FORMAT_P216:
+	case VIDEO_FORMAT_P416:
+		break;
+	}
+
+	return 0;
+}
+
+static inline bool cpu_mode_supported(enum obs_deinterlace_mode mode)
+{
+	return mode == OBS_DEINTERLACE_MODE_YADIF ||
+	       mode == OBS_DEINTERLACE_MODE_YADIF_2X;
+}
+
+bool deinterlace_cpu_supported(const obs_source_t *source,
+			       const struct obs_source_frame *frame)
+{
+	struct cpu_plane planes[MAX_AV_PLANES];
+
+	return source->deinterlace_cpu &&
+	       cpu_mode_supported(source->deinterlace_mode) &&
+	       get_cpu_planes(frame->format, frame->width, frame->height,
+			      planes) != 0;
+}
+
+static void run_deinterlace_task(void *param, size_t idx)
+{
+	struct deinterlace_task *task = (struct deinterlace_task *)param + idx;
+
+	deinterlace_yadif(task->output, task->out_linesize, task->input,
+			  task->in_linesize, task->plane.width,
+			  task->plane.height, task->plane.step, task->parity,
+			  task->start_y, task->end_y);
+}
+
+/* adds the tasks for rebuilding one field of a frame.  `field` holds the
+ * field that is kept, `before` and `after` are the frames around the one
+ * that is rebuilt */
+static void add_field_tasks(struct darray *tasks_da,
+			    struct obs_source_frame *output,
+			    const struct obs_source_frame *field,
+			    const struct obs_source_frame *before,
+			    const struct obs_source_frame *after,
+			    uint32_t parity)
+{
+	struct cpu_plane planes[MAX_AV_PLANES];
+	size_t num_planes = get_cpu_planes(field->format, field->width,
+					   field->height, planes);
+	DARRAY(struct deinterlace_task) tasks;
+
+	tasks.da = *tasks_da;
+
+	for (size_t i = 0; i < num_planes; i++) {
+		struct deinterlace_task task;
+
+		task.output = output->data[i];
+		task.out_linesize = output->linesize[i];
+		task.input[0] = field->data[i];
+		task.input[1] = before->data[i];
+		task.input[2] = after->data[i];
+		task.in_linesize[0] = field->linesize[i];
+		task.in_linesize[1] = before->linesize[i];
+		task.in_linesize[2] = after->linesize[i];
+		task.plane = planes[i];
+
+		/* the top field of a flipped frame is at the bottom */
+		task.parity = parity;
+		if (field->flip && (planes[i].height & 1) == 0)
+			task.parity ^= 1;
+
+		for (uint32_t y = 0; y < planes[i].height;
+		     y += DEINTERLACE_BAND_LINES) {
+			task.start_y = y;
+			task.end_y = y + DEINTERLACE_BAND_LINES;
+			if (task.end_y > planes[i].height)
+				task.end_y = planes[i].height;
+
+			da_push_back(tasks, &task);
+		}
+	}
+
+	*tasks_da = tasks.da;
+}
+
+static inline bool prev_frame_usable(const struct obs_source_frame *prev,
+				     const struct obs_source_frame *frame)
+{
+	return prev && prev->format == frame->format &&
+	       prev->width == frame->width && prev->height == frame->height &&
+	       frame->timestamp > prev->timestamp &&
+	       frame->timestamp - prev->timestamp <= MAX_TS_VAR;
+}
+
+static void store_prev_frame(obs_source_t *source,
+			     const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *prev = source->deinterlace_cpu_prev;
+
+	if (!prev || prev->format != frame->format ||
+	    prev->width != frame->width || prev->height != frame->height) {
+		obs_source_frame_destroy_pooled(prev);
+		prev = obs_source_frame_create_pooled(
+			frame->format, frame->width, frame->height);
+		source->deinterlace_cpu_prev = prev;
+	}
+
+	obs_source_frame_copy(prev, frame);
+}
+
+void deinterlace_cpu_output(obs_source_t *source,
+			    const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *prev = source->deinterlace_cpu_prev;
+	struct obs_source_frame *first_out = NULL;
+	struct obs_source_frame *second_out = NULL;
+	const uint32_t first = source->deinterlace_top_first ? 0 : 1;
+	DARRAY(struct deinterlace_task) tasks = {0};
+
+	/* without a previous frame, the missing field of the first frame is
+	 * rebuilt from the frame itself */
+	if (!prev_frame_usable(prev, frame))
+		prev = NULL;
+
+	if (prev && source->deinterlace_mode == OBS_DEINTERLACE_MODE_YADIF_2X) {
+		first_out = cache_async_frame(source, frame);
+		if (first_out)
+			add_field_tasks(&tasks.da, first_out, prev, prev,
+					frame, first ^ 1);
+	}
+
+	second_out = cache_async_frame(source, frame);
+	if (second_out)
+		add_field_tasks(&tasks.da, second_out, frame,
+				prev ? prev : frame, frame, first);
+
+	os_worker_pool_run(obs_get_deinterlace_pool(), run_deinterlace_task,
+			   tasks.array, tasks.num);
+	da_free(tasks);
+
+	if (first_out) {
+		copy_frame_info(first_out, frame);
+		first_out->timestamp -= (frame->timestamp - prev->timestamp) / 2;
+		push_async_frame(source, first_out);
+	}
+
+	if (second_out) {
+		copy_frame_info(second_out, frame);
+		push_async_frame(source, second_out);
+	}
+
+	store_prev_frame(source, frame);
+}
+
 static void enable_deinterlacing(obs_source_t *source,
 				 enum obs_deinterlace_mode mode)
 {
@@ -533,3 +790,18 @@ obs_source_get_deinterlace_field_order(const obs_source_t *source)
 		       ? OBS_DEINTERLACE_FIELD_ORDER_TOP
 		       : OBS_DEINTERLACE_FIELD_ORDER_BOTTOM;
 }
+
+void obs_source_set_deinterlace_cpu(obs_source_t *source, bool cpu)
+{
+	if (!obs_source_valid(source, "obs_source_set_deinterlace_cpu"))
+		return;
+
+	source->deinterlace_cpu = cpu;
+}
+
+bool obs_source_get_deinterlace_cpu(const obs_source_t *source)
+{
+	return obs_source_valid(source, "obs_source_get_deinterlace_cpu")
+		       ? source->deinterlace_cpu
+		       : false;
+}
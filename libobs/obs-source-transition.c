@@ -955,7 +955,8 @@ static void process_audio(obs_source_t *transition, obs_source_t *child,
 			  uint32_t mixers, size_t channels, size_t sample_rate,
 			  obs_transition_audio_mix_callback_t mix)
 {
-	bool valid = child && !child->audio_pending && child->audio_ts;
+	bool valid = child && !child->audio_pending && child->audio_ts &&
+		     obs_source_audio_rendered(child);
 	struct obs_source_audio_mix child_audio;
 	uint64_t ts;
 	size_t pos;
@@ -994,7 +995,8 @@ static inline uint64_t calc_min_ts(obs_source_t *sources[2])
 
 	for (size_t i = 0; i < 2; i++) {
 		if (sources[i] && !sources[i]->audio_pending &&
-		    sources[i]->audio_ts) {
+		    sources[i]->audio_ts &&
+		    obs_source_audio_rendered(sources[i])) {
 			if (!min_ts || sources[i]->audio_ts < min_ts)
 				min_ts = sources[i]->audio_ts;
 		}
@@ -34,15 +34,19 @@
 #define get_weak(source) ((obs_weak_source_t *)source->context.control)
 
 static bool filter_compatible(obs_source_t *source, obs_source_t *filter);
+static bool render_fused_filters(obs_source_t *filter);
 
 static inline bool data_valid(const struct obs_source *source, const char *f)
 {
 	return obs_source_valid(source, f) && source->context.data;
 }
 
+/* whether frames are deinterlaced when rendered, frames that were already
+ * deinterlaced on the CPU are rendered as they are */
 static inline bool deinterlacing_enabled(const struct obs_source *source)
 {
-	return source->deinterlace_mode != OBS_DEINTERLACE_MODE_DISABLE;
+	return source->deinterlace_mode != OBS_DEINTERLACE_MODE_DISABLE &&
+	       !os_atomic_load_bool(&source->deinterlace_cpu_active);
 }
 
 static inline bool destroying(const struct obs_source *source)
@@ -177,6 +181,21 @@ static inline bool is_composite_source(const struct obs_source *source)
 	return source->info.output_flags & OBS_SOURCE_COMPOSITE;
 }
 
+/* transitions and async sources need their tick to process frames and
+ * transition state even when they are not showing */
+static inline bool source_always_ticks(const struct obs_source *source)
+{
+	uint32_t flags = source->info.output_flags;
+
+	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
+		return true;
+	if (source->info.video_tick &&
+	    (flags & OBS_SOURCE_TICK_WHEN_VISIBLE) == 0)
+		return true;
+	return source->info.type != OBS_SOURCE_TYPE_FILTER &&
+	       (flags & OBS_SOURCE_ASYNC) != 0;
+}
+
 extern char *find_libobs_data_file(const char *file);
 
 /* internal initialization */
@@ -242,8 +261,12 @@ static void obs_source_init_finalize(struct obs_source *source)
 		obs->data.first_audio_source = source;
 
 		pthread_mutex_unlock(&obs->data.audio_sources_mutex);
+		obs_audio_tree_changed();
 	}
 
+	if (source_always_ticks(source))
+		obs_source_tick_list_add(source);
+
 	if (!source->context.private) {
 		obs_context_data_insert_name(&source->context,
 					     &obs->data.sources_mutex,
@@ -344,10 +367,10 @@ static void obs_source_init_audio_hotkeys(struct obs_source *source)
 		obs_source_hotkey_push_to_talk, source);
 }
 
-static obs_source_t *
-obs_source_create_internal(const char *id, const char *name, const char *uuid,
-			   obs_data_t *settings, obs_data_t *hotkey_data,
-			   bool private, uint32_t last_obs_ver)
+obs_source_t *obs_source_create_deferred(const char *id, const char *name,
+					 const char *uuid, obs_data_t *settings,
+					 obs_data_t *hotkey_data,
+					 uint32_t last_obs_ver, bool private)
 {
 	struct obs_source *source = bzalloc(sizeof(struct obs_source));
 
@@ -395,16 +418,33 @@ obs_source_create_internal(const char *id, const char *name, const char *uuid,
 	if (!private)
 		obs_source_init_audio_hotkeys(source);
 
+	return source;
+
+fail:
+	blog(LOG_ERROR, "obs_source_create failed");
+	obs_source_destroy(source);
+	return NULL;
+}
+
+void obs_source_create_data(obs_source_t *source)
+{
 	/* allow the source to be created even if creation fails so that the
 	 * user's data doesn't become lost */
-	if (info && info->create)
+	if (source->info.create)
 		source->context.data =
-			info->create(source->context.settings, source);
-	if ((!info || info->create) && !source->context.data)
-		blog(LOG_ERROR, "Failed to create source '%s'!", name);
+			source->info.create(source->context.settings, source);
+	if ((source->owns_info_id || source->info.create) &&
+	    !source->context.data)
+		blog(LOG_ERROR, "Failed to create source '%s'!",
+		     source->context.name);
+}
+
+void obs_source_create_finish(obs_source_t *source)
+{
+	bool private = source->context.private;
 
 	blog(LOG_DEBUG, "%ssource '%s' (%s) created", private ? "private " : "",
-	     name, id);
+	     source->context.name, source->info.id);
 
 	source->flags = source->default_flags;
 	source->enabled = true;
@@ -413,13 +453,22 @@ obs_source_create_internal(const char *id, const char *name, const char *uuid,
 	if (!private) {
 		obs_source_dosignal(source, "source_create", NULL);
 	}
+}
 
-	return source;
+static obs_source_t *
+obs_source_create_internal(const char *id, const char *name, const char *uuid,
+			   obs_data_t *settings, obs_data_t *hotkey_data,
+			   bool private, uint32_t last_obs_ver)
+{
+	obs_source_t *source = obs_source_create_deferred(
+		id, name, uuid, settings, hotkey_data, last_obs_ver, private);
 
-fail:
-	blog(LOG_ERROR, "obs_source_create failed");
-	obs_source_destroy(source);
-	return NULL;
+	if (source) {
+		obs_source_create_data(source);
+		obs_source_create_finish(source);
+	}
+
+	return source;
 }
 
 obs_source_t *obs_source_create(const char *id, const char *name,
@@ -596,6 +645,21 @@ obs_source_t *obs_source_duplicate(obs_source_t *source, const char *new_name,
 	return new_source;
 }
 
+static void frame_init_from_video(struct obs_source_frame *frame,
+				  enum video_format format, uint32_t width,
+				  uint32_t height,
+				  const struct video_frame *vid_frame)
+{
+	frame->format = format;
+	frame->width = width;
+	frame->height = height;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+		frame->data[i] = vid_frame->data[i];
+		frame->linesize[i] = vid_frame->linesize[i];
+	}
+}
+
 void obs_source_frame_init(struct obs_source_frame *frame,
 			   enum video_format format, uint32_t width,
 			   uint32_t height)
@@ -606,26 +670,124 @@ void obs_source_frame_init(struct obs_source_frame *frame,
 		return;
 
 	video_frame_init(&vid_frame, format, width, height);
-	frame->format = format;
-	frame->width = width;
-	frame->height = height;
+	frame_init_from_video(frame, format, width, height, &vid_frame);
+}
 
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-		frame->data[i] = vid_frame.data[i];
-		frame->linesize[i] = vid_frame.linesize[i];
+struct obs_source_frame *
+obs_source_frame_create_pooled(enum video_format format, uint32_t width,
+			       uint32_t height)
+{
+	struct obs_source_frame *frame = bzalloc(sizeof(*frame));
+	struct video_frame vid_frame;
+
+	video_frame_init_pooled(&vid_frame, format, width, height);
+	frame_init_from_video(frame, format, width, height, &vid_frame);
+	return frame;
+}
+
+void obs_source_frame_destroy_pooled(struct obs_source_frame *frame)
+{
+	if (frame) {
+		frame_pool_free(frame->data[0]);
+		bfree(frame);
 	}
 }
 
 static inline void obs_source_frame_decref(struct obs_source_frame *frame)
 {
 	if (os_atomic_dec_long(&frame->refs) == 0)
-		obs_source_frame_destroy(frame);
+		obs_source_frame_destroy_pooled(frame);
 }
 
 static bool obs_source_filter_remove_refless(obs_source_t *source,
 					     obs_source_t *filter);
 static void obs_source_destroy_defer(struct obs_source *source);
 
+/* assumes tick_sources_mutex is locked */
+void obs_source_tick_list_remove(obs_source_t *source)
+{
+	if (!source->prev_next_tick_source)
+		return;
+
+	*source->prev_next_tick_source = source->next_tick_source;
+	if (source->next_tick_source)
+		source->next_tick_source->prev_next_tick_source =
+			source->prev_next_tick_source;
+
+	source->next_tick_source = NULL;
+	source->prev_next_tick_source = NULL;
+}
+
+/* Only sources that need it are ticked each frame: sources that are showing
+ * or active, have a deferred update pending, or always tick, which is any
+ * source with a video_tick callback unless its type sets
+ * OBS_SOURCE_TICK_WHEN_VISIBLE.  Filters are ticked along with their parent.
+ * This is called whenever one of those conditions may have become true, and
+ * sources are pruned from the list again on the graphics thread once none of
+ * them hold anymore. */
+void obs_source_tick_list_add(obs_source_t *source)
+{
+	struct obs_core_data *data = &obs->data;
+	obs_source_t *parent = source->filter_parent;
+
+	if (parent)
+		source = parent;
+
+	pthread_mutex_lock(&data->tick_sources_mutex);
+
+	if (!source->prev_next_tick_source &&
+	    !os_atomic_load_long(&source->destroying)) {
+		source->next_tick_source = data->first_tick_source;
+		source->prev_next_tick_source = &data->first_tick_source;
+		if (data->first_tick_source)
+			data->first_tick_source->prev_next_tick_source =
+				&source->next_tick_source;
+		data->first_tick_source = source;
+	}
+
+	pthread_mutex_unlock(&data->tick_sources_mutex);
+}
+
+static bool source_needs_tick(obs_source_t *source)
+{
+	bool needs_tick = false;
+
+	if (source_always_ticks(source) || source->showing || source->active)
+		return true;
+	if (os_atomic_load_long(&source->show_refs) ||
+	    os_atomic_load_long(&source->activate_refs) ||
+	    os_atomic_load_long(&source->defer_update_count))
+		return true;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t *filter = source->filters.array[i];
+		if (source_always_ticks(filter) ||
+		    os_atomic_load_long(&filter->defer_update_count)) {
+			needs_tick = true;
+			break;
+		}
+	}
+	pthread_mutex_unlock(&source->filter_mutex);
+
+	return needs_tick;
+}
+
+/* called on the graphics thread after the source was ticked */
+void obs_source_tick_list_prune(obs_source_t *source)
+{
+	/* shortcuts for the common cases.  only this thread removes sources
+	 * from the list, and keeping a source listed is always safe. */
+	if (!source->prev_next_tick_source || source->showing ||
+	    source->active)
+		return;
+
+	pthread_mutex_lock(&obs->data.tick_sources_mutex);
+	if (!source_needs_tick(source))
+		obs_source_tick_list_remove(source);
+	pthread_mutex_unlock(&obs->data.tick_sources_mutex);
+}
+
 void obs_source_destroy(struct obs_source *source)
 {
 	if (!obs_source_valid(source, "obs_source_destroy"))
@@ -660,6 +822,11 @@ void obs_source_destroy(struct obs_source *source)
 				source->prev_next_audio_source;
 	}
 	pthread_mutex_unlock(&obs->data.audio_sources_mutex);
+	obs_audio_tree_changed();
+
+	pthread_mutex_lock(&obs->data.tick_sources_mutex);
+	obs_source_tick_list_remove(source);
+	pthread_mutex_unlock(&obs->data.tick_sources_mutex);
 
 	if (source->filter_parent)
 		obs_source_filter_remove_refless(source->filter_parent, source);
@@ -677,10 +844,10 @@ void obs_source_destroy(struct obs_source *source)
 				 (os_task_t)obs_source_destroy_defer, source);
 }
 
+static void obs_source_free(struct obs_source *source);
+
 static void obs_source_destroy_defer(struct obs_source *source)
 {
-	size_t i;
-
 	/* prevents the destruction of sources if destroy triggered inside of
 	 * a video tick call */
 	obs_context_wait(&source->context);
@@ -692,6 +859,19 @@ static void obs_source_destroy_defer(struct obs_source *source)
 		source->context.data = NULL;
 	}
 
+	obs_source_free(source);
+}
+
+void obs_source_destroy_deferred(obs_source_t *source)
+{
+	if (source)
+		obs_source_free(source);
+}
+
+static void obs_source_free(struct obs_source *source)
+{
+	size_t i;
+
 	blog(LOG_DEBUG, "%ssource '%s' destroyed",
 	     source->context.private ? "private " : "", source->context.name);
 
@@ -703,6 +883,7 @@ static void obs_source_destroy_defer(struct obs_source *source)
 
 	for (i = 0; i < source->async_cache.num; i++)
 		obs_source_frame_decref(source->async_cache.array[i].frame);
+	obs_source_frame_destroy_pooled(source->deinterlace_cpu_prev);
 
 	gs_enter_context(obs->video.graphics);
 	if (source->async_texrender)
@@ -715,6 +896,7 @@ static void obs_source_destroy_defer(struct obs_source *source)
 	}
 	if (source->filter_texrender)
 		gs_texrender_destroy(source->filter_texrender);
+	gs_effect_destroy(source->fused_effect);
 	if (source->color_space_texrender)
 		gs_texrender_destroy(source->color_space_texrender);
 	gs_leave_context();
@@ -727,7 +909,7 @@ static void obs_source_destroy_defer(struct obs_source *source)
 	bfree(source->audio_output_buf[0][0]);
 	bfree(source->audio_mix_buf[0]);
 
-	obs_source_frame_destroy(source->async_preload_frame);
+	obs_source_frame_destroy_pooled(source->async_preload_frame);
 
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_free(source);
@@ -976,6 +1158,7 @@ static void obs_source_deferred_update(obs_source_t *source)
 		long count = os_atomic_load_long(&source->defer_update_count);
 		source->info.update(source->context.data,
 				    source->context.settings);
+		os_atomic_inc_long(&source->content_generation);
 		os_atomic_compare_swap_long(&source->defer_update_count, count,
 					    0);
 		obs_source_dosignal(source, "source_update", "update");
@@ -993,9 +1176,11 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 
 	if (source->info.output_flags & OBS_SOURCE_VIDEO) {
 		os_atomic_inc_long(&source->defer_update_count);
+		obs_source_tick_list_add(source);
 	} else if (source->context.data && source->info.update) {
 		source->info.update(source->context.data,
 				    source->context.settings);
+		os_atomic_inc_long(&source->content_generation);
 		obs_source_dosignal(source, "source_update", "update");
 	}
 }
@@ -1017,6 +1202,86 @@ void obs_source_update_properties(obs_source_t *source)
 	obs_source_dosignal(source, NULL, "update_properties");
 }
 
+void obs_source_content_changed(obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_content_changed"))
+		return;
+
+	os_atomic_inc_long(&source->content_generation);
+}
+
+static inline bool source_content_dynamic(const obs_source_t *source)
+{
+	const uint32_t flags = source->info.output_flags;
+
+	return !source->context.data ||
+	       source->info.type == OBS_SOURCE_TYPE_TRANSITION ||
+	       (flags & OBS_SOURCE_ASYNC) != 0 ||
+	       (flags & OBS_SOURCE_STATIC_CONTENT) == 0;
+}
+
+/* generation of the output of the source itself, without its filters */
+static uint64_t source_generation(obs_source_t *source)
+{
+	uint64_t gen = 0xcbf29ce484222325ULL;
+	long content_gen;
+
+	if (!obs_get_render_cache_enabled())
+		return 0;
+
+	if (source->info.type == OBS_SOURCE_TYPE_SCENE &&
+	    source->context.data) {
+		gen = obs_scene_get_content_generation(source->context.data);
+		if (!gen)
+			return 0;
+
+	} else if (source_content_dynamic(source)) {
+		return 0;
+	}
+
+	content_gen = os_atomic_load_long(&source->content_generation);
+	gen = content_generation_mix(gen, (uint64_t)content_gen);
+	return content_generation_mix(gen, source->enabled);
+}
+
+/* generation of what rendering a source produces as part of a filter chain,
+ * i.e. the source itself if it's the filter parent, or the output of the
+ * filter with all the filters below it otherwise */
+static uint64_t filter_chain_generation(obs_source_t *source)
+{
+	uint64_t input_gen;
+	uint64_t gen;
+
+	if (!source->filter_parent)
+		return source_generation(source);
+	if (!source->filter_target)
+		return 0;
+
+	/* disabled filters pass their input through */
+	input_gen = filter_chain_generation(source->filter_target);
+	if (!input_gen || !source->enabled)
+		return input_gen;
+
+	gen = source_generation(source);
+	if (!gen)
+		return 0;
+
+	gen = content_generation_mix(gen, (uintptr_t)source);
+	return content_generation_mix(gen, input_gen);
+}
+
+uint64_t obs_source_get_content_generation(obs_source_t *source)
+{
+	uint64_t gen;
+
+	pthread_mutex_lock(&source->filter_mutex);
+	gen = source->filters.num
+		      ? filter_chain_generation(source->filters.array[0])
+		      : source_generation(source);
+	pthread_mutex_unlock(&source->filter_mutex);
+	return gen;
+}
+
 void obs_source_send_mouse_click(obs_source_t *source,
 				 const struct obs_mouse_event *event,
 				 int32_t type, bool mouse_up,
@@ -1131,6 +1396,7 @@ static void activate_tree(obs_source_t *parent, obs_source_t *child,
 			  void *param)
 {
 	os_atomic_inc_long(&child->activate_refs);
+	obs_source_tick_list_add(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -1148,6 +1414,7 @@ static void deactivate_tree(obs_source_t *parent, obs_source_t *child,
 static void show_tree(obs_source_t *parent, obs_source_t *child, void *param)
 {
 	os_atomic_inc_long(&child->show_refs);
+	obs_source_tick_list_add(child);
 
 	UNUSED_PARAMETER(parent);
 	UNUSED_PARAMETER(param);
@@ -1167,12 +1434,15 @@ void obs_source_activate(obs_source_t *source, enum view_type type)
 		return;
 
 	os_atomic_inc_long(&source->show_refs);
+	obs_source_tick_list_add(source);
 	obs_source_enum_active_tree(source, show_tree, NULL);
 
 	if (type == MAIN_VIEW) {
 		os_atomic_inc_long(&source->activate_refs);
 		obs_source_enum_active_tree(source, activate_tree, NULL);
 	}
+
+	obs_audio_tree_changed();
 }
 
 void obs_source_deactivate(obs_source_t *source, enum view_type type)
@@ -1192,6 +1462,8 @@ void obs_source_deactivate(obs_source_t *source, enum view_type type)
 						    NULL);
 		}
 	}
+
+	obs_audio_tree_changed();
 }
 
 static inline struct obs_source_frame *get_closest_frame(obs_source_t *source,
@@ -1241,13 +1513,12 @@ static void async_tick(obs_source_t *source)
 	pthread_mutex_unlock(&source->async_mutex);
 }
 
-void obs_source_video_tick(obs_source_t *source, float seconds)
+/* everything a video tick does besides calling the video_tick callback, which
+ * has to happen on the graphics thread */
+void obs_source_video_tick_state(obs_source_t *source, float seconds)
 {
 	bool now_showing, now_active;
 
-	if (!obs_source_valid(source, "obs_source_video_tick"))
-		return;
-
 	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
 		obs_transition_tick(source, seconds);
 
@@ -1309,13 +1580,39 @@ void obs_source_video_tick(obs_source_t *source, float seconds)
 		source->active = now_active;
 	}
 
-	if (source->context.data && source->info.video_tick)
-		source->info.video_tick(source->context.data, seconds);
-
 	source->async_rendered = false;
 	source->deinterlace_rendered = false;
 }
 
+void obs_source_call_video_tick(obs_source_t *source, float seconds)
+{
+	const char *profile_name;
+
+	if (!source->context.data || !source->info.video_tick)
+		return;
+
+	profile_name = source->profile_tick_name;
+	if (!profile_name) {
+		profile_name = profile_store_name(obs_get_profiler_name_store(),
+						  "video_tick(%s)",
+						  source->context.name);
+		source->profile_tick_name = profile_name;
+	}
+
+	profile_start(profile_name);
+	source->info.video_tick(source->context.data, seconds);
+	profile_end(profile_name);
+}
+
+void obs_source_video_tick(obs_source_t *source, float seconds)
+{
+	if (!obs_source_valid(source, "obs_source_video_tick"))
+		return;
+
+	obs_source_video_tick_state(source, seconds);
+	obs_source_call_video_tick(source, seconds);
+}
+
 /* unless the value is 3+ hours worth of frames, this won't overflow */
 static inline uint64_t conv_frames_to_time(const size_t sample_rate,
 					   const size_t frames)
@@ -2927,8 +3224,10 @@ static inline void render_video(obs_source_t *source)
 	if (source->filters.num && !source->rendering_filter)
 		obs_source_render_filters(source);
 
-	else if (source->info.video_render)
-		obs_source_main_render(source);
+	else if (source->info.video_render) {
+		if (!source->filter_parent || !render_fused_filters(source))
+			obs_source_main_render(source);
+	}
 
 	else if (source->filter_target)
 		obs_source_video_render(source->filter_target);
@@ -3130,6 +3429,9 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 
 	signal_handler_signal(source->context.signals, "filter_add", &cd);
 
+	/* filters are ticked along with their parent */
+	obs_source_tick_list_add(source);
+
 	blog(LOG_DEBUG, "- filter '%s' (%s) added to source '%s'",
 	     filter->context.name, filter->info.id, source->context.name);
 }
@@ -3402,8 +3704,8 @@ static inline void copy_frame_data_plane(struct obs_source_frame *dst,
 	}
 }
 
-static void copy_frame_data(struct obs_source_frame *dst,
-			    const struct obs_source_frame *src)
+void copy_frame_info(struct obs_source_frame *dst,
+		     const struct obs_source_frame *src)
 {
 	dst->flip = src->flip;
 	dst->flags = src->flags;
@@ -3417,6 +3719,12 @@ static void copy_frame_data(struct obs_source_frame *dst,
 		memcpy(dst->color_range_min, src->color_range_min, size);
 		memcpy(dst->color_range_max, src->color_range_max, size);
 	}
+}
+
+static void copy_frame_data(struct obs_source_frame *dst,
+			    const struct obs_source_frame *src)
+{
+	copy_frame_info(dst, src);
 
 	switch (src->format) {
 	case VIDEO_FORMAT_I420:
@@ -3527,7 +3835,7 @@ static void clean_cache(obs_source_t *source)
 		struct async_frame *af = &source->async_cache.array[i - 1];
 		if (!af->used) {
 			if (++af->unused_count == MAX_UNUSED_FRAME_DURATION) {
-				obs_source_frame_destroy(af->frame);
+				obs_source_frame_destroy_pooled(af->frame);
 				da_erase(source->async_cache, i - 1);
 			}
 		}
@@ -3535,9 +3843,11 @@ static void clean_cache(obs_source_t *source)
 }
 
 #define MAX_ASYNC_FRAMES 30
+/* returns an unused frame from the cache for a frame of the same format and
+ * size as `frame`, without copying the frame data */
 //if return value is not null then do (os_atomic_dec_long(&output->refs) == 0) && obs_source_frame_destroy(output)
-static inline struct obs_source_frame *
-cache_video(struct obs_source *source, const struct obs_source_frame *frame)
+struct obs_source_frame *cache_async_frame(obs_source_t *source,
+					   const struct obs_source_frame *frame)
 {
 	struct obs_source_frame *new_frame = NULL;
 
@@ -3577,8 +3887,8 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 	if (!new_frame) {
 		struct async_frame new_af;
 
-		new_frame = obs_source_frame_create(format, frame->width,
-						    frame->height);
+		new_frame = obs_source_frame_create_pooled(
+			format, frame->width, frame->height);
 		new_af.frame = new_frame;
 		new_af.used = true;
 		new_af.unused_count = 0;
@@ -3591,11 +3901,56 @@ cache_video(struct obs_source *source, const struct obs_source_frame *frame)
 
 	pthread_mutex_unlock(&source->async_mutex);
 
-	copy_frame_data(new_frame, frame);
+	return new_frame;
+}
+
+static inline struct obs_source_frame *
+cache_video(struct obs_source *source, const struct obs_source_frame *frame)
+{
+	struct obs_source_frame *new_frame = cache_async_frame(source, frame);
+
+	if (new_frame)
+		copy_frame_data(new_frame, frame);
 
 	return new_frame;
 }
 
+/* queues a frame returned by cache_async_frame for rendering */
+void push_async_frame(obs_source_t *source, struct obs_source_frame *output)
+{
+	pthread_mutex_lock(&source->async_mutex);
+	if (output) {
+		if (os_atomic_dec_long(&output->refs) == 0) {
+			obs_source_frame_destroy_pooled(output);
+			output = NULL;
+		} else {
+			da_push_back(source->async_frames, &output);
+			source->async_active = true;
+		}
+	}
+	pthread_mutex_unlock(&source->async_mutex);
+}
+
+/* switches between deinterlacing frames on the CPU as they arrive and
+ * deinterlacing them on the GPU when they are rendered.  frames that are
+ * already cached were made for the other way, so they're dropped */
+static void update_deinterlace_cpu(obs_source_t *source, bool active)
+{
+	if (os_atomic_load_bool(&source->deinterlace_cpu_active) == active)
+		return;
+
+	pthread_mutex_lock(&source->async_mutex);
+	free_async_cache(source);
+	source->last_frame_ts = 0;
+	os_atomic_store_bool(&source->deinterlace_cpu_active, active);
+	pthread_mutex_unlock(&source->async_mutex);
+
+	if (!active) {
+		obs_source_frame_destroy_pooled(source->deinterlace_cpu_prev);
+		source->deinterlace_cpu_prev = NULL;
+	}
+}
+
 static void
 obs_source_output_video_internal(obs_source_t *source,
 				 const struct obs_source_frame *frame)
@@ -3612,20 +3967,15 @@ obs_source_output_video_internal(obs_source_t *source,
 		return;
 	}
 
-	struct obs_source_frame *output = cache_video(source, frame);
+	const bool cpu = deinterlace_cpu_supported(source, frame);
+	update_deinterlace_cpu(source, cpu);
 
-	/* ------------------------------------------- */
-	pthread_mutex_lock(&source->async_mutex);
-	if (output) {
-		if (os_atomic_dec_long(&output->refs) == 0) {
-			obs_source_frame_destroy(output);
-			output = NULL;
-		} else {
-			da_push_back(source->async_frames, &output);
-			source->async_active = true;
-		}
+	if (cpu) {
+		deinterlace_cpu_output(source, frame);
+		return;
 	}
-	pthread_mutex_unlock(&source->async_mutex);
+
+	push_async_frame(source, cache_video(source, frame));
 }
 
 void obs_source_output_video(obs_source_t *source,
@@ -3760,8 +4110,8 @@ obs_source_preload_video_internal(obs_source_t *source,
 		return;
 
 	if (preload_frame_changed(source, frame)) {
-		obs_source_frame_destroy(source->async_preload_frame);
-		source->async_preload_frame = obs_source_frame_create(
+		obs_source_frame_destroy_pooled(source->async_preload_frame);
+		source->async_preload_frame = obs_source_frame_create_pooled(
 			frame->format, frame->width, frame->height);
 	}
 
@@ -3867,8 +4217,8 @@ obs_source_set_video_frame_internal(obs_source_t *source,
 	obs_enter_graphics();
 
 	if (preload_frame_changed(source, frame)) {
-		obs_source_frame_destroy(source->async_preload_frame);
-		source->async_preload_frame = obs_source_frame_create(
+		obs_source_frame_destroy_pooled(source->async_preload_frame);
+		source->async_preload_frame = obs_source_frame_create_pooled(
 			frame->format, frame->width, frame->height);
 	}
 
@@ -4316,12 +4666,12 @@ void obs_source_release_frame(obs_source_t *source,
 		return;
 
 	if (!source) {
-		obs_source_frame_destroy(frame);
+		obs_source_frame_destroy_pooled(frame);
 	} else {
 		pthread_mutex_lock(&source->async_mutex);
 
 		if (os_atomic_dec_long(&frame->refs) == 0)
-			obs_source_frame_destroy(frame);
+			obs_source_frame_destroy_pooled(frame);
 		else
 			remove_async_frame(source, frame);
 
@@ -4370,6 +4720,8 @@ void obs_source_set_name(obs_source_t *source, const char *name)
 		signal_handler_signal(source->context.signals, "rename", &data);
 		calldata_free(&data);
 		bfree(prev_name);
+
+		source->profile_tick_name = NULL;
 	}
 }
 
@@ -4452,6 +4804,70 @@ static inline bool can_bypass(obs_source_t *target, obs_source_t *parent,
 		space == gs_get_color_space());
 }
 
+/* renders the target of a filter to the filter's texture, or reuses what was
+ * rendered previously if nothing below the filter changed since then */
+static void render_filter_input(obs_source_t *filter, obs_source_t *target,
+				obs_source_t *parent,
+				enum gs_color_format format,
+				enum gs_color_space space, int cx, int cy)
+{
+	uint32_t parent_flags = parent->info.output_flags;
+	uint64_t key;
+
+	if (filter->filter_texrender &&
+	    (gs_texrender_get_format(filter->filter_texrender) != format)) {
+		gs_texrender_destroy(filter->filter_texrender);
+		filter->filter_texrender = NULL;
+	}
+
+	if (!filter->filter_texrender) {
+		filter->filter_texrender =
+			gs_texrender_create(format, GS_ZS_NONE);
+		filter->filter_render_key = 0;
+	}
+
+	key = filter_chain_generation(target);
+	if (key) {
+		key = content_generation_mix(key, (uint64_t)cx);
+		key = content_generation_mix(key, (uint64_t)cy);
+		key = content_generation_mix(key, space);
+		key = content_generation_mix(
+			key, (uint64_t)obs_get_video_sdr_white_level());
+
+		if (key == filter->filter_render_key) {
+			os_atomic_inc_long(&obs->video.render_cache_hits);
+			return;
+		}
+	}
+
+	if (gs_texrender_begin_with_color_space(filter->filter_texrender, cx,
+						cy, space)) {
+		gs_blend_state_push();
+		gs_blend_function_separate(GS_BLEND_SRCALPHA,
+					   GS_BLEND_INVSRCALPHA, GS_BLEND_ONE,
+					   GS_BLEND_INVSRCALPHA);
+
+		bool custom_draw = (parent_flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
+		bool async = (parent_flags & OBS_SOURCE_ASYNC) != 0;
+		struct vec4 clear_color;
+
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+		if (target == parent && !custom_draw && !async)
+			obs_source_default_render(target);
+		else
+			obs_source_video_render(target);
+
+		gs_blend_state_pop();
+
+		gs_texrender_end(filter->filter_texrender);
+		filter->filter_render_key = key;
+		os_atomic_inc_long(&obs->video.render_cache_misses);
+	}
+}
+
 bool obs_source_process_filter_begin(obs_source_t *filter,
 				     enum gs_color_format format,
 				     enum obs_allow_direct_render allow_direct)
@@ -4510,41 +4926,7 @@ bool obs_source_process_filter_begin_with_color_space(
 		return false;
 	}
 
-	if (filter->filter_texrender &&
-	    (gs_texrender_get_format(filter->filter_texrender) != format)) {
-		gs_texrender_destroy(filter->filter_texrender);
-		filter->filter_texrender = NULL;
-	}
-
-	if (!filter->filter_texrender) {
-		filter->filter_texrender =
-			gs_texrender_create(format, GS_ZS_NONE);
-	}
-
-	if (gs_texrender_begin_with_color_space(filter->filter_texrender, cx,
-						cy, space)) {
-		gs_blend_state_push();
-		gs_blend_function_separate(GS_BLEND_SRCALPHA,
-					   GS_BLEND_INVSRCALPHA, GS_BLEND_ONE,
-					   GS_BLEND_INVSRCALPHA);
-
-		bool custom_draw = (parent_flags & OBS_SOURCE_CUSTOM_DRAW) != 0;
-		bool async = (parent_flags & OBS_SOURCE_ASYNC) != 0;
-		struct vec4 clear_color;
-
-		vec4_zero(&clear_color);
-		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
-		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
-
-		if (target == parent && !custom_draw && !async)
-			obs_source_default_render(target);
-		else
-			obs_source_video_render(target);
-
-		gs_blend_state_pop();
-
-		gs_texrender_end(filter->filter_texrender);
-	}
+	render_filter_input(filter, target, parent, format, space, cx, cy);
 	return true;
 }
 
@@ -4627,6 +5009,246 @@ void obs_source_skip_video_filter(obs_source_t *filter)
 	}
 }
 
+/* ------------------------------------------------------------------------- */
+/* fused per-pixel filters */
+
+#define MAX_FUSED_FILTERS 8
+
+static const char *fused_effect_head =
+	"uniform float4x4 ViewProj;\n"
+	"uniform texture2d image;\n"
+	"\n"
+	"sampler_state textureSampler {\n"
+	"\tFilter   = Linear;\n"
+	"\tAddressU = Clamp;\n"
+	"\tAddressV = Clamp;\n"
+	"};\n"
+	"\n"
+	"struct VertData {\n"
+	"\tfloat4 pos : POSITION;\n"
+	"\tfloat2 uv  : TEXCOORD0;\n"
+	"};\n"
+	"\n"
+	"VertData VSDefault(VertData v_in)\n"
+	"{\n"
+	"\tVertData vert_out;\n"
+	"\tvert_out.pos = mul(float4(v_in.pos.xyz, 1.0), ViewProj);\n"
+	"\tvert_out.uv  = v_in.uv;\n"
+	"\treturn vert_out;\n"
+	"}\n";
+
+static const char *fused_effect_tail =
+	"\treturn rgba;\n"
+	"}\n"
+	"\n"
+	"technique Draw\n"
+	"{\n"
+	"\tpass\n"
+	"\t{\n"
+	"\t\tvertex_shader = VSDefault(v_in);\n"
+	"\t\tpixel_shader  = PSFused(v_in);\n"
+	"\t}\n"
+	"}\n";
+
+static inline bool pixel_filter(const obs_source_t *filter)
+{
+	return filter->info.get_pixel_shader && filter->info.set_pixel_params;
+}
+
+/* the enabled per-pixel filters from the given one down, top first, and the
+ * source that is rendered as their input.  disabled filters pass their input
+ * through, so they don't end the run */
+static size_t get_fused_filters(obs_source_t *filter, obs_source_t **run,
+				const char **shaders, obs_source_t **input)
+{
+	const uint32_t srgb = filter->info.output_flags & OBS_SOURCE_SRGB;
+	size_t count = 0;
+
+	while (filter && filter->filter_parent && count < MAX_FUSED_FILTERS) {
+		if (filter->enabled) {
+			const uint32_t flags = filter->info.output_flags;
+			const char *shader;
+
+			if (!filter->context.data || !pixel_filter(filter) ||
+			    (flags & OBS_SOURCE_SRGB) != srgb)
+				break;
+
+			shader = filter->info.get_pixel_shader(
+				filter->context.data);
+			if (!shader)
+				break;
+
+			run[count] = filter;
+			shaders[count++] = shader;
+		}
+
+		filter = filter->filter_target;
+	}
+
+	*input = filter;
+	return count;
+}
+
+static uint64_t hash_shaders(const char **shaders, size_t count)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	for (size_t i = 0; i < count; i++) {
+		for (const char *c = shaders[i]; *c; c++)
+			hash = content_generation_mix(hash, (uint8_t)*c);
+		hash = content_generation_mix(hash, 0);
+	}
+
+	return hash;
+}
+
+/* builds the effect that applies the run bottom up, cached on the filter at
+ * the top of the run until the shaders change */
+static gs_effect_t *get_fused_effect(obs_source_t *filter, const char **shaders,
+				     size_t count)
+{
+	const uint64_t key = hash_shaders(shaders, count);
+	struct dstr effect_string = {0};
+	struct dstr shader = {0};
+	char *errors = NULL;
+
+	if (key == filter->fused_effect_key)
+		return filter->fused_effect;
+
+	dstr_copy(&effect_string, fused_effect_head);
+
+	for (size_t i = 0; i < count; i++) {
+		char prefix[16];
+
+		snprintf(prefix, sizeof(prefix), "p%zu_", i);
+		dstr_copy(&shader, shaders[count - 1 - i]);
+		dstr_replace(&shader, "PIXEL_", prefix);
+		dstr_cat(&effect_string, "\n");
+		dstr_cat_dstr(&effect_string, &shader);
+	}
+
+	dstr_cat(&effect_string, "\nfloat4 PSFused(VertData v_in) : TARGET\n"
+				 "{\n"
+				 "\tfloat4 rgba = image.Sample(textureSampler, "
+				 "v_in.uv);\n");
+	for (size_t i = 0; i < count; i++)
+		dstr_catf(&effect_string, "\trgba = p%zu_filter(rgba);\n", i);
+	dstr_cat(&effect_string, fused_effect_tail);
+
+	/* without a file name, so that the effect isn't kept in the effect
+	 * cache of the graphics subsystem and can be destroyed */
+	gs_effect_destroy(filter->fused_effect);
+	filter->fused_effect =
+		gs_effect_create(effect_string.array, NULL, &errors);
+	filter->fused_effect_key = key;
+
+	/* not tried again until the shaders change, the filters are rendered
+	 * one by one meanwhile */
+	if (!filter->fused_effect)
+		blog(LOG_WARNING,
+		     "Failed to fuse the filters below '%s', "
+		     "rendering them separately: %s",
+		     filter->context.name, errors ? errors : "");
+
+	bfree(errors);
+	dstr_free(&shader);
+	dstr_free(&effect_string);
+	return filter->fused_effect;
+}
+
+/* renders a run of adjacent per-pixel filters in a single pass instead of
+ * one pass and one texture per filter.  returns false if there's no run to
+ * fuse, and the filter has to be rendered on its own */
+static bool render_fused_filters(obs_source_t *filter)
+{
+	const enum gs_color_space preferred_spaces[] = {
+		GS_CS_SRGB,
+		GS_CS_SRGB_16F,
+		GS_CS_709_EXTENDED,
+	};
+
+	obs_source_t *run[MAX_FUSED_FILTERS];
+	const char *shaders[MAX_FUSED_FILTERS];
+	obs_source_t *input, *parent = filter->filter_parent;
+	const uint32_t filter_flags = filter->info.output_flags;
+	enum gs_color_space space;
+	gs_effect_t *effect;
+	bool previous, bypass;
+	size_t count;
+	int cx, cy;
+
+	if (!pixel_filter(filter))
+		return false;
+
+	count = get_fused_filters(filter, run, shaders, &input);
+	if (count < 2 || !input)
+		return false;
+
+	/* the filters have the input drawn in one of these, and leave
+	 * everything else to their own render callbacks */
+	space = obs_source_get_color_space(
+		input, OBS_COUNTOF(preferred_spaces), preferred_spaces);
+	if (space != GS_CS_SRGB && space != GS_CS_SRGB_16F)
+		return false;
+
+	effect = get_fused_effect(filter, shaders, count);
+	if (!effect)
+		return false;
+
+	bypass = can_bypass(input, parent, filter_flags,
+			    parent->info.output_flags,
+			    OBS_ALLOW_DIRECT_RENDERING, space);
+	if (!bypass) {
+		cx = get_base_width(input);
+		cy = get_base_height(input);
+		if (!cx || !cy)
+			return true;
+
+		render_filter_input(filter, input, parent,
+				    gs_get_format_from_space(space), space, cx,
+				    cy);
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		obs_source_t *f = run[count - 1 - i];
+		char prefix[16];
+
+		snprintf(prefix, sizeof(prefix), "p%zu_", i);
+		f->info.set_pixel_params(f->context.data, effect, prefix);
+	}
+
+	previous = gs_set_linear_srgb((filter_flags & OBS_SOURCE_SRGB) != 0);
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
+
+	if (bypass) {
+		render_filter_bypass(input, effect, "Draw");
+	} else {
+		gs_texture_t *tex =
+			gs_texrender_get_texture(filter->filter_texrender);
+		if (tex)
+			render_filter_tex(tex, effect, 0, 0, "Draw");
+	}
+
+	gs_blend_state_pop();
+	gs_set_linear_srgb(previous);
+	return true;
+}
+
+gs_eparam_t *obs_filter_get_pixel_param(gs_effect_t *effect,
+					const char *prefix, const char *name)
+{
+	struct dstr full_name = {0};
+	gs_eparam_t *param;
+
+	dstr_copy(&full_name, prefix);
+	dstr_cat(&full_name, name);
+	param = gs_effect_get_param_by_name(effect, full_name.array);
+	dstr_free(&full_name);
+
+	return param;
+}
+
 signal_handler_t *obs_source_get_signal_handler(const obs_source_t *source)
 {
 	return obs_source_valid(source, "obs_source_get_signal_handler")
@@ -4879,6 +5501,7 @@ bool obs_source_add_active_child(obs_source_t *parent, obs_source_t *child)
 		obs_source_activate(child, type);
 	}
 
+	obs_audio_tree_changed();
 	return true;
 }
 
@@ -4894,6 +5517,8 @@ void obs_source_remove_active_child(obs_source_t *parent, obs_source_t *child)
 		type = (i < parent->activate_refs) ? MAIN_VIEW : AUX_VIEW;
 		obs_source_deactivate(child, type);
 	}
+
+	obs_audio_tree_changed();
 }
 
 void obs_source_save(obs_source_t *source)
@@ -5704,9 +6329,10 @@ bool obs_source_audio_pending(const obs_source_t *source)
 	if (!obs_source_valid(source, "obs_source_audio_pending"))
 		return true;
 
-	return (is_composite_source(source) || is_audio_source(source))
-		       ? source->audio_pending
-		       : true;
+	if (!is_composite_source(source) && !is_audio_source(source))
+		return true;
+
+	return source->audio_pending || !obs_source_audio_rendered(source);
 }
 
 uint64_t obs_source_get_audio_timestamp(const obs_source_t *source)
@@ -5716,6 +6342,14 @@ uint64_t obs_source_get_audio_timestamp(const obs_source_t *source)
 		       : 0;
 }
 
+uint64_t obs_source_get_audio_render_time_ns(const obs_source_t *source)
+{
+	if (!obs_source_valid(source, "obs_source_get_audio_render_time_ns"))
+		return 0;
+
+	return (uint64_t)os_atomic_load_long(&source->audio_render_time_ns);
+}
+
 void obs_source_get_audio_mix(const obs_source_t *source,
 			      struct obs_source_audio_mix *audio)
 {
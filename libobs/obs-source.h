@@ -203,6 +203,39 @@ enum obs_media_state {
  */
 #define OBS_SOURCE_CAP_DONT_SHOW_PROPERTIES (1 << 16)
 
+/**
+ * Source's video_tick callback is thread safe, and may be called on a worker
+ * thread at the same time as the video_tick callbacks of other sources
+ */
+#define OBS_SOURCE_THREAD_SAFE_TICK (1 << 17)
+
+/**
+ * Source's video output only changes when its settings are updated, its size
+ * changes, or it calls obs_source_content_changed, which allows scenes to
+ * reuse its last rendered output
+ */
+#define OBS_SOURCE_STATIC_CONTENT (1 << 18)
+
+/**
+ * Source's create callback is thread safe, and may be called on a worker
+ * thread at the same time as the create callbacks of other sources when a
+ * scene collection is loaded.  It must not look up other sources.
+ */
+#define OBS_SOURCE_THREAD_SAFE_CREATE (1 << 19)
+
+/**
+ * Source's audio_render callback is thread safe, and may be called on a worker
+ * thread at the same time as the audio_render callbacks of other sources
+ */
+#define OBS_SOURCE_THREAD_SAFE_AUDIO_RENDER (1 << 20)
+
+/**
+ * Source's video_tick callback only needs to be called while the source is
+ * showing or active.  Sources with a video_tick callback are otherwise ticked
+ * every frame.
+ */
+#define OBS_SOURCE_TICK_WHEN_VISIBLE (1 << 21)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -552,6 +585,34 @@ struct obs_source_info {
 	enum gs_color_space (*video_get_color_space)(
 		void *data, size_t count,
 		const enum gs_color_space *preferred_spaces);
+
+	/**
+	 * Per-pixel filters can implement this to be fused with the per-pixel
+	 * filters next to them into a single pass.  Returns effect code that
+	 * declares the uniforms of the filter and a function
+	 *
+	 *   float4 PIXEL_filter(float4 rgba)
+	 *
+	 * which returns the filtered color of a pixel from the input color of
+	 * the same pixel, both with premultiplied alpha.  Every identifier
+	 * starting with PIXEL_ is renamed in the fused effect.  Returns NULL
+	 * if the filter can't be fused in its current state.
+	 *
+	 * @param  data  Filter data
+	 * @return       Effect code, valid until the next call
+	 */
+	const char *(*get_pixel_shader)(void *data);
+
+	/**
+	 * Sets the uniforms declared by get_pixel_shader on a fused effect,
+	 * which are found with obs_filter_get_pixel_param.
+	 *
+	 * @param  data    Filter data
+	 * @param  effect  Fused effect
+	 * @param  prefix  What PIXEL_ was renamed to
+	 */
+	void (*set_pixel_params)(void *data, gs_effect_t *effect,
+				 const char *prefix);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
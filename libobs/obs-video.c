@@ -29,6 +29,32 @@
 #include <windows.h>
 #endif
 
+static void push_filters_to_tick(struct obs_core_data *data,
+				 obs_source_t *source)
+{
+	if (!source->filters.num)
+		return;
+
+	pthread_mutex_lock(&source->filter_mutex);
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t *filter =
+			obs_source_get_ref(source->filters.array[i]);
+		if (filter)
+			da_push_back(data->sources_to_tick, &filter);
+	}
+
+	pthread_mutex_unlock(&source->filter_mutex);
+}
+
+static void parallel_tick(void *param, size_t idx)
+{
+	obs_source_t *source = obs->data.parallel_sources_to_tick.array[idx];
+	float seconds = *(float *)param;
+
+	obs_source_call_video_tick(source, seconds);
+}
+
 static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 {
 	struct obs_core_data *data = &obs->data;
@@ -56,28 +82,63 @@ static uint64_t tick_sources(uint64_t cur_time, uint64_t last_time)
 	pthread_mutex_unlock(&data->draw_callbacks_mutex);
 
 	/* ------------------------------------- */
-	/* get an array of all sources to tick   */
+	/* get an array of the sources to tick   */
 
 	da_clear(data->sources_to_tick);
 
-	pthread_mutex_lock(&data->sources_mutex);
+	pthread_mutex_lock(&data->tick_sources_mutex);
 
-	source = data->sources;
+	source = data->first_tick_source;
 	while (source) {
-		obs_source_t *s = obs_source_get_ref(source);
-		if (s)
-			da_push_back(data->sources_to_tick, &s);
-		source = (struct obs_source *)source->context.hh_uuid.next;
+		struct obs_source *next = source->next_tick_source;
+
+		/* filters that were added to a source after they were
+		 * listed are ticked along with their parent from now on */
+		if (source->filter_parent) {
+			obs_source_tick_list_remove(source);
+		} else {
+			obs_source_t *s = obs_source_get_ref(source);
+			if (s)
+				da_push_back(data->sources_to_tick, &s);
+		}
+
+		source = next;
 	}
 
-	pthread_mutex_unlock(&data->sources_mutex);
+	pthread_mutex_unlock(&data->tick_sources_mutex);
+
+	/* filters are ticked along with their parent */
+	for (size_t i = 0, num = data->sources_to_tick.num; i < num; i++)
+		push_filters_to_tick(data, data->sources_to_tick.array[i]);
 
 	/* ------------------------------------- */
 	/* call the tick function of each source */
 
+	da_clear(data->parallel_sources_to_tick);
+
+	for (size_t i = 0; i < data->sources_to_tick.num; i++) {
+		obs_source_t *s = data->sources_to_tick.array[i];
+
+		obs_source_video_tick_state(s, seconds);
+
+		if (s->info.output_flags & OBS_SOURCE_THREAD_SAFE_TICK)
+			da_push_back(data->parallel_sources_to_tick, &s);
+		else
+			obs_source_call_video_tick(s, seconds);
+	}
+
+	/* the pool only gets created once there's something to split up */
+	if (data->parallel_sources_to_tick.num > 1)
+		os_worker_pool_run(obs_get_worker_pool(), parallel_tick,
+				   &seconds,
+				   data->parallel_sources_to_tick.num);
+	else if (data->parallel_sources_to_tick.num)
+		parallel_tick(&seconds, 0);
+
 	for (size_t i = 0; i < data->sources_to_tick.num; i++) {
 		obs_source_t *s = data->sources_to_tick.array[i];
-		obs_source_video_tick(s, seconds);
+
+		obs_source_tick_list_prune(s);
 		obs_source_release(s);
 	}
 
@@ -1132,6 +1193,10 @@ static inline bool stop_requested(void)
 	return success;
 }
 
+/* pooled frame buffers that haven't been reused for this long are given
+ * back to the system */
+#define FRAME_POOL_MAX_IDLE_NS 5000000000ULL
+
 bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 {
 	uint64_t frame_start = os_gettime_ns();
@@ -1191,6 +1256,8 @@ bool obs_graphics_thread_loop(struct obs_graphics_context *context)
 		context->frame_time_total_ns = 0;
 		context->fps_total_ns = 0;
 		context->fps_total_frames = 0;
+
+		frame_pool_trim(FRAME_POOL_MAX_IDLE_NS);
 	}
 
 	return !stop_requested();
@@ -20,6 +20,8 @@
 #include "graphics/matrix4.h"
 #include "callback/calldata.h"
 
+#include "media-io/frame-pool.h"
+
 #include "obs.h"
 #include "obs-internal.h"
 
@@ -917,11 +919,20 @@ static void obs_free_graphics(void)
 
 static void set_audio_thread(void *unused);
 
+static size_t get_worker_thread_count(void);
+
+/* audio ticks are short, a few threads are enough to spread them out */
+#define MAX_AUDIO_WORKER_THREADS 3
+
 static bool obs_init_audio(struct audio_output_info *ai)
 {
 	struct obs_core_audio *audio = &obs->audio;
+	size_t render_threads = get_worker_thread_count();
 	int errorcode;
 
+	if (render_threads > MAX_AUDIO_WORKER_THREADS)
+		render_threads = MAX_AUDIO_WORKER_THREADS;
+
 	pthread_mutex_init_value(&audio->monitoring_mutex);
 
 	if (pthread_mutex_init_recursive(&audio->monitoring_mutex) != 0)
@@ -934,6 +945,9 @@ static bool obs_init_audio(struct audio_output_info *ai)
 
 	audio->monitoring_device_name = bstrdup("Default");
 	audio->monitoring_device_id = bstrdup("default");
+	audio->monitoring_latency_ms = 50;
+
+	audio->render_pool = os_worker_pool_create(render_threads);
 
 	errorcode = audio_output_open(&audio->audio, ai);
 	if (errorcode == AUDIO_OUTPUT_SUCCESS)
@@ -959,12 +973,25 @@ static void stop_audio(void)
 static void obs_free_audio(void)
 {
 	struct obs_core_audio *audio = &obs->audio;
+	uint64_t render_tick = audio->render_tick;
+	uint64_t tree_build = audio->tree_build;
 	if (audio->audio)
 		audio_output_close(audio->audio);
 
-	circlebuf_free(&audio->buffered_timestamps);
+	os_worker_pool_destroy(audio->render_pool);
+
+	for (size_t i = 0; i < audio->tree_sources.num; i++)
+		obs_weak_source_release(audio->tree_sources.array[i]);
+
+	audio_buffering_free(&audio->buffering);
 	da_free(audio->render_order);
 	da_free(audio->root_nodes);
+	da_free(audio->tree_sources);
+	da_free(audio->tree_roots);
+	da_free(audio->level_offsets);
+	da_free(audio->tree_nodes);
+	da_free(audio->tree_edges);
+	da_free(audio->tree_levels);
 
 	da_free(audio->monitors);
 	bfree(audio->monitoring_device_name);
@@ -974,6 +1001,11 @@ static void obs_free_audio(void)
 	pthread_mutex_destroy(&audio->monitoring_mutex);
 
 	memset(audio, 0, sizeof(struct obs_core_audio));
+
+	/* sources remember the tick they were last rendered in, and the tree
+	 * build they were last part of */
+	audio->render_tick = render_tick;
+	audio->tree_build = tree_build;
 }
 
 static bool obs_init_data(void)
@@ -989,6 +1021,8 @@ static bool obs_init_data(void)
 		goto fail;
 	if (pthread_mutex_init_recursive(&data->audio_sources_mutex) != 0)
 		goto fail;
+	if (pthread_mutex_init(&data->tick_sources_mutex, NULL) != 0)
+		goto fail;
 	if (pthread_mutex_init_recursive(&data->displays_mutex) != 0)
 		goto fail;
 	if (pthread_mutex_init_recursive(&data->outputs_mutex) != 0)
@@ -1073,6 +1107,7 @@ static void obs_free_data(void)
 
 	pthread_mutex_destroy(&data->sources_mutex);
 	pthread_mutex_destroy(&data->audio_sources_mutex);
+	pthread_mutex_destroy(&data->tick_sources_mutex);
 	pthread_mutex_destroy(&data->displays_mutex);
 	pthread_mutex_destroy(&data->outputs_mutex);
 	pthread_mutex_destroy(&data->encoders_mutex);
@@ -1087,6 +1122,7 @@ static void obs_free_data(void)
 		bfree(data->protocols.array[i]);
 	da_free(data->protocols);
 	da_free(data->sources_to_tick);
+	da_free(data->parallel_sources_to_tick);
 }
 
 static const char *obs_signals[] = {
@@ -1112,6 +1148,9 @@ static const char *obs_signals[] = {
 
 	"void channel_change(int channel, in out ptr source, ptr prev_source)",
 
+	"void audio_buffering_changed(int buffering_ms, int prev_buffering_ms, "
+	"string reason, string source)",
+
 	"void hotkey_layout_change()",
 	"void hotkey_register(ptr hotkey)",
 	"void hotkey_unregister(ptr hotkey)",
@@ -1224,6 +1263,41 @@ const struct obs_source_info audio_line_info = {
 
 extern void log_system_info(void);
 
+#define MAX_WORKER_THREADS 8
+
+/* the calling thread takes part in the work as well */
+static size_t get_worker_thread_count(void)
+{
+	int cores = os_get_logical_cores() - 1;
+
+	if (cores < 0)
+		return 0;
+	return cores > MAX_WORKER_THREADS ? MAX_WORKER_THREADS : (size_t)cores;
+}
+
+static os_worker_pool_t *get_lazy_pool(os_worker_pool_t **ptr)
+{
+	os_worker_pool_t *pool;
+
+	pthread_mutex_lock(&obs->worker_pool_mutex);
+	if (!*ptr)
+		*ptr = os_worker_pool_create(get_worker_thread_count());
+	pool = *ptr;
+	pthread_mutex_unlock(&obs->worker_pool_mutex);
+
+	return pool;
+}
+
+os_worker_pool_t *obs_get_worker_pool(void)
+{
+	return get_lazy_pool(&obs->worker_pool);
+}
+
+os_worker_pool_t *obs_get_deinterlace_pool(void)
+{
+	return get_lazy_pool(&obs->deinterlace_pool);
+}
+
 static bool obs_init(const char *locale, const char *module_config_path,
 		     profiler_name_store_t *store)
 {
@@ -1233,6 +1307,7 @@ static bool obs_init(const char *locale, const char *module_config_path,
 	pthread_mutex_init_value(&obs->audio.task_mutex);
 	pthread_mutex_init_value(&obs->video.task_mutex);
 	pthread_mutex_init_value(&obs->video.mixes_mutex);
+	pthread_mutex_init_value(&obs->worker_pool_mutex);
 
 	obs->name_store_owned = !store;
 	obs->name_store = store ? store : profiler_name_store_create();
@@ -1254,6 +1329,12 @@ static bool obs_init(const char *locale, const char *module_config_path,
 	if (!obs->destruction_task_thread)
 		return false;
 
+	if (pthread_mutex_init(&obs->worker_pool_mutex, NULL) != 0)
+		return false;
+
+	obs->parallel_audio_render = true;
+	obs->render_cache_enabled = true;
+
 	if (module_config_path)
 		obs->module_config_path = bstrdup(module_config_path);
 	obs->locale = bstrdup(locale);
@@ -1377,6 +1458,21 @@ struct obs_cmdline_args obs_get_cmdline_args(void)
 	return cmdline_args;
 }
 
+static void log_frame_pool_stats(void)
+{
+	struct frame_pool_stats stats;
+	frame_pool_get_stats(&stats);
+
+	if (!stats.allocs)
+		return;
+
+	blog(LOG_INFO,
+	     "Frame pool: %" PRIu64 " allocations, %.1f%% reused, "
+	     "peak %.1f MB resident",
+	     stats.allocs, (double)stats.hits * 100.0 / (double)stats.allocs,
+	     (double)stats.peak_resident_bytes / (1024.0 * 1024.0));
+}
+
 void obs_shutdown(void)
 {
 	struct obs_module *module;
@@ -1430,6 +1526,11 @@ void obs_shutdown(void)
 	obs_free_audio();
 	obs_free_video();
 	os_task_queue_destroy(obs->destruction_task_thread);
+	os_worker_pool_destroy(obs->worker_pool);
+	os_worker_pool_destroy(obs->deinterlace_pool);
+	pthread_mutex_destroy(&obs->worker_pool_mutex);
+	log_frame_pool_stats();
+	frame_pool_trim(0);
 	obs_free_hotkeys();
 	obs_free_graphics();
 	proc_handler_destroy(obs->procs);
@@ -1595,13 +1696,13 @@ bool obs_reset_audio2(const struct obs_audio_info2 *oai)
 		uint32_t max_frames = oai->max_buffering_ms *
 				      oai->samples_per_sec / SEC_TO_MSEC;
 		max_frames += (AUDIO_OUTPUT_FRAMES - 1);
-		audio->max_buffering_ticks = max_frames / AUDIO_OUTPUT_FRAMES;
+		audio->buffering.max_ticks = max_frames / AUDIO_OUTPUT_FRAMES;
 	} else {
-		audio->max_buffering_ticks = 45;
+		audio->buffering.max_ticks = 45;
 	}
 	audio->fixed_buffer = oai->fixed_buffering;
 
-	int max_buffering_ms = audio->max_buffering_ticks *
+	int max_buffering_ms = audio->buffering.max_ticks *
 			       AUDIO_OUTPUT_FRAMES * SEC_TO_MSEC /
 			       (int)oai->samples_per_sec;
 
@@ -2294,10 +2395,9 @@ float obs_get_master_volume(void)
 	return 1.f;
 }
 
-static obs_source_t *obs_load_source_type(obs_data_t *source_data,
-					  bool is_private)
+static obs_source_t *obs_load_source_begin(obs_data_t *source_data,
+					   bool is_private)
 {
-	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
 	obs_source_t *source;
 	const char *name = obs_data_get_string(source_data, "name");
 	const char *uuid = obs_data_get_string(source_data, "uuid");
@@ -2305,31 +2405,44 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data,
 	const char *v_id = obs_data_get_string(source_data, "versioned_id");
 	obs_data_t *settings = obs_data_get_obj(source_data, "settings");
 	obs_data_t *hotkeys = obs_data_get_obj(source_data, "hotkeys");
-	double volume;
-	double balance;
-	int64_t sync;
 	uint32_t prev_ver;
-	uint32_t caps;
-	uint32_t flags;
-	uint32_t mixers;
-	int di_order;
-	int di_mode;
-	int monitoring_type;
 
 	prev_ver = (uint32_t)obs_data_get_int(source_data, "prev_ver");
 
 	if (!*v_id)
 		v_id = id;
 
-	source = obs_source_create_set_last_ver(v_id, name, uuid, settings,
-						hotkeys, prev_ver, is_private);
+	source = obs_source_create_deferred(v_id, name, uuid, settings, hotkeys,
+					    prev_ver, is_private);
 
-	if (source->owns_info_id) {
+	if (source && source->owns_info_id) {
 		bfree((void *)source->info.unversioned_id);
 		source->info.unversioned_id = bstrdup(id);
 	}
 
 	obs_data_release(hotkeys);
+	obs_data_release(settings);
+
+	return source;
+}
+
+/* restores the saved state of a source once it has been created */
+static void obs_load_source_end(obs_source_t *source, obs_data_t *source_data)
+{
+	double volume;
+	double balance;
+	int64_t sync;
+	uint32_t prev_ver;
+	uint32_t caps;
+	uint32_t flags;
+	uint32_t mixers;
+	int di_order;
+	int di_mode;
+	int monitoring_type;
+
+	obs_source_create_finish(source);
+
+	prev_ver = (uint32_t)obs_data_get_int(source_data, "prev_ver");
 
 	caps = obs_source_get_output_flags(source);
 
@@ -2384,6 +2497,9 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data,
 	obs_source_set_deinterlace_field_order(
 		source, (enum obs_deinterlace_field_order)di_order);
 
+	obs_source_set_deinterlace_cpu(
+		source, obs_data_get_bool(source_data, "deinterlace_cpu"));
+
 	monitoring_type = (int)obs_data_get_int(source_data, "monitoring_type");
 	if (prev_ver < MAKE_SEMANTIC_VERSION(23, 2, 2)) {
 		if ((caps & OBS_SOURCE_MONITOR_BY_DEFAULT) != 0) {
@@ -2402,6 +2518,21 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data,
 		obs_data_get_obj(source_data, "private_settings");
 	if (!source->private_settings)
 		source->private_settings = obs_data_create();
+}
+
+static obs_source_t *obs_load_source_type(obs_data_t *source_data,
+					  bool is_private)
+{
+	obs_data_array_t *filters = obs_data_get_array(source_data, "filters");
+	obs_source_t *source = obs_load_source_begin(source_data, is_private);
+
+	if (!source) {
+		obs_data_array_release(filters);
+		return NULL;
+	}
+
+	obs_source_create_data(source);
+	obs_load_source_end(source, source_data);
 
 	if (filters) {
 		size_t count = obs_data_array_count(filters);
@@ -2423,8 +2554,6 @@ static obs_source_t *obs_load_source_type(obs_data_t *source_data,
 		obs_data_array_release(filters);
 	}
 
-	obs_data_release(settings);
-
 	return source;
 }
 
@@ -2438,50 +2567,225 @@ obs_source_t *obs_load_private_source(obs_data_t *source_data)
 	return obs_load_source_type(source_data, true);
 }
 
-void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
-		      void *private_data)
+/* ------------------------------------------------------------------------- */
+/* Scene collection loading
+ *
+ *   Sources only start to depend on each other once they're loaded, when
+ * scenes look up the sources of their items, so loading a set of sources
+ * happens in steps: every source and filter is set up first, then the create
+ * callbacks of all types that declare OBS_SOURCE_THREAD_SAFE_CREATE run in
+ * parallel, followed by the remaining ones.  The saved state of the sources
+ * is restored and filters are attached after that, and scenes are wired
+ * together last. */
+
+#define NO_PARENT ((size_t)-1)
+
+struct source_load_entry {
+	obs_source_t *source;
+	obs_data_t *source_data;
+
+	/* index of the source a filter belongs to */
+	size_t parent;
+};
+
+struct source_loader {
+	DARRAY(struct source_load_entry) entries;
+	DARRAY(obs_source_t *) parallel;
+	uint64_t start_time;
+};
+
+static void source_loader_add(struct source_loader *loader,
+			      obs_data_t *source_data, bool is_private,
+			      size_t parent)
 {
-	struct obs_core_data *data = &obs->data;
-	DARRAY(obs_source_t *) sources;
+	struct source_load_entry entry;
+	obs_data_array_t *filters;
+	size_t idx = loader->entries.num;
 	size_t count;
-	size_t i;
 
-	da_init(sources);
+	entry.source = obs_load_source_begin(source_data, is_private);
+	if (!entry.source)
+		return;
 
-	count = obs_data_array_count(array);
-	da_reserve(sources, count);
+	entry.source_data = obs_data_newref(source_data);
+	entry.parent = parent;
+	da_push_back(loader->entries, &entry);
 
-	pthread_mutex_lock(&data->sources_mutex);
+	if (parent != NO_PARENT)
+		return;
 
-	for (i = 0; i < count; i++) {
-		obs_data_t *source_data = obs_data_array_item(array, i);
-		obs_source_t *source = obs_load_source(source_data);
+	filters = obs_data_get_array(source_data, "filters");
+	count = obs_data_array_count(filters);
 
-		da_push_back(sources, &source);
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *filter_data = obs_data_array_item(filters, i);
+		source_loader_add(loader, filter_data, true, idx);
+		obs_data_release(filter_data);
+	}
 
-		obs_data_release(source_data);
+	obs_data_array_release(filters);
+}
+
+static void create_source_data(void *param, size_t idx)
+{
+	struct source_loader *loader = param;
+	obs_source_create_data(loader->parallel.array[idx]);
+}
+
+static void source_loader_create(struct source_loader *loader)
+{
+	os_worker_pool_t *pool = NULL;
+
+	for (size_t i = 0; i < loader->entries.num; i++) {
+		obs_source_t *source = loader->entries.array[i].source;
+
+		if (source->info.output_flags & OBS_SOURCE_THREAD_SAFE_CREATE)
+			da_push_back(loader->parallel, &source);
+	}
+
+	/* a pool of its own, so that the parallel ticks of the graphics
+	 * thread don't have to wait for the sources to be created, and the
+	 * sources are never created inline because the shared pool is busy */
+	if (loader->parallel.num > 1)
+		pool = os_worker_pool_create(get_worker_thread_count());
+
+	os_worker_pool_run(pool, create_source_data, loader,
+			   loader->parallel.num);
+	os_worker_pool_destroy(pool);
+
+	for (size_t i = 0; i < loader->entries.num; i++) {
+		obs_source_t *source = loader->entries.array[i].source;
+
+		if (!(source->info.output_flags &
+		      OBS_SOURCE_THREAD_SAFE_CREATE))
+			obs_source_create_data(source);
+	}
+}
+
+static void obs_finish_loading_source(obs_source_t *source,
+				      obs_data_t *source_data,
+				      obs_load_source_cb cb, void *private_data)
+{
+	if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
+		obs_transition_load(source, source_data);
+	obs_source_load2(source);
+	if (cb)
+		cb(private_data, source);
+}
+
+static void source_loader_finish(struct source_loader *loader,
+				 obs_load_source_cb cb, void *private_data)
+{
+	struct source_load_entry *entries = loader->entries.array;
+	size_t num = loader->entries.num;
+	size_t num_sources = 0;
+
+	source_loader_create(loader);
+
+	for (size_t i = 0; i < num; i++) {
+		obs_load_source_end(entries[i].source, entries[i].source_data);
+
+		if (entries[i].parent != NO_PARENT)
+			obs_source_filter_add(entries[entries[i].parent].source,
+					      entries[i].source);
+		else
+			num_sources++;
 	}
 
 	/* tell sources that we want to load */
-	for (i = 0; i < sources.num; i++) {
-		obs_source_t *source = sources.array[i];
+	for (size_t i = 0; i < num; i++) {
+		if (entries[i].parent == NO_PARENT)
+			obs_finish_loading_source(entries[i].source,
+						  entries[i].source_data, cb,
+						  private_data);
+	}
+
+	for (size_t i = 0; i < num; i++) {
+		obs_source_release(entries[i].source);
+		obs_data_release(entries[i].source_data);
+	}
+
+	if (num)
+		blog(LOG_INFO,
+		     "Loaded %zu sources and %zu filters in %.2f ms "
+		     "(%zu created in parallel)",
+		     num_sources, num - num_sources,
+		     (double)(os_gettime_ns() - loader->start_time) /
+			     1000000.0,
+		     loader->parallel.num);
+
+	da_free(loader->entries);
+	da_free(loader->parallel);
+}
+
+/* releases the sources set up so far without ever creating or announcing
+ * them, for files that turn out to be broken halfway through */
+static void source_loader_discard(struct source_loader *loader)
+{
+	for (size_t i = 0; i < loader->entries.num; i++) {
+		obs_source_destroy_deferred(loader->entries.array[i].source);
+		obs_data_release(loader->entries.array[i].source_data);
+	}
+
+	da_free(loader->entries);
+	da_free(loader->parallel);
+}
+
+void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
+		      void *private_data)
+{
+	struct obs_core_data *data = &obs->data;
+	struct source_loader loader = {0};
+	size_t count = obs_data_array_count(array);
+
+	loader.start_time = os_gettime_ns();
+
+	pthread_mutex_lock(&data->sources_mutex);
+
+	for (size_t i = 0; i < count; i++) {
 		obs_data_t *source_data = obs_data_array_item(array, i);
-		if (source) {
-			if (source->info.type == OBS_SOURCE_TYPE_TRANSITION)
-				obs_transition_load(source, source_data);
-			obs_source_load2(source);
-			if (cb)
-				cb(private_data, source);
-		}
+		source_loader_add(&loader, source_data, false, NO_PARENT);
 		obs_data_release(source_data);
 	}
 
-	for (i = 0; i < sources.num; i++)
-		obs_source_release(sources.array[i]);
+	source_loader_finish(&loader, cb, private_data);
 
 	pthread_mutex_unlock(&data->sources_mutex);
+}
+
+static void load_source_object(void *param, const char *array_name,
+			       obs_data_t *source_data)
+{
+	struct source_loader *loader = param;
 
-	da_free(sources);
+	if (strcmp(array_name, "sources") == 0 ||
+	    strcmp(array_name, "groups") == 0)
+		source_loader_add(loader, source_data, false, NO_PARENT);
+}
+
+obs_data_t *obs_load_sources_from_file(const char *file, obs_load_source_cb cb,
+				       void *private_data)
+{
+	struct obs_core_data *data = &obs->data;
+	struct source_loader loader = {0};
+	obs_data_t *collection;
+
+	loader.start_time = os_gettime_ns();
+
+	pthread_mutex_lock(&data->sources_mutex);
+
+	/* sources are set up while the rest of the file is still being
+	 * parsed */
+	collection = obs_data_create_from_json_file_cb(file, load_source_object,
+						       &loader);
+	if (collection)
+		source_loader_finish(&loader, cb, private_data);
+	else
+		source_loader_discard(&loader);
+
+	pthread_mutex_unlock(&data->sources_mutex);
+
+	return collection;
 }
 
 obs_data_t *obs_save_source(obs_source_t *source)
@@ -2509,6 +2813,7 @@ obs_data_t *obs_save_source(obs_source_t *source)
 	int m_type = (int)obs_source_get_monitoring_type(source);
 	int di_mode = (int)obs_source_get_deinterlace_mode(source);
 	int di_order = (int)obs_source_get_deinterlace_field_order(source);
+	bool di_cpu = obs_source_get_deinterlace_cpu(source);
 
 	obs_source_save(source);
 	hotkeys = obs_hotkeys_save_source(source);
@@ -2540,6 +2845,7 @@ obs_data_t *obs_save_source(obs_source_t *source)
 	obs_data_set_obj(source_data, "hotkeys", hotkey_data);
 	obs_data_set_int(source_data, "deinterlace_mode", di_mode);
 	obs_data_set_int(source_data, "deinterlace_field_order", di_order);
+	obs_data_set_bool(source_data, "deinterlace_cpu", di_cpu);
 	obs_data_set_int(source_data, "monitoring_type", m_type);
 
 	obs_data_set_obj(source_data, "private_settings",
@@ -2945,6 +3251,62 @@ uint64_t obs_get_average_frame_time_ns(void)
 	return obs->video.video_avg_frame_time_ns;
 }
 
+uint64_t obs_get_average_audio_render_time_ns(void)
+{
+	return obs->audio.avg_render_time_ns;
+}
+
+static inline uint32_t audio_ticks_to_ms(int ticks, uint32_t sample_rate)
+{
+	return (uint32_t)util_mul_div64((uint64_t)ticks * AUDIO_OUTPUT_FRAMES,
+					SEC_TO_MSEC, sample_rate);
+}
+
+void obs_get_audio_buffering_stats(struct obs_audio_buffering_stats *stats)
+{
+	struct obs_core_audio *audio = &obs->audio;
+	uint32_t sample_rate;
+
+	memset(stats, 0, sizeof(*stats));
+	if (!audio->audio)
+		return;
+
+	sample_rate = audio_output_get_sample_rate(audio->audio);
+
+	*stats = audio->buffering_stats;
+	stats->buffering_ms =
+		audio_ticks_to_ms(audio->buffering.total_ticks, sample_rate);
+	stats->max_buffering_ms =
+		audio_ticks_to_ms(audio->buffering.max_ticks, sample_rate);
+}
+
+void obs_set_parallel_audio_render(bool enable)
+{
+	if (!obs)
+		return;
+
+	os_atomic_set_bool(&obs->parallel_audio_render, enable);
+}
+
+bool obs_get_parallel_audio_render(void)
+{
+	return obs ? os_atomic_load_bool(&obs->parallel_audio_render) : false;
+}
+
+void obs_set_adaptive_audio_buffering(bool enable)
+{
+	if (!obs)
+		return;
+
+	os_atomic_set_bool(&obs->adaptive_audio_buffering, enable);
+}
+
+bool obs_get_adaptive_audio_buffering(void)
+{
+	return obs ? os_atomic_load_bool(&obs->adaptive_audio_buffering)
+		   : false;
+}
+
 uint64_t obs_get_frame_interval_ns(void)
 {
 	return obs->video.video_frame_interval_ns;
@@ -3042,6 +3404,31 @@ void obs_get_audio_monitoring_device(const char **name, const char **id)
 		*id = obs->audio.monitoring_device_id;
 }
 
+void obs_set_audio_monitoring_latency(uint32_t ms)
+{
+	if (!ms)
+		return;
+
+	pthread_mutex_lock(&obs->audio.monitoring_mutex);
+
+	if (ms != obs->audio.monitoring_latency_ms) {
+		obs->audio.monitoring_latency_ms = ms;
+
+		for (size_t i = 0; i < obs->audio.monitors.num; i++) {
+			struct audio_monitor *monitor =
+				obs->audio.monitors.array[i];
+			audio_monitor_reset(monitor);
+		}
+	}
+
+	pthread_mutex_unlock(&obs->audio.monitoring_mutex);
+}
+
+uint32_t obs_get_audio_monitoring_latency(void)
+{
+	return obs->audio.monitoring_latency_ms;
+}
+
 void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 			   void *param)
 {
@@ -3113,6 +3500,29 @@ uint32_t obs_get_lagged_frames(void)
 	return obs->video.lagged_frames;
 }
 
+void obs_set_render_cache_enabled(bool enable)
+{
+	if (!obs)
+		return;
+
+	os_atomic_set_bool(&obs->render_cache_enabled, enable);
+}
+
+bool obs_get_render_cache_enabled(void)
+{
+	return obs ? os_atomic_load_bool(&obs->render_cache_enabled) : false;
+}
+
+uint32_t obs_get_render_cache_hits(void)
+{
+	return (uint32_t)os_atomic_load_long(&obs->video.render_cache_hits);
+}
+
+uint32_t obs_get_render_cache_misses(void)
+{
+	return (uint32_t)os_atomic_load_long(&obs->video.render_cache_misses);
+}
+
 struct obs_core_video_mix *get_mix_for_video(video_t *v)
 {
 	struct obs_core_video_mix *result = NULL;
@@ -794,6 +794,16 @@ typedef void (*obs_load_source_cb)(void *private_data, obs_source_t *source);
 EXPORT void obs_load_sources(obs_data_array_t *array, obs_load_source_cb cb,
 			     void *private_data);
 
+/**
+ * Loads the "sources" and "groups" arrays of a scene collection file, creating
+ * each source as soon as its data has been read instead of after the whole
+ * file has been parsed.  Returns the data of the collection, or NULL if the
+ * file could not be read, in which case no sources are loaded.
+ */
+EXPORT obs_data_t *obs_load_sources_from_file(const char *file,
+					      obs_load_source_cb cb,
+					      void *private_data);
+
 /** Saves sources to a data array */
 EXPORT obs_data_array_t *obs_save_sources(void);
 
@@ -830,6 +840,13 @@ EXPORT void obs_enum_audio_monitoring_devices(obs_enum_audio_device_cb cb,
 EXPORT bool obs_set_audio_monitoring_device(const char *name, const char *id);
 EXPORT void obs_get_audio_monitoring_device(const char **name, const char **id);
 
+/**
+ * Sets the latency that audio monitoring aims for, in milliseconds.  Only
+ * used by PulseAudio monitoring for now.
+ */
+EXPORT void obs_set_audio_monitoring_latency(uint32_t ms);
+EXPORT uint32_t obs_get_audio_monitoring_latency(void);
+
 EXPORT void obs_add_tick_callback(void (*tick)(void *param, float seconds),
 				  void *param);
 EXPORT void obs_remove_tick_callback(void (*tick)(void *param, float seconds),
@@ -866,9 +883,69 @@ EXPORT double obs_get_active_fps(void);
 EXPORT uint64_t obs_get_average_frame_time_ns(void);
 EXPORT uint64_t obs_get_frame_interval_ns(void);
 
+/** Average time the audio thread spends rendering sources per audio tick */
+EXPORT uint64_t obs_get_average_audio_render_time_ns(void);
+
+struct obs_audio_buffering_stats {
+	/** current audio buffering, added to the latency of every output */
+	uint32_t buffering_ms;
+	uint32_t max_buffering_ms;
+
+	/** times the buffering was raised for a lagging source */
+	uint32_t increases;
+	/** times adaptive buffering gave some of it back, and how much */
+	uint32_t reclaims;
+	uint32_t reclaimed_ms;
+	/** with adaptive buffering, the least audio any source had ready
+	 * ahead of the buffering during the last window */
+	uint32_t headroom_ms;
+	/** times a source lagged at max buffering and had its audio reset */
+	uint32_t source_restarts;
+
+	/** frames dropped from sources lagging at max buffering */
+	uint64_t ignored_frames;
+	/** frames thrown away from sources whose audio stopped */
+	uint64_t discarded_frames;
+};
+
+/** Audio buffering state, with counters since audio was last reset */
+EXPORT void
+obs_get_audio_buffering_stats(struct obs_audio_buffering_stats *stats);
+
+/**
+ * Enables or disables rendering independent audio sources in parallel.
+ * Enabled by default.  Only sources without an audio_render callback, or
+ * with OBS_SOURCE_THREAD_SAFE_AUDIO_RENDER, are rendered on other threads.
+ */
+EXPORT void obs_set_parallel_audio_render(bool enable);
+EXPORT bool obs_get_parallel_audio_render(void);
+
+/**
+ * Enables or disables adaptive audio buffering.  Buffering normally only
+ * grows until audio is reset; with this on, it's given back once every
+ * source has delivered ahead of it for a while.  Off by default, and ignored
+ * with fixed buffering.
+ */
+EXPORT void obs_set_adaptive_audio_buffering(bool enable);
+EXPORT bool obs_get_adaptive_audio_buffering(void);
+
 EXPORT uint32_t obs_get_total_frames(void);
 EXPORT uint32_t obs_get_lagged_frames(void);
 
+/**
+ * Sets/gets whether scenes and filters may reuse their previous render while
+ * their content is unchanged.  Enabled by default.
+ */
+EXPORT void obs_set_render_cache_enabled(bool enable);
+EXPORT bool obs_get_render_cache_enabled(void);
+
+/**
+ * Number of times scenes reused previously rendered items instead of rendering
+ * them again, and number of times they had to render them
+ */
+EXPORT uint32_t obs_get_render_cache_hits(void);
+EXPORT uint32_t obs_get_render_cache_misses(void);
+
 EXPORT bool obs_nv12_tex_active(void);
 EXPORT bool obs_p010_tex_active(void);
 
@@ -1349,6 +1426,14 @@ EXPORT void obs_source_set_deinterlace_field_order(
 EXPORT enum obs_deinterlace_field_order
 obs_source_get_deinterlace_field_order(const obs_source_t *source);
 
+/**
+ * Deinterlaces frames on the CPU as they are output instead of on the GPU when
+ * they are rendered.  Only used with the yadif modes and 8-bit formats, other
+ * frames are still deinterlaced on the GPU.
+ */
+EXPORT void obs_source_set_deinterlace_cpu(obs_source_t *source, bool cpu);
+EXPORT bool obs_source_get_deinterlace_cpu(const obs_source_t *source);
+
 enum obs_monitoring_type {
 	OBS_MONITORING_TYPE_NONE,
 	OBS_MONITORING_TYPE_MONITOR_ONLY,
@@ -1455,6 +1540,12 @@ EXPORT void obs_source_output_audio(obs_source_t *source,
 /** Signal an update to any currently used properties via 'update_properties' */
 EXPORT void obs_source_update_properties(obs_source_t *source);
 
+/**
+ * Notifies libobs that the video output of a source with the
+ * OBS_SOURCE_STATIC_CONTENT flag has changed and has to be rendered again
+ */
+EXPORT void obs_source_content_changed(obs_source_t *source);
+
 /** Gets the current async video frame */
 EXPORT struct obs_source_frame *obs_source_get_frame(obs_source_t *source);
 
@@ -1508,6 +1599,14 @@ EXPORT void obs_source_process_filter_tech_end(obs_source_t *filter,
 /** Skips the filter if the filter is invalid and cannot be rendered */
 EXPORT void obs_source_skip_video_filter(obs_source_t *filter);
 
+/**
+ * Gets a uniform declared by the get_pixel_shader callback of a filter from
+ * the fused effect passed to its set_pixel_params callback
+ */
+EXPORT gs_eparam_t *obs_filter_get_pixel_param(gs_effect_t *effect,
+					       const char *prefix,
+					       const char *name);
+
 /**
  * Adds an active child source.  Must be called by parent sources on child
  * sources when the child is added and active.  This ensures that the source is
@@ -1564,6 +1663,12 @@ EXPORT uint64_t obs_source_get_audio_timestamp(const obs_source_t *source);
 EXPORT void obs_source_get_audio_mix(const obs_source_t *source,
 				     struct obs_source_audio_mix *audio);
 
+/**
+ * Time spent rendering the audio of the source per audio tick, averaged
+ * over recent ticks.  Does not include the time spent on its children.
+ */
+EXPORT uint64_t obs_source_get_audio_render_time_ns(const obs_source_t *source);
+
 EXPORT void obs_source_set_async_unbuffered(obs_source_t *source,
 					    bool unbuffered);
 EXPORT bool obs_source_async_unbuffered(const obs_source_t *source);
@@ -2065,6 +2170,39 @@ EXPORT uint32_t obs_output_get_active_delay(const obs_output_t *output);
 /** Forces the output to stop.  Usually only used with delay. */
 EXPORT void obs_output_force_stop(obs_output_t *output);
 
+/**
+ * Attaches a destination output to an output.  The output interleaves its
+ * encoder packets once and shares them with all of its destinations, which
+ * each send from their own queue position on their own thread.  The
+ * destination is assigned the output's encoders, and is started and stopped
+ * like any other output.
+ */
+EXPORT bool obs_output_add_destination(obs_output_t *output,
+				       obs_output_t *destination);
+
+/**
+ * Detaches a destination output from an output.  An active destination stops
+ * receiving packets right away, and stays active until it is stopped.
+ */
+EXPORT void obs_output_remove_destination(obs_output_t *output,
+					  obs_output_t *destination);
+
+/** Gets the output a destination is attached to, if any. */
+EXPORT obs_output_t *
+obs_output_get_fanout_parent(const obs_output_t *destination);
+
+/**
+ * Sets how far a destination may fall behind the output it is attached to,
+ * in milliseconds, before it skips ahead to the newest keyframe.  Set to 0 to
+ * never skip.
+ */
+EXPORT void obs_output_set_destination_max_backlog(obs_output_t *destination,
+						   uint32_t max_backlog_ms);
+
+/** Gets the destination's maximum backlog, in milliseconds. */
+EXPORT uint32_t
+obs_output_get_destination_max_backlog(const obs_output_t *destination);
+
 /** Returns whether the output is active */
 EXPORT bool obs_output_active(const obs_output_t *output);
 
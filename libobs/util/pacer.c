@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <string.h>
+
+#include "pacer.h"
+#include "platform.h"
+#include "util_uint64.h"
+
+void pacer_init(struct pacer *pacer, uint64_t rate, uint64_t burst)
+{
+	memset(pacer, 0, sizeof(*pacer));
+	pacer_set_rate(pacer, rate, burst);
+}
+
+void pacer_set_rate(struct pacer *pacer, uint64_t rate, uint64_t burst)
+{
+	pacer->rate = rate;
+	pacer->burst = burst;
+	pacer->burst_ns = rate ? util_mul_div64(burst, 1000000000ULL, rate) : 0;
+}
+
+uint64_t pacer_reserve(struct pacer *pacer, size_t size,
+		       enum pacer_priority priority, uint64_t now)
+{
+	struct pacer_stats *stats = &pacer->stats;
+	uint64_t send_ts = now;
+
+	stats->sends++;
+	stats->bytes += size;
+
+	if (!pacer->rate)
+		return now;
+
+	uint64_t cost = util_mul_div64(size, 1000000000ULL, pacer->rate);
+
+	if (pacer->drain_ts < now)
+		pacer->drain_ts = now;
+
+	/* wait until the data fits into the bucket.  data larger than the
+	 * bucket waits for the bucket to be empty instead. */
+	if (priority != PACER_PRIORITY_URGENT) {
+		uint64_t fit_ts = cost > pacer->burst_ns
+					  ? pacer->drain_ts
+					  : pacer->drain_ts + cost -
+						    pacer->burst_ns;
+		if (fit_ts > send_ts)
+			send_ts = fit_ts;
+	}
+
+	pacer->drain_ts += cost;
+
+	if (send_ts > now) {
+		uint64_t delay = send_ts - now;
+
+		stats->delayed_sends++;
+		stats->total_delay_ns += delay;
+		if (delay > stats->max_delay_ns)
+			stats->max_delay_ns = delay;
+	}
+
+	return send_ts;
+}
+
+void pacer_wait(struct pacer *pacer, size_t size, enum pacer_priority priority)
+{
+	uint64_t now = os_gettime_ns();
+	uint64_t send_ts = pacer_reserve(pacer, size, priority, now);
+
+	if (send_ts > now)
+		os_sleepto_ns(send_ts);
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2023 Lain Bailey <lain@obsproject.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+#include "c99defs.h"
+
+/*
+ * Token bucket send pacer
+ *
+ *   Limits the rate at which an output hands data to its socket, so large
+ * packets such as keyframes leave in bursts of at most `burst` bytes instead
+ * of all at once.  Over any interval of time t, no more than
+ * burst + rate * t bytes (plus the size of one send) are let through.
+ *
+ *   Sends with urgent priority (e.g. audio or headers) are never delayed, but
+ * are still charged to the bucket so that the data sent after them is paced
+ * accordingly.
+ *
+ *   Not thread safe; a pacer is meant to be used by a single send thread.
+ */
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum pacer_priority {
+	PACER_PRIORITY_NORMAL,
+	PACER_PRIORITY_URGENT,
+};
+
+struct pacer_stats {
+	uint64_t sends;
+	uint64_t delayed_sends;
+	uint64_t bytes;
+	uint64_t total_delay_ns;
+	uint64_t max_delay_ns;
+};
+
+struct pacer {
+	uint64_t rate;     /* bytes per second, 0 disables pacing */
+	uint64_t burst;    /* bucket size in bytes */
+	uint64_t burst_ns; /* time it takes to send a full bucket */
+
+	/* time at which all data sent so far has drained at `rate` */
+	uint64_t drain_ts;
+
+	struct pacer_stats stats;
+};
+
+EXPORT void pacer_init(struct pacer *pacer, uint64_t rate, uint64_t burst);
+
+/** Changes the rate and bucket size without resetting the bucket */
+EXPORT void pacer_set_rate(struct pacer *pacer, uint64_t rate, uint64_t burst);
+
+/**
+ * Accounts for sending `size` bytes, and returns the earliest time (in
+ * os_gettime_ns() time) at which they may be sent.  `now` is the current time.
+ */
+EXPORT uint64_t pacer_reserve(struct pacer *pacer, size_t size,
+			      enum pacer_priority priority, uint64_t now);
+
+/** Reserves `size` bytes and sleeps until they may be sent */
+EXPORT void pacer_wait(struct pacer *pacer, size_t size,
+		       enum pacer_priority priority);
+
+static inline bool pacer_enabled(const struct pacer *pacer)
+{
+	return pacer->rate != 0;
+}
+
+static inline double pacer_avg_delay_ms(const struct pacer *pacer)
+{
+	const struct pacer_stats *stats = &pacer->stats;
+	return stats->sends ? (double)stats->total_delay_ns /
+				      (double)stats->sends / 1000000.0
+			    : 0.0;
+}
+
+#ifdef __cplusplus
+}
+#endif
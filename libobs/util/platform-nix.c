@@ -27,6 +27,8 @@
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <sys/statvfs.h>
+#include <sys/mman.h>
+#include <fcntl.h>
 #include <dirent.h>
 #include <stdlib.h>
 #include <limits.h>
@@ -621,6 +623,42 @@ void os_globfree(os_glob_t *pglob)
 	}
 }
 
+struct os_mapped_file *os_map_file(const char *path)
+{
+	struct os_mapped_file *file;
+	struct stat st;
+	void *data;
+	int fd;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if (fd == -1)
+		return NULL;
+
+	if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+
+	data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return NULL;
+
+	file = bmalloc(sizeof(struct os_mapped_file));
+	file->data = data;
+	file->size = (size_t)st.st_size;
+	return file;
+}
+
+void os_unmap_file(struct os_mapped_file *file)
+{
+	if (file) {
+		munmap((void *)file->data, file->size);
+		bfree(file);
+	}
+}
+
 int os_unlink(const char *path)
 {
 	return unlink(path);
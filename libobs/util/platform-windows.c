@@ -782,6 +782,57 @@ void os_globfree(os_glob_t *pglob)
 	}
 }
 
+struct os_mapped_file *os_map_file(const char *path)
+{
+	struct os_mapped_file *file = NULL;
+	HANDLE handle, mapping = NULL;
+	LARGE_INTEGER size;
+	wchar_t *w_path;
+	void *data;
+
+	os_utf8_to_wcs_ptr(path, 0, &w_path);
+	if (!w_path)
+		return NULL;
+
+	handle = CreateFileW(w_path, GENERIC_READ, FILE_SHARE_READ, NULL,
+			     OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	bfree(w_path);
+
+	if (handle == INVALID_HANDLE_VALUE)
+		return NULL;
+
+	if (!GetFileSizeEx(handle, &size) || size.QuadPart <= 0 ||
+	    (uint64_t)size.QuadPart > SIZE_MAX)
+		goto cleanup;
+
+	mapping = CreateFileMappingW(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!mapping)
+		goto cleanup;
+
+	data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+		goto cleanup;
+
+	file = bmalloc(sizeof(struct os_mapped_file));
+	file->data = data;
+	file->size = (size_t)size.QuadPart;
+
+cleanup:
+	/* the view keeps the mapping open */
+	if (mapping)
+		CloseHandle(mapping);
+	CloseHandle(handle);
+	return file;
+}
+
+void os_unmap_file(struct os_mapped_file *file)
+{
+	if (file) {
+		UnmapViewOfFile(file->data);
+		bfree(file);
+	}
+}
+
 int os_unlink(const char *path)
 {
 	wchar_t *w_path;
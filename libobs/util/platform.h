@@ -61,6 +61,19 @@ EXPORT bool os_quick_write_mbs_file(const char *path, const char *str,
 EXPORT int64_t os_get_file_size(const char *path);
 EXPORT int64_t os_get_free_space(const char *path);
 
+struct os_mapped_file {
+	const void *data;
+	size_t size;
+};
+
+/**
+ * Maps a file into memory for reading.  The file must not be modified in place
+ * while it is mapped, and on Windows it can't be replaced or deleted until it
+ * is unmapped.  Returns NULL if the file could not be mapped or is empty.
+ */
+EXPORT struct os_mapped_file *os_map_file(const char *path);
+EXPORT void os_unmap_file(struct os_mapped_file *file);
+
 EXPORT size_t os_mbs_to_wcs(const char *str, size_t str_len, wchar_t *dst,
 			    size_t dst_size);
 EXPORT size_t os_utf8_to_wcs(const char *str, size_t len, wchar_t *dst,
@@ -0,0 +1,125 @@
+#include <string.h>
+
+#include "spsc-ring.h"
+#include "bmem.h"
+#include "threading.h"
+
+/* The positions only ever increase and wrap around as unsigned values, the
+ * buffer offset is the position masked with size - 1 */
+
+static inline size_t get_pos(const volatile long *pos)
+{
+	return (size_t)(unsigned long)os_atomic_load_long(pos);
+}
+
+static inline void set_pos(volatile long *pos, size_t val)
+{
+	os_atomic_store_long(pos, (long)(unsigned long)val);
+}
+
+static inline size_t pos_diff(size_t a, size_t b)
+{
+	return (size_t)(unsigned long)(a - b);
+}
+
+void spsc_ring_init(struct spsc_ring *ring, size_t size)
+{
+	size_t pow2 = 64;
+
+	while (pow2 < size)
+		pow2 <<= 1;
+
+	ring->data = bmalloc(pow2);
+	ring->size = pow2;
+	ring->write_pos = 0;
+	ring->read_pos = 0;
+}
+
+void spsc_ring_free(struct spsc_ring *ring)
+{
+	bfree(ring->data);
+	memset(ring, 0, sizeof(*ring));
+}
+
+size_t spsc_ring_readable(const struct spsc_ring *ring)
+{
+	size_t write_pos = get_pos(&ring->write_pos);
+	size_t read_pos = get_pos(&ring->read_pos);
+
+	return pos_diff(write_pos, read_pos);
+}
+
+size_t spsc_ring_writable(const struct spsc_ring *ring)
+{
+	return ring->size - spsc_ring_readable(ring);
+}
+
+static void copy_in(struct spsc_ring *ring, size_t pos, const void *data,
+		    size_t size)
+{
+	size_t offset = pos & (ring->size - 1);
+	size_t first = ring->size - offset;
+
+	if (first >= size) {
+		memcpy(ring->data + offset, data, size);
+	} else {
+		memcpy(ring->data + offset, data, first);
+		memcpy(ring->data, (const uint8_t *)data + first, size - first);
+	}
+}
+
+static void copy_out(const struct spsc_ring *ring, size_t pos, void *data,
+		     size_t size)
+{
+	size_t offset = pos & (ring->size - 1);
+	size_t first = ring->size - offset;
+
+	if (first >= size) {
+		memcpy(data, ring->data + offset, size);
+	} else {
+		memcpy(data, ring->data + offset, first);
+		memcpy((uint8_t *)data + first, ring->data, size - first);
+	}
+}
+
+void spsc_ring_write(struct spsc_ring *ring, size_t offset, const void *data,
+		     size_t size)
+{
+	copy_in(ring, get_pos(&ring->write_pos) + offset, data, size);
+}
+
+void spsc_ring_commit(struct spsc_ring *ring, size_t size)
+{
+	set_pos(&ring->write_pos, get_pos(&ring->write_pos) + size);
+}
+
+bool spsc_ring_push(struct spsc_ring *ring, const void *data, size_t size)
+{
+	if (spsc_ring_writable(ring) < size)
+		return false;
+
+	spsc_ring_write(ring, 0, data, size);
+	spsc_ring_commit(ring, size);
+	return true;
+}
+
+bool spsc_ring_peek(const struct spsc_ring *ring, void *data, size_t size)
+{
+	if (spsc_ring_readable(ring) < size)
+		return false;
+
+	copy_out(ring, get_pos(&ring->read_pos), data, size);
+	return true;
+}
+
+bool spsc_ring_pop(struct spsc_ring *ring, void *data, size_t size)
+{
+	if (spsc_ring_readable(ring) < size)
+		return false;
+
+	if (data)
+		copy_out(ring, get_pos(&ring->read_pos), data, size);
+
+	set_pos(&ring->read_pos, get_pos(&ring->read_pos) + size);
+	return true;
+}
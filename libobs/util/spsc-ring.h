@@ -0,0 +1,63 @@
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Single producer, single consumer ring buffer
+ *
+ *   A fixed size byte ring that one thread can write to while another one
+ * reads from it, without locks.  The writer never waits: data that doesn't
+ * fit is rejected.  Each side must only be used by one thread at a time.
+ */
+
+struct spsc_ring {
+	uint8_t *data;
+	size_t size;
+
+	volatile long write_pos;
+	volatile long read_pos;
+};
+
+/** Allocates the buffer, the size is rounded up to a power of two */
+EXPORT void spsc_ring_init(struct spsc_ring *ring, size_t size);
+EXPORT void spsc_ring_free(struct spsc_ring *ring);
+
+/** Bytes the consumer can read */
+EXPORT size_t spsc_ring_readable(const struct spsc_ring *ring);
+
+/** Bytes the producer can write */
+EXPORT size_t spsc_ring_writable(const struct spsc_ring *ring);
+
+/**
+ * Writes all of the data, or nothing if there isn't enough room.  Returns
+ * false in the latter case.
+ */
+EXPORT bool spsc_ring_push(struct spsc_ring *ring, const void *data,
+			   size_t size);
+
+/**
+ * Copies data offset bytes past the current write position without making
+ * it visible to the consumer, so a message can be assembled from several
+ * pieces.  The caller must have checked spsc_ring_writable first.
+ */
+EXPORT void spsc_ring_write(struct spsc_ring *ring, size_t offset,
+			    const void *data, size_t size);
+
+/** Makes the next size bytes written with spsc_ring_write readable */
+EXPORT void spsc_ring_commit(struct spsc_ring *ring, size_t size);
+
+/** Reads exactly size bytes, returns false without reading if fewer are
+ * available.  data may be NULL to skip the bytes. */
+EXPORT bool spsc_ring_pop(struct spsc_ring *ring, void *data, size_t size);
+
+/** Copies size bytes without consuming them */
+EXPORT bool spsc_ring_peek(const struct spsc_ring *ring, void *data,
+			   size_t size);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,147 @@
+#include "worker-pool.h"
+#include "bmem.h"
+#include "darray.h"
+#include "platform.h"
+#include "threading.h"
+
+struct os_worker_pool {
+	DARRAY(pthread_t) threads;
+	os_sem_t *start_sem;
+	os_sem_t *done_sem;
+	volatile bool stop;
+
+	/* held by the thread whose loop is running */
+	pthread_mutex_t run_mutex;
+
+	os_worker_func_t func;
+	void *param;
+	size_t count;
+	volatile long next_idx;
+};
+
+static THREAD_LOCAL const struct os_worker_pool *current_pool = NULL;
+
+static inline void run_iterations(struct os_worker_pool *pool)
+{
+	for (;;) {
+		size_t idx = (size_t)os_atomic_inc_long(&pool->next_idx) - 1;
+		if (idx >= pool->count)
+			break;
+
+		pool->func(pool->param, idx);
+	}
+}
+
+static void *worker_thread(void *data)
+{
+	struct os_worker_pool *pool = data;
+
+	os_set_thread_name("libobs: worker thread");
+	current_pool = pool;
+
+	while (os_sem_wait(pool->start_sem) == 0) {
+		if (os_atomic_load_bool(&pool->stop))
+			break;
+
+		run_iterations(pool);
+		os_sem_post(pool->done_sem);
+	}
+
+	return NULL;
+}
+
+os_worker_pool_t *os_worker_pool_create(size_t num_threads)
+{
+	struct os_worker_pool *pool = bzalloc(sizeof(*pool));
+
+	if (pthread_mutex_init(&pool->run_mutex, NULL) != 0)
+		goto fail1;
+	if (os_sem_init(&pool->start_sem, 0) != 0)
+		goto fail2;
+	if (os_sem_init(&pool->done_sem, 0) != 0)
+		goto fail3;
+
+	for (size_t i = 0; i < num_threads; i++) {
+		pthread_t thread;
+
+		if (pthread_create(&thread, NULL, worker_thread, pool) != 0)
+			break;
+		da_push_back(pool->threads, &thread);
+	}
+
+	return pool;
+
+fail3:
+	os_sem_destroy(pool->start_sem);
+fail2:
+	pthread_mutex_destroy(&pool->run_mutex);
+fail1:
+	bfree(pool);
+	return NULL;
+}
+
+void os_worker_pool_destroy(os_worker_pool_t *pool)
+{
+	if (!pool)
+		return;
+
+	os_atomic_set_bool(&pool->stop, true);
+	for (size_t i = 0; i < pool->threads.num; i++)
+		os_sem_post(pool->start_sem);
+	for (size_t i = 0; i < pool->threads.num; i++)
+		pthread_join(pool->threads.array[i], NULL);
+
+	da_free(pool->threads);
+	os_sem_destroy(pool->done_sem);
+	os_sem_destroy(pool->start_sem);
+	pthread_mutex_destroy(&pool->run_mutex);
+	bfree(pool);
+}
+
+size_t os_worker_pool_num_threads(const os_worker_pool_t *pool)
+{
+	return pool ? pool->threads.num : 0;
+}
+
+bool os_worker_pool_inside(const os_worker_pool_t *pool)
+{
+	return pool && current_pool == pool;
+}
+
+void os_worker_pool_run(os_worker_pool_t *pool, os_worker_func_t func,
+			void *param, size_t count)
+{
+	size_t wake;
+
+	/* a loop started from one of the pool's own threads would wait for
+	 * itself, and one started while another thread's loop is running
+	 * would wait for that loop, so both run inline */
+	if (!pool || !pool->threads.num || count < 2 ||
+	    os_worker_pool_inside(pool) ||
+	    pthread_mutex_trylock(&pool->run_mutex) != 0) {
+		for (size_t i = 0; i < count; i++)
+			func(param, i);
+		return;
+	}
+
+	pool->func = func;
+	pool->param = param;
+	pool->count = count;
+	os_atomic_set_long(&pool->next_idx, 0);
+
+	/* every woken thread posts done_sem exactly once, so no thread can
+	 * still be looking at this loop once all of them were waited for */
+	wake = count - 1;
+	if (wake > pool->threads.num)
+		wake = pool->threads.num;
+
+	for (size_t i = 0; i < wake; i++)
+		os_sem_post(pool->start_sem);
+
+	run_iterations(pool);
+
+	for (size_t i = 0; i < wake; i++)
+		os_sem_wait(pool->done_sem);
+
+	pthread_mutex_unlock(&pool->run_mutex);
+}
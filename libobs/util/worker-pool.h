@@ -0,0 +1,43 @@
+#pragma once
+
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Worker pool
+ *
+ *   Runs the iterations of a loop in parallel on a fixed set of threads.
+ * The calling thread takes part in the work, and os_worker_pool_run returns
+ * once every iteration has finished.  Only one loop runs on a pool at a time;
+ * a loop started while the pool is busy runs on the calling thread instead
+ * of waiting, so a pool can be shared by threads that must not hold each
+ * other up.
+ */
+
+struct os_worker_pool;
+typedef struct os_worker_pool os_worker_pool_t;
+
+typedef void (*os_worker_func_t)(void *param, size_t idx);
+
+/** Creates a pool with the given number of threads (may be 0) */
+EXPORT os_worker_pool_t *os_worker_pool_create(size_t num_threads);
+EXPORT void os_worker_pool_destroy(os_worker_pool_t *pool);
+
+EXPORT size_t os_worker_pool_num_threads(const os_worker_pool_t *pool);
+
+/**
+ * Calls func(param, idx) for every idx in [0, count).  Runs everything on
+ * the calling thread if the pool is NULL or has no threads.
+ */
+EXPORT void os_worker_pool_run(os_worker_pool_t *pool, os_worker_func_t func,
+			       void *param, size_t count);
+
+/** Returns true if called from one of the threads of the pool */
+EXPORT bool os_worker_pool_inside(const os_worker_pool_t *pool);
+
+#ifdef __cplusplus
+}
+#endif
@@ -39,6 +39,12 @@
 #define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
 #define error(format, ...) do_log(LOG_ERROR, format, ##__VA_ARGS__)
 
+#define DBR_INC_TIMER (4ULL * SEC_TO_NSEC)
+
+/* share of the estimated SRT link capacity the stream may use, the rest is
+ * left for retransmissions and protocol overhead */
+#define DBR_LINK_SHARE 0.75
+
 static void ffmpeg_mpegts_set_last_error(struct ffmpeg_data *data,
 					 const char *error)
 {
@@ -75,6 +81,140 @@ static bool is_srt(struct ffmpeg_output *stream)
 			sizeof(SRT_PROTO) - 1);
 }
 
+/* ------------------------------------------------------------------------- */
+/* SRT link statistics & dynamic bitrate */
+
+static void dbr_set_bitrate(struct ffmpeg_output *stream)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
+	obs_data_t *settings = obs_encoder_get_settings(vencoder);
+
+	obs_data_set_int(settings, "bitrate", stream->dbr_cur_bitrate);
+	obs_encoder_update(vencoder, settings);
+
+	obs_data_release(settings);
+}
+
+static void init_dbr(struct ffmpeg_output *stream)
+{
+	obs_encoder_t *venc = obs_output_get_video_encoder(stream->output);
+	obs_encoder_t *aenc = obs_output_get_audio_encoder(stream->output, 0);
+	obs_data_t *settings = obs_output_get_settings(stream->output);
+	obs_data_t *vsettings = obs_encoder_get_settings(venc);
+	obs_data_t *asettings = obs_encoder_get_settings(aenc);
+
+	stream->audio_bitrate = (long)obs_data_get_int(asettings, "bitrate");
+	stream->dbr_orig_bitrate = (long)obs_data_get_int(vsettings, "bitrate");
+	stream->dbr_cur_bitrate = stream->dbr_orig_bitrate;
+	stream->dbr_inc_bitrate = stream->dbr_orig_bitrate / 10;
+	stream->dbr_inc_timeout = 0;
+	stream->dbr_enabled = is_srt(stream) &&
+			      obs_data_get_bool(settings, "dyn_bitrate");
+
+	if (stream->dbr_enabled &&
+	    (obs_encoder_get_caps(venc) & OBS_ENCODER_CAP_DYN_BITRATE) == 0) {
+		stream->dbr_enabled = false;
+		info("Dynamic bitrate disabled. "
+		     "The encoder does not support on-the-fly bitrate reconfiguration.");
+	}
+
+	if (obs_output_get_delay(stream->output) != 0)
+		stream->dbr_enabled = false;
+
+	if (stream->dbr_enabled)
+		info("Dynamic bitrate enabled (SRT link bandwidth)");
+
+	obs_data_release(settings);
+	obs_data_release(vsettings);
+	obs_data_release(asettings);
+}
+
+/* Lowers the video bitrate to what the link can carry according to the SRT
+ * bandwidth estimate, and slowly raises it back once there is room again. */
+static void dbr_update(struct ffmpeg_output *stream,
+		       const struct srt_link_stats *stats)
+{
+	uint64_t now = os_gettime_ns();
+	long new_bitrate = stream->dbr_cur_bitrate;
+	long available;
+
+	if (stats->bandwidth_mbps <= 0.0)
+		return;
+
+	available = (long)(stats->bandwidth_mbps * 1000.0 * DBR_LINK_SHARE) -
+		    stream->audio_bitrate;
+
+	/* a filling send buffer means the link can't keep up, whatever the
+	 * capacity estimate says */
+	if (stats->latency_ms &&
+	    stats->send_buffer_ms > stats->latency_ms / 2 &&
+	    available > stream->dbr_cur_bitrate * 3 / 4)
+		available = stream->dbr_cur_bitrate * 3 / 4;
+
+	available = available / 100 * 100;
+	if (available < 50)
+		available = 50;
+
+	if (available < stream->dbr_cur_bitrate) {
+		new_bitrate = available;
+		stream->dbr_inc_timeout = now + DBR_INC_TIMER;
+
+	} else if (stream->dbr_cur_bitrate < stream->dbr_orig_bitrate &&
+		   now >= stream->dbr_inc_timeout) {
+		new_bitrate = stream->dbr_cur_bitrate + stream->dbr_inc_bitrate;
+		if (new_bitrate > available)
+			new_bitrate = available;
+		if (new_bitrate > stream->dbr_orig_bitrate)
+			new_bitrate = stream->dbr_orig_bitrate;
+		stream->dbr_inc_timeout = now + DBR_INC_TIMER;
+	}
+
+	if (new_bitrate == stream->dbr_cur_bitrate)
+		return;
+
+	info("bitrate %s to: %ld (link bandwidth: %.1f Mbps)",
+	     new_bitrate < stream->dbr_cur_bitrate ? "decreased" : "increased",
+	     new_bitrate, stats->bandwidth_mbps);
+
+	stream->dbr_cur_bitrate = new_bitrate;
+	dbr_set_bitrate(stream);
+}
+
+/* called on the SRT socket thread */
+static void srt_stats_callback(void *param, const struct srt_link_stats *stats)
+{
+	struct ffmpeg_output *stream = param;
+
+	pthread_mutex_lock(&stream->stats_mutex);
+	stream->srt_stats = *stats;
+	pthread_mutex_unlock(&stream->stats_mutex);
+
+	if (stream->dbr_enabled)
+		dbr_update(stream, stats);
+}
+
+static void get_srt_stats_proc(void *data, calldata_t *cd)
+{
+	struct ffmpeg_output *stream = data;
+	struct srt_link_stats stats;
+
+	pthread_mutex_lock(&stream->stats_mutex);
+	stats = stream->srt_stats;
+	pthread_mutex_unlock(&stream->stats_mutex);
+
+	calldata_set_float(cd, "rtt_ms", stats.rtt_ms);
+	calldata_set_float(cd, "bandwidth_mbps", stats.bandwidth_mbps);
+	calldata_set_float(cd, "send_rate_mbps", stats.send_rate_mbps);
+	calldata_set_int(cd, "latency_ms", stats.latency_ms);
+	calldata_set_int(cd, "send_buffer_ms", stats.send_buffer_ms);
+	calldata_set_int(cd, "packets_sent", stats.packets_sent);
+	calldata_set_int(cd, "packets_lost", stats.packets_lost);
+	calldata_set_int(cd, "packets_retransmitted",
+			 stats.packets_retransmitted);
+	calldata_set_int(cd, "packets_dropped", stats.packets_dropped);
+	calldata_set_int(cd, "bytes_sent", (long long)stats.bytes_sent);
+}
+
 static bool proto_is_allowed(struct ffmpeg_output *stream)
 {
 	return !strncmp(stream->ff_data.config.url, UDP_PROTO,
@@ -361,6 +501,8 @@ static inline int connect_mpegts_url(struct ffmpeg_output *stream, bool is_rist)
 					av_strdup(stream->ff_data.config
 							  .encrypt_passphrase);
 		}
+		context->stats_callback = srt_stats_callback;
+		context->stats_param = stream;
 	} else {
 		RISTContext *context = (RISTContext *)uc->priv_data;
 		context->secret = NULL;
@@ -573,6 +715,9 @@ static void close_mpegts_url(struct ffmpeg_output *stream, bool is_rist)
 	if (!h)
 		return; /* can happen when opening the url fails */
 
+	/* send out what is left in the avio buffer while the URL is open */
+	avio_flush(stream->s);
+
 	/* close rist or srt URLs ; free URLContext */
 	if (is_rist) {
 		err = librist_close(h);
@@ -583,7 +728,6 @@ static void close_mpegts_url(struct ffmpeg_output *stream, bool is_rist)
 	av_freep(h);
 
 	/* close custom avio_context for srt or rist */
-	avio_flush(stream->s);
 	stream->s->opaque = NULL;
 	av_freep(&stream->s->buffer);
 	avio_context_free(&stream->s);
@@ -713,8 +857,12 @@ static void *ffmpeg_mpegts_create(obs_data_t *settings, obs_output_t *output)
 	pthread_mutex_init_value(&data->write_mutex);
 	data->output = output;
 
+	pthread_mutex_init_value(&data->stats_mutex);
+
 	if (pthread_mutex_init(&data->write_mutex, NULL) != 0)
 		goto fail;
+	if (pthread_mutex_init(&data->stats_mutex, NULL) != 0)
+		goto fail;
 	if (os_event_init(&data->stop_event, OS_EVENT_TYPE_AUTO) != 0)
 		goto fail;
 	if (os_sem_init(&data->write_sem, 0) != 0)
@@ -722,11 +870,22 @@ static void *ffmpeg_mpegts_create(obs_data_t *settings, obs_output_t *output)
 
 	av_log_set_callback(ffmpeg_mpegts_log_callback);
 
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+	proc_handler_add(ph,
+			 "void get_srt_stats(out float rtt_ms, "
+			 "out float bandwidth_mbps, out float send_rate_mbps, "
+			 "out int latency_ms, out int send_buffer_ms, "
+			 "out int packets_sent, out int packets_lost, "
+			 "out int packets_retransmitted, "
+			 "out int packets_dropped, out int bytes_sent)",
+			 get_srt_stats_proc, data);
+
 	UNUSED_PARAMETER(settings);
 	return data;
 
 fail:
 	pthread_mutex_destroy(&data->write_mutex);
+	pthread_mutex_destroy(&data->stats_mutex);
 	os_event_destroy(data->stop_event);
 	bfree(data);
 	return NULL;
@@ -746,6 +905,7 @@ static void ffmpeg_mpegts_destroy(void *data)
 		ffmpeg_mpegts_full_stop(output);
 
 		pthread_mutex_destroy(&output->write_mutex);
+		pthread_mutex_destroy(&output->stats_mutex);
 		os_sem_destroy(output->write_sem);
 		os_event_destroy(output->stop_event);
 		bfree(data);
@@ -1012,6 +1172,12 @@ static bool set_config(struct ffmpeg_output *stream)
 		goto fail;
 	}
 	struct ffmpeg_data *ff_data = &stream->ff_data;
+
+	pthread_mutex_lock(&stream->stats_mutex);
+	memset(&stream->srt_stats, 0, sizeof(stream->srt_stats));
+	pthread_mutex_unlock(&stream->stats_mutex);
+	init_dbr(stream);
+
 	if (!stream->got_headers) {
 		if (!init_streams(stream, ff_data)) {
 			error("mpegts avstream failed to be created");
@@ -1121,6 +1287,14 @@ static void ffmpeg_mpegts_deactivate(struct ffmpeg_output *output)
 	pthread_mutex_unlock(&output->write_mutex);
 
 	ffmpeg_mpegts_data_free(output, &output->ff_data);
+
+	if (output->dbr_enabled) {
+		if (output->dbr_cur_bitrate != output->dbr_orig_bitrate) {
+			output->dbr_cur_bitrate = output->dbr_orig_bitrate;
+			dbr_set_bitrate(output);
+		}
+		output->dbr_enabled = false;
+	}
 }
 
 static uint64_t ffmpeg_mpegts_total_bytes(void *data)
@@ -1129,6 +1303,22 @@ static uint64_t ffmpeg_mpegts_total_bytes(void *data)
 	return output->total_bytes;
 }
 
+static float ffmpeg_mpegts_get_congestion(void *data)
+{
+	struct ffmpeg_output *output = data;
+	float congestion = 0.0f;
+
+	/* how much of the SRT latency window the unacknowledged data in the
+	 * send buffer takes up */
+	pthread_mutex_lock(&output->stats_mutex);
+	if (output->srt_stats.latency_ms > 0)
+		congestion = (float)output->srt_stats.send_buffer_ms /
+			     (float)output->srt_stats.latency_ms;
+	pthread_mutex_unlock(&output->stats_mutex);
+
+	return congestion > 1.0f ? 1.0f : congestion;
+}
+
 static inline int64_t rescale_ts2(AVStream *stream, AVRational codec_time_base,
 				  int64_t val)
 {
@@ -1315,4 +1505,5 @@ struct obs_output_info ffmpeg_mpegts_muxer = {
 	.encoded_packet = ffmpeg_mpegts_data,
 	.get_total_bytes = ffmpeg_mpegts_total_bytes,
 	.get_properties = ffmpeg_mpegts_properties,
+	.get_congestion = ffmpeg_mpegts_get_congestion,
 };
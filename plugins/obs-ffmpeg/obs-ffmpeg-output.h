@@ -110,6 +110,18 @@ struct ffmpeg_output {
 	URLContext *h;
 	AVIOContext *s;
 	bool got_headers;
+
+	/* SRT link statistics, updated by the socket thread */
+	pthread_mutex_t stats_mutex;
+	struct srt_link_stats srt_stats;
+
+	/* dynamic bitrate, driven by the SRT link statistics */
+	bool dbr_enabled;
+	long dbr_orig_bitrate;
+	long dbr_cur_bitrate;
+	long dbr_inc_bitrate;
+	long audio_bitrate;
+	uint64_t dbr_inc_timeout;
 #endif
 };
 bool ffmpeg_data_init(struct ffmpeg_data *data, struct ffmpeg_cfg *config);
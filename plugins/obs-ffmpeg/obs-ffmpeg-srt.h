@@ -17,17 +17,39 @@
 
 #pragma once
 #include <obs-module.h>
+#include <util/circlebuf.h>
+#include <util/darray.h>
+#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/threading.h>
 #include "obs-ffmpeg-url.h"
 #include <srt/srt.h>
 #include <libavformat/avformat.h>
 
 #define POLLING_TIME 100 /// Time in milliseconds between interrupt check
 
+#define SEC_TO_NSEC 1000000000ULL
+
+/* Link statistics are polled on the socket thread at this interval */
+#define SRT_STATS_INTERVAL (1ULL * SEC_TO_NSEC)
+#define SRT_STATS_LOG_INTERVAL (60ULL * SEC_TO_NSEC)
+
+/* Maximum amount of muxed data waiting for the socket thread.  The muxer is
+ * held back once it is reached. */
+#define SRT_MAX_QUEUE_SIZE (4 * 1024 * 1024)
+
+/* Time given to the socket thread to send out queued data when closing */
+#define SRT_CLOSE_TIMEOUT (1ULL * SEC_TO_NSEC)
+
 /* This is for MPEG-TS (7 TS packets) */
 #ifndef SRT_LIVE_DEFAULT_PAYLOAD_SIZE
 #define SRT_LIVE_DEFAULT_PAYLOAD_SIZE 1316
 #endif
 
+#ifndef SRT_LIVE_MAX_PAYLOAD_SIZE
+#define SRT_LIVE_MAX_PAYLOAD_SIZE 1456
+#endif
+
 enum SRTMode {
 	SRT_MODE_CALLER = 0,
 	SRT_MODE_LISTENER = 1,
@@ -75,7 +97,27 @@ typedef struct SRTContext {
 	SRT_TRANSTYPE transtype;
 	int linger;
 	int tsbpd;
-	double time; // time in s in order to post logs at definite intervals
+#if SRT_VERSION_VALUE >= 0x010500
+	SRT_GROUP_TYPE group_type;
+	char *group_members; // additional "host:port" members, comma separated
+#endif
+
+	/* muxed data is queued by libsrt_write and sent on the socket thread */
+	pthread_t send_thread;
+	bool send_thread_active;
+	pthread_mutex_t send_mutex;
+	os_sem_t *send_sem;
+	struct circlebuf send_queue;
+	int write_eid; /* for libsrt_write to wait on while the queue is full */
+	volatile bool stopping;
+	volatile long send_error;
+	uint64_t stop_deadline;
+
+	int peer_latency;
+	uint64_t last_stats_time;
+	uint64_t last_log_time;
+	void (*stats_callback)(void *param, const struct srt_link_stats *stats);
+	void *stats_param;
 } SRTContext;
 
 static int libsrt_neterrno(URLContext *h)
@@ -445,6 +487,128 @@ static int libsrt_set_options_pre(URLContext *h, SRTSOCKET fd)
 	return 0;
 }
 
+#if SRT_VERSION_VALUE >= 0x010500
+static bool libsrt_add_group_member(struct darray *da, const char *hostname,
+				    int port)
+{
+	DARRAY(SRT_SOCKGROUPCONFIG) members;
+	struct addrinfo hints = {0}, *ai;
+	SRT_SOCKGROUPCONFIG config;
+	char portstr[10];
+	int ret;
+
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+	snprintf(portstr, sizeof(portstr), "%d", port);
+
+	ret = getaddrinfo(hostname, portstr, &hints, &ai);
+	if (ret) {
+		blog(LOG_ERROR,
+		     "[obs-ffmpeg mpegts muxer / libsrt]: Failed to resolve group member %s: %s",
+		     hostname,
+#ifdef _WIN32
+		     gai_strerrorA(ret)
+#else
+		     gai_strerror(ret)
+#endif
+		);
+		return false;
+	}
+
+	config = srt_prepare_endpoint(NULL, ai->ai_addr, (int)ai->ai_addrlen);
+	freeaddrinfo(ai);
+
+	members.da = *da;
+	da_push_back(members, &config);
+	*da = members.da;
+	return true;
+}
+
+/* Connects a socket group (bonding) to the URL host and all additional
+ * group members.  Broadcast groups send every packet over all links, backup
+ * groups only use one link at a time and switch over when it breaks. */
+static int libsrt_setup_group(URLContext *h, const char *hostname, int port)
+{
+	SRTContext *s = (SRTContext *)h->priv_data;
+	DARRAY(SRT_SOCKGROUPCONFIG) members;
+	char **list = NULL;
+	SRTSOCKET group;
+	int eid;
+	int ret = OBS_OUTPUT_CONNECT_FAILED;
+
+	da_init(members);
+
+	group = srt_create_group(s->group_type);
+	if (group == SRT_INVALID_SOCK) {
+		blog(LOG_ERROR,
+		     "[obs-ffmpeg mpegts muxer / libsrt]: Failed to create socket group: %s",
+		     srt_getlasterror_str());
+		return OBS_OUTPUT_CONNECT_FAILED;
+	}
+
+	if ((ret = libsrt_set_options_pre(h, group)) < 0)
+		goto fail;
+
+	ret = OBS_OUTPUT_CONNECT_FAILED;
+	if (!libsrt_add_group_member(&members.da, hostname, port))
+		goto fail;
+
+	if (s->group_members)
+		list = strlist_split(s->group_members, ',', false);
+
+	for (char **member = list; member && *member; member++) {
+		char *sep = strrchr(*member, ':');
+		if (!sep) {
+			blog(LOG_ERROR,
+			     "[obs-ffmpeg mpegts muxer / libsrt]: Port missing in group member %s",
+			     *member);
+			goto fail;
+		}
+
+		*sep = 0;
+		if (!libsrt_add_group_member(&members.da, *member,
+					     atoi(sep + 1)))
+			goto fail;
+	}
+
+	blog(LOG_INFO,
+	     "[obs-ffmpeg mpegts muxer / libsrt]: Connecting %s socket group with %zu members",
+	     s->group_type == SRT_GTYPE_BROADCAST ? "broadcast" : "backup",
+	     members.num);
+
+	/* the group is still blocking, so this returns once the first
+	 * member is connected */
+	if (srt_connect_group(group, members.array, (int)members.num) < 0) {
+		ret = libsrt_neterrno(h);
+		goto fail;
+	}
+
+	if (libsrt_socket_nonblock(group, 1) < 0)
+		blog(LOG_DEBUG,
+		     "[obs-ffmpeg mpegts muxer / libsrt]: libsrt_socket_nonblock failed");
+
+	if ((ret = libsrt_set_options_post(h, group)) < 0)
+		goto fail;
+
+	ret = eid = libsrt_epoll_create(h, group, 1);
+	if (eid < 0)
+		goto fail;
+
+	s->fd = group;
+	s->eid = eid;
+
+	strlist_free(list);
+	da_free(members);
+	return 0;
+
+fail:
+	srt_close(group);
+	strlist_free(list);
+	da_free(members);
+	return ret;
+}
+#endif
+
 static int libsrt_setup(URLContext *h, const char *uri)
 {
 	struct addrinfo hints = {0}, *ai, *cur_ai;
@@ -480,6 +644,16 @@ static int libsrt_setup(URLContext *h, const char *uri)
 	if (s->rw_timeout >= 0) {
 		open_timeout = h->rw_timeout = s->rw_timeout;
 	}
+#if SRT_VERSION_VALUE >= 0x010500
+	if (s->group_type != SRT_GTYPE_UNDEFINED) {
+		if (s->mode != SRT_MODE_CALLER) {
+			blog(LOG_ERROR,
+			     "[obs-ffmpeg mpegts muxer / libsrt]: Socket groups require caller mode");
+			return OBS_OUTPUT_INVALID_STREAM;
+		}
+		return libsrt_setup_group(h, hostname, port);
+	}
+#endif
 	hints.ai_family = AF_UNSPEC;
 	hints.ai_socktype = SOCK_DGRAM;
 	snprintf(portstr, sizeof(portstr), "%d", port);
@@ -633,6 +807,166 @@ static void libsrt_set_defaults(SRTContext *s)
 	s->transtype = SRTT_LIVE;
 	s->linger = -1;
 	s->tsbpd = -1;
+#if SRT_VERSION_VALUE >= 0x010500
+	s->group_type = SRT_GTYPE_UNDEFINED;
+#endif
+}
+
+/* Polls the link statistics of the socket, at most once per interval unless
+ * forced.  Only called on the socket thread. */
+static void libsrt_update_stats(URLContext *h, bool force)
+{
+	SRTContext *s = (SRTContext *)h->priv_data;
+	struct srt_link_stats stats = {0};
+	SRT_TRACEBSTATS perf = {0};
+	uint64_t now = os_gettime_ns();
+
+	if (!force && now - s->last_stats_time < SRT_STATS_INTERVAL)
+		return;
+
+	s->last_stats_time = now;
+
+	if (srt_bstats(s->fd, &perf, 1) < 0)
+		return;
+
+	stats.rtt_ms = perf.msRTT;
+	stats.bandwidth_mbps = perf.mbpsBandwidth;
+	stats.send_rate_mbps = perf.mbpsSendRate;
+	stats.latency_ms = s->peer_latency;
+	stats.send_buffer_ms = perf.msSndBuf;
+	stats.packets_sent = perf.pktSentTotal;
+	stats.packets_lost = perf.pktSndLossTotal;
+	stats.packets_retransmitted = perf.pktRetransTotal;
+	stats.packets_dropped = perf.pktSndDropTotal;
+	stats.bytes_sent = perf.byteSentTotal;
+
+	if (s->stats_callback)
+		s->stats_callback(s->stats_param, &stats);
+
+	/* log the rtt and link bandwidth (from ingest to egress) every
+	 * minute */
+	if (now - s->last_log_time >= SRT_STATS_LOG_INTERVAL) {
+		blog(LOG_DEBUG,
+		     "[obs-ffmpeg mpegts muxer / libsrt]: RTT [%.2f ms], Link Bandwidth [%.1f Mbps]",
+		     perf.msRTT, perf.mbpsBandwidth);
+		s->last_log_time = now;
+	}
+}
+
+static int libsrt_interrupt(void *opaque)
+{
+	SRTContext *s = opaque;
+
+	/* when closing, give up on a stalled link after a while */
+	return os_atomic_load_bool(&s->stopping) &&
+	       os_gettime_ns() > s->stop_deadline;
+}
+
+static void *libsrt_send_thread(void *data)
+{
+	URLContext *h = data;
+	SRTContext *s = (SRTContext *)h->priv_data;
+	uint8_t buf[SRT_LIVE_MAX_PAYLOAD_SIZE];
+
+	os_set_thread_name("srt: send thread");
+
+	while (os_sem_wait(s->send_sem) == 0) {
+		int size = 0;
+		int ret;
+
+		pthread_mutex_lock(&s->send_mutex);
+		if (s->send_queue.size) {
+			circlebuf_pop_front(&s->send_queue, &size,
+					    sizeof(size));
+			circlebuf_pop_front(&s->send_queue, buf, size);
+		}
+		pthread_mutex_unlock(&s->send_mutex);
+
+		if (!size) {
+			/* everything queued before closing has been sent */
+			if (os_atomic_load_bool(&s->stopping))
+				break;
+			continue;
+		}
+
+		ret = libsrt_network_wait_fd_timeout(h, s->eid, 1,
+						     h->rw_timeout,
+						     &h->interrupt_callback);
+		if (ret == 0) {
+			ret = srt_send(s->fd, (char *)buf, size);
+			if (ret < 0)
+				ret = libsrt_neterrno(h);
+		}
+
+		if (ret < 0) {
+			os_atomic_set_long(&s->send_error, ret);
+			break;
+		}
+
+		libsrt_update_stats(h, false);
+	}
+
+	return NULL;
+}
+
+static int libsrt_start_send_thread(URLContext *h)
+{
+	SRTContext *s = (SRTContext *)h->priv_data;
+	int optlen = sizeof(s->peer_latency);
+
+	if (srt_getsockopt(s->fd, 0, SRTO_PEERLATENCY, &s->peer_latency,
+			   &optlen) < 0)
+		s->peer_latency = 0;
+
+	h->interrupt_callback.callback = libsrt_interrupt;
+	h->interrupt_callback.opaque = s;
+
+	if (pthread_mutex_init(&s->send_mutex, NULL) != 0)
+		return AVERROR(ENOMEM);
+	if (os_sem_init(&s->send_sem, 0) != 0) {
+		pthread_mutex_destroy(&s->send_mutex);
+		return AVERROR(ENOMEM);
+	}
+
+	s->write_eid = libsrt_epoll_create(h, s->fd, 1);
+	if (s->write_eid < 0) {
+		int ret = s->write_eid;
+		pthread_mutex_destroy(&s->send_mutex);
+		os_sem_destroy(s->send_sem);
+		return ret;
+	}
+
+	s->send_thread_active = pthread_create(&s->send_thread, NULL,
+					       libsrt_send_thread, h) == 0;
+	if (!s->send_thread_active) {
+		srt_epoll_release(s->write_eid);
+		pthread_mutex_destroy(&s->send_mutex);
+		os_sem_destroy(s->send_sem);
+		return AVERROR(ENOMEM);
+	}
+
+	return 0;
+}
+
+static void libsrt_stop_send_thread(URLContext *h)
+{
+	SRTContext *s = (SRTContext *)h->priv_data;
+
+	if (!s->send_thread_active)
+		return;
+
+	s->stop_deadline = os_gettime_ns() + SRT_CLOSE_TIMEOUT;
+	os_atomic_set_bool(&s->stopping, true);
+	os_sem_post(s->send_sem);
+	pthread_join(s->send_thread, NULL);
+	s->send_thread_active = false;
+
+	libsrt_update_stats(h, true);
+
+	srt_epoll_release(s->write_eid);
+	circlebuf_free(&s->send_queue);
+	pthread_mutex_destroy(&s->send_mutex);
+	os_sem_destroy(s->send_sem);
 }
 
 static int libsrt_open(URLContext *h, const char *uri)
@@ -780,70 +1114,91 @@ static int libsrt_open(URLContext *h, const char *uri)
 		if (av_find_info_tag(buf, sizeof(buf), "linger", p)) {
 			s->linger = strtol(buf, NULL, 10);
 		}
+#if SRT_VERSION_VALUE >= 0x010500
+		if (av_find_info_tag(buf, sizeof(buf), "grouptype", p)) {
+			if (!strcmp(buf, "broadcast")) {
+				s->group_type = SRT_GTYPE_BROADCAST;
+			} else if (!strcmp(buf, "backup")) {
+				s->group_type = SRT_GTYPE_BACKUP;
+			} else {
+				ret = AVERROR(EINVAL);
+				goto err;
+			}
+		}
+		if (av_find_info_tag(buf, sizeof(buf), "groupmembers", p)) {
+			bfree(s->group_members);
+			s->group_members = bstrdup(buf);
+		}
+#endif
 	}
 	ret = libsrt_setup(h, uri);
 	if (ret < 0)
 		goto err;
 
-#ifdef _WIN32
-	struct timeb timebuffer;
-	ftime(&timebuffer);
-	s->time = (double)timebuffer.time + 0.001 * (double)timebuffer.millitm;
-#else
-	struct timespec timesp;
-	clock_gettime(CLOCK_REALTIME, &timesp);
-	s->time = (double)timesp.tv_sec + 0.000000001 * (double)timesp.tv_nsec;
-#endif
+	s->last_log_time = os_gettime_ns();
+
+	ret = libsrt_start_send_thread(h);
+	if (ret < 0) {
+		srt_epoll_release(s->eid);
+		srt_close(s->fd);
+		goto err;
+	}
 
 	return 0;
 
 err:
 	av_freep(&s->smoother);
 	av_freep(&s->streamid);
+#if SRT_VERSION_VALUE >= 0x010500
+	bfree(s->group_members);
+	s->group_members = NULL;
+#endif
 	srt_cleanup();
 	return ret;
 }
 
+/* Queues muxed data for the socket thread, so that network stalls don't hold
+ * up the muxer. */
 static int libsrt_write(URLContext *h, const uint8_t *buf, int size)
 {
 	SRTContext *s = (SRTContext *)h->priv_data;
-	int ret;
-	SRT_TRACEBSTATS perf;
+	long err = os_atomic_load_long(&s->send_error);
 
-	ret = libsrt_network_wait_fd_timeout(h, s->eid, 1, h->rw_timeout,
-					     &h->interrupt_callback);
-	if (ret)
-		return ret;
+	if (err)
+		return (int)err;
+	if (size <= 0)
+		return 0;
 
-	ret = srt_send(s->fd, (char *)buf, size);
-	if (ret < 0) {
-		ret = libsrt_neterrno(h);
-	} else {
-		/* log every 60 seconds the rtt and link bandwidth
-		 * rtt: round-trip time
-		 * link bandwidth: bandwidth from ingest to egress
-		*/
-#ifdef _WIN32
-		struct timeb timebuffer;
-		ftime(&timebuffer);
-		double time = (double)timebuffer.time +
-			      0.001 * (double)timebuffer.millitm;
-#else
-		struct timespec timesp;
-		clock_gettime(CLOCK_REALTIME, &timesp);
-		double time = (double)timesp.tv_sec +
-			      0.000000001 * (double)timesp.tv_nsec;
-#endif
-		if (time > (s->time + 60.0)) {
-			srt_bistats(s->fd, &perf, 0, 1);
-			blog(LOG_DEBUG,
-			     "[obs-ffmpeg mpegts muxer / libsrt]: RTT [%.2f ms], Link Bandwidth [%.1f Mbps]",
-			     perf.msRTT, perf.mbpsBandwidth);
-			s->time = time;
-		}
+	pthread_mutex_lock(&s->send_mutex);
+
+	/* the queue only stays full while the link is stalled, so wait for the
+	 * socket to take data again, which is also when the socket thread
+	 * makes room */
+	while (s->send_queue.size > SRT_MAX_QUEUE_SIZE) {
+		int ret;
+
+		pthread_mutex_unlock(&s->send_mutex);
+
+		err = os_atomic_load_long(&s->send_error);
+		if (err)
+			return (int)err;
+
+		ret = libsrt_network_wait_fd_timeout(h, s->write_eid, 1,
+						     h->rw_timeout,
+						     &h->interrupt_callback);
+		if (ret < 0)
+			return ret;
+
+		pthread_mutex_lock(&s->send_mutex);
 	}
 
-	return ret;
+	circlebuf_push_back(&s->send_queue, &size, sizeof(size));
+	circlebuf_push_back(&s->send_queue, buf, size);
+
+	pthread_mutex_unlock(&s->send_mutex);
+
+	os_sem_post(s->send_sem);
+	return size;
 }
 
 static int libsrt_close(URLContext *h)
@@ -853,6 +1208,13 @@ static int libsrt_close(URLContext *h)
 		av_freep(&s->streamid);
 	if (s->passphrase)
 		av_freep(&s->passphrase);
+#if SRT_VERSION_VALUE >= 0x010500
+	bfree(s->group_members);
+	s->group_members = NULL;
+#endif
+
+	libsrt_stop_send_thread(h);
+
 	/* Log stream stats. */
 	SRT_TRACEBSTATS perf = {0};
 	srt_bstats(s->fd, &perf, 1);
@@ -24,6 +24,20 @@ typedef struct URLContext {
 	int64_t rw_timeout; /* max time to wait for write completion in mcs */
 } URLContext;
 
+/* link statistics of an SRT connection, from srt_bstats */
+struct srt_link_stats {
+	double rtt_ms;
+	double bandwidth_mbps; /* estimated link capacity */
+	double send_rate_mbps;
+	int latency_ms;
+	int send_buffer_ms; /* age of the oldest unacknowledged packet */
+	int64_t packets_sent;
+	int64_t packets_lost;
+	int64_t packets_retransmitted;
+	int64_t packets_dropped;
+	uint64_t bytes_sent;
+};
+
 #define UDP_DEFAULT_PAYLOAD_SIZE 1316
 
 /* We need to override libsrt/win/syslog_defs.h due to conflicts w/ some libobs
@@ -0,0 +1,371 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <math.h>
+#include <string.h>
+
+#include "audio-biquad.h"
+#include <util/sse-intrin.h>
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+/* samples per lane that are interleaved and filtered at a time */
+#define CHUNK_FRAMES 256
+
+/* state values below this (-300 dB) are flushed to zero after every chunk,
+ * otherwise a filter ringing out on silence ends up computing on denormals */
+#define STATE_EPSILON 1e-15f
+
+enum coeff_index { B0, B1, B2, A1, A2 };
+
+void audio_biquad_design(struct audio_biquad *biquad,
+			 enum audio_biquad_type type, double sample_rate,
+			 double freq, double q, double gain_db)
+{
+	const double nyquist = sample_rate * 0.5;
+	double b0 = 1.0, b1 = 0.0, b2 = 0.0, a0 = 1.0, a1 = 0.0, a2 = 0.0;
+
+	if (freq > nyquist * 0.999)
+		freq = nyquist * 0.999;
+	if (freq < 1.0)
+		freq = 1.0;
+	if (q < 0.01)
+		q = 0.01;
+
+	const double w0 = 2.0 * M_PI * freq / sample_rate;
+	const double cos_w0 = cos(w0);
+	const double alpha = sin(w0) / (2.0 * q);
+	const double a = pow(10.0, gain_db / 40.0);
+	const double shelf = 2.0 * sqrt(a) * alpha;
+
+	switch (type) {
+	case AUDIO_BIQUAD_BYPASS:
+		break;
+	case AUDIO_BIQUAD_PEAK:
+		b0 = 1.0 + alpha * a;
+		b1 = -2.0 * cos_w0;
+		b2 = 1.0 - alpha * a;
+		a0 = 1.0 + alpha / a;
+		a1 = -2.0 * cos_w0;
+		a2 = 1.0 - alpha / a;
+		break;
+	case AUDIO_BIQUAD_LOW_SHELF:
+		b0 = a * ((a + 1.0) - (a - 1.0) * cos_w0 + shelf);
+		b1 = 2.0 * a * ((a - 1.0) - (a + 1.0) * cos_w0);
+		b2 = a * ((a + 1.0) - (a - 1.0) * cos_w0 - shelf);
+		a0 = (a + 1.0) + (a - 1.0) * cos_w0 + shelf;
+		a1 = -2.0 * ((a - 1.0) + (a + 1.0) * cos_w0);
+		a2 = (a + 1.0) + (a - 1.0) * cos_w0 - shelf;
+		break;
+	case AUDIO_BIQUAD_HIGH_SHELF:
+		b0 = a * ((a + 1.0) + (a - 1.0) * cos_w0 + shelf);
+		b1 = -2.0 * a * ((a - 1.0) + (a + 1.0) * cos_w0);
+		b2 = a * ((a + 1.0) + (a - 1.0) * cos_w0 - shelf);
+		a0 = (a + 1.0) - (a - 1.0) * cos_w0 + shelf;
+		a1 = 2.0 * ((a - 1.0) - (a + 1.0) * cos_w0);
+		a2 = (a + 1.0) - (a - 1.0) * cos_w0 - shelf;
+		break;
+	case AUDIO_BIQUAD_LOWPASS:
+		b0 = (1.0 - cos_w0) * 0.5;
+		b1 = 1.0 - cos_w0;
+		b2 = (1.0 - cos_w0) * 0.5;
+		a0 = 1.0 + alpha;
+		a1 = -2.0 * cos_w0;
+		a2 = 1.0 - alpha;
+		break;
+	case AUDIO_BIQUAD_HIGHPASS:
+		b0 = (1.0 + cos_w0) * 0.5;
+		b1 = -(1.0 + cos_w0);
+		b2 = (1.0 + cos_w0) * 0.5;
+		a0 = 1.0 + alpha;
+		a1 = -2.0 * cos_w0;
+		a2 = 1.0 - alpha;
+		break;
+	case AUDIO_BIQUAD_BANDPASS:
+		/* 0 dB peak gain */
+		b0 = alpha;
+		b2 = -alpha;
+		a0 = 1.0 + alpha;
+		a1 = -2.0 * cos_w0;
+		a2 = 1.0 - alpha;
+		break;
+	case AUDIO_BIQUAD_NOTCH:
+		b0 = 1.0;
+		b1 = -2.0 * cos_w0;
+		b2 = 1.0;
+		a0 = 1.0 + alpha;
+		a1 = -2.0 * cos_w0;
+		a2 = 1.0 - alpha;
+		break;
+	}
+
+	biquad->b0 = (float)(b0 / a0);
+	biquad->b1 = (float)(b1 / a0);
+	biquad->b2 = (float)(b2 / a0);
+	biquad->a1 = (float)(a1 / a0);
+	biquad->a2 = (float)(a2 / a0);
+}
+
+double audio_biquad_response(const struct audio_biquad *biquads, size_t count,
+			     double sample_rate, double freq)
+{
+	const double w = 2.0 * M_PI * freq / sample_rate;
+	const double c1 = cos(w), s1 = sin(w);
+	const double c2 = cos(2.0 * w), s2 = sin(2.0 * w);
+	double mag = 1.0;
+
+	/* |b0 + b1 z^-1 + b2 z^-2| / |1 + a1 z^-1 + a2 z^-2| at z = e^jw */
+	for (size_t i = 0; i < count; i++) {
+		const struct audio_biquad *bq = &biquads[i];
+		double nr = bq->b0 + bq->b1 * c1 + bq->b2 * c2;
+		double ni = -(bq->b1 * s1 + bq->b2 * s2);
+		double dr = 1.0 + bq->a1 * c1 + bq->a2 * c2;
+		double di = -(bq->a1 * s1 + bq->a2 * s2);
+
+		mag *= sqrt((nr * nr + ni * ni) / (dr * dr + di * di));
+	}
+
+	return mag;
+}
+
+static const struct audio_biquad identity = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+
+void audio_biquad_bank_init(struct audio_biquad_bank *bank, size_t lanes,
+			    size_t stages)
+{
+	memset(bank, 0, sizeof(*bank));
+
+	if (lanes > AUDIO_BIQUAD_MAX_LANES)
+		lanes = AUDIO_BIQUAD_MAX_LANES;
+	if (stages > AUDIO_BIQUAD_MAX_STAGES)
+		stages = AUDIO_BIQUAD_MAX_STAGES;
+
+	bank->lanes = lanes;
+	bank->stages = stages;
+
+	for (size_t lane = 0; lane < AUDIO_BIQUAD_MAX_LANES; lane++)
+		for (size_t stage = 0; stage < stages; stage++)
+			audio_biquad_bank_set(bank, lane, stage, &identity);
+}
+
+void audio_biquad_bank_set(struct audio_biquad_bank *bank, size_t lane,
+			   size_t stage, const struct audio_biquad *biquad)
+{
+	if (lane >= AUDIO_BIQUAD_MAX_LANES || stage >= bank->stages)
+		return;
+
+	float(*c)[4] = bank->coeffs[lane / 4][stage];
+	const size_t l = lane % 4;
+
+	c[B0][l] = biquad->b0;
+	c[B1][l] = biquad->b1;
+	c[B2][l] = biquad->b2;
+	c[A1][l] = biquad->a1;
+	c[A2][l] = biquad->a2;
+}
+
+void audio_biquad_bank_reset(struct audio_biquad_bank *bank)
+{
+	memset(bank->state, 0, sizeof(bank->state));
+}
+
+static inline __m128 load_lane(const float *in, size_t i)
+{
+	return in ? _mm_loadu_ps(in + i) : _mm_setzero_ps();
+}
+
+static void interleave(__m128 *buf, const float *in[4], size_t frames)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 s0 = load_lane(in[0], i);
+		__m128 s1 = load_lane(in[1], i);
+		__m128 s2 = load_lane(in[2], i);
+		__m128 s3 = load_lane(in[3], i);
+		_MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+		buf[i] = s0;
+		buf[i + 1] = s1;
+		buf[i + 2] = s2;
+		buf[i + 3] = s3;
+	}
+
+	for (; i < frames; i++) {
+		buf[i] = _mm_setr_ps(in[0] ? in[0][i] : 0.0f,
+				     in[1] ? in[1][i] : 0.0f,
+				     in[2] ? in[2][i] : 0.0f,
+				     in[3] ? in[3][i] : 0.0f);
+	}
+}
+
+static void deinterleave(float *out[4], const __m128 *buf, size_t frames)
+{
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 s0 = buf[i];
+		__m128 s1 = buf[i + 1];
+		__m128 s2 = buf[i + 2];
+		__m128 s3 = buf[i + 3];
+		_MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+		if (out[0])
+			_mm_storeu_ps(out[0] + i, s0);
+		if (out[1])
+			_mm_storeu_ps(out[1] + i, s1);
+		if (out[2])
+			_mm_storeu_ps(out[2] + i, s2);
+		if (out[3])
+			_mm_storeu_ps(out[3] + i, s3);
+	}
+
+	for (; i < frames; i++) {
+		float s[4];
+		_mm_storeu_ps(s, buf[i]);
+		for (size_t l = 0; l < 4; l++) {
+			if (out[l])
+				out[l][i] = s[l];
+		}
+	}
+}
+
+static inline __m128 flush_denormal(__m128 x)
+{
+	const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 epsilon = _mm_set1_ps(STATE_EPSILON);
+
+	return _mm_and_ps(x, _mm_cmpge_ps(_mm_and_ps(x, abs_mask), epsilon));
+}
+
+struct stage_regs {
+	__m128 b0, b1, b2, a1, a2;
+	__m128 s1, s2;
+};
+
+static inline void load_stage(struct stage_regs *r, float (*c)[4],
+			      float (*state)[4])
+{
+	r->b0 = _mm_loadu_ps(c[B0]);
+	r->b1 = _mm_loadu_ps(c[B1]);
+	r->b2 = _mm_loadu_ps(c[B2]);
+	r->a1 = _mm_loadu_ps(c[A1]);
+	r->a2 = _mm_loadu_ps(c[A2]);
+	r->s1 = _mm_loadu_ps(state[0]);
+	r->s2 = _mm_loadu_ps(state[1]);
+}
+
+static inline void store_stage(const struct stage_regs *r, float (*state)[4])
+{
+	_mm_storeu_ps(state[0], flush_denormal(r->s1));
+	_mm_storeu_ps(state[1], flush_denormal(r->s2));
+}
+
+static inline __m128 step(struct stage_regs *r, __m128 x)
+{
+	const __m128 y = _mm_add_ps(_mm_mul_ps(r->b0, x), r->s1);
+
+	r->s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(r->b1, x),
+				      _mm_mul_ps(r->a1, y)),
+			   r->s2);
+	r->s2 = _mm_sub_ps(_mm_mul_ps(r->b2, x), _mm_mul_ps(r->a2, y));
+	return y;
+}
+
+/* The recursion of a single stage can't be vectorized over time, but every
+ * lane is an independent filter.  Four stages are run per pass so that the
+ * stages of consecutive samples can overlap instead of every pass waiting
+ * on the latency of one recursion. */
+static void filter_four_stages(__m128 *buf, size_t frames, float (*c)[5][4],
+			       float (*state)[2][4])
+{
+	struct stage_regs r0, r1, r2, r3;
+
+	load_stage(&r0, c[0], state[0]);
+	load_stage(&r1, c[1], state[1]);
+	load_stage(&r2, c[2], state[2]);
+	load_stage(&r3, c[3], state[3]);
+
+	for (size_t i = 0; i < frames; i++)
+		buf[i] = step(&r3, step(&r2, step(&r1, step(&r0, buf[i]))));
+
+	store_stage(&r0, state[0]);
+	store_stage(&r1, state[1]);
+	store_stage(&r2, state[2]);
+	store_stage(&r3, state[3]);
+}
+
+static void filter_stage(__m128 *buf, size_t frames, float (*c)[4],
+			 float (*state)[4])
+{
+	struct stage_regs r;
+
+	load_stage(&r, c, state);
+	for (size_t i = 0; i < frames; i++)
+		buf[i] = step(&r, buf[i]);
+	store_stage(&r, state);
+}
+
+static void filter_chunk(struct audio_biquad_bank *bank, size_t group,
+			 __m128 *buf, size_t frames)
+{
+	float(*c)[5][4] = bank->coeffs[group];
+	float(*state)[2][4] = bank->state[group];
+	size_t s = 0;
+
+	for (; s + 4 <= bank->stages; s += 4)
+		filter_four_stages(buf, frames, c + s, state + s);
+	for (; s < bank->stages; s++)
+		filter_stage(buf, frames, c[s], state[s]);
+}
+
+void audio_biquad_bank_process(struct audio_biquad_bank *bank,
+			       float *const *out, const float *const *in,
+			       size_t frames)
+{
+	__m128 buf[CHUNK_FRAMES];
+
+	for (size_t g = 0; g * 4 < bank->lanes; g++) {
+		const float *group_in[4] = {NULL};
+		float *group_out[4] = {NULL};
+
+		for (size_t l = 0; l < 4 && g * 4 + l < bank->lanes; l++) {
+			group_in[l] = in[g * 4 + l];
+			group_out[l] = out[g * 4 + l];
+		}
+
+		for (size_t i = 0; i < frames; i += CHUNK_FRAMES) {
+			size_t count = frames - i;
+			const float *chunk_in[4];
+			float *chunk_out[4];
+
+			if (count > CHUNK_FRAMES)
+				count = CHUNK_FRAMES;
+
+			for (size_t l = 0; l < 4; l++) {
+				chunk_in[l] = group_in[l] ? group_in[l] + i
+							  : NULL;
+				chunk_out[l] = group_out[l] ? group_out[l] + i
+							    : NULL;
+			}
+
+			interleave(buf, chunk_in, count);
+			filter_chunk(bank, g, buf, count);
+			deinterleave(chunk_out, buf, count);
+		}
+	}
+}
@@ -0,0 +1,107 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/c99defs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Cascades of biquad filters for equalizers.  A bank runs several
+ * independent cascades ("lanes") in SIMD registers, four lanes at a time,
+ * so the channels of a source (or several filters of the same channel) are
+ * processed side by side.  Every lane has its own coefficients but all
+ * lanes of a bank have the same number of stages.
+ *
+ * Stages are transposed direct form II with float state.  Coefficients are
+ * normalized so that a0 is 1:
+ *
+ *   y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+ */
+
+#define AUDIO_BIQUAD_MAX_STAGES 16
+#define AUDIO_BIQUAD_MAX_LANES 16
+#define AUDIO_BIQUAD_LANE_GROUPS (AUDIO_BIQUAD_MAX_LANES / 4)
+
+enum audio_biquad_type {
+	AUDIO_BIQUAD_BYPASS,
+	AUDIO_BIQUAD_PEAK,
+	AUDIO_BIQUAD_LOW_SHELF,
+	AUDIO_BIQUAD_HIGH_SHELF,
+	AUDIO_BIQUAD_LOWPASS,
+	AUDIO_BIQUAD_HIGHPASS,
+	AUDIO_BIQUAD_BANDPASS,
+	AUDIO_BIQUAD_NOTCH,
+};
+
+struct audio_biquad {
+	float b0, b1, b2;
+	float a1, a2;
+};
+
+struct audio_biquad_bank {
+	size_t lanes;
+	size_t stages;
+
+	/* b0, b1, b2, a1, a2 and the two state values of each stage, with
+	 * the four lanes of a group next to each other */
+	float coeffs[AUDIO_BIQUAD_LANE_GROUPS][AUDIO_BIQUAD_MAX_STAGES][5][4];
+	float state[AUDIO_BIQUAD_LANE_GROUPS][AUDIO_BIQUAD_MAX_STAGES][2][4];
+};
+
+/**
+ * Computes the coefficients of a filter from the Audio EQ Cookbook.  q is
+ * the quality factor of every type (for shelves it sets the slope, 0.707
+ * being the steepest without overshoot), and gain_db is only used by the
+ * peak and shelf filters.
+ */
+extern void audio_biquad_design(struct audio_biquad *biquad,
+				enum audio_biquad_type type, double sample_rate,
+				double freq, double q, double gain_db);
+
+/** Magnitude response of a cascade of biquads at freq, as a linear gain */
+extern double audio_biquad_response(const struct audio_biquad *biquads,
+				    size_t count, double sample_rate,
+				    double freq);
+
+/** Sets up a bank with every stage passing its input through unchanged */
+extern void audio_biquad_bank_init(struct audio_biquad_bank *bank,
+				   size_t lanes, size_t stages);
+
+/** Changes the coefficients of one stage, keeping its state */
+extern void audio_biquad_bank_set(struct audio_biquad_bank *bank, size_t lane,
+				  size_t stage,
+				  const struct audio_biquad *biquad);
+
+/** Clears the filter state of every lane */
+extern void audio_biquad_bank_reset(struct audio_biquad_bank *bank);
+
+/**
+ * Filters frames samples of every lane from in to out.  out may alias in,
+ * and an in pointer that is NULL is treated as silence and an out pointer
+ * that is NULL discards the lane's output.
+ */
+extern void audio_biquad_bank_process(struct audio_biquad_bank *bank,
+				      float *const *out,
+				      const float *const *in, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
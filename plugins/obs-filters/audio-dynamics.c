@@ -0,0 +1,279 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <string.h>
+
+#include "audio-dynamics.h"
+#include <media-io/audio-math.h>
+#include <util/sse-intrin.h>
+
+#define GROUP_CHANNELS 4
+
+/* SIMD versions of fast_log2f and fast_exp2f, same operations in the same
+ * order so the scalar tails give matching results */
+static inline __m128 log2_ps(__m128 x)
+{
+	const __m128i bits = _mm_castps_si128(x);
+	const __m128i exp_bits = _mm_and_si128(_mm_srli_epi32(bits, 23),
+					       _mm_set1_epi32(0xff));
+	const __m128i mant_bits =
+		_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)),
+			     _mm_set1_epi32(0x3f800000));
+	const __m128 one = _mm_set1_ps(1.0f);
+
+	__m128 e = _mm_cvtepi32_ps(
+		_mm_sub_epi32(exp_bits, _mm_set1_epi32(127)));
+	__m128 m = _mm_castsi128_ps(mant_bits);
+
+	const __m128 high = _mm_cmpgt_ps(m, _mm_set1_ps(1.414213562f));
+	m = _mm_or_ps(_mm_and_ps(high, _mm_mul_ps(m, _mm_set1_ps(0.5f))),
+			 _mm_andnot_ps(high, m));
+	e = _mm_add_ps(e, _mm_and_ps(high, one));
+
+	const __m128 t = _mm_div_ps(_mm_sub_ps(m, one), _mm_add_ps(m, one));
+	const __m128 t2 = _mm_mul_ps(t, t);
+	__m128 p = _mm_add_ps(_mm_set1_ps(FAST_LOG2_C5),
+			      _mm_mul_ps(t2, _mm_set1_ps(FAST_LOG2_C7)));
+	p = _mm_add_ps(_mm_set1_ps(FAST_LOG2_C3), _mm_mul_ps(t2, p));
+	p = _mm_add_ps(_mm_set1_ps(FAST_LOG2_C1), _mm_mul_ps(t2, p));
+	return _mm_add_ps(e, _mm_mul_ps(t, p));
+}
+
+static inline __m128 exp2_ps(__m128 x)
+{
+	const __m128 underflow = _mm_cmplt_ps(x, _mm_set1_ps(-126.0f));
+	x = _mm_max_ps(x, _mm_set1_ps(-126.0f));
+	x = _mm_min_ps(x, _mm_set1_ps(127.0f));
+
+	/* floor(x + 0.5) */
+	const __m128 y = _mm_add_ps(x, _mm_set1_ps(0.5f));
+	__m128 n = _mm_cvtepi32_ps(_mm_cvttps_epi32(y));
+	n = _mm_sub_ps(n, _mm_and_ps(_mm_cmpgt_ps(n, y), _mm_set1_ps(1.0f)));
+
+	const __m128 f = _mm_sub_ps(x, n);
+	__m128 p = _mm_add_ps(_mm_set1_ps(FAST_EXP2_C5),
+			      _mm_mul_ps(f, _mm_set1_ps(FAST_EXP2_C6)));
+	p = _mm_add_ps(_mm_set1_ps(FAST_EXP2_C4), _mm_mul_ps(f, p));
+	p = _mm_add_ps(_mm_set1_ps(FAST_EXP2_C3), _mm_mul_ps(f, p));
+	p = _mm_add_ps(_mm_set1_ps(FAST_EXP2_C2), _mm_mul_ps(f, p));
+	p = _mm_add_ps(_mm_set1_ps(FAST_EXP2_C1), _mm_mul_ps(f, p));
+	p = _mm_add_ps(_mm_set1_ps(1.0f), _mm_mul_ps(f, p));
+
+	const __m128i scale = _mm_slli_epi32(
+		_mm_add_epi32(_mm_cvttps_epi32(n), _mm_set1_epi32(127)), 23);
+	return _mm_andnot_ps(underflow,
+			     _mm_mul_ps(p, _mm_castsi128_ps(scale)));
+}
+
+static inline __m128 abs_ps(__m128 x)
+{
+	return _mm_and_ps(x, _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff)));
+}
+
+static inline __m128 follow_ps(__m128 env, __m128 in, __m128 attack,
+			       __m128 release)
+{
+	const __m128 rising = _mm_cmplt_ps(env, in);
+	const __m128 gain = _mm_or_ps(_mm_and_ps(rising, attack),
+				      _mm_andnot_ps(rising, release));
+	return _mm_add_ps(in, _mm_mul_ps(gain, _mm_sub_ps(env, in)));
+}
+
+static inline float follow(float env, float in, float attack, float release)
+{
+	return in + (env < in ? attack : release) * (env - in);
+}
+
+/* Runs the follower for four channels at once, one per lane.  Every step
+ * needs the previous one, so the samples of four channels are transposed
+ * into lanes, followed, and transposed back before taking the maximum. */
+static void envelope_group(float *env, const float *in[GROUP_CHANNELS],
+			   size_t frames, float attack_gain,
+			   float release_gain, float start)
+{
+	const __m128 attack = _mm_set1_ps(attack_gain);
+	const __m128 release = _mm_set1_ps(release_gain);
+	__m128 state = _mm_set1_ps(start);
+	float tail_state[GROUP_CHANNELS];
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 s0 = _mm_loadu_ps(in[0] + i);
+		__m128 s1 = _mm_loadu_ps(in[1] + i);
+		__m128 s2 = _mm_loadu_ps(in[2] + i);
+		__m128 s3 = _mm_loadu_ps(in[3] + i);
+		_MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+
+		s0 = state = follow_ps(state, abs_ps(s0), attack, release);
+		s1 = state = follow_ps(state, abs_ps(s1), attack, release);
+		s2 = state = follow_ps(state, abs_ps(s2), attack, release);
+		s3 = state = follow_ps(state, abs_ps(s3), attack, release);
+		_MM_TRANSPOSE4_PS(s0, s1, s2, s3);
+
+		__m128 max = _mm_max_ps(_mm_max_ps(s0, s1), _mm_max_ps(s2, s3));
+		max = _mm_max_ps(max, _mm_loadu_ps(env + i));
+		_mm_storeu_ps(env + i, max);
+	}
+
+	if (i == frames)
+		return;
+
+	_mm_storeu_ps(tail_state, state);
+	for (size_t c = 0; c < GROUP_CHANNELS; c++) {
+		float e = tail_state[c];
+		for (size_t j = i; j < frames; j++) {
+			e = follow(e, fabsf(in[c][j]), attack_gain,
+				   release_gain);
+			env[j] = fmaxf(env[j], e);
+		}
+	}
+}
+
+void audio_dynamics_envelope(float *env, float *const *samples,
+			     size_t channels, size_t frames, float attack_gain,
+			     float release_gain, float *envelope)
+{
+	const float *group[GROUP_CHANNELS];
+	size_t count = 0;
+
+	if (!frames)
+		return;
+
+	memset(env, 0, frames * sizeof(*env));
+
+	for (size_t c = 0; c < channels; c++) {
+		if (!samples[c])
+			continue;
+
+		group[count++] = samples[c];
+		if (count == GROUP_CHANNELS) {
+			envelope_group(env, group, frames, attack_gain,
+				       release_gain, *envelope);
+			count = 0;
+		}
+	}
+
+	if (count) {
+		/* duplicated channels don't change the maximum */
+		for (size_t c = count; c < GROUP_CHANNELS; c++)
+			group[c] = group[0];
+		envelope_group(env, group, frames, attack_gain, release_gain,
+			       *envelope);
+	}
+
+	*envelope = env[frames - 1];
+}
+
+void audio_dynamics_peak(float *peak, float *const *samples, size_t channels,
+			 size_t frames)
+{
+	memset(peak, 0, frames * sizeof(*peak));
+
+	for (size_t c = 0; c < channels; c++) {
+		const float *in = samples[c];
+		size_t i = 0;
+
+		if (!in)
+			continue;
+
+		for (; i + 4 <= frames; i += 4) {
+			__m128 max = abs_ps(_mm_loadu_ps(in + i));
+			max = _mm_max_ps(max, _mm_loadu_ps(peak + i));
+			_mm_storeu_ps(peak + i, max);
+		}
+		for (; i < frames; i++)
+			peak[i] = fmaxf(peak[i], fabsf(in[i]));
+	}
+}
+
+void audio_dynamics_compressor_gain(float *gain, const float *env,
+				    size_t frames, float threshold_db,
+				    float slope, float output_gain)
+{
+	const __m128 db_per_log2 = _mm_set1_ps(FAST_DB_PER_LOG2);
+	const __m128 log2_per_db = _mm_set1_ps(FAST_LOG2_PER_DB);
+	const __m128 threshold = _mm_set1_ps(threshold_db);
+	const __m128 slope_ps = _mm_set1_ps(slope);
+	const __m128 output = _mm_set1_ps(output_gain);
+	const __m128 zero = _mm_setzero_ps();
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 db = _mm_mul_ps(log2_ps(_mm_loadu_ps(env + i)),
+				       db_per_log2);
+		db = _mm_mul_ps(slope_ps, _mm_sub_ps(threshold, db));
+		db = _mm_min_ps(db, zero);
+
+		const __m128 mul = exp2_ps(_mm_mul_ps(db, log2_per_db));
+		_mm_storeu_ps(gain + i, _mm_mul_ps(mul, output));
+	}
+	for (; i < frames; i++) {
+		const float db = fast_mul_to_db(env[i]);
+		const float gain_db = slope * (threshold_db - db);
+		gain[i] = fast_db_to_mul(fminf(gain_db, 0.0f)) * output_gain;
+	}
+}
+
+void audio_dynamics_to_db(float *db, const float *mul, size_t frames)
+{
+	const __m128 db_per_log2 = _mm_set1_ps(FAST_DB_PER_LOG2);
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		const __m128 val = log2_ps(_mm_loadu_ps(mul + i));
+		_mm_storeu_ps(db + i, _mm_mul_ps(val, db_per_log2));
+	}
+	for (; i < frames; i++)
+		db[i] = fast_mul_to_db(mul[i]);
+}
+
+void audio_dynamics_db_to_gain(float *gain, const float *db, size_t frames,
+			       float max_db, float output_gain)
+{
+	const __m128 log2_per_db = _mm_set1_ps(FAST_LOG2_PER_DB);
+	const __m128 max = _mm_set1_ps(max_db);
+	const __m128 output = _mm_set1_ps(output_gain);
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		const __m128 val = _mm_min_ps(_mm_loadu_ps(db + i), max);
+		const __m128 mul = exp2_ps(_mm_mul_ps(val, log2_per_db));
+		_mm_storeu_ps(gain + i, _mm_mul_ps(mul, output));
+	}
+	for (; i < frames; i++)
+		gain[i] = fast_db_to_mul(fminf(db[i], max_db)) * output_gain;
+}
+
+void audio_dynamics_apply_gain(float *const *samples, size_t channels,
+			       const float *gain, size_t frames)
+{
+	for (size_t c = 0; c < channels; c++) {
+		float *out = samples[c];
+		size_t i = 0;
+
+		if (!out)
+			continue;
+
+		for (; i + 4 <= frames; i += 4) {
+			const __m128 val = _mm_loadu_ps(out + i);
+			const __m128 g = _mm_loadu_ps(gain + i);
+			_mm_storeu_ps(out + i, _mm_mul_ps(val, g));
+		}
+		for (; i < frames; i++)
+			out[i] *= gain[i];
+	}
+}
@@ -0,0 +1,74 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <util/c99defs.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Block processing helpers for dynamics filters (compressor, limiter,
+ * expander, noise gate).  Work that doesn't depend on the previous sample is
+ * done four samples at a time, and the envelope follower runs four channels
+ * side by side.  dB conversions use the fast_mul_to_db/fast_db_to_mul
+ * approximations from audio-math.h.
+ *
+ * Channels that are NULL are skipped, and the output buffers may alias the
+ * input buffers of the same length.
+ */
+
+/**
+ * Peak envelope follower.  Every channel starts at *envelope and follows
+ * |x| with attack_gain when rising and release_gain when falling; env
+ * receives the maximum over all channels and *envelope is set to its last
+ * value.
+ */
+extern void audio_dynamics_envelope(float *env, float *const *samples,
+				    size_t channels, size_t frames,
+				    float attack_gain, float release_gain,
+				    float *envelope);
+
+/** Stores the maximum of |x| over all channels in peak */
+extern void audio_dynamics_peak(float *peak, float *const *samples,
+				size_t channels, size_t frames);
+
+/**
+ * Gain of a downward compressor for each envelope value:
+ * db_to_mul(min(0, slope * (threshold_db - mul_to_db(env)))) * output_gain
+ */
+extern void audio_dynamics_compressor_gain(float *gain, const float *env,
+					   size_t frames, float threshold_db,
+					   float slope, float output_gain);
+
+/** Converts linear values to dB */
+extern void audio_dynamics_to_db(float *db, const float *mul, size_t frames);
+
+/** gain = db_to_mul(min(db, max_db)) * output_gain */
+extern void audio_dynamics_db_to_gain(float *gain, const float *db,
+				      size_t frames, float max_db,
+				      float output_gain);
+
+/** Multiplies every channel by gain */
+extern void audio_dynamics_apply_gain(float *const *samples, size_t channels,
+				      const float *gain, size_t frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -63,7 +63,7 @@ else()
 
     target_include_directories(obs-rnnoise INTERFACE "${CMAKE_CURRENT_SOURCE_DIR}/rnnoise/include")
 
-    target_compile_definitions(obs-rnnoise INTERFACE COMPILE_OPUS)
+    target_compile_definitions(obs-rnnoise INTERFACE COMPILE_OPUS RNNOISE_BATCH_API)
 
     target_compile_options(obs-rnnoise INTERFACE "$<$<COMPILE_LANG_AND_ID:C,AppleClang,Clang>:-Wno-null-dereference>")
 
@@ -74,7 +74,7 @@ else()
     source_group("rnnoise" FILES ${_RNNOISE_SOURCES})
   endif()
 
-  target_sources(obs-filters PRIVATE noise-suppress-filter.c)
+  target_sources(obs-filters PRIVATE noise-suppress-filter.c rnnoise-worker.c rnnoise-worker.h)
 
   target_link_libraries(obs-filters PRIVATE Librnnoise::Librnnoise)
 
@@ -110,6 +110,10 @@ endif()
 target_sources(
   obs-filters
   PRIVATE obs-filters.c
+          audio-biquad.c
+          audio-biquad.h
+          audio-dynamics.c
+          audio-dynamics.h
           color-correction-filter.c
           async-delay-filter.c
           gpu-delay.c
@@ -122,6 +126,7 @@ target_sources(
           color-grade-filter.c
           sharpness-filter.c
           eq-filter.c
+          parametric-eq-filter.c
           gain-filter.c
           noise-gate-filter.c
           mask-filter.c
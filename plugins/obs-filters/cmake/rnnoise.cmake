@@ -32,11 +32,12 @@ if(ENABLE_RNNOISE)
 
     target_include_directories(obs-rnnoise INTERFACE "${CMAKE_CURRENT_SOURCE_DIR}/rnnoise/include")
 
-    target_compile_definitions(obs-rnnoise INTERFACE COMPILE_OPUS)
+    target_compile_definitions(obs-rnnoise INTERFACE COMPILE_OPUS RNNOISE_BATCH_API)
 
     set_target_properties(obs-rnnoise PROPERTIES FOLDER plugins/obs-filters/rnnoise)
   endif()
 
+  target_sources(obs-filters PRIVATE rnnoise-worker.c rnnoise-worker.h)
   target_compile_definitions(obs-filters PRIVATE LIBRNNOISE_ENABLED)
 
   target_link_libraries(obs-filters PRIVATE Librnnoise::Librnnoise)
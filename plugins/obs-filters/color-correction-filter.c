@@ -638,6 +638,44 @@ static void color_correction_filter_render_v2(void *data, gs_effect_t *effect)
 	}
 }
 
+/*
+ * The same as PSColorFilterRGBA in the effect file, as a function libobs can
+ * fuse with the per-pixel filters next to this one into a single pass.
+ */
+static const char *color_correction_pixel_shader =
+	"uniform float PIXEL_gamma;\n"
+	"uniform float4x4 PIXEL_color_matrix;\n"
+	"\n"
+	"float4 PIXEL_filter(float4 rgba)\n"
+	"{\n"
+	"\trgba.rgb = max(float3(0.0, 0.0, 0.0), rgba.rgb / rgba.a);\n"
+	"\trgba.rgb = pow(rgba.rgb,\n"
+	"\t\t       float3(PIXEL_gamma, PIXEL_gamma, PIXEL_gamma));\n"
+	"\trgba = mul(PIXEL_color_matrix, rgba);\n"
+	"\trgba.rgb *= rgba.a;\n"
+	"\treturn rgba;\n"
+	"}\n";
+
+static const char *color_correction_filter_pixel_shader_v2(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return color_correction_pixel_shader;
+}
+
+static void color_correction_filter_pixel_params_v2(void *data,
+						    gs_effect_t *effect,
+						    const char *prefix)
+{
+	struct color_correction_filter_data_v2 *filter = data;
+
+	gs_effect_set_float(
+		obs_filter_get_pixel_param(effect, prefix, SETTING_GAMMA),
+		filter->gamma);
+	gs_effect_set_matrix4(
+		obs_filter_get_pixel_param(effect, prefix, "color_matrix"),
+		&filter->final_matrix);
+}
+
 /*
  * This function sets the interface. the types (add_*_Slider), the type of
  * data collected (int), the internal name, user-facing name, minimum,
@@ -760,7 +798,8 @@ static enum gs_color_space color_correction_filter_get_color_space(
 struct obs_source_info color_filter = {
 	.id = "color_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = color_correction_filter_name,
 	.create = color_correction_filter_create_v1,
 	.destroy = color_correction_filter_destroy_v1,
@@ -774,7 +813,8 @@ struct obs_source_info color_filter_v2 = {
 	.id = "color_filter",
 	.version = 2,
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = color_correction_filter_name,
 	.create = color_correction_filter_create_v2,
 	.destroy = color_correction_filter_destroy_v2,
@@ -783,4 +823,6 @@ struct obs_source_info color_filter_v2 = {
 	.get_properties = color_correction_filter_properties_v2,
 	.get_defaults = color_correction_filter_defaults_v2,
 	.video_get_color_space = color_correction_filter_get_color_space,
+	.get_pixel_shader = color_correction_filter_pixel_shader_v2,
+	.set_pixel_params = color_correction_filter_pixel_params_v2,
 };
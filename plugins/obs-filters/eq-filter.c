@@ -2,34 +2,33 @@
 #include <util/circlebuf.h>
 #include <util/darray.h>
 #include <obs-module.h>
+#include "audio-biquad.h"
 
 #include <math.h>
 
 #define LOW_FREQ 800.0f
 #define HIGH_FREQ 5000.0f
 
-struct eq_channel_state {
-	float lf_delay0;
-	float lf_delay1;
-	float lf_delay2;
-	float lf_delay3;
-
-	float hf_delay0;
-	float hf_delay1;
-	float hf_delay2;
-	float hf_delay3;
-
-	float sample_delay1;
-	float sample_delay2;
-	float sample_delay3;
-};
+/* the high band is taken from the input delayed by this many samples */
+#define HIGH_DELAY 3
 
+/*
+ * The bands are split with two fourth order lowpass filters, each made of
+ * four one-pole sections that are run as two biquads.  Both crossovers of
+ * every channel are lanes of the same biquad bank, so stereo fills one
+ * group of four SIMD lanes.
+ */
 struct eq_data {
 	obs_source_t *context;
 	size_t channels;
-	struct eq_channel_state eqs[MAX_AUDIO_CHANNELS];
-	float lf;
-	float hf;
+
+	struct audio_biquad_bank bank;
+	float *lf_out[MAX_AUDIO_CHANNELS];
+	float *hf_out[MAX_AUDIO_CHANNELS];
+	size_t buf_frames;
+
+	float history[MAX_AUDIO_CHANNELS][HIGH_DELAY];
+
 	float low_gain;
 	float mid_gain;
 	float high_gain;
@@ -76,15 +75,38 @@ static obs_properties_t *eq_properties(void *unused)
 	return props;
 }
 
+/* two cascaded one-pole lowpasses, y += k * (x - y), as one biquad */
+static void one_pole_pair(struct audio_biquad *biquad, float k)
+{
+	const float pole = 1.0f - k;
+
+	biquad->b0 = k * k;
+	biquad->b1 = 0.0f;
+	biquad->b2 = 0.0f;
+	biquad->a1 = -2.0f * pole;
+	biquad->a2 = pole * pole;
+}
+
 static void *eq_create(obs_data_t *settings, obs_source_t *filter)
 {
 	struct eq_data *eq = bzalloc(sizeof(*eq));
+	struct audio_biquad lf, hf;
+
 	eq->channels = audio_output_get_channels(obs_get_audio());
 	eq->context = filter;
 
 	float freq = (float)audio_output_get_sample_rate(obs_get_audio());
-	eq->lf = 2.0f * sinf(M_PI * LOW_FREQ / freq);
-	eq->hf = 2.0f * sinf(M_PI * HIGH_FREQ / freq);
+	one_pole_pair(&lf, 2.0f * sinf(M_PI * LOW_FREQ / freq));
+	one_pole_pair(&hf, 2.0f * sinf(M_PI * HIGH_FREQ / freq));
+
+	audio_biquad_bank_init(&eq->bank, eq->channels * 2, 2);
+	for (size_t c = 0; c < eq->channels; c++) {
+		for (size_t s = 0; s < 2; s++) {
+			audio_biquad_bank_set(&eq->bank, c, s, &lf);
+			audio_biquad_bank_set(&eq->bank, eq->channels + c, s,
+					      &hf);
+		}
+	}
 
 	eq_update(eq, settings);
 	return eq;
@@ -93,40 +115,53 @@ static void *eq_create(obs_data_t *settings, obs_source_t *filter)
 static void eq_destroy(void *data)
 {
 	struct eq_data *eq = data;
+
+	for (size_t c = 0; c < eq->channels; c++) {
+		bfree(eq->lf_out[c]);
+		bfree(eq->hf_out[c]);
+	}
 	bfree(eq);
 }
 
-#define EQ_EPSILON (1.0f / 4294967295.0f)
-
-static inline float eq_process(struct eq_data *eq, struct eq_channel_state *c,
-			       float sample)
+static void resize_buffers(struct eq_data *eq, size_t frames)
 {
-	float l, m, h;
-
-	c->lf_delay0 += eq->lf * (sample - c->lf_delay0) + EQ_EPSILON;
-	c->lf_delay1 += eq->lf * (c->lf_delay0 - c->lf_delay1);
-	c->lf_delay2 += eq->lf * (c->lf_delay1 - c->lf_delay2);
-	c->lf_delay3 += eq->lf * (c->lf_delay2 - c->lf_delay3);
-
-	l = c->lf_delay3;
+	eq->buf_frames = frames;
 
-	c->hf_delay0 += eq->hf * (sample - c->hf_delay0) + EQ_EPSILON;
-	c->hf_delay1 += eq->hf * (c->hf_delay0 - c->hf_delay1);
-	c->hf_delay2 += eq->hf * (c->hf_delay1 - c->hf_delay2);
-	c->hf_delay3 += eq->hf * (c->hf_delay2 - c->hf_delay3);
-
-	h = c->sample_delay3 - c->hf_delay3;
-	m = c->sample_delay3 - (h + l);
+	for (size_t c = 0; c < eq->channels; c++) {
+		eq->lf_out[c] = brealloc(eq->lf_out[c], frames * sizeof(float));
+		eq->hf_out[c] = brealloc(eq->hf_out[c], frames * sizeof(float));
+	}
+}
 
-	l *= eq->low_gain;
-	m *= eq->mid_gain;
-	h *= eq->high_gain;
+/* low, mid and high are l, h - l and x[n - HIGH_DELAY] - h for the
+ * crossover outputs l and h.  The output overwrites the input, so samples
+ * are mixed from the back to keep the delayed ones intact. */
+static void eq_mix(struct eq_data *eq, size_t c, float *adata, size_t frames)
+{
+	const float *l = eq->lf_out[c];
+	const float *h = eq->hf_out[c];
+	float *history = eq->history[c];
+	float delayed[HIGH_DELAY];
+
+	memcpy(delayed, history, sizeof(delayed));
+	if (frames >= HIGH_DELAY) {
+		memcpy(history, adata + frames - HIGH_DELAY, sizeof(delayed));
+	} else {
+		memmove(history, history + frames,
+			(HIGH_DELAY - frames) * sizeof(float));
+		memcpy(history + HIGH_DELAY - frames, adata,
+		       frames * sizeof(float));
+	}
 
-	c->sample_delay3 = c->sample_delay2;
-	c->sample_delay2 = c->sample_delay1;
-	c->sample_delay1 = sample;
+	for (size_t i = frames; i > 0; i--) {
+		const size_t n = i - 1;
+		const float x = n >= HIGH_DELAY ? adata[n - HIGH_DELAY]
+						: delayed[n];
 
-	return l + m + h;
+		adata[n] = l[n] * eq->low_gain +
+			   (h[n] - l[n]) * eq->mid_gain +
+			   (x - h[n]) * eq->high_gain;
+	}
 }
 
 static struct obs_audio_data *eq_filter_audio(void *data,
@@ -134,16 +169,23 @@ static struct obs_audio_data *eq_filter_audio(void *data,
 {
 	struct eq_data *eq = data;
 	const uint32_t frames = audio->frames;
+	const float *in[AUDIO_BIQUAD_MAX_LANES];
+	float *out[AUDIO_BIQUAD_MAX_LANES];
 
-	for (size_t c = 0; c < eq->channels; c++) {
-		float *adata = (float *)audio->data[c];
-		struct eq_channel_state *channel = &eq->eqs[c];
+	if (frames > eq->buf_frames)
+		resize_buffers(eq, frames);
 
-		for (size_t i = 0; i < frames; i++) {
-			adata[i] = eq_process(eq, channel, adata[i]);
-		}
+	for (size_t c = 0; c < eq->channels; c++) {
+		in[c] = in[eq->channels + c] = (const float *)audio->data[c];
+		out[c] = eq->lf_out[c];
+		out[eq->channels + c] = eq->hf_out[c];
 	}
 
+	audio_biquad_bank_process(&eq->bank, out, in, frames);
+
+	for (size_t c = 0; c < eq->channels; c++)
+		eq_mix(eq, c, (float *)audio->data[c], frames);
+
 	return audio;
 }
 
@@ -1,12 +1,14 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include <math.h>
+#include <float.h>
 
 #include <obs-module.h>
 #include <media-io/audio-math.h>
 #include <util/platform.h>
 #include <util/circlebuf.h>
 #include <util/threading.h>
+#include "audio-dynamics.h"
 
 /* -------------------------------------------------------- */
 
@@ -289,6 +291,11 @@ static void expander_destroy(void *data)
 }
 
 // detection stage
+static inline float square(float x)
+{
+	return x * x;
+}
+
 static void analyze_envelope(struct expander_data *cd, float **samples,
 			     const uint32_t num_samples)
 {
@@ -321,18 +328,17 @@ static void analyze_envelope(struct expander_data *cd, float **samples,
 		if (cd->detector == RMS_DETECT) {
 			runave[0] =
 				rmscoef * cd->runave[chan] +
-				(1 - rmscoef) * powf(samples[chan][0], 2.0f);
+				(1 - rmscoef) * square(samples[chan][0]);
 			env_in[0] = sqrtf(fmaxf(runave[0], 0));
 			for (uint32_t i = 1; i < num_samples; ++i) {
-				runave[i] =
-					rmscoef * runave[i - 1] +
-					(1 - rmscoef) *
-						powf(samples[chan][i], 2.0f);
+				runave[i] = rmscoef * runave[i - 1] +
+					    (1 - rmscoef) *
+						    square(samples[chan][i]);
 				env_in[i] = sqrtf(runave[i]);
 			}
 		} else if (cd->detector == PEAK_DETECT) {
 			for (uint32_t i = 0; i < num_samples; ++i) {
-				runave[i] = powf(samples[chan][i], 2);
+				runave[i] = square(samples[chan][i]);
 				env_in[i] = fabsf(samples[chan][i]);
 			}
 		}
@@ -344,18 +350,17 @@ static void analyze_envelope(struct expander_data *cd, float **samples,
 	}
 }
 
-static inline void process_sample(size_t idx, float *samples, float *env_buf,
+static inline void process_sample(size_t idx, const float *env_db_buf,
 				  float *gain_db, bool is_upwcomp,
 				  float channel_gain, float threshold,
 				  float slope, float attack_gain,
 				  float inv_attack_gain, float release_gain,
-				  float inv_release_gain, float output_gain,
-				  float knee)
+				  float inv_release_gain, float knee)
 {
 	/* --------------------------------- */
 	/* gain stage of expansion           */
 
-	float env_db = mul_to_db(env_buf[idx]);
+	float env_db = env_db_buf[idx];
 	float diff = threshold - env_db;
 
 	if (is_upwcomp && env_db <= (threshold - 60.0f) / 2)
@@ -377,7 +382,7 @@ static inline void process_sample(size_t idx, float *samples, float *env_buf,
 		// gain in knee:
 		if (env_db > threshold - knee / 2 &&
 		    threshold + knee / 2 > env_db)
-			gain = slope * powf(diff + knee / 2, 2) / (2.0f * knee);
+			gain = slope * square(diff + knee / 2) / (2.0f * knee);
 	} else {
 		prev_gain = idx > 0 ? gain_db[idx - 1] : channel_gain;
 		gain = diff > 0.0f ? fmaxf(slope * diff, -60.0f) : 0.0f;
@@ -391,17 +396,6 @@ static inline void process_sample(size_t idx, float *samples, float *env_buf,
 	else
 		gain_db[idx] =
 			release_gain * prev_gain + inv_release_gain * gain;
-
-	/* --------------------------------- */
-	/* output                            */
-
-	if (!is_upwcomp) {
-		gain = db_to_mul(fminf(0, gain_db[idx]));
-	} else {
-		gain = db_to_mul(gain_db[idx]);
-	}
-
-	samples[idx] *= gain * output_gain;
 }
 
 // gain stage and ballistics in dB domain
@@ -417,6 +411,7 @@ static inline void process_expansion(struct expander_data *cd, float **samples,
 	const float output_gain = cd->output_gain;
 	const bool is_upwcomp = cd->is_upwcomp;
 	const float knee = cd->knee;
+	const float max_gain_db = is_upwcomp ? FLT_MAX : 0.0f;
 
 	if (cd->gain_db_len < num_samples)
 		resize_gain_db_buffer(cd, num_samples);
@@ -425,20 +420,30 @@ static inline void process_expansion(struct expander_data *cd, float **samples,
 		memset(cd->gain_db[i], 0,
 		       num_samples * sizeof(cd->gain_db[i][0]));
 
+	/* env_in isn't needed after the analysis, it holds the envelope in
+	 * dB and then the linear gain of each channel */
+	float *scratch = cd->env_in;
+
 	for (size_t chan = 0; chan < cd->num_channels; chan++) {
 		float *channel_samples = samples[chan];
 		float *env_buf = cd->envelope_buf[chan];
 		float *gain_db = cd->gain_db[chan];
 		float channel_gain = cd->gain_db_buf[chan];
 
+		audio_dynamics_to_db(scratch, env_buf, num_samples);
+
 		for (size_t i = 0; i < num_samples; ++i) {
-			process_sample(i, channel_samples, env_buf, gain_db,
-				       is_upwcomp, channel_gain, threshold,
-				       slope, attack_gain, inv_attack_gain,
-				       release_gain, inv_release_gain,
-				       output_gain, knee);
+			process_sample(i, scratch, gain_db, is_upwcomp,
+				       channel_gain, threshold, slope,
+				       attack_gain, inv_attack_gain,
+				       release_gain, inv_release_gain, knee);
 		}
 		cd->gain_db_buf[chan] = gain_db[num_samples - 1];
+
+		audio_dynamics_db_to_gain(scratch, gain_db, num_samples,
+					  max_gain_db, output_gain);
+		audio_dynamics_apply_gain(&channel_samples, 1, scratch,
+					  num_samples);
 	}
 }
 
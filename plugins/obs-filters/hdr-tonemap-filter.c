@@ -234,7 +234,8 @@ hdr_tonemap_filter_get_color_space(void *data, size_t count,
 struct obs_source_info hdr_tonemap_filter = {
 	.id = "hdr_tonemap_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = hdr_tonemap_filter_get_name,
 	.create = hdr_tonemap_filter_create,
 	.destroy = hdr_tonemap_filter_destroy,
@@ -177,6 +177,57 @@ static void luma_key_render_v2(void *data, gs_effect_t *effect)
 	luma_key_render_internal(data, true);
 }
 
+/* PSALumaKeyRGBA of luma_key_filter_v2.effect as a function, which lets
+ * libobs fuse the filter with the per-pixel filters next to it */
+static const char *luma_key_pixel_shader =
+	"uniform float PIXEL_lumaMax;\n"
+	"uniform float PIXEL_lumaMin;\n"
+	"uniform float PIXEL_lumaMaxSmooth;\n"
+	"uniform float PIXEL_lumaMinSmooth;\n"
+	"\n"
+	"float4 PIXEL_filter(float4 rgba)\n"
+	"{\n"
+	"\trgba.rgb = max(float3(0.0, 0.0, 0.0), rgba.rgb / rgba.a);\n"
+	"\n"
+	"\tfloat3 lumaCoef = float3(0.2126, 0.7152, 0.0722);\n"
+	"\tfloat luminance = dot(rgba.rgb, lumaCoef);\n"
+	"\n"
+	"\tfloat clo = smoothstep(PIXEL_lumaMin,\n"
+	"\t\t\t       PIXEL_lumaMin + PIXEL_lumaMinSmooth,\n"
+	"\t\t\t       luminance);\n"
+	"\tfloat chi = 1. - smoothstep(PIXEL_lumaMax - PIXEL_lumaMaxSmooth,\n"
+	"\t\t\t\t    PIXEL_lumaMax, luminance);\n"
+	"\n"
+	"\trgba.a *= clo * chi;\n"
+	"\trgba.rgb *= rgba.a;\n"
+	"\treturn rgba;\n"
+	"}\n";
+
+static const char *luma_key_pixel_shader_v2(void *data)
+{
+	UNUSED_PARAMETER(data);
+	return luma_key_pixel_shader;
+}
+
+static void luma_key_pixel_params_v2(void *data, gs_effect_t *effect,
+				     const char *prefix)
+{
+	struct luma_key_filter_data *filter = data;
+
+	gs_effect_set_float(
+		obs_filter_get_pixel_param(effect, prefix, "lumaMax"),
+		filter->luma_max);
+	gs_effect_set_float(
+		obs_filter_get_pixel_param(effect, prefix, "lumaMin"),
+		filter->luma_min);
+	gs_effect_set_float(
+		obs_filter_get_pixel_param(effect, prefix, "lumaMaxSmooth"),
+		filter->luma_max_smooth);
+	gs_effect_set_float(
+		obs_filter_get_pixel_param(effect, prefix, "lumaMinSmooth"),
+		filter->luma_min_smooth);
+}
+
 static obs_properties_t *luma_key_properties(void *data)
 {
 	obs_properties_t *props = obs_properties_create();
@@ -228,7 +279,8 @@ luma_key_get_color_space(void *data, size_t count,
 struct obs_source_info luma_key_filter = {
 	.id = "luma_key_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = luma_key_name,
 	.create = luma_key_create_v1,
 	.destroy = luma_key_destroy,
@@ -242,7 +294,8 @@ struct obs_source_info luma_key_filter_v2 = {
 	.id = "luma_key_filter",
 	.version = 2,
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = luma_key_name,
 	.create = luma_key_create_v2,
 	.destroy = luma_key_destroy,
@@ -251,4 +304,6 @@ struct obs_source_info luma_key_filter_v2 = {
 	.get_properties = luma_key_properties,
 	.get_defaults = luma_key_defaults,
 	.video_get_color_space = luma_key_get_color_space,
+	.get_pixel_shader = luma_key_pixel_shader_v2,
+	.set_pixel_params = luma_key_pixel_params_v2,
 };
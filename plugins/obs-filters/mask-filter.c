@@ -80,6 +80,7 @@ static void mask_filter_image_load(struct mask_filter_data *filter)
 	}
 
 	filter->target = filter->image.texture;
+	obs_source_content_changed(filter->context);
 }
 
 static void mask_filter_update_internal(void *data, obs_data_t *settings,
@@ -257,8 +258,10 @@ static void mask_filter_tick(void *data, float seconds)
 		if (!filter->last_time)
 			filter->last_time = cur_time;
 
-		gs_image_file_tick(&filter->image,
-				   cur_time - filter->last_time);
+		if (gs_image_file_tick(&filter->image,
+				       cur_time - filter->last_time))
+			obs_source_content_changed(filter->context);
+
 		obs_enter_graphics();
 		gs_image_file_update_texture(&filter->image);
 		obs_leave_graphics();
@@ -384,7 +387,8 @@ mask_filter_get_color_space(void *data, size_t count,
 struct obs_source_info mask_filter = {
 	.id = "mask_filter",
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CAP_OBSOLETE |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = mask_filter_get_name,
 	.create = mask_filter_create,
 	.destroy = mask_filter_destroy,
@@ -399,7 +403,8 @@ struct obs_source_info mask_filter_v2 = {
 	.id = "mask_filter",
 	.version = 2,
 	.type = OBS_SOURCE_TYPE_FILTER,
-	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB,
+	.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_SRGB |
+			OBS_SOURCE_STATIC_CONTENT,
 	.get_name = mask_filter_get_name,
 	.create = mask_filter_create,
 	.destroy = mask_filter_destroy,
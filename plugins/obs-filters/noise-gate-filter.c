@@ -1,6 +1,7 @@
 #include <media-io/audio-math.h>
 #include <obs-module.h>
 #include <math.h>
+#include "audio-dynamics.h"
 
 #define do_log(level, format, ...)                \
 	blog(level, "[noise gate: '%s'] " format, \
@@ -43,6 +44,9 @@ struct noise_gate_data {
 	float attenuation;
 	float level;
 	float held_time;
+
+	float *level_buf;
+	size_t level_buf_len;
 };
 
 #define VOL_MIN -96.0
@@ -57,6 +61,7 @@ static const char *noise_gate_name(void *unused)
 static void noise_gate_destroy(void *data)
 {
 	struct noise_gate_data *ng = data;
+	bfree(ng->level_buf);
 	bfree(ng);
 }
 
@@ -122,12 +127,19 @@ noise_gate_filter_audio(void *data, struct obs_audio_data *audio)
 	const float decay_rate = ng->decay_rate;
 	const float hold_time = ng->hold_time;
 	const size_t channels = ng->channels;
+	const size_t frames = audio->frames;
 
-	for (size_t i = 0; i < audio->frames; i++) {
-		float cur_level = fabsf(adata[0][i]);
-		for (size_t j = 0; j < channels; j++) {
-			cur_level = fmaxf(cur_level, fabsf(adata[j][i]));
-		}
+	if (ng->level_buf_len < frames) {
+		ng->level_buf_len = frames;
+		ng->level_buf = brealloc(ng->level_buf, frames * sizeof(float));
+	}
+
+	/* the attenuation of each sample replaces its level */
+	float *levels = ng->level_buf;
+	audio_dynamics_peak(levels, adata, channels, frames);
+
+	for (size_t i = 0; i < frames; i++) {
+		const float cur_level = levels[i];
 
 		if (cur_level > open_threshold && !ng->is_open) {
 			ng->is_open = true;
@@ -150,10 +162,10 @@ noise_gate_filter_audio(void *data, struct obs_audio_data *audio)
 			}
 		}
 
-		for (size_t c = 0; c < channels; c++)
-			adata[c][i] *= ng->attenuation;
+		levels[i] = ng->attenuation;
 	}
 
+	audio_dynamics_apply_gain(adata, channels, levels, frames);
 	return audio;
 }
 
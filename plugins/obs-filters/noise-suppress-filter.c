@@ -15,6 +15,7 @@
 #endif
 #include <rnnoise.h>
 #include <media-io/audio-resampler.h>
+#include "rnnoise-worker.h"
 #endif
 
 bool nvafx_loaded = false;
@@ -68,6 +69,9 @@ bool nvafx_loaded = false;
 #define RNNOISE_SAMPLE_RATE 48000
 #define RNNOISE_FRAME_SIZE 480
 
+/* Frames that can be queued on the RNNoise worker before the filter waits */
+#define RNNOISE_MAX_JOBS 8
+
 /* nvafx constants, these can't be changed */
 #define NVAFX_SAMPLE_RATE 48000
 #define NVAFX_FRAME_SIZE \
@@ -109,6 +113,13 @@ struct noise_suppress_data {
 	/* Resampler */
 	audio_resampler_t *rnn_resampler;
 	audio_resampler_t *rnn_resampler_back;
+
+	/* Frames queued on the worker, oldest first */
+	struct rnnoise_job rnn_jobs[RNNOISE_MAX_JOBS];
+	size_t rnn_first_job;
+	size_t rnn_pending_jobs;
+	os_event_t *rnn_event;
+	bool rnn_worker;
 #endif
 
 #ifdef LIBNVAFX_ENABLED
@@ -138,7 +149,7 @@ struct noise_suppress_data {
 	spx_int16_t *spx_segment_buffers[MAX_PREPROC_CHANNELS];
 #endif
 #ifdef LIBRNNOISE_ENABLED
-	float *rnn_segment_buffers[MAX_PREPROC_CHANNELS];
+	float *rnn_job_buffer;
 #endif
 #ifdef LIBNVAFX_ENABLED
 	float *nvafx_segment_buffers[MAX_PREPROC_CHANNELS];
@@ -173,10 +184,15 @@ static const char *noise_suppress_name(void *unused)
 	return obs_module_text("NoiseSuppress");
 }
 
+static void collect_rnnoise(struct noise_suppress_data *ng,
+			    size_t max_pending, bool discard);
+
 static void noise_suppress_destroy(void *data)
 {
 	struct noise_suppress_data *ng = data;
 
+	collect_rnnoise(ng, 0, true);
+
 #ifdef LIBNVAFX_ENABLED
 	if (ng->nvafx_enabled)
 		pthread_mutex_lock(&ng->nvafx_mutex);
@@ -205,7 +221,11 @@ static void noise_suppress_destroy(void *data)
 	bfree(ng->spx_segment_buffers[0]);
 #endif
 #ifdef LIBRNNOISE_ENABLED
-	bfree(ng->rnn_segment_buffers[0]);
+	bfree(ng->rnn_job_buffer);
+	if (ng->rnn_worker)
+		rnnoise_worker_release();
+	if (ng->rnn_event)
+		os_event_destroy(ng->rnn_event);
 
 	if (ng->rnn_resampler) {
 		audio_resampler_destroy(ng->rnn_resampler);
@@ -429,6 +449,51 @@ static inline enum speaker_layout convert_speaker_layout(uint8_t channels)
 		return SPEAKERS_UNKNOWN;
 	}
 }
+
+/* Sets up the frames queued on the worker, after the channels' states */
+static void alloc_rnnoise(struct noise_suppress_data *ng, uint32_t sample_rate)
+{
+#ifdef LIBRNNOISE_ENABLED
+	size_t channels = ng->channels;
+
+	ng->rnn_job_buffer = bmalloc(RNNOISE_MAX_JOBS * RNNOISE_FRAME_SIZE *
+				     channels * sizeof(float));
+
+	for (size_t i = 0; i < RNNOISE_MAX_JOBS; i++) {
+		struct rnnoise_job *job = &ng->rnn_jobs[i];
+		float *frames = ng->rnn_job_buffer +
+				i * channels * RNNOISE_FRAME_SIZE;
+
+		job->owner = ng;
+		job->channels = channels;
+		for (size_t c = 0; c < channels; c++) {
+			job->states[c] = ng->rnn_states[c];
+			job->frames[c] = frames + c * RNNOISE_FRAME_SIZE;
+		}
+	}
+
+	if (sample_rate == RNNOISE_SAMPLE_RATE) {
+		ng->rnn_resampler = NULL;
+		ng->rnn_resampler_back = NULL;
+	} else {
+		struct resample_info src, dst;
+		src.samples_per_sec = sample_rate;
+		src.format = AUDIO_FORMAT_FLOAT_PLANAR;
+		src.speakers = convert_speaker_layout((uint8_t)channels);
+
+		dst.samples_per_sec = RNNOISE_SAMPLE_RATE;
+		dst.format = AUDIO_FORMAT_FLOAT_PLANAR;
+		dst.speakers = convert_speaker_layout((uint8_t)channels);
+
+		ng->rnn_resampler = audio_resampler_create(&dst, &src);
+		ng->rnn_resampler_back = audio_resampler_create(&src, &dst);
+	}
+#else
+	UNUSED_PARAMETER(ng);
+	UNUSED_PARAMETER(sample_rate);
+#endif
+}
+
 #ifdef LIBNVAFX_ENABLED
 static void set_model(void *data, const char *method)
 {
@@ -546,10 +611,6 @@ static void noise_suppress_update(void *data, obs_data_t *s)
 	ng->spx_segment_buffers[0] =
 		bmalloc(frames * channels * sizeof(spx_int16_t));
 #endif
-#ifdef LIBRNNOISE_ENABLED
-	ng->rnn_segment_buffers[0] =
-		bmalloc(RNNOISE_FRAME_SIZE * channels * sizeof(float));
-#endif
 #ifdef LIBNVAFX_ENABLED
 	ng->nvafx_segment_buffers[0] =
 		bmalloc(NVAFX_FRAME_SIZE * channels * sizeof(float));
@@ -560,10 +621,6 @@ static void noise_suppress_update(void *data, obs_data_t *s)
 		ng->spx_segment_buffers[c] =
 			ng->spx_segment_buffers[c - 1] + frames;
 #endif
-#ifdef LIBRNNOISE_ENABLED
-		ng->rnn_segment_buffers[c] =
-			ng->rnn_segment_buffers[c - 1] + RNNOISE_FRAME_SIZE;
-#endif
 #ifdef LIBNVAFX_ENABLED
 		ng->nvafx_segment_buffers[c] =
 			ng->nvafx_segment_buffers[c - 1] + NVAFX_FRAME_SIZE;
@@ -580,24 +637,8 @@ static void noise_suppress_update(void *data, obs_data_t *s)
 	for (size_t i = 0; i < channels; i++)
 		alloc_channel(ng, sample_rate, i, frames);
 
-#ifdef LIBRNNOISE_ENABLED
-	if (sample_rate == RNNOISE_SAMPLE_RATE) {
-		ng->rnn_resampler = NULL;
-		ng->rnn_resampler_back = NULL;
-	} else {
-		struct resample_info src, dst;
-		src.samples_per_sec = sample_rate;
-		src.format = AUDIO_FORMAT_FLOAT_PLANAR;
-		src.speakers = convert_speaker_layout((uint8_t)channels);
-
-		dst.samples_per_sec = RNNOISE_SAMPLE_RATE;
-		dst.format = AUDIO_FORMAT_FLOAT_PLANAR;
-		dst.speakers = convert_speaker_layout((uint8_t)channels);
+	alloc_rnnoise(ng, sample_rate);
 
-		ng->rnn_resampler = audio_resampler_create(&dst, &src);
-		ng->rnn_resampler_back = audio_resampler_create(&src, &dst);
-	}
-#endif
 #ifdef LIBNVAFX_ENABLED
 	if (sample_rate == NVAFX_SAMPLE_RATE) {
 		ng->nvafx_resampler = NULL;
@@ -829,9 +870,26 @@ static inline void process_speexdsp(struct noise_suppress_data *ng)
 #endif
 }
 
-static inline void process_rnnoise(struct noise_suppress_data *ng)
+/* Queues the frame in copy_buffers on the worker, its output is pushed by
+ * collect_rnnoise once it has been processed */
+static inline bool submit_rnnoise(struct noise_suppress_data *ng)
 {
 #ifdef LIBRNNOISE_ENABLED
+	struct rnnoise_job *job;
+
+	if (!ng->rnn_worker) {
+		os_event_init(&ng->rnn_event, OS_EVENT_TYPE_AUTO);
+		rnnoise_worker_acquire();
+		ng->rnn_worker = true;
+	}
+
+	if (ng->rnn_pending_jobs == RNNOISE_MAX_JOBS)
+		collect_rnnoise(ng, RNNOISE_MAX_JOBS - 1, false);
+
+	job = &ng->rnn_jobs[(ng->rnn_first_job + ng->rnn_pending_jobs) %
+			    RNNOISE_MAX_JOBS];
+	job->event = ng->rnn_event;
+
 	/* Adjust signal level to what RNNoise expects, resample if necessary */
 	if (ng->rnn_resampler) {
 		float *output[MAX_PREPROC_CHANNELS];
@@ -847,29 +905,36 @@ static inline void process_rnnoise(struct noise_suppress_data *ng)
 						RNNOISE_FRAME_SIZE;
 			     j < RNNOISE_FRAME_SIZE; ++j, ++k) {
 				if (k >= 0) {
-					ng->rnn_segment_buffers[i][j] =
+					job->frames[i][j] =
 						output[i][k] * 32768.0f;
 				} else {
-					ng->rnn_segment_buffers[i][j] = 0;
+					job->frames[i][j] = 0;
 				}
 			}
 		}
 	} else {
 		for (size_t i = 0; i < ng->channels; i++) {
 			for (size_t j = 0; j < RNNOISE_FRAME_SIZE; ++j) {
-				ng->rnn_segment_buffers[i][j] =
+				job->frames[i][j] =
 					ng->copy_buffers[i][j] * 32768.0f;
 			}
 		}
 	}
 
 	/* Execute */
-	for (size_t i = 0; i < ng->channels; i++) {
-		rnnoise_process_frame(ng->rnn_states[i],
-				      ng->rnn_segment_buffers[i],
-				      ng->rnn_segment_buffers[i]);
-	}
+	ng->rnn_pending_jobs++;
+	rnnoise_worker_submit(job);
+	return true;
+#else
+	UNUSED_PARAMETER(ng);
+	return false;
+#endif
+}
 
+#ifdef LIBRNNOISE_ENABLED
+static void output_rnnoise(struct noise_suppress_data *ng,
+			   struct rnnoise_job *job)
+{
 	/* Revert signal level adjustment, resample back if necessary */
 	if (ng->rnn_resampler) {
 		float *output[MAX_PREPROC_CHANNELS];
@@ -877,7 +942,7 @@ static inline void process_rnnoise(struct noise_suppress_data *ng)
 		uint64_t ts_offset;
 		audio_resampler_resample(
 			ng->rnn_resampler_back, (uint8_t **)output, &out_frames,
-			&ts_offset, (const uint8_t **)ng->rnn_segment_buffers,
+			&ts_offset, (const uint8_t **)job->frames,
 			RNNOISE_FRAME_SIZE);
 
 		for (size_t i = 0; i < ng->channels; i++) {
@@ -896,13 +961,69 @@ static inline void process_rnnoise(struct noise_suppress_data *ng)
 		for (size_t i = 0; i < ng->channels; i++) {
 			for (size_t j = 0; j < RNNOISE_FRAME_SIZE; ++j) {
 				ng->copy_buffers[i][j] =
-					ng->rnn_segment_buffers[i][j] /
-					32768.0f;
+					job->frames[i][j] / 32768.0f;
 			}
 		}
 	}
+
+	/* Push to output circlebuf */
+	for (size_t i = 0; i < ng->channels; i++)
+		circlebuf_push_back(&ng->output_buffers[i], ng->copy_buffers[i],
+				    ng->frames * sizeof(float));
+}
+#endif
+
+/* Outputs the processed frames in order, waiting for the worker until no
+ * more than max_pending are left */
+static void collect_rnnoise(struct noise_suppress_data *ng,
+			    size_t max_pending, bool discard)
+{
+#ifdef LIBRNNOISE_ENABLED
+	while (ng->rnn_pending_jobs) {
+		struct rnnoise_job *job = &ng->rnn_jobs[ng->rnn_first_job];
+
+		if (!os_atomic_load_bool(&job->finished)) {
+			if (ng->rnn_pending_jobs <= max_pending)
+				break;
+
+			os_event_wait(ng->rnn_event);
+			continue;
+		}
+
+		if (!discard)
+			output_rnnoise(ng, job);
+
+		ng->rnn_first_job = (ng->rnn_first_job + 1) % RNNOISE_MAX_JOBS;
+		ng->rnn_pending_jobs--;
+	}
 #else
 	UNUSED_PARAMETER(ng);
+	UNUSED_PARAMETER(max_pending);
+	UNUSED_PARAMETER(discard);
+#endif
+}
+
+/* Waits for the worker if all the frames needed for the next packet have been
+ * submitted, so the filter adds no latency of its own, and only picks up the
+ * frames that are already done otherwise */
+static void collect_rnnoise_packet(struct noise_suppress_data *ng,
+				   size_t out_size)
+{
+#ifdef LIBRNNOISE_ENABLED
+	size_t segment_size = ng->frames * sizeof(float);
+	size_t buffered = ng->output_buffers[0].size;
+	size_t jobs = 0;
+
+	if (buffered < out_size)
+		jobs = (out_size - buffered + segment_size - 1) / segment_size;
+
+	if (jobs <= ng->rnn_pending_jobs)
+		collect_rnnoise(ng, ng->rnn_pending_jobs - jobs, false);
+	else
+		collect_rnnoise(ng, RNNOISE_MAX_JOBS, false);
+#else
+	UNUSED_PARAMETER(ng);
+	UNUSED_PARAMETER(out_size);
 #endif
 }
 
@@ -1019,7 +1140,8 @@ static inline void process(struct noise_suppress_data *ng)
 				    ng->frames * sizeof(float));
 
 	if (ng->use_rnnoise) {
-		process_rnnoise(ng);
+		if (submit_rnnoise(ng))
+			return;
 	} else if (ng->use_nvafx) {
 		if (nvafx_loaded) {
 			process_nvafx(ng);
@@ -1046,6 +1168,8 @@ static inline void clear_circlebuf(struct circlebuf *buf)
 
 static void reset_data(struct noise_suppress_data *ng)
 {
+	collect_rnnoise(ng, 0, true);
+
 	for (size_t i = 0; i < ng->channels; i++) {
 		clear_circlebuf(&ng->input_buffers[i]);
 		clear_circlebuf(&ng->output_buffers[i]);
@@ -1100,6 +1224,12 @@ noise_suppress_filter_audio(void *data, struct obs_audio_data *audio)
 		circlebuf_push_back(&ng->input_buffers[i], audio->data[i],
 				    audio->frames * sizeof(float));
 
+	/* -----------------------------------------------
+	 * frames still queued on the RNNoise worker go out first if the method
+	 * was changed */
+	if (!ng->use_rnnoise)
+		collect_rnnoise(ng, 0, false);
+
 	/* -----------------------------------------------
 	 * pop/process each 10ms segments, push back to output circlebuf */
 	while (ng->input_buffers[0].size >= segment_size)
@@ -1112,6 +1242,12 @@ noise_suppress_filter_audio(void *data, struct obs_audio_data *audio)
 	circlebuf_peek_front(&ng->info_buffer, &info, sizeof(info));
 	out_size = info.frames * sizeof(float);
 
+	/* -----------------------------------------------
+	 * RNNoise frames are processed on a shared worker, wait for the ones
+	 * this packet needs */
+	if (ng->use_rnnoise)
+		collect_rnnoise_packet(ng, out_size);
+
 	if (ng->output_buffers[0].size < out_size)
 		return NULL;
 
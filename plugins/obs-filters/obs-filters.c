@@ -12,6 +12,7 @@ extern struct obs_source_info mask_filter_v2;
 extern struct obs_source_info crop_filter;
 extern struct obs_source_info gain_filter;
 extern struct obs_source_info eq_filter;
+extern struct obs_source_info parametric_eq_filter;
 extern struct obs_source_info hdr_tonemap_filter;
 extern struct obs_source_info color_filter;
 extern struct obs_source_info color_filter_v2;
@@ -53,6 +54,7 @@ bool obs_module_load(void)
 	obs_register_source(&crop_filter);
 	obs_register_source(&gain_filter);
 	obs_register_source(&eq_filter);
+	obs_register_source(&parametric_eq_filter);
 	obs_register_source(&hdr_tonemap_filter);
 	obs_register_source(&color_filter);
 	obs_register_source(&color_filter_v2);
@@ -0,0 +1,356 @@
+#include <media-io/audio-math.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include <obs-module.h>
+#include "audio-biquad.h"
+
+#include <stdio.h>
+
+/* clang-format off */
+
+#define NUM_BANDS                       10
+
+#define S_OUTPUT_GAIN                   "output_gain"
+
+#define MT_ obs_module_text
+#define TEXT_BAND                       MT_("ParametricEq.Band")
+#define TEXT_TYPE                       MT_("ParametricEq.Type")
+#define TEXT_TYPE_PEAK                  MT_("ParametricEq.Type.Peak")
+#define TEXT_TYPE_LOW_SHELF             MT_("ParametricEq.Type.LowShelf")
+#define TEXT_TYPE_HIGH_SHELF            MT_("ParametricEq.Type.HighShelf")
+#define TEXT_TYPE_LOWPASS               MT_("ParametricEq.Type.LowPass")
+#define TEXT_TYPE_HIGHPASS              MT_("ParametricEq.Type.HighPass")
+#define TEXT_TYPE_BANDPASS              MT_("ParametricEq.Type.BandPass")
+#define TEXT_TYPE_NOTCH                 MT_("ParametricEq.Type.Notch")
+#define TEXT_FREQ                       MT_("ParametricEq.Frequency")
+#define TEXT_Q                          MT_("ParametricEq.Q")
+#define TEXT_GAIN                       MT_("ParametricEq.Gain")
+#define TEXT_OUTPUT_GAIN                MT_("ParametricEq.OutputGain")
+
+#define MIN_FREQ                        20.0
+#define MAX_FREQ                        20000.0
+#define MIN_Q                           0.1
+#define MAX_Q                           18.0
+#define MIN_GAIN_DB                     -24.0
+#define MAX_GAIN_DB                     24.0
+
+/* clang-format on */
+
+struct band_settings {
+	bool enabled;
+	enum audio_biquad_type type;
+	double freq;
+	double q;
+	double gain_db;
+};
+
+/*
+ * Every band is a stage of a biquad bank with one lane per channel.  Bands
+ * that are disabled or don't change the signal aren't part of the bank, and
+ * the output gain is folded into the first stage.
+ *
+ * update() designs the stages and leaves them for the audio thread, which
+ * picks them up before filtering its next packet.  As long as the same bands
+ * stay active, only the coefficients change and the filter state is kept.
+ */
+struct parametric_eq_data {
+	obs_source_t *context;
+	size_t channels;
+	double sample_rate;
+
+	struct audio_biquad_bank bank;
+	int active[NUM_BANDS];
+	size_t num_active;
+	bool passthrough;
+
+	pthread_mutex_t mutex;
+	bool pending;
+	struct audio_biquad pending_stages[NUM_BANDS];
+	int pending_active[NUM_BANDS];
+	size_t pending_num_active;
+	float pending_output_gain;
+};
+
+static inline void band_key(char *key, size_t size, int band,
+			    const char *name)
+{
+	if (name)
+		snprintf(key, size, "band%d_%s", band + 1, name);
+	else
+		snprintf(key, size, "band%d", band + 1);
+}
+
+static void get_band(obs_data_t *settings, int band, struct band_settings *bs)
+{
+	char key[32];
+
+	band_key(key, sizeof(key), band, NULL);
+	bs->enabled = obs_data_get_bool(settings, key);
+	band_key(key, sizeof(key), band, "type");
+	bs->type = (enum audio_biquad_type)obs_data_get_int(settings, key);
+	band_key(key, sizeof(key), band, "freq");
+	bs->freq = obs_data_get_double(settings, key);
+	band_key(key, sizeof(key), band, "q");
+	bs->q = obs_data_get_double(settings, key);
+	band_key(key, sizeof(key), band, "gain");
+	bs->gain_db = obs_data_get_double(settings, key);
+}
+
+static inline bool uses_gain(enum audio_biquad_type type)
+{
+	return type == AUDIO_BIQUAD_PEAK || type == AUDIO_BIQUAD_LOW_SHELF ||
+	       type == AUDIO_BIQUAD_HIGH_SHELF;
+}
+
+static inline bool band_changes_signal(const struct band_settings *bs)
+{
+	if (!bs->enabled || bs->type == AUDIO_BIQUAD_BYPASS)
+		return false;
+	return !uses_gain(bs->type) || bs->gain_db != 0.0;
+}
+
+static const char *parametric_eq_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("ParametricEq");
+}
+
+static void parametric_eq_update(void *data, obs_data_t *settings)
+{
+	struct parametric_eq_data *eq = data;
+	struct audio_biquad stages[NUM_BANDS];
+	int active[NUM_BANDS];
+	size_t num_active = 0;
+	float output_gain;
+
+	output_gain = db_to_mul((float)obs_data_get_double(settings,
+							   S_OUTPUT_GAIN));
+
+	for (int i = 0; i < NUM_BANDS; i++) {
+		struct band_settings bs;
+
+		get_band(settings, i, &bs);
+		if (!band_changes_signal(&bs))
+			continue;
+
+		audio_biquad_design(&stages[num_active], bs.type,
+				    eq->sample_rate, bs.freq, bs.q,
+				    bs.gain_db);
+		active[num_active++] = i;
+	}
+
+	pthread_mutex_lock(&eq->mutex);
+	memcpy(eq->pending_stages, stages, sizeof(stages));
+	memcpy(eq->pending_active, active, sizeof(active));
+	eq->pending_num_active = num_active;
+	eq->pending_output_gain = output_gain;
+	eq->pending = true;
+	pthread_mutex_unlock(&eq->mutex);
+}
+
+/* called on the audio thread */
+static void apply_pending(struct parametric_eq_data *eq)
+{
+	struct audio_biquad gain_stage = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+	struct audio_biquad *stages = eq->pending_stages;
+	size_t num_stages = eq->pending_num_active;
+	const float gain = eq->pending_output_gain;
+
+	if (!num_stages) {
+		stages = &gain_stage;
+		num_stages = 1;
+	}
+
+	stages[0].b0 *= gain;
+	stages[0].b1 *= gain;
+	stages[0].b2 *= gain;
+
+	if (eq->num_active != eq->pending_num_active ||
+	    memcmp(eq->active, eq->pending_active,
+		   eq->num_active * sizeof(int)) != 0 ||
+	    eq->bank.stages != num_stages) {
+		audio_biquad_bank_init(&eq->bank, eq->channels, num_stages);
+		memcpy(eq->active, eq->pending_active, sizeof(eq->active));
+		eq->num_active = eq->pending_num_active;
+	}
+
+	for (size_t c = 0; c < eq->channels; c++)
+		for (size_t s = 0; s < num_stages; s++)
+			audio_biquad_bank_set(&eq->bank, c, s, &stages[s]);
+
+	eq->passthrough = !eq->num_active && gain == 1.0f;
+	eq->pending = false;
+}
+
+static void *parametric_eq_create(obs_data_t *settings, obs_source_t *filter)
+{
+	struct parametric_eq_data *eq = bzalloc(sizeof(*eq));
+
+	eq->context = filter;
+	eq->channels = audio_output_get_channels(obs_get_audio());
+	eq->sample_rate =
+		(double)audio_output_get_sample_rate(obs_get_audio());
+	pthread_mutex_init(&eq->mutex, NULL);
+
+	audio_biquad_bank_init(&eq->bank, eq->channels, 1);
+	eq->passthrough = true;
+
+	parametric_eq_update(eq, settings);
+	return eq;
+}
+
+static void parametric_eq_destroy(void *data)
+{
+	struct parametric_eq_data *eq = data;
+
+	pthread_mutex_destroy(&eq->mutex);
+	bfree(eq);
+}
+
+static struct obs_audio_data *
+parametric_eq_filter_audio(void *data, struct obs_audio_data *audio)
+{
+	struct parametric_eq_data *eq = data;
+	float **adata = (float **)audio->data;
+
+	pthread_mutex_lock(&eq->mutex);
+	if (eq->pending)
+		apply_pending(eq);
+	pthread_mutex_unlock(&eq->mutex);
+
+	if (!eq->passthrough)
+		audio_biquad_bank_process(&eq->bank, adata,
+					  (const float *const *)adata,
+					  audio->frames);
+
+	return audio;
+}
+
+static void parametric_eq_defaults(obs_data_t *defaults)
+{
+	static const double freqs[NUM_BANDS] = {31.0,   63.0,   125.0,
+						250.0,  500.0,  1000.0,
+						2000.0, 4000.0, 8000.0,
+						16000.0};
+	char key[32];
+
+	for (int i = 0; i < NUM_BANDS; i++) {
+		enum audio_biquad_type type = AUDIO_BIQUAD_PEAK;
+		double q = 1.0;
+
+		/* 0.707 is the steepest shelf without overshoot */
+		if (i == 0 || i == NUM_BANDS - 1) {
+			type = i == 0 ? AUDIO_BIQUAD_LOW_SHELF
+				      : AUDIO_BIQUAD_HIGH_SHELF;
+			q = 0.707;
+		}
+
+		band_key(key, sizeof(key), i, NULL);
+		obs_data_set_default_bool(defaults, key, true);
+		band_key(key, sizeof(key), i, "type");
+		obs_data_set_default_int(defaults, key, type);
+		band_key(key, sizeof(key), i, "freq");
+		obs_data_set_default_double(defaults, key, freqs[i]);
+		band_key(key, sizeof(key), i, "q");
+		obs_data_set_default_double(defaults, key, q);
+		band_key(key, sizeof(key), i, "gain");
+		obs_data_set_default_double(defaults, key, 0.0);
+	}
+
+	obs_data_set_default_double(defaults, S_OUTPUT_GAIN, 0.0);
+}
+
+static bool type_modified(obs_properties_t *props, obs_property_t *p,
+			  obs_data_t *settings)
+{
+	const char *name = obs_property_name(p);
+	enum audio_biquad_type type =
+		(enum audio_biquad_type)obs_data_get_int(settings, name);
+	int band = 0;
+	char key[32];
+
+	if (sscanf(name, "band%d_", &band) != 1)
+		return false;
+
+	band_key(key, sizeof(key), band - 1, "gain");
+	obs_property_set_visible(obs_properties_get(props, key),
+				 uses_gain(type));
+	return true;
+}
+
+static void add_band(obs_properties_t *props, int band)
+{
+	obs_properties_t *group = obs_properties_create();
+	struct dstr title = {0};
+	obs_property_t *p;
+	char key[32];
+
+	band_key(key, sizeof(key), band, "type");
+	p = obs_properties_add_list(group, key, TEXT_TYPE, OBS_COMBO_TYPE_LIST,
+				    OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(p, TEXT_TYPE_PEAK, AUDIO_BIQUAD_PEAK);
+	obs_property_list_add_int(p, TEXT_TYPE_LOW_SHELF,
+				  AUDIO_BIQUAD_LOW_SHELF);
+	obs_property_list_add_int(p, TEXT_TYPE_HIGH_SHELF,
+				  AUDIO_BIQUAD_HIGH_SHELF);
+	obs_property_list_add_int(p, TEXT_TYPE_LOWPASS, AUDIO_BIQUAD_LOWPASS);
+	obs_property_list_add_int(p, TEXT_TYPE_HIGHPASS,
+				  AUDIO_BIQUAD_HIGHPASS);
+	obs_property_list_add_int(p, TEXT_TYPE_BANDPASS,
+				  AUDIO_BIQUAD_BANDPASS);
+	obs_property_list_add_int(p, TEXT_TYPE_NOTCH, AUDIO_BIQUAD_NOTCH);
+	obs_property_set_modified_callback(p, type_modified);
+
+	band_key(key, sizeof(key), band, "freq");
+	p = obs_properties_add_float_slider(group, key, TEXT_FREQ, MIN_FREQ,
+					    MAX_FREQ, 1.0);
+	obs_property_float_set_suffix(p, " Hz");
+
+	band_key(key, sizeof(key), band, "q");
+	obs_properties_add_float_slider(group, key, TEXT_Q, MIN_Q, MAX_Q,
+					0.01);
+
+	band_key(key, sizeof(key), band, "gain");
+	p = obs_properties_add_float_slider(group, key, TEXT_GAIN, MIN_GAIN_DB,
+					    MAX_GAIN_DB, 0.1);
+	obs_property_float_set_suffix(p, " dB");
+
+	dstr_copy(&title, TEXT_BAND);
+	snprintf(key, sizeof(key), "%d", band + 1);
+	dstr_replace(&title, "%1", key);
+
+	band_key(key, sizeof(key), band, NULL);
+	obs_properties_add_group(props, key, title.array, OBS_GROUP_CHECKABLE,
+				 group);
+	dstr_free(&title);
+}
+
+static obs_properties_t *parametric_eq_properties(void *unused)
+{
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
+
+	for (int i = 0; i < NUM_BANDS; i++)
+		add_band(props, i);
+
+	p = obs_properties_add_float_slider(props, S_OUTPUT_GAIN,
+					    TEXT_OUTPUT_GAIN, MIN_GAIN_DB,
+					    MAX_GAIN_DB, 0.1);
+	obs_property_float_set_suffix(p, " dB");
+
+	UNUSED_PARAMETER(unused);
+	return props;
+}
+
+struct obs_source_info parametric_eq_filter = {
+	.id = "parametric_eq_filter",
+	.type = OBS_SOURCE_TYPE_FILTER,
+	.output_flags = OBS_SOURCE_AUDIO,
+	.get_name = parametric_eq_name,
+	.create = parametric_eq_create,
+	.destroy = parametric_eq_destroy,
+	.update = parametric_eq_update,
+	.filter_audio = parametric_eq_filter_audio,
+	.get_defaults = parametric_eq_defaults,
+	.get_properties = parametric_eq_properties,
+};
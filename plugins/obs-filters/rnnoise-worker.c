@@ -0,0 +1,175 @@
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <obs-module.h>
+
+#include "rnnoise-worker.h"
+
+/* The bundled RNNoise can evaluate several frames at once, other builds of
+ * the library are called once per frame */
+
+struct rnnoise_worker {
+	pthread_mutex_t mutex;
+	long refs;
+
+	pthread_t thread;
+	os_event_t *wake;
+	DARRAY(struct rnnoise_job *) queue;
+};
+
+static struct rnnoise_worker worker = {
+	.mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+/* Takes at most one job per owner, later jobs of the same owner depend on
+ * the state left by the earlier ones */
+static void take_batch(struct rnnoise_job **batch, size_t *count)
+{
+	*count = 0;
+
+	for (size_t i = 0; i < worker.queue.num;) {
+		struct rnnoise_job *job = worker.queue.array[i];
+		bool taken = false;
+
+		for (size_t j = 0; j < *count && !taken; j++)
+			taken = batch[j]->owner == job->owner;
+
+		if (taken) {
+			i++;
+			continue;
+		}
+
+		batch[(*count)++] = job;
+		da_erase(worker.queue, i);
+	}
+}
+
+static void process_batch(struct rnnoise_job **jobs, size_t count,
+			  DenoiseState **states, float **frames)
+{
+	size_t lanes = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		for (size_t ch = 0; ch < jobs[i]->channels; ch++) {
+			states[lanes] = jobs[i]->states[ch];
+			frames[lanes] = jobs[i]->frames[ch];
+			lanes++;
+		}
+	}
+
+#ifdef RNNOISE_BATCH_API
+	rnnoise_process_frames(states, frames, (const float *const *)frames,
+			       NULL, (int)lanes);
+#else
+	for (size_t i = 0; i < lanes; i++)
+		rnnoise_process_frame(states[i], frames[i], frames[i]);
+#endif
+
+	for (size_t i = 0; i < count; i++) {
+		os_atomic_set_bool(&jobs[i]->finished, true);
+		os_event_signal(jobs[i]->event);
+	}
+}
+
+static void *worker_thread(void *param)
+{
+	os_event_t *wake = param;
+	DARRAY(struct rnnoise_job *) batch = {0};
+	DARRAY(DenoiseState *) states = {0};
+	DARRAY(float *) frames = {0};
+	size_t count;
+
+	os_set_thread_name("obs-filters: rnnoise");
+
+	for (;;) {
+		os_event_wait(wake);
+
+		pthread_mutex_lock(&worker.mutex);
+
+		/* released, possibly followed by a new thread being started */
+		if (worker.wake != wake) {
+			pthread_mutex_unlock(&worker.mutex);
+			break;
+		}
+
+		while (worker.queue.num) {
+			da_resize(batch, worker.queue.num);
+			da_resize(states, worker.queue.num *
+						  RNNOISE_WORKER_MAX_CHANNELS);
+			da_resize(frames, states.num);
+			take_batch(batch.array, &count);
+			pthread_mutex_unlock(&worker.mutex);
+
+			process_batch(batch.array, count, states.array,
+				      frames.array);
+
+			pthread_mutex_lock(&worker.mutex);
+		}
+
+		pthread_mutex_unlock(&worker.mutex);
+	}
+
+	da_free(batch);
+	da_free(states);
+	da_free(frames);
+	return NULL;
+}
+
+void rnnoise_worker_acquire(void)
+{
+	pthread_mutex_lock(&worker.mutex);
+
+	if (worker.refs++ == 0) {
+		os_event_init(&worker.wake, OS_EVENT_TYPE_AUTO);
+
+		if (pthread_create(&worker.thread, NULL, worker_thread,
+				   worker.wake) != 0) {
+			blog(LOG_ERROR, "Failed to create RNNoise thread");
+			os_event_destroy(worker.wake);
+			worker.wake = NULL;
+		}
+	}
+
+	pthread_mutex_unlock(&worker.mutex);
+}
+
+void rnnoise_worker_release(void)
+{
+	pthread_t thread;
+	os_event_t *wake = NULL;
+
+	pthread_mutex_lock(&worker.mutex);
+
+	if (--worker.refs == 0 && worker.wake) {
+		wake = worker.wake;
+		thread = worker.thread;
+		worker.wake = NULL;
+	}
+
+	pthread_mutex_unlock(&worker.mutex);
+
+	if (wake) {
+		os_event_signal(wake);
+		pthread_join(thread, NULL);
+		os_event_destroy(wake);
+	}
+}
+
+void rnnoise_worker_submit(struct rnnoise_job *job)
+{
+	os_atomic_set_bool(&job->finished, false);
+
+	pthread_mutex_lock(&worker.mutex);
+
+	/* without a thread the frames are processed right away */
+	if (!worker.wake) {
+		pthread_mutex_unlock(&worker.mutex);
+		process_batch(&job, 1, job->states, job->frames);
+		return;
+	}
+
+	da_push_back(worker.queue, &job);
+	os_event_signal(worker.wake);
+
+	pthread_mutex_unlock(&worker.mutex);
+}
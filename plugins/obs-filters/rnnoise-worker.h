@@ -0,0 +1,34 @@
+#pragma once
+
+#include <util/c99defs.h>
+#include <util/threading.h>
+#include <rnnoise.h>
+
+#define RNNOISE_WORKER_MAX_CHANNELS 8
+
+/*
+ * Shared RNNoise worker
+ *
+ *   Noise suppression filters hand their 10 ms frames to a single thread,
+ * which runs everything that is pending from all filters and channels as one
+ * batch, so the network weights are only streamed through the cache once per
+ * batch.  Jobs of the same owner are processed in the order they were
+ * submitted, and the result is the same as processing them inline.
+ */
+
+struct rnnoise_job {
+	DenoiseState *states[RNNOISE_WORKER_MAX_CHANNELS];
+	float *frames[RNNOISE_WORKER_MAX_CHANNELS];
+	size_t channels;
+
+	/* set once the frames have been processed in place, the owner's event
+	 * is signaled as well */
+	volatile bool finished;
+	os_event_t *event;
+	void *owner;
+};
+
+extern void rnnoise_worker_acquire(void);
+extern void rnnoise_worker_release(void);
+
+extern void rnnoise_worker_submit(struct rnnoise_job *job);
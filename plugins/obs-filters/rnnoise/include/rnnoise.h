@@ -61,6 +61,12 @@ RNNOISE_EXPORT void rnnoise_destroy(DenoiseState *st);
 
 RNNOISE_EXPORT float rnnoise_process_frame(DenoiseState *st, float *out, const float *in);
 
+/* Processes one frame for each of count independent states, evaluating
+   their networks together.  The output is the same as calling
+   rnnoise_process_frame() for each of them.  vad may be NULL. */
+RNNOISE_EXPORT void rnnoise_process_frames(DenoiseState *const *st, float *const *out,
+                                           const float *const *in, float *vad, int count);
+
 RNNOISE_EXPORT RNNModel *rnnoise_model_from_file(FILE *f);
 
 RNNOISE_EXPORT void rnnoise_model_free(RNNModel *model);
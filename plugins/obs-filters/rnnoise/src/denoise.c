@@ -453,44 +453,95 @@ void pitch_filter(kiss_fft_cpx *X, const kiss_fft_cpx *P, const float *Ex, const
   }
 }
 
-float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
-  int i;
+typedef struct {
   kiss_fft_cpx X[FREQ_SIZE];
   kiss_fft_cpx P[WINDOW_SIZE];
-  float x[FRAME_SIZE];
   float Ex[NB_BANDS], Ep[NB_BANDS];
   float Exp[NB_BANDS];
   float features[NB_FEATURES];
   float g[NB_BANDS];
-  float gf[FREQ_SIZE]={1};
-  float vad_prob = 0;
   int silence;
+} FrameState;
+
+static void process_frame_analysis(DenoiseState *st, FrameState *fs, const float *in) {
+  float x[FRAME_SIZE];
   static const float a_hp[2] = {-1.99599f, 0.99600f};
   static const float b_hp[2] = {-2, 1};
   biquad(x, st->mem_hp_x, in, b_hp, a_hp, FRAME_SIZE);
-  silence = compute_frame_features(st, X, P, Ex, Ep, Exp, features, x);
+  fs->silence = compute_frame_features(st, fs->X, fs->P, fs->Ex, fs->Ep, fs->Exp, fs->features, x);
+}
 
-  if (!silence) {
-    compute_rnn(&st->rnn, g, &vad_prob, features);
-    pitch_filter(X, P, Ex, Ep, Exp, g);
+static void process_frame_synthesis(DenoiseState *st, FrameState *fs, float *out) {
+  int i;
+  float gf[FREQ_SIZE]={1};
+  if (!fs->silence) {
+    pitch_filter(fs->X, fs->P, fs->Ex, fs->Ep, fs->Exp, fs->g);
     for (i=0;i<NB_BANDS;i++) {
       float alpha = .6f;
-      g[i] = MAX16(g[i], alpha*st->lastg[i]);
-      st->lastg[i] = g[i];
+      fs->g[i] = MAX16(fs->g[i], alpha*st->lastg[i]);
+      st->lastg[i] = fs->g[i];
     }
-    interp_band_gain(gf, g);
+    interp_band_gain(gf, fs->g);
 #if 1
     for (i=0;i<FREQ_SIZE;i++) {
-      X[i].r *= gf[i];
-      X[i].i *= gf[i];
+      fs->X[i].r *= gf[i];
+      fs->X[i].i *= gf[i];
     }
 #endif
   }
 
-  frame_synthesis(st, out, X);
+  frame_synthesis(st, out, fs->X);
+}
+
+float rnnoise_process_frame(DenoiseState *st, float *out, const float *in) {
+  FrameState fs;
+  float vad_prob = 0;
+  process_frame_analysis(st, &fs, in);
+  if (!fs.silence)
+    compute_rnn(&st->rnn, fs.g, &vad_prob, fs.features);
+  process_frame_synthesis(st, &fs, out);
   return vad_prob;
 }
 
+#define FRAMES_PER_BATCH 8
+
+void rnnoise_process_frames(DenoiseState *const *st, float *const *out,
+                            const float *const *in, float *vad, int count) {
+  int i, j;
+  FrameState *fs = malloc(sizeof(FrameState)*FRAMES_PER_BATCH);
+  for (i=0;i<count;i+=FRAMES_PER_BATCH) {
+    int n = count - i < FRAMES_PER_BATCH ? count - i : FRAMES_PER_BATCH;
+    int active = 0;
+    RNNState *rnn[FRAMES_PER_BATCH];
+    float *gains[FRAMES_PER_BATCH];
+    const float *features[FRAMES_PER_BATCH];
+    float vad_prob[FRAMES_PER_BATCH];
+    float active_vad[FRAMES_PER_BATCH];
+
+    for (j=0;j<n;j++) {
+      process_frame_analysis(st[i+j], &fs[j], in[i+j]);
+      vad_prob[j] = 0;
+      if (!fs[j].silence) {
+        rnn[active] = &st[i+j]->rnn;
+        gains[active] = fs[j].g;
+        features[active] = fs[j].features;
+        active++;
+      }
+    }
+
+    compute_rnn_batch(rnn, gains, active_vad, features, active);
+
+    for (j=0,active=0;j<n;j++) {
+      if (!fs[j].silence)
+        vad_prob[j] = active_vad[active++];
+      process_frame_synthesis(st[i+j], &fs[j], out[i+j]);
+      if (vad)
+        vad[i+j] = vad_prob[j];
+    }
+  }
+  free(fs);
+}
+
 #if TRAINING
 
 static float uni_rand() {
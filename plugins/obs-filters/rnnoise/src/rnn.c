@@ -176,3 +176,255 @@ void compute_rnn(RNNState *rnn, float *gains, float *vad, const float *input) {
   compute_gru(rnn->model->denoise_gru, rnn->denoise_gru_state, denoise_input);
   compute_dense(rnn->model->denoise_output, gains, rnn->denoise_gru_state);
 }
+
+/* Batched evaluation
+
+   The layers of several streams are evaluated together, so that every
+   weight is loaded and converted once per batch instead of once per
+   stream.  The AVX2 kernel computes eight neurons of eight streams at a
+   time.  Each sum is accumulated in the same order as in compute_dense()
+   and compute_gru(), with separate multiplies and adds, so the output
+   doesn't depend on the code path taken. */
+
+#define RNN_BATCH 8
+
+#if defined(__GNUC__) && defined(__x86_64__)
+#define RNN_AVX2
+#include <immintrin.h>
+#endif
+
+typedef float rnn_lanes[RNN_BATCH][MAX_NEURONS];
+
+static int has_avx2(void)
+{
+#ifdef RNN_AVX2
+   static int avx2 = -1;
+   if (avx2 < 0) {
+      __builtin_cpu_init();
+      avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+   }
+   return avx2;
+#else
+   return 0;
+#endif
+}
+
+static void accumulate_c(float (*acc)[MAX_NEURONS], const rnn_weight *weights,
+                         int stride, int i0, int N, const float *const *input,
+                         const float *const *scale, int M)
+{
+   int b, i, j;
+   for (b=0;b<RNN_BATCH;b++)
+   {
+      for (i=i0;i<N;i++)
+      {
+         float sum = acc[b][i];
+         if (scale) {
+            for (j=0;j<M;j++)
+               sum += weights[j*stride + i]*input[b][j]*scale[b][j];
+         } else {
+            for (j=0;j<M;j++)
+               sum += weights[j*stride + i]*input[b][j];
+         }
+         acc[b][i] = sum;
+      }
+   }
+}
+
+#ifdef RNN_AVX2
+static __attribute__((target("avx2"))) int accumulate_avx2(
+      float (*acc)[MAX_NEURONS], const rnn_weight *weights, int stride, int N,
+      const float *const *input, const float *const *scale, int M)
+{
+   int b, i, j;
+   for (i=0;i+8<=N;i+=8)
+   {
+      __m256 sum[RNN_BATCH];
+      for (b=0;b<RNN_BATCH;b++)
+         sum[b] = _mm256_loadu_ps(&acc[b][i]);
+      for (j=0;j<M;j++)
+      {
+         const __m128i w8 = _mm_loadl_epi64((const __m128i *)&weights[j*stride + i]);
+         const __m256 w = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(w8));
+         if (scale) {
+            for (b=0;b<RNN_BATCH;b++) {
+               __m256 x = _mm256_mul_ps(w, _mm256_set1_ps(input[b][j]));
+               x = _mm256_mul_ps(x, _mm256_set1_ps(scale[b][j]));
+               sum[b] = _mm256_add_ps(sum[b], x);
+            }
+         } else {
+            for (b=0;b<RNN_BATCH;b++) {
+               __m256 x = _mm256_mul_ps(w, _mm256_set1_ps(input[b][j]));
+               sum[b] = _mm256_add_ps(sum[b], x);
+            }
+         }
+      }
+      for (b=0;b<RNN_BATCH;b++)
+         _mm256_storeu_ps(&acc[b][i], sum[b]);
+   }
+   return i;
+}
+#endif
+
+/* acc[b][i] += sum over j of weights[j*stride + i]*input[b][j](*scale[b][j]) */
+static void accumulate(float (*acc)[MAX_NEURONS], const rnn_weight *weights,
+                       int stride, int N, const float *const *input,
+                       const float *const *scale, int M)
+{
+   int i0 = 0;
+#ifdef RNN_AVX2
+   i0 = accumulate_avx2(acc, weights, stride, N, input, scale, M);
+#endif
+   accumulate_c(acc, weights, stride, i0, N, input, scale, M);
+}
+
+static void init_lanes(float (*acc)[MAX_NEURONS], const rnn_weight *bias, int N)
+{
+   int b, i;
+   for (b=0;b<RNN_BATCH;b++)
+      for (i=0;i<N;i++)
+         acc[b][i] = bias[i];
+}
+
+static float activation(float x, int type)
+{
+   if (type == ACTIVATION_SIGMOID) return sigmoid_approx(x);
+   else if (type == ACTIVATION_TANH) return tansig_approx(x);
+   else if (type == ACTIVATION_RELU) return relu(x);
+   *(int*)0=0;
+   return 0;
+}
+
+static void compute_dense_batch(const DenseLayer *layer, float (*output)[MAX_NEURONS],
+                                const float *const *input)
+{
+   int b, i;
+   int N = layer->nb_neurons;
+   init_lanes(output, layer->bias, N);
+   accumulate(output, layer->input_weights, N, N, input, NULL, layer->nb_inputs);
+   for (b=0;b<RNN_BATCH;b++)
+      for (i=0;i<N;i++)
+         output[b][i] = activation(WEIGHTS_SCALE*output[b][i], layer->activation);
+}
+
+static void compute_gru_batch(const GRULayer *gru, float *const *state,
+                              const float *const *input)
+{
+   int b, i;
+   int N = gru->nb_neurons;
+   int M = gru->nb_inputs;
+   int stride = 3*N;
+   rnn_lanes z, r, h;
+   const float *state_in[RNN_BATCH];
+   const float *reset[RNN_BATCH];
+   for (b=0;b<RNN_BATCH;b++) {
+      state_in[b] = state[b];
+      reset[b] = r[b];
+   }
+
+   /* Compute update gate. */
+   init_lanes(z, gru->bias, N);
+   accumulate(z, gru->input_weights, stride, N, input, NULL, M);
+   accumulate(z, gru->recurrent_weights, stride, N, state_in, NULL, N);
+
+   /* Compute reset gate. */
+   init_lanes(r, gru->bias + N, N);
+   accumulate(r, gru->input_weights + N, stride, N, input, NULL, M);
+   accumulate(r, gru->recurrent_weights + N, stride, N, state_in, NULL, N);
+
+   for (b=0;b<RNN_BATCH;b++) {
+      for (i=0;i<N;i++) {
+         z[b][i] = sigmoid_approx(WEIGHTS_SCALE*z[b][i]);
+         r[b][i] = sigmoid_approx(WEIGHTS_SCALE*r[b][i]);
+      }
+   }
+
+   /* Compute output. */
+   init_lanes(h, gru->bias + 2*N, N);
+   accumulate(h, gru->input_weights + 2*N, stride, N, input, NULL, M);
+   accumulate(h, gru->recurrent_weights + 2*N, stride, N, state_in, reset, N);
+
+   for (b=0;b<RNN_BATCH;b++) {
+      for (i=0;i<N;i++) {
+         float sum = activation(WEIGHTS_SCALE*h[b][i], gru->activation);
+         h[b][i] = z[b][i]*state[b][i] + (1-z[b][i])*sum;
+      }
+   }
+   for (b=0;b<RNN_BATCH;b++)
+      for (i=0;i<N;i++)
+         state[b][i] = h[b][i];
+}
+
+/* Unused lanes run on zeros, and share one set of scratch states. */
+static void compute_rnn_lanes(RNNState *const *rnn, float *const *gains, float *vad,
+                              const float *const *input, int count)
+{
+   static const float zeros[INPUT_SIZE];
+   const RNNModel *model = rnn[0]->model;
+   int b, i;
+   rnn_lanes dense_out, vad_out, gains_out;
+   float noise_input[RNN_BATCH][MAX_NEURONS*3];
+   float denoise_input[RNN_BATCH][MAX_NEURONS*3];
+   float pad_states[3][MAX_NEURONS] = {{0}};
+   const float *in[RNN_BATCH];
+   float *vad_state[RNN_BATCH];
+   float *noise_state[RNN_BATCH];
+   float *denoise_state[RNN_BATCH];
+   const float *dense_in[RNN_BATCH];
+   const float *noise_in[RNN_BATCH];
+   const float *denoise_in[RNN_BATCH];
+
+   for (b=0;b<RNN_BATCH;b++) {
+      in[b] = b < count ? input[b] : zeros;
+      vad_state[b] = b < count ? rnn[b]->vad_gru_state : pad_states[0];
+      noise_state[b] = b < count ? rnn[b]->noise_gru_state : pad_states[1];
+      denoise_state[b] = b < count ? rnn[b]->denoise_gru_state : pad_states[2];
+      dense_in[b] = dense_out[b];
+      noise_in[b] = noise_input[b];
+      denoise_in[b] = denoise_input[b];
+   }
+
+   compute_dense_batch(model->input_dense, dense_out, in);
+   compute_gru_batch(model->vad_gru, vad_state, dense_in);
+   compute_dense_batch(model->vad_output, vad_out, (const float *const *)vad_state);
+
+   for (b=0;b<RNN_BATCH;b++) {
+      for (i=0;i<model->input_dense_size;i++) noise_input[b][i] = dense_out[b][i];
+      for (i=0;i<model->vad_gru_size;i++) noise_input[b][i+model->input_dense_size] = vad_state[b][i];
+      for (i=0;i<INPUT_SIZE;i++) noise_input[b][i+model->input_dense_size+model->vad_gru_size] = in[b][i];
+   }
+   compute_gru_batch(model->noise_gru, noise_state, noise_in);
+
+   for (b=0;b<RNN_BATCH;b++) {
+      for (i=0;i<model->vad_gru_size;i++) denoise_input[b][i] = vad_state[b][i];
+      for (i=0;i<model->noise_gru_size;i++) denoise_input[b][i+model->vad_gru_size] = noise_state[b][i];
+      for (i=0;i<INPUT_SIZE;i++) denoise_input[b][i+model->vad_gru_size+model->noise_gru_size] = in[b][i];
+   }
+   compute_gru_batch(model->denoise_gru, denoise_state, denoise_in);
+   compute_dense_batch(model->denoise_output, gains_out, (const float *const *)denoise_state);
+
+   for (b=0;b<count;b++) {
+      vad[b] = vad_out[b][0];
+      for (i=0;i<model->denoise_output_size;i++) gains[b][i] = gains_out[b][i];
+   }
+}
+
+void compute_rnn_batch(RNNState *const *rnn, float *const *gains, float *vad,
+                       const float *const *input, int count)
+{
+   int b, n;
+   int same_model = 1;
+   for (b=1;b<count;b++)
+      same_model &= rnn[b]->model == rnn[0]->model;
+
+   if (count < 2 || !same_model || !has_avx2()) {
+      for (b=0;b<count;b++)
+         compute_rnn(rnn[b], gains[b], &vad[b], input[b]);
+      return;
+   }
+
+   for (b=0;b<count;b+=n) {
+      n = count - b < RNN_BATCH ? count - b : RNN_BATCH;
+      compute_rnn_lanes(rnn + b, gains + b, vad + b, input + b, n);
+   }
+}
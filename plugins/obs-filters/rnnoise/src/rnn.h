@@ -62,4 +62,9 @@ typedef struct RNNState RNNState;
 
 void compute_rnn(RNNState *rnn, float *gains, float *vad, const float *input);
 
+/* Evaluates the network for several independent states at once.  The
+   results are bit-exact with calling compute_rnn() for each of them. */
+void compute_rnn_batch(RNNState *const *rnn, float *const *gains, float *vad,
+                       const float *const *input, int count);
+
 #endif /* _MLP_H_ */
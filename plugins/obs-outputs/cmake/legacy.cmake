@@ -20,6 +20,11 @@ target_sources(
           flv-mux.c
           flv-mux.h
           flv-output.c
+          fmp4-mux.c
+          fmp4-mux.h
+          llhls-output.c
+          llhls-segmenter.c
+          llhls-segmenter.h
           net-if.c
           net-if.h
           null-output.c
@@ -51,7 +56,9 @@ if(ENABLE_HEVC)
   target_sources(obs-outputs PRIVATE rtmp-hevc.c rtmp-hevc.h)
 endif()
 
-target_link_libraries(obs-outputs PRIVATE OBS::libobs)
+find_package(CURL REQUIRED)
+
+target_link_libraries(obs-outputs PRIVATE OBS::libobs CURL::libcurl)
 
 set_target_properties(obs-outputs PROPERTIES FOLDER "plugins" PREFIX "")
 
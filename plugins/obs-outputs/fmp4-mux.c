@@ -0,0 +1,489 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <assert.h>
+
+#include "fmp4-mux.h"
+
+#define SAMPLE_FLAGS_SYNC 0x02000000
+#define SAMPLE_FLAGS_NON_SYNC 0x01010000
+
+#define TFHD_DEFAULT_BASE_IS_MOOF 0x020000
+
+#define TRUN_DATA_OFFSET 0x000001
+#define TRUN_SAMPLE_DURATION 0x000100
+#define TRUN_SAMPLE_SIZE 0x000200
+#define TRUN_SAMPLE_FLAGS 0x000400
+#define TRUN_SAMPLE_CTS_OFFSET 0x000800
+
+#define LANGUAGE_UND 0x55C4
+
+static const uint32_t unity_matrix[9] = {
+	0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000,
+};
+
+void fmp4_track_free(struct fmp4_track *track)
+{
+	bfree(track->config);
+	da_free(track->samples);
+	da_free(track->data);
+	memset(track, 0, sizeof(*track));
+}
+
+void fmp4_track_add_sample(struct fmp4_track *track, const uint8_t *data,
+			   size_t size, uint32_t duration, int32_t cts_offset,
+			   bool keyframe)
+{
+	struct fmp4_sample sample = {
+		.offset = track->data.num,
+		.size = (uint32_t)size,
+		.duration = duration,
+		.cts_offset = cts_offset,
+		.keyframe = keyframe,
+	};
+
+	if (!track->samples.num)
+		track->base_time = track->next_time;
+
+	da_push_back(track->samples, &sample);
+	da_push_back_array(track->data, data, size);
+	track->next_time += duration;
+}
+
+/* ------------------------------------------------------------------------- */
+/* boxes */
+
+static inline void s_w4cc(struct serializer *s, const char *type)
+{
+	s_write(s, type, 4);
+}
+
+static inline void s_wzero(struct serializer *s, size_t size)
+{
+	for (size_t i = 0; i < size; i++)
+		s_w8(s, 0);
+}
+
+static inline void patch_b32(struct array_output_data *out, size_t pos,
+			     uint32_t val)
+{
+	uint8_t *p = out->bytes.array + pos;
+	p[0] = (uint8_t)(val >> 24);
+	p[1] = (uint8_t)(val >> 16);
+	p[2] = (uint8_t)(val >> 8);
+	p[3] = (uint8_t)val;
+}
+
+static inline size_t box_begin(struct serializer *s, const char *type)
+{
+	size_t start = (size_t)serializer_get_pos(s);
+	s_wb32(s, 0);
+	s_w4cc(s, type);
+	return start;
+}
+
+static inline size_t full_box_begin(struct serializer *s, const char *type,
+				    uint8_t version, uint32_t flags)
+{
+	size_t start = box_begin(s, type);
+	s_w8(s, version);
+	s_wb24(s, flags);
+	return start;
+}
+
+static inline void box_end(struct array_output_data *out, size_t start)
+{
+	patch_b32(out, start, (uint32_t)(out->bytes.num - start));
+}
+
+static inline void s_wmatrix(struct serializer *s)
+{
+	for (size_t i = 0; i < 9; i++)
+		s_wb32(s, unity_matrix[i]);
+}
+
+static void write_ftyp(struct serializer *s, struct array_output_data *out)
+{
+	size_t box = box_begin(s, "ftyp");
+	s_w4cc(s, "iso6");
+	s_wb32(s, 0);
+	/* no cmfc, CMAF only allows one track per file */
+	s_w4cc(s, "iso6");
+	s_w4cc(s, "isom");
+	s_w4cc(s, "mp41");
+	box_end(out, box);
+}
+
+static void write_mvhd(struct serializer *s, struct array_output_data *out,
+		       uint32_t next_track_id)
+{
+	size_t box = full_box_begin(s, "mvhd", 0, 0);
+	s_wb32(s, 0);          /* creation time */
+	s_wb32(s, 0);          /* modification time */
+	s_wb32(s, 1000);       /* timescale */
+	s_wb32(s, 0);          /* duration */
+	s_wb32(s, 0x00010000); /* rate */
+	s_wb16(s, 0x0100);     /* volume */
+	s_wzero(s, 2 + 8);     /* reserved */
+	s_wmatrix(s);
+	s_wzero(s, 6 * 4); /* pre_defined */
+	s_wb32(s, next_track_id);
+	box_end(out, box);
+}
+
+static void write_tkhd(struct serializer *s, struct array_output_data *out,
+		       const struct fmp4_track *track)
+{
+	bool audio = track->type == OBS_ENCODER_AUDIO;
+
+	/* flags: track enabled | track in movie */
+	size_t box = full_box_begin(s, "tkhd", 0, 0x3);
+	s_wb32(s, 0); /* creation time */
+	s_wb32(s, 0); /* modification time */
+	s_wb32(s, track->id);
+	s_wb32(s, 0);  /* reserved */
+	s_wb32(s, 0);  /* duration */
+	s_wzero(s, 8); /* reserved */
+	s_wb16(s, 0);  /* layer */
+	s_wb16(s, 0);  /* alternate group */
+	s_wb16(s, audio ? 0x0100 : 0);
+	s_wb16(s, 0); /* reserved */
+	s_wmatrix(s);
+	s_wb32(s, audio ? 0 : track->width << 16);
+	s_wb32(s, audio ? 0 : track->height << 16);
+	box_end(out, box);
+}
+
+static void write_mdhd(struct serializer *s, struct array_output_data *out,
+		       const struct fmp4_track *track)
+{
+	size_t box = full_box_begin(s, "mdhd", 0, 0);
+	s_wb32(s, 0); /* creation time */
+	s_wb32(s, 0); /* modification time */
+	s_wb32(s, track->timescale);
+	s_wb32(s, 0); /* duration */
+	s_wb16(s, LANGUAGE_UND);
+	s_wb16(s, 0); /* pre_defined */
+	box_end(out, box);
+}
+
+static void write_hdlr(struct serializer *s, struct array_output_data *out,
+		       const struct fmp4_track *track)
+{
+	bool audio = track->type == OBS_ENCODER_AUDIO;
+	const char *name = audio ? "SoundHandler" : "VideoHandler";
+
+	size_t box = full_box_begin(s, "hdlr", 0, 0);
+	s_wb32(s, 0); /* pre_defined */
+	s_w4cc(s, audio ? "soun" : "vide");
+	s_wzero(s, 3 * 4); /* reserved */
+	s_write(s, name, strlen(name) + 1);
+	box_end(out, box);
+}
+
+static void write_dinf(struct serializer *s, struct array_output_data *out)
+{
+	size_t dinf = box_begin(s, "dinf");
+	size_t dref = full_box_begin(s, "dref", 0, 0);
+	s_wb32(s, 1); /* entry count */
+
+	/* flags: media data is in the same file */
+	size_t url = full_box_begin(s, "url ", 0, 0x1);
+	box_end(out, url);
+
+	box_end(out, dref);
+	box_end(out, dinf);
+}
+
+static void write_avc1(struct serializer *s, struct array_output_data *out,
+		       const struct fmp4_track *track)
+{
+	size_t box = box_begin(s, "avc1");
+	s_wzero(s, 6);  /* reserved */
+	s_wb16(s, 1);   /* data reference index */
+	s_wzero(s, 16); /* pre_defined, reserved */
+	s_wb16(s, (uint16_t)track->width);
+	s_wb16(s, (uint16_t)track->height);
+	s_wb32(s, 0x00480000); /* horizontal resolution, 72 dpi */
+	s_wb32(s, 0x00480000); /* vertical resolution, 72 dpi */
+	s_wb32(s, 0);          /* reserved */
+	s_wb16(s, 1);          /* frame count */
+	s_wzero(s, 32);        /* compressor name */
+	s_wb16(s, 0x0018);     /* depth */
+	s_wb16(s, 0xFFFF);     /* pre_defined */
+
+	size_t avcc = box_begin(s, "avcC");
+	s_write(s, track->config, track->config_size);
+	box_end(out, avcc);
+
+	box_end(out, box);
+}
+
+static inline void s_wdescriptor(struct serializer *s, uint8_t tag,
+				 size_t size)
+{
+	s_w8(s, tag);
+	s_w8(s, 0x80);
+	s_w8(s, 0x80);
+	s_w8(s, 0x80);
+	s_w8(s, (uint8_t)size);
+}
+
+#define DESCRIPTOR_HEADER_SIZE 5
+
+static void write_mp4a(struct serializer *s, struct array_output_data *out,
+		       const struct fmp4_track *track)
+{
+	size_t dsi_size = track->config_size;
+	size_t dcd_size = 13 + DESCRIPTOR_HEADER_SIZE + dsi_size;
+	size_t sl_size = 1;
+	size_t es_size = 3 + DESCRIPTOR_HEADER_SIZE + dcd_size +
+			 DESCRIPTOR_HEADER_SIZE + sl_size;
+
+	size_t box = box_begin(s, "mp4a");
+	s_wzero(s, 6); /* reserved */
+	s_wb16(s, 1);  /* data reference index */
+	s_wzero(s, 8); /* reserved */
+	s_wb16(s, (uint16_t)track->channels);
+	s_wb16(s, 16); /* sample size */
+	s_wb16(s, 0);  /* pre_defined */
+	s_wb16(s, 0);  /* reserved */
+	s_wb32(s, track->sample_rate << 16);
+
+	size_t esds = full_box_begin(s, "esds", 0, 0);
+
+	/* ES_Descriptor */
+	s_wdescriptor(s, 0x03, es_size);
+	s_wb16(s, (uint16_t)track->id);
+	s_w8(s, 0); /* flags */
+
+	/* DecoderConfigDescriptor */
+	s_wdescriptor(s, 0x04, dcd_size);
+	s_w8(s, 0x40); /* object type: MPEG-4 audio */
+	s_w8(s, 0x15); /* stream type: audio */
+	s_wb24(s, 0);  /* buffer size */
+	s_wb32(s, 0);  /* max bitrate */
+	s_wb32(s, 0);  /* average bitrate */
+
+	/* DecoderSpecificInfo */
+	s_wdescriptor(s, 0x05, dsi_size);
+	s_write(s, track->config, dsi_size);
+
+	/* SLConfigDescriptor */
+	s_wdescriptor(s, 0x06, sl_size);
+	s_w8(s, 0x02);
+
+	box_end(out, esds);
+	box_end(out, box);
+}
+
+static void write_stbl(struct serializer *s, struct array_output_data *out,
+		       const struct fmp4_track *track)
+{
+	size_t stbl = box_begin(s, "stbl");
+
+	size_t stsd = full_box_begin(s, "stsd", 0, 0);
+	s_wb32(s, 1); /* entry count */
+	if (track->type == OBS_ENCODER_VIDEO)
+		write_avc1(s, out, track);
+	else
+		write_mp4a(s, out, track);
+	box_end(out, stsd);
+
+	/* samples are only described by the fragments */
+	size_t stts = full_box_begin(s, "stts", 0, 0);
+	s_wb32(s, 0);
+	box_end(out, stts);
+
+	size_t stsc = full_box_begin(s, "stsc", 0, 0);
+	s_wb32(s, 0);
+	box_end(out, stsc);
+
+	size_t stsz = full_box_begin(s, "stsz", 0, 0);
+	s_wb32(s, 0);
+	s_wb32(s, 0);
+	box_end(out, stsz);
+
+	size_t stco = full_box_begin(s, "stco", 0, 0);
+	s_wb32(s, 0);
+	box_end(out, stco);
+
+	box_end(out, stbl);
+}
+
+static void write_trak(struct serializer *s, struct array_output_data *out,
+		       const struct fmp4_track *track)
+{
+	size_t trak = box_begin(s, "trak");
+	write_tkhd(s, out, track);
+
+	size_t mdia = box_begin(s, "mdia");
+	write_mdhd(s, out, track);
+	write_hdlr(s, out, track);
+
+	size_t minf = box_begin(s, "minf");
+	if (track->type == OBS_ENCODER_VIDEO) {
+		size_t vmhd = full_box_begin(s, "vmhd", 0, 0x1);
+		s_wzero(s, 8); /* graphics mode, opcolor */
+		box_end(out, vmhd);
+	} else {
+		size_t smhd = full_box_begin(s, "smhd", 0, 0);
+		s_wzero(s, 4); /* balance, reserved */
+		box_end(out, smhd);
+	}
+	write_dinf(s, out);
+	write_stbl(s, out, track);
+	box_end(out, minf);
+
+	box_end(out, mdia);
+	box_end(out, trak);
+}
+
+void fmp4_write_init_segment(struct array_output_data *out,
+			     const struct fmp4_track *tracks,
+			     size_t num_tracks)
+{
+	struct serializer s;
+	uint32_t next_track_id = 1;
+
+	array_output_serializer_init(&s, out);
+	write_ftyp(&s, out);
+
+	for (size_t i = 0; i < num_tracks; i++) {
+		if (tracks[i].id >= next_track_id)
+			next_track_id = tracks[i].id + 1;
+	}
+
+	size_t moov = box_begin(&s, "moov");
+	write_mvhd(&s, out, next_track_id);
+
+	for (size_t i = 0; i < num_tracks; i++)
+		write_trak(&s, out, &tracks[i]);
+
+	size_t mvex = box_begin(&s, "mvex");
+	for (size_t i = 0; i < num_tracks; i++) {
+		size_t trex = full_box_begin(&s, "trex", 0, 0);
+		s_wb32(&s, tracks[i].id);
+		s_wb32(&s, 1); /* default sample description index */
+		s_wb32(&s, 0); /* default sample duration */
+		s_wb32(&s, 0); /* default sample size */
+		s_wb32(&s, 0); /* default sample flags */
+		box_end(out, trex);
+	}
+	box_end(out, mvex);
+
+	box_end(out, moov);
+}
+
+/* ------------------------------------------------------------------------- */
+/* fragments */
+
+static size_t write_traf(struct serializer *s, struct array_output_data *out,
+			 const struct fmp4_track *track)
+{
+	bool video = track->type == OBS_ENCODER_VIDEO;
+	uint32_t trun_flags = TRUN_DATA_OFFSET | TRUN_SAMPLE_DURATION |
+			      TRUN_SAMPLE_SIZE | TRUN_SAMPLE_FLAGS;
+	size_t data_offset_pos;
+
+	if (video)
+		trun_flags |= TRUN_SAMPLE_CTS_OFFSET;
+
+	size_t traf = box_begin(s, "traf");
+
+	size_t tfhd = full_box_begin(s, "tfhd", 0, TFHD_DEFAULT_BASE_IS_MOOF);
+	s_wb32(s, track->id);
+	box_end(out, tfhd);
+
+	size_t tfdt = full_box_begin(s, "tfdt", 1, 0);
+	s_wb64(s, track->base_time);
+	box_end(out, tfdt);
+
+	/* version 1 allows negative composition time offsets */
+	size_t trun = full_box_begin(s, "trun", 1, trun_flags);
+	s_wb32(s, (uint32_t)track->samples.num);
+	data_offset_pos = out->bytes.num;
+	s_wb32(s, 0);
+
+	for (size_t i = 0; i < track->samples.num; i++) {
+		const struct fmp4_sample *sample = &track->samples.array[i];
+
+		s_wb32(s, sample->duration);
+		s_wb32(s, sample->size);
+		s_wb32(s, sample->keyframe || !video ? SAMPLE_FLAGS_SYNC
+						     : SAMPLE_FLAGS_NON_SYNC);
+		if (video)
+			s_wb32(s, (uint32_t)sample->cts_offset);
+	}
+	box_end(out, trun);
+
+	box_end(out, traf);
+	return data_offset_pos;
+}
+
+void fmp4_write_fragment(struct array_output_data *out, uint32_t sequence,
+			 struct fmp4_track *tracks, size_t num_tracks)
+{
+	size_t data_offset_pos[FMP4_MAX_TRACKS] = {0};
+	struct serializer s;
+	size_t moof_size;
+	size_t data_size = 0;
+	size_t offset = 0;
+
+	assert(num_tracks <= FMP4_MAX_TRACKS);
+	array_output_serializer_init(&s, out);
+
+	size_t moof = box_begin(&s, "moof");
+
+	size_t mfhd = full_box_begin(&s, "mfhd", 0, 0);
+	s_wb32(&s, sequence);
+	box_end(out, mfhd);
+
+	for (size_t i = 0; i < num_tracks; i++) {
+		if (!fmp4_track_empty(&tracks[i]))
+			data_offset_pos[i] = write_traf(&s, out, &tracks[i]);
+	}
+
+	box_end(out, moof);
+	moof_size = out->bytes.num - moof;
+
+	/* sample data of every track follows the mdat header in track
+	 * order, and each trun points at its track's first sample relative
+	 * to the start of the moof */
+	for (size_t i = 0; i < num_tracks; i++) {
+		if (fmp4_track_empty(&tracks[i]))
+			continue;
+
+		patch_b32(out, data_offset_pos[i],
+			  (uint32_t)(moof_size + 8 + offset));
+		offset += tracks[i].data.num;
+	}
+
+	for (size_t i = 0; i < num_tracks; i++)
+		data_size += tracks[i].data.num;
+
+	s_wb32(&s, (uint32_t)(data_size + 8));
+	s_w4cc(&s, "mdat");
+
+	for (size_t i = 0; i < num_tracks; i++) {
+		struct fmp4_track *track = &tracks[i];
+
+		s_write(&s, track->data.array, track->data.num);
+		da_resize(track->samples, 0);
+		da_resize(track->data, 0);
+	}
+}
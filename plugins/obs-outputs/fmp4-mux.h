@@ -0,0 +1,91 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <obs.h>
+#include <util/darray.h>
+#include <util/array-serializer.h>
+
+/* Minimal fragmented MP4 writer for H.264 video and AAC audio.
+ *
+ * The init segment holds the sample descriptions of all tracks, and every
+ * fragment is a moof/mdat pair holding the samples that were queued on the
+ * tracks since the previous fragment.  Both writers initialize the output
+ * data, which is freed with array_output_serializer_free(). */
+
+#define FMP4_MAX_TRACKS 8
+
+struct fmp4_sample {
+	size_t offset;
+	uint32_t size;
+	uint32_t duration;
+	int32_t cts_offset;
+	bool keyframe;
+};
+
+struct fmp4_track {
+	uint32_t id;
+	enum obs_encoder_type type;
+	uint32_t timescale;
+
+	/* video */
+	uint32_t width;
+	uint32_t height;
+
+	/* audio */
+	uint32_t sample_rate;
+	uint32_t channels;
+
+	/* avcC record for video, AudioSpecificConfig for audio */
+	uint8_t *config;
+	size_t config_size;
+
+	/* decode time of the first queued sample, in timescale units */
+	uint64_t base_time;
+	uint64_t next_time;
+
+	DARRAY(struct fmp4_sample) samples;
+	DARRAY(uint8_t) data;
+};
+
+extern void fmp4_track_free(struct fmp4_track *track);
+
+extern void fmp4_track_add_sample(struct fmp4_track *track,
+				  const uint8_t *data, size_t size,
+				  uint32_t duration, int32_t cts_offset,
+				  bool keyframe);
+
+static inline bool fmp4_track_empty(const struct fmp4_track *track)
+{
+	return track->samples.num == 0;
+}
+
+/* duration of the queued samples, in timescale units */
+static inline uint64_t fmp4_track_duration(const struct fmp4_track *track)
+{
+	return track->next_time - track->base_time;
+}
+
+extern void fmp4_write_init_segment(struct array_output_data *out,
+				    const struct fmp4_track *tracks,
+				    size_t num_tracks);
+
+/* writes the queued samples of all tracks as one fragment and clears them */
+extern void fmp4_write_fragment(struct array_output_data *out,
+				uint32_t sequence, struct fmp4_track *tracks,
+				size_t num_tracks);
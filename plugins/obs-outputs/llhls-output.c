@@ -0,0 +1,610 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs-module.h>
+#include <obs-avc.h>
+#include <util/platform.h>
+#include <util/circlebuf.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include <util/curl/curl-helper.h>
+#include <inttypes.h>
+#include "llhls-segmenter.h"
+
+#define do_log(level, format, ...)                  \
+	blog(level, "[ll-hls output: '%s'] " format, \
+	     obs_output_get_name(stream->output), ##__VA_ARGS__)
+
+#define warn(format, ...) do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...) do_log(LOG_INFO, format, ##__VA_ARGS__)
+
+#define OPT_PATH "path"
+#define OPT_PLAYLIST_NAME "playlist_name"
+#define OPT_SEGMENT_DURATION "segment_duration_ms"
+#define OPT_PART_DURATION "part_duration_ms"
+#define OPT_PLAYLIST_SIZE "playlist_size"
+#define OPT_DELETE_SEGMENTS "delete_segments"
+
+/* consecutive failed uploads before the output gives up */
+#define MAX_HTTP_FAILURES 5
+
+struct llhls_output {
+	obs_output_t *output;
+
+	struct dstr path;
+	struct dstr playlist_name;
+	bool http;
+
+	volatile bool active;
+	volatile bool stopping;
+	volatile bool finishing;
+	volatile bool aborting;
+	uint64_t stop_ts;
+
+	pthread_mutex_t write_mutex;
+	os_sem_t *write_sem;
+	pthread_t write_thread;
+	bool write_thread_active;
+	struct circlebuf packets;
+
+	/* everything below is only used by the write thread */
+	CURL *curl;
+	int http_failures;
+	uint64_t total_bytes;
+	struct llhls_segmenter hls;
+};
+
+static inline bool active(struct llhls_output *stream)
+{
+	return os_atomic_load_bool(&stream->active);
+}
+
+static inline bool stopping(struct llhls_output *stream)
+{
+	return os_atomic_load_bool(&stream->stopping);
+}
+
+static const char *llhls_output_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return obs_module_text("LLHLSOutput");
+}
+
+/* ------------------------------------------------------------------------- */
+/* file targets */
+
+struct upload_data {
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+};
+
+static size_t upload_read(char *buffer, size_t size, size_t nitems,
+			  void *param)
+{
+	struct upload_data *upload = param;
+	size_t len = size * nitems;
+
+	if (len > upload->size - upload->pos)
+		len = upload->size - upload->pos;
+
+	memcpy(buffer, upload->data + upload->pos, len);
+	upload->pos += len;
+	return len;
+}
+
+static bool http_request(struct llhls_output *stream, const char *url,
+			 const char *method, const void *data, size_t size,
+			 const char *content_type)
+{
+	struct upload_data upload = {data, size, 0};
+	struct curl_slist *header = NULL;
+	struct dstr content_header = {0};
+	long response_code = 0;
+	CURLcode code;
+
+	curl_easy_reset(stream->curl);
+	curl_easy_setopt(stream->curl, CURLOPT_URL, url);
+	curl_easy_setopt(stream->curl, CURLOPT_USERAGENT, "libobs");
+	curl_easy_setopt(stream->curl, CURLOPT_NOSIGNAL, 1L);
+	curl_easy_setopt(stream->curl, CURLOPT_CONNECTTIMEOUT, 5L);
+	curl_easy_setopt(stream->curl, CURLOPT_TIMEOUT, 10L);
+	curl_obs_set_revoke_setting(stream->curl);
+
+	if (data) {
+		dstr_printf(&content_header, "Content-Type: %s", content_type);
+		header = curl_slist_append(header, content_header.array);
+
+		curl_easy_setopt(stream->curl, CURLOPT_UPLOAD, 1L);
+		curl_easy_setopt(stream->curl, CURLOPT_READFUNCTION,
+				 upload_read);
+		curl_easy_setopt(stream->curl, CURLOPT_READDATA, &upload);
+		curl_easy_setopt(stream->curl, CURLOPT_INFILESIZE_LARGE,
+				 (curl_off_t)size);
+		curl_easy_setopt(stream->curl, CURLOPT_HTTPHEADER, header);
+	} else {
+		curl_easy_setopt(stream->curl, CURLOPT_CUSTOMREQUEST, method);
+	}
+
+	code = curl_easy_perform(stream->curl);
+	if (code == CURLE_OK)
+		curl_easy_getinfo(stream->curl, CURLINFO_RESPONSE_CODE,
+				  &response_code);
+
+	curl_slist_free_all(header);
+	dstr_free(&content_header);
+
+	if (code != CURLE_OK) {
+		warn("%s '%s' failed: %s", method, url,
+		     curl_easy_strerror(code));
+		return false;
+	}
+	if (response_code < 200 || response_code >= 300) {
+		warn("%s '%s' failed: HTTP %ld", method, url, response_code);
+		return false;
+	}
+
+	return true;
+}
+
+static bool write_local_file(struct llhls_output *stream, const char *path,
+			     const void *data, size_t size)
+{
+	struct dstr temp_path = {0};
+	bool success = false;
+	FILE *file;
+
+	/* write to a temporary file first, so that readers never see a
+	 * partially written file */
+	dstr_printf(&temp_path, "%s.tmp", path);
+
+	file = os_fopen(temp_path.array, "wb");
+	if (!file) {
+		warn("Unable to open '%s'", temp_path.array);
+		goto cleanup;
+	}
+
+	success = fwrite(data, 1, size, file) == size;
+	fclose(file);
+
+	if (!success) {
+		warn("Unable to write '%s'", temp_path.array);
+		os_unlink(temp_path.array);
+		goto cleanup;
+	}
+
+	success = os_safe_replace(path, temp_path.array, NULL) == 0;
+	if (!success)
+		warn("Unable to replace '%s'", path);
+
+cleanup:
+	dstr_free(&temp_path);
+	return success;
+}
+
+static inline void get_target_path(struct llhls_output *stream,
+				   struct dstr *path, const char *name)
+{
+	dstr_copy_dstr(path, &stream->path);
+	if (!dstr_is_empty(path) && dstr_end(path) != '/')
+		dstr_cat_ch(path, '/');
+	dstr_cat(path, name);
+}
+
+static bool write_file(void *param, const char *name, const void *data,
+		       size_t size, const char *content_type)
+{
+	struct llhls_output *stream = param;
+	struct dstr path = {0};
+	bool success;
+
+	get_target_path(stream, &path, name);
+
+	if (stream->http) {
+		success = http_request(stream, path.array, "PUT", data, size,
+				       content_type);
+
+		/* an upload that failed only loses a part for the players,
+		 * so the output only stops if the server stays unreachable */
+		if (success)
+			stream->http_failures = 0;
+		else
+			success = ++stream->http_failures < MAX_HTTP_FAILURES;
+	} else {
+		success = write_local_file(stream, path.array, data, size);
+	}
+
+	stream->total_bytes += size;
+	dstr_free(&path);
+	return success;
+}
+
+static void delete_file(void *param, const char *name)
+{
+	struct llhls_output *stream = param;
+	struct dstr path = {0};
+
+	get_target_path(stream, &path, name);
+
+	if (stream->http)
+		http_request(stream, path.array, "DELETE", NULL, 0, NULL);
+	else
+		os_unlink(path.array);
+
+	dstr_free(&path);
+}
+
+/* ------------------------------------------------------------------------- */
+/* segmenter */
+
+static bool init_tracks(void *param, struct fmp4_track *tracks)
+{
+	struct llhls_output *stream = param;
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(stream->output);
+	obs_encoder_t *aencoder =
+		obs_output_get_audio_encoder(stream->output, 0);
+	struct fmp4_track *video = &tracks[LLHLS_VIDEO_TRACK];
+	struct fmp4_track *audio = &tracks[LLHLS_AUDIO_TRACK];
+	uint8_t *header;
+	size_t size;
+
+	if (!obs_encoder_get_extra_data(vencoder, &header, &size)) {
+		warn("No video codec header");
+		return false;
+	}
+	video->config_size = obs_parse_avc_header(&video->config, header, size);
+	video->width = obs_encoder_get_width(vencoder);
+	video->height = obs_encoder_get_height(vencoder);
+
+	if (!obs_encoder_get_extra_data(aencoder, &header, &size)) {
+		warn("No audio codec header");
+		return false;
+	}
+	audio->config = bmemdup(header, size);
+	audio->config_size = size;
+	audio->sample_rate = obs_encoder_get_sample_rate(aencoder);
+	audio->timescale = audio->sample_rate;
+	audio->channels = (uint32_t)audio_output_get_channels(
+		obs_encoder_audio(aencoder));
+	return true;
+}
+
+static void reset_state(struct llhls_output *stream)
+{
+	llhls_segmenter_reset(&stream->hls);
+	stream->http_failures = 0;
+}
+
+static void *write_thread(void *data)
+{
+	struct llhls_output *stream = data;
+	int code = stream->http ? OBS_OUTPUT_DISCONNECTED : OBS_OUTPUT_ERROR;
+
+	os_set_thread_name("ll-hls-output: write_thread");
+
+	while (os_sem_wait(stream->write_sem) == 0) {
+		struct encoder_packet packet;
+		bool has_packet = false;
+
+		if (os_atomic_load_bool(&stream->aborting))
+			return NULL;
+
+		pthread_mutex_lock(&stream->write_mutex);
+		if (stream->packets.size) {
+			circlebuf_pop_front(&stream->packets, &packet,
+					    sizeof(packet));
+			has_packet = true;
+		}
+		pthread_mutex_unlock(&stream->write_mutex);
+
+		if (has_packet) {
+			bool success =
+				llhls_segmenter_packet(&stream->hls, &packet);
+			obs_encoder_packet_release(&packet);
+			if (!success)
+				goto error;
+		} else if (os_atomic_load_bool(&stream->finishing)) {
+			if (!llhls_segmenter_finish(&stream->hls))
+				goto error;
+
+			os_atomic_set_bool(&stream->active, false);
+			obs_output_end_data_capture(stream->output);
+			info("LL-HLS output complete");
+			return NULL;
+		}
+	}
+
+	return NULL;
+
+error:
+	os_atomic_set_bool(&stream->active, false);
+	obs_output_signal_stop(stream->output, code);
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void free_packets(struct llhls_output *stream)
+{
+	while (stream->packets.size) {
+		struct encoder_packet packet;
+		circlebuf_pop_front(&stream->packets, &packet, sizeof(packet));
+		obs_encoder_packet_release(&packet);
+	}
+}
+
+/* can be called from any thread, the write thread is joined later */
+static void abort_write_thread(struct llhls_output *stream)
+{
+	if (!os_atomic_set_bool(&stream->aborting, true))
+		os_sem_post(stream->write_sem);
+}
+
+static void join_write_thread(struct llhls_output *stream, bool abort)
+{
+	if (!stream->write_thread_active)
+		return;
+
+	if (abort)
+		abort_write_thread(stream);
+
+	pthread_join(stream->write_thread, NULL);
+	stream->write_thread_active = false;
+}
+
+static void llhls_output_destroy(void *data)
+{
+	struct llhls_output *stream = data;
+
+	join_write_thread(stream, true);
+	free_packets(stream);
+	reset_state(stream);
+
+	if (stream->curl)
+		curl_easy_cleanup(stream->curl);
+
+	circlebuf_free(&stream->packets);
+	os_sem_destroy(stream->write_sem);
+	pthread_mutex_destroy(&stream->write_mutex);
+	dstr_free(&stream->path);
+	dstr_free(&stream->playlist_name);
+	bfree(stream);
+}
+
+static void *llhls_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct llhls_output *stream = bzalloc(sizeof(*stream));
+	stream->output = output;
+	pthread_mutex_init_value(&stream->write_mutex);
+
+	if (pthread_mutex_init(&stream->write_mutex, NULL) != 0)
+		goto fail;
+	if (os_sem_init(&stream->write_sem, 0) != 0)
+		goto fail;
+
+	stream->hls.param = stream;
+	stream->hls.init_tracks = init_tracks;
+	stream->hls.write_file = write_file;
+	stream->hls.delete_file = delete_file;
+
+	UNUSED_PARAMETER(settings);
+	return stream;
+
+fail:
+	llhls_output_destroy(stream);
+	return NULL;
+}
+
+static inline bool is_http_url(const char *path)
+{
+	return astrcmpi_n(path, "http://", 7) == 0 ||
+	       astrcmpi_n(path, "https://", 8) == 0;
+}
+
+static bool llhls_output_start(void *data)
+{
+	struct llhls_output *stream = data;
+	struct llhls_segmenter *hls = &stream->hls;
+	obs_data_t *settings;
+
+	if (!obs_output_can_begin_data_capture(stream->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(stream->output, 0))
+		return false;
+
+	/* a previous session might still be finishing up */
+	join_write_thread(stream, false);
+	free_packets(stream);
+	reset_state(stream);
+
+	settings = obs_output_get_settings(stream->output);
+	dstr_copy(&stream->path, obs_data_get_string(settings, OPT_PATH));
+	dstr_copy(&stream->playlist_name,
+		  obs_data_get_string(settings, OPT_PLAYLIST_NAME));
+	hls->segment_duration_ms =
+		obs_data_get_int(settings, OPT_SEGMENT_DURATION);
+	hls->part_duration_ms = obs_data_get_int(settings, OPT_PART_DURATION);
+	hls->playlist_size =
+		(size_t)obs_data_get_int(settings, OPT_PLAYLIST_SIZE);
+	hls->delete_segments = obs_data_get_bool(settings, OPT_DELETE_SEGMENTS);
+	obs_data_release(settings);
+
+	dstr_depad(&stream->path);
+	if (dstr_is_empty(&stream->path) ||
+	    dstr_is_empty(&stream->playlist_name)) {
+		warn("No output path or playlist name specified");
+		return false;
+	}
+
+	hls->playlist_name = stream->playlist_name.array;
+	if (hls->part_duration_ms <= 0)
+		hls->part_duration_ms = 333;
+	if (hls->segment_duration_ms < hls->part_duration_ms)
+		hls->segment_duration_ms = hls->part_duration_ms;
+	if (!hls->playlist_size)
+		hls->playlist_size = 1;
+
+	stream->http = is_http_url(stream->path.array);
+	if (stream->http) {
+		if (!stream->curl)
+			stream->curl = curl_easy_init();
+		if (!stream->curl) {
+			warn("Failed to initialize curl");
+			return false;
+		}
+	} else if (os_mkdirs(stream->path.array) == MKDIR_ERROR) {
+		warn("Unable to create directory '%s'", stream->path.array);
+		return false;
+	}
+
+	os_atomic_set_bool(&stream->stopping, false);
+	os_atomic_set_bool(&stream->finishing, false);
+	os_atomic_set_bool(&stream->aborting, false);
+	stream->total_bytes = 0;
+
+	stream->write_thread_active = pthread_create(&stream->write_thread,
+						     NULL, write_thread,
+						     stream) == 0;
+	if (!stream->write_thread_active) {
+		warn("Failed to create write thread");
+		return false;
+	}
+
+	os_atomic_set_bool(&stream->active, true);
+	obs_output_begin_data_capture(stream->output, 0);
+
+	info("Writing LL-HLS playlist '%s' to '%s' "
+	     "(segments: %" PRId64 " ms, parts: %" PRId64 " ms)",
+	     stream->playlist_name.array, stream->path.array,
+	     hls->segment_duration_ms, hls->part_duration_ms);
+	return true;
+}
+
+static void llhls_output_stop(void *data, uint64_t ts)
+{
+	struct llhls_output *stream = data;
+
+	/* the write thread was already told to stop on an encoder error */
+	if (os_atomic_load_bool(&stream->aborting)) {
+		join_write_thread(stream, false);
+		return;
+	}
+
+	stream->stop_ts = ts / 1000;
+	os_atomic_set_bool(&stream->stopping, true);
+}
+
+static void finish(struct llhls_output *stream)
+{
+	if (!os_atomic_set_bool(&stream->finishing, true))
+		os_sem_post(stream->write_sem);
+}
+
+static void llhls_output_data(void *data, struct encoder_packet *packet)
+{
+	struct llhls_output *stream = data;
+	struct encoder_packet new_packet;
+
+	if (!active(stream) || os_atomic_load_bool(&stream->finishing))
+		return;
+
+	/* encoder failure */
+	if (!packet) {
+		os_atomic_set_bool(&stream->active, false);
+		abort_write_thread(stream);
+		obs_output_signal_stop(stream->output, OBS_OUTPUT_ENCODE_ERROR);
+		return;
+	}
+
+	if (stopping(stream) &&
+	    packet->sys_dts_usec >= (int64_t)stream->stop_ts) {
+		finish(stream);
+		return;
+	}
+
+	obs_encoder_packet_ref(&new_packet, packet);
+
+	pthread_mutex_lock(&stream->write_mutex);
+	circlebuf_push_back(&stream->packets, &new_packet, sizeof(new_packet));
+	pthread_mutex_unlock(&stream->write_mutex);
+
+	os_sem_post(stream->write_sem);
+}
+
+static uint64_t llhls_output_total_bytes(void *data)
+{
+	struct llhls_output *stream = data;
+	return stream->total_bytes;
+}
+
+static void llhls_output_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_string(defaults, OPT_PLAYLIST_NAME,
+				    "index.m3u8");
+	obs_data_set_default_int(defaults, OPT_SEGMENT_DURATION, 2000);
+	obs_data_set_default_int(defaults, OPT_PART_DURATION, 333);
+	obs_data_set_default_int(defaults, OPT_PLAYLIST_SIZE, 6);
+	obs_data_set_default_bool(defaults, OPT_DELETE_SEGMENTS, true);
+}
+
+static obs_properties_t *llhls_output_properties(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+
+	obs_properties_t *props = obs_properties_create();
+	obs_property_t *p;
+
+	obs_properties_add_text(props, OPT_PATH,
+				obs_module_text("LLHLSOutput.Path"),
+				OBS_TEXT_DEFAULT);
+	obs_properties_add_text(props, OPT_PLAYLIST_NAME,
+				obs_module_text("LLHLSOutput.PlaylistName"),
+				OBS_TEXT_DEFAULT);
+
+	p = obs_properties_add_int(
+		props, OPT_SEGMENT_DURATION,
+		obs_module_text("LLHLSOutput.SegmentDuration"), 500, 10000,
+		100);
+	obs_property_int_set_suffix(p, " ms");
+	p = obs_properties_add_int(props, OPT_PART_DURATION,
+				   obs_module_text("LLHLSOutput.PartDuration"),
+				   100, 2000, 1);
+	obs_property_int_set_suffix(p, " ms");
+
+	obs_properties_add_int(props, OPT_PLAYLIST_SIZE,
+			       obs_module_text("LLHLSOutput.PlaylistSize"), 1,
+			       100, 1);
+	obs_properties_add_bool(props, OPT_DELETE_SEGMENTS,
+				obs_module_text("LLHLSOutput.DeleteSegments"));
+	return props;
+}
+
+struct obs_output_info llhls_output_info = {
+	.id = "llhls_output",
+	.flags = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED,
+	.encoded_video_codecs = "h264",
+	.encoded_audio_codecs = "aac",
+	.get_name = llhls_output_getname,
+	.create = llhls_output_create,
+	.destroy = llhls_output_destroy,
+	.start = llhls_output_start,
+	.stop = llhls_output_stop,
+	.encoded_packet = llhls_output_data,
+	.get_defaults = llhls_output_defaults,
+	.get_properties = llhls_output_properties,
+	.get_total_bytes = llhls_output_total_bytes,
+};
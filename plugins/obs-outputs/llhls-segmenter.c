@@ -0,0 +1,440 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <util/dstr.h>
+#include <util/util_uint64.h>
+#include <obs-avc.h>
+#include <inttypes.h>
+#include <math.h>
+#include "llhls-segmenter.h"
+
+/* segments that have left the playlist are kept around for a while longer,
+ * as players may still be downloading them */
+#define DELETE_THRESHOLD 2
+
+/* parts are only listed for the most recent segments */
+#define PART_SEGMENTS 2
+
+static inline bool write_file(struct llhls_segmenter *hls, const char *name,
+			      const void *data, size_t size,
+			      const char *content_type)
+{
+	return hls->write_file(hls->param, name, data, size, content_type);
+}
+
+static inline void delete_file(struct llhls_segmenter *hls, const char *name)
+{
+	if (hls->delete_file)
+		hls->delete_file(hls->param, name);
+}
+
+/* ------------------------------------------------------------------------- */
+/* playlist */
+
+static inline void get_segment_name(struct dstr *name, uint64_t idx)
+{
+	dstr_printf(name, "segment%" PRIu64 ".m4s", idx);
+}
+
+static inline void get_part_name(struct dstr *name, uint64_t idx, size_t part)
+{
+	dstr_printf(name, "segment%" PRIu64 ".%zu.m4s", idx, part);
+}
+
+static void cat_parts(struct dstr *playlist, const struct llhls_segment *seg)
+{
+	struct dstr name = {0};
+
+	for (size_t i = 0; i < seg->parts.num; i++) {
+		const struct llhls_part *part = &seg->parts.array[i];
+
+		get_part_name(&name, seg->idx, i);
+		dstr_catf(playlist, "#EXT-X-PART:DURATION=%.5f,URI=\"%s\"%s\n",
+			  part->duration, name.array,
+			  part->independent ? ",INDEPENDENT=YES" : "");
+	}
+
+	dstr_free(&name);
+}
+
+static bool write_playlist(struct llhls_segmenter *hls, bool ended)
+{
+	struct dstr playlist = {0};
+	struct dstr name = {0};
+	size_t first = 0;
+	double target = (double)hls->segment_duration_ms / 1000.0;
+	double part_target = (double)hls->part_duration_ms / 1000.0;
+	bool success;
+
+	if (hls->segments.num > hls->playlist_size)
+		first = hls->segments.num - hls->playlist_size;
+
+	for (size_t i = first; i < hls->segments.num; i++) {
+		if (hls->segments.array[i].duration > target)
+			target = hls->segments.array[i].duration;
+	}
+
+	dstr_copy(&playlist, "#EXTM3U\n");
+	dstr_cat(&playlist, "#EXT-X-VERSION:9\n");
+	dstr_cat(&playlist, "#EXT-X-INDEPENDENT-SEGMENTS\n");
+	dstr_catf(&playlist, "#EXT-X-TARGETDURATION:%d\n", (int)ceil(target));
+	dstr_catf(&playlist, "#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=%.3f\n",
+		  part_target * 3.0);
+	dstr_catf(&playlist, "#EXT-X-PART-INF:PART-TARGET=%.3f\n",
+		  part_target);
+	dstr_catf(&playlist, "#EXT-X-MEDIA-SEQUENCE:%" PRIu64 "\n",
+		  first < hls->segments.num ? hls->segments.array[first].idx
+					    : hls->cur_segment.idx);
+	dstr_cat(&playlist,
+		 "#EXT-X-MAP:URI=\"" LLHLS_INIT_SEGMENT_NAME "\"\n");
+
+	for (size_t i = first; i < hls->segments.num; i++) {
+		const struct llhls_segment *seg = &hls->segments.array[i];
+
+		if (i + PART_SEGMENTS >= hls->segments.num)
+			cat_parts(&playlist, seg);
+
+		get_segment_name(&name, seg->idx);
+		dstr_catf(&playlist, "#EXTINF:%.5f,\n%s\n", seg->duration,
+			  name.array);
+	}
+
+	if (ended) {
+		dstr_cat(&playlist, "#EXT-X-ENDLIST\n");
+	} else {
+		cat_parts(&playlist, &hls->cur_segment);
+
+		get_part_name(&name, hls->cur_segment.idx,
+			      hls->cur_segment.parts.num);
+		dstr_catf(&playlist,
+			  "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s\"\n",
+			  name.array);
+	}
+
+	success = write_file(hls, hls->playlist_name, playlist.array,
+			     playlist.len, "application/vnd.apple.mpegurl");
+
+	dstr_free(&playlist);
+	dstr_free(&name);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* segmenting */
+
+static void free_segment(struct llhls_segmenter *hls,
+			 struct llhls_segment *seg, bool delete_files)
+{
+	if (delete_files) {
+		struct dstr name = {0};
+
+		for (size_t i = 0; i < seg->parts.num; i++) {
+			get_part_name(&name, seg->idx, i);
+			delete_file(hls, name.array);
+		}
+
+		get_segment_name(&name, seg->idx);
+		delete_file(hls, name.array);
+		dstr_free(&name);
+	}
+
+	da_free(seg->parts);
+}
+
+static inline int64_t to_timescale(const struct fmp4_track *track,
+				   int64_t usec)
+{
+	return (int64_t)util_mul_div64(usec, track->timescale, 1000000);
+}
+
+static inline double to_seconds(const struct fmp4_track *track, int64_t time)
+{
+	return (double)time / (double)track->timescale;
+}
+
+static bool write_init_segment(struct llhls_segmenter *hls)
+{
+	struct array_output_data init;
+	bool success;
+
+	if (!hls->init_tracks(hls->param, hls->tracks))
+		return false;
+
+	fmp4_write_init_segment(&init, hls->tracks, LLHLS_NUM_TRACKS);
+	success = write_file(hls, LLHLS_INIT_SEGMENT_NAME, init.bytes.array,
+			     init.bytes.num, "video/mp4");
+	array_output_serializer_free(&init);
+	return success;
+}
+
+static bool end_part(struct llhls_segmenter *hls, int64_t end)
+{
+	struct fmp4_track *video = &hls->tracks[LLHLS_VIDEO_TRACK];
+	struct llhls_segment *seg = &hls->cur_segment;
+	struct array_output_data fragment;
+	struct dstr name = {0};
+	struct llhls_part part;
+	bool success;
+
+	if (fmp4_track_empty(video))
+		return true;
+
+	part.duration = to_seconds(video, end - hls->part_start);
+	part.independent = video->samples.array[0].keyframe;
+
+	fmp4_write_fragment(&fragment, ++hls->sequence, hls->tracks,
+			    LLHLS_NUM_TRACKS);
+
+	get_part_name(&name, seg->idx, seg->parts.num);
+	success = write_file(hls, name.array, fragment.bytes.array,
+			     fragment.bytes.num, "video/mp4");
+
+	/* the full segment is the concatenation of its parts */
+	da_push_back_array(hls->segment_data.bytes, fragment.bytes.array,
+			   fragment.bytes.num);
+	da_push_back(seg->parts, &part);
+	hls->part_start = end;
+
+	array_output_serializer_free(&fragment);
+	dstr_free(&name);
+	return success;
+}
+
+static bool end_segment(struct llhls_segmenter *hls, int64_t end)
+{
+	struct fmp4_track *video = &hls->tracks[LLHLS_VIDEO_TRACK];
+	struct llhls_segment *seg = &hls->cur_segment;
+	struct dstr name = {0};
+	bool success;
+
+	if (!seg->parts.num)
+		return true;
+
+	seg->duration = to_seconds(video, end - hls->segment_start);
+
+	get_segment_name(&name, seg->idx);
+	success = write_file(hls, name.array, hls->segment_data.bytes.array,
+			     hls->segment_data.bytes.num, "video/mp4");
+	dstr_free(&name);
+
+	da_push_back(hls->segments, seg);
+	da_resize(hls->segment_data.bytes, 0);
+	hls->cur_segment.idx++;
+	da_init(hls->cur_segment.parts);
+	hls->segment_start = end;
+
+	while (hls->segments.num > hls->playlist_size + DELETE_THRESHOLD) {
+		free_segment(hls, &hls->segments.array[0],
+			     hls->delete_segments);
+		da_erase(hls->segments, 0);
+	}
+
+	return success;
+}
+
+static void flush_pending(struct llhls_segmenter *hls, size_t track_idx,
+			  int64_t end)
+{
+	struct llhls_pending *pending = &hls->pending[track_idx];
+	struct encoder_packet *packet = &pending->packet;
+	struct fmp4_track *track = &hls->tracks[track_idx];
+	int64_t cts_offset = (packet->pts - packet->dts) * packet->timebase_num;
+
+	if (!pending->valid)
+		return;
+
+	fmp4_track_add_sample(track, packet->data, packet->size,
+			      (uint32_t)(end - pending->time),
+			      (int32_t)cts_offset, packet->keyframe);
+
+	obs_encoder_packet_release(packet);
+	pending->valid = false;
+}
+
+/* cuts the stream before a video frame that starts at the given time */
+static bool check_cut(struct llhls_segmenter *hls, int64_t time,
+		      bool keyframe)
+{
+	struct fmp4_track *video = &hls->tracks[LLHLS_VIDEO_TRACK];
+	int64_t segment_target =
+		to_timescale(video, hls->segment_duration_ms * 1000);
+	int64_t part_target = to_timescale(video, hls->part_duration_ms * 1000);
+	int64_t frame_duration = 0;
+
+	if (video->samples.num)
+		frame_duration = video->samples.array[video->samples.num - 1]
+					 .duration;
+
+	/* segments can only begin with a keyframe */
+	if (keyframe && time - hls->segment_start >= segment_target) {
+		bool success = end_part(hls, time);
+		success = end_segment(hls, time) && success;
+		return write_playlist(hls, false) && success;
+	}
+
+	/* parts must never be longer than the part target, so end the part
+	 * if the next frame would not fit in it anymore */
+	if (time + frame_duration - hls->part_start > part_target) {
+		bool success = end_part(hls, time);
+		return write_playlist(hls, false) && success;
+	}
+
+	return true;
+}
+
+static bool add_video_packet(struct llhls_segmenter *hls,
+			     struct encoder_packet *packet)
+{
+	struct llhls_pending *pending = &hls->pending[LLHLS_VIDEO_TRACK];
+	struct fmp4_track *video = &hls->tracks[LLHLS_VIDEO_TRACK];
+	int64_t time;
+
+	if (!hls->started) {
+		/* the first segment has to start with a keyframe */
+		if (!packet->keyframe)
+			return true;
+
+		video->timescale = (uint32_t)packet->timebase_den;
+		if (!write_init_segment(hls))
+			return false;
+
+		hls->origin_usec = packet->dts_usec;
+		hls->time_offset[LLHLS_VIDEO_TRACK] =
+			-packet->dts * packet->timebase_num;
+		hls->started = true;
+	}
+
+	time = packet->dts * packet->timebase_num +
+	       hls->time_offset[LLHLS_VIDEO_TRACK];
+
+	flush_pending(hls, LLHLS_VIDEO_TRACK, time);
+	if (!check_cut(hls, time, packet->keyframe))
+		return false;
+
+	obs_parse_avc_packet(&pending->packet, packet);
+	pending->time = time;
+	pending->valid = true;
+	return true;
+}
+
+static void add_audio_packet(struct llhls_segmenter *hls,
+			     struct encoder_packet *packet)
+{
+	struct llhls_pending *pending = &hls->pending[LLHLS_AUDIO_TRACK];
+	struct fmp4_track *audio = &hls->tracks[LLHLS_AUDIO_TRACK];
+	int64_t time;
+
+	if (!hls->started)
+		return;
+
+	/* align the audio timeline with the first video frame */
+	if (!hls->track_started[LLHLS_AUDIO_TRACK]) {
+		int64_t start = packet->dts_usec - hls->origin_usec;
+		if (start < 0)
+			return;
+
+		hls->time_offset[LLHLS_AUDIO_TRACK] =
+			to_timescale(audio, start) -
+			packet->dts * packet->timebase_num;
+		hls->track_started[LLHLS_AUDIO_TRACK] = true;
+	}
+
+	time = packet->dts * packet->timebase_num +
+	       hls->time_offset[LLHLS_AUDIO_TRACK];
+
+	flush_pending(hls, LLHLS_AUDIO_TRACK, time);
+
+	obs_encoder_packet_ref(&pending->packet, packet);
+	pending->time = time;
+	pending->valid = true;
+}
+
+bool llhls_segmenter_finish(struct llhls_segmenter *hls)
+{
+	struct fmp4_track *video = &hls->tracks[LLHLS_VIDEO_TRACK];
+	int64_t end;
+
+	if (!hls->started)
+		return true;
+
+	/* the last samples keep the duration of their predecessors */
+	for (size_t i = 0; i < LLHLS_NUM_TRACKS; i++) {
+		struct llhls_pending *pending = &hls->pending[i];
+		struct fmp4_track *track = &hls->tracks[i];
+		int64_t duration = 0;
+
+		if (!pending->valid)
+			continue;
+
+		if (track->samples.num)
+			duration = track->samples.array[track->samples.num - 1]
+					   .duration;
+		else if (i == LLHLS_VIDEO_TRACK)
+			duration = pending->packet.timebase_num;
+		else
+			duration = obs_encoder_get_frame_size(
+				pending->packet.encoder);
+
+		flush_pending(hls, i, pending->time + duration);
+	}
+
+	end = (int64_t)video->next_time;
+
+	bool success = end_part(hls, end);
+	success = end_segment(hls, end) && success;
+	return write_playlist(hls, true) && success;
+}
+
+bool llhls_segmenter_packet(struct llhls_segmenter *hls,
+			    struct encoder_packet *packet)
+{
+	if (packet->type == OBS_ENCODER_VIDEO)
+		return add_video_packet(hls, packet);
+
+	add_audio_packet(hls, packet);
+	return true;
+}
+
+void llhls_segmenter_reset(struct llhls_segmenter *hls)
+{
+	for (size_t i = 0; i < LLHLS_NUM_TRACKS; i++) {
+		if (hls->pending[i].valid)
+			obs_encoder_packet_release(&hls->pending[i].packet);
+
+		fmp4_track_free(&hls->tracks[i]);
+		hls->tracks[i].id = (uint32_t)i + 1;
+		hls->tracks[i].type = i == LLHLS_VIDEO_TRACK
+					      ? OBS_ENCODER_VIDEO
+					      : OBS_ENCODER_AUDIO;
+		hls->pending[i].valid = false;
+		hls->time_offset[i] = 0;
+		hls->track_started[i] = false;
+	}
+
+	for (size_t i = 0; i < hls->segments.num; i++)
+		free_segment(hls, &hls->segments.array[i], false);
+	da_free(hls->segments);
+	free_segment(hls, &hls->cur_segment, false);
+	array_output_serializer_free(&hls->segment_data);
+
+	hls->cur_segment.idx = 0;
+	hls->started = false;
+	hls->sequence = 0;
+	hls->part_start = 0;
+	hls->segment_start = 0;
+}
+
@@ -0,0 +1,96 @@
+/******************************************************************************
+    Copyright (C) 2023 by Lain Bailey <lain@obsproject.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "fmp4-mux.h"
+
+/* LL-HLS segmenter
+ *
+ * Cuts interleaved H.264/AAC encoder packets into fragmented MP4 parts and
+ * segments and writes the playlist after every part.  Files are handed to the
+ * write_file callback by name, so the segmenter doesn't care where they
+ * end up.  A part ends as soon as the next video frame would make it longer
+ * than the part target, and a segment ends on the first keyframe after the
+ * segment target. */
+
+#define LLHLS_VIDEO_TRACK 0
+#define LLHLS_AUDIO_TRACK 1
+#define LLHLS_NUM_TRACKS 2
+
+#define LLHLS_INIT_SEGMENT_NAME "init.mp4"
+
+struct llhls_part {
+	double duration;
+	bool independent;
+};
+
+struct llhls_segment {
+	uint64_t idx;
+	double duration;
+	DARRAY(struct llhls_part) parts;
+};
+
+/* the duration of a sample is only known once the next sample of its track
+ * arrives, so the last packet of each track is held back */
+struct llhls_pending {
+	struct encoder_packet packet;
+	int64_t time;
+	bool valid;
+};
+
+struct llhls_segmenter {
+	/* settings, set before the first packet */
+	const char *playlist_name;
+	int64_t segment_duration_ms;
+	int64_t part_duration_ms;
+	size_t playlist_size;
+	bool delete_segments;
+
+	void *param;
+
+	/* fills in the codec configuration of the tracks, called on the
+	 * first keyframe right before the init segment is written */
+	bool (*init_tracks)(void *param, struct fmp4_track *tracks);
+	bool (*write_file)(void *param, const char *name, const void *data,
+			   size_t size, const char *content_type);
+	void (*delete_file)(void *param, const char *name);
+
+	struct fmp4_track tracks[LLHLS_NUM_TRACKS];
+	struct llhls_pending pending[LLHLS_NUM_TRACKS];
+	int64_t time_offset[LLHLS_NUM_TRACKS];
+	bool track_started[LLHLS_NUM_TRACKS];
+	int64_t origin_usec;
+	bool started;
+
+	uint32_t sequence;
+	int64_t part_start;
+	int64_t segment_start;
+	struct array_output_data segment_data;
+	struct llhls_segment cur_segment;
+	DARRAY(struct llhls_segment) segments;
+};
+
+/* frees everything queued or written so far, keeping the settings */
+extern void llhls_segmenter_reset(struct llhls_segmenter *hls);
+
+/* returns false if a file could not be written */
+extern bool llhls_segmenter_packet(struct llhls_segmenter *hls,
+				   struct encoder_packet *packet);
+
+/* writes out what is left and ends the playlist */
+extern bool llhls_segmenter_finish(struct llhls_segmenter *hls);
@@ -44,6 +44,10 @@
 #define MIN_ESTIMATE_DURATION_MS 1000
 #define MAX_ESTIMATE_DURATION_MS 2000
 
+/* send pacing: the bucket holds this much of the paced rate */
+#define PACING_BURST_MSEC 50
+#define PACING_MIN_BURST (16 * 1024)
+
 static const char *rtmp_stream_getname(void *unused)
 {
 	UNUSED_PARAMETER(unused);
@@ -413,6 +417,80 @@ static int handle_socket_read(struct rtmp_stream *stream)
 	return 0;
 }
 
+static void update_pacer_rate(struct rtmp_stream *stream)
+{
+	long bitrate = os_atomic_load_long(&stream->pacing_bitrate);
+	uint64_t rate;
+	uint64_t burst;
+
+	if (bitrate == stream->pacer_bitrate)
+		return;
+
+	rate = (uint64_t)((double)bitrate * 1000.0 / 8.0 *
+			  stream->pacing_multiplier);
+	burst = rate * PACING_BURST_MSEC / 1000;
+	if (burst < PACING_MIN_BURST)
+		burst = PACING_MIN_BURST;
+
+	pacer_set_rate(&stream->pacer, rate, burst);
+	stream->pacer_bitrate = bitrate;
+}
+
+static int paced_send(RTMPSockBuf *sb, const char *data, int len, void *arg)
+{
+	struct rtmp_stream *stream = arg;
+
+	update_pacer_rate(stream);
+	pacer_wait(&stream->pacer, (size_t)len, stream->pacer_priority);
+
+	if (stream->pacer_send_func)
+		return stream->pacer_send_func(sb, data, len,
+					       stream->pacer_send_param);
+	return RTMPSockBuf_Send(sb, data, len);
+}
+
+/* librtmp hands every chunk of a packet to the send function separately, so
+ * pacing is done there to split up the bursts of large packets */
+static void start_pacing(struct rtmp_stream *stream)
+{
+	if (!stream->pacing_enabled)
+		return;
+
+	if (stream->rtmp.m_bCustomSend) {
+		stream->pacer_send_func = stream->rtmp.m_customSendFunc;
+		stream->pacer_send_param = stream->rtmp.m_customSendParam;
+	} else {
+		stream->pacer_send_func = NULL;
+		stream->pacer_send_param = NULL;
+	}
+
+	pacer_init(&stream->pacer, 0, 0);
+	stream->pacer_priority = PACER_PRIORITY_URGENT;
+	stream->pacer_bitrate = 0;
+	update_pacer_rate(stream);
+
+	stream->rtmp.m_bCustomSend = true;
+	stream->rtmp.m_customSendFunc = paced_send;
+	stream->rtmp.m_customSendParam = stream;
+
+	info("Send pacing enabled at %.1fx the stream bitrate",
+	     stream->pacing_multiplier);
+}
+
+static void log_pacing_stats(struct rtmp_stream *stream)
+{
+	const struct pacer_stats *stats = &stream->pacer.stats;
+
+	if (!stream->pacing_enabled || !stats->sends)
+		return;
+
+	info("Send pacing: %" PRIu64 " of %" PRIu64 " chunks delayed, "
+	     "average delay %.2f ms, max delay %.2f ms",
+	     stats->delayed_sends, stats->sends,
+	     pacer_avg_delay_ms(&stream->pacer),
+	     (double)stats->max_delay_ns / 1000000.0);
+}
+
 static int send_packet(struct rtmp_stream *stream,
 		       struct encoder_packet *packet, bool is_header,
 		       size_t idx)
@@ -663,6 +741,11 @@ static void *send_thread(void *data)
 			dbr_frame.size = packet.size;
 		}
 
+		/* audio is small and latency sensitive, only video is held
+		 * back by the pacer */
+		if (packet.type == OBS_ENCODER_VIDEO)
+			stream->pacer_priority = PACER_PRIORITY_NORMAL;
+
 		int sent;
 		if (packet.type == OBS_ENCODER_VIDEO &&
 		    stream->video_codec != CODEC_H264) {
@@ -672,6 +755,8 @@ static void *send_thread(void *data)
 					   packet.track_idx);
 		}
 
+		stream->pacer_priority = PACER_PRIORITY_URGENT;
+
 		if (sent < 0) {
 			os_atomic_set_bool(&stream->disconnected, true);
 			break;
@@ -702,6 +787,8 @@ static void *send_thread(void *data)
 	log_sndbuf_size(stream);
 #endif
 
+	log_pacing_stats(stream);
+
 	if (stream->new_socket_loop) {
 		os_event_signal(stream->send_thread_signaled_exit);
 		os_event_signal(stream->buffer_has_data_event);
@@ -1051,6 +1138,8 @@ static int init_send(struct rtmp_stream *stream)
 #endif
 	}
 
+	start_pacing(stream);
+
 	os_atomic_set_bool(&stream->active, true);
 
 	if (!send_meta_data(stream)) {
@@ -1296,6 +1385,20 @@ static bool init_connect(struct rtmp_stream *stream)
 		info("Dynamic bitrate enabled.  Dropped frames begone!");
 	}
 
+	stream->pacing_enabled = obs_data_get_bool(settings, OPT_PACING_ENABLED);
+	stream->pacing_multiplier =
+		obs_data_get_double(settings, OPT_PACING_MULTIPLIER);
+	if (stream->pacing_multiplier < 1.0)
+		stream->pacing_multiplier = 1.0;
+	os_atomic_set_long(&stream->pacing_bitrate,
+			   stream->dbr_orig_bitrate + stream->audio_bitrate);
+
+	if (stream->pacing_enabled && stream->dbr_orig_bitrate <= 0) {
+		stream->pacing_enabled = false;
+		info("Send pacing disabled. "
+		     "The encoder does not use a target bitrate.");
+	}
+
 	obs_data_release(vsettings);
 	obs_data_release(asettings);
 
@@ -1530,6 +1633,9 @@ static void dbr_set_bitrate(struct rtmp_stream *stream)
 	obs_data_set_int(settings, "bitrate", stream->dbr_cur_bitrate);
 	obs_encoder_update(vencoder, settings);
 
+	os_atomic_set_long(&stream->pacing_bitrate,
+			   stream->dbr_cur_bitrate + stream->audio_bitrate);
+
 	obs_data_release(settings);
 }
 
@@ -1702,6 +1808,8 @@ static void rtmp_stream_defaults(obs_data_t *defaults)
 	obs_data_set_default_int(defaults, OPT_PFRAME_DROP_THRESHOLD, 900);
 	obs_data_set_default_int(defaults, OPT_MAX_SHUTDOWN_TIME_SEC, 30);
 	obs_data_set_default_string(defaults, OPT_BIND_IP, "default");
+	obs_data_set_default_bool(defaults, OPT_PACING_ENABLED, false);
+	obs_data_set_default_double(defaults, OPT_PACING_MULTIPLIER, 1.5);
 #ifdef _WIN32
 	obs_data_set_default_bool(defaults, OPT_NEWSOCKETLOOP_ENABLED, false);
 	obs_data_set_default_bool(defaults, OPT_LOWLATENCY_ENABLED, false);
@@ -1735,6 +1843,12 @@ static obs_properties_t *rtmp_stream_properties(void *unused)
 	}
 	netif_saddr_data_free(&addrs);
 
+	obs_properties_add_bool(props, OPT_PACING_ENABLED,
+				obs_module_text("RTMPStream.Pacing"));
+	obs_properties_add_float_slider(
+		props, OPT_PACING_MULTIPLIER,
+		obs_module_text("RTMPStream.PacingMultiplier"), 1.0, 4.0, 0.1);
+
 #ifdef _WIN32
 	obs_properties_add_bool(props, OPT_NEWSOCKETLOOP_ENABLED,
 				obs_module_text("RTMPStream.NewSocketLoop"));
@@ -3,6 +3,7 @@
 #include <util/circlebuf.h>
 #include <util/dstr.h>
 #include <util/threading.h>
+#include <util/pacer.h>
 #include <inttypes.h>
 #include "librtmp/rtmp.h"
 #include "librtmp/log.h"
@@ -31,6 +32,8 @@
 #define OPT_NEWSOCKETLOOP_ENABLED "new_socket_loop_enabled"
 #define OPT_LOWLATENCY_ENABLED "low_latency_mode_enabled"
 #define OPT_METADATA_MULTITRACK "metadata_multitrack"
+#define OPT_PACING_ENABLED "pacing_enabled"
+#define OPT_PACING_MULTIPLIER "pacing_multiplier"
 
 //#define TEST_FRAMEDROPS
 //#define TEST_FRAMEDROPS_WITH_BITRATE_SHORTCUTS
@@ -112,6 +115,16 @@ struct rtmp_stream {
 	long dbr_inc_bitrate;
 	bool dbr_enabled;
 
+	/* send pacing, applied to every chunk handed to the socket */
+	bool pacing_enabled;
+	double pacing_multiplier;
+	volatile long pacing_bitrate;
+	long pacer_bitrate;
+	struct pacer pacer;
+	enum pacer_priority pacer_priority;
+	CUSTOMSEND pacer_send_func;
+	void *pacer_send_param;
+
 	enum video_id_t video_codec;
 
 	RTMP rtmp;
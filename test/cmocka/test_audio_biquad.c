@@ -0,0 +1,359 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <math.h>
+#include <string.h>
+
+#include <audio-biquad.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+#define SAMPLE_RATE 48000.0
+#define LANES 6
+#define STAGES 5
+#define FRAMES 4801
+
+static uint32_t rand_state = 1;
+
+static float rand_sample(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (float)(rand_state >> 8) / (float)(1 << 23) - 1.0f;
+}
+
+static inline double to_db(double mul)
+{
+	return 20.0 * log10(mul);
+}
+
+/* straightforward transposed direct form II, one lane at a time */
+static void ref_process(const struct audio_biquad *bq, float (*state)[2],
+			size_t stages, float *data, size_t frames)
+{
+	for (size_t i = 0; i < frames; i++) {
+		float x = data[i];
+
+		for (size_t s = 0; s < stages; s++) {
+			const float y = bq[s].b0 * x + state[s][0];
+
+			state[s][0] =
+				bq[s].b1 * x - bq[s].a1 * y + state[s][1];
+			state[s][1] = bq[s].b2 * x - bq[s].a2 * y;
+			x = y;
+		}
+
+		data[i] = x;
+	}
+}
+
+static void design_lane(struct audio_biquad *bq, size_t lane)
+{
+	static const enum audio_biquad_type types[] = {
+		AUDIO_BIQUAD_PEAK,      AUDIO_BIQUAD_LOW_SHELF,
+		AUDIO_BIQUAD_HIGH_SHELF, AUDIO_BIQUAD_LOWPASS,
+		AUDIO_BIQUAD_HIGHPASS,  AUDIO_BIQUAD_BANDPASS,
+		AUDIO_BIQUAD_NOTCH,
+	};
+
+	for (size_t s = 0; s < STAGES; s++) {
+		const size_t n = lane * STAGES + s;
+		audio_biquad_design(&bq[s], types[n % 7], SAMPLE_RATE,
+				    40.0 * pow(1.6, (double)(n % 17)),
+				    0.5 + 0.3 * (double)(n % 5),
+				    -12.0 + 3.0 * (double)(n % 9));
+	}
+}
+
+static void reference_test(void **state)
+{
+	struct audio_biquad_bank *bank = bzalloc(sizeof(*bank));
+	struct audio_biquad bq[LANES][STAGES];
+	float ref_state[LANES][STAGES][2] = {0};
+	float *in[LANES], *out[LANES], *ref[LANES];
+	float max_err = 0.0f;
+
+	UNUSED_PARAMETER(state);
+
+	audio_biquad_bank_init(bank, LANES, STAGES);
+
+	for (size_t l = 0; l < LANES; l++) {
+		design_lane(bq[l], l);
+		for (size_t s = 0; s < STAGES; s++)
+			audio_biquad_bank_set(bank, l, s, &bq[l][s]);
+
+		in[l] = bmalloc(FRAMES * sizeof(float));
+		ref[l] = bmalloc(FRAMES * sizeof(float));
+		for (size_t i = 0; i < FRAMES; i++)
+			in[l][i] = ref[l][i] = rand_sample() * 0.5f;
+
+		/* odd lanes filter in place, the rest into their own buffer */
+		out[l] = (l & 1) ? in[l] : bmalloc(FRAMES * sizeof(float));
+	}
+
+	/* uneven block sizes so the chunk and transpose tails are covered */
+	for (size_t i = 0, block = 1; i < FRAMES; i += block, block += 97) {
+		float *block_out[LANES];
+		const float *block_in[LANES];
+
+		if (block > FRAMES - i)
+			block = FRAMES - i;
+
+		for (size_t l = 0; l < LANES; l++) {
+			block_in[l] = in[l] + i;
+			block_out[l] = out[l] + i;
+		}
+		audio_biquad_bank_process(bank, block_out, block_in, block);
+	}
+
+	for (size_t l = 0; l < LANES; l++) {
+		ref_process(bq[l], ref_state[l], STAGES, ref[l], FRAMES);
+
+		for (size_t i = 0; i < FRAMES; i++) {
+			const float err = fabsf(out[l][i] - ref[l][i]);
+			if (err > max_err)
+				max_err = err;
+		}
+	}
+
+	print_message("max difference from reference: %g\n", max_err);
+	assert_true(max_err < 1e-5f);
+
+	/* NULL inputs are silence, and silence rings out to exactly zero */
+	for (int i = 0; i < 200; i++) {
+		float *discard[LANES] = {NULL};
+		const float *silence[LANES] = {NULL};
+		audio_biquad_bank_process(bank, discard, silence, 480);
+	}
+	for (size_t l = 0; l < LANES; l++)
+		in[l][0] = 0.0f;
+	audio_biquad_bank_process(bank, out, (const float *const *)in, 1);
+	for (size_t l = 0; l < LANES; l++)
+		assert_true(out[l][0] == 0.0f);
+
+	for (size_t l = 0; l < LANES; l++) {
+		if (out[l] != in[l])
+			bfree(out[l]);
+		bfree(in[l]);
+		bfree(ref[l]);
+	}
+	bfree(bank);
+}
+
+static void check_db(const struct audio_biquad *bq, double freq,
+		     double expected_db, double tolerance)
+{
+	const double db = to_db(audio_biquad_response(bq, 1, SAMPLE_RATE,
+						      freq));
+
+	if (fabs(db - expected_db) > tolerance)
+		fail_msg("%g Hz: %g dB, expected %g dB", freq, db,
+			 expected_db);
+}
+
+static void design_test(void **state)
+{
+	struct audio_biquad bq;
+
+	UNUSED_PARAMETER(state);
+
+	audio_biquad_design(&bq, AUDIO_BIQUAD_PEAK, SAMPLE_RATE, 1000.0, 1.0,
+			    6.0);
+	check_db(&bq, 1000.0, 6.0, 0.01);
+	check_db(&bq, 20.0, 0.0, 0.05);
+	check_db(&bq, 20000.0, 0.0, 0.05);
+
+	audio_biquad_design(&bq, AUDIO_BIQUAD_PEAK, SAMPLE_RATE, 3000.0, 4.0,
+			    -12.0);
+	check_db(&bq, 3000.0, -12.0, 0.01);
+
+	audio_biquad_design(&bq, AUDIO_BIQUAD_LOW_SHELF, SAMPLE_RATE, 200.0,
+			    0.707, -8.0);
+	check_db(&bq, 10.0, -8.0, 0.05);
+	check_db(&bq, 200.0, -4.0, 0.05);
+	check_db(&bq, 10000.0, 0.0, 0.05);
+
+	audio_biquad_design(&bq, AUDIO_BIQUAD_HIGH_SHELF, SAMPLE_RATE, 8000.0,
+			    0.707, 5.0);
+	check_db(&bq, 20.0, 0.0, 0.05);
+	check_db(&bq, 8000.0, 2.5, 0.05);
+	check_db(&bq, 23900.0, 5.0, 0.05);
+
+	audio_biquad_design(&bq, AUDIO_BIQUAD_LOWPASS, SAMPLE_RATE, 2000.0,
+			    M_SQRT1_2, 0.0);
+	check_db(&bq, 20.0, 0.0, 0.01);
+	check_db(&bq, 2000.0, -3.01, 0.02);
+	assert_true(to_db(audio_biquad_response(&bq, 1, SAMPLE_RATE,
+						 16000.0)) < -36.0);
+
+	audio_biquad_design(&bq, AUDIO_BIQUAD_HIGHPASS, SAMPLE_RATE, 100.0,
+			    M_SQRT1_2, 0.0);
+	check_db(&bq, 100.0, -3.01, 0.02);
+	check_db(&bq, 10000.0, 0.0, 0.01);
+
+	audio_biquad_design(&bq, AUDIO_BIQUAD_BANDPASS, SAMPLE_RATE, 1500.0,
+			    2.0, 0.0);
+	check_db(&bq, 1500.0, 0.0, 0.01);
+	assert_true(to_db(audio_biquad_response(&bq, 1, SAMPLE_RATE, 150.0)) <
+		    -20.0);
+
+	audio_biquad_design(&bq, AUDIO_BIQUAD_NOTCH, SAMPLE_RATE, 60.0, 10.0,
+			    0.0);
+	/* the depth is limited by the precision of float coefficients */
+	assert_true(to_db(audio_biquad_response(&bq, 1, SAMPLE_RATE, 60.0)) <
+		    -40.0);
+	check_db(&bq, 1000.0, 0.0, 0.01);
+
+	audio_biquad_design(&bq, AUDIO_BIQUAD_BYPASS, SAMPLE_RATE, 1000.0, 1.0,
+			    12.0);
+	check_db(&bq, 1000.0, 0.0, 0.0);
+
+	/* out of range frequencies are clamped instead of blowing up */
+	audio_biquad_design(&bq, AUDIO_BIQUAD_PEAK, SAMPLE_RATE, 30000.0, 1.0,
+			    6.0);
+	assert_true(isfinite(bq.b0) && isfinite(bq.a1) && isfinite(bq.a2));
+}
+
+/* RMS of a sine after it has gone through the bank, against the expected
+ * magnitude response */
+static void measured_response_test(void **state)
+{
+	static const double freqs[] = {31.0,   80.0,   250.0,  1000.0,
+				       3150.0, 7000.0, 12500.0, 18000.0};
+	struct audio_biquad_bank *bank = bzalloc(sizeof(*bank));
+	struct audio_biquad bq[3];
+	const size_t frames = 48000;
+	float *buf = bmalloc(frames * sizeof(float));
+
+	UNUSED_PARAMETER(state);
+
+	audio_biquad_design(&bq[0], AUDIO_BIQUAD_LOW_SHELF, SAMPLE_RATE, 120.0,
+			    0.707, 6.0);
+	audio_biquad_design(&bq[1], AUDIO_BIQUAD_PEAK, SAMPLE_RATE, 2500.0,
+			    1.4, -9.0);
+	audio_biquad_design(&bq[2], AUDIO_BIQUAD_HIGHPASS, SAMPLE_RATE, 40.0,
+			    0.707, 0.0);
+
+	for (size_t f = 0; f < sizeof(freqs) / sizeof(freqs[0]); f++) {
+		const double expected = to_db(
+			audio_biquad_response(bq, 3, SAMPLE_RATE, freqs[f]));
+		double in_sum = 0.0, out_sum = 0.0;
+
+		audio_biquad_bank_init(bank, 1, 3);
+		for (size_t s = 0; s < 3; s++)
+			audio_biquad_bank_set(bank, 0, s, &bq[s]);
+
+		for (size_t i = 0; i < frames; i++)
+			buf[i] = (float)sin(2.0 * M_PI * freqs[f] * (double)i /
+					    SAMPLE_RATE);
+
+		/* skip the first half while the filters settle */
+		for (size_t i = frames / 2; i < frames; i++)
+			in_sum += (double)buf[i] * buf[i];
+
+		audio_biquad_bank_process(bank, &buf, (const float **)&buf,
+					  frames);
+
+		for (size_t i = frames / 2; i < frames; i++)
+			out_sum += (double)buf[i] * buf[i];
+
+		const double measured = 10.0 * log10(out_sum / in_sum);
+		if (fabs(measured - expected) > 0.05)
+			fail_msg("%g Hz: measured %g dB, expected %g dB",
+				 freqs[f], measured, expected);
+	}
+
+	bfree(buf);
+	bfree(bank);
+}
+
+#define BENCH_FRAMES 480
+#define BENCH_BLOCKS 2000
+#define BENCH_BANDS 10
+
+static double bench_ref(float **channels, size_t count,
+			const struct audio_biquad *bq)
+{
+	float state[8][BENCH_BANDS][2] = {0};
+	uint64_t start = os_gettime_ns();
+
+	for (int b = 0; b < BENCH_BLOCKS; b++)
+		for (size_t c = 0; c < count; c++)
+			ref_process(bq, state[c], BENCH_BANDS, channels[c],
+				    BENCH_FRAMES);
+
+	return (double)(os_gettime_ns() - start) /
+	       ((double)BENCH_BLOCKS * BENCH_FRAMES);
+}
+
+static double bench_bank(float **channels, size_t count,
+			 const struct audio_biquad *bq)
+{
+	struct audio_biquad_bank *bank = bzalloc(sizeof(*bank));
+	uint64_t start;
+
+	audio_biquad_bank_init(bank, count, BENCH_BANDS);
+	for (size_t c = 0; c < count; c++)
+		for (size_t s = 0; s < BENCH_BANDS; s++)
+			audio_biquad_bank_set(bank, c, s, &bq[s]);
+
+	start = os_gettime_ns();
+	for (int b = 0; b < BENCH_BLOCKS; b++)
+		audio_biquad_bank_process(bank, channels,
+					  (const float *const *)channels,
+					  BENCH_FRAMES);
+
+	bfree(bank);
+	return (double)(os_gettime_ns() - start) /
+	       ((double)BENCH_BLOCKS * BENCH_FRAMES);
+}
+
+static void benchmark(void **state)
+{
+	static const size_t channel_counts[] = {1, 2, 6, 8};
+	struct audio_biquad bq[BENCH_BANDS];
+	float *channels[8];
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t s = 0; s < BENCH_BANDS; s++)
+		audio_biquad_design(&bq[s], AUDIO_BIQUAD_PEAK, SAMPLE_RATE,
+				    31.25 * pow(2.0, (double)s), 1.4, 3.0);
+
+	/* the peaks are boosting, so the noise doesn't decay to denormals */
+	for (size_t c = 0; c < 8; c++) {
+		channels[c] = bmalloc(BENCH_FRAMES * sizeof(float));
+		for (size_t i = 0; i < BENCH_FRAMES; i++)
+			channels[c][i] = rand_sample() * 0.01f;
+	}
+
+	print_message("%d band EQ, ns per frame:\n", BENCH_BANDS);
+
+	for (size_t i = 0; i < 4; i++) {
+		const size_t count = channel_counts[i];
+		const double ref = bench_ref(channels, count, bq);
+		const double simd = bench_bank(channels, count, bq);
+
+		print_message("  %zu ch  scalar %6.2f  simd %6.2f  (%.1fx)\n",
+			      count, ref, simd, ref / simd);
+	}
+
+	for (size_t c = 0; c < 8; c++)
+		bfree(channels[c]);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(reference_test),
+		cmocka_unit_test(design_test),
+		cmocka_unit_test(measured_response_test),
+		cmocka_unit_test(benchmark),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,255 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs-audio-buffering.h>
+#include <util/bmem.h>
+
+#define SAMPLE_RATE 48000
+#define MAX_TICKS 45
+
+/* the audio thread and the part of audio_callback that deals with buffering,
+ * with a single source whose audio arrives lag_ticks late */
+struct sim {
+	struct audio_buffering b;
+	uint64_t tick_ns;
+	uint64_t start_time;
+	uint64_t samples;
+	uint64_t audio_time;
+	uint32_t catch_up_ticks;
+	int lag_ticks;
+
+	uint64_t next_render_ts;
+	uint64_t next_out_ts;
+	long outputs;
+	long increases;
+	long reclaims;
+};
+
+static void sim_init(struct sim *sim)
+{
+	memset(sim, 0, sizeof(*sim));
+	sim->b.max_ticks = MAX_TICKS;
+	sim->tick_ns = audio_frames_to_ns(SAMPLE_RATE, AUDIO_OUTPUT_FRAMES);
+	sim->start_time = 1000000000ULL;
+	sim->audio_time = sim->start_time;
+	sim->next_render_ts = sim->audio_time;
+	sim->next_out_ts = sim->audio_time;
+}
+
+/* every tick that's output has to start where the last one ended */
+static void sim_output(struct sim *sim, const struct ts_info *ts)
+{
+	assert_int_equal(ts->start, sim->next_out_ts);
+	sim->next_out_ts = ts->end;
+	sim->outputs++;
+}
+
+static void sim_callback(struct sim *sim, uint64_t start, uint64_t end)
+{
+	const struct ts_info in = {start, end};
+	bool catching_up = start == end;
+	uint64_t ready_end;
+	uint64_t headroom;
+	struct ts_info ts;
+
+	if (!audio_buffering_begin_tick(&sim->b, &in, catching_up, &ts))
+		return;
+
+	/* the source only has audio up to where the clock was lag_ticks ago */
+	ready_end = sim->audio_time - sim->lag_ticks * sim->tick_ns;
+	if (ts.end > ready_end) {
+		uint64_t min_ts = ts.start - (ts.end - ready_end);
+		uint64_t prev_start = ts.start;
+		int ticks = audio_buffering_ticks_behind(SAMPLE_RATE, ts.start,
+							 min_ts);
+
+		ticks = audio_buffering_add(&sim->b, SAMPLE_RATE, &ts, ticks);
+		if (ticks) {
+			uint64_t held_ns = audio_frames_to_ns(
+				SAMPLE_RATE, ticks * AUDIO_OUTPUT_FRAMES);
+
+			/* the ticks held back are rendered again first */
+			assert_int_equal(prev_start - ts.start, held_ns);
+			sim->next_render_ts = ts.start;
+			sim->increases++;
+		}
+	}
+
+	assert_int_equal(ts.start, sim->next_render_ts);
+	assert_true(ts.end - ts.start >= sim->tick_ns);
+	assert_true(ts.end - ts.start <= sim->tick_ns + 1);
+	sim->next_render_ts = ts.end;
+
+	headroom = ready_end > ts.end ? ready_end - ts.end : 0;
+
+	if (!catching_up &&
+	    audio_buffering_window_ended(&sim->b, SAMPLE_RATE, headroom)) {
+		uint32_t ticks = audio_buffering_reclaim(&sim->b, SAMPLE_RATE);
+		if (ticks) {
+			sim->catch_up_ticks += ticks;
+			sim->reclaims++;
+		}
+	}
+
+	if (audio_buffering_end_tick(&sim->b))
+		sim_output(sim, &ts);
+}
+
+static void sim_tick(struct sim *sim)
+{
+	uint64_t prev_time = sim->audio_time;
+
+	sim->samples += AUDIO_OUTPUT_FRAMES;
+	sim->audio_time = sim->start_time +
+			  audio_frames_to_ns(SAMPLE_RATE, sim->samples);
+	sim_callback(sim, prev_time, sim->audio_time);
+
+	while (sim->catch_up_ticks) {
+		sim->catch_up_ticks--;
+		sim_callback(sim, sim->audio_time, sim->audio_time);
+	}
+
+	/* output runs exactly as far behind the clock as the buffering */
+	if (!sim->b.wait_ticks) {
+		uint64_t latency = sim->audio_time - sim->next_out_ts;
+		uint64_t ticks = sim->b.total_ticks;
+		size_t queued = sim->b.timestamps.size / sizeof(struct ts_info);
+
+		assert_int_equal(queued, ticks);
+		assert_true(latency >= ticks * sim->tick_ns);
+		assert_true(latency <= ticks * (sim->tick_ns + 1));
+	}
+}
+
+static uint64_t window_ticks(void)
+{
+	return (RECLAIM_WINDOW_SEC * SAMPLE_RATE + AUDIO_OUTPUT_FRAMES - 1) /
+	       AUDIO_OUTPUT_FRAMES;
+}
+
+static void lag_recovery_test(void **state)
+{
+	struct sim sim;
+	long real_ticks = 0;
+	int prev_ticks;
+
+	UNUSED_PARAMETER(state);
+	sim_init(&sim);
+
+	for (int i = 0; i < 100; i++, real_ticks++)
+		sim_tick(&sim);
+	assert_int_equal(sim.b.total_ticks, 0);
+	assert_int_equal(sim.outputs, real_ticks);
+
+	/* the source starts lagging: buffering goes up to cover it, and
+	 * output is held back until the source has caught up */
+	sim.lag_ticks = 8;
+	for (int i = 0; i < 100; i++, real_ticks++)
+		sim_tick(&sim);
+	assert_int_equal(sim.b.total_ticks, 8);
+	assert_int_equal(sim.increases, 1);
+	assert_int_equal(sim.reclaims, 0);
+	assert_int_equal(sim.outputs, real_ticks - 8);
+
+	/* the lag goes away: the window that saw it gives nothing back, then
+	 * every window gives back half of the headroom past the tick that's
+	 * always left, and the audio output catches up on the ticks it held
+	 * back */
+	sim.lag_ticks = 0;
+	prev_ticks = sim.b.total_ticks;
+
+	const int expected[] = {8, 4, 2, 1, 1};
+	for (size_t w = 0; w < sizeof(expected) / sizeof(expected[0]); w++) {
+		for (uint64_t i = 0; i < window_ticks(); i++, real_ticks++)
+			sim_tick(&sim);
+
+		assert_int_equal(sim.b.total_ticks, expected[w]);
+		assert_true(sim.b.total_ticks <= prev_ticks);
+		prev_ticks = sim.b.total_ticks;
+	}
+
+	assert_int_equal(sim.b.total_ticks, RECLAIM_HEADROOM_TICKS);
+	assert_int_equal(sim.reclaims, 3);
+	assert_int_equal(sim.increases, 1);
+
+	/* nothing was lost or output twice */
+	assert_int_equal(sim.outputs, real_ticks - RECLAIM_HEADROOM_TICKS);
+
+	/* and it can go back up again */
+	sim.lag_ticks = 5;
+	for (int i = 0; i < 100; i++, real_ticks++)
+		sim_tick(&sim);
+	assert_int_equal(sim.b.total_ticks, 5);
+	assert_int_equal(sim.outputs, real_ticks - 5);
+
+	audio_buffering_free(&sim.b);
+}
+
+static void lag_spike_test(void **state)
+{
+	struct sim sim;
+	long real_ticks = 0;
+
+	UNUSED_PARAMETER(state);
+	sim_init(&sim);
+
+	for (int i = 0; i < 10; i++, real_ticks++)
+		sim_tick(&sim);
+
+	sim.lag_ticks = 4;
+	for (int i = 0; i < 10; i++, real_ticks++)
+		sim_tick(&sim);
+	assert_int_equal(sim.b.total_ticks, 4);
+
+	/* a single tick where the source lags as much as before is enough to
+	 * keep a window from giving anything back */
+	for (uint64_t i = 0; i < window_ticks() * 3; i++, real_ticks++) {
+		sim.lag_ticks = i % (window_ticks() / 2) ? 0 : 4;
+		sim_tick(&sim);
+	}
+	assert_int_equal(sim.b.total_ticks, 4);
+	assert_int_equal(sim.reclaims, 0);
+	assert_int_equal(sim.increases, 1);
+
+	sim.lag_ticks = 0;
+	for (uint64_t i = 0; i < window_ticks() * 2; i++, real_ticks++)
+		sim_tick(&sim);
+	assert_true(sim.b.total_ticks < 4);
+	assert_int_equal(sim.outputs, real_ticks - sim.b.total_ticks);
+
+	audio_buffering_free(&sim.b);
+}
+
+static void max_buffering_test(void **state)
+{
+	struct sim sim;
+	long real_ticks = 0;
+
+	UNUSED_PARAMETER(state);
+	sim_init(&sim);
+
+	for (int i = 0; i < 10; i++, real_ticks++)
+		sim_tick(&sim);
+
+	/* buffering stops at the maximum, and the timestamps still line up */
+	sim.lag_ticks = MAX_TICKS + 10;
+	for (int i = 0; i < 100; i++, real_ticks++)
+		sim_tick(&sim);
+	assert_true(audio_buffering_maxed(&sim.b));
+	assert_int_equal(sim.outputs, real_ticks - MAX_TICKS);
+
+	audio_buffering_free(&sim.b);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(lag_recovery_test),
+		cmocka_unit_test(lag_spike_test),
+		cmocka_unit_test(max_buffering_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,463 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <string.h>
+
+#include <audio-dynamics.h>
+#include <media-io/audio-math.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+
+#define CHANNELS 8
+#define FRAMES 1023
+
+static uint32_t rand_state = 1;
+
+static float rand_sample(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (float)(rand_state >> 8) / (float)(1 << 23) - 1.0f;
+}
+
+/* noise with bursts at different levels, so the envelope both attacks and
+ * releases and the gain crosses the threshold */
+static void fill_channels(float *channels[CHANNELS], size_t frames)
+{
+	for (size_t c = 0; c < CHANNELS; c++) {
+		for (size_t i = 0; i < frames; i++) {
+			const float level = ((i + c * 37) / 128) % 3 == 0
+						    ? 0.9f
+						    : 0.01f;
+			channels[c][i] = rand_sample() * level;
+		}
+	}
+}
+
+static float *alloc_channels(float *channels[CHANNELS], size_t frames)
+{
+	float *data = bmalloc(CHANNELS * frames * sizeof(float));
+	for (size_t c = 0; c < CHANNELS; c++)
+		channels[c] = data + c * frames;
+	return data;
+}
+
+/* the scalar code the filters used before */
+static void ref_envelope(float *env, float *const *samples, size_t channels,
+			 size_t frames, float attack_gain, float release_gain,
+			 float *envelope)
+{
+	memset(env, 0, frames * sizeof(float));
+	for (size_t c = 0; c < channels; c++) {
+		if (!samples[c])
+			continue;
+
+		float e = *envelope;
+		for (size_t i = 0; i < frames; i++) {
+			const float in = fabsf(samples[c][i]);
+			if (e < in)
+				e = in + attack_gain * (e - in);
+			else
+				e = in + release_gain * (e - in);
+			env[i] = fmaxf(env[i], e);
+		}
+	}
+	*envelope = env[frames - 1];
+}
+
+static float ref_compressor_gain(float env, float threshold, float slope,
+				 float output_gain)
+{
+	const float gain = slope * (threshold - mul_to_db(env));
+	return db_to_mul(fminf(0, gain)) * output_gain;
+}
+
+static void fast_math_test(void **state)
+{
+	double max_err = 0.0;
+
+	UNUSED_PARAMETER(state);
+
+	for (double l = -1.0; l < 1.0; l += 0.0001) {
+		const float x = (float)exp2(l);
+		const double err = fabs(fast_log2f(x) - log2((double)x));
+		max_err = fmax(max_err, err);
+	}
+	print_message("fast_log2f near 1: %g\n", max_err);
+	assert_true(max_err < 2e-7);
+
+	max_err = 0.0;
+	for (double l = -40.0; l < 6.0; l += 0.001) {
+		const float x = (float)exp2(l);
+		const double db = 20.0 * log10((double)x);
+		max_err = fmax(max_err, fabs(fast_mul_to_db(x) - db));
+	}
+	print_message("fast_mul_to_db: %g dB\n", max_err);
+	assert_true(max_err < 3e-5);
+
+	max_err = 0.0;
+	for (double x = -126.0; x < 127.0; x += 0.001) {
+		const float xf = (float)x;
+		const double exact = exp2((double)xf);
+		const double err = fabs(fast_exp2f(xf) - exact) / exact;
+		max_err = fmax(max_err, err);
+	}
+	print_message("fast_exp2f: %g relative\n", max_err);
+	assert_true(max_err < 3e-7);
+
+	max_err = 0.0;
+	for (double db = -150.0; db < 60.0; db += 0.001) {
+		const float dbf = (float)db;
+		const double exact = pow(10.0, (double)dbf / 20.0);
+		const double err = fabs(fast_db_to_mul(dbf) - exact) / exact;
+		max_err = fmax(max_err, err);
+	}
+	print_message("fast_db_to_mul: %g relative\n", max_err);
+	assert_true(max_err < 1e-6);
+
+	assert_true(fast_mul_to_db(0.0f) < -758.0f);
+	assert_true(fast_db_to_mul(-INFINITY) == 0.0f);
+	assert_true(fast_db_to_mul(-800.0f) == 0.0f);
+	assert_true(fast_db_to_mul(0.0f) == 1.0f);
+}
+
+static void envelope_test(void **state)
+{
+	float *channels[CHANNELS], *samples[CHANNELS];
+	float *data = alloc_channels(channels, FRAMES);
+	float *env = bmalloc(FRAMES * sizeof(float));
+	float *ref = bmalloc(FRAMES * sizeof(float));
+
+	UNUSED_PARAMETER(state);
+
+	fill_channels(channels, FRAMES);
+
+	/* every channel count and tail length, with a NULL channel */
+	for (size_t count = 1; count <= CHANNELS; count++) {
+		for (size_t frames = FRAMES - 3; frames <= FRAMES; frames++) {
+			float envelope = 0.25f, ref_envelope_val = 0.25f;
+
+			memcpy(samples, channels, sizeof(samples));
+			if (count > 2)
+				samples[1] = NULL;
+
+			audio_dynamics_envelope(env, samples, count, frames,
+						0.8f, 0.999f, &envelope);
+			ref_envelope(ref, samples, count, frames, 0.8f, 0.999f,
+				     &ref_envelope_val);
+
+			for (size_t i = 0; i < frames; i++)
+				assert_true(fabsf(env[i] - ref[i]) <=
+					    ref[i] * 1e-6f);
+			assert_true(fabsf(envelope - ref_envelope_val) <=
+				    ref_envelope_val * 1e-6f);
+		}
+	}
+
+	/* no channels leaves a silent envelope */
+	float envelope = 0.5f;
+	memset(samples, 0, sizeof(samples));
+	audio_dynamics_envelope(env, samples, CHANNELS, FRAMES, 0.8f, 0.999f,
+				&envelope);
+	assert_true(envelope == 0.0f);
+
+	bfree(data);
+	bfree(env);
+	bfree(ref);
+}
+
+static void peak_test(void **state)
+{
+	float *channels[CHANNELS];
+	float *data = alloc_channels(channels, FRAMES);
+	float *peak = bmalloc(FRAMES * sizeof(float));
+
+	UNUSED_PARAMETER(state);
+
+	fill_channels(channels, FRAMES);
+	channels[3] = NULL;
+
+	audio_dynamics_peak(peak, channels, CHANNELS, FRAMES);
+
+	for (size_t i = 0; i < FRAMES; i++) {
+		float ref = 0.0f;
+		for (size_t c = 0; c < CHANNELS; c++) {
+			if (channels[c])
+				ref = fmaxf(ref, fabsf(channels[c][i]));
+		}
+		assert_true(peak[i] == ref);
+	}
+
+	bfree(data);
+	bfree(peak);
+}
+
+static void check_compressor(const float *env, float *gain, float threshold,
+			     float slope, float output_gain)
+{
+	double max_err = 0.0;
+
+	audio_dynamics_compressor_gain(gain, env, FRAMES, threshold, slope,
+				       output_gain);
+
+	for (size_t i = 0; i < FRAMES; i++) {
+		const float ref = ref_compressor_gain(env[i], threshold, slope,
+						      output_gain);
+		max_err = fmax(max_err, fabs(gain[i] - ref) / output_gain);
+	}
+
+	print_message("threshold %.0f dB, slope %.3f: %g\n", threshold, slope,
+		      max_err);
+	assert_true(max_err < 2e-6);
+}
+
+static void compressor_gain_test(void **state)
+{
+	float *channels[CHANNELS];
+	float *data = alloc_channels(channels, FRAMES);
+	float *env = bmalloc(FRAMES * sizeof(float));
+	float *gain = bmalloc(FRAMES * sizeof(float));
+	float envelope = 0.0f;
+
+	UNUSED_PARAMETER(state);
+
+	fill_channels(channels, FRAMES);
+	audio_dynamics_envelope(env, channels, 2, FRAMES, 0.99f, 0.9995f,
+				&envelope);
+	env[0] = 0.0f;
+
+	/* compressor at 10:1 and 32:1, limiter */
+	check_compressor(env, gain, -18.0f, 1.0f - 1.0f / 10.0f, 1.0f);
+	check_compressor(env, gain, -40.0f, 1.0f - 1.0f / 32.0f, 4.0f);
+	check_compressor(env, gain, -6.0f, 1.0f, 1.0f);
+
+	bfree(data);
+	bfree(env);
+	bfree(gain);
+}
+
+static void db_conversion_test(void **state)
+{
+	float mul[FRAMES], db[FRAMES], gain[FRAMES];
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t i = 0; i < FRAMES; i++)
+		mul[i] = fabsf(rand_sample()) + 1e-6f;
+
+	audio_dynamics_to_db(db, mul, FRAMES);
+	for (size_t i = 0; i < FRAMES; i++)
+		assert_true(fabsf(db[i] - mul_to_db(mul[i])) < 3e-5f);
+
+	/* expander gains are capped at 0 dB, upward compressor ones aren't */
+	for (size_t i = 0; i < FRAMES; i++)
+		db[i] = rand_sample() * 60.0f;
+
+	audio_dynamics_db_to_gain(gain, db, FRAMES, 0.0f, 2.0f);
+	for (size_t i = 0; i < FRAMES; i++) {
+		const float ref = db_to_mul(fminf(0.0f, db[i])) * 2.0f;
+		assert_true(fabsf(gain[i] - ref) <= ref * 2e-6f);
+	}
+
+	audio_dynamics_db_to_gain(gain, db, FRAMES, INFINITY, 1.0f);
+	for (size_t i = 0; i < FRAMES; i++) {
+		const float ref = db_to_mul(db[i]);
+		assert_true(fabsf(gain[i] - ref) <= ref * 2e-6f);
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* throughput of each filter's per-block work, old scalar code vs new        */
+
+#define BENCH_CHANNELS 2
+#define BENCH_FRAMES 1024
+#define BENCH_BLOCKS 2000
+
+struct bench {
+	float *channels[CHANNELS];
+	float *data;
+	float *buf;
+	float *buf2;
+	float envelope;
+	float gate_level;
+	float attenuation;
+};
+
+static void ref_compressor(struct bench *b, float threshold, float slope)
+{
+	ref_envelope(b->buf, b->channels, BENCH_CHANNELS, BENCH_FRAMES, 0.99f,
+		     0.9995f, &b->envelope);
+
+	for (size_t i = 0; i < BENCH_FRAMES; i++) {
+		const float gain =
+			ref_compressor_gain(b->buf[i], threshold, slope, 1.0f);
+		for (size_t c = 0; c < BENCH_CHANNELS; c++)
+			b->channels[c][i] *= gain;
+	}
+}
+
+static void new_compressor(struct bench *b, float threshold, float slope)
+{
+	audio_dynamics_envelope(b->buf, b->channels, BENCH_CHANNELS,
+				BENCH_FRAMES, 0.99f, 0.9995f, &b->envelope);
+	audio_dynamics_compressor_gain(b->buf, b->buf, BENCH_FRAMES, threshold,
+				       slope, 1.0f);
+	audio_dynamics_apply_gain(b->channels, BENCH_CHANNELS, b->buf,
+				  BENCH_FRAMES);
+}
+
+static void ref_compressor_bench(struct bench *b)
+{
+	ref_compressor(b, -18.0f, 0.9f);
+}
+
+static void new_compressor_bench(struct bench *b)
+{
+	new_compressor(b, -18.0f, 0.9f);
+}
+
+static void ref_limiter_bench(struct bench *b)
+{
+	ref_compressor(b, -6.0f, 1.0f);
+}
+
+static void new_limiter_bench(struct bench *b)
+{
+	new_compressor(b, -6.0f, 1.0f);
+}
+
+/* gain stage of the expander without the ballistics, which stay scalar */
+static inline float expander_gain_db(float env_db)
+{
+	const float diff = -40.0f - env_db;
+	return diff > 0.0f ? fmaxf(-2.0f * diff, -60.0f) : 0.0f;
+}
+
+static void ref_expander_bench(struct bench *b)
+{
+	for (size_t c = 0; c < BENCH_CHANNELS; c++) {
+		float *samples = b->channels[c];
+		for (size_t i = 0; i < BENCH_FRAMES; i++) {
+			const float env_db = mul_to_db(fabsf(samples[i]));
+			const float gain = expander_gain_db(env_db);
+			samples[i] *= db_to_mul(fminf(0, gain));
+		}
+	}
+}
+
+static void new_expander_bench(struct bench *b)
+{
+	for (size_t c = 0; c < BENCH_CHANNELS; c++) {
+		float *samples = b->channels[c];
+		for (size_t i = 0; i < BENCH_FRAMES; i++)
+			b->buf2[i] = fabsf(samples[i]);
+
+		audio_dynamics_to_db(b->buf, b->buf2, BENCH_FRAMES);
+		for (size_t i = 0; i < BENCH_FRAMES; i++)
+			b->buf[i] = expander_gain_db(b->buf[i]);
+		audio_dynamics_db_to_gain(b->buf, b->buf, BENCH_FRAMES, 0.0f,
+					  1.0f);
+		audio_dynamics_apply_gain(&samples, 1, b->buf, BENCH_FRAMES);
+	}
+}
+
+static inline float gate_step(struct bench *b, float level)
+{
+	const bool open = level > 0.1f;
+	b->gate_level = fmaxf(b->gate_level, level) - 0.001f;
+	b->attenuation = open ? fminf(1.0f, b->attenuation + 0.01f)
+			      : fmaxf(0.0f, b->attenuation - 0.01f);
+	return b->attenuation;
+}
+
+static void ref_gate_bench(struct bench *b)
+{
+	for (size_t i = 0; i < BENCH_FRAMES; i++) {
+		float level = fabsf(b->channels[0][i]);
+		for (size_t c = 0; c < BENCH_CHANNELS; c++)
+			level = fmaxf(level, fabsf(b->channels[c][i]));
+
+		const float attenuation = gate_step(b, level);
+		for (size_t c = 0; c < BENCH_CHANNELS; c++)
+			b->channels[c][i] *= attenuation;
+	}
+}
+
+static void new_gate_bench(struct bench *b)
+{
+	audio_dynamics_peak(b->buf, b->channels, BENCH_CHANNELS, BENCH_FRAMES);
+	for (size_t i = 0; i < BENCH_FRAMES; i++)
+		b->buf[i] = gate_step(b, b->buf[i]);
+	audio_dynamics_apply_gain(b->channels, BENCH_CHANNELS, b->buf,
+				  BENCH_FRAMES);
+}
+
+static double run_bench(struct bench *b, void (*func)(struct bench *))
+{
+	uint64_t start, elapsed;
+
+	fill_channels(b->channels, BENCH_FRAMES);
+	b->envelope = 0.0f;
+	b->gate_level = 0.0f;
+	b->attenuation = 0.0f;
+
+	start = os_gettime_ns();
+	for (int i = 0; i < BENCH_BLOCKS; i++) {
+		/* keep the signal from decaying to denormals */
+		if ((i & 15) == 15)
+			fill_channels(b->channels, BENCH_FRAMES);
+		func(b);
+	}
+	elapsed = os_gettime_ns() - start;
+
+	return (double)elapsed / ((double)BENCH_BLOCKS * BENCH_FRAMES);
+}
+
+static void benchmark(void **state)
+{
+	static const struct {
+		const char *name;
+		void (*ref)(struct bench *);
+		void (*simd)(struct bench *);
+	} filters[] = {
+		{"compressor", ref_compressor_bench, new_compressor_bench},
+		{"limiter", ref_limiter_bench, new_limiter_bench},
+		{"expander", ref_expander_bench, new_expander_bench},
+		{"noise gate", ref_gate_bench, new_gate_bench},
+	};
+	struct bench b = {0};
+
+	UNUSED_PARAMETER(state);
+
+	b.data = alloc_channels(b.channels, BENCH_FRAMES);
+	b.buf = bmalloc(BENCH_FRAMES * sizeof(float));
+	b.buf2 = bmalloc(BENCH_FRAMES * sizeof(float));
+
+	print_message("%d channels, ns per frame:\n", BENCH_CHANNELS);
+
+	for (size_t i = 0; i < sizeof(filters) / sizeof(filters[0]); i++) {
+		const double ref = run_bench(&b, filters[i].ref);
+		const double simd = run_bench(&b, filters[i].simd);
+
+		print_message("  %-10s scalar %6.2f  simd %6.2f  (%.1fx)\n",
+			      filters[i].name, ref, simd, ref / simd);
+	}
+
+	bfree(b.data);
+	bfree(b.buf);
+	bfree(b.buf2);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(fast_math_test),
+		cmocka_unit_test(envelope_test),
+		cmocka_unit_test(peak_test),
+		cmocka_unit_test(compressor_gain_test),
+		cmocka_unit_test(db_conversion_test),
+		cmocka_unit_test(benchmark),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
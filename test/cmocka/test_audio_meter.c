@@ -0,0 +1,172 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <math.h>
+
+#include <media-io/audio-meter.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+
+#define HISTORY 3
+#define FRAMES 1027
+
+static uint32_t rand_state = 1;
+
+static float rand_sample(void)
+{
+	rand_state = rand_state * 1103515245 + 12345;
+	return (float)(rand_state >> 8) / (float)(1 << 23) - 1.0f;
+}
+
+/* three samples of history followed by the block */
+static float *alloc_signal(size_t frames)
+{
+	float *buf = bmalloc((HISTORY + frames) * sizeof(float));
+
+	for (size_t i = 0; i < HISTORY + frames; i++)
+		buf[i] = rand_sample() * 0.8f;
+	return buf;
+}
+
+static const double phases[4][4] = {
+	{-0.155915, 0.935489, 0.233872, -0.103943},
+	{-0.216236, 0.756827, 0.504551, -0.189207},
+	{-0.189207, 0.504551, 0.756827, -0.216236},
+	{-0.103943, 0.233872, 0.935489, -0.155915},
+};
+
+static float ref_true_peak(const float *x, size_t frames)
+{
+	double peak = 0.0;
+
+	for (size_t i = 0; i < frames; i++) {
+		peak = fmax(peak, fabs(x[i]));
+
+		for (size_t p = 0; p < 4; p++) {
+			const double *c = phases[p];
+			const double y = c[0] * x[i - 3] + c[1] * x[i - 2] +
+					 c[2] * x[i - 1] + c[3] * x[i];
+			peak = fmax(peak, fabs(y));
+		}
+	}
+
+	return (float)peak;
+}
+
+static void true_peak_test(void **state)
+{
+	float *buf = alloc_signal(FRAMES);
+	float *x = buf + HISTORY;
+
+	UNUSED_PARAMETER(state);
+
+	/* every length, to cover each vector tail */
+	for (size_t frames = 0; frames < 40; frames++) {
+		const float ref = ref_true_peak(x, frames);
+
+		audio_meter_set_avx2(false);
+		const float sse = audio_meter_true_peak(x, frames);
+		assert_true(fabsf(sse - ref) <= 1e-6f);
+
+		/* both kernels evaluate the filter in the same order */
+		if (audio_meter_set_avx2(true))
+			assert_true(audio_meter_true_peak(x, frames) == sse);
+	}
+
+	/* an intersample peak between two samples of the same sign */
+	x[10] = 0.9f;
+	x[11] = 0.9f;
+	x[9] = x[12] = 0.0f;
+	assert_true(audio_meter_true_peak(x, 16) > 0.9f);
+	assert_true(audio_meter_sample_peak(x, 16) == 0.9f);
+
+	bfree(buf);
+}
+
+static void block_test(void **state)
+{
+	float *buf = alloc_signal(FRAMES);
+	float *x = buf + HISTORY;
+	float whole, blocks = 0.0f;
+
+	UNUSED_PARAMETER(state);
+
+	/* metering in pieces gives the same result, as long as the history
+	 * samples come from the previous piece */
+	whole = audio_meter_true_peak(x, FRAMES);
+	for (size_t i = 0; i < FRAMES; i += 100) {
+		const size_t frames = FRAMES - i < 100 ? FRAMES - i : 100;
+		blocks = fmaxf(blocks, audio_meter_true_peak(x + i, frames));
+	}
+	assert_true(whole == blocks);
+
+	bfree(buf);
+}
+
+static void level_test(void **state)
+{
+	float *buf = alloc_signal(FRAMES);
+	float *x = buf + HISTORY;
+	double sum = 0.0;
+	float peak = 0.0f;
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t i = 0; i < FRAMES; i++) {
+		sum += (double)x[i] * x[i];
+		peak = fmaxf(peak, fabsf(x[i]));
+	}
+
+	assert_true(audio_meter_sample_peak(x, FRAMES) == peak);
+	assert_true(fabs(audio_meter_sum_squares(x, FRAMES) - sum) <
+		    sum * 1e-5);
+	assert_true(audio_meter_sample_peak(x, 0) == 0.0f);
+	assert_true(audio_meter_sum_squares(x, 0) == 0.0f);
+
+	bfree(buf);
+}
+
+#define BENCH_FRAMES 1024
+#define BENCH_BLOCKS 20000
+
+static double run_bench(const float *x)
+{
+	uint64_t start = os_gettime_ns();
+	volatile float sink = 0.0f;
+
+	for (int i = 0; i < BENCH_BLOCKS; i++)
+		sink = audio_meter_true_peak(x, BENCH_FRAMES);
+
+	(void)sink;
+	return (double)(os_gettime_ns() - start) /
+	       ((double)BENCH_BLOCKS * BENCH_FRAMES);
+}
+
+static void benchmark(void **state)
+{
+	float *buf = alloc_signal(BENCH_FRAMES);
+
+	UNUSED_PARAMETER(state);
+
+	audio_meter_set_avx2(false);
+	print_message("true peak, ns per frame:\n");
+	print_message("  sse2 %6.3f\n", run_bench(buf + HISTORY));
+
+	if (audio_meter_set_avx2(true))
+		print_message("  avx2 %6.3f\n", run_bench(buf + HISTORY));
+
+	bfree(buf);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(true_peak_test),
+		cmocka_unit_test(block_test),
+		cmocka_unit_test(level_test),
+		cmocka_unit_test(benchmark),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
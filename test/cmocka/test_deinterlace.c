@@ -0,0 +1,188 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <media-io/video-deinterlace.h>
+#include <util/bmem.h>
+
+#define WIDTH 67
+#define HEIGHT 12
+#define LINESIZE 80
+
+/* straightforward version of yadif mode 0, to check the optimized one */
+static int clamp_line(int y, int fallback)
+{
+	return (y < 0 || y >= HEIGHT) ? fallback : y;
+}
+
+static int px(const uint8_t *plane, int x, int y)
+{
+	return plane[y * LINESIZE + x];
+}
+
+static int imax(int a, int b)
+{
+	return a > b ? a : b;
+}
+
+static int imin(int a, int b)
+{
+	return a < b ? a : b;
+}
+
+static uint8_t ref_pixel(const uint8_t *cur, const uint8_t *prev,
+			 const uint8_t *next, int x, int y, int width, int s)
+{
+	int up = y > 0 ? y - 1 : y + 1;
+	int down = y + 1 < HEIGHT ? y + 1 : y - 1;
+	int up2 = clamp_line(y - 2, y);
+	int down2 = clamp_line(y + 2, y);
+
+	int c = px(cur, x, up);
+	int e = px(cur, x, down);
+	int d = (px(prev, x, y) + px(next, x, y)) >> 1;
+	int td0 = abs(px(prev, x, y) - px(next, x, y));
+	int td1 = (abs(px(prev, x, up) - c) + abs(px(prev, x, down) - e)) >> 1;
+	int td2 = (abs(px(next, x, up) - c) + abs(px(next, x, down) - e)) >> 1;
+	int diff = imax(td0 >> 1, imax(td1, td2));
+	int pred = (c + e) >> 1;
+
+	if (x >= 3 * s && x + 3 * s < width) {
+		int best = abs(px(cur, x - s, up) - px(cur, x - s, down)) +
+			   abs(c - e) +
+			   abs(px(cur, x + s, up) - px(cur, x + s, down)) - 1;
+
+		for (int dir = -1; dir <= 1; dir += 2) {
+			for (int j = dir; abs(j) <= 2; j += dir) {
+				int score = 0;
+				for (int k = -1; k <= 1; k++)
+					score += abs(px(cur, x + (k + j) * s,
+							up) -
+						     px(cur, x + (k - j) * s,
+							down));
+				if (score >= best)
+					break;
+
+				best = score;
+				pred = (px(cur, x + j * s, up) +
+					px(cur, x - j * s, down)) >>
+				       1;
+			}
+		}
+	}
+
+	int b = (px(prev, x, up2) + px(next, x, up2)) >> 1;
+	int f = (px(prev, x, down2) + px(next, x, down2)) >> 1;
+	int max_ = imax(d - e, imax(d - c, imin(b - c, f - e)));
+	int min_ = imin(d - e, imin(d - c, imax(b - c, f - e)));
+	diff = imax(diff, imax(min_, -max_));
+
+	return (uint8_t)imin(imax(pred, d - diff), d + diff);
+}
+
+static void fill_random(uint8_t *plane, unsigned *seed, bool smooth)
+{
+	for (int i = 0; i < LINESIZE * HEIGHT; i++) {
+		*seed = *seed * 1103515245 + 12345;
+		plane[i] = smooth ? (uint8_t)(i % LINESIZE * 3 + (*seed >> 28))
+				  : (uint8_t)(*seed >> 16);
+	}
+}
+
+static void check_output(const uint8_t *out, uint8_t *planes[3], int width,
+			 uint32_t step, uint32_t parity)
+{
+	for (int y = 0; y < HEIGHT; y++) {
+		for (int x = 0; x < width; x++) {
+			int val = (y & 1) == (int)parity
+					  ? px(planes[0], x, y)
+					  : ref_pixel(planes[0], planes[1],
+						      planes[2], x, y, width,
+						      (int)step);
+
+			assert_int_equal(out[y * LINESIZE + x], val);
+		}
+	}
+}
+
+static void yadif_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	uint8_t *planes[3];
+	uint8_t *out = bzalloc(LINESIZE * HEIGHT);
+	const uint32_t linesizes[3] = {LINESIZE, LINESIZE, LINESIZE};
+	unsigned seed = 1;
+
+	for (size_t i = 0; i < 3; i++)
+		planes[i] = bmalloc(LINESIZE * HEIGHT);
+
+	const uint8_t *in[3] = {planes[0], planes[1], planes[2]};
+
+	for (int iter = 0; iter < 20; iter++) {
+		for (size_t i = 0; i < 3; i++)
+			fill_random(planes[i], &seed, iter & 1);
+
+		/* every width from too narrow for the vectorized path to
+		 * wider than a multiple of its size */
+		for (int width = 1; width <= WIDTH; width += 11) {
+			for (uint32_t step = 1; step <= 4; step++) {
+				for (uint32_t parity = 0; parity < 2;
+				     parity++) {
+					deinterlace_yadif(out, LINESIZE, in,
+							  linesizes, width,
+							  HEIGHT, step, parity,
+							  0, HEIGHT);
+					check_output(out, planes, width, step,
+						     parity);
+				}
+			}
+		}
+	}
+
+	for (size_t i = 0; i < 3; i++)
+		bfree(planes[i]);
+	bfree(out);
+}
+
+static void static_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	uint8_t *plane = bmalloc(LINESIZE * HEIGHT);
+	uint8_t *out = bzalloc(LINESIZE * HEIGHT);
+	const uint32_t linesizes[3] = {LINESIZE, LINESIZE, LINESIZE};
+	const uint8_t *in[3] = {plane, plane, plane};
+
+	for (int y = 0; y < HEIGHT; y++)
+		for (int x = 0; x < LINESIZE; x++)
+			plane[y * LINESIZE + x] = (uint8_t)(x * 2 + y * 5);
+
+	/* content that doesn't move and has no combing is rebuilt as it was
+	 * (apart from the last line, which has nothing below it), also when
+	 * split up into bands like when run on several threads */
+	deinterlace_yadif(out, LINESIZE, in, linesizes, WIDTH, HEIGHT, 1, 0, 0,
+			  5);
+	deinterlace_yadif(out, LINESIZE, in, linesizes, WIDTH, HEIGHT, 1, 0, 5,
+			  HEIGHT);
+
+	for (int y = 0; y < HEIGHT - 1; y++)
+		assert_memory_equal(out + y * LINESIZE, plane + y * LINESIZE,
+				    WIDTH);
+
+	bfree(plane);
+	bfree(out);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(yadif_test),
+		cmocka_unit_test(static_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,297 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <obs-fanout.h>
+#include <util/bmem.h>
+
+#define VIDEO_FRAME_USEC 16667
+#define AUDIO_FRAME_USEC 21333
+#define KEYFRAME_INTERVAL 30
+
+/* an interleaved stream of one video and one audio track, with the packet's
+ * number in its payload so the order can be checked after it went through
+ * the queue */
+struct stream {
+	int64_t video_ts;
+	int64_t audio_ts;
+	long video_frames;
+	uint32_t next_id;
+};
+
+static void push_packet(struct fanout_queue *q, struct stream *s)
+{
+	struct encoder_packet packet = {0};
+	long *refs = bmalloc(sizeof(long) + sizeof(uint32_t));
+
+	/* the same layout as the encoders' packet instances, so the queue
+	 * can release it with obs_encoder_packet_release() */
+	*refs = 1;
+	packet.data = (uint8_t *)(refs + 1);
+	packet.size = sizeof(uint32_t);
+	*(uint32_t *)packet.data = s->next_id++;
+
+	packet.timebase_num = 1;
+	packet.timebase_den = 1000000;
+
+	if (s->video_ts <= s->audio_ts) {
+		packet.type = OBS_ENCODER_VIDEO;
+		packet.keyframe = s->video_frames % KEYFRAME_INTERVAL == 0;
+		packet.dts_usec = s->video_ts;
+		s->video_ts += VIDEO_FRAME_USEC;
+		s->video_frames++;
+	} else {
+		packet.type = OBS_ENCODER_AUDIO;
+		packet.dts_usec = s->audio_ts;
+		s->audio_ts += AUDIO_FRAME_USEC;
+	}
+
+	packet.dts = packet.dts_usec;
+	packet.pts = packet.dts_usec;
+
+	fanout_queue_push(q, &packet);
+}
+
+static void push_until(struct fanout_queue *q, struct stream *s,
+		       int64_t end_usec)
+{
+	while (s->video_ts < end_usec || s->audio_ts < end_usec)
+		push_packet(q, s);
+}
+
+static inline uint32_t packet_id(const struct encoder_packet *packet)
+{
+	return *(const uint32_t *)packet->data;
+}
+
+/* reads everything the cursor can get, checking that what is sent keeps the
+ * interleaved order and is rebased to the first keyframe */
+struct read_result {
+	long sent_video;
+	long sent_audio;
+	long dropped;
+	int64_t first_video_dts;
+	bool first_is_keyframe;
+};
+
+static void read_all(struct fanout_queue *q, struct fanout_cursor *c,
+		     struct read_result *r)
+{
+	struct encoder_packet *queued;
+	int64_t last_dts = INT64_MIN;
+	int64_t last_id = -1;
+	bool first = true;
+	long dropped;
+
+	while ((queued = fanout_cursor_next(c, q, &dropped)) != NULL) {
+		struct encoder_packet packet = *queued;
+		int64_t orig_dts = packet.dts_usec;
+		bool frame_dropped;
+
+		r->dropped += dropped;
+
+		/* never goes back in the queue */
+		assert_true((int64_t)packet_id(&packet) > last_id);
+		last_id = packet_id(&packet);
+
+		if (!fanout_cursor_prepare(c, &packet, &frame_dropped)) {
+			if (frame_dropped)
+				r->dropped++;
+			continue;
+		}
+
+		if (first) {
+			assert_int_equal(packet.type, OBS_ENCODER_VIDEO);
+			r->first_is_keyframe = packet.keyframe;
+			r->first_video_dts = orig_dts;
+			first = false;
+		}
+
+		assert_int_equal(packet.dts_usec, orig_dts - c->base_usec);
+		assert_int_equal(packet.dts, packet.dts_usec);
+		assert_int_equal(packet.pts, packet.dts_usec);
+		assert_true(packet.dts_usec >= 0);
+		assert_true(packet.dts_usec >= last_dts);
+		last_dts = packet.dts_usec;
+
+		if (packet.type == OBS_ENCODER_VIDEO)
+			r->sent_video++;
+		else
+			r->sent_audio++;
+	}
+
+	r->dropped += dropped;
+}
+
+static void fanout_join_test(void **state)
+{
+	struct fanout_queue q = {0};
+	struct fanout_cursor c = {0};
+	struct read_result r = {0};
+	struct stream s = {0};
+	long frames_before;
+	long frames_to_key;
+	long allocs = bnum_allocs();
+
+	UNUSED_PARAMETER(state);
+
+	/* join a third of the way into a GOP */
+	push_until(&q, &s, KEYFRAME_INTERVAL * VIDEO_FRAME_USEC / 3);
+	fanout_cursor_reset(&c, &q);
+	assert_int_equal(c.seq, fanout_queue_end_seq(&q));
+
+	frames_before = s.video_frames;
+	frames_to_key = KEYFRAME_INTERVAL - frames_before % KEYFRAME_INTERVAL;
+	push_until(&q, &s, 3 * KEYFRAME_INTERVAL * VIDEO_FRAME_USEC);
+
+	read_all(&q, &c, &r);
+
+	/* the frames before the next keyframe are dropped, and audio before
+	 * it is skipped without being counted */
+	assert_true(r.first_is_keyframe);
+	assert_int_equal(r.first_video_dts,
+			 (frames_before + frames_to_key) * VIDEO_FRAME_USEC);
+	assert_int_equal(r.dropped, frames_to_key);
+	assert_int_equal(r.sent_video + r.dropped,
+			 s.video_frames - frames_before);
+	assert_true(r.sent_audio > 0);
+	assert_int_equal(c.seq, fanout_queue_end_seq(&q));
+
+	fanout_queue_free(&q);
+	assert_int_equal(bnum_allocs(), allocs);
+}
+
+static void fanout_backlog_test(void **state)
+{
+	struct fanout_queue q = {0};
+	struct fanout_cursor c = {.max_backlog_usec = 1000000};
+	struct read_result r = {0};
+	struct stream s = {0};
+	const int64_t gop_usec = KEYFRAME_INTERVAL * VIDEO_FRAME_USEC;
+	long allocs = bnum_allocs();
+	int64_t newest_key;
+
+	UNUSED_PARAMETER(state);
+
+	fanout_cursor_reset(&c, &q);
+
+	/* a destination that was stuck for three seconds */
+	push_until(&q, &s, 3000000);
+	newest_key = ((s.video_frames - 1) / KEYFRAME_INTERVAL) *
+		     KEYFRAME_INTERVAL * VIDEO_FRAME_USEC;
+
+	read_all(&q, &c, &r);
+
+	/* it catches up at the newest keyframe instead of sending it all */
+	assert_true(r.first_is_keyframe);
+	assert_int_equal(r.first_video_dts, newest_key);
+	assert_true(s.video_ts - r.first_video_dts <= gop_usec);
+	assert_int_equal(r.sent_video + r.dropped, s.video_frames);
+	assert_true(r.dropped >= s.video_frames - KEYFRAME_INTERVAL);
+
+	/* and keeps up from there without skipping again */
+	memset(&r, 0, sizeof(r));
+	push_until(&q, &s, 3500000);
+	read_all(&q, &c, &r);
+	assert_int_equal(r.dropped, 0);
+	assert_true(r.sent_video > 0);
+
+	fanout_queue_free(&q);
+	assert_int_equal(bnum_allocs(), allocs);
+}
+
+/* packets are only released once the slowest cursor has passed them */
+static void fanout_trim_test(void **state)
+{
+	struct fanout_queue q = {0};
+	struct fanout_cursor a = {0};
+	struct fanout_cursor b = {0};
+	struct stream s = {0};
+	long allocs = bnum_allocs();
+	long dropped;
+	size_t count;
+
+	UNUSED_PARAMETER(state);
+
+	fanout_cursor_reset(&a, &q);
+	fanout_cursor_reset(&b, &q);
+	push_until(&q, &s, 1000000);
+	count = fanout_queue_count(&q);
+
+	while (fanout_cursor_next(&a, &q, &dropped))
+		;
+	for (size_t i = 0; i < count / 2; i++)
+		assert_non_null(fanout_cursor_next(&b, &q, &dropped));
+
+	fanout_queue_trim(&q, a.seq < b.seq ? a.seq : b.seq);
+	assert_int_equal(q.first_seq, b.seq);
+	assert_int_equal(fanout_queue_count(&q), count - count / 2);
+
+	/* sequence numbers carry on as packets are released */
+	push_until(&q, &s, 2000000);
+	while (fanout_cursor_next(&b, &q, &dropped))
+		;
+	fanout_queue_trim(&q, a.seq < b.seq ? a.seq : b.seq);
+	assert_int_equal(q.first_seq, a.seq);
+
+	while (fanout_cursor_next(&a, &q, &dropped))
+		;
+	fanout_queue_trim(&q, a.seq);
+	assert_int_equal(fanout_queue_count(&q), 0);
+	assert_int_equal(q.first_seq, b.seq);
+
+	fanout_queue_free(&q);
+	assert_int_equal(bnum_allocs(), allocs);
+}
+
+/* a second video track can't start the stream, and waits for its own
+ * keyframe after the first one started it */
+static void fanout_second_track_test(void **state)
+{
+	struct fanout_cursor c = {0};
+	struct fanout_queue q = {0};
+	struct encoder_packet packet = {0};
+	bool dropped;
+
+	UNUSED_PARAMETER(state);
+
+	fanout_cursor_reset(&c, &q);
+	packet.type = OBS_ENCODER_VIDEO;
+	packet.timebase_num = 1;
+	packet.timebase_den = 1000000;
+
+	packet.track_idx = 1;
+	packet.keyframe = true;
+	packet.dts_usec = packet.dts = packet.pts = 1000;
+	assert_false(fanout_cursor_prepare(&c, &packet, &dropped));
+	assert_true(dropped);
+
+	packet.track_idx = 0;
+	packet.dts_usec = packet.dts = packet.pts = 2000;
+	assert_true(fanout_cursor_prepare(&c, &packet, &dropped));
+	assert_int_equal(packet.dts, 0);
+
+	packet.track_idx = 1;
+	packet.keyframe = false;
+	packet.dts_usec = packet.dts = packet.pts = 3000;
+	assert_false(fanout_cursor_prepare(&c, &packet, &dropped));
+	assert_true(dropped);
+
+	packet.keyframe = true;
+	packet.dts_usec = packet.dts = packet.pts = 4000;
+	assert_true(fanout_cursor_prepare(&c, &packet, &dropped));
+	assert_int_equal(packet.dts, 2000);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(fanout_join_test),
+		cmocka_unit_test(fanout_backlog_test),
+		cmocka_unit_test(fanout_trim_test),
+		cmocka_unit_test(fanout_second_track_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
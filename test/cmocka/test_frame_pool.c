@@ -0,0 +1,203 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <string.h>
+
+#include <media-io/frame-pool.h>
+#include <media-io/video-frame.h>
+#include <util/bmem.h>
+#include <util/threading.h>
+
+#define MB (1024 * 1024)
+
+static void reuse_test(void **state)
+{
+	struct frame_pool_stats before, after;
+	void *a, *b, *c;
+
+	UNUSED_PARAMETER(state);
+
+	frame_pool_trim(0);
+	frame_pool_get_stats(&before);
+
+	/* sizes within the same class share buffers */
+	a = frame_pool_alloc(MB);
+	memset(a, 1, MB);
+	frame_pool_free(a);
+	b = frame_pool_alloc(MB - 100);
+	assert_ptr_equal(a, b);
+
+	/* but a larger class doesn't */
+	c = frame_pool_alloc(2 * MB);
+	assert_true(c != b);
+
+	frame_pool_get_stats(&after);
+	assert_int_equal(after.allocs - before.allocs, 3);
+	assert_int_equal(after.hits - before.hits, 1);
+	assert_true(after.in_use_bytes - before.in_use_bytes >= 3 * MB);
+
+	frame_pool_free(b);
+	frame_pool_free(c);
+
+	frame_pool_get_stats(&after);
+	assert_int_equal(after.in_use_bytes, before.in_use_bytes);
+	assert_true(after.cached_bytes >= 3 * MB);
+
+	frame_pool_trim(0);
+	frame_pool_get_stats(&after);
+	assert_int_equal(after.cached_bytes, 0);
+}
+
+static void passthrough_test(void **state)
+{
+	struct frame_pool_stats before, after;
+	void *small;
+
+	UNUSED_PARAMETER(state);
+
+	frame_pool_get_stats(&before);
+
+	/* small buffers aren't pooled and are just freed */
+	small = frame_pool_alloc(100);
+	frame_pool_free(small);
+	frame_pool_free(NULL);
+
+	frame_pool_get_stats(&after);
+	assert_int_equal(after.allocs, before.allocs);
+	assert_int_equal(after.cached_bytes, before.cached_bytes);
+}
+
+static void limit_test(void **state)
+{
+	struct frame_pool_stats before, after;
+	void *a, *b;
+
+	UNUSED_PARAMETER(state);
+
+	frame_pool_trim(0);
+	frame_pool_get_stats(&before);
+
+	a = frame_pool_alloc(MB);
+	b = frame_pool_alloc(MB);
+	frame_pool_free(a);
+	frame_pool_free(b);
+
+	/* lowering the limit evicts what no longer fits */
+	frame_pool_set_max_cached(MB + MB / 2);
+	frame_pool_get_stats(&after);
+	assert_true(after.cached_bytes <= MB + MB / 2);
+	assert_int_equal(after.evictions - before.evictions, 1);
+
+	frame_pool_set_max_cached(0);
+	a = frame_pool_alloc(MB);
+	frame_pool_free(a);
+	frame_pool_get_stats(&after);
+	assert_int_equal(after.cached_bytes, 0);
+
+	frame_pool_set_max_cached(256 * MB);
+}
+
+static void video_frame_test(void **state)
+{
+	struct frame_pool_stats before, after;
+	struct video_frame frame;
+	uint8_t *data;
+
+	UNUSED_PARAMETER(state);
+
+	frame_pool_trim(0);
+
+	/* the public helpers stay plain bmalloc/bfree, so plugins that free
+	 * their frames with bfree keep working */
+	frame_pool_get_stats(&before);
+	video_frame_init(&frame, VIDEO_FORMAT_NV12, 1920, 1080);
+	bfree(frame.data[0]);
+	frame_pool_get_stats(&after);
+	assert_int_equal(after.allocs, before.allocs);
+	assert_int_equal(after.in_use_bytes, before.in_use_bytes);
+
+	video_frame_init_pooled(&frame, VIDEO_FORMAT_NV12, 1920, 1080);
+	data = frame.data[0];
+	video_frame_free_pooled(&frame);
+
+	/* steady state: recreating frames doesn't allocate */
+	frame_pool_get_stats(&before);
+	for (int i = 0; i < 100; i++) {
+		video_frame_init_pooled(&frame, VIDEO_FORMAT_NV12, 1920, 1080);
+		assert_ptr_equal(frame.data[0], data);
+		memset(frame.data[1], 0x80, frame.linesize[1] * 540);
+		video_frame_free_pooled(&frame);
+	}
+	frame_pool_get_stats(&after);
+	assert_int_equal(after.allocs - before.allocs, 100);
+	assert_int_equal(after.hits - before.hits, 100);
+
+	frame_pool_trim(0);
+}
+
+#define NUM_THREADS 4
+#define ITERATIONS 2000
+
+static void *stress_thread(void *param)
+{
+	unsigned seed = (unsigned)(uintptr_t)param;
+	void *held[8] = {0};
+
+	for (int i = 0; i < ITERATIONS; i++) {
+		size_t slot;
+
+		seed = seed * 1103515245 + 12345;
+		slot = (seed >> 16) % 8;
+
+		if (held[slot]) {
+			frame_pool_free(held[slot]);
+			held[slot] = NULL;
+		} else {
+			size_t size = 64 * 1024 + ((seed >> 8) % (4 * MB));
+			held[slot] = frame_pool_alloc(size);
+			memset(held[slot], (int)slot, 64);
+		}
+	}
+
+	for (size_t i = 0; i < 8; i++)
+		frame_pool_free(held[i]);
+	return NULL;
+}
+
+static void thread_test(void **state)
+{
+	struct frame_pool_stats before, after;
+	pthread_t threads[NUM_THREADS];
+
+	UNUSED_PARAMETER(state);
+
+	frame_pool_get_stats(&before);
+
+	for (uintptr_t i = 0; i < NUM_THREADS; i++)
+		pthread_create(&threads[i], NULL, stress_thread,
+			       (void *)(i + 1));
+	for (size_t i = 0; i < NUM_THREADS; i++)
+		pthread_join(threads[i], NULL);
+
+	frame_pool_get_stats(&after);
+	assert_int_equal(after.in_use_bytes, before.in_use_bytes);
+	assert_true(after.hits > before.hits);
+
+	frame_pool_trim(0);
+	frame_pool_get_stats(&after);
+	assert_int_equal(after.cached_bytes, 0);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(reuse_test),
+		cmocka_unit_test(passthrough_test),
+		cmocka_unit_test(limit_test),
+		cmocka_unit_test(video_frame_test),
+		cmocka_unit_test(thread_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
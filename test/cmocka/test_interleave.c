@@ -0,0 +1,259 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdio.h>
+#include <cmocka.h>
+
+#include <obs-interleave.h>
+#include <util/darray.h>
+#include <util/platform.h>
+
+#define VIDEO_FRAME_USEC 16667
+#define AUDIO_FRAME_USEC 21333
+
+static void make_packet(struct encoder_packet *packet,
+			enum obs_encoder_type type, size_t track_idx,
+			int64_t dts_usec)
+{
+	memset(packet, 0, sizeof(*packet));
+	packet->type = type;
+	packet->track_idx = track_idx;
+	packet->dts = dts_usec;
+	packet->pts = dts_usec;
+	packet->dts_usec = dts_usec;
+	packet->timebase_num = 1;
+	packet->timebase_den = 1000000;
+}
+
+/* the next packet of the stream with the lowest timestamp, which is the order
+ * encoders would emit them in */
+static void next_packet(struct encoder_packet *packet, size_t video_tracks,
+			size_t audio_tracks, int64_t *video_ts,
+			int64_t *audio_ts)
+{
+	size_t best = 0;
+	int64_t best_ts = INT64_MAX;
+
+	for (size_t i = 0; i < video_tracks + audio_tracks; i++) {
+		int64_t ts = i < video_tracks ? video_ts[i]
+					      : audio_ts[i - video_tracks];
+		if (ts < best_ts) {
+			best_ts = ts;
+			best = i;
+		}
+	}
+
+	if (best < video_tracks) {
+		make_packet(packet, OBS_ENCODER_VIDEO, best, best_ts);
+		video_ts[best] += VIDEO_FRAME_USEC;
+	} else {
+		best -= video_tracks;
+		make_packet(packet, OBS_ENCODER_AUDIO, best, best_ts);
+		audio_ts[best] += AUDIO_FRAME_USEC + (int64_t)best * 7;
+	}
+}
+
+static void interleave_order_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct interleave_queue q = {0};
+	struct encoder_packet packet;
+	struct encoder_packet prev;
+
+	/* push each track separately, so packets arrive out of order */
+	for (size_t track = 0; track < 3; track++) {
+		for (int64_t i = 0; i < 50; i++) {
+			make_packet(&packet, OBS_ENCODER_VIDEO, track,
+				    i * VIDEO_FRAME_USEC);
+			interleave_queue_push(&q, &packet);
+		}
+	}
+	for (size_t track = 0; track < MAX_OUTPUT_AUDIO_ENCODERS; track++) {
+		for (int64_t i = 0; i < 40; i++) {
+			make_packet(&packet, OBS_ENCODER_AUDIO, track,
+				    i * AUDIO_FRAME_USEC);
+			interleave_queue_push(&q, &packet);
+		}
+	}
+
+	assert_int_equal(q.num, 3 * 50 + MAX_OUTPUT_AUDIO_ENCODERS * 40);
+	assert_true(interleave_queue_pop(&q, &prev));
+
+	while (interleave_queue_pop(&q, &packet)) {
+		assert_true(packet.dts_usec >= prev.dts_usec);
+
+		/* video comes before audio on equal timestamps, and tracks
+		 * of the same type are ordered by index */
+		if (packet.dts_usec == prev.dts_usec) {
+			if (packet.type == prev.type)
+				assert_true(packet.track_idx > prev.track_idx);
+			else
+				assert_int_equal(packet.type,
+						 OBS_ENCODER_AUDIO);
+		}
+
+		prev = packet;
+	}
+
+	assert_int_equal(q.num, 0);
+	assert_null(interleave_queue_peek(&q));
+	interleave_queue_free(&q);
+}
+
+static void interleave_track_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct interleave_queue q = {0};
+	struct encoder_packet packet;
+
+	make_packet(&packet, OBS_ENCODER_AUDIO, 1, 100);
+	interleave_queue_push(&q, &packet);
+	make_packet(&packet, OBS_ENCODER_AUDIO, 1, 200);
+	interleave_queue_push(&q, &packet);
+	make_packet(&packet, OBS_ENCODER_VIDEO, 0, 150);
+	interleave_queue_push(&q, &packet);
+	make_packet(&packet, OBS_ENCODER_VIDEO, 0, 200);
+	interleave_queue_push(&q, &packet);
+
+	assert_null(interleave_queue_head(&q, OBS_ENCODER_AUDIO, 0));
+	assert_int_equal(
+		interleave_queue_head(&q, OBS_ENCODER_AUDIO, 1)->dts_usec, 100);
+	assert_int_equal(
+		interleave_queue_tail(&q, OBS_ENCODER_AUDIO, 1)->dts_usec, 200);
+	assert_int_equal(
+		interleave_queue_tail(&q, OBS_ENCODER_VIDEO, 0)->dts_usec, 200);
+
+	/* audio 100, video 150, video 200, audio 200 */
+	struct encoder_packet *video =
+		interleave_queue_tail(&q, OBS_ENCODER_VIDEO, 0);
+	struct encoder_packet *audio =
+		interleave_queue_tail(&q, OBS_ENCODER_AUDIO, 1);
+	assert_int_equal(interleave_queue_count_before(&q, video), 2);
+	assert_int_equal(interleave_queue_count_before(&q, audio), 3);
+
+	interleave_queue_discard(&q, 2);
+	assert_int_equal(q.num, 2);
+	assert_int_equal(interleave_queue_peek(&q)->type, OBS_ENCODER_VIDEO);
+	assert_int_equal(interleave_queue_peek(&q)->dts_usec, 200);
+
+	interleave_queue_free(&q);
+	assert_int_equal(q.num, 0);
+}
+
+/* ------------------------------------------------------------------------- */
+/* benchmark against the previous sorted array insert */
+
+static void sorted_insert(struct darray *da, struct encoder_packet *out)
+{
+	DARRAY(struct encoder_packet) packets;
+	size_t idx;
+
+	packets.da = *da;
+
+	for (idx = 0; idx < packets.num; idx++) {
+		struct encoder_packet *cur = packets.array + idx;
+
+		if (out->dts_usec == cur->dts_usec &&
+		    out->type == OBS_ENCODER_VIDEO &&
+		    cur->type == OBS_ENCODER_VIDEO &&
+		    out->track_idx > cur->track_idx)
+			continue;
+
+		if (out->dts_usec == cur->dts_usec &&
+		    out->type == OBS_ENCODER_VIDEO) {
+			break;
+		} else if (out->dts_usec < cur->dts_usec) {
+			break;
+		}
+	}
+
+	da_insert(packets, idx, out);
+	*da = packets.da;
+}
+
+static uint64_t run_sorted_array(size_t video_tracks, size_t audio_tracks,
+				 size_t depth, size_t count)
+{
+	DARRAY(struct encoder_packet) packets = {0};
+	int64_t video_ts[MAX_OUTPUT_VIDEO_ENCODERS] = {0};
+	int64_t audio_ts[MAX_OUTPUT_AUDIO_ENCODERS] = {0};
+	struct encoder_packet packet;
+	uint64_t start = os_gettime_ns();
+
+	for (size_t i = 0; i < count; i++) {
+		next_packet(&packet, video_tracks, audio_tracks, video_ts,
+			    audio_ts);
+		sorted_insert(&packets.da, &packet);
+
+		if (packets.num > depth)
+			da_erase(packets, 0);
+	}
+
+	da_free(packets);
+	return os_gettime_ns() - start;
+}
+
+static uint64_t run_interleave_queue(size_t video_tracks, size_t audio_tracks,
+				     size_t depth, size_t count)
+{
+	struct interleave_queue q = {0};
+	int64_t video_ts[MAX_OUTPUT_VIDEO_ENCODERS] = {0};
+	int64_t audio_ts[MAX_OUTPUT_AUDIO_ENCODERS] = {0};
+	struct encoder_packet packet;
+	uint64_t start = os_gettime_ns();
+
+	for (size_t i = 0; i < count; i++) {
+		next_packet(&packet, video_tracks, audio_tracks, video_ts,
+			    audio_ts);
+		interleave_queue_push(&q, &packet);
+
+		if (q.num > depth)
+			interleave_queue_pop(&q, &packet);
+	}
+
+	interleave_queue_free(&q);
+	return os_gettime_ns() - start;
+}
+
+static void interleave_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	static const size_t track_counts[][2] = {
+		{1, 1}, {1, 6}, {3, 6}, {6, 6}};
+	static const size_t depths[] = {16, 256, 2048};
+	const size_t count = 20000;
+
+	printf("tracks (v+a)  depth   sorted array ns/pkt  "
+	       "interleave queue ns/pkt\n");
+
+	for (size_t t = 0; t < sizeof(track_counts) / sizeof(track_counts[0]);
+	     t++) {
+		for (size_t d = 0; d < sizeof(depths) / sizeof(depths[0]);
+		     d++) {
+			size_t v = track_counts[t][0];
+			size_t a = track_counts[t][1];
+			uint64_t old_ns =
+				run_sorted_array(v, a, depths[d], count);
+			uint64_t new_ns =
+				run_interleave_queue(v, a, depths[d], count);
+
+			printf("%5zu+%-6zu  %5zu   %19.1f  %23.1f\n", v, a,
+			       depths[d], (double)old_ns / count,
+			       (double)new_ns / count);
+		}
+	}
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(interleave_order_test),
+		cmocka_unit_test(interleave_track_test),
+		cmocka_unit_test(interleave_benchmark),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
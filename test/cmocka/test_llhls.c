@@ -0,0 +1,951 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <string.h>
+
+#include <llhls-segmenter.h>
+#include <util/bmem.h>
+#include <util/dstr.h>
+
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
+/* the output is built into the test, so that its uploads can be checked
+ * against a local server */
+#include "llhls-output.c"
+
+#define FPS 30
+#define SAMPLE_RATE 48000
+#define AUDIO_FRAME_SIZE 1024
+#define KEYFRAME_INTERVAL 30
+#define FRAMES_PER_PART 6
+
+/* seven and a half segments */
+#define STREAM_END (7 * KEYFRAME_INTERVAL + KEYFRAME_INTERVAL / 2)
+
+#define SAMPLE_FLAGS_SYNC 0x02000000
+#define SAMPLE_FLAGS_NON_SYNC 0x01010000
+
+const char *obs_module_text(const char *val)
+{
+	return val;
+}
+
+/* ------------------------------------------------------------------------- */
+/* in-memory target */
+
+struct test_file {
+	char *name;
+	DARRAY(uint8_t) data;
+};
+
+struct test_target {
+	DARRAY(struct test_file) files;
+	long deleted;
+};
+
+static struct test_file *find_file(struct test_target *target,
+				   const char *name)
+{
+	for (size_t i = 0; i < target->files.num; i++) {
+		if (strcmp(target->files.array[i].name, name) == 0)
+			return &target->files.array[i];
+	}
+
+	return NULL;
+}
+
+static bool target_write_file(void *param, const char *name,
+			      const void *data, size_t size,
+			      const char *content_type)
+{
+	struct test_target *target = param;
+	struct test_file *file = find_file(target, name);
+
+	UNUSED_PARAMETER(content_type);
+
+	if (!file) {
+		file = da_push_back_new(target->files);
+		file->name = bstrdup(name);
+	}
+
+	da_resize(file->data, 0);
+	da_push_back_array(file->data, (const uint8_t *)data, size);
+	return true;
+}
+
+static void target_delete_file(void *param, const char *name)
+{
+	struct test_target *target = param;
+	struct test_file *file = find_file(target, name);
+
+	if (!file)
+		return;
+
+	bfree(file->name);
+	da_free(file->data);
+	da_erase_item(target->files, file);
+	target->deleted++;
+}
+
+static void free_target(struct test_target *target)
+{
+	for (size_t i = 0; i < target->files.num; i++) {
+		bfree(target->files.array[i].name);
+		da_free(target->files.array[i].data);
+	}
+
+	da_free(target->files);
+}
+
+static bool test_init_tracks(void *param, struct fmp4_track *tracks)
+{
+	static const uint8_t avcc[] = {1,    0x64, 0, 0x1f, 0xff, 0xe1, 0,
+				       4,    0x67, 0x64, 0,  0x1f, 1,    0,
+				       4,    0x68, 0xee, 0x3c, 0x80};
+	static const uint8_t asc[] = {0x11, 0x90};
+	struct fmp4_track *video = &tracks[LLHLS_VIDEO_TRACK];
+	struct fmp4_track *audio = &tracks[LLHLS_AUDIO_TRACK];
+
+	UNUSED_PARAMETER(param);
+
+	video->config = bmemdup(avcc, sizeof(avcc));
+	video->config_size = sizeof(avcc);
+	video->width = 1280;
+	video->height = 720;
+
+	audio->config = bmemdup(asc, sizeof(asc));
+	audio->config_size = sizeof(asc);
+	audio->sample_rate = SAMPLE_RATE;
+	audio->timescale = SAMPLE_RATE;
+	audio->channels = 2;
+	return true;
+}
+
+static void init_segmenter(struct llhls_segmenter *hls,
+			   struct test_target *target)
+{
+	memset(hls, 0, sizeof(*hls));
+	memset(target, 0, sizeof(*target));
+
+	hls->playlist_name = "index.m3u8";
+	hls->segment_duration_ms = 1000;
+	hls->part_duration_ms = 200;
+	hls->playlist_size = 3;
+	hls->delete_segments = true;
+	hls->param = target;
+	hls->init_tracks = test_init_tracks;
+	hls->write_file = target_write_file;
+	hls->delete_file = target_delete_file;
+	llhls_segmenter_reset(hls);
+}
+
+/* ------------------------------------------------------------------------- */
+/* synthetic stream */
+
+/* sizes that are different for every frame, so that a sample that ends up
+ * in the wrong place shows */
+static inline size_t video_nal_size(int64_t frame)
+{
+	return 100 + (size_t)(frame % 7) * 3;
+}
+
+static inline size_t audio_frame_size(int64_t frame)
+{
+	return 40 + (size_t)(frame % 5);
+}
+
+static inline uint8_t sample_fill(int64_t frame)
+{
+	return (uint8_t)(0x80 | (frame & 0x7F));
+}
+
+static bool send_packet(struct llhls_segmenter *hls, bool video,
+			int64_t frame)
+{
+	struct encoder_packet packet = {0};
+	bool success;
+	size_t size = video ? 4 + video_nal_size(frame)
+			    : audio_frame_size(frame);
+	long *refs = bmalloc(sizeof(long) + size);
+	uint8_t *data = (uint8_t *)(refs + 1);
+
+	*refs = 1;
+	/* no zeros, which could be mistaken for start codes */
+	memset(data, (int)sample_fill(frame), size);
+
+	if (video) {
+		bool keyframe = frame % KEYFRAME_INTERVAL == 0;
+
+		/* annex b, with an IDR slice for keyframes */
+		data[0] = data[1] = data[2] = 0;
+		data[3] = 1;
+		data[4] = keyframe ? 0x65 : 0x41;
+
+		packet.type = OBS_ENCODER_VIDEO;
+		packet.timebase_num = 1;
+		packet.timebase_den = FPS;
+		packet.dts = frame;
+		packet.dts_usec = frame * 1000000 / FPS;
+		packet.keyframe = keyframe;
+	} else {
+		packet.type = OBS_ENCODER_AUDIO;
+		packet.timebase_num = 1;
+		packet.timebase_den = SAMPLE_RATE;
+		packet.dts = frame * AUDIO_FRAME_SIZE;
+		packet.dts_usec = packet.dts * 1000000 / SAMPLE_RATE;
+	}
+
+	packet.pts = packet.dts;
+	packet.data = data;
+	packet.size = size;
+
+	success = llhls_segmenter_packet(hls, &packet);
+	obs_encoder_packet_release(&packet);
+	return success;
+}
+
+struct stream {
+	int64_t video_frames;
+	int64_t audio_frames;
+};
+
+/* sends both tracks in interleaved order until the video reaches a frame,
+ * or a file could not be written */
+static bool send_until(struct llhls_segmenter *hls, struct stream *s,
+		       int64_t video_frame)
+{
+	while (s->video_frames < video_frame) {
+		int64_t video_usec = s->video_frames * 1000000 / FPS;
+		int64_t audio_usec = s->audio_frames * AUDIO_FRAME_SIZE *
+				     1000000 / SAMPLE_RATE;
+		bool success;
+
+		if (video_usec <= audio_usec)
+			success = send_packet(hls, true, s->video_frames++);
+		else
+			success = send_packet(hls, false, s->audio_frames++);
+		if (!success)
+			return false;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* boxes */
+
+static inline uint32_t rb32(const uint8_t *p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+	       ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline uint64_t rb64(const uint8_t *p)
+{
+	return ((uint64_t)rb32(p) << 32) | rb32(p + 4);
+}
+
+/* checks that the boxes exactly fill the range and returns the one with the
+ * given type, counting from 0 */
+static const uint8_t *find_box(const uint8_t *data, size_t size,
+			       const char *type, size_t nth,
+			       uint32_t *box_size)
+{
+	const uint8_t *found = NULL;
+	size_t pos = 0;
+
+	while (pos < size) {
+		uint32_t cur_size;
+
+		assert_true(size - pos >= 8);
+		cur_size = rb32(data + pos);
+		assert_true(cur_size >= 8 && cur_size <= size - pos);
+
+		if (!found && memcmp(data + pos + 4, type, 4) == 0 && !nth--) {
+			found = data + pos;
+			*box_size = cur_size;
+		}
+
+		pos += cur_size;
+	}
+
+	assert_int_equal(pos, size);
+	assert_non_null(found);
+	return found;
+}
+
+#define box_payload(box) ((box) + 8)
+#define full_box_payload(box) ((box) + 12)
+
+static void check_init_segment(struct test_target *target)
+{
+	struct test_file *file = find_file(target, LLHLS_INIT_SEGMENT_NAME);
+	const uint8_t *moov;
+	const uint8_t *mvex;
+	const uint8_t *box;
+	uint32_t moov_size;
+	uint32_t mvex_size;
+	uint32_t size;
+
+	assert_non_null(file);
+
+	box = find_box(file->data.array, file->data.num, "ftyp", 0, &size);
+	assert_memory_equal(box_payload(box), "iso6", 4);
+
+	/* both tracks are in one file, so it can't claim to be CMAF */
+	for (uint32_t i = 16; i < size; i += 4)
+		assert_memory_not_equal(box + i, "cmfc", 4);
+	moov = find_box(file->data.array, file->data.num, "moov", 0,
+			&moov_size);
+
+	box = find_box(box_payload(moov), moov_size - 8, "mvhd", 0, &size);
+	assert_int_equal(rb32(full_box_payload(box) + 8), 1000);
+	assert_int_equal(rb32(box + size - 4), 3); /* next track id */
+
+	for (size_t i = 0; i < LLHLS_NUM_TRACKS; i++) {
+		uint32_t trak_size;
+		const uint8_t *trak = find_box(box_payload(moov), moov_size - 8,
+					       "trak", i, &trak_size);
+
+		box = find_box(box_payload(trak), trak_size - 8, "tkhd", 0,
+			       &size);
+		assert_int_equal(rb32(full_box_payload(box) + 8), i + 1);
+	}
+
+	mvex = find_box(box_payload(moov), moov_size - 8, "mvex", 0,
+			&mvex_size);
+	find_box(box_payload(mvex), mvex_size - 8, "trex", 1, &size);
+}
+
+struct fragment_info {
+	uint32_t sequence;
+	uint64_t base_time[LLHLS_NUM_TRACKS];
+	uint32_t samples[LLHLS_NUM_TRACKS];
+	uint32_t first_flags;
+	uint64_t duration[LLHLS_NUM_TRACKS];
+};
+
+/* checks the layout of a part, and that every trun points at its track's
+ * samples in the mdat */
+static void check_fragment(const uint8_t *data, size_t size,
+			   struct fragment_info *info)
+{
+	const uint8_t *moof;
+	const uint8_t *mdat;
+	const uint8_t *box;
+	uint32_t moof_size;
+	uint32_t mdat_size;
+	uint32_t size32;
+	size_t offset;
+
+	memset(info, 0, sizeof(*info));
+
+	moof = find_box(data, size, "moof", 0, &moof_size);
+	mdat = find_box(data, size, "mdat", 0, &mdat_size);
+	assert_ptr_equal(moof, data);
+	assert_ptr_equal(mdat, data + moof_size);
+
+	box = find_box(box_payload(moof), moof_size - 8, "mfhd", 0, &size32);
+	info->sequence = rb32(full_box_payload(box));
+
+	offset = moof_size + 8;
+
+	for (size_t i = 0; i < LLHLS_NUM_TRACKS; i++) {
+		const uint8_t *traf;
+		const uint8_t *trun;
+		const uint8_t *entry;
+		uint32_t traf_size;
+		uint32_t trun_size;
+		uint32_t flags;
+		size_t entry_size;
+		size_t data_size = 0;
+
+		traf = find_box(box_payload(moof), moof_size - 8, "traf", i,
+				&traf_size);
+
+		box = find_box(box_payload(traf), traf_size - 8, "tfhd", 0,
+			       &size32);
+		assert_int_equal(rb32(full_box_payload(box)), i + 1);
+
+		box = find_box(box_payload(traf), traf_size - 8, "tfdt", 0,
+			       &size32);
+		assert_int_equal(box[8], 1);
+		info->base_time[i] = rb64(full_box_payload(box));
+
+		trun = find_box(box_payload(traf), traf_size - 8, "trun", 0,
+				&trun_size);
+		flags = rb32(trun + 8) & 0xFFFFFF;
+		entry_size = i == LLHLS_VIDEO_TRACK ? 16 : 12;
+		info->samples[i] = rb32(full_box_payload(trun));
+		assert_int_equal(trun_size,
+				 12 + 8 + info->samples[i] * entry_size);
+		assert_int_equal(flags & 0x800,
+				 i == LLHLS_VIDEO_TRACK ? 0x800 : 0);
+
+		/* data offset, relative to the start of the moof */
+		assert_int_equal(rb32(full_box_payload(trun) + 4), offset);
+
+		entry = full_box_payload(trun) + 8;
+		for (uint32_t j = 0; j < info->samples[i]; j++) {
+			info->duration[i] += rb32(entry);
+			data_size += rb32(entry + 4);
+			if (i == LLHLS_VIDEO_TRACK && j == 0)
+				info->first_flags = rb32(entry + 8);
+			entry += entry_size;
+		}
+
+		offset += data_size;
+	}
+
+	assert_int_equal(offset, size);
+	assert_int_equal(mdat_size, size - moof_size);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static const char *playlist_text(struct test_target *target)
+{
+	struct test_file *file = find_file(target, "index.m3u8");
+
+	assert_non_null(file);
+	da_push_back(file->data, &(uint8_t){0});
+	file->data.num--;
+	return (const char *)file->data.array;
+}
+
+static void llhls_playlist_test(void **state)
+{
+	struct llhls_segmenter hls;
+	struct test_target target;
+	struct stream s = {0};
+	long allocs = bnum_allocs();
+
+	UNUSED_PARAMETER(state);
+
+	init_segmenter(&hls, &target);
+
+	/* through the first part of the second segment */
+	assert_true(
+		send_until(&hls, &s, KEYFRAME_INTERVAL + FRAMES_PER_PART + 1));
+
+	assert_string_equal(
+		playlist_text(&target),
+		"#EXTM3U\n"
+		"#EXT-X-VERSION:9\n"
+		"#EXT-X-INDEPENDENT-SEGMENTS\n"
+		"#EXT-X-TARGETDURATION:1\n"
+		"#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=0.600\n"
+		"#EXT-X-PART-INF:PART-TARGET=0.200\n"
+		"#EXT-X-MEDIA-SEQUENCE:0\n"
+		"#EXT-X-MAP:URI=\"init.mp4\"\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment0.0.m4s\","
+		"INDEPENDENT=YES\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment0.1.m4s\"\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment0.2.m4s\"\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment0.3.m4s\"\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment0.4.m4s\"\n"
+		"#EXTINF:1.00000,\n"
+		"segment0.m4s\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment1.0.m4s\","
+		"INDEPENDENT=YES\n"
+		"#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"segment1.1.m4s\"\n");
+
+	/* to the end of the stream, then stop */
+	assert_true(send_until(&hls, &s, STREAM_END));
+	assert_true(llhls_segmenter_finish(&hls));
+
+	/* three segments are listed, the two before them are kept for
+	 * players that are still downloading them, and the rest is gone */
+	assert_string_equal(
+		playlist_text(&target),
+		"#EXTM3U\n"
+		"#EXT-X-VERSION:9\n"
+		"#EXT-X-INDEPENDENT-SEGMENTS\n"
+		"#EXT-X-TARGETDURATION:1\n"
+		"#EXT-X-SERVER-CONTROL:PART-HOLD-BACK=0.600\n"
+		"#EXT-X-PART-INF:PART-TARGET=0.200\n"
+		"#EXT-X-MEDIA-SEQUENCE:5\n"
+		"#EXT-X-MAP:URI=\"init.mp4\"\n"
+		"#EXTINF:1.00000,\n"
+		"segment5.m4s\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment6.0.m4s\","
+		"INDEPENDENT=YES\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment6.1.m4s\"\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment6.2.m4s\"\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment6.3.m4s\"\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment6.4.m4s\"\n"
+		"#EXTINF:1.00000,\n"
+		"segment6.m4s\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment7.0.m4s\","
+		"INDEPENDENT=YES\n"
+		"#EXT-X-PART:DURATION=0.20000,URI=\"segment7.1.m4s\"\n"
+		"#EXT-X-PART:DURATION=0.10000,URI=\"segment7.2.m4s\"\n"
+		"#EXTINF:0.50000,\n"
+		"segment7.m4s\n"
+		"#EXT-X-ENDLIST\n");
+
+	assert_null(find_file(&target, "segment2.m4s"));
+	assert_null(find_file(&target, "segment2.4.m4s"));
+	assert_non_null(find_file(&target, "segment3.m4s"));
+	assert_int_equal(target.deleted, 3 * 6);
+
+	llhls_segmenter_reset(&hls);
+	free_target(&target);
+	assert_int_equal(bnum_allocs(), allocs);
+}
+
+static void llhls_boxes_test(void **state)
+{
+	struct llhls_segmenter hls;
+	struct test_target target;
+	struct stream s = {0};
+	struct dstr name = {0};
+	uint64_t video_time = 0;
+	uint64_t audio_time = 0;
+	uint32_t sequence = 0;
+
+	UNUSED_PARAMETER(state);
+
+	init_segmenter(&hls, &target);
+	assert_true(send_until(&hls, &s, 2 * KEYFRAME_INTERVAL + 1));
+
+	check_init_segment(&target);
+
+	for (size_t seg = 0; seg < 2; seg++) {
+		struct test_file *segment;
+		DARRAY(uint8_t) joined = {0};
+
+		for (size_t part = 0; part < 5; part++) {
+			struct fragment_info info;
+			struct test_file *file;
+
+			dstr_printf(&name, "segment%zu.%zu.m4s", seg, part);
+			file = find_file(&target, name.array);
+			assert_non_null(file);
+
+			check_fragment(file->data.array, file->data.num,
+				       &info);
+
+			/* fragments are numbered in order, and each track
+			 * continues where its previous part ended */
+			assert_int_equal(info.sequence, ++sequence);
+			assert_int_equal(info.base_time[LLHLS_VIDEO_TRACK],
+					 video_time);
+			assert_int_equal(info.base_time[LLHLS_AUDIO_TRACK],
+					 audio_time);
+			assert_int_equal(info.samples[LLHLS_VIDEO_TRACK],
+					 FRAMES_PER_PART);
+			assert_int_equal(info.duration[LLHLS_VIDEO_TRACK],
+					 FRAMES_PER_PART);
+			assert_int_equal(info.duration[LLHLS_AUDIO_TRACK],
+					 info.samples[LLHLS_AUDIO_TRACK] *
+						 AUDIO_FRAME_SIZE);
+			assert_int_equal(info.first_flags,
+					 part == 0 ? SAMPLE_FLAGS_SYNC
+						   : SAMPLE_FLAGS_NON_SYNC);
+
+			video_time += info.duration[LLHLS_VIDEO_TRACK];
+			audio_time += info.duration[LLHLS_AUDIO_TRACK];
+
+			da_push_back_array(joined, file->data.array,
+					   file->data.num);
+		}
+
+		/* a segment is exactly its parts */
+		dstr_printf(&name, "segment%zu.m4s", seg);
+		segment = find_file(&target, name.array);
+		assert_non_null(segment);
+		assert_int_equal(segment->data.num, joined.num);
+		assert_memory_equal(segment->data.array, joined.array,
+				    joined.num);
+		da_free(joined);
+	}
+
+	/* the audio of the two segments ends with their video, give or take
+	 * the audio frame that was still waiting for its duration */
+	assert_true(audio_time <= 2 * SAMPLE_RATE);
+	assert_true(audio_time > 2 * SAMPLE_RATE - 2 * AUDIO_FRAME_SIZE);
+
+	/* the video samples are the length prefixed nals that were sent */
+	{
+		struct test_file *file = find_file(&target, "segment1.0.m4s");
+		uint32_t moof_size = rb32(file->data.array);
+		const uint8_t *sample = file->data.array + moof_size + 8;
+
+		for (int64_t frame = KEYFRAME_INTERVAL;
+		     frame < KEYFRAME_INTERVAL + FRAMES_PER_PART; frame++) {
+			size_t nal_size = video_nal_size(frame);
+
+			assert_int_equal(rb32(sample), nal_size);
+			assert_int_equal(sample[4],
+					 frame == KEYFRAME_INTERVAL ? 0x65
+								    : 0x41);
+			assert_int_equal(sample[5], sample_fill(frame));
+			sample += 4 + nal_size;
+		}
+	}
+
+	dstr_free(&name);
+	llhls_segmenter_reset(&hls);
+	free_target(&target);
+}
+
+#ifndef _WIN32
+/* ------------------------------------------------------------------------- */
+/* local HTTP server, which takes PUT and DELETE requests under /live/ */
+
+#define SERVER_PATH "/live/"
+
+struct test_server {
+	int fd;
+	int port;
+	pthread_t thread;
+	volatile bool stop;
+
+	pthread_mutex_t mutex;
+	struct test_target files;
+	long fail_puts;
+	long failed_puts;
+	long bad_requests;
+};
+
+static const char *header_value(const char *head, const char *name,
+				struct dstr *value)
+{
+	const char *line = strstr(head, "\r\n");
+	size_t len = strlen(name);
+
+	while (line && line[2] != '\r') {
+		line += 2;
+
+		if (astrcmpi_n(line, name, len) == 0 && line[len] == ':') {
+			line += len + 1;
+			while (*line == ' ')
+				line++;
+
+			dstr_ncopy(value, line, strstr(line, "\r\n") - line);
+			return value->array;
+		}
+
+		line = strstr(line, "\r\n");
+	}
+
+	return NULL;
+}
+
+static inline const char *expected_content_type(const char *name)
+{
+	const char *ext = strrchr(name, '.');
+	return ext && strcmp(ext, ".m3u8") == 0
+		       ? "application/vnd.apple.mpegurl"
+		       : "video/mp4";
+}
+
+static int handle_request(struct test_server *server, const char *method,
+			  const char *path, const char *content_type,
+			  const uint8_t *body, size_t size)
+{
+	const char *name = path + strlen(SERVER_PATH);
+	int status = 200;
+
+	if (strncmp(path, SERVER_PATH, strlen(SERVER_PATH)) != 0)
+		return 404;
+
+	pthread_mutex_lock(&server->mutex);
+
+	if (strcmp(method, "PUT") == 0) {
+		if (!content_type ||
+		    strcmp(content_type, expected_content_type(name)) != 0) {
+			server->bad_requests++;
+			status = 400;
+		} else if (server->fail_puts) {
+			server->fail_puts--;
+			server->failed_puts++;
+			status = 500;
+		} else {
+			target_write_file(&server->files, name, body, size,
+					  content_type);
+		}
+
+	} else if (strcmp(method, "DELETE") == 0) {
+		target_delete_file(&server->files, name);
+
+	} else {
+		server->bad_requests++;
+		status = 405;
+	}
+
+	pthread_mutex_unlock(&server->mutex);
+	return status;
+}
+
+static bool receive(int fd, struct darray *data)
+{
+	char buf[4096];
+	ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+
+	if (ret <= 0)
+		return false;
+
+	darray_push_back_array(1, data, buf, (size_t)ret);
+	return true;
+}
+
+static void handle_connection(struct test_server *server, int fd)
+{
+	DARRAY(char) data = {0};
+	struct dstr method = {0};
+	struct dstr path = {0};
+	struct dstr value = {0};
+	const char *content_type;
+	const char *end = NULL;
+	size_t head_size;
+	size_t size = 0;
+	int status;
+
+	while (!end) {
+		if (!receive(fd, &data.da))
+			goto cleanup;
+
+		da_push_back(data, &(char){0});
+		data.num--;
+		end = strstr(data.array, "\r\n\r\n");
+	}
+
+	head_size = end + 4 - data.array;
+
+	/* "METHOD /path HTTP/1.1" */
+	dstr_ncopy(&method, data.array, strcspn(data.array, " "));
+	dstr_ncopy(&path, data.array + method.len + 1,
+		   strcspn(data.array + method.len + 1, " "));
+
+	if (header_value(data.array, "Content-Length", &value))
+		size = strtoul(value.array, NULL, 10);
+	if (header_value(data.array, "Expect", &value) &&
+	    data.num == head_size) {
+		static const char *response = "HTTP/1.1 100 Continue\r\n\r\n";
+		send(fd, response, strlen(response), 0);
+	}
+
+	while (data.num < head_size + size) {
+		if (!receive(fd, &data.da))
+			goto cleanup;
+	}
+
+	content_type = header_value(data.array, "Content-Type", &value);
+	status = handle_request(server, method.array, path.array, content_type,
+				(const uint8_t *)data.array + head_size, size);
+
+	dstr_printf(&value,
+		    "HTTP/1.1 %d %s\r\n"
+		    "Content-Length: 0\r\n"
+		    "Connection: close\r\n\r\n",
+		    status, status == 200 ? "OK" : "Error");
+	send(fd, value.array, value.len, 0);
+
+cleanup:
+	dstr_free(&value);
+	dstr_free(&path);
+	dstr_free(&method);
+	da_free(data);
+}
+
+static void *server_thread(void *data)
+{
+	struct test_server *server = data;
+
+	while (!os_atomic_load_bool(&server->stop)) {
+		struct pollfd pfd = {server->fd, POLLIN, 0};
+		int fd;
+
+		if (poll(&pfd, 1, 50) <= 0)
+			continue;
+
+		fd = accept(server->fd, NULL, NULL);
+		if (fd >= 0) {
+			handle_connection(server, fd);
+			close(fd);
+		}
+	}
+
+	return NULL;
+}
+
+static void start_server(struct test_server *server)
+{
+	struct sockaddr_in addr = {0};
+	socklen_t len = sizeof(addr);
+
+	memset(server, 0, sizeof(*server));
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	server->fd = socket(AF_INET, SOCK_STREAM, 0);
+	assert_true(server->fd >= 0);
+	assert_int_equal(bind(server->fd, (struct sockaddr *)&addr,
+			      sizeof(addr)),
+			 0);
+	assert_int_equal(listen(server->fd, 8), 0);
+	assert_int_equal(getsockname(server->fd, (struct sockaddr *)&addr,
+				     &len),
+			 0);
+	server->port = ntohs(addr.sin_port);
+
+	pthread_mutex_init(&server->mutex, NULL);
+	assert_int_equal(pthread_create(&server->thread, NULL, server_thread,
+					server),
+			 0);
+}
+
+static void stop_server(struct test_server *server)
+{
+	os_atomic_set_bool(&server->stop, true);
+	pthread_join(server->thread, NULL);
+	pthread_mutex_destroy(&server->mutex);
+	close(server->fd);
+}
+
+static void fail_puts(struct test_server *server, long count)
+{
+	pthread_mutex_lock(&server->mutex);
+	server->fail_puts = count;
+	pthread_mutex_unlock(&server->mutex);
+}
+
+static long failed_puts(struct test_server *server)
+{
+	long count;
+
+	pthread_mutex_lock(&server->mutex);
+	count = server->failed_puts;
+	pthread_mutex_unlock(&server->mutex);
+	return count;
+}
+
+/* the same settings, with the files uploaded by the output */
+static void init_upload(struct llhls_output *stream,
+			struct test_server *server)
+{
+	struct test_target unused;
+
+	memset(stream, 0, sizeof(*stream));
+	init_segmenter(&stream->hls, &unused);
+
+	stream->hls.param = stream;
+	stream->hls.write_file = write_file;
+	stream->hls.delete_file = delete_file;
+
+	stream->http = true;
+	stream->curl = curl_easy_init();
+	assert_non_null(stream->curl);
+	dstr_printf(&stream->path, "http://127.0.0.1:%d/live", server->port);
+}
+
+static void free_upload(struct llhls_output *stream)
+{
+	llhls_segmenter_reset(&stream->hls);
+	curl_easy_cleanup(stream->curl);
+	dstr_free(&stream->path);
+}
+
+static void llhls_upload_test(void **state)
+{
+	struct test_server server;
+	struct llhls_output stream;
+	struct llhls_segmenter hls;
+	struct test_target target;
+	struct stream s = {0};
+	struct stream ref = {0};
+
+	UNUSED_PARAMETER(state);
+
+	start_server(&server);
+	init_upload(&stream, &server);
+	init_segmenter(&hls, &target);
+
+	/* the same stream, uploaded and written to memory */
+	assert_true(send_until(&stream.hls, &s, STREAM_END));
+	assert_true(llhls_segmenter_finish(&stream.hls));
+	assert_true(send_until(&hls, &ref, STREAM_END));
+	assert_true(llhls_segmenter_finish(&hls));
+
+	stop_server(&server);
+
+	/* every file ends up on the server as it was written, and the
+	 * segments that were dropped from the playlist are deleted there */
+	assert_int_equal(server.bad_requests, 0);
+	assert_int_equal(server.files.files.num, target.files.num);
+	for (size_t i = 0; i < target.files.num; i++) {
+		struct test_file *file = &target.files.array[i];
+		struct test_file *uploaded =
+			find_file(&server.files, file->name);
+
+		assert_non_null(uploaded);
+		assert_int_equal(uploaded->data.num, file->data.num);
+		assert_memory_equal(uploaded->data.array, file->data.array,
+				    file->data.num);
+	}
+	assert_int_equal(server.files.deleted, target.deleted);
+	assert_true(target.deleted > 0);
+
+	assert_int_equal(stream.http_failures, 0);
+	assert_true(stream.total_bytes > 0);
+
+	free_upload(&stream);
+	free_target(&server.files);
+	llhls_segmenter_reset(&hls);
+	free_target(&target);
+}
+
+static void llhls_upload_failure_test(void **state)
+{
+	struct test_server server;
+	struct llhls_output stream;
+	struct stream s = {0};
+
+	UNUSED_PARAMETER(state);
+
+	start_server(&server);
+	init_upload(&stream, &server);
+
+	assert_true(send_until(&stream.hls, &s, KEYFRAME_INTERVAL));
+
+	/* a few failed uploads only lose those parts for the players */
+	fail_puts(&server, MAX_HTTP_FAILURES - 1);
+	assert_true(send_until(&stream.hls, &s, 3 * KEYFRAME_INTERVAL));
+	assert_int_equal(failed_puts(&server), MAX_HTTP_FAILURES - 1);
+	assert_int_equal(stream.http_failures, 0);
+
+	/* but the output gives up once the server keeps failing them */
+	fail_puts(&server, LONG_MAX);
+	assert_false(send_until(&stream.hls, &s, STREAM_END));
+	assert_int_equal(failed_puts(&server), 2 * MAX_HTTP_FAILURES - 1);
+
+	stop_server(&server);
+	assert_int_equal(server.bad_requests, 0);
+
+	free_upload(&stream);
+	free_target(&server.files);
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(llhls_playlist_test),
+		cmocka_unit_test(llhls_boxes_test),
+#ifndef _WIN32
+		cmocka_unit_test(llhls_upload_test),
+		cmocka_unit_test(llhls_upload_failure_test),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
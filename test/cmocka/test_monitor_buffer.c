@@ -0,0 +1,320 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <math.h>
+#include <string.h>
+
+#include <media-io/monitor-buffer.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#define SAMPLE_RATE 48000
+#define PACKET_FRAMES 480
+#define TARGET_MS 20
+
+/*
+ * A fake device that pulls chunks on its own clock, against a source that
+ * pushes 10 ms packets on the audio clock, simulated in virtual time.  The
+ * "resampler" just repeats or drops frames as the compensation asks.
+ */
+struct sim {
+	struct monitor_buffer *mb;
+	bool compensate;
+
+	double device_ppm;
+	uint32_t device_chunk;
+
+	double now;
+	double next_packet;
+	double next_read;
+
+	/* stop either side between these times */
+	double source_stop, source_resume;
+	double device_stop, device_resume;
+
+	int32_t packet[PACKET_FRAMES * 2];
+	int32_t chunk[4096];
+	int32_t counter;
+
+	long zero_reads;
+};
+
+static void sim_init(struct sim *sim, double device_ppm, bool compensate)
+{
+	memset(sim, 0, sizeof(*sim));
+	sim->mb = monitor_buffer_create(SAMPLE_RATE, sizeof(int32_t), 0,
+					TARGET_MS);
+	sim->compensate = compensate;
+	sim->device_ppm = device_ppm;
+	sim->device_chunk = 441;
+	sim->next_read = 0.003;
+	sim->source_stop = sim->device_stop = 1e9;
+}
+
+static void sim_free(struct sim *sim)
+{
+	monitor_buffer_destroy(sim->mb);
+}
+
+static void sim_packet(struct sim *sim)
+{
+	int delta = monitor_buffer_compensation(sim->mb, PACKET_FRAMES);
+	uint32_t frames = PACKET_FRAMES;
+
+	if (!sim->compensate)
+		delta = 0;
+
+	frames = (uint32_t)((int)frames + delta);
+	for (uint32_t i = 0; i < frames; i++)
+		sim->packet[i] = ++sim->counter;
+
+	monitor_buffer_push(sim->mb, sim->packet, frames);
+}
+
+static void sim_read(struct sim *sim)
+{
+	uint32_t got = monitor_buffer_read(sim->mb, sim->chunk,
+					   sim->device_chunk);
+	if (!got)
+		sim->zero_reads++;
+}
+
+static void sim_run(struct sim *sim, double seconds)
+{
+	const double end = sim->now + seconds;
+	const double device_rate =
+		SAMPLE_RATE * (1.0 + sim->device_ppm / 1000000.0);
+
+	while (sim->now < end) {
+		if (sim->next_packet <= sim->next_read) {
+			sim->now = sim->next_packet;
+			sim->next_packet += (double)PACKET_FRAMES / SAMPLE_RATE;
+
+			if (sim->now < sim->source_stop ||
+			    sim->now >= sim->source_resume)
+				sim_packet(sim);
+		} else {
+			sim->now = sim->next_read;
+			sim->next_read += (double)sim->device_chunk /
+					  device_rate;
+
+			if (sim->now < sim->device_stop ||
+			    sim->now >= sim->device_resume)
+				sim_read(sim);
+		}
+	}
+}
+
+static void drift(double ppm)
+{
+	struct monitor_buffer_stats before, after;
+	struct sim sim;
+	double average_ppm;
+
+	sim_init(&sim, ppm, true);
+
+	/* settle */
+	sim_run(&sim, 30.0);
+	monitor_buffer_get_stats(sim.mb, &before);
+
+	/* ten minutes */
+	sim_run(&sim, 600.0);
+	monitor_buffer_get_stats(sim.mb, &after);
+
+	/* the correction itself wobbles with the fill level, but on average
+	 * the source has to match the device's rate */
+	average_ppm = ((double)(after.pushed_frames - before.pushed_frames) /
+			       (600.0 * SAMPLE_RATE) -
+		       1.0) *
+		      1000000.0;
+
+	print_message("%+.0f ppm: latency %.2f ms, correction %+.1f ppm, "
+		      "%ld underruns, %ld overflows, %ld skips\n",
+		      ppm, after.latency_ms, average_ppm, after.underruns,
+		      after.overflows, after.skips);
+
+	assert_int_equal(after.underruns, before.underruns);
+	assert_int_equal(after.overflows, 0);
+	assert_int_equal(after.skips, 0);
+	assert_true(fabs(after.latency_ms - TARGET_MS) < 2.0);
+	assert_true(fabs(average_ppm - ppm) < 5.0);
+	assert_true(fabs(after.correction_ppm) <= 1000.0);
+
+	sim_free(&sim);
+}
+
+static void drift_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	drift(0.0);
+	drift(300.0);
+	drift(-300.0);
+	drift(800.0);
+}
+
+/* without compensation the same drift eventually runs the buffer dry */
+static void uncompensated_test(void **state)
+{
+	struct monitor_buffer_stats stats;
+	struct sim sim;
+
+	UNUSED_PARAMETER(state);
+
+	sim_init(&sim, 300.0, false);
+	sim_run(&sim, 600.0);
+	monitor_buffer_get_stats(sim.mb, &stats);
+	assert_true(stats.underruns > 0);
+	sim_free(&sim);
+
+	sim_init(&sim, -300.0, false);
+	sim_run(&sim, 600.0);
+	monitor_buffer_get_stats(sim.mb, &stats);
+	assert_true(stats.skips > 0 || stats.overflows > 0);
+	sim_free(&sim);
+}
+
+static void device_stall_test(void **state)
+{
+	struct monitor_buffer_stats stats;
+	struct sim sim;
+
+	UNUSED_PARAMETER(state);
+
+	sim_init(&sim, 0.0, true);
+	sim.device_stop = 10.0;
+	sim.device_resume = 12.0;
+
+	sim_run(&sim, 12.05);
+	monitor_buffer_get_stats(sim.mb, &stats);
+
+	/* the source kept going while the device was stuck, and the device
+	 * jumped back to the target latency when it came back */
+	assert_true(stats.overflows > 0);
+	assert_int_equal(stats.skips, 1);
+
+	sim_run(&sim, 10.0);
+	monitor_buffer_get_stats(sim.mb, &stats);
+	print_message("latency after stall: %.2f ms\n", stats.latency_ms);
+	assert_true(fabs(stats.latency_ms - TARGET_MS) < 2.0);
+
+	sim_free(&sim);
+}
+
+static void source_stop_test(void **state)
+{
+	struct monitor_buffer_stats stats;
+	struct sim sim;
+	long zero_reads;
+
+	UNUSED_PARAMETER(state);
+
+	sim_init(&sim, 0.0, true);
+	sim.source_stop = 10.0;
+	sim.source_resume = 11.0;
+
+	sim_run(&sim, 10.5);
+	monitor_buffer_get_stats(sim.mb, &stats);
+	assert_int_equal(stats.underruns, 1);
+
+	/* silence until the buffer is back at the target */
+	zero_reads = sim.zero_reads;
+	sim_run(&sim, 0.5);
+	assert_true(sim.zero_reads > zero_reads);
+
+	sim_run(&sim, 10.0);
+	monitor_buffer_get_stats(sim.mb, &stats);
+	assert_int_equal(stats.underruns, 1);
+	assert_true(fabs(stats.latency_ms - TARGET_MS) < 2.0);
+
+	sim_free(&sim);
+}
+
+/* the consumer must see the producer's frames in order, minus any that were
+ * dropped or skipped */
+#define THREAD_PACKETS 20000
+
+struct thread_data {
+	struct monitor_buffer *mb;
+	volatile bool done;
+};
+
+static void *producer_thread(void *param)
+{
+	struct thread_data *td = param;
+	int32_t packet[PACKET_FRAMES];
+	int32_t counter = 0;
+
+	for (int i = 0; i < THREAD_PACKETS; i++) {
+		for (size_t j = 0; j < PACKET_FRAMES; j++)
+			packet[j] = ++counter;
+		monitor_buffer_push(td->mb, packet, PACKET_FRAMES);
+		if ((i & 7) == 0)
+			os_sleep_ms(0);
+	}
+
+	os_atomic_set_bool(&td->done, true);
+	return NULL;
+}
+
+static void thread_test(void **state)
+{
+	struct monitor_buffer_stats stats;
+	struct thread_data td = {0};
+	int32_t chunk[441];
+	int32_t last = 0;
+	pthread_t thread;
+	uint64_t frames = 0;
+
+	UNUSED_PARAMETER(state);
+
+	td.mb = monitor_buffer_create(SAMPLE_RATE, sizeof(int32_t), 0,
+				      TARGET_MS);
+	pthread_create(&thread, NULL, producer_thread, &td);
+
+	for (;;) {
+		/* check before reading, so that an empty read after the
+		 * producer is done really is the end (the last partial target
+		 * never plays) */
+		bool done = os_atomic_load_bool(&td.done);
+		uint32_t got = monitor_buffer_read(td.mb, chunk, 441);
+
+		for (uint32_t i = 0; i < got; i++) {
+			assert_true(chunk[i] > last);
+			last = chunk[i];
+		}
+		for (uint32_t i = got; i < 441; i++)
+			assert_int_equal(chunk[i], 0);
+
+		frames += got;
+		if (!got) {
+			if (done)
+				break;
+			os_sleep_ms(1);
+		}
+	}
+
+	pthread_join(thread, NULL);
+
+	monitor_buffer_get_stats(td.mb, &stats);
+	assert_int_equal(stats.played_frames, frames);
+	assert_true(stats.pushed_frames +
+			    (uint64_t)stats.overflows * PACKET_FRAMES ==
+		    (uint64_t)THREAD_PACKETS * PACKET_FRAMES);
+	monitor_buffer_destroy(td.mb);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(drift_test),
+		cmocka_unit_test(uncompensated_test),
+		cmocka_unit_test(device_stall_test),
+		cmocka_unit_test(source_stop_test),
+		cmocka_unit_test(thread_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,198 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/threading.h>
+#include <util/util_uint64.h>
+
+/* the filter is built into the test, with the shared RNNoise worker replaced
+ * by the slow one below */
+#include "noise-suppress-filter.c"
+
+#define SAMPLE_RATE 48000
+#define CHANNELS 2
+#define PACKET_FRAMES 1024
+#define NUM_PACKETS 200
+
+/* every few frames the worker falls behind by a couple of packets */
+#define STALL_EVERY 7
+#define STALL_MS 40
+
+const char *obs_module_text(const char *val)
+{
+	return val;
+}
+
+/* leaves the frames as they are, so the output can be compared with the
+ * input */
+static struct {
+	pthread_mutex_t mutex;
+	pthread_t thread;
+	os_event_t *wake;
+	DARRAY(struct rnnoise_job *) queue;
+	volatile bool stop;
+	long jobs;
+} worker;
+
+static struct rnnoise_job *pop_job(void)
+{
+	struct rnnoise_job *job = NULL;
+
+	pthread_mutex_lock(&worker.mutex);
+	if (worker.queue.num) {
+		job = worker.queue.array[0];
+		da_erase(worker.queue, 0);
+	}
+	pthread_mutex_unlock(&worker.mutex);
+
+	return job;
+}
+
+static void *slow_worker_thread(void *param)
+{
+	struct rnnoise_job *job;
+
+	for (;;) {
+		os_event_wait(worker.wake);
+
+		while ((job = pop_job()) != NULL) {
+			if (++worker.jobs % STALL_EVERY == 0)
+				os_sleep_ms(STALL_MS);
+
+			os_atomic_set_bool(&job->finished, true);
+			os_event_signal(job->event);
+		}
+
+		if (os_atomic_load_bool(&worker.stop))
+			break;
+	}
+
+	UNUSED_PARAMETER(param);
+	return NULL;
+}
+
+void rnnoise_worker_acquire(void)
+{
+	pthread_mutex_init(&worker.mutex, NULL);
+	os_event_init(&worker.wake, OS_EVENT_TYPE_AUTO);
+	pthread_create(&worker.thread, NULL, slow_worker_thread, NULL);
+}
+
+void rnnoise_worker_release(void)
+{
+	os_atomic_set_bool(&worker.stop, true);
+	os_event_signal(worker.wake);
+	pthread_join(worker.thread, NULL);
+
+	os_event_destroy(worker.wake);
+	pthread_mutex_destroy(&worker.mutex);
+	da_free(worker.queue);
+}
+
+void rnnoise_worker_submit(struct rnnoise_job *job)
+{
+	os_atomic_set_bool(&job->finished, false);
+
+	pthread_mutex_lock(&worker.mutex);
+	da_push_back(worker.queue, &job);
+	pthread_mutex_unlock(&worker.mutex);
+
+	os_event_signal(worker.wake);
+}
+
+/* values that survive the scaling to and from RNNoise's range exactly */
+static float sample(size_t n, size_t channel)
+{
+	return (float)((int)((n * 7 + channel * 3) % 2000) - 1000) / 32768.0f;
+}
+
+static struct noise_suppress_data *create_filter(void)
+{
+	struct noise_suppress_data *ng = bzalloc(sizeof(*ng));
+
+	ng->frames = SAMPLE_RATE / (1000 / BUFFER_SIZE_MSEC);
+	ng->channels = CHANNELS;
+	ng->latency = 1000000000LL / (1000 / BUFFER_SIZE_MSEC);
+	ng->use_rnnoise = true;
+
+	ng->copy_buffers[0] = bmalloc(ng->frames * CHANNELS * sizeof(float));
+	for (size_t c = 1; c < CHANNELS; c++)
+		ng->copy_buffers[c] = ng->copy_buffers[c - 1] + ng->frames;
+	for (size_t c = 0; c < CHANNELS; c++)
+		alloc_channel(ng, SAMPLE_RATE, c, ng->frames);
+
+	alloc_rnnoise(ng, SAMPLE_RATE);
+	return ng;
+}
+
+static void slow_worker_test(void **state)
+{
+	struct noise_suppress_data *ng = create_filter();
+	float *data = bmalloc(PACKET_FRAMES * CHANNELS * sizeof(float));
+	const uint64_t packet_ns =
+		util_mul_div64(PACKET_FRAMES, 1000000000ULL, SAMPLE_RATE);
+	size_t out_frames = 0;
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t p = 0; p < NUM_PACKETS; p++) {
+		struct obs_audio_data audio = {0};
+		struct obs_audio_data *out;
+
+		for (size_t c = 0; c < CHANNELS; c++) {
+			float *channel = data + c * PACKET_FRAMES;
+
+			for (size_t i = 0; i < PACKET_FRAMES; i++)
+				channel[i] = sample(p * PACKET_FRAMES + i, c);
+			audio.data[c] = (uint8_t *)channel;
+		}
+
+		audio.frames = PACKET_FRAMES;
+		audio.timestamp = 1000000000ULL + p * packet_ns;
+
+		out = noise_suppress_filter_audio(ng, &audio);
+
+		/* only the first packet is held back, however long the
+		 * worker takes */
+		assert_true(ng->info_buffer.size <=
+			    sizeof(struct ng_audio_info));
+		if (!p) {
+			assert_null(out);
+			continue;
+		}
+
+		assert_non_null(out);
+		assert_int_equal(out->frames, PACKET_FRAMES);
+		assert_int_equal(out->timestamp,
+				 1000000000ULL + (p - 1) * packet_ns -
+					 ng->latency);
+
+		for (size_t c = 0; c < CHANNELS; c++) {
+			const float *channel = (const float *)out->data[c];
+
+			for (size_t i = 0; i < PACKET_FRAMES; i++)
+				assert_true(channel[i] ==
+					    sample(out_frames + i, c));
+		}
+
+		out_frames += PACKET_FRAMES;
+	}
+
+	/* and the worker really did fall behind */
+	assert_true(worker.jobs >= STALL_EVERY * 10);
+
+	noise_suppress_destroy(ng);
+	bfree(data);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(slow_worker_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
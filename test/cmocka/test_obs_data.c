@@ -0,0 +1,495 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <stdio.h>
+
+#include <obs-data.h>
+#include <util/platform.h>
+#include <util/bmem.h>
+
+#define TEST_FILE "test_obs_data.json"
+#define TEST_BINARY_FILE "test_obs_data.bin"
+
+static const char *test_json =
+	"{\n"
+	"  \"string\": \"a \\\"quoted\\\" \\u00e9\\ud83d\\ude00 \xc3\xa9\",\n"
+	"  \"int\": -42,\n"
+	"  \"big\": 9223372036854775807,\n"
+	"  \"double\": 1.5e3,\n"
+	"  \"true\": true,\n"
+	"  \"false\": false,\n"
+	"  \"null\": null,\n"
+	"  \"empty\": {},\n"
+	"  \"obj\": {\"nested\": {\"val\": 0.25}},\n"
+	"  \"array\": [{\"i\": 0}, 1, \"skipped\", [2], {\"i\": 1}]\n"
+	"}";
+
+static void parse_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create_from_json(test_json);
+	assert_non_null(data);
+
+	assert_string_equal(obs_data_get_string(data, "string"),
+			    "a \"quoted\" \xc3\xa9\xf0\x9f\x98\x80 \xc3\xa9");
+	assert_int_equal(obs_data_get_int(data, "int"), -42);
+	assert_true(obs_data_get_int(data, "big") == 9223372036854775807LL);
+	assert_true(obs_data_get_double(data, "double") == 1500.0);
+	assert_true(obs_data_get_bool(data, "true"));
+	assert_false(obs_data_get_bool(data, "false"));
+	assert_false(obs_data_has_user_value(data, "null"));
+
+	obs_data_t *obj = obs_data_get_obj(data, "obj");
+	obs_data_t *nested = obs_data_get_obj(obj, "nested");
+	assert_true(obs_data_get_double(nested, "val") == 0.25);
+	obs_data_release(nested);
+	obs_data_release(obj);
+
+	/* non-object array elements are skipped */
+	obs_data_array_t *array = obs_data_get_array(data, "array");
+	assert_int_equal(obs_data_array_count(array), 2);
+	for (size_t i = 0; i < 2; i++) {
+		obs_data_t *item = obs_data_array_item(array, i);
+		assert_int_equal(obs_data_get_int(item, "i"), i);
+		obs_data_release(item);
+	}
+	obs_data_array_release(array);
+
+	/* round trip */
+	obs_data_t *copy = obs_data_create_from_json(obs_data_get_json(data));
+	assert_non_null(copy);
+	assert_string_equal(obs_data_get_json(copy), obs_data_get_json(data));
+	obs_data_release(copy);
+
+	obs_data_release(data);
+}
+
+static void modify_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create_from_json(test_json);
+	obs_data_t *obj = obs_data_get_obj(data, "obj");
+
+	/* parsed items have to stay valid when they're changed, and when
+	 * they outlive the object they were parsed with */
+	obs_data_set_default_int(data, "int", 7);
+	obs_data_set_default_string(data, "string", "default");
+	obs_data_set_string(data, "string",
+			    "a string that is a lot longer than the one it "
+			    "replaces, so that the item has to grow");
+	obs_data_set_int(data, "added", 1);
+	obs_data_erase(data, "double");
+
+	assert_int_equal(obs_data_get_int(data, "int"), -42);
+	assert_int_equal(obs_data_get_default_int(data, "int"), 7);
+	assert_string_equal(obs_data_get_default_string(data, "string"),
+			    "default");
+	assert_int_equal(obs_data_get_int(data, "added"), 1);
+	assert_false(obs_data_has_user_value(data, "double"));
+
+	obs_data_release(data);
+
+	obs_data_t *nested = obs_data_get_obj(obj, "nested");
+	assert_true(obs_data_get_double(nested, "val") == 0.25);
+	obs_data_set_double(nested, "val", 0.5);
+	assert_true(obs_data_get_double(nested, "val") == 0.5);
+	obs_data_release(nested);
+	obs_data_release(obj);
+}
+
+static void error_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	static const char *invalid[] = {
+		"",
+		"{",
+		"{\"a\": 1,}",
+		"{\"a\": 1} x",
+		"{\"a\": 1, \"a\": 2}",
+		"{\"a\": 01}",
+		"{\"a\": 1.}",
+		"{\"a\": tru}",
+		"{\"a\": \"\\x\"}",
+		"{\"a\": \"\\ud800\"}",
+		"{\"a\": \"\\u0000\"}",
+		"{\"a\": \"\xc0\xaf\"}",
+		"{\"a\": \"line\nbreak\"}",
+		"{\"a\": 99999999999999999999}",
+		"{\"a\": 1e999}",
+		"{\"a\": [{\"b\": 1}, ]}",
+	};
+
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+		assert_null(obs_data_create_from_json(invalid[i]));
+
+	/* a root array is valid json, but has nothing to put in the object */
+	obs_data_t *data = obs_data_create_from_json(" [1, {\"a\": 2}] ");
+	assert_non_null(data);
+	assert_null(obs_data_first(data));
+	obs_data_release(data);
+}
+
+static const char *sources_json =
+	"{\"sources\": [{\"i\": 0, \"last\": 0},"
+	"{\"i\": 1, \"nested\": {\"items\": [{}]}, \"last\": 2},"
+	"{\"i\": 2, \"last\": 4}],"
+	"\"other\": {\"items\": [{\"i\": 5}]}}";
+
+struct callback_data {
+	int count;
+};
+
+static void object_cb(void *param, const char *array_name, obs_data_t *obj)
+{
+	struct callback_data *cd = param;
+
+	assert_string_equal(array_name, "sources");
+
+	/* objects are reported in order, once they're complete */
+	assert_int_equal(obs_data_get_int(obj, "i"), cd->count);
+	assert_int_equal(obs_data_get_int(obj, "last"), cd->count * 2);
+	cd->count++;
+}
+
+static void callback_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct callback_data cd = {0};
+	obs_data_t *data;
+
+	assert_true(os_quick_write_utf8_file(TEST_FILE, sources_json,
+					     strlen(sources_json), false));
+
+	data = obs_data_create_from_json_file_cb(TEST_FILE, object_cb, &cd);
+	assert_non_null(data);
+	assert_int_equal(cd.count, 3);
+	obs_data_release(data);
+
+	os_unlink(TEST_FILE);
+}
+
+static void binary_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create_from_json(test_json);
+	obs_data_t *loaded;
+
+	obs_data_set_default_int(data, "default", 5);
+	assert_true(obs_data_save_binary_safe(data, TEST_BINARY_FILE, "tmp",
+					      NULL));
+
+	loaded = obs_data_create_from_binary_file(TEST_BINARY_FILE);
+	assert_non_null(loaded);
+	assert_string_equal(obs_data_get_json(loaded), obs_data_get_json(data));
+
+	/* only user values are saved */
+	assert_false(obs_data_has_default_value(loaded, "default"));
+	assert_true(obs_data_get_int(loaded, "big") == 9223372036854775807LL);
+
+	obs_data_release(loaded);
+	obs_data_release(data);
+	os_unlink(TEST_BINARY_FILE);
+}
+
+static void lazy_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = obs_data_create_from_json(test_json);
+	assert_true(obs_data_save_binary_safe(data, TEST_BINARY_FILE, "tmp",
+					      NULL));
+	obs_data_release(data);
+
+	data = obs_data_create_from_binary_file(TEST_BINARY_FILE);
+	obs_data_t *obj = obs_data_get_obj(data, "obj");
+	obs_data_array_t *array = obs_data_get_array(data, "array");
+
+	/* unread objects keep the file alive after their parent is gone, and
+	 * after the file has been replaced */
+	obs_data_release(data);
+	data = obs_data_create();
+	assert_true(obs_data_save_binary_safe(data, TEST_BINARY_FILE, "tmp",
+					      NULL));
+	obs_data_release(data);
+
+	obs_data_t *nested = obs_data_get_obj(obj, "nested");
+	assert_true(obs_data_get_double(nested, "val") == 0.25);
+	obs_data_set_default_double(nested, "val", 1.0);
+	assert_true(obs_data_get_default_double(nested, "val") == 1.0);
+	obs_data_release(nested);
+	obs_data_release(obj);
+
+	assert_int_equal(obs_data_array_count(array), 2);
+	obs_data_t *item = obs_data_array_item(array, 1);
+	assert_int_equal(obs_data_get_int(item, "i"), 1);
+	obs_data_release(item);
+	obs_data_array_release(array);
+
+	os_unlink(TEST_BINARY_FILE);
+}
+
+static obs_data_t *create_collection(size_t count)
+{
+	obs_data_t *data = obs_data_create();
+	obs_data_array_t *sources = obs_data_array_create();
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *source = obs_data_create();
+		obs_data_t *settings = obs_data_create();
+
+		obs_data_set_string(source, "id", "image_source");
+		obs_data_set_int(source, "index", i);
+		obs_data_set_double(source, "volume", 1.0);
+		obs_data_set_bool(source, "enabled", true);
+		obs_data_set_string(settings, "file",
+				    "/home/user/pictures/overlay.png");
+		obs_data_set_bool(settings, "unload", false);
+		obs_data_set_obj(source, "settings", settings);
+		obs_data_array_push_back(sources, source);
+
+		obs_data_release(settings);
+		obs_data_release(source);
+	}
+
+	obs_data_set_array(data, "sources", sources);
+	obs_data_set_string(data, "name", "Untitled");
+	obs_data_array_release(sources);
+	return data;
+}
+
+static void check_binary_file(obs_data_t *data)
+{
+	obs_data_t *loaded = obs_data_create_from_binary_file(TEST_BINARY_FILE);
+	assert_non_null(loaded);
+	assert_string_equal(obs_data_get_json(loaded), obs_data_get_json(data));
+	obs_data_release(loaded);
+}
+
+static void writer_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = create_collection(100);
+	obs_data_writer_t *writer = obs_data_writer_create(TEST_BINARY_FILE);
+	int64_t full_size, size;
+
+	assert_true(obs_data_writer_save(writer, data));
+	full_size = os_get_file_size(TEST_BINARY_FILE);
+	check_binary_file(data);
+
+	/* saving unchanged data doesn't write anything */
+	assert_true(obs_data_writer_save(writer, data));
+	assert_int_equal(os_get_file_size(TEST_BINARY_FILE), full_size);
+
+	/* changing one source only appends that source */
+	obs_data_array_t *sources = obs_data_get_array(data, "sources");
+	obs_data_t *source = obs_data_array_item(sources, 42);
+	obs_data_set_double(source, "volume", 0.5);
+	obs_data_release(source);
+
+	assert_true(obs_data_writer_save(writer, data));
+	size = os_get_file_size(TEST_BINARY_FILE);
+	assert_true(size > full_size);
+	assert_true(size - full_size < full_size / 20);
+	check_binary_file(data);
+
+	/* removed, added and resized items */
+	obs_data_array_erase(sources, 99);
+	obs_data_array_erase(sources, 98);
+	obs_data_erase(data, "name");
+	obs_data_set_int(data, "version", 2);
+	obs_data_array_release(sources);
+
+	assert_true(obs_data_writer_save(writer, data));
+	check_binary_file(data);
+
+	/* arrays and values that change type */
+	obs_data_set_string(data, "sources", "none");
+	obs_data_array_t *array = obs_data_array_create();
+	obs_data_set_array(data, "version", array);
+	obs_data_array_release(array);
+
+	assert_true(obs_data_writer_save(writer, data));
+	check_binary_file(data);
+
+	obs_data_writer_destroy(writer);
+	obs_data_release(data);
+	os_unlink(TEST_BINARY_FILE);
+}
+
+static void *read_file(const char *file, size_t *size)
+{
+	FILE *f = os_fopen(file, "rb");
+	void *buf;
+
+	*size = (size_t)os_fgetsize(f);
+	buf = bmalloc(*size);
+	assert_int_equal(fread(buf, 1, *size, f), *size);
+	fclose(f);
+	return buf;
+}
+
+static void write_file(const char *file, const void *buf, size_t size)
+{
+	FILE *f = os_fopen(file, "wb");
+	assert_int_equal(fwrite(buf, 1, size, f), size);
+	fclose(f);
+}
+
+static void corrupt_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	obs_data_t *data = create_collection(10);
+	obs_data_writer_t *writer = obs_data_writer_create(TEST_BINARY_FILE);
+	obs_data_t *loaded;
+	uint8_t *buf;
+	size_t full_size, size;
+
+	assert_true(obs_data_writer_save(writer, data));
+	full_size = (size_t)os_get_file_size(TEST_BINARY_FILE);
+	obs_data_set_string(data, "name", "changed");
+	assert_true(obs_data_writer_save(writer, data));
+	obs_data_writer_destroy(writer);
+
+	buf = read_file(TEST_BINARY_FILE, &size);
+	assert_true(size > full_size);
+
+	/* a record cut short while being appended is ignored */
+	write_file(TEST_BINARY_FILE, buf, size - 3);
+	loaded = obs_data_create_from_binary_file(TEST_BINARY_FILE);
+	assert_non_null(loaded);
+	assert_string_equal(obs_data_get_string(loaded, "name"), "Untitled");
+	obs_data_release(loaded);
+
+	/* as is a record that doesn't make sense */
+	buf[full_size] = 0x7f;
+	write_file(TEST_BINARY_FILE, buf, size);
+	loaded = obs_data_create_from_binary_file(TEST_BINARY_FILE);
+	assert_non_null(loaded);
+	assert_string_equal(obs_data_get_string(loaded, "name"), "Untitled");
+	obs_data_release(loaded);
+
+	/* broken full records and headers fail to load */
+	write_file(TEST_BINARY_FILE, buf, full_size - 1);
+	assert_null(obs_data_create_from_binary_file(TEST_BINARY_FILE));
+
+	for (size_t i = 12; i < full_size; i += 7) {
+		uint8_t val = buf[i];
+		buf[i] = 0xff;
+		write_file(TEST_BINARY_FILE, buf, full_size);
+		obs_data_release(
+			obs_data_create_from_binary_file(TEST_BINARY_FILE));
+		buf[i] = val;
+	}
+
+	buf[0] = 'X';
+	write_file(TEST_BINARY_FILE, buf, full_size);
+	assert_null(obs_data_create_from_binary_file(TEST_BINARY_FILE));
+
+	bfree(buf);
+	obs_data_release(data);
+	os_unlink(TEST_BINARY_FILE);
+}
+
+/* ------------------------------------------------------------------------- */
+/* benchmark against JSON */
+
+/* reads every value, like loading a scene collection does */
+static void read_all(obs_data_t *data)
+{
+	obs_data_item_t *item = obs_data_first(data);
+
+	for (; item; obs_data_item_next(&item)) {
+		enum obs_data_type type = obs_data_item_gettype(item);
+
+		if (type == OBS_DATA_OBJECT) {
+			obs_data_t *obj = obs_data_item_get_obj(item);
+			read_all(obj);
+			obs_data_release(obj);
+
+		} else if (type == OBS_DATA_ARRAY) {
+			obs_data_array_t *array = obs_data_item_get_array(item);
+			size_t count = obs_data_array_count(array);
+
+			for (size_t i = 0; i < count; i++) {
+				obs_data_t *obj = obs_data_array_item(array, i);
+				read_all(obj);
+				obs_data_release(obj);
+			}
+			obs_data_array_release(array);
+		}
+	}
+}
+
+static void snapshot_benchmark(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	static const size_t counts[] = {100, 1000, 10000};
+
+	printf("sources  json save ms  json load ms  binary save ms  "
+	       "binary load ms  (lazy ms)\n");
+
+	for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); i++) {
+		obs_data_t *data = create_collection(counts[i]);
+		uint64_t json_save, json_load, bin_save, bin_load, lazy;
+		uint64_t start = os_gettime_ns();
+		obs_data_t *loaded;
+
+		obs_data_save_json_safe(data, TEST_FILE, "tmp", NULL);
+		json_save = os_gettime_ns() - start;
+
+		start = os_gettime_ns();
+		loaded = obs_data_create_from_json_file(TEST_FILE);
+		read_all(loaded);
+		json_load = os_gettime_ns() - start;
+		obs_data_release(loaded);
+
+		start = os_gettime_ns();
+		obs_data_save_binary_safe(data, TEST_BINARY_FILE, "tmp", NULL);
+		bin_save = os_gettime_ns() - start;
+
+		start = os_gettime_ns();
+		loaded = obs_data_create_from_binary_file(TEST_BINARY_FILE);
+		lazy = os_gettime_ns() - start;
+		read_all(loaded);
+		bin_load = os_gettime_ns() - start;
+		obs_data_release(loaded);
+
+		printf("%7zu  %12.2f  %12.2f  %14.2f  %14.2f  %9.2f\n",
+		       counts[i], (double)json_save / 1000000.0,
+		       (double)json_load / 1000000.0,
+		       (double)bin_save / 1000000.0,
+		       (double)bin_load / 1000000.0, (double)lazy / 1000000.0);
+
+		obs_data_release(data);
+	}
+
+	os_unlink(TEST_FILE);
+	os_unlink(TEST_BINARY_FILE);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(parse_test),
+		cmocka_unit_test(modify_test),
+		cmocka_unit_test(error_test),
+		cmocka_unit_test(callback_test),
+		cmocka_unit_test(binary_test),
+		cmocka_unit_test(lazy_test),
+		cmocka_unit_test(writer_test),
+		cmocka_unit_test(corrupt_test),
+		cmocka_unit_test(snapshot_benchmark),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,417 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <math.h>
+#include <string.h>
+
+#include <media-io/audio-io.h>
+#include <media-io/audio-resampler.h>
+#include <media-io/video-io.h>
+#include <media-io/video-convert.h>
+#include <media-io/video-frame.h>
+#include <media-io/video-scaler.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include <util/platform.h>
+
+#define NUM_INPUTS 3
+#define WAIT_TIMEOUT_MS 5000
+
+/* inputs 0 and 1 ask for the same conversion, input 2 for a different one */
+static inline size_t input_conversion(size_t input)
+{
+	return input < 2 ? 0 : 1;
+}
+
+/* ------------------------------------------------------------------------- */
+
+#define AUDIO_TICKS 16
+
+static const struct audio_convert_info audio_conversions[2] = {
+	{.samples_per_sec = 44100,
+	 .format = AUDIO_FORMAT_FLOAT_PLANAR,
+	 .speakers = SPEAKERS_STEREO},
+	{.samples_per_sec = 22050,
+	 .format = AUDIO_FORMAT_FLOAT_PLANAR,
+	 .speakers = SPEAKERS_STEREO},
+};
+
+struct audio_capture {
+	DARRAY(float) samples;
+	long callbacks;
+};
+
+struct audio_test {
+	/* what each conversion gives with a resampler of its own, which is
+	 * what every input got before conversions were shared */
+	audio_resampler_t *reference[2];
+	DARRAY(float) expected[2];
+
+	struct audio_capture inputs[NUM_INPUTS];
+	uint64_t frames;
+
+	volatile bool ready;
+	volatile bool done;
+	volatile bool idle;
+	volatile long ticks;
+};
+
+static bool audio_input(void *param, uint64_t start_ts, uint64_t end_ts,
+			uint64_t *new_ts, uint32_t active_mixers,
+			struct audio_output_data *mixes)
+{
+	struct audio_test *t = param;
+
+	UNUSED_PARAMETER(end_ts);
+	UNUSED_PARAMETER(active_mixers);
+
+	if (!os_atomic_load_bool(&t->ready))
+		return false;
+	if (os_atomic_load_bool(&t->done)) {
+		os_atomic_set_bool(&t->idle, true);
+		return false;
+	}
+
+	for (size_t ch = 0; ch < 2; ch++) {
+		for (size_t i = 0; i < AUDIO_OUTPUT_FRAMES; i++) {
+			float pos = (float)(t->frames + i);
+			mixes[0].data[ch][i] =
+				0.5f * sinf(pos * 0.01f * (float)(ch + 1));
+		}
+	}
+	t->frames += AUDIO_OUTPUT_FRAMES;
+
+	for (size_t i = 0; i < 2; i++) {
+		const uint8_t *in[2] = {(uint8_t *)mixes[0].data[0],
+					(uint8_t *)mixes[0].data[1]};
+		uint8_t *out[MAX_AV_PLANES] = {0};
+		uint32_t frames = 0;
+		uint64_t offset;
+
+		if (audio_resampler_resample(t->reference[i], out, &frames,
+					     &offset, in, AUDIO_OUTPUT_FRAMES))
+			da_push_back_array(t->expected[i], (float *)out[0],
+					   frames);
+	}
+
+	*new_ts = start_ts;
+	os_atomic_inc_long(&t->ticks);
+	return true;
+}
+
+static void audio_output(void *param, size_t mix_idx, struct audio_data *data)
+{
+	struct audio_capture *capture = param;
+
+	UNUSED_PARAMETER(mix_idx);
+
+	da_push_back_array(capture->samples, (float *)data->data[0],
+			   data->frames);
+	capture->callbacks++;
+}
+
+static bool wait_for(volatile bool *flag)
+{
+	for (int ms = 0; ms < WAIT_TIMEOUT_MS; ms += 5) {
+		if (os_atomic_load_bool(flag))
+			return true;
+		os_sleep_ms(5);
+	}
+	return false;
+}
+
+static void audio_sharing_test(void **state)
+{
+	struct audio_test t = {0};
+	struct audio_output_info info = {
+		.name = "test",
+		.samples_per_sec = 48000,
+		.format = AUDIO_FORMAT_FLOAT_PLANAR,
+		.speakers = SPEAKERS_STEREO,
+		.input_callback = audio_input,
+		.input_param = &t,
+	};
+	struct resample_info from = {
+		.samples_per_sec = 48000,
+		.format = AUDIO_FORMAT_FLOAT_PLANAR,
+		.speakers = SPEAKERS_STEREO,
+	};
+	struct audio_output_stats stats;
+	audio_t *audio;
+	long ticks;
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t i = 0; i < 2; i++) {
+		struct resample_info to = {
+			.samples_per_sec = audio_conversions[i].samples_per_sec,
+			.format = audio_conversions[i].format,
+			.speakers = audio_conversions[i].speakers,
+		};
+		t.reference[i] = audio_resampler_create(&to, &from);
+		assert_non_null(t.reference[i]);
+	}
+
+	assert_int_equal(audio_output_open(&audio, &info),
+			 AUDIO_OUTPUT_SUCCESS);
+
+	for (size_t i = 0; i < NUM_INPUTS; i++)
+		assert_true(audio_output_connect(
+			audio, 0, &audio_conversions[input_conversion(i)],
+			audio_output, &t.inputs[i]));
+
+	audio_output_get_stats(audio, &stats);
+	assert_int_equal(stats.resamplers, 2);
+
+	/* nothing is mixed until every input is connected, so they all see
+	 * the same ticks as the reference resamplers */
+	os_atomic_set_bool(&t.ready, true);
+	for (int ms = 0; ms < WAIT_TIMEOUT_MS; ms += 5) {
+		if (os_atomic_load_long(&t.ticks) >= AUDIO_TICKS)
+			break;
+		os_sleep_ms(5);
+	}
+	os_atomic_set_bool(&t.done, true);
+	assert_true(wait_for(&t.idle));
+
+	ticks = os_atomic_load_long(&t.ticks);
+	assert_true(ticks >= AUDIO_TICKS);
+
+	/* one resampler run per conversion and tick, the second input with
+	 * the same conversion reuses the first one's */
+	audio_output_get_stats(audio, &stats);
+	assert_int_equal(stats.resamples, 2 * (uint64_t)ticks);
+	assert_int_equal(stats.shared_resamples, (uint64_t)ticks);
+
+	for (size_t i = 0; i < NUM_INPUTS; i++) {
+		struct audio_capture *capture = &t.inputs[i];
+		size_t conv = input_conversion(i);
+
+		assert_int_equal(capture->callbacks, ticks);
+		assert_int_equal(capture->samples.num, t.expected[conv].num);
+		assert_memory_equal(capture->samples.array,
+				    t.expected[conv].array,
+				    capture->samples.num * sizeof(float));
+	}
+
+	/* the shared resampler lives until its last input is gone */
+	audio_output_disconnect(audio, 0, audio_output, &t.inputs[0]);
+	audio_output_get_stats(audio, &stats);
+	assert_int_equal(stats.resamplers, 2);
+
+	audio_output_disconnect(audio, 0, audio_output, &t.inputs[1]);
+	audio_output_get_stats(audio, &stats);
+	assert_int_equal(stats.resamplers, 1);
+
+	audio_output_disconnect(audio, 0, audio_output, &t.inputs[2]);
+	audio_output_get_stats(audio, &stats);
+	assert_int_equal(stats.resamplers, 0);
+
+	audio_output_close(audio);
+
+	for (size_t i = 0; i < 2; i++) {
+		audio_resampler_destroy(t.reference[i]);
+		da_free(t.expected[i]);
+	}
+	for (size_t i = 0; i < NUM_INPUTS; i++)
+		da_free(t.inputs[i].samples);
+}
+
+/* ------------------------------------------------------------------------- */
+
+#define VIDEO_FRAMES 8
+#define VIDEO_WIDTH 640
+#define VIDEO_HEIGHT 360
+
+/* the first is a plain layout change, the second needs the scaler */
+static const struct video_scale_info video_conversions[2] = {
+	{.format = VIDEO_FORMAT_I420,
+	 .width = VIDEO_WIDTH,
+	 .height = VIDEO_HEIGHT,
+	 .range = VIDEO_RANGE_PARTIAL,
+	 .colorspace = VIDEO_CS_709},
+	{.format = VIDEO_FORMAT_I420,
+	 .width = VIDEO_WIDTH / 2,
+	 .height = VIDEO_HEIGHT / 2,
+	 .range = VIDEO_RANGE_PARTIAL,
+	 .colorspace = VIDEO_CS_709},
+};
+
+struct video_capture {
+	struct video_frame frame;
+	uint32_t height;
+	volatile long frames;
+};
+
+static void video_output(void *param, struct video_data *data)
+{
+	struct video_capture *capture = param;
+	struct video_frame src;
+
+	memcpy(src.data, data->data, sizeof(src.data));
+	memcpy(src.linesize, data->linesize, sizeof(src.linesize));
+
+	video_frame_copy(&capture->frame, &src, VIDEO_FORMAT_I420,
+			 capture->height);
+	os_atomic_inc_long(&capture->frames);
+}
+
+static void fill_nv12(struct video_frame *frame, int seq)
+{
+	for (uint32_t y = 0; y < VIDEO_HEIGHT; y++) {
+		uint8_t *row = frame->data[0] + y * frame->linesize[0];
+		for (uint32_t x = 0; x < VIDEO_WIDTH; x++)
+			row[x] = (uint8_t)(16 + (x + y * 3 + seq * 7) % 220);
+	}
+
+	for (uint32_t y = 0; y < VIDEO_HEIGHT / 2; y++) {
+		uint8_t *row = frame->data[1] + y * frame->linesize[1];
+		for (uint32_t x = 0; x < VIDEO_WIDTH; x++)
+			row[x] = (uint8_t)(16 + (x * 5 + y + seq) % 224);
+	}
+}
+
+static void assert_frames_equal(const struct video_frame *a,
+				const struct video_frame *b, uint32_t height)
+{
+	assert_memory_equal(a->data[0], b->data[0], a->linesize[0] * height);
+	assert_memory_equal(a->data[1], b->data[1],
+			    a->linesize[1] * (height / 2));
+	assert_memory_equal(a->data[2], b->data[2],
+			    a->linesize[2] * (height / 2));
+}
+
+static bool wait_for_frames(struct video_capture *inputs, long frames)
+{
+	for (int ms = 0; ms < WAIT_TIMEOUT_MS; ms++) {
+		bool all = true;
+
+		for (size_t i = 0; i < NUM_INPUTS; i++)
+			all = all &&
+			      os_atomic_load_long(&inputs[i].frames) == frames;
+		if (all)
+			return true;
+
+		os_sleep_ms(1);
+	}
+	return false;
+}
+
+static void video_sharing_test(void **state)
+{
+	struct video_output_info info = {
+		.name = "test",
+		.format = VIDEO_FORMAT_NV12,
+		.fps_num = 30,
+		.fps_den = 1,
+		.width = VIDEO_WIDTH,
+		.height = VIDEO_HEIGHT,
+		.cache_size = 4,
+		.colorspace = VIDEO_CS_709,
+		.range = VIDEO_RANGE_PARTIAL,
+	};
+	struct video_scale_info from = {
+		.format = VIDEO_FORMAT_NV12,
+		.width = VIDEO_WIDTH,
+		.height = VIDEO_HEIGHT,
+		.range = VIDEO_RANGE_PARTIAL,
+		.colorspace = VIDEO_CS_709,
+	};
+	struct video_capture inputs[NUM_INPUTS] = {0};
+	struct video_frame source, expected[2];
+	struct video_output_stats stats;
+	video_scaler_t *scaler;
+	video_t *video;
+
+	UNUSED_PARAMETER(state);
+
+	/* the unshared path: each input converted the frame on its own */
+	assert_int_equal(video_scaler_create(&scaler, &video_conversions[1],
+					     &from, VIDEO_SCALE_FAST_BILINEAR),
+			 VIDEO_SCALER_SUCCESS);
+	video_frame_init(&source, VIDEO_FORMAT_NV12, VIDEO_WIDTH,
+			 VIDEO_HEIGHT);
+	for (size_t i = 0; i < 2; i++)
+		video_frame_init(&expected[i], VIDEO_FORMAT_I420,
+				 video_conversions[i].width,
+				 video_conversions[i].height);
+
+	assert_int_equal(video_output_open(&video, &info),
+			 VIDEO_OUTPUT_SUCCESS);
+
+	for (size_t i = 0; i < NUM_INPUTS; i++) {
+		const struct video_scale_info *conv =
+			&video_conversions[input_conversion(i)];
+
+		video_frame_init(&inputs[i].frame, conv->format, conv->width,
+				 conv->height);
+		inputs[i].height = conv->height;
+		assert_true(video_output_connect(video, conv, video_output,
+						 &inputs[i]));
+	}
+
+	video_output_get_stats(video, &stats);
+	assert_int_equal(stats.converters, 2);
+
+	for (int seq = 0; seq < VIDEO_FRAMES; seq++) {
+		struct video_frame frame;
+
+		assert_true(video_output_lock_frame(video, &frame, 1,
+						    (uint64_t)seq * 33333333));
+		fill_nv12(&frame, seq);
+		video_frame_copy(&source, &frame, VIDEO_FORMAT_NV12,
+				 VIDEO_HEIGHT);
+		video_output_unlock_frame(video);
+
+		assert_true(wait_for_frames(inputs, seq + 1));
+
+		assert_true(video_convert(VIDEO_FORMAT_NV12, VIDEO_FORMAT_I420,
+					  VIDEO_WIDTH, VIDEO_HEIGHT,
+					  (const uint8_t *const *)source.data,
+					  source.linesize, expected[0].data,
+					  expected[0].linesize));
+		assert_true(video_scaler_scale(
+			scaler, expected[1].data, expected[1].linesize,
+			(const uint8_t *const *)source.data, source.linesize));
+
+		for (size_t i = 0; i < NUM_INPUTS; i++) {
+			size_t conv = input_conversion(i);
+			assert_frames_equal(&inputs[i].frame, &expected[conv],
+					    video_conversions[conv].height);
+		}
+	}
+
+	/* one conversion per output frame and conversion, the second input
+	 * with the same conversion reuses the first one's */
+	video_output_get_stats(video, &stats);
+	assert_int_equal(stats.conversions, 2 * VIDEO_FRAMES);
+	assert_int_equal(stats.shared_conversions, VIDEO_FRAMES);
+
+	video_output_disconnect(video, video_output, &inputs[0]);
+	video_output_get_stats(video, &stats);
+	assert_int_equal(stats.converters, 2);
+
+	video_output_disconnect(video, video_output, &inputs[1]);
+	video_output_get_stats(video, &stats);
+	assert_int_equal(stats.converters, 1);
+
+	video_output_close(video);
+
+	for (size_t i = 0; i < NUM_INPUTS; i++)
+		video_frame_free(&inputs[i].frame);
+	for (size_t i = 0; i < 2; i++)
+		video_frame_free(&expected[i]);
+	video_frame_free(&source);
+	video_scaler_destroy(scaler);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(audio_sharing_test),
+		cmocka_unit_test(video_sharing_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,264 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/pacer.h>
+#include <util/platform.h>
+#include <util/threading.h>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#define RATE (1000 * 1000) /* 8 mbps */
+#define BURST (32 * 1024)
+#define CHUNK 4096
+#define KEYFRAME_SIZE (400 * 1024)
+#define NUM_CHUNKS (KEYFRAME_SIZE / CHUNK)
+
+/* maximum number of bytes that may leave within `dur` nanoseconds */
+static uint64_t max_bytes(uint64_t dur)
+{
+	return BURST + CHUNK + dur * RATE / 1000000000ULL;
+}
+
+static void check_bursts(const uint64_t *ts, size_t count)
+{
+	for (size_t i = 0; i < count; i++) {
+		uint64_t bytes = 0;
+
+		for (size_t j = i; j < count; j++) {
+			bytes += CHUNK;
+			assert_true(bytes <= max_bytes(ts[j] - ts[i]));
+		}
+	}
+}
+
+static void pacer_burst_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct pacer pacer;
+	uint64_t ts[NUM_CHUNKS];
+	uint64_t now = 1000000000ULL;
+
+	pacer_init(&pacer, RATE, BURST);
+
+	/* a keyframe handed to the socket all at once */
+	for (size_t i = 0; i < NUM_CHUNKS; i++) {
+		ts[i] = pacer_reserve(&pacer, CHUNK, PACER_PRIORITY_NORMAL,
+				      now);
+		assert_true(ts[i] >= now);
+		if (i > 0)
+			assert_true(ts[i] >= ts[i - 1]);
+
+		/* the socket accepts the chunk as soon as it may be sent */
+		now = ts[i];
+	}
+
+	check_bursts(ts, NUM_CHUNKS);
+
+	/* the first bucket worth of data goes out without waiting, the rest
+	 * at the configured rate */
+	assert_int_equal(ts[BURST / CHUNK - 1], 1000000000ULL);
+	assert_true(ts[NUM_CHUNKS - 1] - ts[0] >=
+		    (uint64_t)(KEYFRAME_SIZE - BURST - CHUNK) * 1000000000ULL /
+			    RATE);
+
+	assert_int_equal(pacer.stats.sends, NUM_CHUNKS);
+	assert_int_equal(pacer.stats.bytes, KEYFRAME_SIZE);
+	assert_int_equal(pacer.stats.delayed_sends,
+			 NUM_CHUNKS - BURST / CHUNK);
+	assert_true(pacer.stats.max_delay_ns > 0);
+
+	/* after an idle period the full bucket is available again */
+	now += 1000000000ULL;
+	assert_int_equal(pacer_reserve(&pacer, BURST, PACER_PRIORITY_NORMAL,
+				       now),
+			 now);
+}
+
+static void pacer_priority_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct pacer pacer;
+	uint64_t now = 0;
+	uint64_t ts;
+
+	pacer_init(&pacer, RATE, BURST);
+
+	/* fill the bucket */
+	pacer_reserve(&pacer, BURST, PACER_PRIORITY_NORMAL, now);
+
+	/* urgent data is not delayed even though the bucket is full */
+	ts = pacer_reserve(&pacer, 1000, PACER_PRIORITY_URGENT, now);
+	assert_int_equal(ts, now);
+
+	/* but it is charged, so normal data has to wait for it to drain */
+	ts = pacer_reserve(&pacer, 1000, PACER_PRIORITY_NORMAL, now);
+	assert_int_equal(ts, now + 2000 * 1000000000ULL / RATE);
+
+	/* oversized sends wait for the bucket to be empty */
+	pacer_init(&pacer, RATE, BURST);
+	pacer_reserve(&pacer, CHUNK, PACER_PRIORITY_NORMAL, now);
+	ts = pacer_reserve(&pacer, BURST * 2, PACER_PRIORITY_NORMAL, now);
+	assert_int_equal(ts, now + (uint64_t)CHUNK * 1000000000ULL / RATE);
+
+	/* disabled pacer never delays */
+	pacer_init(&pacer, 0, 0);
+	assert_false(pacer_enabled(&pacer));
+	for (int i = 0; i < 100; i++)
+		assert_int_equal(pacer_reserve(&pacer, KEYFRAME_SIZE,
+					       PACER_PRIORITY_NORMAL, now),
+				 now);
+}
+
+/* loopback through the real clock: the sender can never get ahead of the
+ * configured rate, however fast it tries to send */
+static void pacer_wait_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	const size_t total = 128 * 1024;
+	struct pacer pacer;
+	uint64_t ts[128 * 1024 / CHUNK];
+	uint64_t start;
+
+	pacer_init(&pacer, RATE * 4, BURST);
+
+	start = os_gettime_ns();
+	for (size_t i = 0; i < total / CHUNK; i++) {
+		pacer_wait(&pacer, CHUNK, PACER_PRIORITY_NORMAL);
+		ts[i] = os_gettime_ns();
+	}
+
+	assert_true(ts[total / CHUNK - 1] - start >=
+		    (uint64_t)(total - BURST - CHUNK) * 1000000000ULL /
+			    (RATE * 4));
+
+	/* sleeping can overshoot, never undershoot, so the reserved times
+	 * are an upper bound for the amount of data sent by then */
+	for (size_t i = 0; i < total / CHUNK; i++) {
+		uint64_t allowed = BURST + CHUNK +
+				   (ts[i] - start) * (RATE * 4) / 1000000000ULL;
+		assert_true((i + 1) * CHUNK <= allowed);
+	}
+}
+
+#ifndef _WIN32
+#define LOOPBACK_TOTAL (256 * 1024)
+#define LOOPBACK_RATE (RATE * 4)
+
+struct loopback_sender {
+	int fd;
+	uint64_t start;
+};
+
+static void *loopback_send_thread(void *data)
+{
+	struct loopback_sender *sender = data;
+	uint8_t chunk[CHUNK] = {0};
+	struct pacer pacer;
+
+	pacer_init(&pacer, LOOPBACK_RATE, BURST);
+
+	for (size_t i = 0; i < LOOPBACK_TOTAL / CHUNK; i++) {
+		size_t sent = 0;
+
+		pacer_wait(&pacer, CHUNK, PACER_PRIORITY_NORMAL);
+		while (sent < CHUNK) {
+			ssize_t ret = send(sender->fd, chunk + sent,
+					   CHUNK - sent, 0);
+			if (ret <= 0)
+				return NULL;
+			sent += (size_t)ret;
+		}
+	}
+
+	return NULL;
+}
+
+/* paced through a real TCP connection on the loopback interface.  reading
+ * late can only make less data show up by a given time, so the amount
+ * received must stay within the bound measured from the start of sending. */
+static void pacer_loopback_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct loopback_sender sender = {0};
+	struct sockaddr_in addr = {0};
+	socklen_t addr_len = sizeof(addr);
+	uint8_t buf[CHUNK];
+	size_t received = 0;
+	pthread_t thread;
+	int listener;
+	int fd;
+
+	listener = socket(AF_INET, SOCK_STREAM, 0);
+	assert_true(listener >= 0);
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	assert_int_equal(bind(listener, (struct sockaddr *)&addr,
+			      sizeof(addr)),
+			 0);
+	assert_int_equal(getsockname(listener, (struct sockaddr *)&addr,
+				     &addr_len),
+			 0);
+	assert_int_equal(listen(listener, 1), 0);
+
+	sender.fd = socket(AF_INET, SOCK_STREAM, 0);
+	assert_int_equal(connect(sender.fd, (struct sockaddr *)&addr,
+				 sizeof(addr)),
+			 0);
+	fd = accept(listener, NULL, NULL);
+	assert_true(fd >= 0);
+
+	/* taken before the pacer starts, which only loosens the bound */
+	sender.start = os_gettime_ns();
+	assert_int_equal(pthread_create(&thread, NULL, loopback_send_thread,
+					&sender),
+			 0);
+
+	while (received < LOOPBACK_TOTAL) {
+		ssize_t ret = recv(fd, buf, sizeof(buf), 0);
+		uint64_t elapsed;
+
+		assert_true(ret > 0);
+		received += (size_t)ret;
+
+		elapsed = os_gettime_ns() - sender.start;
+		assert_true(received <=
+			    BURST + CHUNK +
+				    elapsed * LOOPBACK_RATE / 1000000000ULL);
+	}
+
+	pthread_join(thread, NULL);
+	assert_true(os_gettime_ns() - sender.start >=
+		    (uint64_t)(LOOPBACK_TOTAL - BURST - CHUNK) *
+			    1000000000ULL / LOOPBACK_RATE);
+
+	close(fd);
+	close(sender.fd);
+	close(listener);
+}
+#endif
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(pacer_burst_test),
+		cmocka_unit_test(pacer_priority_test),
+		cmocka_unit_test(pacer_wait_test),
+#ifndef _WIN32
+		cmocka_unit_test(pacer_loopback_test),
+#endif
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
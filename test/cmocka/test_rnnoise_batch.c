@@ -0,0 +1,155 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <math.h>
+#include <string.h>
+
+#include <rnnoise.h>
+#include <util/bmem.h>
+#include <util/c99defs.h>
+#include <util/platform.h>
+
+#define FRAME_SIZE 480
+#define NUM_STREAMS 16
+#define NUM_FRAMES 200
+
+static float test_signal(int stream, size_t n)
+{
+	/* voice-ish harmonics over a per-stream noise floor */
+	float t = (float)n / 48000.0f;
+	float voice = sinf(t * (700.0f + stream * 31.0f)) *
+		      (0.5f + 0.5f * sinf(t * 3.0f));
+	float noise = sinf((float)n * (1.7f + stream * 0.013f)) *
+		      sinf((float)n * 0.37f);
+
+	return 8000.0f * voice + 1500.0f * noise;
+}
+
+struct streams {
+	DenoiseState *states[NUM_STREAMS];
+	float *out[NUM_STREAMS];
+	float *in[NUM_STREAMS];
+	float vad[NUM_STREAMS];
+};
+
+static void streams_init(struct streams *s)
+{
+	for (int i = 0; i < NUM_STREAMS; i++) {
+		s->states[i] = rnnoise_create(NULL);
+		s->out[i] = bmalloc(FRAME_SIZE * sizeof(float));
+		s->in[i] = bmalloc(FRAME_SIZE * sizeof(float));
+	}
+}
+
+static void streams_free(struct streams *s)
+{
+	for (int i = 0; i < NUM_STREAMS; i++) {
+		rnnoise_destroy(s->states[i]);
+		bfree(s->out[i]);
+		bfree(s->in[i]);
+	}
+}
+
+static void fill_input(struct streams *s, int frame)
+{
+	for (int i = 0; i < NUM_STREAMS; i++)
+		for (size_t n = 0; n < FRAME_SIZE; n++)
+			s->in[i][n] = test_signal(
+				i, (size_t)frame * FRAME_SIZE + n);
+}
+
+static void bit_exact_test(void **state)
+{
+	struct streams single, batched;
+	int mismatches = 0;
+
+	UNUSED_PARAMETER(state);
+
+	streams_init(&single);
+	streams_init(&batched);
+
+	for (int f = 0; f < NUM_FRAMES; f++) {
+		fill_input(&single, f);
+		fill_input(&batched, f);
+
+		/* silence one stream now and then to exercise the skip */
+		if (f % 17 == 0)
+			memset(single.in[3], 0, FRAME_SIZE * sizeof(float));
+		if (f % 17 == 0)
+			memset(batched.in[3], 0, FRAME_SIZE * sizeof(float));
+
+		for (int i = 0; i < NUM_STREAMS; i++)
+			single.vad[i] = rnnoise_process_frame(
+				single.states[i], single.out[i], single.in[i]);
+
+		rnnoise_process_frames(batched.states, batched.out,
+				       (const float *const *)batched.in,
+				       batched.vad, NUM_STREAMS);
+
+		for (int i = 0; i < NUM_STREAMS; i++) {
+			if (memcmp(single.out[i], batched.out[i],
+				   FRAME_SIZE * sizeof(float)) != 0 ||
+			    single.vad[i] != batched.vad[i])
+				mismatches++;
+		}
+	}
+
+	assert_int_equal(mismatches, 0);
+
+	streams_free(&single);
+	streams_free(&batched);
+}
+
+static double frames_per_sec(struct streams *s, bool batch)
+{
+	uint64_t start = os_gettime_ns();
+	uint64_t elapsed;
+
+	for (int f = 0; f < NUM_FRAMES; f++) {
+		if (batch) {
+			rnnoise_process_frames(s->states, s->out,
+					       (const float *const *)s->in,
+					       s->vad, NUM_STREAMS);
+		} else {
+			for (int i = 0; i < NUM_STREAMS; i++)
+				rnnoise_process_frame(s->states[i], s->out[i],
+						      s->in[i]);
+		}
+	}
+
+	elapsed = os_gettime_ns() - start;
+	return (double)NUM_FRAMES * NUM_STREAMS * 1e9 / (double)elapsed;
+}
+
+static void benchmark_test(void **state)
+{
+	struct streams s;
+	double single, batched;
+
+	UNUSED_PARAMETER(state);
+
+	streams_init(&s);
+	fill_input(&s, 1);
+
+	single = frames_per_sec(&s, false);
+	batched = frames_per_sec(&s, true);
+
+	/* 100 frames per second is one realtime channel */
+	print_message("frames per second on one core, %d streams:\n",
+		      NUM_STREAMS);
+	print_message("  single %8.0f  batched %8.0f  (%.1fx, %.0f channels)\n",
+		      single, batched, batched / single, batched / 100.0);
+
+	streams_free(&s);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(bit_exact_test),
+		cmocka_unit_test(benchmark_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
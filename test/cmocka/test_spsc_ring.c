@@ -0,0 +1,139 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <string.h>
+
+#include <util/platform.h>
+#include <util/spsc-ring.h>
+#include <util/threading.h>
+
+static void basic_test(void **state)
+{
+	struct spsc_ring ring;
+	uint8_t in[100], out[100];
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t i = 0; i < sizeof(in); i++)
+		in[i] = (uint8_t)i;
+
+	/* sizes are rounded up to a power of two */
+	spsc_ring_init(&ring, 100);
+	assert_int_equal(ring.size, 128);
+	assert_int_equal(spsc_ring_readable(&ring), 0);
+	assert_int_equal(spsc_ring_writable(&ring), 128);
+
+	assert_true(spsc_ring_push(&ring, in, 100));
+	assert_int_equal(spsc_ring_readable(&ring), 100);
+
+	/* writes are all or nothing */
+	assert_false(spsc_ring_push(&ring, in, 29));
+	assert_int_equal(spsc_ring_readable(&ring), 100);
+
+	assert_true(spsc_ring_peek(&ring, out, 10));
+	assert_memory_equal(out, in, 10);
+	assert_true(spsc_ring_pop(&ring, out, 60));
+	assert_memory_equal(out, in, 60);
+
+	/* this one wraps around the end of the buffer */
+	assert_true(spsc_ring_push(&ring, in, 80));
+	assert_int_equal(spsc_ring_readable(&ring), 120);
+	assert_true(spsc_ring_pop(&ring, NULL, 40));
+	assert_true(spsc_ring_pop(&ring, out, 80));
+	assert_memory_equal(out, in, 80);
+
+	assert_false(spsc_ring_pop(&ring, out, 1));
+	assert_false(spsc_ring_peek(&ring, out, 1));
+
+	spsc_ring_free(&ring);
+}
+
+static void partial_write_test(void **state)
+{
+	struct spsc_ring ring;
+	uint32_t header = 0xdeadbeef, value;
+	uint8_t payload[50], out[50];
+
+	UNUSED_PARAMETER(state);
+
+	memset(payload, 0x5a, sizeof(payload));
+	spsc_ring_init(&ring, 64);
+
+	/* nothing is visible until the message is committed */
+	spsc_ring_write(&ring, 0, &header, sizeof(header));
+	spsc_ring_write(&ring, sizeof(header), payload, sizeof(payload));
+	assert_int_equal(spsc_ring_readable(&ring), 0);
+
+	spsc_ring_commit(&ring, sizeof(header) + sizeof(payload));
+	assert_true(spsc_ring_pop(&ring, &value, sizeof(value)));
+	assert_int_equal(value, header);
+	assert_true(spsc_ring_pop(&ring, out, sizeof(out)));
+	assert_memory_equal(out, payload, sizeof(payload));
+
+	spsc_ring_free(&ring);
+}
+
+#define MESSAGES 200000
+
+static void *producer_thread(void *param)
+{
+	struct spsc_ring *ring = param;
+	uint32_t msg[4];
+
+	for (uint32_t i = 0; i < MESSAGES;) {
+		const size_t size = sizeof(uint32_t) * (1 + i % 4);
+
+		for (size_t j = 0; j < 4; j++)
+			msg[j] = i * 4 + (uint32_t)j;
+
+		if (spsc_ring_push(ring, msg, size))
+			i++;
+		else
+			os_sleep_ms(0);
+	}
+
+	return NULL;
+}
+
+static void thread_test(void **state)
+{
+	struct spsc_ring ring;
+	pthread_t thread;
+	uint32_t msg[4];
+	bool ok = true;
+
+	UNUSED_PARAMETER(state);
+
+	spsc_ring_init(&ring, 256);
+	pthread_create(&thread, NULL, producer_thread, &ring);
+
+	/* messages arrive complete and in order */
+	for (uint32_t i = 0; i < MESSAGES;) {
+		const size_t size = sizeof(uint32_t) * (1 + i % 4);
+
+		if (!spsc_ring_pop(&ring, msg, size))
+			continue;
+
+		for (size_t j = 0; j < size / sizeof(uint32_t); j++)
+			ok = ok && msg[j] == i * 4 + (uint32_t)j;
+		i++;
+	}
+
+	pthread_join(thread, NULL);
+	assert_true(ok);
+	assert_int_equal(spsc_ring_readable(&ring), 0);
+
+	spsc_ring_free(&ring);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(basic_test),
+		cmocka_unit_test(partial_write_test),
+		cmocka_unit_test(thread_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
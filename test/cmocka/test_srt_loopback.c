@@ -0,0 +1,160 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#endif
+
+#include <obs-ffmpeg-srt.h>
+
+#define CHUNK_SIZE SRT_LIVE_DEFAULT_PAYLOAD_SIZE
+
+/* more than the send queue holds, so libsrt_write has to wait for the link */
+#define NUM_CHUNKS (SRT_MAX_QUEUE_SIZE / CHUNK_SIZE * 3 / 2)
+
+/* slower than the writer, in bytes per second */
+#define LINK_RATE 4000000
+
+struct receiver {
+	SRTSOCKET listener;
+	pthread_t thread;
+	uint32_t *seqs;
+	long received;
+	bool corrupt;
+};
+
+static void fill_chunk(uint8_t *chunk, uint32_t seq)
+{
+	memcpy(chunk, &seq, sizeof(seq));
+	for (size_t i = sizeof(seq); i < CHUNK_SIZE; i++)
+		chunk[i] = (uint8_t)(seq + i);
+}
+
+static void *receive_thread(void *data)
+{
+	struct receiver *r = data;
+	uint8_t buf[SRT_LIVE_MAX_PAYLOAD_SIZE];
+	uint8_t expected[CHUNK_SIZE];
+	SRTSOCKET fd;
+
+	fd = srt_accept(r->listener, NULL, NULL);
+	if (fd == SRT_INVALID_SOCK)
+		return NULL;
+
+	while (r->received < NUM_CHUNKS) {
+		int size = srt_recvmsg(fd, (char *)buf, sizeof(buf));
+		uint32_t seq;
+
+		if (size <= 0)
+			break;
+
+		memcpy(&seq, buf, sizeof(seq));
+		fill_chunk(expected, seq);
+
+		if (size != CHUNK_SIZE || memcmp(buf, expected, CHUNK_SIZE))
+			r->corrupt = true;
+
+		r->seqs[r->received++] = seq;
+	}
+
+	srt_close(fd);
+	return NULL;
+}
+
+static int start_receiver(struct receiver *r)
+{
+	struct sockaddr_in addr = {0};
+	int addr_len = sizeof(addr);
+	int no = 0;
+	int timeout_ms = 10000;
+
+	r->seqs = bzalloc(NUM_CHUNKS * sizeof(uint32_t));
+	r->listener = srt_create_socket();
+	assert_int_not_equal(r->listener, SRT_INVALID_SOCK);
+
+	/* nothing may be dropped for the comparison to work */
+	srt_setsockopt(r->listener, 0, SRTO_TLPKTDROP, &no, sizeof(no));
+	srt_setsockopt(r->listener, 0, SRTO_RCVTIMEO, &timeout_ms,
+		       sizeof(timeout_ms));
+
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	assert_int_equal(srt_bind(r->listener, (struct sockaddr *)&addr,
+				  sizeof(addr)),
+			 0);
+	assert_int_equal(srt_getsockname(r->listener, (struct sockaddr *)&addr,
+					 &addr_len),
+			 0);
+	assert_int_equal(srt_listen(r->listener, 1), 0);
+	assert_int_equal(pthread_create(&r->thread, NULL, receive_thread, r),
+			 0);
+
+	return ntohs(addr.sin_port);
+}
+
+static void srt_loopback_test(void **state)
+{
+	struct receiver r = {0};
+	uint8_t chunk[CHUNK_SIZE];
+	URLContext *h;
+	SRTContext *s;
+	struct dstr url = {0};
+	int port;
+
+	UNUSED_PARAMETER(state);
+
+	assert_true(srt_startup() >= 0);
+	port = start_receiver(&r);
+
+	dstr_printf(&url,
+		    "srt://127.0.0.1:%d?mode=caller&tlpktdrop=0&maxbw=%d",
+		    port, LINK_RATE);
+
+	h = av_mallocz(sizeof(URLContext));
+	h->url = url.array;
+	h->max_packet_size = SRT_LIVE_DEFAULT_PAYLOAD_SIZE;
+	h->priv_data = av_mallocz(sizeof(SRTContext));
+	s = h->priv_data;
+
+	assert_int_equal(libsrt_open(h, h->url), 0);
+
+	for (uint32_t seq = 0; seq < NUM_CHUNKS; seq++) {
+		fill_chunk(chunk, seq);
+		assert_int_equal(libsrt_write(h, chunk, CHUNK_SIZE),
+				 CHUNK_SIZE);
+
+		/* never more than one chunk over the limit */
+		pthread_mutex_lock(&s->send_mutex);
+		assert_true(s->send_queue.size <=
+			    SRT_MAX_QUEUE_SIZE + sizeof(int) + CHUNK_SIZE);
+		pthread_mutex_unlock(&s->send_mutex);
+	}
+
+	/* everything reaches the other end, in order and intact */
+	pthread_join(r.thread, NULL);
+	assert_int_equal(os_atomic_load_long(&s->send_error), 0);
+	assert_int_equal(r.received, NUM_CHUNKS);
+	assert_false(r.corrupt);
+	for (long i = 0; i < r.received; i++)
+		assert_int_equal(r.seqs[i], (uint32_t)i);
+
+	assert_int_equal(libsrt_close(h), 0);
+	av_freep(&h->priv_data);
+	av_freep(&h);
+
+	srt_close(r.listener);
+	srt_cleanup();
+	bfree(r.seqs);
+	dstr_free(&url);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(srt_loopback_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
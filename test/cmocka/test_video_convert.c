@@ -0,0 +1,482 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <media-io/video-convert.h>
+#include <media-io/video-frame.h>
+#include <media-io/video-scaler.h>
+#include <util/bmem.h>
+#include <util/platform.h>
+
+#define PADDING 40
+#define GUARD 0xCD
+
+struct planes {
+	size_t count;
+	uint32_t row_bytes[3];
+	uint32_t rows[3];
+	uint32_t linesize[3];
+	uint8_t *data[3];
+};
+
+static void describe(struct planes *p, enum video_format format,
+		     uint32_t width, uint32_t height)
+{
+	const uint32_t cx = (width + 1) / 2;
+	const uint32_t cy = (height + 1) / 2;
+
+	memset(p, 0, sizeof(*p));
+
+#define PLANE(bytes, lines)                     \
+	do {                                    \
+		p->row_bytes[p->count] = bytes; \
+		p->rows[p->count] = lines;      \
+		p->count++;                     \
+	} while (false)
+
+	switch (format) {
+	case VIDEO_FORMAT_NV12:
+		PLANE(width, height);
+		PLANE(cx * 2, cy);
+		break;
+	case VIDEO_FORMAT_I420:
+		PLANE(width, height);
+		PLANE(cx, cy);
+		PLANE(cx, cy);
+		break;
+	case VIDEO_FORMAT_P010:
+		PLANE(width * 2, height);
+		PLANE(cx * 4, cy);
+		break;
+	case VIDEO_FORMAT_I010:
+		PLANE(width * 2, height);
+		PLANE(cx * 2, cy);
+		PLANE(cx * 2, cy);
+		break;
+	case VIDEO_FORMAT_I422:
+		PLANE(width, height);
+		PLANE(cx, height);
+		PLANE(cx, height);
+		break;
+	case VIDEO_FORMAT_YUY2:
+	case VIDEO_FORMAT_UYVY:
+	case VIDEO_FORMAT_YVYU:
+		PLANE(cx * 4, height);
+		break;
+	default:
+		PLANE(width * 4, height);
+		break;
+	}
+
+#undef PLANE
+}
+
+/* planes get some padding at the end of every row and one extra row, which
+ * are filled with a guard value to catch out of bounds writes */
+static void alloc_planes(struct planes *p, enum video_format format,
+			 uint32_t width, uint32_t height)
+{
+	describe(p, format, width, height);
+
+	for (size_t i = 0; i < p->count; i++) {
+		size_t size;
+
+		p->linesize[i] = p->row_bytes[i] + PADDING;
+		size = (size_t)p->linesize[i] * (p->rows[i] + 1);
+		p->data[i] = bmalloc(size);
+		memset(p->data[i], GUARD, size);
+	}
+}
+
+static void free_planes(struct planes *p)
+{
+	for (size_t i = 0; i < p->count; i++)
+		bfree(p->data[i]);
+}
+
+static uint8_t random_byte(unsigned *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return (uint8_t)(*seed >> 16);
+}
+
+static void fill_random(uint8_t *const data[], const uint32_t linesize[],
+			enum video_format format, uint32_t width,
+			uint32_t height, unsigned *seed)
+{
+	const bool i010 = format == VIDEO_FORMAT_I010;
+	struct planes p;
+
+	describe(&p, format, width, height);
+
+	for (size_t i = 0; i < p.count; i++) {
+		for (uint32_t y = 0; y < p.rows[i]; y++) {
+			uint8_t *row = data[i] + linesize[i] * y;
+
+			for (uint32_t x = 0; x < p.row_bytes[i]; x++)
+				row[x] = random_byte(seed);
+
+			/* keep I010 samples within 10 bits */
+			for (uint32_t x = 1; i010 && x < p.row_bytes[i];
+			     x += 2)
+				row[x] &= 0x3;
+		}
+	}
+}
+
+static uint16_t rd16(const struct planes *p, size_t plane, uint32_t x,
+		     uint32_t y)
+{
+	uint16_t val;
+	memcpy(&val, p->data[plane] + p->linesize[plane] * y + x * 2, 2);
+	return val;
+}
+
+static void wr16(struct planes *p, size_t plane, uint32_t x, uint32_t y,
+		 uint16_t val)
+{
+	memcpy(p->data[plane] + p->linesize[plane] * y + x * 2, &val, 2);
+}
+
+#define RD8(p, plane, x, y) (p)->data[plane][(p)->linesize[plane] * (y) + (x)]
+
+/* one sample at a time, to check the kernels against */
+static void ref_convert16(enum video_format src, const struct planes *in,
+			  struct planes *out)
+{
+	for (size_t i = 0; i < out->count; i++) {
+		for (uint32_t y = 0; y < out->rows[i]; y++) {
+			for (uint32_t x = 0; x < out->row_bytes[i] / 2; x++) {
+				uint16_t val;
+
+				if (i == 0) {
+					val = rd16(in, 0, x, y);
+				} else if (src == VIDEO_FORMAT_P010) {
+					val = rd16(in, 1, x * 2 + i - 1, y);
+				} else {
+					val = rd16(in, 1 + (x & 1), x / 2, y);
+				}
+
+				if (src == VIDEO_FORMAT_P010)
+					val >>= 6;
+				else
+					val = (uint16_t)(val << 6);
+
+				wr16(out, i, x, y, val);
+			}
+		}
+	}
+}
+
+static void ref_convert(enum video_format src, const struct planes *in,
+			struct planes *out)
+{
+	if (src == VIDEO_FORMAT_P010 || src == VIDEO_FORMAT_I010) {
+		ref_convert16(src, in, out);
+		return;
+	}
+
+	for (size_t i = 0; i < out->count; i++) {
+		for (uint32_t y = 0; y < out->rows[i]; y++) {
+			for (uint32_t x = 0; x < out->row_bytes[i]; x++) {
+				const bool uyvy = src == VIDEO_FORMAT_UYVY;
+				const bool yvyu = src == VIDEO_FORMAT_YVYU;
+				size_t plane = i;
+				uint32_t sx = x;
+
+				switch (src) {
+				case VIDEO_FORMAT_NV12:
+					if (i > 0) {
+						sx = x * 2 + (uint32_t)i - 1;
+						plane = 1;
+					}
+					break;
+				case VIDEO_FORMAT_I420:
+					if (i > 0) {
+						sx = x / 2;
+						plane = 1 + (x & 1);
+					}
+					break;
+				case VIDEO_FORMAT_YUY2:
+				case VIDEO_FORMAT_UYVY:
+				case VIDEO_FORMAT_YVYU:
+					plane = 0;
+					if (i == 0)
+						sx = x * 2 + (uyvy ? 1 : 0);
+					else if ((i == 2) != yvyu)
+						sx = x * 4 + (uyvy ? 2 : 3);
+					else
+						sx = x * 4 + (uyvy ? 0 : 1);
+					break;
+				default:
+					/* RGBA/BGRA, swap the first and
+					 * third byte of each pixel */
+					if ((x & 1) == 0)
+						sx = x ^ 2;
+					break;
+				}
+
+				RD8(out, i, x, y) = RD8(in, plane, sx, y);
+			}
+		}
+	}
+}
+
+static void check_planes(const struct planes *ref, const struct planes *out)
+{
+	for (size_t i = 0; i < out->count; i++) {
+		for (uint32_t y = 0; y <= out->rows[i]; y++) {
+			const uint8_t *a = ref->data[i] + ref->linesize[i] * y;
+			const uint8_t *b = out->data[i] + out->linesize[i] * y;
+			uint32_t x = 0;
+
+			if (y < out->rows[i]) {
+				assert_memory_equal(a, b, out->row_bytes[i]);
+				x = out->row_bytes[i];
+			}
+
+			for (; x < out->linesize[i]; x++)
+				assert_int_equal(b[x], GUARD);
+		}
+	}
+}
+
+static const struct {
+	enum video_format src;
+	enum video_format dst;
+} pairs[] = {
+	{VIDEO_FORMAT_NV12, VIDEO_FORMAT_I420},
+	{VIDEO_FORMAT_I420, VIDEO_FORMAT_NV12},
+	{VIDEO_FORMAT_P010, VIDEO_FORMAT_I010},
+	{VIDEO_FORMAT_I010, VIDEO_FORMAT_P010},
+	{VIDEO_FORMAT_RGBA, VIDEO_FORMAT_BGRA},
+	{VIDEO_FORMAT_BGRA, VIDEO_FORMAT_RGBA},
+	{VIDEO_FORMAT_BGRX, VIDEO_FORMAT_RGBA},
+	{VIDEO_FORMAT_YUY2, VIDEO_FORMAT_I422},
+	{VIDEO_FORMAT_UYVY, VIDEO_FORMAT_I422},
+	{VIDEO_FORMAT_YVYU, VIDEO_FORMAT_I422},
+};
+
+#define NUM_PAIRS (sizeof(pairs) / sizeof(pairs[0]))
+
+static void convert_test(void **state)
+{
+	static const uint32_t widths[] = {1,  2,  3,  7,   16,  17,  31, 32,
+					  33, 63, 64, 65, 127, 129, 200};
+	static const uint32_t heights[] = {1, 2, 3, 5};
+	const enum video_convert_simd max =
+		video_convert_set_simd(VIDEO_CONVERT_SIMD_AVX512);
+	unsigned seed = 1;
+
+	UNUSED_PARAMETER(state);
+
+	print_message("testing up to %s\n", video_convert_simd_name(max));
+
+	assert_false(video_convert_supported(VIDEO_FORMAT_I444,
+					     VIDEO_FORMAT_NV12));
+
+	for (size_t p = 0; p < NUM_PAIRS; p++) {
+		const enum video_format src = pairs[p].src;
+		const enum video_format dst = pairs[p].dst;
+
+		assert_true(video_convert_supported(src, dst));
+
+		for (size_t w = 0; w < sizeof(widths) / sizeof(widths[0]);
+		     w++) {
+			for (size_t h = 0;
+			     h < sizeof(heights) / sizeof(heights[0]); h++) {
+				struct planes in, ref, out;
+
+				alloc_planes(&in, src, widths[w], heights[h]);
+				alloc_planes(&ref, dst, widths[w], heights[h]);
+				fill_random(in.data, in.linesize, src,
+					    widths[w], heights[h], &seed);
+				ref_convert(src, &in, &ref);
+
+				for (int s = 0; s <= (int)max; s++) {
+					enum video_convert_simd simd = s;
+
+					assert_int_equal(
+						video_convert_set_simd(simd),
+						simd);
+
+					alloc_planes(&out, dst, widths[w],
+						     heights[h]);
+					assert_true(video_convert(
+						src, dst, widths[w], heights[h],
+						(const uint8_t *const *)in.data,
+						in.linesize, out.data,
+						out.linesize));
+					check_planes(&ref, &out);
+					free_planes(&out);
+				}
+
+				free_planes(&in);
+				free_planes(&ref);
+			}
+		}
+	}
+
+	video_convert_set_simd(VIDEO_CONVERT_SIMD_AVX512);
+}
+
+/* these layouts have dedicated lossless paths in swscale, so the results
+ * have to be identical to it */
+static const struct {
+	enum video_format src;
+	enum video_format dst;
+} scaler_pairs[] = {
+	{VIDEO_FORMAT_NV12, VIDEO_FORMAT_I420},
+	{VIDEO_FORMAT_I420, VIDEO_FORMAT_NV12},
+	{VIDEO_FORMAT_YUY2, VIDEO_FORMAT_I422},
+	{VIDEO_FORMAT_UYVY, VIDEO_FORMAT_I422},
+};
+
+static bool create_scaler(video_scaler_t **scaler, enum video_format src,
+			  enum video_format dst, uint32_t width,
+			  uint32_t height)
+{
+	struct video_scale_info from = {
+		.format = src,
+		.width = width,
+		.height = height,
+		.range = VIDEO_RANGE_PARTIAL,
+		.colorspace = VIDEO_CS_709,
+	};
+	struct video_scale_info to = from;
+
+	to.format = dst;
+	return video_scaler_create(scaler, &to, &from,
+				   VIDEO_SCALE_FAST_BILINEAR) ==
+	       VIDEO_SCALER_SUCCESS;
+}
+
+static void scaler_test(void **state)
+{
+	const uint32_t width = 322;
+	const uint32_t height = 38;
+	unsigned seed = 2;
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t p = 0; p < sizeof(scaler_pairs) / sizeof(scaler_pairs[0]);
+	     p++) {
+		const enum video_format src = scaler_pairs[p].src;
+		const enum video_format dst = scaler_pairs[p].dst;
+		struct video_frame in, a, b;
+		video_scaler_t *scaler;
+		struct planes desc;
+
+		if (!create_scaler(&scaler, src, dst, width, height)) {
+			print_message("scaler unavailable, skipping\n");
+			return;
+		}
+
+		video_frame_init(&in, src, width, height);
+		video_frame_init(&a, dst, width, height);
+		video_frame_init(&b, dst, width, height);
+
+		fill_random(in.data, in.linesize, src, width, height, &seed);
+
+		assert_true(video_scaler_scale(scaler, a.data, a.linesize,
+					       (const uint8_t *const *)in.data,
+					       in.linesize));
+		assert_true(video_convert(src, dst, width, height,
+					  (const uint8_t *const *)in.data,
+					  in.linesize, b.data, b.linesize));
+
+		describe(&desc, dst, width, height);
+		for (size_t i = 0; i < desc.count; i++) {
+			for (uint32_t y = 0; y < desc.rows[i]; y++)
+				assert_memory_equal(
+					a.data[i] + a.linesize[i] * y,
+					b.data[i] + b.linesize[i] * y,
+					desc.row_bytes[i]);
+		}
+
+		video_frame_free(&in);
+		video_frame_free(&a);
+		video_frame_free(&b);
+		video_scaler_destroy(scaler);
+	}
+}
+
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_FRAMES 20
+
+static void benchmark(void **state)
+{
+	const enum video_convert_simd max =
+		video_convert_set_simd(VIDEO_CONVERT_SIMD_AVX512);
+
+	UNUSED_PARAMETER(state);
+
+	for (size_t p = 0; p < NUM_PAIRS; p++) {
+		const enum video_format src = pairs[p].src;
+		const enum video_format dst = pairs[p].dst;
+		struct video_frame in, out;
+		video_scaler_t *scaler;
+		unsigned seed = 3;
+
+		video_frame_init(&in, src, BENCH_WIDTH, BENCH_HEIGHT);
+		video_frame_init(&out, dst, BENCH_WIDTH, BENCH_HEIGHT);
+
+		fill_random(in.data, in.linesize, src, BENCH_WIDTH,
+			    BENCH_HEIGHT, &seed);
+
+		print_message("%s -> %s:\n", get_video_format_name(src),
+			      get_video_format_name(dst));
+
+		for (int s = 0; s <= (int)max; s++) {
+			video_convert_set_simd((enum video_convert_simd)s);
+
+			uint64_t start = os_gettime_ns();
+			for (int i = 0; i < BENCH_FRAMES; i++)
+				video_convert(src, dst, BENCH_WIDTH,
+					      BENCH_HEIGHT,
+					      (const uint8_t *const *)in.data,
+					      in.linesize, out.data,
+					      out.linesize);
+			uint64_t elapsed = os_gettime_ns() - start;
+
+			print_message("  %-8s %.3f ms\n",
+				      video_convert_simd_name(s),
+				      (double)elapsed / BENCH_FRAMES / 1e6);
+		}
+
+		if (create_scaler(&scaler, src, dst, BENCH_WIDTH,
+				  BENCH_HEIGHT)) {
+			uint64_t start = os_gettime_ns();
+			for (int i = 0; i < BENCH_FRAMES; i++)
+				video_scaler_scale(
+					scaler, out.data, out.linesize,
+					(const uint8_t *const *)in.data,
+					in.linesize);
+			uint64_t elapsed = os_gettime_ns() - start;
+
+			print_message("  %-8s %.3f ms\n", "swscale",
+				      (double)elapsed / BENCH_FRAMES / 1e6);
+			video_scaler_destroy(scaler);
+		}
+
+		video_frame_free(&in);
+		video_frame_free(&out);
+	}
+
+	video_convert_set_simd(VIDEO_CONVERT_SIMD_AVX512);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(convert_test),
+		cmocka_unit_test(scaler_test),
+		cmocka_unit_test(benchmark),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,161 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <cmocka.h>
+
+#include <util/worker-pool.h>
+#include <util/threading.h>
+#include <util/bmem.h>
+
+#define COUNT 10000
+
+struct loop_data {
+	os_worker_pool_t *pool;
+	volatile long calls[COUNT];
+	volatile long inside;
+};
+
+static void count_call(void *param, size_t idx)
+{
+	struct loop_data *data = param;
+
+	os_atomic_inc_long(&data->calls[idx]);
+	if (os_worker_pool_inside(data->pool))
+		os_atomic_inc_long(&data->inside);
+}
+
+static void check_calls(struct loop_data *data, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		assert_int_equal(data->calls[i], 1);
+	for (size_t i = count; i < COUNT; i++)
+		assert_int_equal(data->calls[i], 0);
+}
+
+static void worker_pool_run_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct loop_data *data = bzalloc(sizeof(*data));
+
+	data->pool = os_worker_pool_create(4);
+	assert_non_null(data->pool);
+	assert_int_equal(os_worker_pool_num_threads(data->pool), 4);
+	assert_false(os_worker_pool_inside(data->pool));
+
+	/* every iteration runs exactly once, also when run repeatedly */
+	for (int run = 0; run < 50; run++) {
+		memset((void *)data->calls, 0, sizeof(data->calls));
+		os_worker_pool_run(data->pool, count_call, data, COUNT);
+		check_calls(data, COUNT);
+	}
+
+	/* small loops, fewer iterations than threads */
+	for (size_t count = 0; count < 8; count++) {
+		memset((void *)data->calls, 0, sizeof(data->calls));
+		os_worker_pool_run(data->pool, count_call, data, count);
+		check_calls(data, count);
+	}
+
+	os_worker_pool_destroy(data->pool);
+	bfree(data);
+}
+
+static void nested_run(void *param, size_t idx)
+{
+	struct loop_data *data = param;
+
+	/* runs inline instead of waiting for itself, both on the pool's
+	 * threads and on the thread that started the outer loop */
+	os_worker_pool_run(data->pool, count_call, data, 2);
+	UNUSED_PARAMETER(idx);
+}
+
+static void worker_pool_inline_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	struct loop_data *data = bzalloc(sizeof(*data));
+
+	/* no pool or no threads runs everything on the calling thread */
+	os_worker_pool_run(NULL, count_call, data, 100);
+	check_calls(data, 100);
+	assert_int_equal(data->inside, 0);
+
+	data->pool = os_worker_pool_create(0);
+	memset((void *)data->calls, 0, sizeof(data->calls));
+	os_worker_pool_run(data->pool, count_call, data, 100);
+	check_calls(data, 100);
+	assert_int_equal(data->inside, 0);
+	os_worker_pool_destroy(data->pool);
+
+	data->pool = os_worker_pool_create(2);
+	memset((void *)data->calls, 0, sizeof(data->calls));
+	os_worker_pool_run(data->pool, nested_run, data, 64);
+	assert_int_equal(data->calls[0], 64);
+	assert_int_equal(data->calls[1], 64);
+	os_worker_pool_destroy(data->pool);
+
+	bfree(data);
+}
+
+struct concurrent_data {
+	struct loop_data *loop;
+	bool failed;
+};
+
+static void *concurrent_thread(void *param)
+{
+	struct concurrent_data *data = param;
+	struct loop_data *loop = data->loop;
+
+	for (int run = 0; run < 200; run++) {
+		memset((void *)loop->calls, 0, sizeof(loop->calls));
+		os_worker_pool_run(loop->pool, count_call, loop, COUNT);
+
+		for (size_t i = 0; i < COUNT; i++) {
+			if (loop->calls[i] != 1)
+				data->failed = true;
+		}
+	}
+
+	return NULL;
+}
+
+/* threads sharing a pool never wait for each other's loops, and every loop
+ * still runs each iteration exactly once */
+static void worker_pool_concurrent_test(void **state)
+{
+	UNUSED_PARAMETER(state);
+
+	os_worker_pool_t *pool = os_worker_pool_create(4);
+	struct concurrent_data data[3] = {0};
+	pthread_t threads[3];
+
+	for (size_t i = 0; i < 3; i++) {
+		data[i].loop = bzalloc(sizeof(struct loop_data));
+		data[i].loop->pool = pool;
+		assert_int_equal(pthread_create(&threads[i], NULL,
+						concurrent_thread, &data[i]),
+				 0);
+	}
+
+	for (size_t i = 0; i < 3; i++) {
+		pthread_join(threads[i], NULL);
+		assert_false(data[i].failed);
+		bfree(data[i].loop);
+	}
+
+	os_worker_pool_destroy(pool);
+}
+
+int main()
+{
+	const struct CMUnitTest tests[] = {
+		cmocka_unit_test(worker_pool_run_test),
+		cmocka_unit_test(worker_pool_inline_test),
+		cmocka_unit_test(worker_pool_concurrent_test),
+	};
+
+	return cmocka_run_group_tests(tests, NULL, NULL);
+}
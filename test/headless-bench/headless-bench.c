@@ -0,0 +1,1397 @@
+/*
+ * Renders a scene collection without a display for a fixed number of frames
+ * and prints the profiler timings of every stage of the graphics thread.
+ *
+ * Uses the headless EGL platform, so it also runs on machines without a GPU
+ * through Mesa's llvmpipe (LIBGL_ALWAYS_SOFTWARE=1).
+ *
+ * With --audio-sources it instead measures the time the audio thread spends
+ * per tick on scenes with the given numbers of audio sources, once with a
+ * static audio tree and once with a tree that changes all the time.
+ *
+ * With --av-sync it instead plays a synthetic async source with jittery
+ * delivery and drifting clocks, and measures A/V offset, latency, audio
+ * buffering, dropped audio and CPU use, optionally written out as JSON.
+ *
+ * With --cache-check it instead renders a scene of static sources with the
+ * render cache on and off, and fails if the outputs differ.
+ *
+ * usage: obs-headless-bench [options] <scene collection .json>
+ *        obs-headless-bench --audio-sources <n>[,<n>...]
+ *        obs-headless-bench --av-sync [options]
+ *        obs-headless-bench --cache-check [options]
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <obs.h>
+#include <obs-nix-platform.h>
+#include <util/darray.h>
+#include <util/platform.h>
+#include <util/profiler.h>
+#include <util/threading.h>
+
+struct bench {
+	long target_frames;
+	volatile long frames;
+	os_event_t *done;
+};
+
+struct bench_options {
+	const char *collection;
+	const char *scene;
+	const char *csv;
+	const char *audio_sources;
+	uint32_t width;
+	uint32_t height;
+	uint32_t fps;
+	long frames;
+
+	bool av_sync;
+	const char *json;
+	long duration;
+	uint32_t jitter_ms;
+	double drift_ppm;
+	uint32_t stall_at_ms;
+	uint32_t stall_ms;
+	bool adaptive;
+
+	bool cache_check;
+};
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"usage: %s [options] <scene collection .json>\n"
+		"       %s --audio-sources <n>[,<n>...]\n"
+		"       %s --av-sync [options]\n"
+		"       %s --cache-check [options]\n"
+		"\n"
+		"  --frames <n>      number of frames to render (default 600)\n"
+		"  --width <n>       canvas width (default 1920)\n"
+		"  --height <n>      canvas height (default 1080)\n"
+		"  --fps <n>         frame rate (default 60)\n"
+		"  --scene <name>    scene to render (default: the current\n"
+		"                    program scene of the collection)\n"
+		"  --csv <file>      also write the profiler snapshot as CSV\n"
+		"  --audio-sources <n>[,<n>...]\n"
+		"                    measure the audio tick time with n audio\n"
+		"                    sources instead of using a collection\n"
+		"  --av-sync         measure A/V sync and audio buffering of\n"
+		"                    a synthetic source instead\n"
+		"  --duration <s>    seconds to measure (default 60)\n"
+		"  --jitter-ms <n>   deliver each packet up to n ms late\n"
+		"  --drift-ppm <n>   run the audio clock n ppm fast\n"
+		"  --stall-at <ms>   stop delivering this far in ...\n"
+		"  --stall-ms <n>    ... for n ms, then deliver the backlog\n"
+		"  --adaptive        let audio buffering shrink again\n"
+		"  --json <file>     write samples and summary as JSON, - for\n"
+		"                    stdout\n"
+		"  --cache-check     check that the render cache gives the\n"
+		"                    same output as rendering everything\n",
+		name, name, name, name);
+}
+
+static bool parse_options(struct bench_options *opts, int argc, char *argv[])
+{
+	opts->frames = 600;
+	opts->width = 1920;
+	opts->height = 1080;
+	opts->fps = 60;
+	opts->duration = 60;
+
+	for (int i = 1; i < argc; i++) {
+		const char *arg = argv[i];
+		const char *val = i + 1 < argc ? argv[i + 1] : NULL;
+
+		if (strcmp(arg, "--frames") == 0 && val) {
+			opts->frames = strtol(val, NULL, 10);
+		} else if (strcmp(arg, "--width") == 0 && val) {
+			opts->width = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--height") == 0 && val) {
+			opts->height = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--fps") == 0 && val) {
+			opts->fps = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--scene") == 0 && val) {
+			opts->scene = val;
+		} else if (strcmp(arg, "--csv") == 0 && val) {
+			opts->csv = val;
+		} else if (strcmp(arg, "--audio-sources") == 0 && val) {
+			opts->audio_sources = val;
+		} else if (strcmp(arg, "--av-sync") == 0) {
+			opts->av_sync = true;
+			continue;
+		} else if (strcmp(arg, "--duration") == 0 && val) {
+			opts->duration = strtol(val, NULL, 10);
+		} else if (strcmp(arg, "--jitter-ms") == 0 && val) {
+			opts->jitter_ms = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--drift-ppm") == 0 && val) {
+			opts->drift_ppm = strtod(val, NULL);
+		} else if (strcmp(arg, "--stall-at") == 0 && val) {
+			opts->stall_at_ms = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--stall-ms") == 0 && val) {
+			opts->stall_ms = (uint32_t)strtoul(val, NULL, 10);
+		} else if (strcmp(arg, "--adaptive") == 0) {
+			opts->adaptive = true;
+			continue;
+		} else if (strcmp(arg, "--cache-check") == 0) {
+			opts->cache_check = true;
+			continue;
+		} else if (strcmp(arg, "--json") == 0 && val) {
+			opts->json = val;
+		} else if (arg[0] != '-' && !opts->collection) {
+			opts->collection = arg;
+			continue;
+		} else {
+			return false;
+		}
+
+		i++;
+	}
+
+	return (opts->collection || opts->audio_sources || opts->av_sync ||
+		opts->cache_check) &&
+	       opts->frames > 0 && opts->duration > 0 && opts->width &&
+	       opts->height && opts->fps;
+}
+
+static bool reset_video(const struct bench_options *opts)
+{
+	struct obs_video_info ovi = {0};
+
+	ovi.graphics_module = "libobs-opengl";
+	ovi.fps_num = opts->fps;
+	ovi.fps_den = 1;
+	ovi.base_width = opts->width;
+	ovi.base_height = opts->height;
+	ovi.output_width = opts->width;
+	ovi.output_height = opts->height;
+	ovi.output_format = VIDEO_FORMAT_NV12;
+	ovi.colorspace = VIDEO_CS_709;
+	ovi.range = VIDEO_RANGE_PARTIAL;
+	ovi.gpu_conversion = true;
+	ovi.scale_type = OBS_SCALE_BICUBIC;
+
+	return obs_reset_video(&ovi) == OBS_VIDEO_SUCCESS;
+}
+
+static bool reset_audio(void)
+{
+	struct obs_audio_info oai = {48000, SPEAKERS_STEREO};
+	return obs_reset_audio(&oai);
+}
+
+static obs_source_t *load_collection(const struct bench_options *opts)
+{
+	uint64_t start = os_gettime_ns();
+	obs_data_t *data;
+	obs_source_t *scene;
+	const char *name;
+
+	data = obs_load_sources_from_file(opts->collection, NULL, NULL);
+	if (!data) {
+		blog(LOG_ERROR, "Failed to read scene collection '%s'",
+		     opts->collection);
+		return NULL;
+	}
+
+	blog(LOG_INFO, "Loaded scene collection in %.2f ms",
+	     (double)(os_gettime_ns() - start) / 1000000.0);
+
+	name = opts->scene ? opts->scene
+			   : obs_data_get_string(data, "current_program_scene");
+	if (!*name)
+		name = obs_data_get_string(data, "current_scene");
+
+	scene = obs_get_source_by_name(name);
+	if (!scene)
+		blog(LOG_ERROR, "Scene '%s' not found in '%s'", name,
+		     opts->collection);
+
+	obs_data_release(data);
+	return scene;
+}
+
+static void count_frame(void *param, struct video_data *frame)
+{
+	struct bench *bench = param;
+
+	if (os_atomic_inc_long(&bench->frames) == bench->target_frames)
+		os_event_signal(bench->done);
+
+	UNUSED_PARAMETER(frame);
+}
+
+static bool run(const struct bench_options *opts, obs_source_t *scene)
+{
+	struct bench bench = {.target_frames = opts->frames};
+	uint32_t start_total, start_lagged, start_hits, start_misses;
+	uint64_t start_ts, end_ts;
+	unsigned long timeout_ms;
+	bool success;
+
+	if (os_event_init(&bench.done, OS_EVENT_TYPE_MANUAL) != 0)
+		return false;
+
+	/* give rendering 4 times the nominal duration before giving up, the
+	 * point is to measure slow renderers too */
+	timeout_ms = (unsigned long)(opts->frames * 4000 / opts->fps) + 10000;
+
+	obs_set_output_source(0, scene);
+
+	start_total = obs_get_total_frames();
+	start_lagged = obs_get_lagged_frames();
+	start_hits = obs_get_render_cache_hits();
+	start_misses = obs_get_render_cache_misses();
+	start_ts = os_gettime_ns();
+
+	obs_add_raw_video_callback(NULL, count_frame, &bench);
+	success = os_event_timedwait(bench.done, timeout_ms) == 0;
+	obs_remove_raw_video_callback(count_frame, &bench);
+
+	end_ts = os_gettime_ns();
+
+	uint32_t total = obs_get_total_frames() - start_total;
+	uint32_t lagged = obs_get_lagged_frames() - start_lagged;
+	uint32_t hits = obs_get_render_cache_hits() - start_hits;
+	uint32_t misses = obs_get_render_cache_misses() - start_misses;
+	double seconds = (double)(end_ts - start_ts) / 1000000000.0;
+
+	obs_set_output_source(0, NULL);
+
+	if (!success)
+		blog(LOG_ERROR, "Timed out after %ld of %ld frames",
+		     os_atomic_load_long(&bench.frames), opts->frames);
+
+	blog(LOG_INFO, "==== Headless render benchmark =====================");
+	blog(LOG_INFO, "Canvas:              %ux%u @ %u fps", opts->width,
+	     opts->height, opts->fps);
+	blog(LOG_INFO, "Frames output:       %ld in %.2f s",
+	     os_atomic_load_long(&bench.frames), seconds);
+	blog(LOG_INFO, "Frames rendered:     %u (%u lagged)", total, lagged);
+	blog(LOG_INFO, "Average render time: %.3f ms",
+	     (double)obs_get_average_frame_time_ns() / 1000000.0);
+	blog(LOG_INFO, "Render cache hits:   %u / %u", hits, hits + misses);
+
+	os_event_destroy(bench.done);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* audio tick benchmark */
+
+#define AUDIO_SCENE_SIZE 10
+#define AUDIO_PHASE_MS 2500
+
+struct audio_churn {
+	obs_sceneitem_t *item;
+	os_event_t *stop;
+};
+
+/* toggling an item more than once per audio tick makes the audio thread
+ * rebuild its render order every tick */
+static void *churn_thread(void *param)
+{
+	struct audio_churn *churn = param;
+	bool visible = true;
+
+	while (os_event_timedwait(churn->stop, 5) == ETIMEDOUT) {
+		visible = !visible;
+		obs_sceneitem_set_visible(churn->item, visible);
+	}
+
+	obs_sceneitem_set_visible(churn->item, true);
+	return NULL;
+}
+
+/* audio lines in nested scenes of AUDIO_SCENE_SIZE sources each.  audio
+ * lines without any audio are cheap to render, so the tick time is mostly
+ * the overhead of walking the tree */
+static obs_scene_t *create_audio_scene(size_t count, obs_sceneitem_t **first)
+{
+	obs_scene_t *scene = obs_scene_create_private("audio bench");
+	obs_scene_t *sub = NULL;
+
+	*first = NULL;
+
+	for (size_t i = 0; i < count; i++) {
+		obs_source_t *source;
+
+		if (i % AUDIO_SCENE_SIZE == 0) {
+			obs_sceneitem_t *item;
+
+			obs_scene_release(sub);
+			sub = obs_scene_create_private(NULL);
+			item = obs_scene_add(scene, obs_scene_get_source(sub));
+			if (!*first)
+				*first = item;
+		}
+
+		source = obs_source_create_private("audio_line", NULL, NULL);
+		obs_scene_add(sub, source);
+		obs_source_release(source);
+	}
+
+	obs_scene_release(sub);
+	return scene;
+}
+
+/* the average is updated once per second, so the last full second of the
+ * phase is what gets reported */
+static double measure_audio_ticks(void)
+{
+	os_sleep_ms(AUDIO_PHASE_MS);
+	return (double)obs_get_average_audio_render_time_ns() / 1000.0;
+}
+
+static bool bench_audio_sources(size_t count)
+{
+	struct audio_churn churn = {0};
+	obs_scene_t *scene = create_audio_scene(count, &churn.item);
+	double static_us, changing_us = 0.0;
+	pthread_t thread;
+
+	obs_set_output_source(0, obs_scene_get_source(scene));
+	static_us = measure_audio_ticks();
+
+	if (os_event_init(&churn.stop, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (pthread_create(&thread, NULL, churn_thread, &churn) != 0) {
+		os_event_destroy(churn.stop);
+		goto fail;
+	}
+
+	changing_us = measure_audio_ticks();
+
+	os_event_signal(churn.stop);
+	pthread_join(thread, NULL);
+	os_event_destroy(churn.stop);
+
+	blog(LOG_INFO, "%8zu sources: %10.1f us %10.1f us", count, static_us,
+	     changing_us);
+
+fail:
+	obs_set_output_source(0, NULL);
+	obs_scene_release(scene);
+	return changing_us > 0.0;
+}
+
+static bool run_audio(const struct bench_options *opts)
+{
+	const char *list = opts->audio_sources;
+
+	blog(LOG_INFO, "==== Audio tick benchmark ==========================");
+	blog(LOG_INFO, "                  static tree   changing tree");
+
+	while (*list) {
+		char *end;
+		size_t count = (size_t)strtoul(list, &end, 10);
+
+		if (end == list || !count || (*end && *end != ',')) {
+			blog(LOG_ERROR, "Invalid source count list '%s'",
+			     opts->audio_sources);
+			return false;
+		}
+		if (!bench_audio_sources(count))
+			return false;
+
+		list = *end ? end + 1 : end;
+	}
+
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* A/V sync benchmark */
+
+/*
+ * A synthetic async source captures video and audio on clocks that can drift
+ * apart, and delivers them late by a random jitter or after a stall.  Every
+ * second both carry a marker: a gray video frame, and a burst of full scale
+ * samples whose length matches the gray level.  The raw outputs find the
+ * markers again, which gives the A/V offset of what outputs see and how late
+ * each side arrives, next to what the audio buffering had to do.
+ */
+
+#define AV_SOURCE_FPS 30
+#define AV_PACKET_FRAMES 480
+#define AV_MARKER_IDS 8
+#define AV_MARKER_STEP (256 / AV_MARKER_IDS)
+#define AV_TAIL_MS 1500
+
+struct av_source {
+	obs_source_t *source;
+	os_event_t *stop;
+	pthread_t thread;
+	bool initialized;
+
+	uint64_t start_ts;
+	uint32_t jitter_ms;
+	double drift_ppm;
+	uint64_t stall_start;
+	uint64_t stall_end;
+	uint64_t last_delivery;
+	uint32_t random;
+};
+
+struct av_marker {
+	uint64_t video_ts;
+	uint64_t video_arrival;
+	uint64_t audio_ts;
+	uint64_t audio_arrival;
+};
+
+struct av_sync {
+	pthread_mutex_t mutex;
+	DARRAY(struct av_marker) markers;
+	uint64_t start_ts;
+
+	long last_video_marker;
+	int last_video_id;
+
+	long last_audio_marker;
+	uint32_t audio_run;
+	uint64_t audio_run_ts;
+};
+
+static const char *av_source_name(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "A/V Sync Benchmark Source";
+}
+
+static void av_source_destroy(void *data)
+{
+	struct av_source *avs = data;
+
+	if (avs->initialized) {
+		os_event_signal(avs->stop);
+		pthread_join(avs->thread, NULL);
+	}
+
+	os_event_destroy(avs->stop);
+	bfree(avs);
+}
+
+/* xorshift, so that runs with the same options see the same jitter */
+static uint32_t av_source_random(struct av_source *avs, uint32_t max)
+{
+	avs->random ^= avs->random << 13;
+	avs->random ^= avs->random >> 17;
+	avs->random ^= avs->random << 5;
+	return max ? avs->random % (max + 1) : 0;
+}
+
+/* waits until something captured at capture_ts is delivered, in order */
+static bool av_source_deliver(struct av_source *avs, uint64_t capture_ts)
+{
+	uint64_t ts = capture_ts +
+		      (uint64_t)av_source_random(avs, avs->jitter_ms) * 1000000;
+
+	if (ts >= avs->stall_start && ts < avs->stall_end)
+		ts = avs->stall_end;
+	if (ts < avs->last_delivery)
+		ts = avs->last_delivery;
+
+	avs->last_delivery = ts;
+	os_sleepto_ns(ts);
+	return os_event_try(avs->stop) == EAGAIN;
+}
+
+static void av_source_video(struct av_source *avs, uint32_t *pixels,
+			    uint64_t frame)
+{
+	struct obs_source_frame out = {
+		.data = {[0] = (uint8_t *)pixels},
+		.linesize = {[0] = 20 * 4},
+		.width = 20,
+		.height = 20,
+		.format = VIDEO_FORMAT_BGRX,
+		.timestamp = avs->start_ts +
+			     frame * 1000000000ULL / AV_SOURCE_FPS,
+	};
+	uint32_t color = 0xFF000000;
+
+	if (frame && frame % AV_SOURCE_FPS == 0) {
+		uint64_t id = frame / AV_SOURCE_FPS % AV_MARKER_IDS;
+		uint32_t gray = (uint32_t)(AV_MARKER_STEP * (id + 1) - 1);
+		color |= gray | gray << 8 | gray << 16;
+	}
+
+	for (size_t i = 0; i < 20 * 20; i++)
+		pixels[i] = color;
+
+	obs_source_output_video(avs->source, &out);
+}
+
+static void av_source_audio(struct av_source *avs, float *samples,
+			    uint64_t pos, double device_rate)
+{
+	struct obs_source_audio out = {
+		.speakers = SPEAKERS_MONO,
+		.data = {[0] = (uint8_t *)samples},
+		.samples_per_sec =
+			audio_output_get_sample_rate(obs_get_audio()),
+		.frames = AV_PACKET_FRAMES,
+		.format = AUDIO_FORMAT_FLOAT,
+		.timestamp = avs->start_ts +
+			     (uint64_t)((double)pos * 1e9 / device_rate),
+	};
+
+	for (size_t i = 0; i < AV_PACKET_FRAMES; i++) {
+		/* the sample captured closest to the marker's time starts a
+		 * burst of id + 1 samples */
+		uint64_t n = pos + i;
+		uint64_t k = (uint64_t)((double)n / device_rate + 0.5);
+		uint64_t start = (uint64_t)((double)k * device_rate + 0.5);
+		uint64_t len = k % AV_MARKER_IDS + 1;
+
+		samples[i] = k && n >= start && n < start + len ? 1.0f : 0.0f;
+	}
+
+	obs_source_output_audio(avs->source, &out);
+}
+
+static void *av_source_thread(void *data)
+{
+	struct av_source *avs = data;
+	uint32_t sample_rate = audio_output_get_sample_rate(obs_get_audio());
+	double device_rate = sample_rate * (1.0 + avs->drift_ppm / 1000000.0);
+	uint32_t *pixels = bmalloc(20 * 20 * sizeof(uint32_t));
+	float *samples = bmalloc(AV_PACKET_FRAMES * sizeof(float));
+	uint64_t frame = 0;
+	uint64_t pos = 0;
+
+	for (;;) {
+		uint64_t video_ts = avs->start_ts +
+				    frame * 1000000000ULL / AV_SOURCE_FPS;
+		uint64_t audio_ts =
+			avs->start_ts +
+			(uint64_t)((double)(pos + AV_PACKET_FRAMES) * 1e9 /
+				   device_rate);
+
+		if (audio_ts <= video_ts) {
+			if (!av_source_deliver(avs, audio_ts))
+				break;
+			av_source_audio(avs, samples, pos, device_rate);
+			pos += AV_PACKET_FRAMES;
+		} else {
+			if (!av_source_deliver(avs, video_ts))
+				break;
+			av_source_video(avs, pixels, frame++);
+		}
+	}
+
+	bfree(pixels);
+	bfree(samples);
+	return NULL;
+}
+
+static void *av_source_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct av_source *avs = bzalloc(sizeof(*avs));
+	uint64_t stall_at = obs_data_get_int(settings, "stall_at_ms");
+
+	avs->source = source;
+	avs->start_ts = os_gettime_ns();
+	avs->jitter_ms = (uint32_t)obs_data_get_int(settings, "jitter_ms");
+	avs->drift_ppm = obs_data_get_double(settings, "drift_ppm");
+	avs->random = 0x2545F491;
+
+	if (stall_at) {
+		avs->stall_start = avs->start_ts + stall_at * 1000000;
+		avs->stall_end =
+			avs->stall_start +
+			obs_data_get_int(settings, "stall_ms") * 1000000;
+	}
+
+	if (os_event_init(&avs->stop, OS_EVENT_TYPE_MANUAL) != 0) {
+		av_source_destroy(avs);
+		return NULL;
+	}
+
+	if (pthread_create(&avs->thread, NULL, av_source_thread, avs) != 0) {
+		av_source_destroy(avs);
+		return NULL;
+	}
+
+	avs->initialized = true;
+	return avs;
+}
+
+static struct obs_source_info av_source_info = {
+	.id = "headless_bench_av_source",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_ASYNC_VIDEO | OBS_SOURCE_AUDIO,
+	.get_name = av_source_name,
+	.create = av_source_create,
+	.destroy = av_source_destroy,
+};
+
+/* markers only carry their number modulo AV_MARKER_IDS, so count on from
+ * the last one that was seen */
+static struct av_marker *av_sync_marker(struct av_sync *sync, long *last,
+					int id)
+{
+	long k = *last + 1;
+
+	k += ((id - k) % AV_MARKER_IDS + AV_MARKER_IDS) % AV_MARKER_IDS;
+	*last = k;
+
+	if ((size_t)k >= sync->markers.num) {
+		size_t old_num = sync->markers.num;
+
+		da_resize(sync->markers, (size_t)k + 1);
+		memset(sync->markers.array + old_num, 0,
+		       (sync->markers.num - old_num) *
+			       sizeof(struct av_marker));
+	}
+
+	return &sync->markers.array[k];
+}
+
+static void av_sync_video(void *param, struct video_data *frame)
+{
+	struct av_sync *sync = param;
+	uint8_t y = frame->data[0][10 * frame->linesize[0] + 10];
+	int gray = ((int)y - 16) * 255 / 219;
+	int id = gray < AV_MARKER_STEP / 2
+			 ? -1
+			 : (gray + 1 + AV_MARKER_STEP / 2) / AV_MARKER_STEP - 1;
+
+	if (id == sync->last_video_id)
+		return;
+
+	sync->last_video_id = id;
+	if (id < 0)
+		return;
+
+	pthread_mutex_lock(&sync->mutex);
+	struct av_marker *marker = av_sync_marker(
+		sync, &sync->last_video_marker, id);
+	marker->video_ts = frame->timestamp;
+	marker->video_arrival = os_gettime_ns();
+	pthread_mutex_unlock(&sync->mutex);
+}
+
+static void av_sync_audio(void *param, size_t mix_idx, struct audio_data *data)
+{
+	struct av_sync *sync = param;
+	const float *samples = (const float *)data->data[0];
+	uint32_t sample_rate = audio_output_get_sample_rate(obs_get_audio());
+
+	for (uint32_t i = 0; i < data->frames; i++) {
+		if (samples[i] > 0.25f) {
+			if (!sync->audio_run++)
+				sync->audio_run_ts =
+					data->timestamp +
+					audio_frames_to_ns(sample_rate, i);
+			continue;
+		}
+		if (!sync->audio_run)
+			continue;
+
+		int id = (int)(sync->audio_run - 1) % AV_MARKER_IDS;
+		sync->audio_run = 0;
+
+		pthread_mutex_lock(&sync->mutex);
+		struct av_marker *marker = av_sync_marker(
+			sync, &sync->last_audio_marker, id);
+		marker->audio_ts = sync->audio_run_ts;
+		marker->audio_arrival = os_gettime_ns();
+		pthread_mutex_unlock(&sync->mutex);
+	}
+
+	UNUSED_PARAMETER(mix_idx);
+}
+
+static inline double ns_to_ms(int64_t ns)
+{
+	return (double)ns / 1000000.0;
+}
+
+struct av_sync_result {
+	double offset_ms;
+	double audio_latency_ms;
+	double video_latency_ms;
+};
+
+static bool av_sync_result(const struct av_sync *sync, long k,
+			   struct av_sync_result *result)
+{
+	const struct av_marker *marker = &sync->markers.array[k];
+	uint64_t marker_ts = sync->start_ts + (uint64_t)k * 1000000000ULL;
+
+	if (!marker->video_ts || !marker->audio_ts)
+		return false;
+
+	result->offset_ms = ns_to_ms((int64_t)(marker->audio_ts -
+					       marker->video_ts));
+	result->audio_latency_ms =
+		ns_to_ms((int64_t)(marker->audio_arrival - marker_ts));
+	result->video_latency_ms =
+		ns_to_ms((int64_t)(marker->video_arrival - marker_ts));
+	return true;
+}
+
+static obs_data_t *av_sync_sample(struct av_sync *sync, double seconds,
+				  double cpu)
+{
+	struct obs_audio_buffering_stats stats;
+	struct av_sync_result result = {0};
+	obs_data_t *sample = obs_data_create();
+
+	obs_get_audio_buffering_stats(&stats);
+
+	obs_data_set_double(sample, "time_s", seconds);
+	obs_data_set_int(sample, "buffering_ms", stats.buffering_ms);
+	obs_data_set_int(sample, "buffering_increases", stats.increases);
+	obs_data_set_int(sample, "buffering_reclaims", stats.reclaims);
+	obs_data_set_int(sample, "reclaimed_ms", stats.reclaimed_ms);
+	obs_data_set_int(sample, "headroom_ms", stats.headroom_ms);
+	obs_data_set_int(sample, "source_restarts", stats.source_restarts);
+	obs_data_set_int(sample, "ignored_frames",
+			 (long long)stats.ignored_frames);
+	obs_data_set_int(sample, "discarded_frames",
+			 (long long)stats.discarded_frames);
+	obs_data_set_double(sample, "audio_tick_us",
+			    (double)obs_get_average_audio_render_time_ns() /
+				    1000.0);
+	obs_data_set_double(sample, "frame_ms",
+			    ns_to_ms((int64_t)obs_get_average_frame_time_ns()));
+	obs_data_set_int(sample, "lagged_frames", obs_get_lagged_frames());
+	obs_data_set_double(sample, "cpu_percent", cpu);
+
+	/* the newest marker that made it through both sides */
+	pthread_mutex_lock(&sync->mutex);
+	for (long k = (long)sync->markers.num - 1; k > 0; k--) {
+		if (av_sync_result(sync, k, &result)) {
+			obs_data_set_int(sample, "marker", k);
+			obs_data_set_double(sample, "av_offset_ms",
+					    result.offset_ms);
+			obs_data_set_double(sample, "audio_latency_ms",
+					    result.audio_latency_ms);
+			obs_data_set_double(sample, "video_latency_ms",
+					    result.video_latency_ms);
+			break;
+		}
+	}
+	pthread_mutex_unlock(&sync->mutex);
+
+	return sample;
+}
+
+static obs_data_t *av_sync_summary(struct av_sync *sync, long sent,
+				   obs_data_array_t *samples)
+{
+	struct obs_audio_buffering_stats stats;
+	obs_data_t *summary = obs_data_create();
+	double offset_sum = 0.0, offset_min = 0.0, offset_max = 0.0;
+	double audio_sum = 0.0, audio_max = 0.0;
+	double video_sum = 0.0, video_max = 0.0;
+	long matched = 0, audio_missing = 0, video_missing = 0;
+	long long max_buffering = 0;
+	double cpu_sum = 0.0, tick_sum = 0.0;
+	size_t count = obs_data_array_count(samples);
+
+	for (long k = 1; k <= sent; k++) {
+		struct av_sync_result r;
+		const struct av_marker *marker =
+			(size_t)k < sync->markers.num ? &sync->markers.array[k]
+						      : NULL;
+
+		if (!marker || !marker->audio_ts)
+			audio_missing++;
+		if (!marker || !marker->video_ts)
+			video_missing++;
+		if (!marker || !av_sync_result(sync, k, &r))
+			continue;
+
+		if (!matched || r.offset_ms < offset_min)
+			offset_min = r.offset_ms;
+		if (!matched || r.offset_ms > offset_max)
+			offset_max = r.offset_ms;
+		if (r.audio_latency_ms > audio_max)
+			audio_max = r.audio_latency_ms;
+		if (r.video_latency_ms > video_max)
+			video_max = r.video_latency_ms;
+
+		offset_sum += r.offset_ms;
+		audio_sum += r.audio_latency_ms;
+		video_sum += r.video_latency_ms;
+		matched++;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		obs_data_t *sample = obs_data_array_item(samples, i);
+		long long buffering = obs_data_get_int(sample, "buffering_ms");
+
+		if (buffering > max_buffering)
+			max_buffering = buffering;
+		cpu_sum += obs_data_get_double(sample, "cpu_percent");
+		tick_sum += obs_data_get_double(sample, "audio_tick_us");
+		obs_data_release(sample);
+	}
+
+	obs_get_audio_buffering_stats(&stats);
+
+	obs_data_set_int(summary, "markers_sent", sent);
+	obs_data_set_int(summary, "markers_matched", matched);
+	obs_data_set_int(summary, "audio_markers_missing", audio_missing);
+	obs_data_set_int(summary, "video_markers_missing", video_missing);
+	if (matched) {
+		obs_data_set_double(summary, "av_offset_mean_ms",
+				    offset_sum / matched);
+		obs_data_set_double(summary, "av_offset_min_ms", offset_min);
+		obs_data_set_double(summary, "av_offset_max_ms", offset_max);
+		obs_data_set_double(summary, "audio_latency_mean_ms",
+				    audio_sum / matched);
+		obs_data_set_double(summary, "audio_latency_max_ms", audio_max);
+		obs_data_set_double(summary, "video_latency_mean_ms",
+				    video_sum / matched);
+		obs_data_set_double(summary, "video_latency_max_ms", video_max);
+	}
+	obs_data_set_int(summary, "buffering_end_ms", stats.buffering_ms);
+	obs_data_set_int(summary, "buffering_max_ms", max_buffering);
+	obs_data_set_int(summary, "buffering_increases", stats.increases);
+	obs_data_set_int(summary, "buffering_reclaims", stats.reclaims);
+	obs_data_set_int(summary, "reclaimed_ms", stats.reclaimed_ms);
+	obs_data_set_int(summary, "source_restarts", stats.source_restarts);
+	obs_data_set_int(summary, "ignored_frames",
+			 (long long)stats.ignored_frames);
+	obs_data_set_int(summary, "discarded_frames",
+			 (long long)stats.discarded_frames);
+	if (count) {
+		obs_data_set_double(summary, "cpu_mean_percent",
+				    cpu_sum / (double)count);
+		obs_data_set_double(summary, "audio_tick_mean_us",
+				    tick_sum / (double)count);
+	}
+
+	return summary;
+}
+
+static obs_data_t *av_sync_config(const struct bench_options *opts)
+{
+	obs_data_t *config = obs_data_create();
+
+	obs_data_set_int(config, "duration_s", opts->duration);
+	obs_data_set_int(config, "jitter_ms", opts->jitter_ms);
+	obs_data_set_double(config, "drift_ppm", opts->drift_ppm);
+	obs_data_set_int(config, "stall_at_ms", opts->stall_at_ms);
+	obs_data_set_int(config, "stall_ms", opts->stall_ms);
+	obs_data_set_bool(config, "adaptive", opts->adaptive);
+	obs_data_set_int(config, "fps", opts->fps);
+	return config;
+}
+
+static void av_sync_log(obs_data_t *summary)
+{
+	blog(LOG_INFO, "==== A/V sync benchmark ============================");
+	blog(LOG_INFO, "Markers matched:     %lld / %lld",
+	     obs_data_get_int(summary, "markers_matched"),
+	     obs_data_get_int(summary, "markers_sent"));
+	blog(LOG_INFO, "A/V offset:          %.1f ms (%.1f to %.1f)",
+	     obs_data_get_double(summary, "av_offset_mean_ms"),
+	     obs_data_get_double(summary, "av_offset_min_ms"),
+	     obs_data_get_double(summary, "av_offset_max_ms"));
+	blog(LOG_INFO, "Audio latency:       %.1f ms (max %.1f)",
+	     obs_data_get_double(summary, "audio_latency_mean_ms"),
+	     obs_data_get_double(summary, "audio_latency_max_ms"));
+	blog(LOG_INFO, "Video latency:       %.1f ms (max %.1f)",
+	     obs_data_get_double(summary, "video_latency_mean_ms"),
+	     obs_data_get_double(summary, "video_latency_max_ms"));
+	blog(LOG_INFO, "Audio buffering:     %lld ms (max %lld, %lld raises)",
+	     obs_data_get_int(summary, "buffering_end_ms"),
+	     obs_data_get_int(summary, "buffering_max_ms"),
+	     obs_data_get_int(summary, "buffering_increases"));
+	blog(LOG_INFO, "Reclaimed buffering: %lld ms (%lld reclaims)",
+	     obs_data_get_int(summary, "reclaimed_ms"),
+	     obs_data_get_int(summary, "buffering_reclaims"));
+	blog(LOG_INFO, "Dropped frames:      %lld ignored, %lld discarded",
+	     obs_data_get_int(summary, "ignored_frames"),
+	     obs_data_get_int(summary, "discarded_frames"));
+	blog(LOG_INFO, "Audio tick:          %.1f us",
+	     obs_data_get_double(summary, "audio_tick_mean_us"));
+	blog(LOG_INFO, "CPU:                 %.1f %%",
+	     obs_data_get_double(summary, "cpu_mean_percent"));
+}
+
+static bool run_av_sync(const struct bench_options *opts)
+{
+	struct av_sync sync = {.last_video_id = -1};
+	obs_data_t *settings = obs_data_create();
+	obs_data_array_t *samples = obs_data_array_create();
+	obs_data_t *result = obs_data_create();
+	os_cpu_usage_info_t *cpu;
+	obs_source_t *source;
+	obs_scene_t *scene;
+	struct av_source *avs;
+	uint64_t start_ts;
+	bool success = true;
+
+	pthread_mutex_init_value(&sync.mutex);
+	if (pthread_mutex_init(&sync.mutex, NULL) != 0)
+		return false;
+
+	obs_register_source(&av_source_info);
+	obs_set_adaptive_audio_buffering(opts->adaptive);
+
+	obs_data_set_int(settings, "jitter_ms", opts->jitter_ms);
+	obs_data_set_double(settings, "drift_ppm", opts->drift_ppm);
+	obs_data_set_int(settings, "stall_at_ms", opts->stall_at_ms);
+	obs_data_set_int(settings, "stall_ms", opts->stall_ms);
+
+	scene = obs_scene_create_private("av sync bench");
+	source = obs_source_create_private(av_source_info.id, "A/V sync",
+					   settings);
+	obs_scene_add(scene, source);
+	obs_data_release(settings);
+
+	avs = obs_obj_get_data(source);
+	sync.start_ts = start_ts = avs->start_ts;
+
+	obs_add_raw_video_callback(NULL, av_sync_video, &sync);
+	obs_add_raw_audio_callback(0, NULL, av_sync_audio, &sync);
+	obs_set_output_source(0, obs_scene_get_source(scene));
+
+	cpu = os_cpu_usage_info_start();
+
+	for (long s = 1; s <= opts->duration; s++) {
+		os_sleepto_ns(start_ts + (uint64_t)s * 1000000000ULL);
+
+		obs_data_t *sample = av_sync_sample(
+			&sync, (double)s, os_cpu_usage_info_query(cpu));
+		obs_data_array_push_back(samples, sample);
+		obs_data_release(sample);
+	}
+
+	/* let the last markers through */
+	os_sleep_ms(AV_TAIL_MS);
+
+	obs_set_output_source(0, NULL);
+	obs_remove_raw_audio_callback(0, av_sync_audio, &sync);
+	obs_remove_raw_video_callback(av_sync_video, &sync);
+	os_cpu_usage_info_destroy(cpu);
+
+	obs_data_t *config = av_sync_config(opts);
+	obs_data_t *summary = av_sync_summary(&sync, opts->duration, samples);
+
+	av_sync_log(summary);
+
+	obs_data_set_obj(result, "config", config);
+	obs_data_set_obj(result, "summary", summary);
+	obs_data_set_array(result, "samples", samples);
+
+	if (opts->json && strcmp(opts->json, "-") == 0) {
+		printf("%s\n", obs_data_get_json_pretty(result));
+	} else if (opts->json && !obs_data_save_json_pretty_safe(
+					 result, opts->json, "tmp", NULL)) {
+		blog(LOG_ERROR, "Failed to write '%s'", opts->json);
+		success = false;
+	}
+
+	if (!obs_data_get_int(summary, "markers_matched")) {
+		blog(LOG_ERROR, "No marker made it through both outputs");
+		success = false;
+	}
+
+	obs_data_release(config);
+	obs_data_release(summary);
+	obs_data_release(result);
+	obs_data_array_release(samples);
+	obs_source_release(source);
+	obs_scene_release(scene);
+
+	da_free(sync.markers);
+	pthread_mutex_destroy(&sync.mutex);
+	return success;
+}
+
+/* ------------------------------------------------------------------------- */
+/* render cache check */
+
+/*
+ * Renders a scene of static sources with the render cache on and off and
+ * compares the raw output of both.  The scene covers all the cached paths:
+ * the scene texture, a cropped item rendered through its own texture, a
+ * filter reusing its input, and a nested scene.  Every change is made while
+ * the cache is warm, so stale content shows up as a difference.
+ */
+
+#define CACHE_CHECK_FRAMES 8
+#define CACHE_CHECK_TIMEOUT_MS 10000
+
+/* the cached scene texture is blended once more than the items it holds,
+ * which can round differently */
+#define CACHE_CHECK_TOLERANCE 2
+
+/* the check can't run without the headless platform or the modules it
+ * uses, which ctest reports as skipped rather than failed */
+#define EXIT_SKIP 77
+
+struct cache_check {
+	pthread_mutex_t mutex;
+	os_event_t *captured;
+	long frames_left;
+	DARRAY(uint8_t) frame;
+
+	DARRAY(uint8_t) cached;
+	DARRAY(uint8_t) uncached;
+	DARRAY(uint8_t) previous;
+};
+
+struct cache_scene {
+	obs_scene_t *scene;
+	obs_scene_t *nested;
+	obs_source_t *box;
+	obs_source_t *inner;
+	obs_source_t *filter;
+	obs_sceneitem_t *box_item;
+};
+
+/* NV12: a full size luma plane followed by a half height chroma plane */
+static void cache_check_video(void *param, struct video_data *frame)
+{
+	struct cache_check *check = param;
+	const struct video_output_info *voi =
+		video_output_get_info(obs_get_video());
+
+	pthread_mutex_lock(&check->mutex);
+
+	if (check->frames_left && --check->frames_left == 0) {
+		const uint8_t *luma = frame->data[0];
+		const uint8_t *chroma = frame->data[1];
+
+		da_resize(check->frame, 0);
+
+		for (uint32_t y = 0; y < voi->height; y++)
+			da_push_back_array(check->frame,
+					   luma + y * frame->linesize[0],
+					   voi->width);
+		for (uint32_t y = 0; y < voi->height / 2; y++)
+			da_push_back_array(check->frame,
+					   chroma + y * frame->linesize[1],
+					   voi->width);
+
+		os_event_signal(check->captured);
+	}
+
+	pthread_mutex_unlock(&check->mutex);
+}
+
+/* skips a few frames so that the frame captured was rendered after anything
+ * changed before the call */
+static bool cache_check_capture(struct cache_check *check, bool cache,
+				struct darray *out)
+{
+	bool success;
+
+	obs_set_render_cache_enabled(cache);
+
+	pthread_mutex_lock(&check->mutex);
+	os_event_reset(check->captured);
+	check->frames_left = CACHE_CHECK_FRAMES;
+	pthread_mutex_unlock(&check->mutex);
+
+	success = os_event_timedwait(check->captured,
+				     CACHE_CHECK_TIMEOUT_MS) == 0;
+
+	pthread_mutex_lock(&check->mutex);
+	check->frames_left = 0;
+	if (success)
+		darray_copy(1, out, &check->frame.da);
+	pthread_mutex_unlock(&check->mutex);
+
+	if (!success)
+		blog(LOG_ERROR, "Timed out waiting for a frame");
+	return success;
+}
+
+static int cache_check_diff(const uint8_t *a, const uint8_t *b, size_t size)
+{
+	int max_diff = 0;
+
+	for (size_t i = 0; i < size; i++) {
+		int diff = abs((int)a[i] - (int)b[i]);
+		if (diff > max_diff)
+			max_diff = diff;
+	}
+
+	return max_diff;
+}
+
+static bool cache_check_step(struct cache_check *check, const char *step)
+{
+	uint32_t hits = obs_get_render_cache_hits();
+	uint32_t cached_hits, uncached_hits;
+	int diff;
+
+	/* first with the cache that was warm when the change was made */
+	if (!cache_check_capture(check, true, &check->cached.da))
+		return false;
+	cached_hits = obs_get_render_cache_hits() - hits;
+
+	hits = obs_get_render_cache_hits();
+	if (!cache_check_capture(check, false, &check->uncached.da))
+		return false;
+	uncached_hits = obs_get_render_cache_hits() - hits;
+
+	/* warms the cache up again for the next change */
+	if (!cache_check_capture(check, true, &check->frame.da))
+		return false;
+
+	diff = cache_check_diff(check->cached.array, check->uncached.array,
+				check->cached.num);
+	blog(LOG_INFO, "%-24s max difference %d, %u cache hits", step, diff,
+	     cached_hits);
+
+	if (!cached_hits) {
+		blog(LOG_ERROR, "%s: the render cache wasn't used", step);
+		return false;
+	}
+	if (uncached_hits) {
+		blog(LOG_ERROR, "%s: the render cache was used while off",
+		     step);
+		return false;
+	}
+	if (diff > CACHE_CHECK_TOLERANCE) {
+		blog(LOG_ERROR, "%s: cached and uncached renders differ", step);
+		return false;
+	}
+	if (check->previous.num &&
+	    !cache_check_diff(check->uncached.array, check->previous.array,
+			      check->uncached.num)) {
+		blog(LOG_ERROR, "%s: the change isn't visible", step);
+		return false;
+	}
+
+	da_copy(check->previous, check->uncached);
+	return true;
+}
+
+static obs_source_t *create_color_source(const char *name, uint32_t color,
+					 uint32_t cx, uint32_t cy)
+{
+	obs_data_t *settings = obs_data_create();
+	obs_source_t *source;
+
+	obs_data_set_int(settings, "color", color);
+	obs_data_set_int(settings, "width", cx);
+	obs_data_set_int(settings, "height", cy);
+	source = obs_source_create_private("color_source_v3", name, settings);
+	obs_data_release(settings);
+
+	return source;
+}
+
+static void set_color(obs_source_t *source, uint32_t color)
+{
+	obs_data_t *settings = obs_data_create();
+
+	obs_data_set_int(settings, "color", color);
+	obs_source_update(source, settings);
+	obs_data_release(settings);
+}
+
+/* colors are 0xAABBGGRR */
+static bool create_cache_scene(struct cache_scene *cs,
+			       const struct bench_options *opts)
+{
+	struct obs_sceneitem_crop crop = {10, 10, 10, 10};
+	obs_source_t *background;
+	obs_sceneitem_t *item;
+	obs_data_t *settings;
+	struct vec2 pos;
+
+	/* sources of unknown types are still created, to keep their data */
+	if (!obs_source_get_display_name("color_source_v3") ||
+	    !obs_source_get_display_name("color_filter_v2")) {
+		blog(LOG_WARNING, "The check needs the color source and the "
+				  "color correction filter");
+		return false;
+	}
+
+	cs->scene = obs_scene_create_private("cache check");
+	cs->nested = obs_scene_create_private("cache check nested");
+
+	background = create_color_source("background", 0xFF402010,
+					 opts->width, opts->height);
+	cs->box = create_color_source("box", 0xFF0000FF, 160, 90);
+	cs->inner = create_color_source("inner", 0xFFFF0000, 80, 80);
+
+	settings = obs_data_create();
+	obs_data_set_double(settings, "hue_shift", 120.0);
+	cs->filter = obs_source_create_private("color_filter_v2", "tint",
+					       settings);
+	obs_data_release(settings);
+
+	obs_source_filter_add(cs->box, cs->filter);
+
+	obs_scene_add(cs->scene, background);
+	obs_source_release(background);
+
+	cs->box_item = obs_scene_add(cs->scene, cs->box);
+	vec2_set(&pos, 40.0f, 40.0f);
+	obs_sceneitem_set_pos(cs->box_item, &pos);
+	obs_sceneitem_set_crop(cs->box_item, &crop);
+
+	obs_scene_add(cs->nested, cs->inner);
+	item = obs_scene_add(cs->scene, obs_scene_get_source(cs->nested));
+	vec2_set(&pos, 220.0f, 60.0f);
+	obs_sceneitem_set_pos(item, &pos);
+
+	return true;
+}
+
+static void free_cache_scene(struct cache_scene *cs)
+{
+	obs_source_release(cs->box);
+	obs_source_release(cs->inner);
+	obs_source_release(cs->filter);
+	obs_scene_release(cs->nested);
+	obs_scene_release(cs->scene);
+}
+
+static int run_cache_check(const struct bench_options *opts)
+{
+	struct cache_check check = {0};
+	struct cache_scene cs = {0};
+	struct vec2 pos;
+	bool success = false;
+
+	if (!create_cache_scene(&cs, opts)) {
+		free_cache_scene(&cs);
+		return EXIT_SKIP;
+	}
+
+	pthread_mutex_init_value(&check.mutex);
+	if (pthread_mutex_init(&check.mutex, NULL) != 0)
+		goto fail_mutex;
+	if (os_event_init(&check.captured, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail_event;
+
+	blog(LOG_INFO, "==== Render cache check ============================");
+
+	obs_add_raw_video_callback(NULL, cache_check_video, &check);
+	obs_set_output_source(0, obs_scene_get_source(cs.scene));
+
+	/* one frame to warm the cache up before the first step */
+	if (!cache_check_capture(&check, true, &check.frame.da))
+		goto fail;
+	if (!cache_check_step(&check, "static scene"))
+		goto fail;
+
+	vec2_set(&pos, 60.0f, 80.0f);
+	obs_sceneitem_set_pos(cs.box_item, &pos);
+	if (!cache_check_step(&check, "transform change"))
+		goto fail;
+
+	set_color(cs.box, 0xFF00FFFF);
+	if (!cache_check_step(&check, "settings update"))
+		goto fail;
+
+	set_color(cs.inner, 0xFF00FF00);
+	if (!cache_check_step(&check, "nested settings update"))
+		goto fail;
+
+	obs_source_set_enabled(cs.filter, false);
+	if (!cache_check_step(&check, "filter disabled"))
+		goto fail;
+
+	obs_source_set_enabled(cs.filter, true);
+	if (!cache_check_step(&check, "filter enabled"))
+		goto fail;
+
+	success = true;
+
+fail:
+	obs_set_output_source(0, NULL);
+	obs_remove_raw_video_callback(cache_check_video, &check);
+	obs_set_render_cache_enabled(true);
+
+	os_event_destroy(check.captured);
+fail_event:
+	pthread_mutex_destroy(&check.mutex);
+fail_mutex:
+	da_free(check.frame);
+	da_free(check.cached);
+	da_free(check.uncached);
+	da_free(check.previous);
+	free_cache_scene(&cs);
+	return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char *argv[])
+{
+	struct bench_options opts = {0};
+	profiler_name_store_t *name_store;
+	profiler_snapshot_t *snap;
+	obs_source_t *scene = NULL;
+	int ret = EXIT_FAILURE;
+
+	if (!parse_options(&opts, argc, argv)) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	obs_set_nix_platform(OBS_NIX_PLATFORM_HEADLESS);
+	obs_set_nix_platform_display(NULL);
+
+	profiler_start();
+	name_store = profiler_name_store_create();
+
+	if (!obs_startup("en-US", NULL, name_store)) {
+		blog(LOG_ERROR, "Couldn't start OBS");
+		goto fail_startup;
+	}
+
+	if (!reset_audio() || !reset_video(&opts)) {
+		blog(LOG_ERROR, "Couldn't initialize audio/video");
+		if (opts.cache_check)
+			ret = EXIT_SKIP;
+		goto fail;
+	}
+
+	if (opts.audio_sources) {
+		if (run_audio(&opts))
+			ret = EXIT_SUCCESS;
+	} else if (opts.av_sync) {
+		if (run_av_sync(&opts))
+			ret = EXIT_SUCCESS;
+	} else if (opts.cache_check) {
+		obs_load_all_modules();
+		obs_post_load_modules();
+
+		ret = run_cache_check(&opts);
+	} else {
+		obs_load_all_modules();
+		obs_post_load_modules();
+
+		scene = load_collection(&opts);
+		if (scene && run(&opts, scene))
+			ret = EXIT_SUCCESS;
+
+		obs_source_release(scene);
+	}
+
+fail:
+	obs_shutdown();
+
+fail_startup:
+	profiler_stop();
+
+	snap = profile_snapshot_create();
+	profiler_print(snap);
+	profiler_print_time_between_calls(snap);
+	if (opts.csv && !profiler_snapshot_dump_csv(snap, opts.csv))
+		blog(LOG_ERROR, "Failed to write '%s'", opts.csv);
+	profile_snapshot_free(snap);
+
+	profiler_free();
+	profiler_name_store_free(name_store);
+	return ret;
+}
@@ -0,0 +1,421 @@
+#include <math.h>
+#include <string.h>
+#include <util/bmem.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <obs.h>
+
+/*
+ * Audio render stress test: a composite source with a few hundred private
+ * children, each of which filters the tone of its own input in its audio
+ * render callback.  Every few seconds it switches parallel audio rendering
+ * on or off and logs how long the audio ticks took either way.
+ */
+
+#ifndef M_PI
+#define M_PI 3.1415926535897932384626433832795
+#endif
+
+#define TONE_FRAMES 480
+#define TONE_INTERVAL_NS 10000000ULL
+
+/* ~5 seconds worth of ticks at 48khz */
+#define PHASE_TICKS 256
+
+#define MAX_LOAD 64
+
+struct audio_load {
+	obs_source_t *source;
+	obs_source_t *tone;
+	int load;
+
+	/* one-pole lowpass states, per pass and channel */
+	float state[MAX_LOAD][MAX_AUDIO_CHANNELS];
+};
+
+struct audio_stress {
+	obs_source_t *source;
+	DARRAY(obs_source_t *) children;
+	DARRAY(double) phases;
+
+	bool initialized_thread;
+	pthread_t thread;
+	os_event_t *event;
+
+	bool compare;
+	bool prev_parallel;
+	uint32_t ticks;
+	uint64_t serial_ns;
+	uint64_t parallel_ns;
+};
+
+/* ------------------------------------------------------------------------- */
+/* tone input: a plain async audio source, fed by the stress source */
+
+static const char *tone_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Audio Stress Tone (Test)";
+}
+
+static void *tone_create(obs_data_t *settings, obs_source_t *source)
+{
+	UNUSED_PARAMETER(settings);
+	return source;
+}
+
+static void tone_destroy(void *data)
+{
+	UNUSED_PARAMETER(data);
+}
+
+struct obs_source_info audio_stress_tone = {
+	.id = "test_audio_stress_tone",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_CAP_DISABLED,
+	.get_name = tone_getname,
+	.create = tone_create,
+	.destroy = tone_destroy,
+};
+
+/* ------------------------------------------------------------------------- */
+/* load: runs its tone through a chain of lowpass filters when rendered */
+
+static const char *load_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Audio Stress Load (Test)";
+}
+
+static void load_destroy(void *data)
+{
+	struct audio_load *al = data;
+
+	obs_source_release(al->tone);
+	bfree(al);
+}
+
+static void *load_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct audio_load *al = bzalloc(sizeof(struct audio_load));
+	int load = (int)obs_data_get_int(settings, "load");
+
+	al->source = source;
+	al->load = load < 1 ? 1 : (load > MAX_LOAD ? MAX_LOAD : load);
+	al->tone = obs_source_create_private("test_audio_stress_tone", NULL,
+					     NULL);
+	if (!al->tone) {
+		load_destroy(al);
+		return NULL;
+	}
+
+	obs_source_add_active_child(source, al->tone);
+	return al;
+}
+
+static void load_enum_sources(void *data, obs_source_enum_proc_t cb,
+			      void *param)
+{
+	struct audio_load *al = data;
+	cb(al->source, al->tone, param);
+}
+
+static void lowpass(float *state, float *out, const float *in, size_t frames)
+{
+	float s = *state;
+
+	for (size_t i = 0; i < frames; i++) {
+		s += (in[i] - s) * 0.25f;
+		out[i] = s;
+	}
+
+	*state = s;
+}
+
+static bool load_audio_render(void *data, uint64_t *ts_out,
+			      struct obs_source_audio_mix *audio_output,
+			      uint32_t mixers, size_t channels,
+			      size_t sample_rate)
+{
+	struct audio_load *al = data;
+	struct obs_source_audio_mix child;
+
+	if (obs_source_audio_pending(al->tone))
+		return false;
+
+	obs_source_get_audio_mix(al->tone, &child);
+
+	for (size_t ch = 0; ch < channels; ch++) {
+		float *out = audio_output->output[0].data[ch];
+
+		lowpass(&al->state[0][ch], out, child.output[0].data[ch],
+			AUDIO_OUTPUT_FRAMES);
+		for (int pass = 1; pass < al->load; pass++)
+			lowpass(&al->state[pass][ch], out, out,
+				AUDIO_OUTPUT_FRAMES);
+	}
+
+	for (size_t mix = 1; mix < MAX_AUDIO_MIXES; mix++) {
+		if ((mixers & (1 << mix)) == 0)
+			continue;
+
+		for (size_t ch = 0; ch < channels; ch++)
+			memcpy(audio_output->output[mix].data[ch],
+			       audio_output->output[0].data[ch],
+			       AUDIO_OUTPUT_FRAMES * sizeof(float));
+	}
+
+	*ts_out = obs_source_get_audio_timestamp(al->tone);
+
+	UNUSED_PARAMETER(sample_rate);
+	return true;
+}
+
+struct obs_source_info audio_stress_load = {
+	.id = "test_audio_stress_load",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_COMPOSITE |
+			OBS_SOURCE_CAP_DISABLED |
+			OBS_SOURCE_THREAD_SAFE_AUDIO_RENDER,
+	.get_name = load_getname,
+	.create = load_create,
+	.destroy = load_destroy,
+	.enum_active_sources = load_enum_sources,
+	.audio_render = load_audio_render,
+};
+
+/* ------------------------------------------------------------------------- */
+/* stress source: mixes all of the load sources */
+
+static void *stress_thread(void *data)
+{
+	struct audio_stress *as = data;
+	uint64_t last_time = os_gettime_ns();
+	float samples[TONE_FRAMES];
+
+	while (os_event_try(as->event) == EAGAIN) {
+		if (!os_sleepto_ns(last_time += TONE_INTERVAL_NS))
+			last_time = os_gettime_ns();
+
+		for (size_t i = 0; i < as->children.num; i++) {
+			struct audio_load *al =
+				obs_obj_get_data(as->children.array[i]);
+			double rate = (220.0 + 10.0 * (double)i) / 48000.0;
+			double phase = as->phases.array[i];
+			struct obs_source_audio audio = {
+				.data = {(uint8_t *)samples},
+				.frames = TONE_FRAMES,
+				.speakers = SPEAKERS_MONO,
+				.samples_per_sec = 48000,
+				.timestamp = last_time,
+				.format = AUDIO_FORMAT_FLOAT,
+			};
+
+			for (size_t j = 0; j < TONE_FRAMES; j++) {
+				samples[j] = (float)(sin(phase) * 0.5);
+				phase += rate * M_PI * 2.0;
+			}
+
+			as->phases.array[i] = fmod(phase, M_PI * 2.0);
+			obs_source_output_audio(al->tone, &audio);
+		}
+	}
+
+	return NULL;
+}
+
+static const char *stress_getname(void *unused)
+{
+	UNUSED_PARAMETER(unused);
+	return "Audio Render Stress Test";
+}
+
+static void stress_destroy(void *data)
+{
+	struct audio_stress *as = data;
+
+	if (as->initialized_thread) {
+		os_event_signal(as->event);
+		pthread_join(as->thread, NULL);
+	}
+
+	for (size_t i = 0; i < as->children.num; i++)
+		obs_source_release(as->children.array[i]);
+
+	if (as->compare)
+		obs_set_parallel_audio_render(as->prev_parallel);
+
+	da_free(as->children);
+	da_free(as->phases);
+	os_event_destroy(as->event);
+	bfree(as);
+}
+
+static void *stress_create(obs_data_t *settings, obs_source_t *source)
+{
+	struct audio_stress *as = bzalloc(sizeof(struct audio_stress));
+	int count = (int)obs_data_get_int(settings, "sources");
+	obs_data_t *load_settings = obs_data_create();
+
+	as->source = source;
+	as->compare = obs_data_get_bool(settings, "compare");
+	as->prev_parallel = obs_get_parallel_audio_render();
+
+	obs_data_set_int(load_settings, "load",
+			 obs_data_get_int(settings, "load"));
+
+	for (int i = 0; i < count; i++) {
+		obs_source_t *child = obs_source_create_private(
+			"test_audio_stress_load", NULL, load_settings);
+		double phase = 0.0;
+
+		if (!child)
+			break;
+
+		obs_source_add_active_child(source, child);
+		da_push_back(as->children, &child);
+		da_push_back(as->phases, &phase);
+	}
+
+	obs_data_release(load_settings);
+
+	if (os_event_init(&as->event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (pthread_create(&as->thread, NULL, stress_thread, as) != 0)
+		goto fail;
+
+	as->initialized_thread = true;
+	return as;
+
+fail:
+	stress_destroy(as);
+	return NULL;
+}
+
+static void stress_defaults(obs_data_t *settings)
+{
+	obs_data_set_default_int(settings, "sources", 200);
+	obs_data_set_default_int(settings, "load", 16);
+	obs_data_set_default_bool(settings, "compare", true);
+}
+
+static obs_properties_t *stress_properties(void *unused)
+{
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_int(props, "sources", "Sources", 1, 1000, 1);
+	obs_properties_add_int(props, "load", "Filter passes per source", 1,
+			       MAX_LOAD, 1);
+	obs_properties_add_bool(props, "compare",
+				"Alternate between serial and parallel");
+
+	UNUSED_PARAMETER(unused);
+	return props;
+}
+
+static void stress_enum_sources(void *data, obs_source_enum_proc_t cb,
+				void *param)
+{
+	struct audio_stress *as = data;
+
+	for (size_t i = 0; i < as->children.num; i++)
+		cb(as->source, as->children.array[i], param);
+}
+
+/* called once at the end of each phase, when the last second of ticks was
+ * rendered entirely with the current setting */
+static void log_phase(struct audio_stress *as)
+{
+	bool parallel = obs_get_parallel_audio_render();
+	uint64_t avg_ns = obs_get_average_audio_render_time_ns();
+	uint64_t children_ns = 0;
+
+	for (size_t i = 0; i < as->children.num; i++)
+		children_ns += obs_source_get_audio_render_time_ns(
+			as->children.array[i]);
+
+	blog(LOG_INFO,
+	     "[audio stress] %zu sources, %s: %.3f ms per tick "
+	     "(load sources alone: %.3f ms of render time)",
+	     as->children.num, parallel ? "parallel" : "serial",
+	     (double)avg_ns / 1000000.0, (double)children_ns / 1000000.0);
+
+	if (parallel)
+		as->parallel_ns = avg_ns;
+	else
+		as->serial_ns = avg_ns;
+
+	if (as->serial_ns && as->parallel_ns)
+		blog(LOG_INFO, "[audio stress] speedup: %.2fx",
+		     (double)as->serial_ns / (double)as->parallel_ns);
+
+	obs_set_parallel_audio_render(!parallel);
+}
+
+static bool stress_audio_render(void *data, uint64_t *ts_out,
+				struct obs_source_audio_mix *audio_output,
+				uint32_t mixers, size_t channels,
+				size_t sample_rate)
+{
+	struct audio_stress *as = data;
+	struct obs_source_audio_mix child;
+	const float gain = 1.0f / (float)as->children.num;
+	uint64_t ts = 0;
+
+	if (as->compare && ++as->ticks % PHASE_TICKS == 0)
+		log_phase(as);
+
+	for (size_t i = 0; i < as->children.num; i++) {
+		obs_source_t *source = as->children.array[i];
+		uint64_t source_ts = obs_source_get_audio_timestamp(source);
+
+		if (!obs_source_audio_pending(source) && source_ts &&
+		    (!ts || source_ts < ts))
+			ts = source_ts;
+	}
+
+	if (!ts)
+		return false;
+
+	for (size_t i = 0; i < as->children.num; i++) {
+		obs_source_t *source = as->children.array[i];
+
+		if (obs_source_audio_pending(source) ||
+		    obs_source_get_audio_timestamp(source) != ts)
+			continue;
+
+		obs_source_get_audio_mix(source, &child);
+
+		for (size_t mix = 0; mix < MAX_AUDIO_MIXES; mix++) {
+			if ((mixers & (1 << mix)) == 0)
+				continue;
+
+			for (size_t ch = 0; ch < channels; ch++) {
+				float *out = audio_output->output[mix].data[ch];
+				const float *in = child.output[mix].data[ch];
+
+				for (size_t j = 0; j < AUDIO_OUTPUT_FRAMES; j++)
+					out[j] += in[j] * gain;
+			}
+		}
+	}
+
+	*ts_out = ts;
+
+	UNUSED_PARAMETER(sample_rate);
+	return true;
+}
+
+struct obs_source_info audio_stress = {
+	.id = "test_audio_stress",
+	.type = OBS_SOURCE_TYPE_INPUT,
+	.output_flags = OBS_SOURCE_AUDIO | OBS_SOURCE_COMPOSITE,
+	.get_name = stress_getname,
+	.create = stress_create,
+	.destroy = stress_destroy,
+	.get_defaults = stress_defaults,
+	.get_properties = stress_properties,
+	.enum_active_sources = stress_enum_sources,
+	.audio_render = stress_audio_render,
+};
@@ -9,6 +9,9 @@ extern struct obs_source_info async_sync_test;
 extern struct obs_source_info buffering_async_sync_test;
 extern struct obs_source_info sync_video;
 extern struct obs_source_info sync_audio;
+extern struct obs_source_info audio_stress_tone;
+extern struct obs_source_info audio_stress_load;
+extern struct obs_source_info audio_stress;
 
 bool obs_module_load(void)
 {
@@ -19,5 +22,8 @@ bool obs_module_load(void)
 	obs_register_source(&buffering_async_sync_test);
 	obs_register_source(&sync_video);
 	obs_register_source(&sync_audio);
+	obs_register_source(&audio_stress_tone);
+	obs_register_source(&audio_stress_load);
+	obs_register_source(&audio_stress);
 	return true;
 }